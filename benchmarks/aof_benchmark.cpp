@@ -0,0 +1,82 @@
+// Measures SET throughput with the append-only file enabled, under each fsync
+// policy and with different numbers of concurrent clients. Each client thread
+// follows the same steps as the server does for a write command.
+
+// System includes.
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/aof.hpp"
+#include "../src/cache.hpp"
+#include "../src/config.hpp"
+#include "../src/redis_core.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+double sets_per_second(const std::filesystem::path &path, AppendFsync policy,
+                       int num_clients) {
+  using namespace std::chrono_literals;
+  constexpr auto DURATION = 1s;
+  std::filesystem::remove(path);
+  const Config config{};
+  Cache cache{};
+  AppendOnlyFile aof(path, policy);
+  std::mutex write_mutex{};
+  std::atomic<bool> done{false};
+  std::atomic<std::size_t> num_sets{0};
+  {
+    std::vector<std::jthread> clients{};
+    for (int client = 0; client < num_clients; ++client) {
+      clients.emplace_back([&, client] {
+        const auto prefix = "key:" + std::to_string(client) + ":";
+        std::size_t count = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          const Command command{CommandVerb::Set,
+                                {prefix + std::to_string(count % 1000),
+                                 "some value that is 32 bytes long"}};
+          std::uint64_t offset = 0;
+          {
+            std::scoped_lock lock(write_mutex);
+            handle_command(command, config, cache);
+            offset = aof.append(
+                0, make_propagated_command(
+                       command, Message{"OK", DataType::SimpleString}));
+          }
+          aof.wait_until_durable(offset);
+          ++count;
+        }
+        num_sets += count;
+      });
+    }
+    std::this_thread::sleep_for(DURATION);
+    done = true;
+  }
+  std::filesystem::remove(path);
+  return static_cast<double>(num_sets) /
+         std::chrono::duration<double>(DURATION).count();
+}
+
+} // namespace
+
+int main() {
+  const auto path =
+      std::filesystem::temp_directory_path() / "aof_benchmark.aof";
+  const std::vector<std::pair<std::string, AppendFsync>> policies = {
+      {"always", AppendFsync::Always},
+      {"everysec", AppendFsync::EverySec},
+      {"no", AppendFsync::No}};
+  for (const auto &[name, policy] : policies) {
+    for (const int num_clients : {1, 8, 32}) {
+      print_result("SET appendfsync " + name + ", " +
+                       std::to_string(num_clients) + " clients",
+                   sets_per_second(path, policy, num_clients), "ops/s");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// System includes.
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Small helpers shared by the benchmark executables. We deliberately avoid a
+// benchmarking framework dependency: each benchmark is a plain executable that
+// prints one line per measurement.
+
+// Runs func() repeatedly until at least min_duration has passed and returns
+// the average number of seconds per call.
+template <typename Func>
+double time_per_call(Func &&func, std::chrono::milliseconds min_duration =
+                                      std::chrono::milliseconds(500)) {
+  using Clock = std::chrono::steady_clock;
+  // Warm up caches and branch predictors once before measuring.
+  func();
+  std::size_t num_calls = 0;
+  const auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  while (elapsed < min_duration) {
+    func();
+    ++num_calls;
+    elapsed = Clock::now() - start;
+  }
+  return std::chrono::duration<double>(elapsed).count() /
+         static_cast<double>(num_calls);
+}
+
+inline void print_result(const std::string &name, double value,
+                         const std::string &unit) {
+  std::cout << std::left << std::setw(48) << name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(3) << value
+            << " " << unit << std::endl;
+}
+
+// Keeps the compiler from optimizing away a result we never otherwise use.
+template <typename T> void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
@@ -0,0 +1,66 @@
+// Measures BITCOUNT's popcount and BITOP's bitwise operations over 128 MB
+// bitmaps, for each implementation, in GB/s.
+
+// System includes.
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+
+// Our library's header includes.
+#include "../src/bitops.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+constexpr std::size_t BITMAP_SIZE = 128UL * 1024 * 1024;
+
+std::string random_bitmap(std::mt19937_64 &generator) {
+  std::string bitmap(BITMAP_SIZE, 0);
+  for (std::size_t i = 0; i < bitmap.size(); i += sizeof(std::uint64_t)) {
+    const auto word = generator();
+    std::memcpy(bitmap.data() + i, &word, sizeof(word));
+  }
+  return bitmap;
+}
+
+} // namespace
+
+int main() {
+  // NOLINTNEXTLINE(cert-msc51-cpp, cert-msc32-c)
+  std::mt19937_64 generator(42);
+  const auto source = random_bitmap(generator);
+  auto dest = random_bitmap(generator);
+  const auto gigabytes = static_cast<double>(BITMAP_SIZE) / 1e9;
+  if (!has_bitops_avx2()) {
+    std::cout << "AVX2 is not supported on this CPU" << std::endl;
+  }
+
+  const auto portable_seconds =
+      time_per_call([&] { do_not_optimize(popcount_portable(source)); });
+  print_result("popcount portable", gigabytes / portable_seconds, "GB/s");
+  const auto avx2_seconds =
+      time_per_call([&] { do_not_optimize(popcount_avx2(source)); });
+  print_result("popcount avx2 harley-seal", gigabytes / avx2_seconds, "GB/s");
+
+  for (const auto &[op, name] :
+       {std::pair{BitOp::And, "and"}, std::pair{BitOp::Or, "or"},
+        std::pair{BitOp::Xor, "xor"}}) {
+    // Each operation reads both bitmaps and writes one of them.
+    const auto bytes_touched = 3 * gigabytes;
+    const auto bitwise_portable_seconds = time_per_call([&] {
+      bitwise_portable(op, dest.data(), source);
+      do_not_optimize(dest.front());
+    });
+    print_result(std::string("bitop ") + name + " portable",
+                 bytes_touched / bitwise_portable_seconds, "GB/s");
+    const auto bitwise_avx2_seconds = time_per_call([&] {
+      bitwise_avx2(op, dest.data(), source);
+      do_not_optimize(dest.front());
+    });
+    print_result(std::string("bitop ") + name + " avx2",
+                 bytes_touched / bitwise_avx2_seconds, "GB/s");
+  }
+  return 0;
+}
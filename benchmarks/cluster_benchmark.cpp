@@ -0,0 +1,121 @@
+// Measures how write throughput scales with the number of nodes in a cluster
+// on localhost. Clients route each SET straight to the node serving its key's
+// slot, like cluster-aware clients do, so no command is ever redirected.
+// Scaling is bounded by the cores available: nodes sharing cores only split
+// them between each other.
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/cluster.hpp"
+#include "../src/redis_core.hpp"
+#include "benchmark_utils.hpp"
+#include "server_process.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+constexpr std::uint16_t FIRST_PORT = 17000;
+constexpr int NUM_CLIENTS = 8;
+constexpr auto DURATION = 2s;
+
+// The node serving the slot, when the slots are split evenly between
+// num_nodes nodes in order.
+std::size_t node_of_slot(std::size_t slot, std::size_t num_nodes) {
+  return slot * num_nodes / CLUSTER_SLOTS;
+}
+
+void expect_ok(const std::string &reply) {
+  if (!reply.starts_with('+')) {
+    std::cerr << "Unexpected reply: " << reply << std::endl;
+    std::terminate();
+  }
+}
+
+// Starts a cluster of the nodes and returns how many SETs per second the
+// clients get through.
+double measure_writes_per_second(std::size_t num_nodes) {
+  std::vector<std::unique_ptr<ServerProcess>> nodes{};
+  std::vector<std::string> ports{};
+  for (std::size_t node = 0; node < num_nodes; ++node) {
+    ports.push_back(std::to_string(FIRST_PORT + node));
+    nodes.push_back(std::make_unique<ServerProcess>(std::vector<std::string>{
+        "--port", ports.back(), "--cluster-enabled", "yes"}));
+  }
+  for (std::size_t node = 0; node < num_nodes; ++node) {
+    Client admin(static_cast<std::uint16_t>(FIRST_PORT + node));
+    expect_ok(admin.call(Command{
+        CommandVerb::Cluster,
+        {"addslotsrange", std::to_string(node * CLUSTER_SLOTS / num_nodes),
+         std::to_string(((node + 1) * CLUSTER_SLOTS / num_nodes) - 1)}}));
+  }
+  // There is no gossip, so every node meets every other one.
+  for (std::size_t node = 0; node < num_nodes; ++node) {
+    Client admin(static_cast<std::uint16_t>(FIRST_PORT + node));
+    for (std::size_t other = 0; other < num_nodes; ++other) {
+      if (other != node) {
+        expect_ok(admin.call(Command{CommandVerb::Cluster,
+                                     {"meet", "127.0.0.1", ports[other]}}));
+      }
+    }
+  }
+
+  const std::string value(100, 'v');
+  std::atomic<std::size_t> num_writes{0};
+  std::atomic<bool> done{false};
+  {
+    std::vector<std::jthread> clients{};
+    for (int client = 0; client < NUM_CLIENTS; ++client) {
+      clients.emplace_back([&, client] {
+        std::vector<std::unique_ptr<Client>> connections{};
+        for (std::size_t node = 0; node < num_nodes; ++node) {
+          connections.push_back(std::make_unique<Client>(
+              static_cast<std::uint16_t>(FIRST_PORT + node)));
+        }
+        std::size_t count = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          auto key = "key:" + std::to_string(client) + ":" +
+                     std::to_string(count % 10000);
+          const auto node = node_of_slot(key_hash_slot(key), num_nodes);
+          expect_ok(connections[node]->call(
+              Command{CommandVerb::Set, {std::move(key), value}}));
+          ++count;
+        }
+        num_writes += count;
+      });
+    }
+    std::this_thread::sleep_for(DURATION);
+    done = true;
+  }
+  return static_cast<double>(num_writes) /
+         std::chrono::duration<double>(DURATION).count();
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Hardware threads: " << std::thread::hardware_concurrency()
+            << std::endl;
+  double single_node = 0;
+  for (const std::size_t num_nodes : {1, 2, 4}) {
+    const auto writes = measure_writes_per_second(num_nodes);
+    if (num_nodes == 1) {
+      single_node = writes;
+    }
+    const auto name = std::to_string(num_nodes) + " node(s), " +
+                      std::to_string(NUM_CLIENTS) + " clients";
+    print_result(name, writes, "writes/s");
+    print_result(name + " speedup", writes / single_node, "x");
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Measures what counting a command costs: a pair of clock reads plus
+// CommandStats::record(), from one thread and from 8 threads at once, against
+// counting into shared atomics (which only differ with 8 cores or more).
+
+// System includes.
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/command_stats.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+using Clock = CommandStats::Clock;
+
+constexpr std::size_t NUM_THREADS = 8;
+constexpr std::size_t NUM_VERBS =
+    static_cast<std::size_t>(CommandVerb::Set) + 1;
+
+// Shared counters, updated with read-modify-write instructions.
+struct SharedCounters {
+  std::atomic<std::uint64_t> calls = 0;
+  std::atomic<std::uint64_t> nanoseconds = 0;
+  std::array<std::atomic<std::uint64_t>, LatencyHistogram::NUM_BUCKETS>
+      buckets{};
+};
+
+// The seconds per call of func() when NUM_THREADS threads call it at once.
+template <typename Func> double time_per_call_in_threads(Func &&func) {
+  std::vector<double> times(NUM_THREADS);
+  {
+    std::vector<std::jthread> threads{};
+    for (std::size_t i = 0; i < NUM_THREADS; ++i) {
+      threads.emplace_back(
+          [&times, &func, i] { times[i] = time_per_call(func); });
+    }
+  }
+  double total = 0;
+  for (const auto time : times) {
+    total += time;
+  }
+  return total / static_cast<double>(times.size());
+}
+
+} // namespace
+
+int main() {
+  CommandStats stats(NUM_VERBS);
+  const auto record = [&stats] {
+    const auto start = Clock::now();
+    stats.record(CommandVerb::Set, Clock::now() - start, false);
+  };
+  SharedCounters shared{};
+  const auto record_shared = [&shared] {
+    const auto start = Clock::now();
+    const auto nanoseconds = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             start)
+            .count());
+    shared.calls.fetch_add(1, std::memory_order_relaxed);
+    shared.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    shared.buckets[LatencyHistogram::bucket_of(nanoseconds)].fetch_add(
+        1, std::memory_order_relaxed);
+  };
+
+  const auto clock_pair = [] {
+    const auto start = Clock::now();
+    do_not_optimize(Clock::now() - start);
+  };
+  const auto record_only = [&stats] {
+    stats.record(CommandVerb::Set, std::chrono::microseconds(1), false);
+  };
+
+  print_result("read the clock twice", time_per_call(clock_pair) * 1e9, "ns");
+  print_result("record() alone", time_per_call(record_only) * 1e9, "ns");
+  print_result("record 1 call, 1 thread", time_per_call(record) * 1e9, "ns");
+  print_result("record 1 call, 8 threads",
+               time_per_call_in_threads(record) * 1e9, "ns");
+  print_result("shared atomics, 8 threads",
+               time_per_call_in_threads(record_shared) * 1e9, "ns");
+  do_not_optimize(stats.merged().size());
+  return 0;
+}
@@ -0,0 +1,56 @@
+// Measures finding a command by name: the perfect hash lookup (one hash and
+// one comparison, without copying the name), against lowercasing the name and
+// comparing it with every command name in turn, like the if-chains used to.
+// Also times parsing a whole request into a Command.
+
+// System includes.
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/command_table.hpp"
+#include "../src/redis_core.hpp"
+#include "../src/utils.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+// Every command name, in the order the if-chains checked them (roughly).
+std::vector<std::string> all_names() {
+  std::vector<std::string> names{};
+  for (int verb = 1;; ++verb) {
+    const auto *spec = command_spec(static_cast<CommandVerb>(verb));
+    if (!spec) {
+      break;
+    }
+    names.emplace_back(spec->name);
+  }
+  return names;
+}
+
+} // namespace
+
+int main() {
+  const auto names = all_names();
+  for (const std::string name : {"GET", "xread"}) {
+    const auto linear = time_per_call([&] {
+      const auto lower = tolower(name);
+      std::size_t index = 0;
+      while (index < names.size() && names[index] != lower) {
+        ++index;
+      }
+      do_not_optimize(index);
+    });
+    const auto hashed =
+        time_per_call([&] { do_not_optimize(find_command(name)); });
+    print_result("find " + name + ", lowercase and scan", linear * 1e9, "ns");
+    print_result("find " + name + ", perfect hash", hashed * 1e9, "ns");
+  }
+
+  const auto request = command_to_message(
+      Command{CommandVerb::XRead, {"COUNT", "1", "STREAMS", "s", "0"}});
+  const auto parse = time_per_call(
+      [&] { do_not_optimize(parse_and_validate_command(request)); });
+  print_result("parse XREAD request", parse * 1e9, "ns");
+  return 0;
+}
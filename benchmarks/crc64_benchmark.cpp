@@ -0,0 +1,37 @@
+// Measures CRC64 throughput of each implementation, in GB/s.
+
+// System includes.
+#include <random>
+#include <string>
+
+// Our library's header includes.
+#include "../src/crc64.hpp"
+#include "benchmark_utils.hpp"
+
+int main() {
+  // NOLINTNEXTLINE(cert-msc51-cpp, cert-msc32-c)
+  std::mt19937_64 generator(42);
+  for (const std::size_t size :
+       {4UL * 1024, 1024UL * 1024, 256UL * 1024 * 1024}) {
+    std::string data(size, 0);
+    for (auto &byte : data) {
+      byte = static_cast<char>(generator());
+    }
+    const auto gigabytes = static_cast<double>(size) / 1e9;
+    const auto suffix = " (" + std::to_string(size / 1024) + " KiB)";
+
+    const auto table_seconds = time_per_call(
+        [&] { do_not_optimize(crc64_slicing_by_8(0, data)); });
+    print_result("crc64 slicing-by-8" + suffix, gigabytes / table_seconds,
+                 "GB/s");
+    if (has_crc64_clmul()) {
+      const auto clmul_seconds =
+          time_per_call([&] { do_not_optimize(crc64_clmul(0, data)); });
+      print_result("crc64 pclmulqdq" + suffix, gigabytes / clmul_seconds,
+                   "GB/s");
+    } else {
+      std::cout << "pclmulqdq is not supported on this CPU" << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Counts a million unique visitor IDs with a HyperLogLog, against keeping
+// them all in a set, and measures PFCOUNT (cached and not) and PFMERGE's
+// register merge for each implementation.
+
+// System includes.
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/hyperloglog.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+constexpr std::size_t NUM_VISITORS = 1'000'000;
+constexpr std::size_t SPARSE_MAX_BYTES = 3000;
+
+} // namespace
+
+int main() {
+  std::vector<std::string> visitors{};
+  visitors.reserve(NUM_VISITORS);
+  for (std::size_t i = 0; i < NUM_VISITORS; ++i) {
+    visitors.push_back("visitor:" + std::to_string(i));
+  }
+
+  std::string hll{};
+  const auto add_seconds = time_per_call([&] {
+    hll = hll_create();
+    for (const auto &visitor : visitors) {
+      hll_add(hll, visitor, SPARSE_MAX_BYTES);
+    }
+  });
+  print_result("PFADD", static_cast<double>(NUM_VISITORS) / add_seconds / 1e6,
+               "M ops/s");
+  std::unordered_set<std::string> set{};
+  const auto set_seconds = time_per_call([&] {
+    set = std::unordered_set<std::string>(visitors.begin(), visitors.end());
+  });
+  print_result("SADD (std::unordered_set)",
+               static_cast<double>(NUM_VISITORS) / set_seconds / 1e6,
+               "M ops/s");
+  print_result("HyperLogLog size", static_cast<double>(hll.size()) / 1024,
+               "KiB");
+  // Roughly: each node holds the string (with its small-string buffer), a
+  // next pointer and the cached hash, plus one bucket pointer per member.
+  print_result("std::unordered_set size (approx.)",
+               static_cast<double>(set.size() * (sizeof(std::string) + 16) +
+                                   (set.bucket_count() * sizeof(void *))) /
+                   1024,
+               "KiB");
+  std::cout << "estimated " << hll_count(hll) << " of " << NUM_VISITORS
+            << " visitors" << std::endl;
+
+  // A merged HyperLogLog has no cached cardinality yet.
+  HllRegisters merged{};
+  hll_merge(merged, hll);
+  const auto stale = hll_from_registers(merged, SPARSE_MAX_BYTES);
+  const auto uncached_seconds = time_per_call([&] {
+    auto copy = stale;
+    do_not_optimize(hll_count(copy));
+  });
+  print_result("PFCOUNT (not cached)", 1 / uncached_seconds / 1e3,
+               "K ops/s");
+  const auto cached_seconds =
+      time_per_call([&] { do_not_optimize(hll_count(hll)); });
+  print_result("PFCOUNT (cached)", 1 / cached_seconds / 1e6, "M ops/s");
+
+  HllRegisters registers{};
+  const auto portable_seconds =
+      time_per_call([&] { hll_merge_portable(registers, hll); });
+  print_result("PFMERGE dense registers portable",
+               1 / portable_seconds / 1e3, "K merges/s");
+  if (has_hll_avx2()) {
+    const auto avx2_seconds =
+        time_per_call([&] { hll_merge_avx2(registers, hll); });
+    print_result("PFMERGE dense registers avx2", 1 / avx2_seconds / 1e3,
+                 "K merges/s");
+  } else {
+    std::cout << "AVX2 is not supported on this CPU" << std::endl;
+  }
+  do_not_optimize(registers.front());
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Compares lists stored as a quicklist of listpacks against a plain
+// std::deque<std::string>: the memory each element takes, and how fast LRANGE
+// style reads copy a range of elements out.
+
+// System includes.
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <malloc.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/quicklist.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+// The bytes currently allocated through operator new, including malloc's own
+// rounding up.
+std::atomic<std::size_t> allocated_bytes{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  allocated_bytes += malloc_usable_size(ptr);
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (ptr != nullptr) {
+    allocated_bytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+  }
+}
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+  operator delete(ptr);
+}
+
+namespace {
+
+constexpr std::size_t NUM_ELEMENTS = 100'000;
+constexpr std::size_t RANGE_SIZE = 100;
+
+// Pushes every element into a new list and returns the number of bytes that
+// allocated per element.
+template <typename List, typename Push>
+double bytes_per_element(const std::vector<std::string> &elements,
+                         Push &&push) {
+  const auto before = allocated_bytes.load();
+  auto list = std::make_unique<List>();
+  for (const auto &element : elements) {
+    push(*list, element);
+  }
+  const auto after = allocated_bytes.load();
+  return static_cast<double>(after - before) /
+         static_cast<double>(elements.size());
+}
+
+// Copies RANGE_SIZE elements out of the middle of the list, like LRANGE does
+// when building its reply.
+std::vector<std::string> quicklist_range(const Quicklist &list,
+                                         std::size_t first) {
+  std::vector<std::string> result{};
+  result.reserve(RANGE_SIZE);
+  list.for_each(first, RANGE_SIZE, [&result](const Listpack::Element &elem) {
+    result.push_back(Listpack::to_string(elem));
+  });
+  return result;
+}
+
+std::vector<std::string> deque_range(const std::deque<std::string> &list,
+                                     std::size_t first) {
+  return {list.begin() + static_cast<std::ptrdiff_t>(first),
+          list.begin() + static_cast<std::ptrdiff_t>(first + RANGE_SIZE)};
+}
+
+void run(const std::string &name, const std::vector<std::string> &elements) {
+  print_result("quicklist bytes/element (" + name + ")",
+               bytes_per_element<Quicklist>(
+                   elements, [](Quicklist &list, const std::string &element) {
+                     list.push_back(element);
+                   }),
+               "B");
+  print_result("deque bytes/element (" + name + ")",
+               bytes_per_element<std::deque<std::string>>(
+                   elements, [](std::deque<std::string> &list,
+                                const std::string &element) {
+                     list.push_back(element);
+                   }),
+               "B");
+
+  Quicklist quicklist{};
+  std::deque<std::string> deque{};
+  for (const auto &element : elements) {
+    quicklist.push_back(element);
+    deque.push_back(element);
+  }
+  const auto middle = NUM_ELEMENTS / 2;
+  const auto elements_per_second = [](double seconds) {
+    return static_cast<double>(RANGE_SIZE) / seconds / 1e6;
+  };
+  print_result("quicklist LRANGE (" + name + ")",
+               elements_per_second(time_per_call([&] {
+                 do_not_optimize(quicklist_range(quicklist, middle));
+               })),
+               "M elements/s");
+  print_result("deque LRANGE (" + name + ")",
+               elements_per_second(time_per_call(
+                   [&] { do_not_optimize(deque_range(deque, middle)); })),
+               "M elements/s");
+}
+
+} // namespace
+
+int main() {
+  std::vector<std::string> integers{};
+  std::vector<std::string> short_strings{};
+  std::vector<std::string> long_strings{};
+  for (std::size_t i = 0; i < NUM_ELEMENTS; ++i) {
+    integers.push_back(std::to_string(i * 7919));
+    short_strings.push_back("job:" + std::to_string(i));
+    long_strings.push_back("job:" + std::to_string(i) + ":" +
+                           std::string(60, 'x'));
+  }
+  run("integers", integers);
+  run("short strings", short_strings);
+  run("64 byte strings", long_strings);
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Measures pub/sub fan-out: how many messages per second reach subscribers
+// as one channel's audience grows, and how finding the patterns a channel
+// matches compares with trying every pattern like a plain list would.
+// Subscribers are one end of socket pairs, drained by a single reader thread.
+
+// System includes.
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/glob.hpp"
+#include "../src/pattern_index.hpp"
+#include "../src/pubsub.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+constexpr std::size_t NUM_MESSAGES = 20000;
+constexpr std::size_t NUM_PATTERNS = 10000;
+
+// Reads everything sent to the sockets, counting the bytes.
+class Reader {
+public:
+  explicit Reader(const std::vector<int> &fds)
+      : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {
+    for (const int fd : fds) {
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+    thread_ = std::jthread([this](const std::stop_token &stop) {
+      std::array<epoll_event, 64> events{};
+      std::array<char, 64UL * 1024> buffer{};
+      while (!stop.stop_requested()) {
+        const int num_events = epoll_wait(epoll_fd_, events.data(),
+                                          static_cast<int>(events.size()), 10);
+        for (int i = 0; i < num_events; ++i) {
+          const auto received =
+              recv(events[static_cast<std::size_t>(i)].data.fd, buffer.data(),
+                   buffer.size(), MSG_DONTWAIT);
+          if (received > 0) {
+            bytes_ += static_cast<std::size_t>(received);
+          }
+        }
+      }
+    });
+  }
+  Reader(const Reader &other) = delete;
+  Reader &operator=(const Reader &other) = delete;
+  Reader(Reader &&other) = delete;
+  Reader &operator=(Reader &&other) = delete;
+  ~Reader() {
+    thread_.request_stop();
+    thread_.join();
+    close(epoll_fd_);
+  }
+
+  void wait_for(std::size_t bytes) const {
+    while (bytes_ < bytes) {
+      std::this_thread::sleep_for(100us);
+    }
+  }
+
+private:
+  int epoll_fd_;
+  std::atomic<std::size_t> bytes_ = 0;
+  std::jthread thread_;
+};
+
+// Subscribes the clients to one channel, publishes to it, and returns how
+// many messages per second reach the subscribers.
+double measure_fan_out(std::size_t num_subscribers) {
+  std::vector<int> peers{};
+  double elapsed = 0;
+  {
+    PubSub pubsub([](SocketFd, ClientState) {}, 0);
+    for (std::size_t i = 0; i < num_subscribers; ++i) {
+      std::array<int, 2> fds{};
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) != 0) {
+        std::cerr << "Failed to create a socket pair" << std::endl;
+        std::terminate();
+      }
+      pubsub.subscribe(SocketFd(fds[0]), ClientState{},
+                       Command{CommandVerb::Subscribe, {"channel"}});
+      peers.push_back(fds[1]);
+    }
+    Reader reader(peers);
+    const std::string subscribed =
+        "*3\r\n$9\r\nsubscribe\r\n$7\r\nchannel\r\n:1\r\n";
+    reader.wait_for(subscribed.size() * num_subscribers);
+
+    const std::string data(64, 'x');
+    const auto message_size =
+        std::string("*3\r\n$7\r\nmessage\r\n$7\r\nchannel\r\n$64\r\n\r\n")
+            .size() +
+        data.size();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < NUM_MESSAGES; ++i) {
+      pubsub.publish("channel", data);
+    }
+    reader.wait_for((subscribed.size() + (message_size * NUM_MESSAGES)) *
+                    num_subscribers);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  }
+  // Only hang up once pubsub is gone, so it doesn't log every subscriber.
+  for (const int peer : peers) {
+    close(peer);
+  }
+  return static_cast<double>(NUM_MESSAGES * num_subscribers) / elapsed;
+}
+
+} // namespace
+
+int main() {
+  // Each subscriber takes two file descriptors.
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+
+  for (const std::size_t num_subscribers : {1, 10, 100, 1000}) {
+    print_result("fan-out to " + std::to_string(num_subscribers) +
+                     " subscribers",
+                 measure_fan_out(num_subscribers) / 1e6, "M deliveries/s");
+  }
+
+  // Patterns like "user:<id>:*", plus a few that match everything.
+  std::vector<std::string> patterns{};
+  PatternIndex<int> index{};
+  for (std::size_t i = 0; i < NUM_PATTERNS; ++i) {
+    patterns.push_back("user:" + std::to_string(i) + ":*");
+    index.add(patterns.back(), 0);
+  }
+  for (const auto *pattern : {"*", "user:*", "*:login"}) {
+    patterns.emplace_back(pattern);
+    index.add(pattern, 0);
+  }
+  const std::string channel = "user:4242:login";
+  const auto linear = time_per_call([&] {
+    std::size_t matches = 0;
+    for (const auto &pattern : patterns) {
+      matches += glob_match(pattern, channel) ? 1 : 0;
+    }
+    do_not_optimize(matches);
+  });
+  const auto indexed = time_per_call([&] {
+    std::size_t matches = 0;
+    index.for_each_match(channel,
+                         [&matches](const auto &, const auto &) { ++matches; });
+    do_not_optimize(matches);
+  });
+  print_result("match 10k patterns, trying each", linear * 1e6, "us");
+  print_result("match 10k patterns, indexed", indexed * 1e6, "us");
+  print_result("speedup", linear / indexed, "x");
+  return 0;
+}
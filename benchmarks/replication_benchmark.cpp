@@ -0,0 +1,144 @@
+// Measures replication between two server processes on localhost: how long a
+// full sync of a dataset takes, how long a write on the master takes to show
+// up on the replica, and how long the replica takes to catch up after a burst
+// of writes.
+
+// System includes.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/redis_core.hpp"
+#include "benchmark_utils.hpp"
+#include "server_process.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint16_t MASTER_PORT = 16379;
+constexpr std::uint16_t REPLICA_PORT = 16380;
+
+// The value of the field in the replication section of INFO.
+std::string info_field(Client &client, const std::string &field) {
+  const auto info = client.call(Command{CommandVerb::Info, {"replication"}});
+  const auto start = info.find(field + ":");
+  if (start == std::string::npos) {
+    return "";
+  }
+  const auto value_start = start + field.size() + 1;
+  const auto value_end = info.find('\r', value_start);
+  return info.substr(value_start, value_end - value_start);
+}
+
+void wait_until(const std::function<bool()> &done) {
+  const auto deadline = Clock::now() + 60s;
+  while (!done()) {
+    if (Clock::now() > deadline) {
+      std::cerr << "Timed out waiting on the replica" << std::endl;
+      std::terminate();
+    }
+    std::this_thread::sleep_for(100us);
+  }
+}
+
+double percentile(std::vector<double> values, double fraction) {
+  std::ranges::sort(values);
+  return values[static_cast<std::size_t>(fraction *
+                                         static_cast<double>(values.size() -
+                                                             1))];
+}
+
+} // namespace
+
+int main() {
+  constexpr std::size_t NUM_KEYS = 20000;
+  constexpr std::size_t NUM_LAG_SAMPLES = 2000;
+  constexpr int NUM_WRITERS = 4;
+  const std::string value(100, 'v');
+
+  ServerProcess master({"--port", std::to_string(MASTER_PORT)});
+  Client master_client(MASTER_PORT);
+  for (std::size_t i = 0; i < NUM_KEYS; ++i) {
+    master_client.call(
+        Command{CommandVerb::Set, {"key:" + std::to_string(i), value}});
+  }
+
+  // Full sync: from starting the replica until it has the whole dataset.
+  const auto sync_start = Clock::now();
+  ServerProcess replica({"--port", std::to_string(REPLICA_PORT),
+                         "--replicaof", "127.0.0.1",
+                         std::to_string(MASTER_PORT)});
+  Client replica_client(REPLICA_PORT);
+  wait_until([&] {
+    return info_field(replica_client, "master_link_status") == "up";
+  });
+  print_result("full sync of " + std::to_string(NUM_KEYS) + " keys",
+               std::chrono::duration<double, std::milli>(Clock::now() -
+                                                         sync_start)
+                   .count(),
+               "ms");
+
+  // Lag: from the master acknowledging a write to the replica serving it.
+  std::vector<double> lags_us{};
+  lags_us.reserve(NUM_LAG_SAMPLES);
+  for (std::size_t i = 0; i < NUM_LAG_SAMPLES; ++i) {
+    const auto key = "lag:" + std::to_string(i);
+    master_client.call(Command{CommandVerb::Set, {key, value}});
+    const auto written = Clock::now();
+    const Command get{CommandVerb::Get, {key}};
+    while (replica_client.call(get) == "$-1\r\n") {
+    }
+    lags_us.push_back(std::chrono::duration<double, std::micro>(
+                          Clock::now() - written)
+                          .count());
+  }
+  print_result("replication lag p50", percentile(lags_us, 0.5), "us");
+  print_result("replication lag p99", percentile(lags_us, 0.99), "us");
+
+  // Catch-up: a burst of writes from several clients at once, then how long
+  // until the replica has all of them.
+  std::atomic<std::size_t> num_writes{0};
+  {
+    std::atomic<bool> done{false};
+    std::vector<std::jthread> writers{};
+    for (int writer = 0; writer < NUM_WRITERS; ++writer) {
+      writers.emplace_back([&, writer] {
+        Client client(MASTER_PORT);
+        std::size_t count = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          client.call(Command{CommandVerb::Set,
+                              {"burst:" + std::to_string(writer) + ":" +
+                                   std::to_string(count % 1000),
+                               value}});
+          ++count;
+        }
+        num_writes += count;
+      });
+    }
+    std::this_thread::sleep_for(1s);
+    done = true;
+  }
+  const auto burst_end = Clock::now();
+  const auto master_offset = info_field(master_client, "master_repl_offset");
+  wait_until([&] {
+    return info_field(replica_client, "slave_repl_offset") == master_offset;
+  });
+  print_result("burst writes on the master (" + std::to_string(NUM_WRITERS) +
+                   " clients)",
+               static_cast<double>(num_writes), "writes/s");
+  print_result("replica catch-up after the burst",
+               std::chrono::duration<double, std::milli>(Clock::now() -
+                                                         burst_end)
+                   .count(),
+               "ms");
+  return 0;
+}
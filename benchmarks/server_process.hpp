@@ -0,0 +1,98 @@
+#pragma once
+
+// System includes.
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <exception>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/network.hpp"
+#include "../src/redis_core.hpp"
+
+// Helpers for the benchmarks that run whole servers. The "server" executable
+// is expected next to the benchmark's.
+
+// A server process, killed when this goes out of scope.
+class ServerProcess {
+public:
+  explicit ServerProcess(const std::vector<std::string> &args) {
+    const auto exe =
+        std::filesystem::read_symlink("/proc/self/exe").parent_path() /
+        "server";
+    std::vector<std::string> argv_strings{exe.string()};
+    argv_strings.insert(argv_strings.end(), args.begin(), args.end());
+    std::vector<char *> argv{};
+    for (auto &arg : argv_strings) {
+      argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    // The server logs every request, which we don't want to measure.
+    posix_spawn_file_actions_t actions{};
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+    if (posix_spawn(&pid_, exe.c_str(), &actions, nullptr, argv.data(),
+                    environ) != 0) {
+      std::cerr << "Failed to start " << exe << std::endl;
+      std::terminate();
+    }
+    posix_spawn_file_actions_destroy(&actions);
+  }
+  ServerProcess(const ServerProcess &other) = delete;
+  ServerProcess &operator=(const ServerProcess &other) = delete;
+  ServerProcess(ServerProcess &&other) = delete;
+  ServerProcess &operator=(ServerProcess &&other) = delete;
+  ~ServerProcess() {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  }
+
+private:
+  pid_t pid_ = 0;
+};
+
+// A connection that sends one command at a time and returns the raw reply.
+class Client {
+public:
+  explicit Client(std::uint16_t port) {
+    using namespace std::chrono_literals;
+    // Give the server a moment to start listening.
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!fd_ && std::chrono::steady_clock::now() < deadline) {
+      fd_ = connect_to_server("127.0.0.1", port);
+      if (!fd_) {
+        std::this_thread::sleep_for(10ms);
+      }
+    }
+    if (!fd_) {
+      std::cerr << "Failed to connect to port " << port << std::endl;
+      std::terminate();
+    }
+  }
+  Client(const Client &other) = delete;
+  Client &operator=(const Client &other) = delete;
+  Client(Client &&other) = delete;
+  Client &operator=(Client &&other) = delete;
+  ~Client() { close(static_cast<int>(*fd_)); }
+
+  std::string call(const Command &command) {
+    send_to_client(*fd_, message_to_string(command_to_message(command)));
+    return receive_string_from_client(*fd_).value_or("");
+  }
+
+private:
+  std::optional<SocketFd> fd_{};
+};
@@ -0,0 +1,80 @@
+// Intersects two sets of a million random integer IDs each, the way SINTER
+// does for each encoding: intsets with the block-wise SIMD merge, a plain
+// scalar merge of the same sorted integers as a baseline, and hash tables
+// probed member by member.
+
+// System includes.
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/intset.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+constexpr std::size_t NUM_MEMBERS = 1'000'000;
+
+} // namespace
+
+int main() {
+  // IDs drawn from four times as many, so about a quarter are shared.
+  std::mt19937_64 generator{42};
+  std::uniform_int_distribution<std::int64_t> id_distribution(
+      0, (4 * static_cast<std::int64_t>(NUM_MEMBERS)) - 1);
+  const auto random_ids = [&] {
+    std::set<std::int64_t> ids{};
+    while (ids.size() < NUM_MEMBERS) {
+      ids.insert(id_distribution(generator));
+    }
+    return std::vector<std::int64_t>(ids.begin(), ids.end());
+  };
+  const auto first_values = random_ids();
+  const auto second_values = random_ids();
+
+  IntSet first{};
+  IntSet second{};
+  std::unordered_set<std::string> first_table{};
+  std::unordered_set<std::string> second_table{};
+  for (std::size_t i = 0; i < NUM_MEMBERS; ++i) {
+    first.insert(first_values[i]);
+    second.insert(second_values[i]);
+    first_table.insert(std::to_string(first_values[i]));
+    second_table.insert(std::to_string(second_values[i]));
+  }
+  const auto members_per_second = [](double seconds) {
+    return 2 * static_cast<double>(NUM_MEMBERS) / seconds / 1e6;
+  };
+
+  print_result("intset SINTER (SIMD merge)",
+               members_per_second(time_per_call([&] {
+                 do_not_optimize(IntSet::intersect(first, second).size());
+               })),
+               "M members/s");
+  print_result("sorted vectors (scalar merge)",
+               members_per_second(time_per_call([&] {
+                 std::vector<std::int64_t> result{};
+                 std::ranges::set_intersection(first_values, second_values,
+                                               std::back_inserter(result));
+                 do_not_optimize(result.size());
+               })),
+               "M members/s");
+  print_result("hash tables (probing)",
+               members_per_second(time_per_call([&] {
+                 std::vector<const std::string *> result{};
+                 for (const auto &member : first_table) {
+                   if (second_table.contains(member)) {
+                     result.push_back(&member);
+                   }
+                 }
+                 do_not_optimize(result.size());
+               })),
+               "M members/s");
+  return 0;
+}
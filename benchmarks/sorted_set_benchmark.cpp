@@ -0,0 +1,94 @@
+// Measures ZADD and ZRANK on a leaderboard of a million members, going through
+// the same handle_command() path as the server. As a baseline, ZRANK is also
+// timed on a std::set ordered by (score, member), which has to count its way
+// to the member instead of summing skiplist spans.
+
+// System includes.
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/cache.hpp"
+#include "../src/config.hpp"
+#include "../src/redis_core.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+
+constexpr std::size_t NUM_MEMBERS = 1'000'000;
+constexpr std::size_t NUM_LOOKUPS = 1'000;
+// Counting is slow enough that a few lookups take long enough to time.
+constexpr std::size_t NUM_COUNTED_LOOKUPS = 10;
+
+std::string member_name(std::size_t index) {
+  return "player:" + std::to_string(index);
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 generator{42};
+  std::uniform_int_distribution<std::int64_t> score_distribution(0, 1'000'000);
+  std::vector<std::string> scores{};
+  scores.reserve(NUM_MEMBERS);
+  for (std::size_t i = 0; i < NUM_MEMBERS; ++i) {
+    scores.push_back(std::to_string(score_distribution(generator)));
+  }
+
+  const Config config{};
+  Cache cache{};
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  for (std::size_t i = 0; i < NUM_MEMBERS; ++i) {
+    do_not_optimize(handle_command(
+        Command{CommandVerb::ZAdd, {"board", scores[i], member_name(i)}},
+        config, cache));
+  }
+  const auto seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  print_result("ZADD (1M members)",
+               static_cast<double>(NUM_MEMBERS) / seconds / 1e6, "M ops/s");
+
+  // Look up members spread over the whole leaderboard.
+  std::vector<std::size_t> lookups{};
+  std::uniform_int_distribution<std::size_t> member_distribution(
+      0, NUM_MEMBERS - 1);
+  for (std::size_t i = 0; i < NUM_LOOKUPS; ++i) {
+    lookups.push_back(member_distribution(generator));
+  }
+  const auto per_second = [](std::size_t num_lookups,
+                              double seconds_per_batch) {
+    return static_cast<double>(num_lookups) / seconds_per_batch;
+  };
+  const auto rank_seconds = time_per_call([&] {
+    for (const auto index : lookups) {
+      do_not_optimize(handle_command(
+          Command{CommandVerb::ZRank, {"board", member_name(index)}}, config,
+          cache));
+    }
+  });
+  print_result("ZRANK (1M members)",
+               per_second(NUM_LOOKUPS, rank_seconds) / 1e6, "M ops/s");
+
+  std::set<std::pair<double, std::string>> ordered{};
+  for (std::size_t i = 0; i < NUM_MEMBERS; ++i) {
+    ordered.emplace(std::stod(scores[i]), member_name(i));
+  }
+  const auto counted_seconds = time_per_call([&] {
+    for (std::size_t i = 0; i < NUM_COUNTED_LOOKUPS; ++i) {
+      const auto index = lookups[i];
+      const auto it =
+          ordered.find({std::stod(scores[index]), member_name(index)});
+      do_not_optimize(std::distance(ordered.begin(), it));
+    }
+  });
+  print_result("std::set rank by counting (1M members)",
+               per_second(NUM_COUNTED_LOOKUPS, counted_seconds), "ops/s");
+  return 0;
+}
@@ -0,0 +1,156 @@
+// Compares streams stored as a radix tree of listpack blocks against a
+// per-entry node design (a std::map from ID to the entry's fields): how fast
+// XADD appends, the memory each entry takes, and how fast XRANGE copies a
+// range of entries out.
+
+// System includes.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/stream.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+// The bytes currently allocated through operator new, including malloc's own
+// rounding up.
+std::atomic<std::size_t> allocated_bytes{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  allocated_bytes += malloc_usable_size(ptr);
+  return ptr;
+}
+
+// Not inlined, or GCC takes the std::map nodes for memory from new that is
+// given to free().
+[[gnu::noinline]] void operator delete(void *ptr) noexcept {
+  if (ptr != nullptr) {
+    allocated_bytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+  }
+}
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+  operator delete(ptr);
+}
+
+namespace {
+
+constexpr std::size_t NUM_ENTRIES = 100'000;
+constexpr std::size_t RANGE_SIZE = 100;
+// Redis's defaults for stream-node-max-bytes and stream-node-max-entries.
+constexpr std::size_t MAX_BLOCK_BYTES = 4096;
+constexpr std::size_t MAX_BLOCK_ENTRIES = 100;
+
+using NodeStream = std::map<StreamId, std::vector<std::string>>;
+
+// Sensor readings with the same fields every time, a few per millisecond,
+// like most event streams.
+std::vector<std::vector<std::string>> make_entries() {
+  std::vector<std::vector<std::string>> entries{};
+  entries.reserve(NUM_ENTRIES);
+  for (std::size_t i = 0; i < NUM_ENTRIES; ++i) {
+    entries.push_back({"sensor", std::to_string(i % 64), "temperature",
+                       std::to_string(200 + (i * 7) % 150), "status",
+                       i % 10 == 0 ? "alarm" : "ok"});
+  }
+  return entries;
+}
+
+StreamId id_of(std::size_t index) {
+  return {1700000000000 + index / 4, index % 4};
+}
+
+Stream fill_stream(const std::vector<std::vector<std::string>> &entries) {
+  Stream stream{};
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    stream.append(id_of(i), entries[i], MAX_BLOCK_BYTES, MAX_BLOCK_ENTRIES);
+  }
+  return stream;
+}
+
+NodeStream fill_nodes(const std::vector<std::vector<std::string>> &entries) {
+  NodeStream stream{};
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    stream.emplace_hint(stream.end(), id_of(i), entries[i]);
+  }
+  return stream;
+}
+
+// The number of bytes the container allocated per entry.
+template <typename Fill>
+double bytes_per_entry(const std::vector<std::vector<std::string>> &entries,
+                       Fill &&fill) {
+  const auto before = allocated_bytes.load();
+  auto stream = std::make_unique<decltype(fill(entries))>(fill(entries));
+  const auto after = allocated_bytes.load();
+  return static_cast<double>(after - before) /
+         static_cast<double>(entries.size());
+}
+
+std::vector<StreamEntry> node_range(const NodeStream &stream,
+                                    StreamId first) {
+  std::vector<StreamEntry> result{};
+  result.reserve(RANGE_SIZE);
+  for (auto entry = stream.lower_bound(first);
+       entry != stream.end() && result.size() < RANGE_SIZE; ++entry) {
+    result.push_back({entry->first, entry->second});
+  }
+  return result;
+}
+
+} // namespace
+
+int main() {
+  const auto entries = make_entries();
+  const auto entries_per_second = [](double seconds, std::size_t count) {
+    return static_cast<double>(count) / seconds / 1e6;
+  };
+
+  print_result("stream XADD",
+               entries_per_second(time_per_call([&] {
+                 do_not_optimize(fill_stream(entries).size());
+               }),
+                                  NUM_ENTRIES),
+               "M entries/s");
+  print_result("map XADD",
+               entries_per_second(time_per_call([&] {
+                 do_not_optimize(fill_nodes(entries).size());
+               }),
+                                  NUM_ENTRIES),
+               "M entries/s");
+
+  print_result("stream bytes/entry", bytes_per_entry(entries, fill_stream),
+               "B");
+  print_result("map bytes/entry", bytes_per_entry(entries, fill_nodes), "B");
+
+  const auto stream = fill_stream(entries);
+  const auto nodes = fill_nodes(entries);
+  const auto middle = id_of(NUM_ENTRIES / 2);
+  print_result("stream XRANGE",
+               entries_per_second(time_per_call([&] {
+                 do_not_optimize(
+                     stream.range(middle, StreamId::max(), RANGE_SIZE));
+               }),
+                                  RANGE_SIZE),
+               "M entries/s");
+  print_result("map XRANGE",
+               entries_per_second(time_per_call([&] {
+                 do_not_optimize(node_range(nodes, middle));
+               }),
+                                  RANGE_SIZE),
+               "M entries/s");
+  return 0;
+}
@@ -0,0 +1,84 @@
+// Measures pushing back the deadlines of 100k idle timers, as each client
+// sends a request, in a TimerWheel against a sorted set of deadlines.
+
+// System includes.
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/timer_wheel.hpp"
+#include "benchmark_utils.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t NUM_TIMERS = 100000;
+constexpr auto TIMEOUT = 300s;
+
+// The clients that send requests, in a random order.
+std::vector<std::uint64_t> make_requests() {
+  std::mt19937_64 random(42);
+  std::uniform_int_distribution<std::uint64_t> pick(0, NUM_TIMERS - 1);
+  std::vector<std::uint64_t> requests(NUM_TIMERS);
+  for (auto &request : requests) {
+    request = pick(random);
+  }
+  return requests;
+}
+
+} // namespace
+
+int main() {
+  const auto requests = make_requests();
+  auto now = Clock::now();
+
+  TimerWheel wheel(100ms, now);
+  for (std::uint64_t id = 0; id < NUM_TIMERS; ++id) {
+    wheel.schedule(id, now + TIMEOUT);
+  }
+  std::size_t next = 0;
+  const auto wheel_time = time_per_call([&] {
+    now += 1ms;
+    wheel.schedule(requests[next], now + TIMEOUT);
+    do_not_optimize(wheel.advance(now).size());
+    next = (next + 1) % requests.size();
+  });
+
+  std::set<std::pair<Clock::time_point, std::uint64_t>> sorted{};
+  std::unordered_map<std::uint64_t, Clock::time_point> deadlines{};
+  for (std::uint64_t id = 0; id < NUM_TIMERS; ++id) {
+    sorted.emplace(now + TIMEOUT, id);
+    deadlines.emplace(id, now + TIMEOUT);
+  }
+  next = 0;
+  const auto sorted_time = time_per_call([&] {
+    now += 1ms;
+    const auto id = requests[next];
+    auto &deadline = deadlines[id];
+    sorted.erase({deadline, id});
+    deadline = now + TIMEOUT;
+    sorted.emplace(deadline, id);
+    std::size_t num_fired = 0;
+    while (!sorted.empty() && sorted.begin()->first <= now) {
+      deadlines.erase(sorted.begin()->second);
+      sorted.erase(sorted.begin());
+      ++num_fired;
+    }
+    do_not_optimize(num_fired);
+    next = (next + 1) % requests.size();
+  });
+
+  print_result("reschedule 1 of 100k timers, timer wheel", wheel_time * 1e9,
+               "ns");
+  print_result("reschedule 1 of 100k timers, sorted set", sorted_time * 1e9,
+               "ns");
+  print_result("speedup", sorted_time / wheel_time, "x");
+  return 0;
+}
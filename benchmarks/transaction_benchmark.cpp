@@ -0,0 +1,120 @@
+// Measures optimistic transactions on a server process under contention:
+// clients each increment random counters with WATCH, GET, MULTI, SET and
+// EXEC, retrying when another client got to the counter first. The fewer the
+// keys, the more transactions are aborted.
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "../src/redis_core.hpp"
+#include "benchmark_utils.hpp"
+#include "server_process.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+constexpr std::uint16_t PORT = 16390;
+constexpr auto DURATION = 1s;
+
+// The counter in the reply to GET, where a missing key counts as 0.
+std::int64_t parse_counter(const std::string &reply) {
+  if (!reply.starts_with('$') || reply.starts_with("$-1")) {
+    return 0;
+  }
+  const auto start = reply.find("\r\n") + 2;
+  return std::stoll(reply.substr(start, reply.find("\r\n", start) - start));
+}
+
+struct Result {
+  std::size_t commits = 0;
+  std::size_t aborts = 0;
+};
+
+Result increment_counters(std::size_t num_clients, std::size_t num_keys,
+                          const std::string &prefix) {
+  std::atomic<std::size_t> commits{0};
+  std::atomic<std::size_t> aborts{0};
+  {
+    std::atomic<bool> done{false};
+    std::vector<std::jthread> clients{};
+    for (std::size_t i = 0; i < num_clients; ++i) {
+      clients.emplace_back([&, i] {
+        Client client(PORT);
+        std::mt19937 random(static_cast<std::uint32_t>(i));
+        std::uniform_int_distribution<std::size_t> pick(0, num_keys - 1);
+        std::size_t num_commits = 0;
+        std::size_t num_aborts = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          const auto key = prefix + std::to_string(pick(random));
+          while (true) {
+            client.call(Command{CommandVerb::Watch, {key}});
+            const auto counter =
+                parse_counter(client.call(Command{CommandVerb::Get, {key}}));
+            client.call(Command{CommandVerb::Multi, {}});
+            client.call(
+                Command{CommandVerb::Set, {key, std::to_string(counter + 1)}});
+            if (client.call(Command{CommandVerb::Exec, {}}).starts_with('*')) {
+              ++num_commits;
+              break;
+            }
+            ++num_aborts;
+          }
+        }
+        commits += num_commits;
+        aborts += num_aborts;
+      });
+    }
+    std::this_thread::sleep_for(DURATION);
+    done = true;
+  }
+
+  // Every commit must have incremented a counter exactly once.
+  Client client(PORT);
+  std::int64_t total = 0;
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    total += parse_counter(
+        client.call(Command{CommandVerb::Get, {prefix + std::to_string(i)}}));
+  }
+  if (total != static_cast<std::int64_t>(commits.load())) {
+    std::cerr << "Lost updates: " << commits << " commits but the counters add "
+              << "up to " << total << std::endl;
+    std::terminate();
+  }
+  return Result{.commits = commits, .aborts = aborts};
+}
+
+} // namespace
+
+int main() {
+  ServerProcess server({"--port", std::to_string(PORT)});
+  Client(PORT).call(Command{CommandVerb::Ping, {}});
+
+  for (const auto &[num_clients, num_keys] :
+       std::vector<std::pair<std::size_t, std::size_t>>{
+           {1, 1}, {8, 1}, {8, 16}, {8, 1024}, {32, 16}, {32, 1024}}) {
+    const auto name = std::to_string(num_clients) + " clients, " +
+                      std::to_string(num_keys) + " keys";
+    const auto result = increment_counters(
+        num_clients, num_keys,
+        "counter:" + std::to_string(num_clients) + ":" +
+            std::to_string(num_keys) + ":");
+    const auto seconds = std::chrono::duration<double>(DURATION).count();
+    print_result(name, static_cast<double>(result.commits) / seconds,
+                 "commits/s");
+    print_result(name + ", aborted",
+                 100.0 * static_cast<double>(result.aborts) /
+                     static_cast<double>(result.commits + result.aborts),
+                 "%");
+  }
+  return 0;
+}
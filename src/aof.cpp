@@ -0,0 +1,468 @@
+// This source file's own header include.
+#include "aof.hpp"
+
+// System includes.
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <spanstream>
+#include <sstream>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+// Our library's header includes.
+#include "redis_core.hpp"
+#include "storage.hpp"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// How often the background thread writes out the buffer (and fsyncs it under
+// the "everysec" policy).
+constexpr auto BACKGROUND_FLUSH_INTERVAL = 1s;
+// Wake the background thread early once this much is buffered, which bounds
+// the memory used by the buffer under heavy write load.
+constexpr std::size_t BUFFER_HIGH_WATER_MARK = 4UL * 1024 * 1024;
+// The rewrite writes out the snapshot in chunks of about this size.
+constexpr std::size_t REWRITE_CHUNK_SIZE = 1024UL * 1024;
+// Before swapping in the new file, the rewrite catches up with the commands
+// that arrived meanwhile (without blocking writers) until fewer than this many
+// bytes are left, or it has tried this many times.
+constexpr std::size_t REWRITE_CATCH_UP_THRESHOLD = 64UL * 1024;
+constexpr int MAX_REWRITE_CATCH_UP_ROUNDS = 10;
+
+// Returns false (with errno set) if the write failed.
+bool write_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto num_written = write(fd, data.data(), data.size());
+    if (num_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(num_written));
+  }
+  return true;
+}
+
+std::uint64_t get_file_size(int fd) {
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(file_stat.st_size);
+}
+
+} // namespace
+
+AppendOnlyFile::AppendOnlyFile(std::filesystem::path path,
+                               AppendFsync fsync_policy,
+                               std::uint32_t auto_rewrite_percentage,
+                               std::uint64_t auto_rewrite_min_size)
+    : path_(std::move(path)), fsync_policy_(fsync_policy),
+      auto_rewrite_percentage_(auto_rewrite_percentage),
+      auto_rewrite_min_size_(auto_rewrite_min_size),
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+      fd_(open(path_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+               0644)) {
+  if (!is_open()) {
+    std::cerr << "Failed to open append-only file at " << path_ << ": "
+              << std::system_category().message(errno) << std::endl;
+    return;
+  }
+  base_size_ = get_file_size(fd_);
+  current_size_ = base_size_.load();
+  // Under "always", the clients themselves do the writing (see
+  // wait_until_durable()), so there is nothing for a background thread to do.
+  if (fsync_policy_ != AppendFsync::Always) {
+    flusher_ = std::jthread(
+        [this](const std::stop_token &stop_token) {
+          background_flush_loop(stop_token);
+        });
+  }
+}
+
+AppendOnlyFile::~AppendOnlyFile() {
+  // Abandons a rewrite that is still in progress.
+  if (rewriter_.joinable()) {
+    rewriter_.request_stop();
+    rewriter_.join();
+  }
+  if (flusher_.joinable()) {
+    flusher_.request_stop();
+    flusher_.join();
+  }
+  if (is_open()) {
+    flush();
+    close(fd_);
+  }
+}
+
+bool AppendOnlyFile::is_open() const { return fd_.load() >= 0; }
+
+std::uint64_t AppendOnlyFile::append(std::size_t db_index,
+                                     const Command &command) {
+  const auto serialized = message_to_string(command_to_message(command));
+  const auto select = [db_index] {
+    return message_to_string(command_to_message(
+        Command{CommandVerb::Select, {std::to_string(db_index)}}));
+  };
+  bool should_wake_flusher = false;
+  std::uint64_t offset = 0;
+  {
+    std::scoped_lock lock(mutex_);
+    const auto size_before = buffer_.size();
+    if (selected_db_ != db_index) {
+      buffer_ += select();
+      selected_db_ = db_index;
+    }
+    buffer_ += serialized;
+    if (rewrite_in_progress_) {
+      if (rewrite_selected_db_ != db_index) {
+        rewrite_buffer_ += select();
+        rewrite_selected_db_ = db_index;
+      }
+      rewrite_buffer_ += serialized;
+    }
+    appended_offset_ += buffer_.size() - size_before;
+    offset = appended_offset_;
+    should_wake_flusher = buffer_.size() >= BUFFER_HIGH_WATER_MARK;
+  }
+  if (should_wake_flusher) {
+    condition_.notify_all();
+  }
+  return offset;
+}
+
+void AppendOnlyFile::wait_until_durable(std::uint64_t offset) {
+  if (fsync_policy_ != AppendFsync::Always || !is_open()) {
+    return;
+  }
+  std::unique_lock lock(mutex_);
+  while (written_offset_ < offset) {
+    if (write_in_progress_) {
+      // Someone else is writing. Once they're done, either our command was
+      // part of their batch or one of us waiting will write the next batch.
+      condition_.wait(lock);
+    } else {
+      // Become the leader and commit everything buffered so far, including
+      // the commands of every other client waiting on us.
+      write_buffer(lock, true);
+    }
+  }
+}
+
+void AppendOnlyFile::flush() {
+  std::unique_lock lock(mutex_);
+  write_buffer(lock, true);
+}
+
+void AppendOnlyFile::write_buffer(std::unique_lock<std::mutex> &lock,
+                                  bool fsync) {
+  condition_.wait(lock, [this] { return !write_in_progress_; });
+  if (buffer_.empty() && written_offset_ == appended_offset_ && !fsync) {
+    return;
+  }
+  write_in_progress_ = true;
+  std::string pending{};
+  pending.swap(buffer_);
+  const auto target_offset = appended_offset_;
+  const int fd = fd_;
+  lock.unlock();
+
+  // Losing writes silently would defeat the point of the AOF, so we stop the
+  // server on IO errors like Redis does.
+  if (!write_all(fd, pending)) {
+    std::cerr << "Failed to write to the append-only file: "
+              << std::system_category().message(errno) << std::endl;
+    std::terminate();
+  }
+  if (fsync && fdatasync(fd) != 0) {
+    std::cerr << "Failed to fsync the append-only file: "
+              << std::system_category().message(errno) << std::endl;
+    std::terminate();
+  }
+
+  lock.lock();
+  current_size_ += pending.size();
+  written_offset_ = target_offset;
+  write_in_progress_ = false;
+  // Hand the (now empty) allocation back so the next batch can reuse it.
+  if (buffer_.empty()) {
+    pending.clear();
+    buffer_.swap(pending);
+  }
+  condition_.notify_all();
+}
+
+void AppendOnlyFile::background_flush_loop(const std::stop_token &stop_token) {
+  std::unique_lock lock(mutex_);
+  while (!stop_token.stop_requested()) {
+    condition_.wait_for(lock, stop_token, BACKGROUND_FLUSH_INTERVAL, [this] {
+      return buffer_.size() >= BUFFER_HIGH_WATER_MARK;
+    });
+    if (!buffer_.empty()) {
+      write_buffer(lock, fsync_policy_ == AppendFsync::EverySec);
+    }
+  }
+}
+
+bool AppendOnlyFile::start_rewrite(SnapshotT snapshot) {
+  {
+    std::scoped_lock lock(mutex_);
+    if (rewrite_in_progress_ || !is_open()) {
+      return false;
+    }
+    rewrite_in_progress_ = true;
+    rewrite_buffer_.clear();
+    // Replaying the snapshot leaves database 0 selected.
+    rewrite_selected_db_ = 0;
+  }
+  std::size_t num_keys = 0;
+  for (const auto &database : snapshot) {
+    num_keys += database.size();
+  }
+  std::cout << "Started rewriting the append-only file with " << num_keys
+            << " keys" << std::endl;
+  // Any previous rewriter thread has already finished, so replacing it only
+  // waits for that thread to exit.
+  rewriter_ = std::jthread([this, snapshot = std::move(snapshot)](
+                               const std::stop_token &stop_token) {
+    rewrite(stop_token, snapshot);
+  });
+  return true;
+}
+
+bool AppendOnlyFile::is_rewrite_in_progress() {
+  std::scoped_lock lock(mutex_);
+  return rewrite_in_progress_;
+}
+
+void AppendOnlyFile::wait_for_rewrite() {
+  std::unique_lock lock(mutex_);
+  condition_.wait(lock, [this] { return !rewrite_in_progress_; });
+}
+
+bool AppendOnlyFile::should_auto_rewrite() const {
+  if (auto_rewrite_percentage_ == 0 || rewrite_in_progress_) {
+    return false;
+  }
+  const auto size = current_size_.load();
+  const auto base_size = std::max<std::uint64_t>(base_size_.load(), 1);
+  return size >= auto_rewrite_min_size_ && size > base_size &&
+         (size - base_size) * 100 / base_size >= auto_rewrite_percentage_;
+}
+
+std::uint64_t AppendOnlyFile::file_size() const { return current_size_; }
+
+void AppendOnlyFile::rewrite(const std::stop_token &stop_token,
+                             const SnapshotT &snapshot) {
+  auto temp_path = path_;
+  temp_path += ".rewrite-tmp";
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+  const int new_fd = open(temp_path.c_str(),
+                          O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+  const auto abandon = [&](const std::string &reason) {
+    std::cerr << "Append-only file rewrite failed: " << reason << std::endl;
+    if (new_fd >= 0) {
+      close(new_fd);
+      std::filesystem::remove(temp_path);
+    }
+    std::scoped_lock lock(mutex_);
+    rewrite_in_progress_ = false;
+    rewrite_buffer_.clear();
+    // Wait for the file to grow further before automatically trying again.
+    base_size_ = current_size_.load();
+    condition_.notify_all();
+  };
+  if (new_fd < 0) {
+    abandon(std::system_category().message(errno));
+    return;
+  }
+
+  // Like Redis's "aof-use-rdb-preamble", the snapshot is written out in the
+  // RDB format, which can hold every type of value and loads faster than
+  // replaying commands. The commands that follow are replayed on top of it.
+  std::ostringstream preamble{};
+  write_rdb(preamble, snapshot);
+  const auto preamble_view = preamble.view();
+  for (std::size_t pos = 0; pos < preamble_view.size();
+       pos += REWRITE_CHUNK_SIZE) {
+    if (!write_all(new_fd, preamble_view.substr(pos, REWRITE_CHUNK_SIZE))) {
+      abandon(std::system_category().message(errno));
+      return;
+    }
+    if (stop_token.stop_requested()) {
+      abandon("the server is shutting down");
+      return;
+    }
+  }
+
+  // Catch up with the commands that arrived while we were writing, without
+  // blocking the writers.
+  for (int round = 0; round < MAX_REWRITE_CATCH_UP_ROUNDS; ++round) {
+    std::string pending{};
+    {
+      std::scoped_lock lock(mutex_);
+      if (rewrite_buffer_.size() < REWRITE_CATCH_UP_THRESHOLD) {
+        break;
+      }
+      pending.swap(rewrite_buffer_);
+    }
+    if (!write_all(new_fd, pending)) {
+      abandon(std::system_category().message(errno));
+      return;
+    }
+  }
+  // Do the expensive fsync before blocking writers for the final step.
+  if (fdatasync(new_fd) != 0) {
+    abandon(std::system_category().message(errno));
+    return;
+  }
+
+  std::unique_lock lock(mutex_);
+  condition_.wait(lock, [this] { return !write_in_progress_; });
+  if (!finish_rewrite(new_fd, temp_path)) {
+    lock.unlock();
+    abandon(std::system_category().message(errno));
+  }
+}
+
+bool AppendOnlyFile::finish_rewrite(int new_fd,
+                                    const std::filesystem::path &new_path) {
+  // Whatever is left in the rewrite buffer is all the new file is missing.
+  if (!write_all(new_fd, rewrite_buffer_) || fdatasync(new_fd) != 0) {
+    return false;
+  }
+  if (rename(new_path.c_str(), path_.c_str()) != 0) {
+    return false;
+  }
+  fsync_directory(path_.parent_path().empty() ? "." : path_.parent_path());
+  close(fd_.exchange(new_fd));
+
+  // Everything appended so far is in the new file (either in the snapshot or
+  // in the rewrite buffer), including what was still buffered for the old one.
+  buffer_.clear();
+  written_offset_ = appended_offset_;
+  rewrite_buffer_.clear();
+  selected_db_ = rewrite_selected_db_;
+  rewrite_in_progress_ = false;
+  base_size_ = get_file_size(new_fd);
+  current_size_ = base_size_.load();
+  std::cout << "Finished rewriting the append-only file, new size is "
+            << current_size_ << " bytes" << std::endl;
+  condition_.notify_all();
+  return true;
+}
+
+std::filesystem::path aof_path(const Config &config) {
+  return std::filesystem::path(config.dir.value_or(".")) /
+         std::filesystem::path(config.appendfilename);
+}
+
+bool load_aof(const std::filesystem::path &path, const Config &config,
+              std::span<Cache> databases, LoadingProgress *progress) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::cout << "Replaying append-only file: " << path << std::endl;
+  const std::string contents{std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>()};
+  file.close();
+  if (progress) {
+    progress->total_bytes = contents.size();
+  }
+
+  std::size_t pos = 0;
+  // A rewritten file starts with the snapshot in the RDB format.
+  if (contents.starts_with(RDB_MAGIC)) {
+    std::ispanstream preamble(contents);
+    read_rdb_into_databases(preamble, databases, progress);
+    pos = static_cast<std::size_t>(preamble.tellg());
+  }
+  std::size_t num_commands = 0;
+  // Tracks the database selected by the SELECTs in the file.
+  ClientState replay{};
+  const auto replay_command = [&](const Command &command) {
+    const auto reply = handle_database_command(command, databases, replay);
+    if (!reply) {
+      auto &cache = databases[replay.db_index];
+      if (!handle_command(command, config, cache)) {
+        generate_response_message(command, config, cache);
+      }
+    } else if (reply->get_data_type() == DataType::SimpleError) {
+      // e.g. a SELECT of a database beyond --databases.
+      std::cerr << "Failed to replay command from append-only file: "
+                << message_to_string(command_to_message(command))
+                << std::endl;
+      std::terminate();
+    }
+    ++num_commands;
+  };
+  // The commands of the transaction being read, which are only replayed
+  // once its EXEC is, and where its MULTI starts.
+  std::optional<std::vector<Command>> transaction{};
+  std::size_t transaction_start = 0;
+  while (pos < contents.size()) {
+    const auto command_start = pos;
+    const auto message = parse_command_array(contents, pos);
+    if (!message) {
+      // The last command was only partially written before a crash. Drop it
+      // (and the rest of its transaction) so that new commands get appended
+      // after a complete one.
+      const auto size = transaction ? transaction_start : command_start;
+      std::cerr << "Append-only file ends with a truncated command, "
+                   "truncating it to "
+                << size << " bytes" << std::endl;
+      std::filesystem::resize_file(path, size);
+      transaction.reset();
+      break;
+    }
+    const auto command = parse_and_validate_command(*message);
+    if (!command) {
+      std::cerr << "Skipping unknown command in append-only file: "
+                << message_to_string(*message) << std::endl;
+      continue;
+    }
+    if (command->verb == CommandVerb::Multi) {
+      transaction.emplace();
+      transaction_start = command_start;
+    } else if (command->verb == CommandVerb::Exec) {
+      if (transaction) {
+        for (const auto &queued : *transaction) {
+          replay_command(queued);
+        }
+        transaction.reset();
+      }
+    } else if (transaction) {
+      transaction->push_back(*command);
+    } else {
+      replay_command(*command);
+    }
+    if (progress) {
+      progress->loaded_bytes = pos;
+    }
+  }
+  if (transaction) {
+    // The server stopped in the middle of writing the transaction. Like a
+    // truncated command, it never happened.
+    std::cerr << "Append-only file ends with an unterminated MULTI, "
+                 "truncating it to "
+              << transaction_start << " bytes" << std::endl;
+    std::filesystem::resize_file(path, transaction_start);
+  }
+  std::cout << "Replayed " << num_commands << " commands" << std::endl;
+  return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "protocol.hpp"
+
+struct LoadingProgress;
+
+// The append-only file (AOF) logs every write command in the same RESP format
+// clients send them in, so the dataset can be rebuilt by replaying the log on
+// startup. See
+// https://redis.io/docs/latest/operate/oss_and_stack/management/persistence/
+//
+// Like Redis, a SELECT is logged in front of any command for a different
+// database than the command before it.
+//
+// Commands are first appended to an in-memory buffer, which is written out in
+// batches. With the "always" fsync policy, clients waiting on the same fsync
+// are group committed: whoever gets there first writes and fsyncs the whole
+// buffer on behalf of everyone else, so concurrent writers share the cost of
+// one fsync. The other policies write (and, for "everysec", fsync) the buffer
+// from a background thread.
+//
+// Since the file only ever grows, it can be rewritten in the background (like
+// BGREWRITEAOF) into a snapshot of the current dataset in the RDB format (an
+// "RDB preamble"). Commands appended during the rewrite go to both the old
+// file and a rewrite buffer, which is appended to the new file before it
+// atomically replaces the old one.
+class AppendOnlyFile {
+public:
+  // A snapshot of each database, indexed by database number.
+  using SnapshotT = std::vector<Cache::SnapshotT>;
+
+  AppendOnlyFile(std::filesystem::path path, AppendFsync fsync_policy,
+                 std::uint32_t auto_rewrite_percentage = 0,
+                 std::uint64_t auto_rewrite_min_size = 0);
+  AppendOnlyFile(const AppendOnlyFile &other) = delete;
+  AppendOnlyFile &operator=(const AppendOnlyFile &other) = delete;
+  AppendOnlyFile(AppendOnlyFile &&other) = delete;
+  AppendOnlyFile &operator=(AppendOnlyFile &&other) = delete;
+  // Flushes and fsyncs anything still buffered.
+  ~AppendOnlyFile();
+
+  [[nodiscard]] bool is_open() const;
+
+  // Buffers the command (run against the given database) and returns the
+  // offset right after it, to be passed to wait_until_durable(). This never
+  // does any IO itself.
+  std::uint64_t append(std::size_t db_index, const Command &command);
+
+  // Under the "always" policy, blocks until everything up to the given offset
+  // has been written and fsync'ed. Returns immediately under other policies.
+  void wait_until_durable(std::uint64_t offset);
+
+  // Writes out and fsyncs everything buffered so far, regardless of policy.
+  void flush();
+
+  // Starts rewriting the file in the background from the given snapshot of the
+  // dataset. Returns false if a rewrite is already in progress.
+  // NOTE: take the snapshot while holding the same lock that orders writes
+  // with append(), so no write falls between the snapshot and the point where
+  // the rewrite starts buffering new commands.
+  bool start_rewrite(SnapshotT snapshot);
+  [[nodiscard]] bool is_rewrite_in_progress();
+  // Blocks until the rewrite in progress (if any) has finished.
+  void wait_for_rewrite();
+  // Whether the file has grown enough since the last rewrite (or since it was
+  // opened) that it should be rewritten automatically.
+  [[nodiscard]] bool should_auto_rewrite() const;
+  [[nodiscard]] std::uint64_t file_size() const;
+
+private:
+  // Writes the pending buffer to the file (and fsyncs it if asked). Must be
+  // called with the lock held, which is released for the duration of the IO.
+  void write_buffer(std::unique_lock<std::mutex> &lock, bool fsync);
+  void background_flush_loop(const std::stop_token &stop_token);
+  void rewrite(const std::stop_token &stop_token, const SnapshotT &snapshot);
+  // Swaps in the fully-written rewritten file. Called with the lock held.
+  bool finish_rewrite(int new_fd, const std::filesystem::path &new_path);
+
+  std::filesystem::path path_;
+  AppendFsync fsync_policy_;
+  std::uint32_t auto_rewrite_percentage_;
+  std::uint64_t auto_rewrite_min_size_;
+  // Changes when a rewrite swaps in the new file.
+  std::atomic<int> fd_ = -1;
+  // The size of the file right after it was opened or last rewritten, and its
+  // current size. These drive the automatic rewrites.
+  std::atomic<std::uint64_t> base_size_ = 0;
+  std::atomic<std::uint64_t> current_size_ = 0;
+
+  // Protects everything below.
+  std::mutex mutex_;
+  // Signalled when the buffer fills up, and whenever a write completes.
+  std::condition_variable_any condition_;
+  std::string buffer_;
+  // Offsets count the bytes appended since the file was opened.
+  std::uint64_t appended_offset_ = 0;
+  std::uint64_t written_offset_ = 0;
+  // Only one thread writes to the file at a time.
+  bool write_in_progress_ = false;
+  // Atomic so should_auto_rewrite() can check it without taking the lock.
+  std::atomic<bool> rewrite_in_progress_ = false;
+  // Commands appended since the current rewrite started.
+  std::string rewrite_buffer_;
+  // The database selected by the last command in the file (unknown until we
+  // log our first SELECT), and by the last command in the rewrite buffer.
+  std::optional<std::size_t> selected_db_;
+  std::size_t rewrite_selected_db_ = 0;
+
+  // Declared last so they stop before the members they use are destroyed.
+  std::jthread rewriter_;
+  std::jthread flusher_;
+};
+
+// Returns the path of the append-only file given in the config.
+std::filesystem::path aof_path(const Config &config);
+
+// Replays every command in the append-only file into the databases. If the
+// file ends with a partially-written command (e.g. we crashed mid-write), the
+// file is truncated to the last complete command. Returns false if there is no
+// file to load. The progress (if given) is kept up to date along the way.
+bool load_aof(const std::filesystem::path &path, const Config &config,
+              std::span<Cache> databases,
+              LoadingProgress *progress = nullptr);
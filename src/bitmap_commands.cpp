@@ -0,0 +1,362 @@
+// This source file's own header include.
+#include "bitmap_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "bitops.hpp"
+#include "cache.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// Like Redis's default proto-max-bulk-len, bitmaps are at most 512 MB.
+constexpr std::int64_t MAX_BIT_OFFSET = (std::int64_t{512} << 23) - 1;
+
+constexpr auto BIT_OFFSET_ERROR =
+    "ERR bit offset is not an integer or out of range";
+constexpr auto BIT_VALUE_ERROR = "ERR bit is not an integer or out of range";
+constexpr auto BIT_ARGUMENT_ERROR = "ERR The bit argument must be 1 or 0.";
+constexpr auto BITOP_NOT_ERROR =
+    "ERR BITOP NOT must be called with a single source key.";
+constexpr auto SYNTAX_ERROR = "ERR syntax error";
+
+// The byte holding the bit, and the mask of the bit within it. Bit 0 is the
+// most significant bit of the first byte, like in Redis.
+std::pair<std::size_t, unsigned char> locate_bit(std::uint64_t offset) {
+  return {offset / 8, static_cast<unsigned char>(0x80U >> (offset % 8))};
+}
+
+std::optional<std::uint64_t> parse_bit_offset(const std::string &str) {
+  const auto offset = parse_canonical_int(str);
+  if (!offset || *offset < 0 || *offset > MAX_BIT_OFFSET) {
+    return std::nullopt;
+  }
+  return static_cast<std::uint64_t>(*offset);
+}
+
+// Resolves the inclusive start and end of a BITCOUNT or BITPOS range over
+// length units (counting from the end if negative), or nullopt if it is
+// empty.
+std::optional<std::pair<std::uint64_t, std::uint64_t>>
+resolve_range(std::int64_t start, std::int64_t end, std::uint64_t length) {
+  const auto signed_length = static_cast<std::int64_t>(length);
+  if (start < 0) {
+    start = std::max<std::int64_t>(start + signed_length, 0);
+  }
+  if (end < 0) {
+    end = std::max<std::int64_t>(end + signed_length, 0);
+  }
+  end = std::min(end, signed_length - 1);
+  if (start > end) {
+    return std::nullopt;
+  }
+  return std::pair{static_cast<std::uint64_t>(start),
+                   static_cast<std::uint64_t>(end)};
+}
+
+// The mask of the bits of a byte from the first to the last (inclusive,
+// counting from the most significant bit).
+unsigned char bits_between(std::uint64_t first, std::uint64_t last) {
+  return static_cast<unsigned char>((0xFFU >> first) &
+                                    (0xFFU << (7 - last)));
+}
+
+// Counts the set bits between the first and last bit (inclusive). Whole bytes
+// go through popcount(), only the bytes at the edges are masked.
+std::uint64_t count_bits(std::string_view bitmap, std::uint64_t first,
+                         std::uint64_t last) {
+  const auto first_byte = first / 8;
+  const auto last_byte = last / 8;
+  const auto byte_at = [&bitmap](std::uint64_t index) {
+    return static_cast<unsigned char>(bitmap[index]);
+  };
+  if (first_byte == last_byte) {
+    return static_cast<std::uint64_t>(std::popcount(static_cast<unsigned char>(
+        byte_at(first_byte) & bits_between(first % 8, last % 8))));
+  }
+  return static_cast<std::uint64_t>(std::popcount(static_cast<unsigned char>(
+             byte_at(first_byte) & bits_between(first % 8, 7)))) +
+         popcount(bitmap.substr(first_byte + 1, last_byte - first_byte - 1)) +
+         static_cast<std::uint64_t>(std::popcount(static_cast<unsigned char>(
+             byte_at(last_byte) & bits_between(0, last % 8))));
+}
+
+// The first bit set to bit between the first and last bit (inclusive), or
+// nullopt if there is none. Whole bytes that can't hold it are skipped 8 at a
+// time.
+std::optional<std::uint64_t> find_bit(std::string_view bitmap, bool bit,
+                                      std::uint64_t first,
+                                      std::uint64_t last) {
+  // Bytes with none of the wanted bits.
+  const std::uint64_t skip_word = bit ? 0 : ~std::uint64_t{0};
+  auto byte = first / 8;
+  const auto last_byte = last / 8;
+  while (byte <= last_byte) {
+    if (byte + 8 <= last_byte) {
+      std::uint64_t word = 0;
+      std::memcpy(&word, bitmap.data() + byte, sizeof(word));
+      if (word == skip_word) {
+        byte += 8;
+        continue;
+      }
+    }
+    auto value = static_cast<unsigned char>(bitmap[byte]);
+    if (!bit) {
+      value = static_cast<unsigned char>(~value);
+    }
+    value &= bits_between(byte == first / 8 ? first % 8 : 0,
+                          byte == last_byte ? last % 8 : 7);
+    if (value != 0) {
+      return (byte * 8) + static_cast<std::uint64_t>(std::countl_zero(value));
+    }
+    ++byte;
+  }
+  return std::nullopt;
+}
+
+Message integer_reply(std::int64_t value) {
+  return Message{std::to_string(value), DataType::Integer};
+}
+
+// Calls func(bitmap) with the string stored at the key, or replies with
+// missing_reply if there is none.
+template <typename Func>
+Message read_bitmap(const Cache &cache, const std::string &key,
+                    const Message &missing_reply, Func &&func) {
+  return cache.read(key, [&](const Value *value) {
+    if (value == nullptr) {
+      return missing_reply;
+    }
+    const auto *bitmap = std::get_if<std::string>(value);
+    if (bitmap == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return func(std::string_view(*bitmap));
+  });
+}
+
+// SETBIT key offset value
+Message set_bit(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  const auto offset = parse_bit_offset(args[1]);
+  if (!offset) {
+    return Message{BIT_OFFSET_ERROR, DataType::SimpleError};
+  }
+  if (args[2] != "0" && args[2] != "1") {
+    return Message{BIT_VALUE_ERROR, DataType::SimpleError};
+  }
+  const bool bit = args[2] == "1";
+  return cache.update(args.front(), [&](std::optional<Value> &value) {
+    if (!value) {
+      value = std::string{};
+    }
+    auto *bitmap = std::get_if<std::string>(&*value);
+    if (bitmap == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    const auto [byte, mask] = locate_bit(*offset);
+    if (byte >= bitmap->size()) {
+      bitmap->resize(byte + 1, '\0');
+    }
+    auto &target = (*bitmap)[byte];
+    const bool old_bit = (static_cast<unsigned char>(target) & mask) != 0;
+    target = static_cast<char>(bit ? (target | mask) : (target & ~mask));
+    return integer_reply(old_bit ? 1 : 0);
+  });
+}
+
+// GETBIT key offset
+Message get_bit(const Command &command, const Cache &cache) {
+  const auto offset = parse_bit_offset(command.arguments[1]);
+  if (!offset) {
+    return Message{BIT_OFFSET_ERROR, DataType::SimpleError};
+  }
+  return read_bitmap(cache, command.arguments.front(), integer_reply(0),
+                     [&offset](std::string_view bitmap) {
+                       const auto [byte, mask] = locate_bit(*offset);
+                       const bool bit =
+                           byte < bitmap.size() &&
+                           (static_cast<unsigned char>(bitmap[byte]) & mask) !=
+                               0;
+                       return integer_reply(bit ? 1 : 0);
+                     });
+}
+
+// Parses the optional BYTE or BIT unit of BITCOUNT and BITPOS. Returns
+// whether the range is in bits, or nullopt on a syntax error.
+std::optional<bool> parse_unit(const std::vector<std::string> &args,
+                               std::size_t index) {
+  if (index >= args.size()) {
+    return false;
+  }
+  const auto unit = tolower(args[index]);
+  if (index + 1 != args.size() || (unit != "byte" && unit != "bit")) {
+    return std::nullopt;
+  }
+  return unit == "bit";
+}
+
+// BITCOUNT key [start end [BYTE | BIT]]
+Message bit_count(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  std::int64_t start = 0;
+  std::int64_t end = -1;
+  const auto in_bits = parse_unit(args, 3);
+  if (args.size() == 2 || !in_bits) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  if (args.size() > 1) {
+    const auto parsed_start = parse_canonical_int(args[1]);
+    const auto parsed_end = parse_canonical_int(args[2]);
+    if (!parsed_start || !parsed_end) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    start = *parsed_start;
+    end = *parsed_end;
+  }
+  return read_bitmap(
+      cache, args.front(), integer_reply(0), [&](std::string_view bitmap) {
+        const auto unit = *in_bits ? 1 : 8;
+        const auto range = resolve_range(start, end, bitmap.size() * 8 / unit);
+        if (!range) {
+          return integer_reply(0);
+        }
+        return integer_reply(static_cast<std::int64_t>(count_bits(
+            bitmap, range->first * unit, (range->second * unit) + unit - 1)));
+      });
+}
+
+// BITPOS key bit [start [end [BYTE | BIT]]]
+Message bit_position(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  if (args[1] != "0" && args[1] != "1") {
+    return Message{BIT_ARGUMENT_ERROR, DataType::SimpleError};
+  }
+  const bool bit = args[1] == "1";
+  std::int64_t start = 0;
+  std::int64_t end = -1;
+  const bool end_given = args.size() > 3;
+  const auto in_bits = parse_unit(args, 4);
+  if (!in_bits) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  for (std::size_t i = 2; i < std::min<std::size_t>(args.size(), 4); ++i) {
+    const auto parsed = parse_canonical_int(args[i]);
+    if (!parsed) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    (i == 2 ? start : end) = *parsed;
+  }
+  // Looking for a clear bit in a missing key finds the first one.
+  return read_bitmap(
+      cache, args.front(), integer_reply(bit ? -1 : 0),
+      [&](std::string_view bitmap) {
+        const auto unit = *in_bits ? 1 : 8;
+        const auto range = resolve_range(start, end, bitmap.size() * 8 / unit);
+        if (!range) {
+          return integer_reply(-1);
+        }
+        const auto first = range->first * unit;
+        const auto last = (range->second * unit) + unit - 1;
+        if (const auto found = find_bit(bitmap, bit, first, last)) {
+          return integer_reply(static_cast<std::int64_t>(*found));
+        }
+        // Without an end, the string counts as padded with clear bits.
+        if (!bit && !end_given) {
+          return integer_reply(static_cast<std::int64_t>(bitmap.size() * 8));
+        }
+        return integer_reply(-1);
+      });
+}
+
+// BITOP AND|OR|XOR|NOT destkey key [key ...]
+Message bit_operation(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  const auto name = tolower(args.front());
+  BitOp op{};
+  if (name == "and") {
+    op = BitOp::And;
+  } else if (name == "or") {
+    op = BitOp::Or;
+  } else if (name == "xor") {
+    op = BitOp::Xor;
+  } else if (name == "not") {
+    op = BitOp::Not;
+  } else {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  if (op == BitOp::Not && args.size() != 3) {
+    return Message{BITOP_NOT_ERROR, DataType::SimpleError};
+  }
+  return cache.store(
+      args[1], std::span(args).subspan(2),
+      [op](const std::vector<const Value *> &values,
+           std::optional<std::optional<Value>> &result) {
+        std::vector<std::string_view> sources{};
+        std::size_t length = 0;
+        for (const auto *value : values) {
+          if (value == nullptr) {
+            sources.emplace_back();
+            continue;
+          }
+          const auto *bitmap = std::get_if<std::string>(value);
+          if (bitmap == nullptr) {
+            return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+          }
+          sources.emplace_back(*bitmap);
+          length = std::max(length, bitmap->size());
+        }
+        // Shorter strings count as padded with zero bytes.
+        std::string combined(length, '\0');
+        std::ranges::copy(sources.front(), combined.begin());
+        if (op == BitOp::Not) {
+          bitwise(op, combined.data(), combined);
+        }
+        for (auto source = sources.cbegin() + 1; source != sources.cend();
+             ++source) {
+          bitwise(op, combined.data(), *source);
+          if (op == BitOp::And) {
+            std::fill(combined.begin() +
+                          static_cast<std::ptrdiff_t>(source->size()),
+                      combined.end(), '\0');
+          }
+        }
+        // An empty result removes the destination.
+        result.emplace();
+        if (!combined.empty()) {
+          result->emplace(std::move(combined));
+        }
+        return integer_reply(static_cast<std::int64_t>(length));
+      });
+}
+
+} // namespace
+
+std::optional<Message> handle_bitmap_command(const Command &command,
+                                             Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::SetBit:
+    return set_bit(command, cache);
+  case CommandVerb::GetBit:
+    return get_bit(command, cache);
+  case CommandVerb::BitCount:
+    return bit_count(command, cache);
+  case CommandVerb::BitPos:
+    return bit_position(command, cache);
+  case CommandVerb::BitOp:
+    return bit_operation(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
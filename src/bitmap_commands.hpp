@@ -0,0 +1,16 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the bitmap commands (SETBIT, GETBIT, BITCOUNT, BITPOS and BITOP),
+// which treat string values as arrays of bits, and returns the reply, or
+// nullopt for any other command.
+std::optional<Message> handle_bitmap_command(const Command &command,
+                                             Cache &cache);
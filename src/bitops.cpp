@@ -0,0 +1,253 @@
+// This source file's own header include.
+#include "bitops.hpp"
+
+// System includes.
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BITOPS_HAVE_AVX2 1
+#endif
+
+namespace {
+
+constexpr std::size_t WORD_SIZE = sizeof(std::uint64_t);
+
+std::uint64_t load_word(const char *data) {
+  std::uint64_t word = 0;
+  std::memcpy(&word, data, WORD_SIZE);
+  return word;
+}
+
+void store_word(char *data, std::uint64_t word) {
+  std::memcpy(data, &word, WORD_SIZE);
+}
+
+std::uint64_t combine(BitOp op, std::uint64_t dest, std::uint64_t source) {
+  switch (op) {
+  case BitOp::And:
+    return dest & source;
+  case BitOp::Or:
+    return dest | source;
+  case BitOp::Xor:
+    return dest ^ source;
+  default:
+    return ~source;
+  }
+}
+
+std::uint64_t popcount_words(const char *data, std::size_t len) {
+  std::uint64_t count = 0;
+  std::size_t i = 0;
+  for (; i + WORD_SIZE <= len; i += WORD_SIZE) {
+    count += static_cast<std::uint64_t>(std::popcount(load_word(data + i)));
+  }
+  for (; i < len; ++i) {
+    count += static_cast<std::uint64_t>(
+        std::popcount(static_cast<unsigned char>(data[i])));
+  }
+  return count;
+}
+
+#ifdef BITOPS_HAVE_AVX2
+// The same loop, compiled to use the POPCNT instruction.
+__attribute__((target("popcnt"))) std::uint64_t
+popcount_words_popcnt(const char *data, std::size_t len) {
+  return popcount_words(data, len);
+}
+
+bool has_popcnt() {
+  static const bool supported = __builtin_cpu_supports("popcnt");
+  return supported;
+}
+
+__attribute__((target("avx2"))) inline __m256i load_vector(const char *data) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+}
+
+__attribute__((target("avx2"))) inline void store_vector(char *data,
+                                                         __m256i vector) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), vector);
+}
+
+// The bit counts of each of the four 64-bit lanes, found by looking up each
+// nibble's count in a table.
+__attribute__((target("avx2"))) inline __m256i count_lanes(__m256i vector) {
+  const auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3,
+                                      3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3,
+                                      2, 3, 3, 4);
+  const auto low_mask = _mm256_set1_epi8(0x0F);
+  const auto low = _mm256_and_si256(vector, low_mask);
+  const auto high = _mm256_and_si256(_mm256_srli_epi16(vector, 4), low_mask);
+  const auto counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, low),
+                                      _mm256_shuffle_epi8(table, high));
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+// A carry-save adder: adds a, b and c bitwise into high (the carries) and
+// low (the sums).
+__attribute__((target("avx2"))) inline void
+carry_save_add(__m256i &high, __m256i &low, __m256i a, __m256i b, __m256i c) {
+  const auto a_xor_b = _mm256_xor_si256(a, b);
+  high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(a_xor_b, c));
+  low = _mm256_xor_si256(a_xor_b, c);
+}
+
+__attribute__((target("avx2"))) std::uint64_t
+popcount_avx2_impl(const char *data, std::size_t len) {
+  constexpr std::size_t VECTOR_SIZE = 32;
+  constexpr std::size_t STEP = 16 * VECTOR_SIZE;
+  auto total = _mm256_setzero_si256();
+  auto ones = _mm256_setzero_si256();
+  auto twos = _mm256_setzero_si256();
+  auto fours = _mm256_setzero_si256();
+  auto eights = _mm256_setzero_si256();
+  __m256i sixteens{};
+  __m256i twos_a{};
+  __m256i twos_b{};
+  __m256i fours_a{};
+  __m256i fours_b{};
+  __m256i eights_a{};
+  __m256i eights_b{};
+  std::size_t i = 0;
+  for (; i + STEP <= len; i += STEP) {
+    const char *block = data + i;
+    carry_save_add(twos_a, ones, ones, load_vector(block),
+                   load_vector(block + 32));
+    carry_save_add(twos_b, ones, ones, load_vector(block + 64),
+                   load_vector(block + 96));
+    carry_save_add(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add(twos_a, ones, ones, load_vector(block + 128),
+                   load_vector(block + 160));
+    carry_save_add(twos_b, ones, ones, load_vector(block + 192),
+                   load_vector(block + 224));
+    carry_save_add(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add(eights_a, fours, fours, fours_a, fours_b);
+    carry_save_add(twos_a, ones, ones, load_vector(block + 256),
+                   load_vector(block + 288));
+    carry_save_add(twos_b, ones, ones, load_vector(block + 320),
+                   load_vector(block + 352));
+    carry_save_add(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add(twos_a, ones, ones, load_vector(block + 384),
+                   load_vector(block + 416));
+    carry_save_add(twos_b, ones, ones, load_vector(block + 448),
+                   load_vector(block + 480));
+    carry_save_add(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add(eights_b, fours, fours, fours_a, fours_b);
+    carry_save_add(sixteens, eights, eights, eights_a, eights_b);
+    total = _mm256_add_epi64(total, count_lanes(sixteens));
+  }
+  // Each bit left in eights is worth 8, in fours 4 and so on.
+  total = _mm256_slli_epi64(total, 4);
+  total = _mm256_add_epi64(total,
+                           _mm256_slli_epi64(count_lanes(eights), 3));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(count_lanes(fours), 2));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(count_lanes(twos), 1));
+  total = _mm256_add_epi64(total, count_lanes(ones));
+  for (; i + VECTOR_SIZE <= len; i += VECTOR_SIZE) {
+    total = _mm256_add_epi64(total, count_lanes(load_vector(data + i)));
+  }
+  const auto count =
+      static_cast<std::uint64_t>(_mm256_extract_epi64(total, 0)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(total, 1)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(total, 2)) +
+      static_cast<std::uint64_t>(_mm256_extract_epi64(total, 3));
+  return count + popcount_words_popcnt(data + i, len - i);
+}
+
+__attribute__((target("avx2"))) __m256i apply(BitOp op, __m256i dest,
+                                               __m256i source) {
+  switch (op) {
+  case BitOp::And:
+    return _mm256_and_si256(dest, source);
+  case BitOp::Or:
+    return _mm256_or_si256(dest, source);
+  case BitOp::Xor:
+    return _mm256_xor_si256(dest, source);
+  default:
+    return _mm256_xor_si256(source, _mm256_set1_epi8(-1));
+  }
+}
+
+__attribute__((target("avx2"))) void
+bitwise_avx2_impl(BitOp op, char *dest, const char *source, std::size_t len) {
+  constexpr std::size_t VECTOR_SIZE = 32;
+  constexpr std::size_t BLOCK_SIZE = 2 * VECTOR_SIZE;
+  std::size_t i = 0;
+  for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE) {
+    const auto first =
+        apply(op, load_vector(dest + i), load_vector(source + i));
+    const auto second = apply(op, load_vector(dest + i + VECTOR_SIZE),
+                              load_vector(source + i + VECTOR_SIZE));
+    store_vector(dest + i, first);
+    store_vector(dest + i + VECTOR_SIZE, second);
+  }
+  bitwise_portable(op, dest + i, std::string_view(source + i, len - i));
+}
+#endif
+
+} // namespace
+
+std::uint64_t popcount(std::string_view data) {
+  return popcount_avx2(data);
+}
+
+std::uint64_t popcount_portable(std::string_view data) {
+#ifdef BITOPS_HAVE_AVX2
+  if (has_popcnt()) {
+    return popcount_words_popcnt(data.data(), data.size());
+  }
+#endif
+  return popcount_words(data.data(), data.size());
+}
+
+std::uint64_t popcount_avx2(std::string_view data) {
+#ifdef BITOPS_HAVE_AVX2
+  if (has_bitops_avx2()) {
+    return popcount_avx2_impl(data.data(), data.size());
+  }
+#endif
+  return popcount_portable(data);
+}
+
+bool has_bitops_avx2() {
+#ifdef BITOPS_HAVE_AVX2
+  // The tail of popcount_avx2() uses POPCNT, which every AVX2 CPU has.
+  static const bool supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void bitwise(BitOp op, char *dest, std::string_view source) {
+  bitwise_avx2(op, dest, source);
+}
+
+void bitwise_portable(BitOp op, char *dest, std::string_view source) {
+  const auto *data = source.data();
+  const auto len = source.size();
+  std::size_t i = 0;
+  for (; i + WORD_SIZE <= len; i += WORD_SIZE) {
+    store_word(dest + i, combine(op, load_word(dest + i), load_word(data + i)));
+  }
+  for (; i < len; ++i) {
+    dest[i] = static_cast<char>(combine(
+        op, static_cast<unsigned char>(dest[i]),
+        static_cast<unsigned char>(data[i])));
+  }
+}
+
+void bitwise_avx2(BitOp op, char *dest, std::string_view source) {
+#ifdef BITOPS_HAVE_AVX2
+  if (has_bitops_avx2()) {
+    bitwise_avx2_impl(op, dest, source.data(), source.size());
+    return;
+  }
+#endif
+  bitwise_portable(op, dest, source);
+}
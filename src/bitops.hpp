@@ -0,0 +1,45 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// The kernels behind the bitmap commands, which scan or combine whole string
+// values. Like crc64(), each comes in a portable version and an AVX2 version
+// that is picked at runtime when the CPU supports it.
+
+// Counts the set bits using the fastest implementation the CPU supports.
+std::uint64_t popcount(std::string_view data);
+
+// Counts 8 bytes at a time with the POPCNT instruction where available (or
+// the compiler's portable fallback elsewhere).
+std::uint64_t popcount_portable(std::string_view data);
+
+// Harley-Seal popcount over 512 bytes per step with AVX2, which carries the
+// bits through a tree of carry-save adders so only one in 16 vectors needs a
+// full count. See https://arxiv.org/abs/1611.07612. Falls back to the
+// portable version when the CPU lacks AVX2, so it is always safe to call.
+std::uint64_t popcount_avx2(std::string_view data);
+
+// Whether popcount_avx2() and bitwise_avx2() can use AVX2 on this CPU.
+bool has_bitops_avx2();
+
+enum class BitOp : std::uint8_t {
+  And,
+  Or,
+  Xor,
+  // Ignores what dest holds, and writes the inverted source into it.
+  Not,
+};
+
+// Combines source into the first source.size() bytes of dest in place (dest
+// = dest op source), using the fastest implementation the CPU supports.
+void bitwise(BitOp op, char *dest, std::string_view source);
+
+// 8 bytes at a time.
+void bitwise_portable(BitOp op, char *dest, std::string_view source);
+
+// 64 bytes at a time with AVX2, falling back to the portable version when the
+// CPU lacks it.
+void bitwise_avx2(BitOp op, char *dest, std::string_view source);
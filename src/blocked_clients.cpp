@@ -0,0 +1,158 @@
+// This source file's own header include.
+#include "blocked_clients.hpp"
+
+// System includes.
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <limits>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+
+BlockedClients::BlockedClients()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = 0;
+  if (epoll_fd_ < 0 || wake_fd_ < 0 ||
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0) {
+    std::cerr << "Failed to set up waiting on blocked clients: "
+              << std::system_category().message(errno) << std::endl;
+    std::terminate();
+  }
+}
+
+BlockedClients::~BlockedClients() {
+  for (const auto &[id, entry] : clients_) {
+    close(static_cast<int>(entry.client.fd));
+  }
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+BlockedClients::Id BlockedClients::block(BlockedClient client) {
+  const Id id = next_id_++;
+  // Waiting on the same key twice would only get the client served twice.
+  std::vector<std::string> keys{};
+  for (auto &key : client.keys) {
+    if (std::ranges::find(keys, key) == keys.end()) {
+      keys.push_back(std::move(key));
+    }
+  }
+  client.keys = std::move(keys);
+
+  Entry entry{std::move(client), {}};
+  entry.positions.reserve(entry.client.keys.size());
+  for (const auto &key : entry.client.keys) {
+    auto &queue = queues_[Key{entry.client.state.db_index, key}];
+    entry.positions.push_back(queue.insert(queue.end(), id));
+  }
+  if (entry.client.deadline) {
+    deadlines_.emplace(*entry.client.deadline, id);
+  }
+  // Only hanging up matters, whatever the client sends in the meantime waits
+  // in the socket until it is unblocked.
+  epoll_event event{};
+  event.events = EPOLLRDHUP;
+  event.data.u64 = id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, static_cast<int>(entry.client.fd),
+            &event);
+  clients_.emplace(id, std::move(entry));
+  ++num_clients_;
+  return id;
+}
+
+std::optional<BlockedClient> BlockedClients::unblock(Id id) {
+  auto node = clients_.extract(id);
+  if (node.empty()) {
+    return std::nullopt;
+  }
+  --num_clients_;
+  auto &[client, positions] = node.mapped();
+  for (std::size_t i = 0; i < client.keys.size(); ++i) {
+    const auto queue =
+        queues_.find(Key{client.state.db_index, client.keys[i]});
+    queue->second.erase(positions[i]);
+    if (queue->second.empty()) {
+      queues_.erase(queue);
+    }
+  }
+  if (client.deadline) {
+    deadlines_.erase({*client.deadline, id});
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, static_cast<int>(client.fd), nullptr);
+  return std::move(client);
+}
+
+const BlockedClient *BlockedClients::find(Id id) const {
+  const auto entry = clients_.find(id);
+  return entry == clients_.end() ? nullptr : &entry->second.client;
+}
+
+std::vector<BlockedClients::Id>
+BlockedClients::waiting_on(std::size_t db_index,
+                           const std::string &key) const {
+  const auto queue = queues_.find(Key{db_index, key});
+  if (queue == queues_.end()) {
+    return {};
+  }
+  return {queue->second.begin(), queue->second.end()};
+}
+
+std::vector<BlockedClients::Id>
+BlockedClients::timed_out(Clock::time_point now) const {
+  std::vector<Id> ids{};
+  for (const auto &[deadline, id] : deadlines_) {
+    if (deadline > now) {
+      break;
+    }
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+std::optional<BlockedClients::Clock::time_point>
+BlockedClients::next_deadline() const {
+  if (deadlines_.empty()) {
+    return std::nullopt;
+  }
+  return deadlines_.begin()->first;
+}
+
+std::vector<BlockedClients::Id>
+BlockedClients::wait(std::optional<Clock::time_point> until) {
+  int timeout_ms = -1;
+  if (until) {
+    // Rounded up, so we never wake up just before the deadline.
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+        *until - Clock::now());
+    timeout_ms = static_cast<int>(std::clamp<std::int64_t>(
+        remaining.count(), 0, std::numeric_limits<int>::max()));
+  }
+  constexpr int MAX_EVENTS = 64;
+  std::array<epoll_event, MAX_EVENTS> events{};
+  const int num_events =
+      epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, timeout_ms);
+  std::vector<Id> hung_up{};
+  for (int i = 0; i < num_events; ++i) {
+    const auto &event = events[static_cast<std::size_t>(i)];
+    if (event.data.u64 == 0) {
+      std::uint64_t count = 0;
+      [[maybe_unused]] const auto bytes_read =
+          read(wake_fd_, &count, sizeof(count));
+    } else {
+      hung_up.push_back(event.data.u64);
+    }
+  }
+  return hung_up;
+}
+
+void BlockedClients::wake() {
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto bytes_written =
+      write(wake_fd_, &one, sizeof(one));
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "network.hpp"
+#include "protocol.hpp"
+#include "redis_core.hpp"
+
+// A client waiting for a blocking command (BLPOP, BRPOP or XREAD with BLOCK)
+// to have something to reply with.
+struct BlockedClient {
+  SocketFd fd;
+  ClientState state;
+  // Retried whenever one of the keys may have become ready.
+  Command command;
+  std::vector<std::string> keys;
+  // Unset if it waits forever.
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+// The clients blocked on keys. None of them holds a thread while it waits:
+// each costs a place in the queue of every key it waits on, a timer if it has
+// a timeout, and an epoll registration of its socket, which is only watched
+// for the client hanging up. The queues are FIFO, like in Redis, so the client
+// that blocked first is served first.
+// Not thread-safe, apart from wait(), wake() and size(), which may run while
+// another thread uses the rest.
+class BlockedClients {
+public:
+  using Id = std::uint64_t;
+  using Clock = std::chrono::steady_clock;
+
+  BlockedClients();
+  BlockedClients(const BlockedClients &other) = delete;
+  BlockedClients &operator=(const BlockedClients &other) = delete;
+  BlockedClients(BlockedClients &&other) = delete;
+  BlockedClients &operator=(BlockedClients &&other) = delete;
+  // Closes the sockets of the clients still blocked.
+  ~BlockedClients();
+
+  // Blocks the client (whose socket it now owns) until unblock() is called
+  // with the returned ID.
+  Id block(BlockedClient client);
+  // Hands the client (and its socket) back, or nullopt if it isn't blocked.
+  std::optional<BlockedClient> unblock(Id id);
+
+  // The client blocked with the ID, or nullptr if there is none.
+  [[nodiscard]] const BlockedClient *find(Id id) const;
+  // The clients blocked on the key of the database, in the order they blocked.
+  [[nodiscard]] std::vector<Id> waiting_on(std::size_t db_index,
+                                           const std::string &key) const;
+  // The clients whose deadline is at or before now, earliest first.
+  [[nodiscard]] std::vector<Id> timed_out(Clock::time_point now) const;
+  [[nodiscard]] std::optional<Clock::time_point> next_deadline() const;
+  [[nodiscard]] std::size_t size() const { return num_clients_; }
+
+  // Waits until a client hangs up, wake() is called, or until (if set)
+  // passes. Returns the IDs of the clients that hung up, which the caller
+  // should unblock (unless someone else already did).
+  std::vector<Id> wait(std::optional<Clock::time_point> until);
+  // Makes wait() return early, e.g. so it notices a new earlier deadline.
+  void wake();
+
+private:
+  // A database index and a key.
+  using Key = std::pair<std::size_t, std::string>;
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const {
+      return std::hash<std::string>{}(key.second) ^
+             (key.first * 0x9E3779B97F4A7C15ULL);
+    }
+  };
+  using Queue = std::list<Id>;
+
+  struct Entry {
+    BlockedClient client;
+    // Where the client is in the queue of each of its keys, so unblocking it
+    // doesn't search them.
+    std::vector<Queue::iterator> positions;
+  };
+
+  int epoll_fd_ = -1;
+  // An eventfd that wake() writes to, which is registered with ID 0.
+  int wake_fd_ = -1;
+  Id next_id_ = 1;
+  std::unordered_map<Id, Entry> clients_;
+  // The size of clients_, which other threads may read.
+  std::atomic<std::size_t> num_clients_ = 0;
+  std::unordered_map<Key, Queue, KeyHash> queues_;
+  std::set<std::pair<Clock::time_point, Id>> deadlines_;
+};
@@ -4,6 +4,10 @@
 // System includes.
 #include <algorithm>
 #include <mutex>
+#include <utility>
+
+// Our library's header includes.
+#include "lazy_free.hpp"
 
 // TODO clean up any expired cache elements we try to access so we don't waste
 // time checking their expiry next time around.
@@ -20,11 +24,24 @@ std::optional<std::string> Cache::get(const std::string &key) const {
     if (!data.at(key).second.has_value() ||
         std::chrono::steady_clock::now() <= *data.at(key).second) {
       // Get the value for this key.
-      return data.at(key).first;
+      if (const auto *value = std::get_if<std::string>(&data.at(key).first)) {
+        return *value;
+      }
     }
   }
   return std::nullopt;
 }
+
+std::optional<ValueType> Cache::type(const std::string &key) const {
+  std::shared_lock lock(mutex);
+  const auto entry = data.find(key);
+  if (entry == data.end() || (entry->second.second.has_value() &&
+                              std::chrono::steady_clock::now() >
+                                  *entry->second.second)) {
+    return std::nullopt;
+  }
+  return value_type(entry->second.first);
+}
 void Cache::set(
     const std::string &key, const std::string &value,
     const std::optional<std::chrono::milliseconds> &expiry_duration) {
@@ -34,10 +51,73 @@ void Cache::set(
     // should expire after this much time from now).
     expiry_time = std::chrono::steady_clock::now() + expiry_duration.value();
   }
-  // Acquire a unique lock, blocking out every other read/write, because we're
-  // writing to the cache.
+  std::optional<ValueT> old_value{};
+  {
+    // Acquire a unique lock, blocking out every other read/write, because
+    // we're writing to the cache.
+    std::unique_lock lock(mutex);
+    auto [entry, inserted] = data.try_emplace(key);
+    if (!inserted) {
+      old_value = std::move(entry->second.first);
+    }
+    entry->second = {value, expiry_time};
+  }
+  // Free the replaced value only once the other clients can get going again.
+  if (old_value) {
+    dispose(std::move(*old_value), lazy_free_server_del());
+  }
+}
+
+bool Cache::remove(const std::string &key, bool lazy) {
+  std::optional<EntryT> removed{};
+  {
+    std::unique_lock lock(mutex);
+    auto node = data.extract(key);
+    if (node.empty()) {
+      return false;
+    }
+    removed = std::move(node.mapped());
+  }
+  const bool expired = removed->second.has_value() &&
+                       std::chrono::steady_clock::now() > *removed->second;
+  dispose(std::move(removed->first), lazy);
+  return !expired;
+}
+
+void Cache::dispose(ValueT value, bool lazy) {
+  if (lazy_free) {
+    lazy_free->dispose(std::move(value), lazy);
+  }
+  // Otherwise the value is freed as it goes out of scope here.
+}
+
+bool Cache::lazy_free_server_del() const {
+  return lazy_free && lazy_free->policy().lazy_server_del;
+}
+
+void Cache::insert(std::unordered_map<KeyT, EntryT> entries) {
+  std::unique_lock lock(mutex);
+  if (data.empty()) {
+    data = std::move(entries);
+    return;
+  }
+  for (auto &[key, entry] : entries) {
+    data.insert_or_assign(key, std::move(entry));
+  }
+}
+
+std::unordered_map<Cache::KeyT, Cache::EntryT> Cache::detach() {
   std::unique_lock lock(mutex);
-  data[key] = {value, expiry_time};
+  return std::exchange(data, {});
+}
+
+void Cache::swap(Cache &other) {
+  if (this == &other) {
+    return;
+  }
+  // Locks both without risking a deadlock with a swap the other way around.
+  std::scoped_lock lock(mutex, other.mutex);
+  data.swap(other.data);
 }
 
 std::vector<std::string> Cache::keys() const {
@@ -49,4 +129,17 @@ std::vector<std::string> Cache::keys() const {
   std::transform(data.cbegin(), data.cend(), std::back_inserter(keys),
                  [](const auto &cache_entry) { return cache_entry.first; });
   return keys;
-}
\ No newline at end of file
+}
+
+std::size_t Cache::size() const {
+  std::shared_lock lock(mutex);
+  return data.size();
+}
+
+Cache::SnapshotT Cache::snapshot() const {
+  SnapshotT entries{};
+  for_each([&entries](const KeyT &key, const EntryT &entry) {
+    entries.emplace_back(key, entry);
+  });
+  return entries;
+}
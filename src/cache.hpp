@@ -2,33 +2,199 @@
 
 // System includes.
 #include <chrono>
+#include <cstddef>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+// Our library's header includes.
+#include "value.hpp"
+
+class LazyFree;
+
 class Cache {
 public:
-  using ValueT = std::string;
+  using ValueT = Value;
   using ExpiryValueT = std::optional<std::chrono::steady_clock::time_point>;
   using EntryT = std::pair<ValueT, ExpiryValueT>;
   using KeyT = std::string;
+  using SnapshotT = std::vector<std::pair<KeyT, EntryT>>;
 
 private:
   // This mutex will protect the data map.
   mutable std::shared_mutex mutex;
   std::unordered_map<KeyT, EntryT> data;
+  // Where values removed from the cache get freed. Without one, they are
+  // freed right away (but never while holding the lock).
+  LazyFree *lazy_free = nullptr;
+
+  void dispose(ValueT value, bool lazy);
+  // Whether values overwritten by writes are freed in the background.
+  [[nodiscard]] bool lazy_free_server_del() const;
+  static bool is_expired(const EntryT &entry,
+                         std::chrono::steady_clock::time_point now =
+                             std::chrono::steady_clock::now()) {
+    return entry.second.has_value() && now > *entry.second;
+  }
 
 public:
   Cache() = default;
   explicit Cache(std::unordered_map<KeyT, EntryT> data_in)
       : data(std::move(data_in)) {}
 
+  void set_lazy_free(LazyFree *lazy_free_in) { lazy_free = lazy_free_in; }
+
   // TODO consider changing this to return a ref string for efficiency.
+  // Returns nullopt if the key is missing or holds something other than a
+  // string.
   std::optional<std::string> get(const std::string &key) const;
+  // The type of value the key holds, or nullopt if it is missing.
+  std::optional<ValueType> type(const std::string &key) const;
   void set(const std::string &key, const std::string &value,
            const std::optional<std::chrono::milliseconds> &expiry_duration =
                std::nullopt);
+  // Removes the key, freeing its value in the background if lazy is set (and
+  // the value is big enough). Returns false if the key was missing (or had
+  // already expired).
+  bool remove(const std::string &key, bool lazy);
   std::vector<std::string> keys() const;
+  // The number of entries, including any expired ones not yet removed.
+  std::size_t size() const;
+  // Adds all the given entries (keeping their expiry times as they are),
+  // overwriting any existing entries with the same keys. Used when loading.
+  void insert(std::unordered_map<KeyT, EntryT> entries);
+  // Removes every entry and hands them back, so the caller decides where they
+  // get freed. This itself is O(1).
+  std::unordered_map<KeyT, EntryT> detach();
+  // Exchanges the entries of the two caches in O(1).
+  void swap(Cache &other);
+
+  // Calls func(value) under a shared lock, where value points to the key's
+  // value, or is nullptr if the key is missing. Returns what func returns.
+  template <typename Func>
+  auto read(const std::string &key, Func &&func) const {
+    std::shared_lock lock(mutex);
+    const auto entry = data.find(key);
+    const ValueT *value = entry == data.end() || is_expired(entry->second)
+                              ? nullptr
+                              : &entry->second.first;
+    return func(value);
+  }
+
+  // Like read(), but func gets the whole entry (the value and its expiry
+  // time), or nullptr if the key is missing.
+  template <typename Func>
+  auto read_entry(const std::string &key, Func &&func) const {
+    std::shared_lock lock(mutex);
+    const auto entry = data.find(key);
+    const EntryT *found = entry == data.end() || is_expired(entry->second)
+                              ? nullptr
+                              : &entry->second;
+    return func(found);
+  }
+
+  // Like read(), but for several keys under the same shared lock, so func sees
+  // them all at one point in time. Calls func(values) with one pointer per key.
+  template <typename Func>
+  auto read_many(std::span<const std::string> keys, Func &&func) const {
+    std::shared_lock lock(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<const ValueT *> values{};
+    values.reserve(keys.size());
+    for (const auto &key : keys) {
+      const auto entry = data.find(key);
+      values.push_back(entry == data.end() || is_expired(entry->second, now)
+                           ? nullptr
+                           : &entry->second.first);
+    }
+    return func(values);
+  }
+
+  // Calls func(value) under the write lock, where value is an optional
+  // holding the key's value, or nullopt if the key is missing. Whatever func
+  // leaves in it is stored back (keeping the key's expiry time), and the key
+  // is removed if func leaves nullopt. Returns what func returns.
+  template <typename Func> auto update(const std::string &key, Func &&func) {
+    std::unique_lock lock(mutex);
+    auto entry = data.find(key);
+    const bool existed = entry != data.end() && !is_expired(entry->second);
+    std::optional<ValueT> value{};
+    if (existed) {
+      value = std::move(entry->second.first);
+    }
+    auto result = func(value);
+    if (!value) {
+      if (entry != data.end()) {
+        data.erase(entry);
+      }
+    } else if (existed) {
+      entry->second.first = std::move(*value);
+    } else {
+      data.insert_or_assign(key, EntryT{std::move(*value), std::nullopt});
+    }
+    return result;
+  }
+
+  // Calls func(values, result) under the write lock, where values holds one
+  // pointer per source key like read_many(). If func sets result, its value
+  // replaces the dest key (with no expiry time), or removes the dest key if
+  // it is nullopt. If func leaves result unset (e.g. on errors), the dest key
+  // is left alone. For commands that write what they compute from other keys
+  // (e.g. BITOP). Returns what func returns.
+  template <typename Func>
+  auto store(const std::string &dest, std::span<const std::string> sources,
+             Func &&func) {
+    std::optional<ValueT> old_value{};
+    std::optional<std::optional<ValueT>> result{};
+    auto reply = [&] {
+      std::unique_lock lock(mutex);
+      const auto now = std::chrono::steady_clock::now();
+      std::vector<const ValueT *> values{};
+      values.reserve(sources.size());
+      for (const auto &key : sources) {
+        const auto entry = data.find(key);
+        values.push_back(entry == data.end() || is_expired(entry->second, now)
+                             ? nullptr
+                             : &entry->second.first);
+      }
+      auto func_reply = func(values, result);
+      if (!result) {
+        return func_reply;
+      }
+      auto node = data.extract(dest);
+      if (!node.empty()) {
+        old_value = std::move(node.mapped().first);
+      }
+      if (*result) {
+        data.insert_or_assign(dest,
+                              EntryT{std::move(**result), std::nullopt});
+      }
+      return func_reply;
+    }();
+    // Free the replaced value only once the other clients can get going again.
+    if (old_value) {
+      dispose(std::move(*old_value), lazy_free_server_del());
+    }
+    return reply;
+  }
+
+  // Returns a copy of every unexpired entry, taken under a single shared lock
+  // so it is a consistent point-in-time view of the cache.
+  SnapshotT snapshot() const;
+
+  // Calls func(key, entry) on every unexpired entry while holding a shared
+  // lock, so writers wait until the whole walk is done.
+  template <typename Func> void for_each(Func &&func) const {
+    std::shared_lock lock(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto &[key, entry] : data) {
+      if (!entry.second.has_value() || now <= *entry.second) {
+        func(key, entry);
+      }
+    }
+  }
 };
\ No newline at end of file
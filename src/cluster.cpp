@@ -0,0 +1,530 @@
+// This source file's own header include.
+#include "cluster.hpp"
+
+// System includes.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+// Our library's header includes.
+#include "network.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// How long MEET waits on the other node.
+constexpr auto MEET_TIMEOUT = std::chrono::seconds(5);
+
+Message error(std::string message) {
+  return Message{std::move(message), DataType::SimpleError};
+}
+
+Message integer(std::size_t value) {
+  return Message{std::to_string(value), DataType::Integer};
+}
+
+std::optional<std::uint16_t> parse_slot(const std::string &arg) {
+  const auto slot = parse_canonical_int(arg);
+  if (!slot || *slot < 0 || static_cast<std::size_t>(*slot) >= CLUSTER_SLOTS) {
+    return std::nullopt;
+  }
+  return static_cast<std::uint16_t>(*slot);
+}
+
+const Message INVALID_SLOT_ERROR = error("ERR Invalid or out of range slot");
+
+std::size_t count_keys_in_slot(const Cache &cache, std::uint16_t slot) {
+  std::size_t count = 0;
+  cache.for_each([&count, slot](const auto &key, const auto &) {
+    count += key_hash_slot(key) == slot ? 1 : 0;
+  });
+  return count;
+}
+
+// One line of CLUSTER NODES per node: its ID, address, flags, the node it
+// replicates (always "-"), ping and pong times, config epoch, link state and
+// the slots it serves. Our own line also lists the slots being migrated.
+std::string describe_nodes(const ClusterState &cluster) {
+  const auto ranges = cluster.slot_ranges();
+  std::ostringstream out{};
+  for (std::size_t index = 0; index < cluster.num_nodes(); ++index) {
+    const auto node_index = static_cast<ClusterState::NodeIndex>(index);
+    const auto node = cluster.node(node_index);
+    out << node.id << " " << node.host << ":" << node.port << "@"
+        << node.port + 10000 << " "
+        << (node_index == ClusterState::MYSELF ? "myself,master" : "master")
+        << " - 0 0 0 connected";
+    for (const auto &range : ranges) {
+      if (range.node != node_index) {
+        continue;
+      }
+      out << " " << range.start;
+      if (range.end != range.start) {
+        out << "-" << range.end;
+      }
+    }
+    if (node_index == ClusterState::MYSELF) {
+      for (std::size_t slot = 0; slot < CLUSTER_SLOTS; ++slot) {
+        const auto slot16 = static_cast<std::uint16_t>(slot);
+        if (const auto to = cluster.migrating_to(slot16)) {
+          out << " [" << slot << "->-" << cluster.node(*to).id << "]";
+        }
+        if (const auto from = cluster.importing_from(slot16)) {
+          out << " [" << slot << "-<-" << cluster.node(*from).id << "]";
+        }
+      }
+    }
+    out << "\n";
+  }
+  return out.str();
+}
+
+// Connects to the node and learns its ID and the slots it serves from its
+// CLUSTER NODES. The slots we serve ourselves stay ours.
+Message meet(ClusterState &cluster, const std::string &host,
+             const std::string &port_arg) {
+  const auto port = parse_canonical_int(port_arg);
+  if (!port || *port <= 0 || *port > 65535) {
+    return error("ERR Invalid node address specified: " + host + ":" +
+                 port_arg);
+  }
+  const auto node_fd =
+      connect_to_server(host, static_cast<std::uint16_t>(*port));
+  if (!node_fd) {
+    return error("ERR Can't connect to node " + host + ":" + port_arg);
+  }
+  set_socket_timeout(*node_fd, MEET_TIMEOUT);
+  std::optional<std::string> nodes{};
+  try {
+    std::string buffer{};
+    if (send_to_client(*node_fd, message_to_string(command_to_message(
+                                     Command{CommandVerb::Cluster,
+                                             {"nodes"}})))) {
+      nodes = read_node_reply(*node_fd, buffer);
+    }
+  } catch (const std::system_error &read_error) {
+    std::cerr << "Failed to read from node: " << read_error.what()
+              << std::endl;
+  }
+  close(static_cast<int>(*node_fd));
+  if (!nodes || nodes->starts_with('-')) {
+    return error("ERR Node " + host + ":" + port_arg +
+                 " didn't tell us about itself");
+  }
+  std::istringstream lines(*nodes);
+  std::string line{};
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string id{};
+    std::string address{};
+    std::string flags{};
+    fields >> id >> address >> flags;
+    if (!flags.starts_with("myself")) {
+      continue;
+    }
+    const auto index = cluster.add_node(
+        ClusterNode{id, host, static_cast<std::uint16_t>(*port)});
+    // Skip the replicated node, ping, pong, epoch and link state.
+    std::string field{};
+    for (int i = 0; i < 5; ++i) {
+      fields >> field;
+    }
+    while (fields >> field) {
+      const auto dash = field.find('-');
+      const auto start = parse_slot(field.substr(0, dash));
+      const auto end = dash == std::string::npos
+                           ? start
+                           : parse_slot(field.substr(dash + 1));
+      if (!start || !end) {
+        // e.g. the slots it is migrating, in brackets.
+        continue;
+      }
+      for (auto slot = *start; slot <= *end; ++slot) {
+        if (cluster.owner(slot) != ClusterState::MYSELF) {
+          cluster.set_owner(slot, index);
+        }
+      }
+    }
+    return Message{"OK", DataType::SimpleString};
+  }
+  return error("ERR Node " + host + ":" + port_arg +
+               " didn't tell us about itself");
+}
+
+Message set_slot(const Command &command, ClusterState &cluster,
+                 const Cache &cache) {
+  const auto &args = command.arguments;
+  const auto slot = parse_slot(args[1]);
+  if (!slot) {
+    return INVALID_SLOT_ERROR;
+  }
+  const auto action = tolower(args[2]);
+  if (action == "stable") {
+    cluster.set_stable(*slot);
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (args.size() < 4) {
+    return error("ERR Invalid CLUSTER SETSLOT action or number of arguments");
+  }
+  const auto node = cluster.find_node(args[3]);
+  if (!node) {
+    return error("ERR I don't know about node " + args[3]);
+  }
+  const bool is_mine = cluster.owner(*slot) == ClusterState::MYSELF;
+  if (action == "migrating") {
+    if (!is_mine) {
+      return error("ERR I'm not the owner of hash slot " + args[1]);
+    }
+    cluster.set_migrating(*slot, *node);
+  } else if (action == "importing") {
+    if (is_mine) {
+      return error("ERR I'm already the owner of hash slot " + args[1]);
+    }
+    cluster.set_importing(*slot, *node);
+  } else if (action == "node") {
+    if (is_mine && *node != ClusterState::MYSELF &&
+        count_keys_in_slot(cache, *slot) > 0) {
+      return error("ERR Can't assign hashslot " + args[1] +
+                   " to a different node while I still hold keys for this "
+                   "hash slot.");
+    }
+    // Once the slot has an owner, its migration is done.
+    cluster.set_stable(*slot);
+    cluster.set_owner(*slot, *node);
+  } else {
+    return error("ERR Invalid CLUSTER SETSLOT action or number of arguments");
+  }
+  return Message{"OK", DataType::SimpleString};
+}
+
+// Replies to ADDSLOTS, ADDSLOTSRANGE and DELSLOTS. Either all of the slots
+// change, or none of them.
+Message change_slots(const Command &command, ClusterState &cluster,
+                     bool is_add, bool is_range) {
+  const auto args = std::span(command.arguments).subspan(1);
+  if (is_range && args.size() % 2 != 0) {
+    return error("ERR wrong number of arguments for 'cluster|addslotsrange' "
+                 "command");
+  }
+  std::vector<std::uint16_t> slots{};
+  for (std::size_t i = 0; i < args.size(); i += is_range ? 2 : 1) {
+    const auto start = parse_slot(args[i]);
+    const auto end = is_range ? parse_slot(args[i + 1]) : start;
+    if (!start || !end || *start > *end) {
+      return INVALID_SLOT_ERROR;
+    }
+    for (auto slot = *start; slot <= *end; ++slot) {
+      const auto owner = cluster.owner(slot);
+      if (is_add && owner) {
+        return error("ERR Slot " + std::to_string(slot) +
+                     " is already busy");
+      }
+      if (!is_add && !owner) {
+        return error("ERR Slot " + std::to_string(slot) +
+                     " is already unassigned");
+      }
+      slots.push_back(slot);
+    }
+  }
+  for (const auto slot : slots) {
+    cluster.set_stable(slot);
+    cluster.set_owner(slot, is_add ? std::optional(ClusterState::MYSELF)
+                                   : std::nullopt);
+  }
+  return Message{"OK", DataType::SimpleString};
+}
+
+Message cluster_info(const ClusterState &cluster) {
+  std::size_t slots_assigned = 0;
+  std::vector<bool> serves_slots(cluster.num_nodes(), false);
+  for (const auto &range : cluster.slot_ranges()) {
+    slots_assigned += range.end - range.start + 1;
+    serves_slots[range.node] = true;
+  }
+  std::ostringstream out{};
+  out << "cluster_enabled:1\r\n"
+      << "cluster_state:" << (slots_assigned == CLUSTER_SLOTS ? "ok" : "fail")
+      << "\r\n"
+      << "cluster_slots_assigned:" << slots_assigned << "\r\n"
+      << "cluster_known_nodes:" << cluster.num_nodes() << "\r\n"
+      << "cluster_size:" << std::ranges::count(serves_slots, true) << "\r\n";
+  return Message{out.str(), DataType::BulkString};
+}
+
+} // namespace
+
+std::uint16_t crc16(std::string_view data) {
+  // Bit by bit, which is plenty fast for keys.
+  std::uint16_t crc = 0;
+  for (const auto byte : data) {
+    crc ^= static_cast<std::uint16_t>(static_cast<std::uint8_t>(byte) << 8);
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x8000) != 0
+                ? static_cast<std::uint16_t>((crc << 1) ^ 0x1021)
+                : static_cast<std::uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+std::uint16_t key_hash_slot(std::string_view key) {
+  const auto open = key.find('{');
+  if (open != std::string_view::npos) {
+    const auto close = key.find('}', open + 1);
+    if (close != std::string_view::npos && close > open + 1) {
+      key = key.substr(open + 1, close - open - 1);
+    }
+  }
+  return crc16(key) & (CLUSTER_SLOTS - 1);
+}
+
+ClusterState::ClusterState(std::string host, std::uint16_t port)
+    : nodes_{ClusterNode{generate_random_id(), std::move(host), port}} {
+  for (std::size_t slot = 0; slot < CLUSTER_SLOTS; ++slot) {
+    owners_[slot] = NO_NODE;
+    migrating_[slot] = NO_NODE;
+    importing_[slot] = NO_NODE;
+  }
+}
+
+ClusterNode ClusterState::node(NodeIndex index) const {
+  std::scoped_lock lock(mutex_);
+  return nodes_[index];
+}
+
+std::size_t ClusterState::num_nodes() const {
+  std::scoped_lock lock(mutex_);
+  return nodes_.size();
+}
+
+ClusterState::NodeIndex ClusterState::add_node(const ClusterNode &node) {
+  std::scoped_lock lock(mutex_);
+  for (std::size_t index = 0; index < nodes_.size(); ++index) {
+    if (nodes_[index].id == node.id) {
+      nodes_[index] = node;
+      return static_cast<NodeIndex>(index);
+    }
+  }
+  nodes_.push_back(node);
+  return static_cast<NodeIndex>(nodes_.size() - 1);
+}
+
+std::optional<ClusterState::NodeIndex>
+ClusterState::find_node(std::string_view id) const {
+  std::scoped_lock lock(mutex_);
+  for (std::size_t index = 0; index < nodes_.size(); ++index) {
+    if (nodes_[index].id == id) {
+      return static_cast<NodeIndex>(index);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<ClusterState::NodeIndex>
+ClusterState::owner(std::uint16_t slot) const {
+  const auto node = owners_[slot].load(std::memory_order_relaxed);
+  return node == NO_NODE ? std::nullopt : std::optional(node);
+}
+
+void ClusterState::set_owner(std::uint16_t slot,
+                             std::optional<NodeIndex> node) {
+  owners_[slot] = node.value_or(NO_NODE);
+}
+
+void ClusterState::set_migrating(std::uint16_t slot, NodeIndex to) {
+  importing_[slot] = NO_NODE;
+  migrating_[slot] = to;
+}
+
+void ClusterState::set_importing(std::uint16_t slot, NodeIndex from) {
+  migrating_[slot] = NO_NODE;
+  importing_[slot] = from;
+}
+
+void ClusterState::set_stable(std::uint16_t slot) {
+  migrating_[slot] = NO_NODE;
+  importing_[slot] = NO_NODE;
+}
+
+std::optional<ClusterState::NodeIndex>
+ClusterState::migrating_to(std::uint16_t slot) const {
+  const auto node = migrating_[slot].load(std::memory_order_relaxed);
+  return node == NO_NODE ? std::nullopt : std::optional(node);
+}
+
+std::optional<ClusterState::NodeIndex>
+ClusterState::importing_from(std::uint16_t slot) const {
+  const auto node = importing_[slot].load(std::memory_order_relaxed);
+  return node == NO_NODE ? std::nullopt : std::optional(node);
+}
+
+std::string ClusterState::address(NodeIndex index) const {
+  const auto target = node(index);
+  return target.host + ":" + std::to_string(target.port);
+}
+
+std::optional<std::string> ClusterState::redirect(
+    std::uint16_t slot, bool asking, std::size_t num_keys,
+    const std::function<std::size_t()> &count_keys_here) const {
+  const auto slot_owner = owner(slot);
+  if (!slot_owner) {
+    return "CLUSTERDOWN Hash slot not served";
+  }
+  const auto slot_text = std::to_string(slot);
+  if (*slot_owner == MYSELF) {
+    // Keys that already moved on are looked for at their new node, and so
+    // are new keys, so the slot empties out here.
+    if (const auto to = migrating_to(slot)) {
+      const auto num_here = count_keys_here();
+      if (num_here == 0) {
+        return "ASK " + slot_text + " " + address(*to);
+      }
+      if (num_here < num_keys) {
+        return "TRYAGAIN Multiple keys request during rehashing of slot";
+      }
+    }
+    return std::nullopt;
+  }
+  // Clients only come here for a slot we're importing when the node it is
+  // migrating from sent them (with ASK).
+  if (asking && importing_from(slot)) {
+    if (num_keys > 1 && count_keys_here() < num_keys) {
+      return "TRYAGAIN Multiple keys request during rehashing of slot";
+    }
+    return std::nullopt;
+  }
+  return "MOVED " + slot_text + " " + address(*slot_owner);
+}
+
+std::vector<ClusterState::SlotRange> ClusterState::slot_ranges() const {
+  std::vector<SlotRange> ranges{};
+  for (std::size_t slot = 0; slot < CLUSTER_SLOTS; ++slot) {
+    const auto slot16 = static_cast<std::uint16_t>(slot);
+    const auto node = owner(slot16);
+    if (!node) {
+      continue;
+    }
+    if (!ranges.empty() && ranges.back().node == *node &&
+        ranges.back().end + 1 == slot16) {
+      ranges.back().end = slot16;
+    } else {
+      ranges.push_back(SlotRange{slot16, slot16, *node});
+    }
+  }
+  return ranges;
+}
+
+std::optional<std::string> read_node_reply(const SocketFd node_fd,
+                                           std::string &buffer) {
+  while (true) {
+    const auto line_end = buffer.find(TERMINATOR);
+    if (line_end != std::string::npos) {
+      std::optional<std::string> reply{};
+      std::size_t reply_end = line_end + 2;
+      const auto length =
+          buffer.starts_with('$')
+              ? parse_canonical_int(
+                    std::string_view(buffer).substr(1, line_end - 1))
+              : std::nullopt;
+      if (!length || *length < 0) {
+        // Nil, or anything else that fits on a line.
+        reply = buffer.substr(0, line_end);
+      } else if (buffer.size() >=
+                 reply_end + static_cast<std::size_t>(*length) + 2) {
+        reply = buffer.substr(reply_end, static_cast<std::size_t>(*length));
+        reply_end += static_cast<std::size_t>(*length) + 2;
+      }
+      if (reply) {
+        buffer.erase(0, reply_end);
+        return reply;
+      }
+    }
+    const auto received = receive_string_from_client(node_fd);
+    if (!received) {
+      return std::nullopt;
+    }
+    buffer += *received;
+  }
+}
+
+Message handle_cluster_command(const Command &command, ClusterState &cluster,
+                               const Cache &cache) {
+  const auto &args = command.arguments;
+  const auto subcommand = tolower(args.front());
+  if (subcommand == "info" && args.size() == 1) {
+    return cluster_info(cluster);
+  }
+  if (subcommand == "myid" && args.size() == 1) {
+    return Message{cluster.myself().id, DataType::BulkString};
+  }
+  if (subcommand == "nodes" && args.size() == 1) {
+    return Message{describe_nodes(cluster), DataType::BulkString};
+  }
+  if (subcommand == "meet" && args.size() == 3) {
+    return meet(cluster, args[1], args[2]);
+  }
+  if ((subcommand == "addslots" || subcommand == "delslots") &&
+      args.size() >= 2) {
+    return change_slots(command, cluster, subcommand == "addslots", false);
+  }
+  if (subcommand == "addslotsrange" && args.size() >= 3) {
+    return change_slots(command, cluster, true, true);
+  }
+  if (subcommand == "setslot" && args.size() >= 3) {
+    return set_slot(command, cluster, cache);
+  }
+  if (subcommand == "slots" && args.size() == 1) {
+    // Each range is [start, end, [host, port, id]].
+    Message::NestedVariantT ranges{};
+    for (const auto &range : cluster.slot_ranges()) {
+      const auto node = cluster.node(range.node);
+      ranges.emplace_back(
+          Message::NestedVariantT{
+              integer(range.start), integer(range.end),
+              Message{Message::NestedVariantT{
+                          Message{node.host, DataType::BulkString},
+                          integer(node.port),
+                          Message{node.id, DataType::BulkString}},
+                      DataType::Array}},
+          DataType::Array);
+    }
+    return Message{std::move(ranges), DataType::Array};
+  }
+  if (subcommand == "keyslot" && args.size() == 2) {
+    return integer(key_hash_slot(args[1]));
+  }
+  if (subcommand == "countkeysinslot" && args.size() == 2) {
+    const auto slot = parse_slot(args[1]);
+    if (!slot) {
+      return INVALID_SLOT_ERROR;
+    }
+    return integer(count_keys_in_slot(cache, *slot));
+  }
+  if (subcommand == "getkeysinslot" && args.size() == 3) {
+    const auto slot = parse_slot(args[1]);
+    const auto count = parse_canonical_int(args[2]);
+    if (!slot) {
+      return INVALID_SLOT_ERROR;
+    }
+    if (!count || *count < 0) {
+      return error("ERR Invalid number of keys");
+    }
+    // There is no index of keys by slot, so this walks the whole keyspace.
+    Message::NestedVariantT keys{};
+    cache.for_each([&keys, &slot, &count](const auto &key, const auto &) {
+      if (keys.size() < static_cast<std::size_t>(*count) &&
+          key_hash_slot(key) == *slot) {
+        keys.emplace_back(key, DataType::BulkString);
+      }
+    });
+    return Message{std::move(keys), DataType::Array};
+  }
+  return error("ERR unknown subcommand or wrong number of arguments for '" +
+               args.front() + "'");
+}
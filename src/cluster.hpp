@@ -0,0 +1,111 @@
+#pragma once
+
+// System includes.
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "network.hpp"
+#include "protocol.hpp"
+
+// Keys are sharded across the nodes of a cluster by hash slot. See
+// https://redis.io/docs/latest/operate/oss_and_stack/reference/cluster-spec/
+constexpr std::size_t CLUSTER_SLOTS = 16384;
+
+// CRC16-CCITT (XMODEM), the checksum Redis Cluster hashes keys with.
+std::uint16_t crc16(std::string_view data);
+
+// The slot of the key. If the key has a non-empty "{hashtag}", only the
+// hashtag is hashed, so related keys can be put in the same slot.
+std::uint16_t key_hash_slot(std::string_view key);
+
+struct ClusterNode {
+  std::string id;
+  std::string host;
+  std::uint16_t port = 0;
+};
+
+// What this node knows about the cluster: the other nodes, which node serves
+// each slot, and the slots being migrated to or from other nodes. There is no
+// gossip between nodes, so it only changes through CLUSTER commands. The
+// per-slot lookups every command makes take no lock.
+class ClusterState {
+public:
+  using NodeIndex = std::uint16_t;
+  // This node is always the first.
+  static constexpr NodeIndex MYSELF = 0;
+
+  ClusterState(std::string host, std::uint16_t port);
+
+  [[nodiscard]] ClusterNode myself() const { return node(MYSELF); }
+  [[nodiscard]] ClusterNode node(NodeIndex index) const;
+  [[nodiscard]] std::size_t num_nodes() const;
+  // Adds the node (or updates its address, if we already know its ID).
+  NodeIndex add_node(const ClusterNode &node);
+  [[nodiscard]] std::optional<NodeIndex> find_node(std::string_view id) const;
+
+  // The node serving the slot, if any.
+  [[nodiscard]] std::optional<NodeIndex> owner(std::uint16_t slot) const;
+  void set_owner(std::uint16_t slot, std::optional<NodeIndex> node);
+  // Marks the slot as being moved from this node to another (MIGRATING), or
+  // from another node to this one (IMPORTING), or neither (STABLE).
+  void set_migrating(std::uint16_t slot, NodeIndex to);
+  void set_importing(std::uint16_t slot, NodeIndex from);
+  void set_stable(std::uint16_t slot);
+  [[nodiscard]] std::optional<NodeIndex> migrating_to(std::uint16_t slot) const;
+  [[nodiscard]] std::optional<NodeIndex>
+  importing_from(std::uint16_t slot) const;
+
+  // Where a command on num_keys keys in the slot has to go instead, as the
+  // error to reply with (e.g. "MOVED 3999 127.0.0.1:6381"), or nullopt if it
+  // can run here. asking is whether the client sent ASKING right before.
+  // While the slot is being migrated, count_keys_here() is asked how many of
+  // the keys are still (or already) here.
+  [[nodiscard]] std::optional<std::string>
+  redirect(std::uint16_t slot, bool asking, std::size_t num_keys,
+           const std::function<std::size_t()> &count_keys_here) const;
+
+  // Each run of consecutive slots served by the same node.
+  struct SlotRange {
+    std::uint16_t start = 0;
+    std::uint16_t end = 0;
+    NodeIndex node = MYSELF;
+  };
+  [[nodiscard]] std::vector<SlotRange> slot_ranges() const;
+
+private:
+  static constexpr NodeIndex NO_NODE = 0xFFFF;
+  using SlotTable = std::array<std::atomic<NodeIndex>, CLUSTER_SLOTS>;
+
+  // Guards nodes_, which only ever grows.
+  mutable std::mutex mutex_;
+  std::vector<ClusterNode> nodes_;
+  SlotTable owners_;
+  SlotTable migrating_;
+  SlotTable importing_;
+
+  [[nodiscard]] std::string address(NodeIndex index) const;
+};
+
+// Reads one reply from another node: the line of a SimpleString, SimpleError
+// or Integer (with its type byte), or the contents of a BulkString. buffer
+// holds what was received but not read yet, so replies to pipelined commands
+// can be read one after the other. Returns nullopt if the node hangs up, and
+// throws if reading fails (e.g. times out).
+std::optional<std::string> read_node_reply(const SocketFd node_fd,
+                                           std::string &buffer);
+
+// Replies to CLUSTER (INFO, MYID, NODES, MEET, ADDSLOTS, ADDSLOTSRANGE,
+// DELSLOTS, SETSLOT, SLOTS, KEYSLOT, COUNTKEYSINSLOT and GETKEYSINSLOT), where
+// cache is the one database a cluster node has.
+Message handle_cluster_command(const Command &command, ClusterState &cluster,
+                               const Cache &cache);
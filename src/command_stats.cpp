@@ -0,0 +1,141 @@
+// This source file's own header include.
+#include "command_stats.hpp"
+
+// System includes.
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Adds to a counter only the calling thread writes to, which needs no
+// read-modify-write instruction.
+void bump(std::atomic<std::uint64_t> &counter, const std::uint64_t amount) {
+  counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+} // namespace
+
+std::uint64_t LatencyHistogram::percentile(const double fraction) const {
+  if (total_ == 0) {
+    return 0;
+  }
+  // The rank of the value, counting from 1.
+  const auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(fraction * static_cast<double>(total_))));
+  std::uint64_t seen = 0;
+  for (std::size_t bucket = 0; bucket < NUM_BUCKETS; ++bucket) {
+    seen += buckets_[bucket];
+    if (seen >= rank) {
+      return highest_in_bucket(bucket);
+    }
+  }
+  return MAX_NANOSECONDS;
+}
+
+CommandStats::CommandStats(const std::size_t num_verbs)
+    : pool_(std::make_shared<Pool>(num_verbs)) {}
+
+void CommandStats::record(const CommandVerb verb,
+                          const Clock::duration duration, const bool failed) {
+  auto *counters = local_counters(verb);
+  if (!counters) {
+    return;
+  }
+  const auto nanoseconds = static_cast<std::uint64_t>(std::max<std::int64_t>(
+      0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+             .count()));
+  bump(counters->calls, 1);
+  bump(counters->nanoseconds, nanoseconds);
+  bump(counters->buckets[LatencyHistogram::bucket_of(nanoseconds)], 1);
+  if (failed) {
+    bump(counters->failed, 1);
+  }
+}
+
+void CommandStats::record_rejected(const CommandVerb verb) {
+  if (auto *counters = local_counters(verb)) {
+    bump(counters->rejected, 1);
+  }
+}
+
+std::vector<CommandCounts> CommandStats::merged() const {
+  std::vector<CommandCounts> merged(pool_->num_verbs);
+  std::scoped_lock lock(pool_->mutex);
+  for (const auto &shard : pool_->shards) {
+    for (std::size_t verb = 0; verb < merged.size(); ++verb) {
+      const auto *counters =
+          shard->counters[verb].load(std::memory_order_acquire);
+      if (!counters) {
+        continue;
+      }
+      auto &counts = merged[verb];
+      counts.calls += counters->calls.load(std::memory_order_relaxed);
+      counts.nanoseconds +=
+          counters->nanoseconds.load(std::memory_order_relaxed);
+      counts.rejected += counters->rejected.load(std::memory_order_relaxed);
+      counts.failed += counters->failed.load(std::memory_order_relaxed);
+      for (std::size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS;
+           ++bucket) {
+        if (const auto count =
+                counters->buckets[bucket].load(std::memory_order_relaxed)) {
+          counts.latencies.add(bucket, count);
+        }
+      }
+    }
+  }
+  return merged;
+}
+
+CommandStats::Shard &CommandStats::local_shard() {
+  // The shards the thread took, from each pool it recorded into, which it
+  // hands back as it exits.
+  struct LocalShards {
+    std::vector<std::pair<std::shared_ptr<Pool>, Shard *>> shards{};
+    LocalShards() = default;
+    LocalShards(const LocalShards &other) = delete;
+    LocalShards &operator=(const LocalShards &other) = delete;
+    LocalShards(LocalShards &&other) = delete;
+    LocalShards &operator=(LocalShards &&other) = delete;
+    ~LocalShards() {
+      for (const auto &[pool, shard] : shards) {
+        std::scoped_lock lock(pool->mutex);
+        pool->free.push_back(shard);
+      }
+    }
+  };
+  thread_local LocalShards local{};
+  for (const auto &[pool, shard] : local.shards) {
+    if (pool == pool_) {
+      return *shard;
+    }
+  }
+  Shard *shard = nullptr;
+  {
+    std::scoped_lock lock(pool_->mutex);
+    if (pool_->free.empty()) {
+      pool_->shards.push_back(std::make_unique<Shard>(pool_->num_verbs));
+      shard = pool_->shards.back().get();
+    } else {
+      shard = pool_->free.back();
+      pool_->free.pop_back();
+    }
+  }
+  local.shards.emplace_back(pool_, shard);
+  return *shard;
+}
+
+CommandStats::Counters *CommandStats::local_counters(const CommandVerb verb) {
+  const auto index = static_cast<std::size_t>(verb);
+  if (index >= pool_->num_verbs) {
+    return nullptr;
+  }
+  auto &shard = local_shard();
+  auto *counters = shard.counters[index].load(std::memory_order_relaxed);
+  if (!counters) {
+    counters = shard.owned.emplace_back(std::make_unique<Counters>()).get();
+    shard.counters[index].store(counters, std::memory_order_release);
+  }
+  return counters;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+// System includes.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+// A histogram of latencies (in nanoseconds) with log-linear buckets, like
+// HdrHistogram's: values below SUB_BUCKETS each have a bucket, and every
+// power of two above that is split into SUB_BUCKETS buckets, so any value
+// (and so any percentile) is known to within 1/SUB_BUCKETS of itself.
+// Latencies past MAX_NANOSECONDS (over a minute) count as MAX_NANOSECONDS.
+class LatencyHistogram {
+public:
+  static constexpr std::size_t SUB_BUCKET_BITS = 4;
+  static constexpr std::uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+  static constexpr std::uint64_t MAX_NANOSECONDS = (1ULL << 36U) - 1;
+  static constexpr std::size_t NUM_BUCKETS =
+      (36 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  // The bucket the latency falls in.
+  static constexpr std::size_t bucket_of(std::uint64_t nanoseconds) {
+    nanoseconds = std::min(nanoseconds, MAX_NANOSECONDS);
+    if (nanoseconds < SUB_BUCKETS) {
+      return nanoseconds;
+    }
+    const auto shift = static_cast<std::size_t>(std::bit_width(nanoseconds)) -
+                       1 - SUB_BUCKET_BITS;
+    return ((shift + 1) * SUB_BUCKETS) +
+           ((nanoseconds >> shift) - SUB_BUCKETS);
+  }
+  // The highest latency in the bucket, which is what percentiles report.
+  static constexpr std::uint64_t highest_in_bucket(std::size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    const auto shift = (bucket / SUB_BUCKETS) - 1;
+    const auto lowest = (SUB_BUCKETS + (bucket % SUB_BUCKETS)) << shift;
+    return lowest + (1ULL << shift) - 1;
+  }
+
+  void add(std::size_t bucket, std::uint64_t count) {
+    buckets_[bucket] += count;
+    total_ += count;
+  }
+  [[nodiscard]] std::uint64_t count() const { return total_; }
+  // The latency that the fraction (between 0 and 1) of the values are at or
+  // under, or 0 if there are none.
+  [[nodiscard]] std::uint64_t percentile(double fraction) const;
+
+private:
+  std::array<std::uint64_t, NUM_BUCKETS> buckets_{};
+  std::uint64_t total_ = 0;
+};
+
+// What a command has been up to, for INFO commandstats and latencystats.
+struct CommandCounts {
+  // The calls that ran (including failed ones) and how long they took in
+  // total.
+  std::uint64_t calls = 0;
+  std::uint64_t nanoseconds = 0;
+  // The calls turned down before running (e.g. with LOADING or READONLY).
+  std::uint64_t rejected = 0;
+  // The calls that ran but replied with an error.
+  std::uint64_t failed = 0;
+  LatencyHistogram latencies{};
+};
+
+// Counts the calls to each command and how long they took.
+//
+// Recording is on the path of every command, so it never takes a lock or
+// writes to memory another thread writes to: each thread counts into a shard
+// of its own, which only it writes to, and reading merges the shards. A shard
+// only gets counters for the commands its thread ran. Shards are handed back
+// as their threads exit, and reused (counts and all) by new threads, so there
+// are only ever as many as threads running at once.
+class CommandStats {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Verbs are counted up to (and not including) num_verbs.
+  explicit CommandStats(std::size_t num_verbs);
+  CommandStats(const CommandStats &other) = delete;
+  CommandStats &operator=(const CommandStats &other) = delete;
+  CommandStats(CommandStats &&other) = delete;
+  CommandStats &operator=(CommandStats &&other) = delete;
+  ~CommandStats() = default;
+
+  // Records a call to the command that took the duration, and whether it
+  // replied with an error.
+  void record(CommandVerb verb, Clock::duration duration, bool failed);
+  // Records a call to the command that was turned down before running.
+  void record_rejected(CommandVerb verb);
+
+  // The counts of every verb (indexed by verb) summed over all the threads.
+  [[nodiscard]] std::vector<CommandCounts> merged() const;
+
+private:
+  // Written only by the thread that owns the shard, so the updates are plain
+  // loads and stores, which are atomic only so other threads may read them.
+  struct Counters {
+    std::atomic<std::uint64_t> calls = 0;
+    std::atomic<std::uint64_t> nanoseconds = 0;
+    std::atomic<std::uint64_t> rejected = 0;
+    std::atomic<std::uint64_t> failed = 0;
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::NUM_BUCKETS>
+        buckets{};
+  };
+  struct Shard {
+    explicit Shard(std::size_t num_verbs) : counters(num_verbs) {}
+    // Allocated the first time the thread runs each verb.
+    std::vector<std::atomic<Counters *>> counters;
+    std::vector<std::unique_ptr<Counters>> owned{};
+  };
+  // Every shard, and the ones no thread is using. Shared with the threads
+  // using its shards, which hand them back as they exit (even if this is
+  // gone by then).
+  struct Pool {
+    explicit Pool(std::size_t num_verbs_in) : num_verbs(num_verbs_in) {}
+    std::size_t num_verbs;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards{};
+    std::vector<Shard *> free{};
+  };
+
+  std::shared_ptr<Pool> pool_;
+
+  // The calling thread's shard, taken from the pool the first time.
+  Shard &local_shard();
+  // The calling thread's counters for the verb, or nullptr if it's out of
+  // range.
+  Counters *local_counters(CommandVerb verb);
+};
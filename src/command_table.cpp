@@ -0,0 +1,336 @@
+// This source file's own header include.
+#include "command_table.hpp"
+
+// System includes.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Our library's header includes.
+#include "bitmap_commands.hpp"
+#include "dump_commands.hpp"
+#include "generic_commands.hpp"
+#include "hash_commands.hpp"
+#include "hyperloglog_commands.hpp"
+#include "list_commands.hpp"
+#include "set_commands.hpp"
+#include "sorted_set_commands.hpp"
+#include "stream_commands.hpp"
+
+namespace {
+using enum CommandSpec::Flag;
+
+// The handlers of each type of value, as CommandHandlers.
+std::optional<Message> list(const Command &command, const Config &config,
+                            Cache &cache, const LazyFree * /*lazy_free*/) {
+  return handle_list_command(command, config, cache);
+}
+std::optional<Message> hash(const Command &command, const Config &config,
+                            Cache &cache, const LazyFree * /*lazy_free*/) {
+  return handle_hash_command(command, config, cache);
+}
+std::optional<Message> set(const Command &command, const Config &config,
+                           Cache &cache, const LazyFree * /*lazy_free*/) {
+  return handle_set_command(command, config, cache);
+}
+std::optional<Message> sorted_set(const Command &command,
+                                  const Config &config, Cache &cache,
+                                  const LazyFree * /*lazy_free*/) {
+  return handle_sorted_set_command(command, config, cache);
+}
+std::optional<Message> bitmap(const Command &command,
+                              const Config & /*config*/, Cache &cache,
+                              const LazyFree * /*lazy_free*/) {
+  return handle_bitmap_command(command, cache);
+}
+std::optional<Message> hyperloglog(const Command &command,
+                                   const Config &config, Cache &cache,
+                                   const LazyFree * /*lazy_free*/) {
+  return handle_hyperloglog_command(command, config, cache);
+}
+std::optional<Message> stream(const Command &command, const Config &config,
+                              Cache &cache, const LazyFree * /*lazy_free*/) {
+  return handle_stream_command(command, config, cache);
+}
+std::optional<Message> dump(const Command &command, const Config & /*config*/,
+                            Cache &cache, const LazyFree * /*lazy_free*/) {
+  return handle_dump_command(command, cache);
+}
+constexpr CommandHandler generic = handle_generic_command;
+
+// Name, subcommand, verb, arity, max arity, first key, last key, key step,
+// flags and handler. Writes that replace or remove one key in O(1) count as
+// fast, like in Redis.
+constexpr std::array COMMANDS{
+    CommandSpec{"ping", "", CommandVerb::Ping, -1, 2, 0, 0, 0, Loading | Fast,
+                generic},
+    CommandSpec{"echo", "", CommandVerb::Echo, 2, 0, 0, 0, 0, Loading | Fast,
+                generic},
+    CommandSpec{"set", "", CommandVerb::Set, -3, 0, 1, 1, 1, Write, generic},
+    CommandSpec{"get", "", CommandVerb::Get, 2, 0, 1, 1, 1, ReadOnly | Fast,
+                generic},
+    CommandSpec{"config", "get", CommandVerb::ConfigGet, -3, 0, 0, 0, 0,
+                Loading, generic},
+    CommandSpec{"keys", "", CommandVerb::Keys, -1, 0, 0, 0, 0, ReadOnly,
+                generic},
+    CommandSpec{"save", "", CommandVerb::Save, -1, 0, 0, 0, 0, 0, nullptr},
+    CommandSpec{"bgrewriteaof", "", CommandVerb::BgRewriteAof, -1, 0, 0, 0, 0,
+                0, nullptr},
+    CommandSpec{"info", "", CommandVerb::Info, -1, 0, 0, 0, 0, Loading,
+                nullptr},
+    CommandSpec{"type", "", CommandVerb::Type, 2, 0, 1, 1, 1, ReadOnly | Fast,
+                generic},
+    CommandSpec{"select", "", CommandVerb::Select, 2, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    CommandSpec{"swapdb", "", CommandVerb::SwapDb, 3, 0, 0, 0, 0,
+                Write | Fast, nullptr},
+    CommandSpec{"flushdb", "", CommandVerb::FlushDb, -1, 2, 0, 0, 0, Write,
+                nullptr},
+    CommandSpec{"flushall", "", CommandVerb::FlushAll, -1, 2, 0, 0, 0, Write,
+                nullptr},
+    CommandSpec{"del", "", CommandVerb::Del, -2, 0, 1, -1, 1, Write, generic},
+    CommandSpec{"unlink", "", CommandVerb::Unlink, -2, 0, 1, -1, 1,
+                Write | Fast, generic},
+    CommandSpec{"lpush", "", CommandVerb::LPush, -3, 0, 1, 1, 1, Write | Fast,
+                list},
+    CommandSpec{"rpush", "", CommandVerb::RPush, -3, 0, 1, 1, 1, Write | Fast,
+                list},
+    CommandSpec{"lpop", "", CommandVerb::LPop, -2, 3, 1, 1, 1, Write | Fast,
+                list},
+    CommandSpec{"rpop", "", CommandVerb::RPop, -2, 3, 1, 1, 1, Write | Fast,
+                list},
+    CommandSpec{"llen", "", CommandVerb::LLen, 2, 0, 1, 1, 1, ReadOnly | Fast,
+                list},
+    CommandSpec{"lrange", "", CommandVerb::LRange, 4, 0, 1, 1, 1, ReadOnly,
+                list},
+    CommandSpec{"ltrim", "", CommandVerb::LTrim, 4, 0, 1, 1, 1, Write, list},
+    CommandSpec{"hset", "", CommandVerb::HSet, -4, 0, 1, 1, 1, Write | Fast,
+                hash},
+    CommandSpec{"hget", "", CommandVerb::HGet, 3, 0, 1, 1, 1, ReadOnly | Fast,
+                hash},
+    CommandSpec{"hmget", "", CommandVerb::HMGet, -3, 0, 1, 1, 1,
+                ReadOnly | Fast, hash},
+    CommandSpec{"hgetall", "", CommandVerb::HGetAll, 2, 0, 1, 1, 1, ReadOnly,
+                hash},
+    CommandSpec{"hdel", "", CommandVerb::HDel, -3, 0, 1, 1, 1, Write | Fast,
+                hash},
+    CommandSpec{"hincrby", "", CommandVerb::HIncrBy, 4, 0, 1, 1, 1,
+                Write | Fast, hash},
+    CommandSpec{"hscan", "", CommandVerb::HScan, -3, 0, 1, 1, 1, ReadOnly,
+                hash},
+    CommandSpec{"zadd", "", CommandVerb::ZAdd, -4, 0, 1, 1, 1, Write | Fast,
+                sorted_set},
+    CommandSpec{"zincrby", "", CommandVerb::ZIncrBy, 4, 0, 1, 1, 1,
+                Write | Fast, sorted_set},
+    CommandSpec{"zrange", "", CommandVerb::ZRange, -4, 0, 1, 1, 1, ReadOnly,
+                sorted_set},
+    CommandSpec{"zrangebyscore", "", CommandVerb::ZRangeByScore, -4, 0, 1, 1,
+                1, ReadOnly, sorted_set},
+    CommandSpec{"zrank", "", CommandVerb::ZRank, -3, 4, 1, 1, 1,
+                ReadOnly | Fast, sorted_set},
+    CommandSpec{"zrem", "", CommandVerb::ZRem, -3, 0, 1, 1, 1, Write | Fast,
+                sorted_set},
+    CommandSpec{"zcard", "", CommandVerb::ZCard, 2, 0, 1, 1, 1,
+                ReadOnly | Fast, sorted_set},
+    CommandSpec{"sadd", "", CommandVerb::SAdd, -3, 0, 1, 1, 1, Write | Fast,
+                set},
+    CommandSpec{"srem", "", CommandVerb::SRem, -3, 0, 1, 1, 1, Write | Fast,
+                set},
+    CommandSpec{"sismember", "", CommandVerb::SIsMember, 3, 0, 1, 1, 1,
+                ReadOnly | Fast, set},
+    CommandSpec{"smembers", "", CommandVerb::SMembers, 2, 0, 1, 1, 1,
+                ReadOnly, set},
+    CommandSpec{"scard", "", CommandVerb::SCard, 2, 0, 1, 1, 1,
+                ReadOnly | Fast, set},
+    CommandSpec{"sinter", "", CommandVerb::SInter, -2, 0, 1, -1, 1, ReadOnly,
+                set},
+    CommandSpec{"sunion", "", CommandVerb::SUnion, -2, 0, 1, -1, 1, ReadOnly,
+                set},
+    CommandSpec{"sdiff", "", CommandVerb::SDiff, -2, 0, 1, -1, 1, ReadOnly,
+                set},
+    // SINTERCARD numkeys key [key ...] [LIMIT limit]
+    CommandSpec{"sintercard", "", CommandVerb::SInterCard, -3, 0, 0, 0, 0,
+                ReadOnly | MovableKeys, set},
+    CommandSpec{"setbit", "", CommandVerb::SetBit, 4, 0, 1, 1, 1, Write,
+                bitmap},
+    CommandSpec{"getbit", "", CommandVerb::GetBit, 3, 0, 1, 1, 1,
+                ReadOnly | Fast, bitmap},
+    CommandSpec{"bitcount", "", CommandVerb::BitCount, -2, 0, 1, 1, 1,
+                ReadOnly, bitmap},
+    CommandSpec{"bitpos", "", CommandVerb::BitPos, -3, 0, 1, 1, 1, ReadOnly,
+                bitmap},
+    // BITOP operation destkey key [key ...]
+    CommandSpec{"bitop", "", CommandVerb::BitOp, -4, 0, 2, -1, 1, Write,
+                bitmap},
+    CommandSpec{"pfadd", "", CommandVerb::PfAdd, -2, 0, 1, 1, 1, Write | Fast,
+                hyperloglog},
+    CommandSpec{"pfcount", "", CommandVerb::PfCount, -2, 0, 1, -1, 1,
+                ReadOnly, hyperloglog},
+    CommandSpec{"pfmerge", "", CommandVerb::PfMerge, -2, 0, 1, -1, 1, Write,
+                hyperloglog},
+    CommandSpec{"xadd", "", CommandVerb::XAdd, -5, 0, 1, 1, 1, Write | Fast,
+                stream},
+    CommandSpec{"xrange", "", CommandVerb::XRange, -4, 0, 1, 1, 1, ReadOnly,
+                stream},
+    CommandSpec{"xrevrange", "", CommandVerb::XRevRange, -4, 0, 1, 1, 1,
+                ReadOnly, stream},
+    CommandSpec{"xlen", "", CommandVerb::XLen, 2, 0, 1, 1, 1, ReadOnly | Fast,
+                stream},
+    CommandSpec{"xtrim", "", CommandVerb::XTrim, -4, 0, 1, 1, 1, Write,
+                stream},
+    // The keys are the first half of what follows STREAMS.
+    CommandSpec{"xread", "", CommandVerb::XRead, -4, 0, 0, 0, 0,
+                ReadOnly | Blocking | MovableKeys, stream},
+    // The last argument is the timeout.
+    CommandSpec{"blpop", "", CommandVerb::BLPop, -3, 0, 1, -2, 1,
+                Write | Blocking, list},
+    CommandSpec{"brpop", "", CommandVerb::BRPop, -3, 0, 1, -2, 1,
+                Write | Blocking, list},
+    CommandSpec{"replconf", "", CommandVerb::ReplConf, -3, 0, 0, 0, 0,
+                Loading, nullptr},
+    CommandSpec{"psync", "", CommandVerb::PSync, 3, 0, 0, 0, 0, 0, nullptr},
+    CommandSpec{"cluster", "", CommandVerb::Cluster, -2, 0, 0, 0, 0, Loading,
+                nullptr},
+    CommandSpec{"asking", "", CommandVerb::Asking, 1, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    // MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE]
+    // [KEYS key...] moves keys of a slot this node serves, wherever they
+    // hash to, so it has none as far as the cluster is concerned.
+    CommandSpec{"migrate", "", CommandVerb::Migrate, -6, 0, 0, 0, 0, Write,
+                nullptr},
+    CommandSpec{"dump", "", CommandVerb::Dump, 2, 0, 1, 1, 1, ReadOnly, dump},
+    CommandSpec{"restore", "", CommandVerb::Restore, -4, 0, 1, 1, 1, Write,
+                dump},
+    // Channels are not keys.
+    CommandSpec{"subscribe", "", CommandVerb::Subscribe, -2, 0, 0, 0, 0,
+                Loading, nullptr},
+    CommandSpec{"unsubscribe", "", CommandVerb::Unsubscribe, -1, 0, 0, 0, 0,
+                Loading, nullptr},
+    CommandSpec{"psubscribe", "", CommandVerb::PSubscribe, -2, 0, 0, 0, 0,
+                Loading, nullptr},
+    CommandSpec{"punsubscribe", "", CommandVerb::PUnsubscribe, -1, 0, 0, 0, 0,
+                Loading, nullptr},
+    CommandSpec{"publish", "", CommandVerb::Publish, 3, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    // PUBSUB CHANNELS [pattern], NUMSUB [channel...] or NUMPAT.
+    CommandSpec{"pubsub", "", CommandVerb::PubSub, -2, 0, 0, 0, 0, Loading,
+                nullptr},
+    // HELLO [protover [AUTH username password] [SETNAME clientname]]
+    CommandSpec{"hello", "", CommandVerb::Hello, -1, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    // CLIENT ID, GETNAME, SETNAME name or TRACKING ON|OFF [options].
+    CommandSpec{"client", "", CommandVerb::Client, -2, 0, 0, 0, 0, Loading,
+                nullptr},
+    // Transactions are run by the server, which queues the commands sent
+    // between MULTI and EXEC.
+    CommandSpec{"multi", "", CommandVerb::Multi, 1, 0, 0, 0, 0, Loading | Fast,
+                nullptr},
+    CommandSpec{"exec", "", CommandVerb::Exec, 1, 0, 0, 0, 0, Loading, nullptr},
+    CommandSpec{"discard", "", CommandVerb::Discard, 1, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    CommandSpec{"watch", "", CommandVerb::Watch, -2, 0, 1, -1, 1,
+                Loading | Fast, nullptr},
+    CommandSpec{"unwatch", "", CommandVerb::Unwatch, 1, 0, 0, 0, 0,
+                Loading | Fast, nullptr},
+    // SLOWLOG GET [count], LEN or RESET.
+    CommandSpec{"slowlog", "", CommandVerb::SlowLog, -2, 3, 0, 0, 0, Loading,
+                nullptr},
+};
+
+constexpr char to_lower(char character) {
+  return character >= 'A' && character <= 'Z'
+             ? static_cast<char>(character - 'A' + 'a')
+             : character;
+}
+
+// FNV-1a of the lowercased name, mixed with the seed.
+constexpr std::uint32_t hash_name(std::string_view name, std::uint32_t seed) {
+  constexpr std::uint32_t FNV_OFFSET_BASIS = 2166136261U;
+  constexpr std::uint32_t FNV_PRIME = 16777619U;
+  std::uint32_t hash = FNV_OFFSET_BASIS ^ seed;
+  for (const char character : name) {
+    hash ^= static_cast<unsigned char>(to_lower(character));
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// The hash table the names are looked up in, which holds the index of each
+// command (plus one, so 0 is an empty slot). The seed is the first one that
+// gives every command a slot of its own, found at compile time, so a lookup
+// is one hash and one comparison.
+constexpr std::size_t NUM_SLOTS = 1024;
+static_assert(COMMANDS.size() < 255, "The slots only hold 8-bit indices");
+struct PerfectHash {
+  std::uint32_t seed = 0;
+  std::array<std::uint8_t, NUM_SLOTS> slots{};
+  bool found = false;
+};
+
+consteval PerfectHash make_perfect_hash() {
+  constexpr std::uint32_t MAX_SEEDS = 100000;
+  for (std::uint32_t seed = 0; seed < MAX_SEEDS; ++seed) {
+    PerfectHash hash{.seed = seed, .slots = {}, .found = true};
+    for (std::size_t i = 0; i < COMMANDS.size() && hash.found; ++i) {
+      auto &slot = hash.slots[hash_name(COMMANDS[i].name, seed) % NUM_SLOTS];
+      hash.found = slot == 0;
+      slot = static_cast<std::uint8_t>(i + 1);
+    }
+    if (hash.found) {
+      return hash;
+    }
+  }
+  return PerfectHash{};
+}
+
+constexpr PerfectHash PERFECT_HASH = make_perfect_hash();
+static_assert(PERFECT_HASH.found, "No seed gives every command its own slot");
+
+// The index of each verb's command (plus one), by verb.
+constexpr std::size_t NUM_VERBS =
+    static_cast<std::size_t>(
+        std::ranges::max(COMMANDS, {}, &CommandSpec::verb).verb) +
+    1;
+constexpr auto BY_VERB = [] {
+  std::array<std::uint8_t, NUM_VERBS> by_verb{};
+  for (std::size_t i = 0; i < COMMANDS.size(); ++i) {
+    by_verb[static_cast<std::size_t>(COMMANDS[i].verb)] =
+        static_cast<std::uint8_t>(i + 1);
+  }
+  return by_verb;
+}();
+
+constexpr bool equals_ignoring_case(std::string_view lowercase,
+                                    std::string_view name) {
+  return std::ranges::equal(lowercase, name, {}, {}, to_lower);
+}
+
+} // namespace
+
+bool CommandSpec::accepts(const std::size_t num_elements) const {
+  const auto count = static_cast<int>(num_elements);
+  if (arity > 0) {
+    return count == arity;
+  }
+  return count >= -arity && (max_arity == 0 || count <= max_arity);
+}
+
+const CommandSpec *find_command(const std::string_view name) {
+  const auto slot =
+      PERFECT_HASH.slots[hash_name(name, PERFECT_HASH.seed) % NUM_SLOTS];
+  if (slot == 0 || !equals_ignoring_case(COMMANDS[slot - 1].name, name)) {
+    return nullptr;
+  }
+  return &COMMANDS[slot - 1];
+}
+
+const CommandSpec *command_spec(const CommandVerb verb) {
+  const auto index = static_cast<std::size_t>(verb);
+  if (index >= NUM_VERBS || BY_VERB[index] == 0) {
+    return nullptr;
+  }
+  return &COMMANDS[BY_VERB[index] - 1];
+}
+
+std::size_t num_command_verbs() { return NUM_VERBS; }
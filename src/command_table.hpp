@@ -0,0 +1,73 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+class LazyFree;
+
+// Applies a command to the database the client selected and returns the
+// reply, like the handle_*_command() functions of each type of value.
+using CommandHandler = std::optional<Message> (*)(const Command &command,
+                                                  const Config &config,
+                                                  Cache &cache,
+                                                  const LazyFree *lazy_free);
+
+// What is known about a command ahead of time, like what Redis's COMMAND INFO
+// tells clients.
+struct CommandSpec {
+  enum Flag : std::uint8_t {
+    // Changes the dataset, so it is persisted and replicated.
+    Write = 1U << 0U,
+    // Only reads keys, so it may run while the dataset is loading if we're
+    // asked to serve the keys loaded so far.
+    ReadOnly = 1U << 1U,
+    // Runs in constant or logarithmic time.
+    Fast = 1U << 2U,
+    // Doesn't touch the dataset, so it can always run while loading.
+    Loading = 1U << 3U,
+    // May block the client until one of its keys changes.
+    Blocking = 1U << 4U,
+    // Its keys can't be found by position alone (see command_keys()).
+    MovableKeys = 1U << 5U,
+  };
+
+  // Lowercase. Commands made up of two words (CONFIG GET) have the second
+  // one in subcommand.
+  std::string_view name;
+  std::string_view subcommand;
+  CommandVerb verb = CommandVerb::Unknown;
+  // How many elements the command is sent as (counting its name, like in
+  // Redis): exactly arity if it is positive, otherwise at least -arity and
+  // at most max_arity (if set).
+  int arity = 0;
+  int max_arity = 0;
+  // Where the keys are among the arguments (counting the name as 0, like in
+  // Redis): from first_key to last_key (negative counts back from the last
+  // argument), every key_step. A first_key of 0 means there are none.
+  int first_key = 0;
+  int last_key = 0;
+  int key_step = 0;
+  std::uint8_t flags = 0;
+  // Unset for the commands the server applies itself (e.g. INFO and SELECT).
+  CommandHandler handler = nullptr;
+
+  [[nodiscard]] bool has(Flag flag) const { return (flags & flag) != 0; }
+  // Whether the command may be sent as that many elements.
+  [[nodiscard]] bool accepts(std::size_t num_elements) const;
+};
+
+// The command with the name (in any case), found with a perfect hash without
+// lowercasing it first. nullptr for commands we don't know.
+const CommandSpec *find_command(std::string_view name);
+// The command with the verb. nullptr for CommandVerb::Unknown.
+const CommandSpec *command_spec(CommandVerb verb);
+// One past the highest verb that has a command, for tables indexed by verb.
+std::size_t num_command_verbs();
@@ -1,11 +1,107 @@
 #pragma once
 
 // System includes.
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 
+// How often the append-only file is fsync'ed to disk. See
+// https://redis.io/docs/latest/operate/oss_and_stack/management/persistence/#how-durable-is-the-append-only-file
+enum class AppendFsync : std::uint8_t {
+  // fsync before replying to every write command (group committed).
+  Always,
+  // fsync at most once per second in the background.
+  EverySec,
+  // Never fsync, let the operating system decide when to flush.
+  No,
+};
+
 // TODO merge this and the cache to be part of the Server state
 struct Config {
+  // The port to listen on for clients.
+  std::uint16_t port = 6379;
   std::optional<std::string> dir;
   std::optional<std::string> dbfilename;
+  // The number of databases clients can SELECT between.
+  std::size_t databases = 16;
+  // Free the values of these deletions in the background, like UNLINK and
+  // FLUSHALL ASYNC do. Respectively: DEL, values overwritten by writes, and
+  // FLUSHDB/FLUSHALL without ASYNC or SYNC.
+  bool lazyfree_lazy_user_del = false;
+  bool lazyfree_lazy_server_del = false;
+  bool lazyfree_lazy_user_flush = false;
+  // The size of each node of a list: a positive number of elements, or -1 to
+  // -5 for 4, 8, 16, 32 or 64 KiB.
+  std::int64_t list_max_listpack_size = -2;
+  // Hashes are listpacks until they have more fields than this, or a field
+  // or value longer than this many bytes.
+  std::size_t hash_max_listpack_entries = 128;
+  std::size_t hash_max_listpack_value = 64;
+  // Sets of integers are intsets until they have more members than
+  // set_max_intset_entries. Other sets are listpacks until they have more
+  // members than set_max_listpack_entries, or one longer than
+  // set_max_listpack_value bytes.
+  std::size_t set_max_intset_entries = 512;
+  std::size_t set_max_listpack_entries = 128;
+  std::size_t set_max_listpack_value = 64;
+  // The same for sorted sets, counting members and their length.
+  std::size_t zset_max_listpack_entries = 128;
+  std::size_t zset_max_listpack_value = 64;
+  // HyperLogLogs turn dense once their sparse encoding grows past this many
+  // bytes (header included).
+  std::size_t hll_sparse_max_bytes = 3000;
+  // Streams start a new block of entries once the last one is this many
+  // bytes, or holds this many entries (0 means no limit).
+  std::size_t stream_node_max_bytes = 4096;
+  std::size_t stream_node_max_entries = 100;
+  // Append-only file persistence. The file lives in "dir" (or the working
+  // directory if "dir" is not given).
+  bool appendonly = false;
+  std::string appendfilename = "appendonly.aof";
+  AppendFsync appendfsync = AppendFsync::EverySec;
+  // Rewrite the append-only file automatically once it has grown by this
+  // percentage since the last rewrite (0 disables automatic rewrites), but
+  // only if it is at least this many bytes.
+  std::uint32_t auto_aof_rewrite_percentage = 100;
+  std::uint64_t auto_aof_rewrite_min_size = 64UL * 1024 * 1024;
+  // Load the dataset in the background and start accepting connections right
+  // away. Until loading is done, commands are rejected with a LOADING error,
+  // except for a few that don't touch the dataset (e.g. PING and INFO).
+  bool async_loading = false;
+  // While loading asynchronously, also serve reads of the keys loaded so far
+  // instead of rejecting them.
+  bool loading_serve_keys = false;
+  // When master_host is set, this server is a read-only replica of the master
+  // at that host and port.
+  std::optional<std::string> master_host{};
+  std::uint16_t master_port = 0;
+  // The size (in bytes) of the recent writes kept for replicas, so one that
+  // reconnects can catch up on what it missed instead of resyncing in full.
+  std::size_t repl_backlog_size = 1024UL * 1024;
+  // Run as a node of a cluster, serving only the hash slots assigned to it
+  // (and only database 0). Other nodes and clients are told to find it at
+  // cluster_announce_ip and port.
+  bool cluster_enabled = false;
+  std::string cluster_announce_ip = "127.0.0.1";
+  // Disconnect a subscriber once more than this many bytes of messages are
+  // waiting to be sent to it (0 means no limit).
+  std::size_t client_output_buffer_limit_pubsub = 32UL * 1024 * 1024;
+  // The most keys remembered for clients that track the keys they read,
+  // past which keys are evicted (and their clients told to drop them). 0
+  // means no limit.
+  std::size_t tracking_table_max_keys = 1000000;
+  // Close the connection of a client that sent nothing for this many seconds
+  // (0 means never). Replicas, and clients that are blocked or subscribed,
+  // are never timed out.
+  std::uint32_t timeout = 0;
+  // Send TCP keepalive probes to clients after this many seconds of silence,
+  // so the connections of clients that went away without closing them are
+  // noticed (0 turns keepalive off).
+  std::uint32_t tcp_keepalive = 300;
+  // Log the commands that take at least this many microseconds to run in the
+  // slow log (negative turns it off, and 0 logs every command).
+  std::int64_t slowlog_log_slower_than = 10000;
+  // The most commands the slow log keeps, past which the oldest are dropped.
+  std::uint32_t slowlog_max_len = 128;
 };
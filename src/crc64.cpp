@@ -0,0 +1,206 @@
+// This source file's own header include.
+#include "crc64.hpp"
+
+// System includes.
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRC64_HAVE_CLMUL 1
+#endif
+
+namespace {
+
+// The Jones polynomial in normal (most significant bit first) form.
+constexpr std::uint64_t JONES_POLY = 0xad93d23594c935a9;
+// The same polynomial bit-reversed, used by the reflected table algorithm.
+constexpr std::uint64_t JONES_POLY_REFLECTED = 0x95ac9329ac4bc9b5;
+
+using Crc64Table = std::array<std::array<std::uint64_t, 256>, 8>;
+
+// TABLES[0] is the classic byte-at-a-time table. TABLES[k][n] is the crc of
+// the byte n followed by k zero bytes, which lets us fold 8 bytes at once.
+constexpr Crc64Table make_tables() {
+  Crc64Table tables{};
+  for (std::uint64_t byte = 0; byte < 256; ++byte) {
+    std::uint64_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1U) ? (crc >> 1U) ^ JONES_POLY_REFLECTED : crc >> 1U;
+    }
+    tables[0][byte] = crc;
+  }
+  for (std::size_t k = 1; k < tables.size(); ++k) {
+    for (std::size_t byte = 0; byte < 256; ++byte) {
+      const auto prev = tables[k - 1][byte];
+      tables[k][byte] = (prev >> 8U) ^ tables[0][prev & 0xffU];
+    }
+  }
+  return tables;
+}
+constexpr Crc64Table TABLES = make_tables();
+
+std::uint64_t crc64_bytewise(std::uint64_t crc, const char *data,
+                             std::size_t len) {
+  for (std::size_t i = 0; i < len; ++i) {
+    crc = TABLES[0][(crc ^ static_cast<unsigned char>(data[i])) & 0xffU] ^
+          (crc >> 8U);
+  }
+  return crc;
+}
+
+std::uint64_t crc64_slicing_by_8(std::uint64_t crc, const char *data,
+                                 std::size_t len) {
+  while (len >= 8) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data, sizeof(word));
+    // The reflected algorithm consumes the lowest-addressed byte first.
+    if constexpr (std::endian::native == std::endian::big) {
+      word = std::byteswap(word);
+    }
+    crc ^= word;
+    crc = TABLES[7][crc & 0xffU] ^ TABLES[6][(crc >> 8U) & 0xffU] ^
+          TABLES[5][(crc >> 16U) & 0xffU] ^ TABLES[4][(crc >> 24U) & 0xffU] ^
+          TABLES[3][(crc >> 32U) & 0xffU] ^ TABLES[2][(crc >> 40U) & 0xffU] ^
+          TABLES[1][(crc >> 48U) & 0xffU] ^ TABLES[0][crc >> 56U];
+    data += 8;
+    len -= 8;
+  }
+  return crc64_bytewise(crc, data, len);
+}
+
+#ifdef CRC64_HAVE_CLMUL
+
+constexpr std::uint64_t reflect(std::uint64_t value) {
+  std::uint64_t result = 0;
+  for (int bit = 0; bit < 64; ++bit) {
+    result = (result << 1U) | (value & 1U);
+    value >>= 1U;
+  }
+  return result;
+}
+
+// Returns x^n mod P in the reflected bit order that PCLMULQDQ operates on.
+constexpr std::uint64_t reflected_xpow_mod(unsigned int exponent) {
+  std::uint64_t remainder = 1;
+  for (unsigned int i = 0; i < exponent; ++i) {
+    const bool carry = (remainder >> 63U) != 0;
+    remainder <<= 1U;
+    if (carry) {
+      remainder ^= JONES_POLY;
+    }
+  }
+  return reflect(remainder);
+}
+
+// Folding a 128-bit block forward by D bits multiplies its high-degree half by
+// x^(D+64) and its low-degree half by x^D. The carry-less product of two
+// reflected values comes out shifted by one bit, hence the "- 1" exponents.
+// The high-degree half sits in the low qword after a little-endian load.
+template <unsigned int fold_bits>
+constexpr std::array<std::uint64_t, 2> fold_constants() {
+  return {reflected_xpow_mod(fold_bits + 64 - 1),
+          reflected_xpow_mod(fold_bits - 1)};
+}
+constexpr auto FOLD_BY_128 = fold_constants<128>();
+constexpr auto FOLD_BY_512 = fold_constants<512>();
+
+__attribute__((target("pclmul,sse4.1"))) inline __m128i
+fold(__m128i block, __m128i constants) {
+  return _mm_xor_si128(_mm_clmulepi64_si128(block, constants, 0x00),
+                       _mm_clmulepi64_si128(block, constants, 0x11));
+}
+
+__attribute__((target("pclmul,sse4.1"))) inline __m128i
+load_block(const char *data) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+// Folds the input down into a single 128-bit block that has the same
+// remainder as the data consumed so far, then hands that block and the
+// remaining tail to the table implementation for the final reduction.
+__attribute__((target("pclmul,sse4.1"))) std::uint64_t
+crc64_clmul_impl(std::uint64_t crc, const char *data, std::size_t len) {
+  constexpr std::size_t LANES_SIZE = 64;
+  constexpr std::size_t BLOCK_SIZE = 16;
+  if (len < LANES_SIZE) {
+    return crc64_slicing_by_8(crc, data, len);
+  }
+  const auto by_128 =
+      _mm_set_epi64x(static_cast<long long>(FOLD_BY_128[1]),
+                     static_cast<long long>(FOLD_BY_128[0]));
+  const auto by_512 =
+      _mm_set_epi64x(static_cast<long long>(FOLD_BY_512[1]),
+                     static_cast<long long>(FOLD_BY_512[0]));
+
+  // Four independent lanes hide the latency of the multiplications. The
+  // running crc is xor'ed into the first 8 bytes, just like the table
+  // algorithm would do.
+  auto lane0 = _mm_xor_si128(load_block(data),
+                             _mm_cvtsi64_si128(static_cast<long long>(crc)));
+  auto lane1 = load_block(data + BLOCK_SIZE);
+  auto lane2 = load_block(data + (2 * BLOCK_SIZE));
+  auto lane3 = load_block(data + (3 * BLOCK_SIZE));
+  data += LANES_SIZE;
+  len -= LANES_SIZE;
+  while (len >= LANES_SIZE) {
+    lane0 = _mm_xor_si128(fold(lane0, by_512), load_block(data));
+    lane1 = _mm_xor_si128(fold(lane1, by_512), load_block(data + BLOCK_SIZE));
+    lane2 = _mm_xor_si128(fold(lane2, by_512),
+                          load_block(data + (2 * BLOCK_SIZE)));
+    lane3 = _mm_xor_si128(fold(lane3, by_512),
+                          load_block(data + (3 * BLOCK_SIZE)));
+    data += LANES_SIZE;
+    len -= LANES_SIZE;
+  }
+
+  // Merge the lanes into one, then fold in any remaining whole blocks.
+  lane1 = _mm_xor_si128(fold(lane0, by_128), lane1);
+  lane2 = _mm_xor_si128(fold(lane1, by_128), lane2);
+  auto folded = _mm_xor_si128(fold(lane2, by_128), lane3);
+  while (len >= BLOCK_SIZE) {
+    folded = _mm_xor_si128(fold(folded, by_128), load_block(data));
+    data += BLOCK_SIZE;
+    len -= BLOCK_SIZE;
+  }
+
+  std::array<char, BLOCK_SIZE> remainder{};
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(remainder.data()), folded);
+  crc = crc64_slicing_by_8(0, remainder.data(), remainder.size());
+  return crc64_slicing_by_8(crc, data, len);
+}
+
+#endif
+
+} // namespace
+
+std::uint64_t crc64(std::uint64_t crc, std::string_view data) {
+  return has_crc64_clmul() ? crc64_clmul(crc, data)
+                           : crc64_slicing_by_8(crc, data);
+}
+
+std::uint64_t crc64_slicing_by_8(std::uint64_t crc, std::string_view data) {
+  return crc64_slicing_by_8(crc, data.data(), data.size());
+}
+
+std::uint64_t crc64_clmul(std::uint64_t crc, std::string_view data) {
+#ifdef CRC64_HAVE_CLMUL
+  if (has_crc64_clmul()) {
+    return crc64_clmul_impl(crc, data.data(), data.size());
+  }
+#endif
+  return crc64_slicing_by_8(crc, data.data(), data.size());
+}
+
+bool has_crc64_clmul() {
+#ifdef CRC64_HAVE_CLMUL
+  static const bool supported =
+      __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+  return supported;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// System includes.
+#include <cstdint>
+#include <string_view>
+
+// The Jones CRC64 checksum used by Redis to protect RDB files (reflected input
+// and output, zero initial value, no final xor). See
+// https://github.com/redis/redis/blob/unstable/src/crc64.c for the reference.
+//
+// Every function here continues a running checksum, so a large input can be
+// checksummed piece by piece: start with a crc of 0 and pass in the result of
+// the previous call along with the next chunk of data.
+
+// Computes the checksum using the fastest implementation the CPU supports.
+std::uint64_t crc64(std::uint64_t crc, std::string_view data);
+
+// Portable table-driven implementation that consumes 8 bytes per step.
+std::uint64_t crc64_slicing_by_8(std::uint64_t crc, std::string_view data);
+
+// Carry-less multiplication (PCLMULQDQ) implementation that folds 64 bytes per
+// step. Falls back to slicing-by-8 when the CPU lacks the instruction, so it is
+// always safe to call.
+std::uint64_t crc64_clmul(std::uint64_t crc, std::string_view data);
+
+// Whether crc64_clmul() can use the PCLMULQDQ instruction on this CPU.
+bool has_crc64_clmul();
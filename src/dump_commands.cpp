@@ -0,0 +1,119 @@
+// This source file's own header include.
+#include "dump_commands.hpp"
+
+// System includes.
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "redis_core.hpp"
+#include "storage.hpp"
+#include "time.hpp"
+#include "utils.hpp"
+
+namespace {
+
+Message error(std::string message) {
+  return Message{std::move(message), DataType::SimpleError};
+}
+
+struct RestoreOptions {
+  bool replace = false;
+  bool absolute_ttl = false;
+};
+
+// Parses the options after RESTORE key ttl payload. IDLETIME and FREQ are
+// accepted and ignored, since we don't track access times.
+std::optional<RestoreOptions> parse_restore_options(const Command &command) {
+  RestoreOptions options{};
+  const auto &args = command.arguments;
+  for (std::size_t i = 3; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "replace") {
+      options.replace = true;
+    } else if (option == "absttl") {
+      options.absolute_ttl = true;
+    } else if ((option == "idletime" || option == "freq") &&
+               i + 1 < args.size() && parse_canonical_int(args[i + 1])) {
+      ++i;
+    } else {
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+Message restore(const Command &command, Cache &cache) {
+  const auto &key = command.arguments[0];
+  const auto options = parse_restore_options(command);
+  if (!options) {
+    return error("ERR syntax error");
+  }
+  const auto ttl = parse_canonical_int(command.arguments[1]);
+  if (!ttl) {
+    return error(NOT_AN_INTEGER_ERROR);
+  }
+  if (*ttl < 0) {
+    return error("ERR Invalid TTL value, must be >= 0");
+  }
+  if (!options->replace && cache.type(key)) {
+    return error("BUSYKEY Target key name already exists.");
+  }
+  auto value = restore_value(command.arguments[2]);
+  if (!value) {
+    return error("ERR DUMP payload version or checksum are wrong");
+  }
+  // A TTL of 0 means the key never expires.
+  Cache::ExpiryValueT expiry{};
+  if (*ttl > 0) {
+    expiry = options->absolute_ttl
+                 ? unix_timestamp_to_steady_clock<std::chrono::milliseconds>(
+                       static_cast<std::size_t>(*ttl))
+                 : std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(*ttl);
+  }
+  cache.remove(key, false);
+  // An absolute TTL may already be in the past, in which case the key is
+  // just gone.
+  if (!expiry || *expiry > std::chrono::steady_clock::now()) {
+    std::unordered_map<Cache::KeyT, Cache::EntryT> entries{};
+    entries.emplace(key, Cache::EntryT{std::move(*value), expiry});
+    cache.insert(std::move(entries));
+  }
+  return Message{"OK", DataType::SimpleString};
+}
+
+} // namespace
+
+std::optional<Message> handle_dump_command(const Command &command,
+                                           Cache &cache) {
+  if (command.verb == CommandVerb::Dump) {
+    return cache.read(command.arguments.front(),
+                      [](const Cache::ValueT *value) {
+                        return value ? Message{dump_value(*value),
+                                               DataType::BulkString}
+                                     : Message{"", DataType::NullBulkString};
+                      });
+  }
+  if (command.verb == CommandVerb::Restore) {
+    return restore(command, cache);
+  }
+  return std::nullopt;
+}
+
+Command make_propagated_restore(const Command &command) {
+  const auto options = parse_restore_options(command);
+  const auto ttl = parse_canonical_int(command.arguments[1]);
+  if (!options || options->absolute_ttl || !ttl || *ttl <= 0) {
+    return command;
+  }
+  Command propagated = command;
+  propagated.arguments[1] = std::to_string(
+      steady_clock_to_unix_timestamp<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() + std::chrono::milliseconds(*ttl)));
+  propagated.arguments.emplace_back("ABSTTL");
+  return propagated;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+class Cache;
+
+// Applies DUMP, which serializes a key's value, and RESTORE, which creates a
+// key from such a payload, and returns the reply, or nullopt for any other
+// command.
+std::optional<Message> handle_dump_command(const Command &command,
+                                           Cache &cache);
+
+// Rewrites RESTORE so that replaying it later gives the key the expiry time it
+// got now: a relative TTL becomes an absolute one (ABSTTL).
+Command make_propagated_restore(const Command &command);
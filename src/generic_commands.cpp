@@ -0,0 +1,147 @@
+// This source file's own header include.
+#include "generic_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "lazy_free.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+#include "value.hpp"
+
+namespace {
+
+Message ping(const Command &command) {
+  // If PING had an argument, reply with just that argument like ECHO would.
+  if (command.arguments.size() == 1) {
+    return Message{command.arguments.front(), DataType::BulkString};
+  }
+  // Otherwise, reply with the simple string "PONG".
+  return Message{"PONG", DataType::SimpleString};
+}
+
+Message get(const Command &command, const Cache &cache) {
+  // TODO we don't currently handle "*" globs or multiple keys.
+  const auto &key = command.arguments.front();
+  const auto value = cache.get(key);
+  if (value) {
+    return Message{*value, DataType::BulkString};
+  }
+  if (cache.type(key).has_value()) {
+    return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+  }
+  return Message{"", DataType::NullBulkString};
+}
+
+Message set(const Command &command, Cache &cache) {
+  const auto &key = command.arguments.front();
+  const auto &value = command.arguments[1];
+  std::optional<std::chrono::milliseconds> expiry{};
+  if (command.arguments.size() == 4) {
+    const auto option = tolower(command.arguments[2]);
+    const auto num = std::stoll(command.arguments[3]);
+    if (option == "px") {
+      expiry = std::chrono::milliseconds(num);
+    } else if (option == "pxat") {
+      // An absolute unix time, which may already be in the past.
+      expiry = std::chrono::milliseconds(num) -
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch());
+    }
+  }
+  cache.set(key, value, expiry);
+  return Message{"OK", DataType::SimpleString};
+}
+
+Message config_get(const Command &command, const Config &config) {
+  // TODO we don't currently handle "*" globs or multiple keys.
+  const auto &key = command.arguments.front();
+  std::optional<std::string> value{};
+  if (tolower(key) == "dir") {
+    value = config.dir;
+  } else if (tolower(key) == "dbfilename") {
+    value = config.dbfilename;
+  } else if (tolower(key) == "timeout") {
+    value = std::to_string(config.timeout);
+  } else if (tolower(key) == "tcp-keepalive") {
+    value = std::to_string(config.tcp_keepalive);
+  } else if (tolower(key) == "slowlog-log-slower-than") {
+    value = std::to_string(config.slowlog_log_slower_than);
+  } else if (tolower(key) == "slowlog-max-len") {
+    value = std::to_string(config.slowlog_max_len);
+  }
+
+  // Reply with a map of the key to its value if found.
+  if (value.has_value()) {
+    return Message(
+        Message::NestedVariantT{Message(key, DataType::BulkString),
+                                Message(*value, DataType::BulkString)},
+        DataType::Map);
+  }
+  // Otherwise, respond with an empty map.
+  return Message{Message::NestedVariantT{}, DataType::Map};
+}
+
+Message keys(const Cache &cache) {
+  // TODO actually use the KEYS pattern (assume "*" for now).
+  // Get all the keys from the cache, and make BulkString messages out of each
+  // one.
+  const std::vector<std::string> keys = cache.keys();
+  std::vector<Message> key_messages{};
+  key_messages.reserve(keys.size());
+  std::transform(
+      keys.cbegin(), keys.cend(), std::back_inserter(key_messages),
+      [](const auto &key) { return Message{key, DataType::BulkString}; });
+  // Send them back as an array of these BulkString messages.
+  return Message{key_messages, DataType::Array};
+}
+
+// UNLINK is DEL that frees the values in the background (if they are big
+// enough to be worth it).
+Message del(const Command &command, Cache &cache, const LazyFree *lazy_free) {
+  const bool lazy = command.verb == CommandVerb::Unlink ||
+                    (lazy_free && lazy_free->policy().lazy_user_del);
+  const auto num_removed =
+      std::count_if(command.arguments.cbegin(), command.arguments.cend(),
+                    [&cache, lazy](const std::string &key) {
+                      return cache.remove(key, lazy);
+                    });
+  return Message{std::to_string(num_removed), DataType::Integer};
+}
+
+} // namespace
+
+std::optional<Message> handle_generic_command(const Command &command,
+                                              const Config &config,
+                                              Cache &cache,
+                                              const LazyFree *lazy_free) {
+  switch (command.verb) {
+  case CommandVerb::Ping:
+    return ping(command);
+  case CommandVerb::Echo:
+    return Message{command.arguments.front(), DataType::BulkString};
+  case CommandVerb::Get:
+    return get(command, cache);
+  case CommandVerb::Set:
+    return set(command, cache);
+  case CommandVerb::Type: {
+    const auto type = cache.type(command.arguments.front());
+    return Message{type ? type_name(*type) : "none", DataType::SimpleString};
+  }
+  case CommandVerb::ConfigGet:
+    return config_get(command, config);
+  case CommandVerb::Keys:
+    return keys(cache);
+  case CommandVerb::Del:
+  case CommandVerb::Unlink:
+    return del(command, cache, lazy_free);
+  default:
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+class LazyFree;
+
+// Applies the commands that aren't about one type of value (PING, ECHO, GET,
+// SET, TYPE, KEYS, CONFIG GET, DEL and UNLINK) and returns the reply, or
+// nullopt for any other command. DEL frees big values in the background if
+// lazy_free (when given) says to, and UNLINK always does.
+std::optional<Message> handle_generic_command(const Command &command,
+                                              const Config &config,
+                                              Cache &cache,
+                                              const LazyFree *lazy_free);
@@ -0,0 +1,121 @@
+// This source file's own header include.
+#include "glob.hpp"
+
+// System includes.
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Matches the character against the class starting at pattern[pos] (the
+// "["). Returns whether it matched and where the pattern continues after the
+// class. An unterminated class runs to the end of the pattern, like in Redis.
+std::pair<bool, std::size_t> match_class(std::string_view pattern,
+                                         std::size_t pos, char character) {
+  ++pos;
+  const bool negate = pos < pattern.size() && pattern[pos] == '^';
+  if (negate) {
+    ++pos;
+  }
+  bool matched = false;
+  while (pos < pattern.size() && pattern[pos] != ']') {
+    if (pattern[pos] == '\\' && pos + 1 < pattern.size()) {
+      matched = matched || pattern[pos + 1] == character;
+      pos += 2;
+    } else if (pos + 2 < pattern.size() && pattern[pos + 1] == '-' &&
+               pattern[pos + 2] != ']') {
+      // Ranges work in either direction ("[a-z]" or "[z-a]").
+      auto low = pattern[pos];
+      auto high = pattern[pos + 2];
+      if (low > high) {
+        std::swap(low, high);
+      }
+      matched = matched || (character >= low && character <= high);
+      pos += 3;
+    } else {
+      matched = matched || pattern[pos] == character;
+      ++pos;
+    }
+  }
+  // Skip the closing "]".
+  if (pos < pattern.size()) {
+    ++pos;
+  }
+  return {matched != negate, pos};
+}
+
+} // namespace
+
+bool glob_match(std::string_view pattern, std::string_view str) {
+  std::size_t pattern_pos = 0;
+  std::size_t str_pos = 0;
+  // Where to resume after the last "*" if the rest fails to match: the
+  // pattern right after the star, and the next string position it could
+  // swallow up to. Only the last star ever needs to be retried.
+  std::optional<std::pair<std::size_t, std::size_t>> backtrack{};
+  while (str_pos < str.size()) {
+    if (pattern_pos < pattern.size()) {
+      const char token = pattern[pattern_pos];
+      if (token == '*') {
+        ++pattern_pos;
+        backtrack = {pattern_pos, str_pos};
+        continue;
+      }
+      if (token == '?') {
+        ++pattern_pos;
+        ++str_pos;
+        continue;
+      }
+      if (token == '[') {
+        const auto [matched, next] =
+            match_class(pattern, pattern_pos, str[str_pos]);
+        if (matched) {
+          pattern_pos = next;
+          ++str_pos;
+          continue;
+        }
+      } else {
+        const bool escaped =
+            token == '\\' && pattern_pos + 1 < pattern.size();
+        const char literal = escaped ? pattern[pattern_pos + 1] : token;
+        if (literal == str[str_pos]) {
+          pattern_pos += escaped ? 2 : 1;
+          ++str_pos;
+          continue;
+        }
+      }
+    }
+    if (!backtrack) {
+      return false;
+    }
+    // Let the last star swallow one more character and try again.
+    pattern_pos = backtrack->first;
+    str_pos = ++backtrack->second;
+  }
+  while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+    ++pattern_pos;
+  }
+  return pattern_pos == pattern.size();
+}
+
+std::pair<std::string, std::size_t>
+glob_literal_prefix(std::string_view pattern) {
+  std::string prefix{};
+  std::size_t pos = 0;
+  while (pos < pattern.size()) {
+    const char token = pattern[pos];
+    if (token == '*' || token == '?' || token == '[') {
+      break;
+    }
+    if (token == '\\' && pos + 1 < pattern.size()) {
+      prefix.push_back(pattern[pos + 1]);
+      pos += 2;
+    } else {
+      prefix.push_back(token);
+      ++pos;
+    }
+  }
+  return {std::move(prefix), pos};
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Whether the string matches the glob-style pattern, the way Redis matches
+// patterns for KEYS, SCAN's MATCH option and the like. Supports "*", "?",
+// character classes ("[abc]", "[^abc]" and "[a-z]") and escaping any of
+// these with a backslash.
+bool glob_match(std::string_view pattern, std::string_view str);
+
+// The literal text the pattern starts with (unescaped), which every string it
+// matches starts with too, and how many characters of the pattern it takes
+// up. e.g. news.\*.* starts with "news.*." and takes up 8 characters.
+std::pair<std::string, std::size_t>
+glob_literal_prefix(std::string_view pattern);
@@ -0,0 +1,356 @@
+// This source file's own header include.
+#include "hash_commands.hpp"
+
+// System includes.
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "glob.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+using HashTable = std::unordered_map<std::string, std::string>;
+
+constexpr auto HASH_VALUE_NOT_AN_INTEGER_ERROR =
+    "ERR hash value is not an integer";
+constexpr auto OVERFLOW_ERROR = "ERR increment or decrement would overflow";
+constexpr auto INVALID_CURSOR_ERROR = "ERR invalid cursor";
+constexpr auto SYNTAX_ERROR = "ERR syntax error";
+
+std::size_t hash_size(const HashValue &hash) {
+  if (const auto *listpack = std::get_if<Listpack>(&hash)) {
+    return listpack->size() / 2;
+  }
+  return std::get<HashTable>(hash).size();
+}
+
+std::optional<std::string> hash_get(const HashValue &hash,
+                                    const std::string &field) {
+  if (const auto *listpack = std::get_if<Listpack>(&hash)) {
+    const auto index = listpack->find(field, 1);
+    if (!index) {
+      return std::nullopt;
+    }
+    std::string value{};
+    listpack->for_each(*index + 1, 1, [&value](const Listpack::Element &elem) {
+      value = Listpack::to_string(elem);
+    });
+    return value;
+  }
+  const auto &table = std::get<HashTable>(hash);
+  const auto entry = table.find(field);
+  if (entry == table.end()) {
+    return std::nullopt;
+  }
+  return entry->second;
+}
+
+// Calls func(field, value) on every pair in the hash.
+template <typename Func>
+void hash_for_each(const HashValue &hash, Func &&func) {
+  if (const auto *listpack = std::get_if<Listpack>(&hash)) {
+    std::optional<std::string> field{};
+    listpack->for_each([&field, &func](const Listpack::Element &elem) {
+      if (!field) {
+        field = Listpack::to_string(elem);
+      } else {
+        func(*field, Listpack::to_string(elem));
+        field.reset();
+      }
+    });
+    return;
+  }
+  for (const auto &[field, value] : std::get<HashTable>(hash)) {
+    func(field, value);
+  }
+}
+
+void convert_to_table(HashValue &hash) {
+  HashTable table{};
+  table.reserve(hash_size(hash));
+  hash_for_each(hash, [&table](const std::string &field,
+                               const std::string &value) {
+    table.emplace(field, value);
+  });
+  hash = std::move(table);
+}
+
+// Sets the field, converting the hash to a table first if it would outgrow
+// the listpack. Returns true if the field is new.
+bool hash_set(HashValue &hash, const std::string &field,
+              const std::string &value, const Config &config) {
+  if (auto *listpack = std::get_if<Listpack>(&hash)) {
+    const bool fits = field.size() <= config.hash_max_listpack_value &&
+                      value.size() <= config.hash_max_listpack_value;
+    const auto index = fits ? listpack->find(field, 1) : std::nullopt;
+    if (index) {
+      listpack->replace(*index + 1, value);
+      return false;
+    }
+    if (fits && hash_size(hash) < config.hash_max_listpack_entries) {
+      listpack->push_back(field);
+      listpack->push_back(value);
+      return true;
+    }
+    convert_to_table(hash);
+  }
+  return std::get<HashTable>(hash).insert_or_assign(field, value).second;
+}
+
+bool hash_delete(HashValue &hash, const std::string &field) {
+  if (auto *listpack = std::get_if<Listpack>(&hash)) {
+    const auto index = listpack->find(field, 1);
+    if (index) {
+      listpack->erase(*index, 2);
+    }
+    return index.has_value();
+  }
+  return std::get<HashTable>(hash).erase(field) > 0;
+}
+
+Message bulk_or_null(const std::optional<std::string> &value) {
+  if (value) {
+    return Message{*value, DataType::BulkString};
+  }
+  return Message{"", DataType::NullBulkString};
+}
+
+// Calls func(hash) with the hash stored at the key (creating an empty one if
+// the key is missing), removing the key if func leaves the hash empty.
+template <typename Func>
+Message update_hash(Cache &cache, const std::string &key, Func &&func) {
+  return cache.update(key, [&func](std::optional<Value> &value) {
+    if (!value) {
+      value = HashValue{Listpack{}};
+    }
+    auto *hash = std::get_if<HashValue>(&*value);
+    if (hash == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    auto reply = func(*hash);
+    if (hash_size(*hash) == 0) {
+      value.reset();
+    }
+    return reply;
+  });
+}
+
+// Calls func(hash) with the hash stored at the key, or replies with
+// missing_reply if there is none.
+template <typename Func>
+Message read_hash(const Cache &cache, const std::string &key,
+                  const Message &missing_reply, Func &&func) {
+  return cache.read(key, [&](const Value *value) {
+    if (value == nullptr) {
+      return missing_reply;
+    }
+    const auto *hash = std::get_if<HashValue>(value);
+    if (hash == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return func(*hash);
+  });
+}
+
+Message set(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  // The key, then field and value pairs.
+  if (args.size() % 2 == 0) {
+    return Message{"ERR wrong number of arguments for 'hset' command",
+                   DataType::SimpleError};
+  }
+  return update_hash(cache, args.front(), [&](HashValue &hash) {
+    std::size_t num_added = 0;
+    for (std::size_t i = 1; i + 1 < args.size(); i += 2) {
+      num_added += hash_set(hash, args[i], args[i + 1], config) ? 1 : 0;
+    }
+    return Message{std::to_string(num_added), DataType::Integer};
+  });
+}
+
+Message delete_fields(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  return update_hash(cache, args.front(), [&args](HashValue &hash) {
+    std::size_t num_removed = 0;
+    for (auto field = args.cbegin() + 1; field != args.cend(); ++field) {
+      num_removed += hash_delete(hash, *field) ? 1 : 0;
+    }
+    return Message{std::to_string(num_removed), DataType::Integer};
+  });
+}
+
+Message increment(const Command &command, const Config &config,
+                  Cache &cache) {
+  const auto &field = command.arguments[1];
+  const auto increment = parse_canonical_int(command.arguments[2]);
+  if (!increment) {
+    return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+  }
+  return update_hash(
+      cache, command.arguments.front(), [&](HashValue &hash) {
+        std::int64_t current = 0;
+        if (const auto value = hash_get(hash, field)) {
+          const auto parsed = parse_canonical_int(*value);
+          if (!parsed) {
+            return Message{HASH_VALUE_NOT_AN_INTEGER_ERROR,
+                           DataType::SimpleError};
+          }
+          current = *parsed;
+        }
+        std::int64_t result = 0;
+        if (__builtin_add_overflow(current, *increment, &result)) {
+          return Message{OVERFLOW_ERROR, DataType::SimpleError};
+        }
+        hash_set(hash, field, std::to_string(result), config);
+        return Message{std::to_string(result), DataType::Integer};
+      });
+}
+
+Message get(const Command &command, const Cache &cache) {
+  return read_hash(cache, command.arguments.front(),
+                   Message{"", DataType::NullBulkString},
+                   [&command](const HashValue &hash) {
+                     return bulk_or_null(
+                         hash_get(hash, command.arguments[1]));
+                   });
+}
+
+Message get_many(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  const auto reply = [&args](const HashValue *hash) {
+    Message::NestedVariantT values{};
+    values.reserve(args.size() - 1);
+    for (auto field = args.cbegin() + 1; field != args.cend(); ++field) {
+      values.push_back(bulk_or_null(
+          hash != nullptr ? hash_get(*hash, *field) : std::nullopt));
+    }
+    return Message{std::move(values), DataType::Array};
+  };
+  return read_hash(cache, args.front(), reply(nullptr),
+                   [&reply](const HashValue &hash) { return reply(&hash); });
+}
+
+Message get_all(const Command &command, const Cache &cache) {
+  return read_hash(
+      cache, command.arguments.front(),
+      Message{Message::NestedVariantT{}, DataType::Map},
+      [](const HashValue &hash) {
+        Message::NestedVariantT pairs{};
+        pairs.reserve(hash_size(hash) * 2);
+        hash_for_each(hash, [&pairs](const std::string &field,
+                                     const std::string &value) {
+          pairs.emplace_back(field, DataType::BulkString);
+          pairs.emplace_back(value, DataType::BulkString);
+        });
+        return Message{std::move(pairs), DataType::Map};
+      });
+}
+
+// HSCAN key cursor [MATCH pattern] [COUNT count] [NOVALUES]
+Message scan(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  const auto cursor = parse_canonical_int(args[1]);
+  if (!cursor || *cursor < 0) {
+    return Message{INVALID_CURSOR_ERROR, DataType::SimpleError};
+  }
+  std::optional<std::string> pattern{};
+  std::size_t count = 10;
+  bool with_values = true;
+  for (std::size_t i = 2; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    const bool has_value = i + 1 < args.size();
+    if (option == "match" && has_value) {
+      pattern = args[++i];
+    } else if (option == "count" && has_value) {
+      const auto parsed = parse_canonical_int(args[++i]);
+      if (!parsed) {
+        return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+      }
+      if (*parsed < 1) {
+        return Message{SYNTAX_ERROR, DataType::SimpleError};
+      }
+      count = static_cast<std::size_t>(*parsed);
+    } else if (option == "novalues") {
+      with_values = false;
+    } else {
+      return Message{SYNTAX_ERROR, DataType::SimpleError};
+    }
+  }
+
+  const auto reply = [](std::size_t next_cursor,
+                        Message::NestedVariantT elements) {
+    return Message{
+        Message::NestedVariantT{
+            Message{std::to_string(next_cursor), DataType::BulkString},
+            Message{std::move(elements), DataType::Array}},
+        DataType::Array};
+  };
+  return read_hash(
+      cache, args.front(), reply(0, {}), [&](const HashValue &hash) {
+        Message::NestedVariantT elements{};
+        const auto add = [&](const std::string &field,
+                             const std::string &value) {
+          if (pattern && !glob_match(*pattern, field)) {
+            return;
+          }
+          elements.emplace_back(field, DataType::BulkString);
+          if (with_values) {
+            elements.emplace_back(value, DataType::BulkString);
+          }
+        };
+        // Small hashes are returned whole in one go, like in Redis.
+        if (std::holds_alternative<Listpack>(hash)) {
+          hash_for_each(hash, add);
+          return reply(0, std::move(elements));
+        }
+        // The cursor is the next bucket to visit. If the table gets rehashed
+        // between calls, the buckets move around, so fields may be returned
+        // twice or (unlike in Redis) skipped.
+        const auto &table = std::get<HashTable>(hash);
+        auto bucket = static_cast<std::size_t>(*cursor);
+        std::size_t num_visited = 0;
+        for (; bucket < table.bucket_count() && num_visited < count;
+             ++bucket) {
+          for (auto entry = table.begin(bucket); entry != table.end(bucket);
+               ++entry) {
+            add(entry->first, entry->second);
+            ++num_visited;
+          }
+        }
+        return reply(bucket < table.bucket_count() ? bucket : 0,
+                     std::move(elements));
+      });
+}
+
+} // namespace
+
+std::optional<Message> handle_hash_command(const Command &command,
+                                           const Config &config,
+                                           Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::HSet:
+    return set(command, config, cache);
+  case CommandVerb::HGet:
+    return get(command, cache);
+  case CommandVerb::HMGet:
+    return get_many(command, cache);
+  case CommandVerb::HGetAll:
+    return get_all(command, cache);
+  case CommandVerb::HDel:
+    return delete_fields(command, cache);
+  case CommandVerb::HIncrBy:
+    return increment(command, config, cache);
+  case CommandVerb::HScan:
+    return scan(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the hash commands (HSET, HGET, HMGET, HGETALL, HDEL, HINCRBY and
+// HSCAN) and returns the reply, or nullopt for any other command. Hashes stay
+// listpacks until they outgrow config.hash_max_listpack_entries or
+// config.hash_max_listpack_value.
+std::optional<Message> handle_hash_command(const Command &command,
+                                           const Config &config, Cache &cache);
@@ -0,0 +1,544 @@
+// This source file's own header include.
+#include "hyperloglog.hpp"
+
+// System includes.
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HLL_HAVE_AVX2 1
+#endif
+
+namespace {
+
+constexpr std::string_view MAGIC = "HYLL";
+constexpr std::size_t ENCODING_OFFSET = 4;
+constexpr std::size_t CARDINALITY_OFFSET = 8;
+constexpr std::size_t HEADER_SIZE = 16;
+constexpr unsigned char DENSE = 0;
+constexpr unsigned char SPARSE = 1;
+// The low bits of the hash pick the register, the rest are counted.
+constexpr std::size_t INDEX_BITS = 14;
+constexpr std::size_t COUNTED_BITS = 64 - INDEX_BITS;
+constexpr std::size_t REGISTER_BITS = 6;
+constexpr std::uint8_t REGISTER_MASK = 0x3F;
+constexpr std::size_t PACKED_SIZE = HLL_REGISTERS * REGISTER_BITS / 8;
+constexpr std::size_t DENSE_SIZE = HEADER_SIZE + PACKED_SIZE;
+// The longest runs and biggest value the sparse opcodes can hold.
+constexpr std::size_t ZERO_MAX_RUN = 64;
+constexpr std::size_t XZERO_MAX_RUN = 16384;
+constexpr std::size_t VALUE_MAX_RUN = 4;
+constexpr std::uint8_t SPARSE_VALUE_MAX = 32;
+
+using Histogram = std::array<std::uint32_t, 64>;
+
+unsigned char byte_at(std::string_view bytes, std::size_t index) {
+  return static_cast<unsigned char>(bytes[index]);
+}
+
+// MurmurHash2's 64-bit variant with the seed Redis uses, so elements land in
+// the same registers as in Redis.
+std::uint64_t murmur_hash64a(std::string_view key) {
+  constexpr std::uint64_t MULTIPLIER = 0xc6a4a7935bd1e995ULL;
+  constexpr int SHIFT = 47;
+  constexpr std::uint64_t SEED = 0xadc83b19ULL;
+  const auto len = key.size();
+  std::uint64_t hash = SEED ^ (len * MULTIPLIER);
+  std::size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    std::uint64_t word = 0;
+    for (std::size_t j = 0; j < 8; ++j) {
+      word |= static_cast<std::uint64_t>(byte_at(key, i + j)) << (8 * j);
+    }
+    word *= MULTIPLIER;
+    word ^= word >> SHIFT;
+    word *= MULTIPLIER;
+    hash ^= word;
+    hash *= MULTIPLIER;
+  }
+  if (i < len) {
+    for (std::size_t j = len - i; j > 0; --j) {
+      hash ^= static_cast<std::uint64_t>(byte_at(key, i + j - 1))
+              << (8 * (j - 1));
+    }
+    hash *= MULTIPLIER;
+  }
+  hash ^= hash >> SHIFT;
+  hash *= MULTIPLIER;
+  hash ^= hash >> SHIFT;
+  return hash;
+}
+
+// The element's register, and the value it bids for it: one more than the
+// number of trailing zero bits in the rest of the hash.
+std::pair<std::size_t, std::uint8_t> locate(std::string_view element) {
+  const auto hash = murmur_hash64a(element);
+  const auto counted =
+      (hash >> INDEX_BITS) | (std::uint64_t{1} << COUNTED_BITS);
+  return {hash & (HLL_REGISTERS - 1),
+          static_cast<std::uint8_t>(std::countr_zero(counted) + 1)};
+}
+
+void invalidate_count(std::string &hll) {
+  hll[CARDINALITY_OFFSET + 7] =
+      static_cast<char>(byte_at(hll, CARDINALITY_OFFSET + 7) | 0x80U);
+}
+
+std::string make_header(unsigned char encoding) {
+  std::string header(HEADER_SIZE, '\0');
+  std::ranges::copy(MAGIC, header.begin());
+  header[ENCODING_OFFSET] = static_cast<char>(encoding);
+  return header;
+}
+
+// Dense registers.
+
+std::uint8_t get_dense(std::string_view hll, std::size_t index) {
+  const auto bit = index * REGISTER_BITS;
+  const auto byte = HEADER_SIZE + (bit / 8);
+  const auto shift = bit % 8;
+  unsigned value = byte_at(hll, byte) >> shift;
+  // Registers starting in the low 3 bits fit in one byte.
+  if (shift > 8 - REGISTER_BITS) {
+    value |= static_cast<unsigned>(byte_at(hll, byte + 1)) << (8 - shift);
+  }
+  return static_cast<std::uint8_t>(value & REGISTER_MASK);
+}
+
+void set_dense(std::string &hll, std::size_t index, std::uint8_t value) {
+  const auto bit = index * REGISTER_BITS;
+  const auto byte = HEADER_SIZE + (bit / 8);
+  const auto shift = bit % 8;
+  hll[byte] = static_cast<char>(
+      (byte_at(hll, byte) & ~(unsigned{REGISTER_MASK} << shift)) |
+      (unsigned{value} << shift));
+  if (shift > 8 - REGISTER_BITS) {
+    hll[byte + 1] = static_cast<char>(
+        (byte_at(hll, byte + 1) & ~(unsigned{REGISTER_MASK} >> (8 - shift))) |
+        (unsigned{value} >> (8 - shift)));
+  }
+}
+
+// Calls func(index, values) on every 3 packed bytes, with the 4 registers
+// they hold.
+template <typename Func>
+void for_each_dense_group(std::string_view hll, std::size_t first_byte,
+                          Func &&func) {
+  for (std::size_t i = first_byte; i < PACKED_SIZE; i += 3) {
+    const unsigned first = byte_at(hll, HEADER_SIZE + i);
+    const unsigned second = byte_at(hll, HEADER_SIZE + i + 1);
+    const unsigned third = byte_at(hll, HEADER_SIZE + i + 2);
+    func(i / 3 * 4,
+         std::array{static_cast<std::uint8_t>(first & REGISTER_MASK),
+                    static_cast<std::uint8_t>(((first >> 6) | (second << 2)) &
+                                              REGISTER_MASK),
+                    static_cast<std::uint8_t>(((second >> 4) | (third << 4)) &
+                                              REGISTER_MASK),
+                    static_cast<std::uint8_t>(third >> 2)});
+  }
+}
+
+void merge_dense_portable(HllRegisters &registers, std::string_view hll,
+                          std::size_t first_byte) {
+  for_each_dense_group(
+      hll, first_byte, [&registers](std::size_t index, const auto &values) {
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          registers[index + i] = std::max(registers[index + i], values[i]);
+        }
+      });
+}
+
+#ifdef HLL_HAVE_AVX2
+// Merges the dense registers 32 at a time from 24 packed bytes. Each 32-bit
+// lane gets 3 packed bytes, whose 4 registers are then shifted into the
+// lane's 4 bytes. Leaves the last few registers for the caller.
+__attribute__((target("avx2"))) std::size_t
+merge_dense_avx2_impl(HllRegisters &registers, const char *packed) {
+  // The vector is loaded from 4 bytes before the packed bytes it needs, so
+  // the low half takes bytes 4 to 15 of its half and the high half (which
+  // starts 12 packed bytes later) bytes 0 to 11.
+  const auto shuffle = _mm256_setr_epi8(4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12,
+                                        -1, 13, 14, 15, -1, 0, 1, 2, -1, 3, 4,
+                                        5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const auto mask = _mm256_set1_epi32(REGISTER_MASK);
+  std::size_t i = 0;
+  // Stop before the load would read past the packed bytes.
+  for (; i + 28 <= PACKED_SIZE; i += 24) {
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto lanes = _mm256_shuffle_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(packed + i - 4)),
+        shuffle);
+    const auto values = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(lanes, mask),
+            _mm256_and_si256(_mm256_slli_epi32(lanes, 2),
+                             _mm256_slli_epi32(mask, 8))),
+        _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(lanes, 4),
+                                         _mm256_slli_epi32(mask, 16)),
+                        _mm256_and_si256(_mm256_slli_epi32(lanes, 6),
+                                         _mm256_slli_epi32(mask, 24))));
+    auto *dest = reinterpret_cast<__m256i *>(registers.data() + (i / 3 * 4));
+    _mm256_storeu_si256(dest,
+                        _mm256_max_epu8(_mm256_loadu_si256(dest), values));
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+  }
+  return i;
+}
+#endif
+
+// Sparse registers.
+
+struct SparseOp {
+  // How many registers it covers, their value, and its size in bytes.
+  std::size_t run;
+  std::uint8_t value;
+  std::size_t size;
+};
+
+// The opcode at pos, or nullopt if it is cut short.
+std::optional<SparseOp> decode_op(std::string_view hll, std::size_t pos) {
+  const auto byte = byte_at(hll, pos);
+  if ((byte & 0x80U) != 0) {
+    return SparseOp{(byte & 0x03U) + 1U,
+                    static_cast<std::uint8_t>(((byte >> 2U) & 0x1FU) + 1),
+                    1};
+  }
+  if ((byte & 0x40U) == 0) {
+    return SparseOp{(byte & 0x3FU) + 1U, 0, 1};
+  }
+  if (pos + 1 >= hll.size()) {
+    return std::nullopt;
+  }
+  return SparseOp{(((byte & 0x3FU) << 8U) | byte_at(hll, pos + 1)) + 1U, 0,
+                  2};
+}
+
+// Calls func(index, op) on every opcode of a well-formed sparse HyperLogLog,
+// until func returns false.
+template <typename Func>
+void for_each_sparse_op(std::string_view hll, Func &&func) {
+  std::size_t index = 0;
+  for (std::size_t pos = HEADER_SIZE; pos < hll.size();) {
+    const auto op = *decode_op(hll, pos);
+    if (!func(index, op)) {
+      return;
+    }
+    index += op.run;
+    pos += op.size;
+  }
+}
+
+// Builds the opcodes of a sparse HyperLogLog from runs of registers, merging
+// runs of the same value.
+class SparseWriter {
+public:
+  explicit SparseWriter(std::string &out) : out_(out) {}
+
+  void add(std::uint8_t value, std::size_t run) {
+    if (run == 0) {
+      return;
+    }
+    if (value != value_) {
+      flush();
+      value_ = value;
+    }
+    run_ += run;
+  }
+
+  void flush() {
+    while (run_ > 0) {
+      if (value_ == 0 && run_ > ZERO_MAX_RUN) {
+        const auto run = std::min(run_, XZERO_MAX_RUN);
+        out_.push_back(static_cast<char>(0x40U | ((run - 1) >> 8U)));
+        out_.push_back(static_cast<char>((run - 1) & 0xFFU));
+        run_ -= run;
+      } else if (value_ == 0) {
+        out_.push_back(static_cast<char>(run_ - 1));
+        run_ = 0;
+      } else {
+        const auto run = std::min(run_, VALUE_MAX_RUN);
+        out_.push_back(static_cast<char>(0x80U | ((value_ - 1U) << 2U) |
+                                         (run - 1)));
+        run_ -= run;
+      }
+    }
+  }
+
+private:
+  std::string &out_;
+  std::uint8_t value_ = 0;
+  std::size_t run_ = 0;
+};
+
+void merge_sparse(HllRegisters &registers, std::string_view hll) {
+  for_each_sparse_op(hll, [&registers](std::size_t index, const SparseOp &op) {
+    for (std::size_t i = index; i < index + op.run && op.value != 0; ++i) {
+      registers[i] = std::max(registers[i], op.value);
+    }
+    return true;
+  });
+}
+
+void to_dense(std::string &hll) {
+  HllRegisters registers{};
+  merge_sparse(registers, hll);
+  auto dense = hll_from_registers(registers, 0);
+  std::copy_n(hll.cbegin() + CARDINALITY_OFFSET,
+              HEADER_SIZE - CARDINALITY_OFFSET,
+              dense.begin() + CARDINALITY_OFFSET);
+  hll = std::move(dense);
+}
+
+// Sets the sparse register to the higher value by rewriting the opcodes
+// around it.
+void set_sparse(std::string &hll, std::size_t index, std::uint8_t value) {
+  std::string rewritten = hll.substr(0, HEADER_SIZE);
+  rewritten.reserve(hll.size() + 3);
+  SparseWriter writer(rewritten);
+  for_each_sparse_op(hll, [&](std::size_t first, const SparseOp &op) {
+    if (index >= first && index < first + op.run) {
+      writer.add(op.value, index - first);
+      writer.add(value, 1);
+      writer.add(op.value, first + op.run - index - 1);
+    } else {
+      writer.add(op.value, op.run);
+    }
+    return true;
+  });
+  writer.flush();
+  hll = std::move(rewritten);
+}
+
+// Histograms and estimates.
+
+Histogram histogram_of(std::string_view hll) {
+  Histogram histogram{};
+  if (hll_is_sparse(hll)) {
+    for_each_sparse_op(hll, [&histogram](std::size_t, const SparseOp &op) {
+      histogram[op.value] += static_cast<std::uint32_t>(op.run);
+      return true;
+    });
+  } else {
+    for_each_dense_group(hll, 0, [&histogram](std::size_t, const auto &values) {
+      for (const auto value : values) {
+        ++histogram[value];
+      }
+    });
+  }
+  return histogram;
+}
+
+double tau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double previous = 0.0;
+  double y = 1.0;
+  double z = 1 - x;
+  do {
+    x = std::sqrt(x);
+    previous = z;
+    y *= 0.5;
+    z -= std::pow(1 - x, 2) * y;
+  } while (previous != z);
+  return z / 3;
+}
+
+double sigma(double x) {
+  if (x == 1.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double previous = 0.0;
+  double y = 1.0;
+  double z = x;
+  do {
+    x *= x;
+    previous = z;
+    z += x * y;
+    y += y;
+  } while (previous != z);
+  return z;
+}
+
+// Ertl's estimator from "New cardinality estimation algorithms for
+// HyperLogLog sketches" (https://arxiv.org/abs/1702.01284), which needs no
+// bias correction tables.
+std::uint64_t estimate(const Histogram &histogram) {
+  constexpr double ALPHA_INF = 0.721347520444481703680;
+  constexpr auto NUM_REGISTERS = static_cast<double>(HLL_REGISTERS);
+  double z = NUM_REGISTERS *
+             tau((NUM_REGISTERS - histogram[COUNTED_BITS + 1]) / NUM_REGISTERS);
+  for (std::size_t j = COUNTED_BITS; j >= 1; --j) {
+    z += histogram[j];
+    z *= 0.5;
+  }
+  z += NUM_REGISTERS * sigma(histogram[0] / NUM_REGISTERS);
+  return static_cast<std::uint64_t>(
+      std::llround(ALPHA_INF * NUM_REGISTERS * NUM_REGISTERS / z));
+}
+
+} // namespace
+
+std::string hll_create() {
+  auto hll = make_header(SPARSE);
+  SparseWriter writer(hll);
+  writer.add(0, HLL_REGISTERS);
+  writer.flush();
+  return hll;
+}
+
+bool is_hll(std::string_view bytes) {
+  if (bytes.size() < HEADER_SIZE || !bytes.starts_with(MAGIC)) {
+    return false;
+  }
+  if (byte_at(bytes, ENCODING_OFFSET) == DENSE) {
+    return bytes.size() == DENSE_SIZE;
+  }
+  if (byte_at(bytes, ENCODING_OFFSET) != SPARSE) {
+    return false;
+  }
+  // The opcodes must cover every register exactly.
+  std::size_t num_registers = 0;
+  for (std::size_t pos = HEADER_SIZE; pos < bytes.size();) {
+    const auto op = decode_op(bytes, pos);
+    if (!op) {
+      return false;
+    }
+    num_registers += op->run;
+    pos += op->size;
+  }
+  return num_registers == HLL_REGISTERS;
+}
+
+bool hll_is_sparse(std::string_view hll) {
+  return byte_at(hll, ENCODING_OFFSET) == SPARSE;
+}
+
+bool hll_add(std::string &hll, std::string_view element,
+             std::size_t sparse_max_bytes) {
+  const auto [index, value] = locate(element);
+  if (hll_is_sparse(hll)) {
+    std::uint8_t old_value = 0;
+    for_each_sparse_op(hll, [&](std::size_t first, const SparseOp &op) {
+      old_value = op.value;
+      return index >= first + op.run;
+    });
+    if (old_value >= value) {
+      return false;
+    }
+    if (value <= SPARSE_VALUE_MAX) {
+      set_sparse(hll, index, value);
+      if (hll.size() > sparse_max_bytes) {
+        to_dense(hll);
+      }
+      invalidate_count(hll);
+      return true;
+    }
+    to_dense(hll);
+  }
+  if (get_dense(hll, index) >= value) {
+    return false;
+  }
+  set_dense(hll, index, value);
+  invalidate_count(hll);
+  return true;
+}
+
+std::optional<std::uint64_t> hll_cached_count(std::string_view hll) {
+  if ((byte_at(hll, CARDINALITY_OFFSET + 7) & 0x80U) != 0) {
+    return std::nullopt;
+  }
+  std::uint64_t count = 0;
+  for (std::size_t i = 8; i > 0; --i) {
+    count = (count << 8U) | byte_at(hll, CARDINALITY_OFFSET + i - 1);
+  }
+  return count;
+}
+
+std::uint64_t hll_count(std::string &hll) {
+  if (const auto cached = hll_cached_count(hll)) {
+    return *cached;
+  }
+  const auto count = estimate(histogram_of(hll));
+  for (std::size_t i = 0; i < 8; ++i) {
+    hll[CARDINALITY_OFFSET + i] = static_cast<char>(count >> (8 * i));
+  }
+  return count;
+}
+
+void hll_merge(HllRegisters &registers, std::string_view hll) {
+  hll_merge_avx2(registers, hll);
+}
+
+void hll_merge_portable(HllRegisters &registers, std::string_view hll) {
+  if (hll_is_sparse(hll)) {
+    merge_sparse(registers, hll);
+  } else {
+    merge_dense_portable(registers, hll, 0);
+  }
+}
+
+void hll_merge_avx2(HllRegisters &registers, std::string_view hll) {
+#ifdef HLL_HAVE_AVX2
+  if (has_hll_avx2() && !hll_is_sparse(hll)) {
+    const auto merged =
+        merge_dense_avx2_impl(registers, hll.data() + HEADER_SIZE);
+    merge_dense_portable(registers, hll, merged);
+    return;
+  }
+#endif
+  hll_merge_portable(registers, hll);
+}
+
+bool has_hll_avx2() {
+#ifdef HLL_HAVE_AVX2
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+std::uint64_t hll_estimate(const HllRegisters &registers) {
+  Histogram histogram{};
+  for (const auto value : registers) {
+    ++histogram[value & REGISTER_MASK];
+  }
+  return estimate(histogram);
+}
+
+std::string hll_from_registers(const HllRegisters &registers,
+                               std::size_t sparse_max_bytes) {
+  if (std::ranges::all_of(registers, [](std::uint8_t value) {
+        return value <= SPARSE_VALUE_MAX;
+      })) {
+    auto hll = make_header(SPARSE);
+    SparseWriter writer(hll);
+    for (const auto value : registers) {
+      writer.add(value, 1);
+    }
+    writer.flush();
+    if (hll.size() <= sparse_max_bytes) {
+      invalidate_count(hll);
+      return hll;
+    }
+  }
+  auto hll = make_header(DENSE);
+  hll.resize(DENSE_SIZE, '\0');
+  for (std::size_t i = 0; i < HLL_REGISTERS; i += 4) {
+    const unsigned first = registers[i] & REGISTER_MASK;
+    const unsigned second = registers[i + 1] & REGISTER_MASK;
+    const unsigned third = registers[i + 2] & REGISTER_MASK;
+    const unsigned fourth = registers[i + 3] & REGISTER_MASK;
+    auto *packed = hll.data() + HEADER_SIZE + (i / 4 * 3);
+    packed[0] = static_cast<char>(first | (second << 6));
+    packed[1] = static_cast<char>((second >> 2) | (third << 4));
+    packed[2] = static_cast<char>((third >> 4) | (fourth << 2));
+  }
+  invalidate_count(hll);
+  return hll;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// System includes.
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A HyperLogLog estimates how many distinct elements were added to it in at
+// most 12 KiB, with a standard error of 0.81%. Each element hashes to one of
+// 16384 registers, which keeps the longest run of zero bits (plus one) seen
+// in the rest of the hash. Like in Redis, HyperLogLogs are plain string
+// values (so they are saved and loaded like any other string) laid out as:
+//   "HYLL" <encoding: u8> <unused: 3 bytes> <cardinality: u64> <registers>
+// with the cached cardinality in little endian, and marked stale by its most
+// significant bit. Dense HyperLogLogs pack the registers in 6 bits each.
+// Sparse ones run-length encode them, which is far smaller while most
+// registers are still zero:
+//   00xxxxxx           xxxxxx + 1 zero registers (up to 64)
+//   01xxxxxx yyyyyyyy  xxxxxxyyyyyyyy + 1 zero registers (up to 16384)
+//   1vvvvvxx           xx + 1 registers set to vvvvv + 1 (up to 4, up to 32)
+
+constexpr std::size_t HLL_REGISTERS = 16384;
+
+// The registers of a HyperLogLog, unpacked to one per byte.
+using HllRegisters = std::array<std::uint8_t, HLL_REGISTERS>;
+
+// An empty HyperLogLog, in the sparse encoding.
+std::string hll_create();
+
+// Whether the string is a well-formed HyperLogLog.
+bool is_hll(std::string_view bytes);
+
+bool hll_is_sparse(std::string_view hll);
+
+// Adds the element, and returns whether any register changed. A sparse
+// HyperLogLog turns dense once it would grow past sparse_max_bytes, or needs
+// a register value too big for the sparse encoding.
+bool hll_add(std::string &hll, std::string_view element,
+             std::size_t sparse_max_bytes);
+
+// The cached cardinality, or nullopt if it is stale.
+std::optional<std::uint64_t> hll_cached_count(std::string_view hll);
+
+// The estimated cardinality, which is cached in the HyperLogLog so asking
+// again before it changes is O(1).
+std::uint64_t hll_count(std::string &hll);
+
+// Raises each register to the HyperLogLog's one wherever that is higher,
+// using the fastest implementation the CPU supports.
+void hll_merge(HllRegisters &registers, std::string_view hll);
+
+// Unpacks dense registers 4 at a time from every 3 bytes.
+void hll_merge_portable(HllRegisters &registers, std::string_view hll);
+
+// Unpacks dense registers 32 at a time with AVX2 shuffles and shifts, and
+// takes the maximum of 32 at a time. Falls back to the portable version when
+// the CPU lacks AVX2, so it is always safe to call.
+void hll_merge_avx2(HllRegisters &registers, std::string_view hll);
+
+// Whether hll_merge_avx2() can use AVX2 on this CPU.
+bool has_hll_avx2();
+
+// The estimated cardinality of the registers (using Ertl's improved
+// estimator, like Redis).
+std::uint64_t hll_estimate(const HllRegisters &registers);
+
+// A HyperLogLog holding the registers, in the sparse encoding if that fits in
+// sparse_max_bytes.
+std::string hll_from_registers(const HllRegisters &registers,
+                               std::size_t sparse_max_bytes);
@@ -0,0 +1,146 @@
+// This source file's own header include.
+#include "hyperloglog_commands.hpp"
+
+// System includes.
+#include <span>
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "hyperloglog.hpp"
+#include "redis_core.hpp"
+
+namespace {
+
+constexpr auto INVALID_HLL_ERROR =
+    "WRONGTYPE Key is not a valid HyperLogLog string value.";
+
+Message integer_reply(std::uint64_t value) {
+  return Message{std::to_string(value), DataType::Integer};
+}
+
+// The error to reply with if the value isn't a HyperLogLog.
+std::optional<Message> check_hll(const Value &value) {
+  const auto *hll = std::get_if<std::string>(&value);
+  if (hll == nullptr) {
+    return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+  }
+  if (!is_hll(*hll)) {
+    return Message{INVALID_HLL_ERROR, DataType::SimpleError};
+  }
+  return std::nullopt;
+}
+
+// PFADD key [element ...]
+Message add(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  return cache.update(args.front(), [&](std::optional<Value> &value) {
+    const bool created = !value;
+    if (created) {
+      value = hll_create();
+    }
+    if (auto error = check_hll(*value)) {
+      return std::move(*error);
+    }
+    auto &hll = std::get<std::string>(*value);
+    bool changed = created;
+    for (auto element = args.cbegin() + 1; element != args.cend();
+         ++element) {
+      changed |= hll_add(hll, *element, config.hll_sparse_max_bytes);
+    }
+    return integer_reply(changed ? 1 : 0);
+  });
+}
+
+// PFCOUNT key [key ...]
+Message count(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  if (args.size() > 1) {
+    // The union of several HyperLogLogs is estimated without caching it.
+    return cache.read_many(args, [](const std::vector<const Value *> &values) {
+      HllRegisters registers{};
+      for (const auto *value : values) {
+        if (value == nullptr) {
+          continue;
+        }
+        if (auto error = check_hll(*value)) {
+          return std::move(*error);
+        }
+        hll_merge(registers, std::get<std::string>(*value));
+      }
+      return integer_reply(hll_estimate(registers));
+    });
+  }
+  // Most of the time the cached cardinality is up to date, which only needs
+  // the shared lock.
+  auto reply = cache.read(
+      args.front(), [](const Value *value) -> std::optional<Message> {
+        if (value == nullptr) {
+          return integer_reply(0);
+        }
+        if (auto error = check_hll(*value)) {
+          return error;
+        }
+        if (const auto cached =
+                hll_cached_count(std::get<std::string>(*value))) {
+          return integer_reply(*cached);
+        }
+        return std::nullopt;
+      });
+  if (reply) {
+    return std::move(*reply);
+  }
+  return cache.update(args.front(), [](std::optional<Value> &value) {
+    if (!value) {
+      return integer_reply(0);
+    }
+    if (auto error = check_hll(*value)) {
+      return std::move(*error);
+    }
+    auto &hll = std::get<std::string>(*value);
+    return integer_reply(hll_count(hll));
+  });
+}
+
+// PFMERGE destkey [sourcekey ...]
+Message merge(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  // The destination is merged in too.
+  return cache.store(
+      args.front(), args,
+      [&config](const std::vector<const Value *> &values,
+                std::optional<std::optional<Value>> &result) {
+        HllRegisters registers{};
+        for (const auto *value : values) {
+          if (value == nullptr) {
+            continue;
+          }
+          if (auto error = check_hll(*value)) {
+            return std::move(*error);
+          }
+          hll_merge(registers, std::get<std::string>(*value));
+        }
+        result.emplace(
+            hll_from_registers(registers, config.hll_sparse_max_bytes));
+        return Message{"OK", DataType::SimpleString};
+      });
+}
+
+} // namespace
+
+std::optional<Message> handle_hyperloglog_command(const Command &command,
+                                                  const Config &config,
+                                                  Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::PfAdd:
+    return add(command, config, cache);
+  case CommandVerb::PfCount:
+    return count(command, cache);
+  case CommandVerb::PfMerge:
+    return merge(command, config, cache);
+  default:
+    return std::nullopt;
+  }
+}
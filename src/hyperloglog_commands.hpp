@@ -0,0 +1,18 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the HyperLogLog commands (PFADD, PFCOUNT and PFMERGE) and returns
+// the reply, or nullopt for any other command. HyperLogLogs are string values
+// that stay in the sparse encoding until they outgrow
+// config.hll_sparse_max_bytes.
+std::optional<Message> handle_hyperloglog_command(const Command &command,
+                                                  const Config &config,
+                                                  Cache &cache);
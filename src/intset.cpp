@@ -0,0 +1,315 @@
+// This source file's own header include.
+#include "intset.hpp"
+
+// System includes.
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+std::uint64_t read_little_endian(std::string_view bytes) {
+  std::uint64_t value = 0;
+  for (std::size_t i = bytes.size(); i > 0; --i) {
+    value = (value << 8U) | static_cast<unsigned char>(bytes[i - 1]);
+  }
+  return value;
+}
+
+void write_little_endian(char *dest, std::uint64_t value, std::size_t width) {
+  for (std::size_t i = 0; i < width; ++i) {
+    dest[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+std::string encode(std::int64_t value, std::size_t width) {
+  std::string encoded(width, '\0');
+  write_little_endian(encoded.data(), static_cast<std::uint64_t>(value), width);
+  return encoded;
+}
+
+// The narrowest encoding that fits the integer.
+std::size_t width_for(std::int64_t value) {
+  if (value >= std::numeric_limits<std::int16_t>::min() &&
+      value <= std::numeric_limits<std::int16_t>::max()) {
+    return sizeof(std::int16_t);
+  }
+  if (value >= std::numeric_limits<std::int32_t>::min() &&
+      value <= std::numeric_limits<std::int32_t>::max()) {
+    return sizeof(std::int32_t);
+  }
+  return sizeof(std::int64_t);
+}
+
+template <typename T> T load(const char *values, std::size_t index) {
+  T value{};
+  std::memcpy(&value, values + (index * sizeof(T)), sizeof(T));
+  return value;
+}
+
+constexpr std::size_t BLOCK_BYTES = 16;
+
+// A bitmask of which integers in the block of a are also in the block of b,
+// with bit i set for the ith integer. Compares every pair at once by rotating
+// b a lane at a time, like the "shuffling" intersection of
+// https://arxiv.org/abs/1401.6399
+template <typename T>
+std::uint32_t matches_in_block(const char *a, const char *b) {
+  constexpr std::size_t LANES = BLOCK_BYTES / sizeof(T);
+#if defined(__SSE2__)
+  const auto equal = [](__m128i first, __m128i second) {
+    if constexpr (sizeof(T) == sizeof(std::int16_t)) {
+      return _mm_cmpeq_epi16(first, second);
+    } else if constexpr (sizeof(T) == sizeof(std::int32_t)) {
+      return _mm_cmpeq_epi32(first, second);
+    } else {
+      // SSE2 can't compare 64-bit lanes, so check that both halves match.
+      const auto halves = _mm_cmpeq_epi32(first, second);
+      return _mm_and_si128(
+          halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+  };
+  const auto a_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+  auto b_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+  auto found = equal(a_block, b_block);
+  for (std::size_t i = 1; i < LANES; ++i) {
+    b_block = _mm_or_si128(_mm_srli_si128(b_block, sizeof(T)),
+                           _mm_slli_si128(b_block, BLOCK_BYTES - sizeof(T)));
+    found = _mm_or_si128(found, equal(a_block, b_block));
+  }
+  if constexpr (sizeof(T) == sizeof(std::int16_t)) {
+    return static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_packs_epi16(found, _mm_setzero_si128())));
+  } else if constexpr (sizeof(T) == sizeof(std::int32_t)) {
+    return static_cast<std::uint32_t>(
+        _mm_movemask_ps(_mm_castsi128_ps(found)));
+  } else {
+    return static_cast<std::uint32_t>(
+        _mm_movemask_pd(_mm_castsi128_pd(found)));
+  }
+#else
+  std::uint32_t mask = 0;
+  for (std::size_t i = 0; i < LANES; ++i) {
+    for (std::size_t j = 0; j < LANES; ++j) {
+      if (load<T>(a, i) == load<T>(b, j)) {
+        mask |= 1U << i;
+      }
+    }
+  }
+  return mask;
+#endif
+}
+
+// Writes the integers found in both sorted arrays to out, which must have
+// room for the smaller of the two, and returns how many there are. Whole
+// blocks of each are compared against each other, and whichever block ends
+// lower is moved past, which avoids the unpredictable branches of merging one
+// integer at a time.
+template <typename T>
+std::size_t intersect_blocks(const char *a, std::size_t num_a, const char *b,
+                             std::size_t num_b, char *out) {
+  constexpr std::size_t LANES = BLOCK_BYTES / sizeof(T);
+  std::size_t num_found = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i + LANES <= num_a && j + LANES <= num_b) {
+    const auto *a_block = a + (i * sizeof(T));
+    for (auto mask = matches_in_block<T>(a_block, b + (j * sizeof(T)));
+         mask != 0; mask &= mask - 1) {
+      std::memcpy(out + (num_found * sizeof(T)),
+                  a_block + (std::countr_zero(mask) * sizeof(T)), sizeof(T));
+      ++num_found;
+    }
+    const auto a_last = load<T>(a, i + LANES - 1);
+    const auto b_last = load<T>(b, j + LANES - 1);
+    i += a_last <= b_last ? LANES : 0;
+    j += b_last <= a_last ? LANES : 0;
+  }
+  // Fewer than a block's worth are left on one side, so merge the rest.
+  while (i < num_a && j < num_b) {
+    const auto a_value = load<T>(a, i);
+    const auto b_value = load<T>(b, j);
+    if (a_value == b_value) {
+      std::memcpy(out + (num_found * sizeof(T)), a + (i * sizeof(T)),
+                  sizeof(T));
+      ++num_found;
+    }
+    i += a_value <= b_value ? 1 : 0;
+    j += b_value <= a_value ? 1 : 0;
+  }
+  return num_found;
+}
+
+} // namespace
+
+IntSet::IntSet() : bytes_(HEADER_SIZE, '\0') {
+  // Start out with the narrowest encoding.
+  bytes_[0] = static_cast<char>(sizeof(std::int16_t));
+}
+
+std::optional<IntSet> IntSet::from_bytes(std::string bytes) {
+  if (bytes.size() < HEADER_SIZE) {
+    return std::nullopt;
+  }
+  IntSet intset(std::move(bytes));
+  const auto width = intset.encoding();
+  if (width != sizeof(std::int16_t) && width != sizeof(std::int32_t) &&
+      width != sizeof(std::int64_t)) {
+    return std::nullopt;
+  }
+  const auto num_values = intset.size();
+  if (intset.bytes_.size() != HEADER_SIZE + (num_values * width)) {
+    return std::nullopt;
+  }
+  // Lookups binary search the contents, so they had better be sorted.
+  for (std::size_t i = 1; i < num_values; ++i) {
+    if (intset.at(i - 1) >= intset.at(i)) {
+      return std::nullopt;
+    }
+  }
+  return intset;
+}
+
+std::size_t IntSet::size() const {
+  return read_little_endian(std::string_view(bytes_).substr(4, 4));
+}
+
+std::int64_t IntSet::at(std::size_t index) const {
+  const auto width = encoding();
+  const auto raw = read_little_endian(
+      std::string_view(bytes_).substr(HEADER_SIZE + (index * width), width));
+  // Sign extend from the encoded width.
+  switch (width) {
+  case sizeof(std::int16_t):
+    return static_cast<std::int16_t>(raw);
+  case sizeof(std::int32_t):
+    return static_cast<std::int32_t>(raw);
+  default:
+    return static_cast<std::int64_t>(raw);
+  }
+}
+
+bool IntSet::contains(std::int64_t value) const { return find(value).second; }
+
+bool IntSet::insert(std::int64_t value) {
+  const auto width = width_for(value);
+  if (width > encoding()) {
+    upgrade(width);
+    // Too big for the old encoding, so it goes past one end or the other.
+    bytes_.insert(value < 0 ? HEADER_SIZE : bytes_.size(),
+                  encode(value, width));
+    set_size(size() + 1);
+    return true;
+  }
+  const auto [index, found] = find(value);
+  if (found) {
+    return false;
+  }
+  bytes_.insert(HEADER_SIZE + (index * encoding()), encode(value, encoding()));
+  set_size(size() + 1);
+  return true;
+}
+
+bool IntSet::erase(std::int64_t value) {
+  const auto [index, found] = find(value);
+  if (!found) {
+    return false;
+  }
+  bytes_.erase(HEADER_SIZE + (index * encoding()), encoding());
+  set_size(size() - 1);
+  return true;
+}
+
+IntSet IntSet::intersect(const IntSet &first, const IntSet &second) {
+  const auto &small = first.size() <= second.size() ? first : second;
+  const auto &big = first.size() <= second.size() ? second : first;
+  // Every integer in both fits the narrower encoding.
+  const auto width = std::min(small.encoding(), big.encoding());
+  IntSet result{};
+  result.upgrade(width);
+  std::size_t num_found = 0;
+  if (small.encoding() == big.encoding() &&
+      std::endian::native == std::endian::little) {
+    const auto *small_values = small.bytes_.data() + HEADER_SIZE;
+    const auto *big_values = big.bytes_.data() + HEADER_SIZE;
+    result.bytes_.resize(HEADER_SIZE + (small.size() * width));
+    auto *out = result.bytes_.data() + HEADER_SIZE;
+    switch (width) {
+    case sizeof(std::int16_t):
+      num_found = intersect_blocks<std::int16_t>(
+          small_values, small.size(), big_values, big.size(), out);
+      break;
+    case sizeof(std::int32_t):
+      num_found = intersect_blocks<std::int32_t>(
+          small_values, small.size(), big_values, big.size(), out);
+      break;
+    default:
+      num_found = intersect_blocks<std::int64_t>(
+          small_values, small.size(), big_values, big.size(), out);
+      break;
+    }
+    result.bytes_.resize(HEADER_SIZE + (num_found * width));
+  } else {
+    // Different encodings can't be compared lane by lane, so merge them.
+    const auto num_big = big.size();
+    std::size_t index = 0;
+    small.for_each([&](std::int64_t value) {
+      while (index < num_big && big.at(index) < value) {
+        ++index;
+      }
+      if (index < num_big && big.at(index) == value) {
+        result.bytes_ += encode(value, width);
+        ++num_found;
+      }
+    });
+  }
+  result.set_size(num_found);
+  return result;
+}
+
+std::size_t IntSet::encoding() const {
+  return read_little_endian(std::string_view(bytes_).substr(0, 4));
+}
+
+std::pair<std::size_t, bool> IntSet::find(std::int64_t value) const {
+  std::size_t low = 0;
+  std::size_t high = size();
+  while (low < high) {
+    const auto mid = low + ((high - low) / 2);
+    const auto mid_value = at(mid);
+    if (mid_value == value) {
+      return {mid, true};
+    }
+    if (mid_value < value) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return {low, false};
+}
+
+void IntSet::set_size(std::size_t num_values) {
+  write_little_endian(bytes_.data() + 4, num_values, 4);
+}
+
+void IntSet::upgrade(std::size_t width) {
+  if (width == encoding()) {
+    return;
+  }
+  const auto num_values = size();
+  std::string bytes(HEADER_SIZE, '\0');
+  write_little_endian(bytes.data(), width, 4);
+  write_little_endian(bytes.data() + 4, num_values, 4);
+  bytes.reserve(HEADER_SIZE + (num_values * width));
+  for_each([&bytes, width](std::int64_t value) {
+    bytes += encode(value, width);
+  });
+  bytes_ = std::move(bytes);
+}
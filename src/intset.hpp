@@ -0,0 +1,69 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+// An intset is a sorted array of unique integers, all stored with the same
+// width (2, 4 or 8 bytes) which is the smallest that fits every one of them.
+// Sets made up of only a few integers are kept in this form. Like Redis, we
+// keep the exact serialized layout in memory so loading and saving it is a
+// plain copy:
+//   <encoding: u32> <length: u32> <contents: length * encoding bytes>
+// with everything in little endian.
+class IntSet {
+public:
+  // An empty intset.
+  IntSet();
+
+  // Wraps the given serialized intset, or returns nullopt if it is malformed
+  // (e.g. its contents are not sorted and unique).
+  static std::optional<IntSet> from_bytes(std::string bytes);
+
+  [[nodiscard]] std::size_t size() const;
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  // The integer at the given position in sorted order.
+  [[nodiscard]] std::int64_t at(std::size_t index) const;
+  [[nodiscard]] bool contains(std::int64_t value) const;
+  // Adds the integer, widening the encoding first if it doesn't fit. Returns
+  // false if it was already there.
+  bool insert(std::int64_t value);
+  // Returns false if the integer wasn't there.
+  bool erase(std::int64_t value);
+  // The serialized intset, ready to be written out.
+  [[nodiscard]] const std::string &bytes() const { return bytes_; }
+
+  // Calls func(value) on every integer in sorted order.
+  template <typename Func> void for_each(Func &&func) const {
+    const auto num_values = size();
+    for (std::size_t i = 0; i < num_values; ++i) {
+      func(at(i));
+    }
+  }
+
+  // The integers in both intsets. Both are sorted, so this is a merge, which
+  // compares a whole block of one against a whole block of the other with
+  // SIMD instructions when the encodings match (and SSE2 is available).
+  static IntSet intersect(const IntSet &first, const IntSet &second);
+
+  bool operator==(const IntSet &other) const = default;
+
+private:
+  static constexpr std::size_t HEADER_SIZE = 8;
+
+  explicit IntSet(std::string bytes) : bytes_(std::move(bytes)) {}
+
+  // The width of each integer in bytes.
+  [[nodiscard]] std::size_t encoding() const;
+  // The index of the integer, or of where it would be inserted, and whether
+  // it is there.
+  [[nodiscard]] std::pair<std::size_t, bool> find(std::int64_t value) const;
+  void set_size(std::size_t num_values);
+  // Rewrites every integer with the given wider encoding.
+  void upgrade(std::size_t width);
+
+  std::string bytes_;
+};
@@ -0,0 +1,94 @@
+// This source file's own header include.
+#include "lazy_free.hpp"
+
+// System includes.
+#include <string>
+#include <unordered_set>
+#include <variant>
+
+std::size_t free_effort(const Value &value) {
+  return std::visit(
+      ValueVisitor{
+          [](const std::string &) -> std::size_t { return 1; },
+          [](const ListValue &list) -> std::size_t {
+            return list.nodes().size();
+          },
+          [](const SetValue &set) -> std::size_t {
+            if (const auto *table =
+                    std::get_if<std::unordered_set<std::string>>(&set)) {
+              return table->size();
+            }
+            return 1;
+          },
+          [](const SortedSetValue &sorted_set) -> std::size_t {
+            if (const auto *table = std::get_if<SortedSetTable>(&sorted_set)) {
+              return table->size();
+            }
+            return 1;
+          },
+          [](const HashValue &hash) -> std::size_t {
+            if (const auto *table =
+                    std::get_if<std::unordered_map<std::string, std::string>>(
+                        &hash)) {
+              return table->size();
+            }
+            return 1;
+          },
+          [](const StreamValue &stream) -> std::size_t {
+            return stream.blocks().size();
+          },
+      },
+      value);
+}
+
+LazyFree::LazyFree(LazyFreePolicy policy)
+    : policy_(policy), thread_([this] { free_loop(); }) {}
+
+LazyFree::~LazyFree() {
+  // Push an empty object to wake the thread up so it sees it should exit.
+  stopping_ = true;
+  ++pending_;
+  enqueue(std::make_unique<Garbage>());
+  thread_.join();
+  free_all();
+}
+
+void LazyFree::wait_until_idle() const {
+  for (auto pending = pending_.load(); pending != 0;
+       pending = pending_.load()) {
+    pending_.wait(pending);
+  }
+}
+
+void LazyFree::enqueue(std::unique_ptr<Garbage> garbage) {
+  auto *node = garbage.release();
+  node->next = head_.load(std::memory_order_relaxed);
+  // The release pairs with the acquire in free_loop(), so the thread sees the
+  // object fully constructed.
+  while (!head_.compare_exchange_weak(node->next, node,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+  }
+  head_.notify_one();
+}
+
+void LazyFree::free_loop() {
+  while (!stopping_) {
+    head_.wait(nullptr, std::memory_order_acquire);
+    free_all();
+  }
+}
+
+void LazyFree::free_all() {
+  // Take the whole stack at once, so pushes never contend with pops.
+  auto *node = head_.exchange(nullptr, std::memory_order_acquire);
+  std::uint64_t num_freed = 0;
+  while (node != nullptr) {
+    const std::unique_ptr<Garbage> garbage(node);
+    node = garbage->next;
+    ++num_freed;
+  }
+  freed_ += num_freed;
+  pending_ -= num_freed;
+  pending_.notify_all();
+}
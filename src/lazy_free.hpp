@@ -0,0 +1,109 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+// Our library's header includes.
+#include "value.hpp"
+
+// Which kinds of deletions free their values in the background, named after
+// the matching "lazyfree-lazy-*" options of Redis.
+struct LazyFreePolicy {
+  // DEL behaves like UNLINK.
+  bool lazy_user_del = false;
+  // Values replaced by a write (e.g. SET over an existing key).
+  bool lazy_server_del = false;
+  // FLUSHDB and FLUSHALL without ASYNC or SYNC behave like ASYNC.
+  bool lazy_user_flush = false;
+};
+
+// Roughly how many allocations it takes to free the value, like Redis's
+// lazyfreeGetFreeEffort(). Compact encodings are a single allocation no
+// matter how many elements they hold.
+std::size_t free_effort(const Value &value);
+// A whole table of entries (e.g. a flushed database).
+template <typename KeyT, typename EntryT>
+std::size_t free_effort(const std::unordered_map<KeyT, EntryT> &table) {
+  return table.size();
+}
+
+// Frees objects on a background thread, so that dropping something big (like
+// a huge hash after UNLINK, or a whole database after FLUSHDB ASYNC) doesn't
+// block the client that asked for it. See
+// https://redis.io/docs/latest/commands/unlink/
+//
+// Objects are handed over through a lock-free stack, so queueing one never
+// waits on the freeing thread (or on other clients queueing theirs).
+class LazyFree {
+public:
+  // Objects that take more than this much effort to free are worth handing to
+  // the background thread. Anything cheaper is faster to free right away.
+  static constexpr std::size_t LAZYFREE_THRESHOLD = 64;
+
+  explicit LazyFree(LazyFreePolicy policy = {});
+  LazyFree(const LazyFree &other) = delete;
+  LazyFree &operator=(const LazyFree &other) = delete;
+  LazyFree(LazyFree &&other) = delete;
+  LazyFree &operator=(LazyFree &&other) = delete;
+  // Frees everything still queued before returning.
+  ~LazyFree();
+
+  [[nodiscard]] const LazyFreePolicy &policy() const { return policy_; }
+
+  // Takes ownership of the object and frees it: on the background thread if
+  // lazy is set and it is expensive to free, otherwise right away.
+  template <typename T> void dispose(T object, bool lazy) {
+    if (lazy && free_effort(object) > LAZYFREE_THRESHOLD) {
+      ++pending_;
+      enqueue(std::make_unique<Holder<T>>(std::move(object)));
+    }
+    // Otherwise the object is freed as it goes out of scope here.
+  }
+
+  // The number of objects queued but not freed yet.
+  [[nodiscard]] std::uint64_t pending() const { return pending_; }
+  // The number of objects freed in the background so far.
+  [[nodiscard]] std::uint64_t freed() const { return freed_; }
+  // Blocks until everything queued so far has been freed.
+  void wait_until_idle() const;
+
+private:
+  // Type erases the objects so they can share one stack, which links them
+  // through the next pointers.
+  struct Garbage {
+    Garbage() = default;
+    Garbage(const Garbage &other) = delete;
+    Garbage &operator=(const Garbage &other) = delete;
+    Garbage(Garbage &&other) = delete;
+    Garbage &operator=(Garbage &&other) = delete;
+    virtual ~Garbage() = default;
+
+    Garbage *next = nullptr;
+  };
+  template <typename T> struct Holder : Garbage {
+    explicit Holder(T value_in) : value(std::move(value_in)) {}
+    T value;
+  };
+
+  void enqueue(std::unique_ptr<Garbage> garbage);
+  void free_loop();
+  // Frees everything queued so far.
+  void free_all();
+
+  LazyFreePolicy policy_;
+  // The top of the stack of objects waiting to be freed. The freeing thread
+  // sleeps on this while it is empty.
+  std::atomic<Garbage *> head_ = nullptr;
+  std::atomic<std::uint64_t> pending_ = 0;
+  std::atomic<std::uint64_t> freed_ = 0;
+  std::atomic<bool> stopping_ = false;
+
+  // Declared last so it stops before the members it uses are destroyed.
+  std::jthread thread_;
+};
@@ -0,0 +1,274 @@
+// This source file's own header include.
+#include "list_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+constexpr auto NOT_POSITIVE_ERROR =
+    "ERR value is out of range, must be positive";
+constexpr auto TIMEOUT_NOT_A_FLOAT_ERROR =
+    "ERR timeout is not a float or out of range";
+constexpr auto NEGATIVE_TIMEOUT_ERROR = "ERR timeout is negative";
+
+// The timeout of BLPOP and BRPOP, in seconds (which may have a fraction).
+std::optional<double> parse_timeout(std::string_view str) {
+  double seconds = 0;
+  const auto [end, error] =
+      std::from_chars(str.data(), str.data() + str.size(), seconds);
+  if (error != std::errc{} || end != str.data() + str.size() ||
+      !std::isfinite(seconds)) {
+    return std::nullopt;
+  }
+  return seconds;
+}
+
+// Resolves the start and stop indexes of LRANGE and LTRIM (inclusive, and
+// counting from the end if negative) into the index of the first element and
+// the number of elements, for a list of the given size.
+std::pair<std::size_t, std::size_t>
+resolve_range(std::int64_t start, std::int64_t stop, std::size_t size) {
+  const auto length = static_cast<std::int64_t>(size);
+  if (start < 0) {
+    start = std::max<std::int64_t>(start + length, 0);
+  }
+  if (stop < 0) {
+    stop += length;
+  }
+  if (start > stop || start >= length) {
+    return {0, 0};
+  }
+  stop = std::min(stop, length - 1);
+  return {start, stop - start + 1};
+}
+
+Message push(const Command &command, const Config &config, Cache &cache) {
+  const bool front = command.verb == CommandVerb::LPush;
+  return cache.update(
+      command.arguments.front(), [&](std::optional<Value> &value) {
+        if (!value) {
+          value = ListValue(config.list_max_listpack_size);
+        }
+        auto *list = std::get_if<ListValue>(&*value);
+        if (list == nullptr) {
+          return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+        }
+        for (auto element = command.arguments.cbegin() + 1;
+             element != command.arguments.cend(); ++element) {
+          if (front) {
+            list->push_front(*element);
+          } else {
+            list->push_back(*element);
+          }
+        }
+        return Message{std::to_string(list->size()), DataType::Integer};
+      });
+}
+
+Message pop(const Command &command, Cache &cache) {
+  // Without a count, the reply is the element itself rather than an array.
+  std::optional<std::size_t> count{};
+  if (command.arguments.size() == 2) {
+    const auto parsed = parse_canonical_int(command.arguments[1]);
+    if (!parsed || *parsed < 0) {
+      return Message{NOT_POSITIVE_ERROR, DataType::SimpleError};
+    }
+    count = static_cast<std::size_t>(*parsed);
+  }
+  const bool front = command.verb == CommandVerb::LPop;
+  return cache.update(
+      command.arguments.front(), [&](std::optional<Value> &value) {
+        // Like Redis, a nil array if a count was given. blocking_pop()
+        // relies on the nil bulk string otherwise.
+        if (!value) {
+          return Message{"", count ? DataType::NullArray
+                                   : DataType::NullBulkString};
+        }
+        auto *list = std::get_if<ListValue>(&*value);
+        if (list == nullptr) {
+          return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+        }
+        const auto pop_one = [list, front] {
+          return *(front ? list->pop_front() : list->pop_back());
+        };
+        Message reply{};
+        if (count) {
+          Message::NestedVariantT elements{};
+          elements.reserve(std::min(*count, list->size()));
+          while (elements.size() < *count && !list->empty()) {
+            elements.emplace_back(pop_one(), DataType::BulkString);
+          }
+          reply = Message{std::move(elements), DataType::Array};
+        } else {
+          reply = Message{pop_one(), DataType::BulkString};
+        }
+        // Lists never stay around empty.
+        if (list->empty()) {
+          value.reset();
+        }
+        return reply;
+      });
+}
+
+// BLPOP key [key ...] timeout, and BRPOP. Pops from the first of the keys
+// holding a list, replying with the key and the element, or with nil if
+// there is none. Blocking until there is one is up to the server.
+Message blocking_pop(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  const auto seconds = parse_timeout(args.back());
+  if (!seconds) {
+    return Message{TIMEOUT_NOT_A_FLOAT_ERROR, DataType::SimpleError};
+  }
+  if (*seconds < 0) {
+    return Message{NEGATIVE_TIMEOUT_ERROR, DataType::SimpleError};
+  }
+  const auto verb = command.verb == CommandVerb::BLPop ? CommandVerb::LPop
+                                                       : CommandVerb::RPop;
+  for (auto key = args.cbegin(); key + 1 != args.cend(); ++key) {
+    auto reply = pop(Command{verb, {*key}}, cache);
+    if (reply.get_data_type() == DataType::NullBulkString) {
+      continue;
+    }
+    if (reply.get_data_type() == DataType::SimpleError) {
+      return reply;
+    }
+    Message::NestedVariantT elements{};
+    elements.emplace_back(*key, DataType::BulkString);
+    elements.push_back(std::move(reply));
+    return Message{std::move(elements), DataType::Array};
+  }
+  return Message{"", DataType::NullBulkString};
+}
+
+Message length(const Command &command, const Cache &cache) {
+  return cache.read(command.arguments.front(), [](const Value *value) {
+    if (value == nullptr) {
+      return Message{"0", DataType::Integer};
+    }
+    const auto *list = std::get_if<ListValue>(value);
+    if (list == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return Message{std::to_string(list->size()), DataType::Integer};
+  });
+}
+
+Message range(const Command &command, const Cache &cache) {
+  const auto start = parse_canonical_int(command.arguments[1]);
+  const auto stop = parse_canonical_int(command.arguments[2]);
+  if (!start || !stop) {
+    return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+  }
+  return cache.read(command.arguments.front(), [&](const Value *value) {
+    Message::NestedVariantT elements{};
+    if (value == nullptr) {
+      return Message{std::move(elements), DataType::Array};
+    }
+    const auto *list = std::get_if<ListValue>(value);
+    if (list == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    const auto [first, count] = resolve_range(*start, *stop, list->size());
+    elements.reserve(count);
+    list->for_each(first, count, [&elements](const Listpack::Element &elem) {
+      elements.emplace_back(Listpack::to_string(elem), DataType::BulkString);
+    });
+    return Message{std::move(elements), DataType::Array};
+  });
+}
+
+Message trim(const Command &command, Cache &cache) {
+  const auto start = parse_canonical_int(command.arguments[1]);
+  const auto stop = parse_canonical_int(command.arguments[2]);
+  if (!start || !stop) {
+    return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+  }
+  return cache.update(
+      command.arguments.front(), [&](std::optional<Value> &value) {
+        if (!value) {
+          return Message{"OK", DataType::SimpleString};
+        }
+        auto *list = std::get_if<ListValue>(&*value);
+        if (list == nullptr) {
+          return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+        }
+        const auto [first, count] =
+            resolve_range(*start, *stop, list->size());
+        list->trim(first, count);
+        if (list->empty()) {
+          value.reset();
+        }
+        return Message{"OK", DataType::SimpleString};
+      });
+}
+
+} // namespace
+
+std::optional<Message> handle_list_command(const Command &command,
+                                           const Config &config,
+                                           Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::LPush:
+  case CommandVerb::RPush:
+    return push(command, config, cache);
+  case CommandVerb::LPop:
+  case CommandVerb::RPop:
+    return pop(command, cache);
+  case CommandVerb::BLPop:
+  case CommandVerb::BRPop:
+    return blocking_pop(command, cache);
+  case CommandVerb::LLen:
+    return length(command, cache);
+  case CommandVerb::LRange:
+    return range(command, cache);
+  case CommandVerb::LTrim:
+    return trim(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<BlockingSpec> get_blocking_pop_spec(const Command &command) {
+  if (command.verb != CommandVerb::BLPop &&
+      command.verb != CommandVerb::BRPop) {
+    return std::nullopt;
+  }
+  const auto &args = command.arguments;
+  BlockingSpec spec{{args.cbegin(), args.cend() - 1}, std::nullopt};
+  // Zero means forever.
+  const auto seconds = parse_timeout(args.back()).value_or(0);
+  if (seconds > 0) {
+    spec.timeout = std::chrono::milliseconds(
+        static_cast<std::int64_t>(std::ceil(seconds * 1000)));
+  }
+  return spec;
+}
+
+Command make_propagated_blocking_pop(const Command &command,
+                                     const Message &reply) {
+  const auto *elements =
+      std::get_if<Message::NestedVariantT>(&reply.get_data());
+  if (elements == nullptr || elements->empty()) {
+    return command;
+  }
+  const auto &key = std::get<Message::StringVariantT>(
+      elements->front().get_data());
+  return Command{command.verb == CommandVerb::BLPop ? CommandVerb::LPop
+                                                    : CommandVerb::RPop,
+                 {key}};
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the list commands (LPUSH, RPUSH, LPOP, RPOP, BLPOP, BRPOP, LLEN,
+// LRANGE and LTRIM) and returns the reply, or nullopt for any other command.
+// BLPOP and BRPOP never block here, they reply with nil instead. New lists get
+// the node size of config.list_max_listpack_size.
+std::optional<Message> handle_list_command(const Command &command,
+                                           const Config &config, Cache &cache);
+
+// The keys and timeout of BLPOP or BRPOP, or nullopt for any other command.
+// Only meant for commands that got a reply other than an error.
+std::optional<BlockingSpec> get_blocking_pop_spec(const Command &command);
+
+// Rewrites BLPOP and BRPOP as the LPOP or RPOP of the key they popped from
+// (which the reply holds), like Redis propagates them.
+Command make_propagated_blocking_pop(const Command &command,
+                                     const Message &reply);
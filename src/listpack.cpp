@@ -0,0 +1,458 @@
+// This source file's own header include.
+#include "listpack.hpp"
+
+// System includes.
+#include <algorithm>
+#include <limits>
+
+// Our library's header includes.
+#include "utils.hpp"
+
+namespace {
+
+// Encoding types, see the listpack spec. The small ones keep part of the
+// length (or the integer itself) in the low bits of the first byte.
+constexpr unsigned char ENCODING_7BIT_UINT_MASK = 0x80;
+constexpr unsigned char ENCODING_6BIT_STR = 0x80;
+constexpr unsigned char ENCODING_6BIT_STR_MASK = 0xC0;
+constexpr unsigned char ENCODING_13BIT_INT = 0xC0;
+constexpr unsigned char ENCODING_13BIT_INT_MASK = 0xE0;
+constexpr unsigned char ENCODING_12BIT_STR = 0xE0;
+constexpr unsigned char ENCODING_12BIT_STR_MASK = 0xF0;
+constexpr unsigned char ENCODING_32BIT_STR = 0xF0;
+constexpr unsigned char ENCODING_16BIT_INT = 0xF1;
+constexpr unsigned char ENCODING_24BIT_INT = 0xF2;
+constexpr unsigned char ENCODING_32BIT_INT = 0xF3;
+constexpr unsigned char ENCODING_64BIT_INT = 0xF4;
+
+std::uint64_t read_little_endian(std::string_view bytes) {
+  std::uint64_t value = 0;
+  for (std::size_t i = bytes.size(); i > 0; --i) {
+    value = (value << 8U) | static_cast<unsigned char>(bytes[i - 1]);
+  }
+  return value;
+}
+
+void append_little_endian(std::string &out, std::uint64_t value,
+                          std::size_t num_bytes) {
+  for (std::size_t i = 0; i < num_bytes; ++i) {
+    out.push_back(static_cast<char>(value & 0xFFU));
+    value >>= 8U;
+  }
+}
+
+// Sign extends the lowest num_bits bits of the value.
+std::int64_t sign_extend(std::uint64_t value, unsigned int num_bits) {
+  const std::uint64_t sign_bit = 1ULL << (num_bits - 1);
+  if (num_bits < 64) {
+    value &= (1ULL << num_bits) - 1;
+  }
+  return static_cast<std::int64_t>((value ^ sign_bit) - sign_bit);
+}
+
+// The number of bytes taken by the encoding and data of the entry starting
+// with these bytes, or nullopt if it is malformed (or runs past the end).
+std::optional<std::size_t> encoded_size(std::string_view entry) {
+  if (entry.empty()) {
+    return std::nullopt;
+  }
+  const auto first = static_cast<unsigned char>(entry[0]);
+  std::size_t size = 0;
+  if ((first & ENCODING_7BIT_UINT_MASK) == 0) {
+    size = 1;
+  } else if ((first & ENCODING_6BIT_STR_MASK) == ENCODING_6BIT_STR) {
+    size = 1 + (first & 0x3FU);
+  } else if ((first & ENCODING_13BIT_INT_MASK) == ENCODING_13BIT_INT) {
+    size = 2;
+  } else if ((first & ENCODING_12BIT_STR_MASK) == ENCODING_12BIT_STR) {
+    if (entry.size() < 2) {
+      return std::nullopt;
+    }
+    size = 2 + (((first & 0x0FU) << 8U) |
+                static_cast<unsigned char>(entry[1]));
+  } else if (first == ENCODING_32BIT_STR) {
+    if (entry.size() < 5) {
+      return std::nullopt;
+    }
+    size = 5 + read_little_endian(entry.substr(1, 4));
+  } else if (first == ENCODING_16BIT_INT) {
+    size = 3;
+  } else if (first == ENCODING_24BIT_INT) {
+    size = 4;
+  } else if (first == ENCODING_32BIT_INT) {
+    size = 5;
+  } else if (first == ENCODING_64BIT_INT) {
+    size = 9;
+  } else {
+    return std::nullopt;
+  }
+  if (size > entry.size()) {
+    return std::nullopt;
+  }
+  return size;
+}
+
+std::size_t backlen_size(std::size_t encoded_size) {
+  if (encoded_size <= 127) {
+    return 1;
+  }
+  if (encoded_size < 16383) {
+    return 2;
+  }
+  if (encoded_size < 2097151) {
+    return 3;
+  }
+  if (encoded_size < 268435455) {
+    return 4;
+  }
+  return 5;
+}
+
+// The backlen stores the size of the encoding and data in 7 bit groups, most
+// significant group first, with the high bit set on all but the first byte.
+// That way it can be read starting from its last byte when walking backwards.
+void append_backlen(std::string &out, std::size_t encoded_size) {
+  const auto num_bytes = backlen_size(encoded_size);
+  for (std::size_t i = num_bytes; i > 0; --i) {
+    auto byte = static_cast<unsigned char>((encoded_size >> (7 * (i - 1))) &
+                                           0x7FU);
+    if (i != num_bytes) {
+      byte |= 0x80U;
+    }
+    out.push_back(static_cast<char>(byte));
+  }
+}
+
+// Reads the backlen written by append_backlen() back in.
+std::size_t read_backlen(std::string_view backlen) {
+  std::size_t value = 0;
+  for (const char byte : backlen) {
+    value = (value << 7U) | (static_cast<unsigned char>(byte) & 0x7FU);
+  }
+  return value;
+}
+
+std::string encode_int(std::int64_t value) {
+  std::string encoded{};
+  const auto as_unsigned = static_cast<std::uint64_t>(value);
+  if (value >= 0 && value <= 127) {
+    encoded.push_back(static_cast<char>(value));
+  } else if (value >= -4096 && value <= 4095) {
+    const auto bits = as_unsigned & 0x1FFFU;
+    encoded.push_back(static_cast<char>((bits >> 8U) | ENCODING_13BIT_INT));
+    encoded.push_back(static_cast<char>(bits & 0xFFU));
+  } else if (value >= std::numeric_limits<std::int16_t>::min() &&
+             value <= std::numeric_limits<std::int16_t>::max()) {
+    encoded.push_back(static_cast<char>(ENCODING_16BIT_INT));
+    append_little_endian(encoded, as_unsigned, 2);
+  } else if (value >= -8388608 && value <= 8388607) {
+    encoded.push_back(static_cast<char>(ENCODING_24BIT_INT));
+    append_little_endian(encoded, as_unsigned, 3);
+  } else if (value >= std::numeric_limits<std::int32_t>::min() &&
+             value <= std::numeric_limits<std::int32_t>::max()) {
+    encoded.push_back(static_cast<char>(ENCODING_32BIT_INT));
+    append_little_endian(encoded, as_unsigned, 4);
+  } else {
+    encoded.push_back(static_cast<char>(ENCODING_64BIT_INT));
+    append_little_endian(encoded, as_unsigned, 8);
+  }
+  return encoded;
+}
+
+std::string encode_string(std::string_view str) {
+  std::string encoded{};
+  const auto length = str.size();
+  if (length < 64) {
+    encoded.push_back(static_cast<char>(ENCODING_6BIT_STR | length));
+  } else if (length < 4096) {
+    encoded.push_back(static_cast<char>(ENCODING_12BIT_STR | (length >> 8U)));
+    encoded.push_back(static_cast<char>(length & 0xFFU));
+  } else {
+    encoded.push_back(static_cast<char>(ENCODING_32BIT_STR));
+    append_little_endian(encoded, length, 4);
+  }
+  encoded += str;
+  return encoded;
+}
+
+} // namespace
+
+Listpack::Listpack() {
+  bytes_.resize(HEADER_SIZE);
+  bytes_.push_back(static_cast<char>(END));
+  set_header(static_cast<std::uint32_t>(bytes_.size()), 0);
+}
+
+std::optional<Listpack> Listpack::from_bytes(std::string bytes) {
+  if (bytes.size() < HEADER_SIZE + 1 ||
+      read_little_endian(std::string_view(bytes).substr(0, 4)) !=
+          bytes.size() ||
+      static_cast<unsigned char>(bytes.back()) != END) {
+    return std::nullopt;
+  }
+  // Walk every entry to make sure none of them point outside the listpack,
+  // since we trust the encodings from here on.
+  const std::string_view view(bytes);
+  std::size_t pos = HEADER_SIZE;
+  std::size_t num_elements = 0;
+  while (static_cast<unsigned char>(view[pos]) != END) {
+    const auto size = encoded_size(view.substr(pos, view.size() - 1 - pos));
+    if (!size) {
+      return std::nullopt;
+    }
+    const auto backlen_pos = pos + *size;
+    pos = backlen_pos + backlen_size(*size);
+    if (pos >= view.size() ||
+        read_backlen(view.substr(backlen_pos, pos - backlen_pos)) != *size) {
+      return std::nullopt;
+    }
+    ++num_elements;
+  }
+  const auto recorded_num_elements = read_little_endian(view.substr(4, 2));
+  if (recorded_num_elements != UNKNOWN_NUM_ELEMENTS &&
+      recorded_num_elements != num_elements) {
+    return std::nullopt;
+  }
+  return Listpack(std::move(bytes));
+}
+
+void Listpack::push_back(std::string_view element) {
+  const auto as_int = parse_canonical_int(element);
+  insert_encoded(bytes_.size() - 1,
+                 as_int ? encode_int(*as_int) : encode_string(element));
+}
+
+void Listpack::push_back(std::int64_t element) {
+  insert_encoded(bytes_.size() - 1, encode_int(element));
+}
+
+void Listpack::push_back(std::span<const Element> elements) {
+  std::string encoded{};
+  for (const auto &element : elements) {
+    const auto *str = std::get_if<std::string_view>(&element);
+    const auto as_int =
+        str != nullptr ? parse_canonical_int(*str) : std::get<1>(element);
+    auto entry = as_int ? encode_int(*as_int) : encode_string(*str);
+    append_backlen(entry, entry.size());
+    encoded += entry;
+  }
+  bytes_.insert(bytes_.size() - 1, encoded);
+  update_header(static_cast<std::int64_t>(elements.size()));
+}
+
+void Listpack::push_front(std::string_view element) {
+  const auto as_int = parse_canonical_int(element);
+  insert_encoded(HEADER_SIZE,
+                 as_int ? encode_int(*as_int) : encode_string(element));
+}
+
+std::string Listpack::pop_front() {
+  auto element = to_string(element_at(HEADER_SIZE));
+  erase_entries(HEADER_SIZE, next(HEADER_SIZE), 1);
+  return element;
+}
+
+std::string Listpack::pop_back() {
+  const auto end = bytes_.size() - 1;
+  const auto last = prev(end);
+  auto element = to_string(element_at(last));
+  erase_entries(last, end, 1);
+  return element;
+}
+
+void Listpack::erase(std::size_t first, std::size_t count) {
+  const auto begin = offset_of(first);
+  auto end = begin;
+  std::size_t num_elements = 0;
+  for (; num_elements < count && static_cast<unsigned char>(bytes_[end]) != END;
+       ++num_elements) {
+    end = next(end);
+  }
+  erase_entries(begin, end, num_elements);
+}
+
+std::size_t Listpack::size() const {
+  const auto num_elements =
+      read_little_endian(std::string_view(bytes_).substr(4, 2));
+  if (num_elements != UNKNOWN_NUM_ELEMENTS) {
+    return num_elements;
+  }
+  std::size_t count = 0;
+  for_each([&count](const Element &) { ++count; });
+  return count;
+}
+
+std::string Listpack::to_string(const Element &element) {
+  if (const auto *str = std::get_if<std::string_view>(&element)) {
+    return std::string(*str);
+  }
+  return std::to_string(std::get<std::int64_t>(element));
+}
+
+Listpack::Element Listpack::element_at(std::size_t pos) const {
+  std::size_t next_pos = 0;
+  return element_at(pos, next_pos);
+}
+
+Listpack::Element Listpack::element_at(std::size_t pos,
+                                       std::size_t &next_pos) const {
+  const std::string_view entry = std::string_view(bytes_).substr(pos);
+  const auto first = static_cast<unsigned char>(entry[0]);
+  // The size of the encoding and data, which the backlen follows.
+  std::size_t size = 0;
+  Element element{};
+  if ((first & ENCODING_7BIT_UINT_MASK) == 0) {
+    size = 1;
+    element = static_cast<std::int64_t>(first);
+  } else if ((first & ENCODING_6BIT_STR_MASK) == ENCODING_6BIT_STR) {
+    size = 1 + (first & 0x3FU);
+    element = entry.substr(1, size - 1);
+  } else if ((first & ENCODING_13BIT_INT_MASK) == ENCODING_13BIT_INT) {
+    size = 2;
+    element = sign_extend(((first & 0x1FU) << 8U) |
+                              static_cast<unsigned char>(entry[1]),
+                          13);
+  } else if ((first & ENCODING_12BIT_STR_MASK) == ENCODING_12BIT_STR) {
+    size = 2 + (((first & 0x0FU) << 8U) |
+                static_cast<unsigned char>(entry[1]));
+    element = entry.substr(2, size - 2);
+  } else {
+    switch (first) {
+    case ENCODING_32BIT_STR:
+      size = 5 + read_little_endian(entry.substr(1, 4));
+      element = entry.substr(5, size - 5);
+      break;
+    case ENCODING_16BIT_INT:
+      size = 3;
+      element = sign_extend(read_little_endian(entry.substr(1, 2)), 16);
+      break;
+    case ENCODING_24BIT_INT:
+      size = 4;
+      element = sign_extend(read_little_endian(entry.substr(1, 3)), 24);
+      break;
+    case ENCODING_32BIT_INT:
+      size = 5;
+      element = sign_extend(read_little_endian(entry.substr(1, 4)), 32);
+      break;
+    case ENCODING_64BIT_INT:
+    default:
+      size = 9;
+      element = sign_extend(read_little_endian(entry.substr(1, 8)), 64);
+      break;
+    }
+  }
+  next_pos = pos + size + backlen_size(size);
+  return element;
+}
+
+std::size_t Listpack::next(std::size_t pos) const {
+  // The entry was validated when it was added, so this always has a value.
+  const auto size = *encoded_size(std::string_view(bytes_).substr(pos));
+  return pos + size + backlen_size(size);
+}
+
+void Listpack::replace(std::size_t index, std::string_view element) {
+  const auto pos = offset_of(index);
+  const auto as_int = parse_canonical_int(element);
+  std::string entry = as_int ? encode_int(*as_int) : encode_string(element);
+  append_backlen(entry, entry.size());
+  bytes_.replace(pos, next(pos) - pos, entry);
+  update_header(0);
+}
+
+void Listpack::insert(std::size_t index, std::string_view element) {
+  const auto as_int = parse_canonical_int(element);
+  insert_encoded(offset_of(index),
+                 as_int ? encode_int(*as_int) : encode_string(element));
+}
+
+std::optional<std::size_t> Listpack::find(std::string_view element,
+                                          std::size_t skip) const {
+  // Integers are stored as integers, so compare them as such.
+  const auto as_int = parse_canonical_int(element);
+  std::size_t index = 0;
+  for (std::size_t pos = HEADER_SIZE;
+       static_cast<unsigned char>(bytes_[pos]) != END; ++index) {
+    if (index % (skip + 1) == 0) {
+      const auto current = element_at(pos);
+      const auto *str = std::get_if<std::string_view>(&current);
+      if (str != nullptr ? !as_int && *str == element
+                         : as_int == std::get<std::int64_t>(current)) {
+        return index;
+      }
+    }
+    pos = next(pos);
+  }
+  return std::nullopt;
+}
+
+std::size_t Listpack::prev(std::size_t pos) const {
+  // Only the first byte of the backlen lacks the continuation bit, so look
+  // for it walking backwards.
+  std::size_t backlen_start = pos - 1;
+  while ((static_cast<unsigned char>(bytes_[backlen_start]) & 0x80U) != 0) {
+    --backlen_start;
+  }
+  const auto size = read_backlen(
+      std::string_view(bytes_).substr(backlen_start, pos - backlen_start));
+  return backlen_start - size;
+}
+
+std::size_t Listpack::offset_of(std::size_t index) const {
+  // Walk from whichever end is closer, so reaching into the middle of a
+  // listpack (e.g. for LRANGE) only walks half of it at most.
+  const auto num_elements = size();
+  if (index >= num_elements) {
+    return bytes_.size() - 1;
+  }
+  if (index > num_elements / 2) {
+    std::size_t pos = bytes_.size() - 1;
+    for (auto num_steps = num_elements - index; num_steps > 0; --num_steps) {
+      pos = prev(pos);
+    }
+    return pos;
+  }
+  std::size_t pos = HEADER_SIZE;
+  for (; index > 0; --index) {
+    pos = next(pos);
+  }
+  return pos;
+}
+
+void Listpack::insert_encoded(std::size_t pos, std::string_view encoded) {
+  std::string entry(encoded);
+  append_backlen(entry, encoded.size());
+  bytes_.insert(pos, entry);
+  update_header(1);
+}
+
+void Listpack::erase_entries(std::size_t begin, std::size_t end,
+                             std::size_t num_elements) {
+  bytes_.erase(begin, end - begin);
+  update_header(-static_cast<std::int64_t>(num_elements));
+}
+
+void Listpack::update_header(std::int64_t num_elements_added) {
+  const auto num_elements =
+      read_little_endian(std::string_view(bytes_).substr(4, 2));
+  // Once the count has saturated we don't know it anymore without a walk,
+  // which size() does when asked, like in Redis.
+  const auto new_num_elements =
+      num_elements == UNKNOWN_NUM_ELEMENTS
+          ? UNKNOWN_NUM_ELEMENTS
+          : std::min<std::int64_t>(
+                static_cast<std::int64_t>(num_elements) + num_elements_added,
+                UNKNOWN_NUM_ELEMENTS);
+  set_header(static_cast<std::uint32_t>(bytes_.size()),
+             static_cast<std::uint16_t>(new_num_elements));
+}
+
+void Listpack::set_header(std::uint32_t total_bytes,
+                          std::uint16_t num_elements) {
+  // Written in place, since this happens on every change.
+  for (std::size_t i = 0; i < 4; ++i) {
+    bytes_[i] = static_cast<char>((total_bytes >> (8 * i)) & 0xFFU);
+  }
+  bytes_[4] = static_cast<char>(num_elements & 0xFFU);
+  bytes_[5] = static_cast<char>(num_elements >> 8U);
+}
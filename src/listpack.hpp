@@ -0,0 +1,130 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+
+// A listpack is a compact serialized list of strings and integers, laid out in
+// a single allocation exactly like Redis does (which also makes it the on-disk
+// format in RDB files). See
+// https://github.com/antirez/listpack/blob/master/listpack.md for the spec.
+//
+// The layout is:
+//   <total-bytes: u32> <num-elements: u16> <entry> ... <entry> <end: 0xFF>
+// where each entry is:
+//   <encoding-type + element-data> <backlen>
+// Integers (and strings that look like integers) are stored in as few bytes
+// as possible, and the backlen of each entry lets us walk it back to front.
+class Listpack {
+public:
+  // An element is either a string or an integer, depending on how it was
+  // encoded.
+  using Element = std::variant<std::string_view, std::int64_t>;
+
+  // An empty listpack.
+  Listpack();
+
+  // Wraps the given serialized listpack, or returns nullopt if it is
+  // malformed.
+  static std::optional<Listpack> from_bytes(std::string bytes);
+
+  // Appends the string, encoding it as an integer if it is the canonical form
+  // of one.
+  void push_back(std::string_view element);
+  void push_back(std::int64_t element);
+  // Appends all the elements at once, which saves rewriting the header and
+  // moving the end marker for each one.
+  void push_back(std::span<const Element> elements);
+  void push_front(std::string_view element);
+  // Removes the first or last element and returns it as a string. The
+  // listpack must not be empty.
+  std::string pop_front();
+  std::string pop_back();
+  // Removes count elements starting at index first (or as many as there are).
+  void erase(std::size_t first, std::size_t count);
+  // Replaces the element at the index, which must exist.
+  void replace(std::size_t index, std::string_view element);
+  // Inserts the element before the one at the index (or at the end if there
+  // are not that many).
+  void insert(std::size_t index, std::string_view element);
+  // The index of the first element equal to the given one, only comparing
+  // every (skip + 1)th element starting from the first. With a skip of 1 that
+  // finds the fields of alternating fields and values, like Redis's lpFind().
+  [[nodiscard]] std::optional<std::size_t> find(std::string_view element,
+                                                std::size_t skip = 0) const;
+
+  [[nodiscard]] std::size_t size() const;
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  // The serialized listpack, ready to be written out.
+  [[nodiscard]] const std::string &bytes() const { return bytes_; }
+
+  // Calls func(element) on every element from front to back. The string views
+  // point into the listpack and are only valid until it is modified.
+  template <typename Func> void for_each(Func &&func) const {
+    std::size_t pos = HEADER_SIZE;
+    while (static_cast<unsigned char>(bytes_[pos]) != END) {
+      std::size_t next_pos = 0;
+      func(element_at(pos, next_pos));
+      pos = next_pos;
+    }
+  }
+
+  // Calls func(element) on count elements starting at index first (or as many
+  // as there are), front to back.
+  template <typename Func>
+  void for_each(std::size_t first, std::size_t count, Func &&func) const {
+    std::size_t pos = offset_of(first);
+    for (; count > 0 && static_cast<unsigned char>(bytes_[pos]) != END;
+         --count) {
+      std::size_t next_pos = 0;
+      func(element_at(pos, next_pos));
+      pos = next_pos;
+    }
+  }
+
+  // Renders the element as a string, the way it was originally given.
+  static std::string to_string(const Element &element);
+
+  bool operator==(const Listpack &other) const = default;
+
+private:
+  static constexpr std::size_t HEADER_SIZE = 6;
+  static constexpr unsigned char END = 0xFF;
+  // The element count saturates at this value, after which counting the
+  // elements requires a walk.
+  static constexpr std::uint16_t UNKNOWN_NUM_ELEMENTS = 65535;
+
+  explicit Listpack(std::string bytes) : bytes_(std::move(bytes)) {}
+
+  // The element of the entry starting at the given offset.
+  [[nodiscard]] Element element_at(std::size_t pos) const;
+  // The same, also giving the offset of the entry after it, which saves
+  // decoding the entry twice when walking the listpack.
+  [[nodiscard]] Element element_at(std::size_t pos,
+                                   std::size_t &next_pos) const;
+  // The offset of the entry after the one starting at the given offset.
+  [[nodiscard]] std::size_t next(std::size_t pos) const;
+  // The offset of the entry before the one starting at the given offset (or
+  // of the last entry, given the offset of the end marker).
+  [[nodiscard]] std::size_t prev(std::size_t pos) const;
+  // The offset of the entry at the given index, or of the end marker if there
+  // are not that many.
+  [[nodiscard]] std::size_t offset_of(std::size_t index) const;
+  // Inserts an already encoded element (without its backlen) at the given
+  // offset.
+  void insert_encoded(std::size_t pos, std::string_view encoded);
+  // Removes the num_elements entries between the two offsets.
+  void erase_entries(std::size_t begin, std::size_t end,
+                     std::size_t num_elements);
+  // Adjusts the element count in the header after adding or removing
+  // elements, and the total bytes to match.
+  void update_header(std::int64_t num_elements_added);
+  void set_header(std::uint32_t total_bytes, std::uint16_t num_elements);
+
+  std::string bytes_;
+};
@@ -0,0 +1,52 @@
+// This source file's own header include.
+#include "lzf.hpp"
+
+std::optional<std::string> lzf_decompress(std::string_view compressed,
+                                          std::size_t decompressed_length) {
+  std::string out{};
+  out.reserve(decompressed_length);
+  std::size_t pos = 0;
+  while (pos < compressed.size()) {
+    const auto control = static_cast<unsigned char>(compressed[pos++]);
+    // Values below 32 mean a run of (control + 1) literal bytes follows.
+    if (control < 32) {
+      const std::size_t num_literals = control + 1U;
+      if (pos + num_literals > compressed.size() ||
+          out.size() + num_literals > decompressed_length) {
+        return std::nullopt;
+      }
+      out.append(compressed.substr(pos, num_literals));
+      pos += num_literals;
+      continue;
+    }
+    // Otherwise it's a back reference: the top 3 bits are the length (7 means
+    // the length continues in the next byte), and the low 5 bits are the high
+    // bits of the offset back from the end of the output.
+    std::size_t length = control >> 5U;
+    if (length == 7) {
+      if (pos >= compressed.size()) {
+        return std::nullopt;
+      }
+      length += static_cast<unsigned char>(compressed[pos++]);
+    }
+    if (pos >= compressed.size()) {
+      return std::nullopt;
+    }
+    const auto offset_low = static_cast<unsigned char>(compressed[pos++]);
+    const std::size_t offset = (((control & 0x1FU) << 8U) | offset_low) + 1;
+    length += 2;
+    if (offset > out.size() || out.size() + length > decompressed_length) {
+      return std::nullopt;
+    }
+    // The reference may overlap the bytes it produces (e.g. a run of a single
+    // repeated byte), so copy one byte at a time.
+    auto from = out.size() - offset;
+    for (std::size_t i = 0; i < length; ++i) {
+      out.push_back(out[from++]);
+    }
+  }
+  if (out.size() != decompressed_length) {
+    return std::nullopt;
+  }
+  return out;
+}
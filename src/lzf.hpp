@@ -0,0 +1,15 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Decompresses data compressed with LZF, which Redis uses for long strings in
+// RDB files (when "rdbcompression" is on). The decompressed length is stored
+// next to the compressed data, so it is passed in here. Returns nullopt if the
+// data is malformed or doesn't decompress to exactly that length. See
+// https://github.com/redis/redis/blob/unstable/src/lzf_d.c for the reference.
+std::optional<std::string> lzf_decompress(std::string_view compressed,
+                                          std::size_t decompressed_length);
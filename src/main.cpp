@@ -1,3 +1,11 @@
+// System includes.
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
 // Other includes.
 #include <CLI11.hpp>
 
@@ -9,6 +17,7 @@
 int main(int argc, char **argv) {
   Config config{};
   CLI::App app{"RedisClone"};
+  app.add_option("--port", config.port, "Port to listen on for clients.");
   auto *dir_option =
       app.add_option("--dir", config.dir,
                      "Directory where the RDB file is stored. Both --dir and "
@@ -19,7 +28,135 @@ int main(int argc, char **argv) {
                      "--dbfilename must be specified together.");
   dir_option->needs(dbfilename_option);
   dbfilename_option->needs(dir_option);
+  app.add_option("--databases", config.databases,
+                 "Number of databases clients can SELECT between.")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--lazyfree-lazy-user-del", config.lazyfree_lazy_user_del,
+                 "Free the values of DEL in the background like UNLINK "
+                 "(yes/no).");
+  app.add_option("--lazyfree-lazy-server-del",
+                 config.lazyfree_lazy_server_del,
+                 "Free values overwritten by writes in the background "
+                 "(yes/no).");
+  app.add_option("--lazyfree-lazy-user-flush",
+                 config.lazyfree_lazy_user_flush,
+                 "Make FLUSHDB and FLUSHALL default to ASYNC (yes/no).");
+  app.add_option("--list-max-listpack-size", config.list_max_listpack_size,
+                 "Elements per list node, or -1 to -5 for nodes of 4 to 64 "
+                 "KiB.")
+      ->check(CLI::Range(-5, 32767));
+  app.add_option("--hash-max-listpack-entries",
+                 config.hash_max_listpack_entries,
+                 "Most fields a hash may have while kept as a listpack.");
+  app.add_option("--hash-max-listpack-value", config.hash_max_listpack_value,
+                 "Longest field or value (in bytes) a hash may have while "
+                 "kept as a listpack.");
+  app.add_option("--set-max-intset-entries", config.set_max_intset_entries,
+                 "Most members a set of integers may have while kept as an "
+                 "intset.");
+  app.add_option("--set-max-listpack-entries",
+                 config.set_max_listpack_entries,
+                 "Most members a set may have while kept as a listpack.");
+  app.add_option("--set-max-listpack-value", config.set_max_listpack_value,
+                 "Longest member (in bytes) a set may have while kept as a "
+                 "listpack.");
+  app.add_option("--zset-max-listpack-entries",
+                 config.zset_max_listpack_entries,
+                 "Most members a sorted set may have while kept as a "
+                 "listpack.");
+  app.add_option("--zset-max-listpack-value", config.zset_max_listpack_value,
+                 "Longest member (in bytes) a sorted set may have while kept "
+                 "as a listpack.");
+  app.add_option("--hll-sparse-max-bytes", config.hll_sparse_max_bytes,
+                 "Largest size (in bytes) of a HyperLogLog kept in the sparse "
+                 "encoding.");
+  app.add_option("--stream-node-max-bytes", config.stream_node_max_bytes,
+                 "Largest size (in bytes) of a block of stream entries (0 for "
+                 "no limit).");
+  app.add_option("--stream-node-max-entries", config.stream_node_max_entries,
+                 "Most entries a block of stream entries may hold (0 for no "
+                 "limit).");
+  app.add_option("--appendonly", config.appendonly,
+                 "Log every write command to the append-only file (yes/no).");
+  app.add_option("--appendfilename", config.appendfilename,
+                 "Filename of the append-only file, stored in --dir.");
+  // Read as a string, so --help lists the names rather than the enum values.
+  std::string appendfsync = "everysec";
+  app.add_option("--appendfsync", appendfsync,
+                 "When to fsync the append-only file: always, everysec or no.")
+      ->transform(
+          CLI::IsMember({"always", "everysec", "no"}, CLI::ignore_case));
+  app.add_option("--auto-aof-rewrite-percentage",
+                 config.auto_aof_rewrite_percentage,
+                 "Rewrite the append-only file once it grows by this "
+                 "percentage since the last rewrite (0 to disable).");
+  app.add_option("--auto-aof-rewrite-min-size",
+                 config.auto_aof_rewrite_min_size,
+                 "Minimum size in bytes of the append-only file before it is "
+                 "automatically rewritten.");
+  app.add_option("--async-loading", config.async_loading,
+                 "Load the dataset in the background while accepting "
+                 "connections (yes/no).");
+  app.add_option("--loading-serve-keys", config.loading_serve_keys,
+                 "Serve reads of already loaded keys while loading "
+                 "asynchronously (yes/no).");
+  // Either "--replicaof <host> <port>" or "--replicaof '<host> <port>'".
+  std::vector<std::string> replicaof{};
+  app.add_option("--replicaof", replicaof,
+                 "Replicate the master at this host and port.")
+      ->expected(1, 2);
+  app.add_option("--repl-backlog-size", config.repl_backlog_size,
+                 "Bytes of recent writes kept for replicas to catch up on "
+                 "after reconnecting.");
+  app.add_option("--cluster-enabled", config.cluster_enabled,
+                 "Run as a node of a cluster, sharding keys by hash slot "
+                 "(yes/no).");
+  app.add_option("--cluster-announce-ip", config.cluster_announce_ip,
+                 "IP address other nodes and clients reach this node at.");
+  app.add_option("--client-output-buffer-limit-pubsub",
+                 config.client_output_buffer_limit_pubsub,
+                 "Bytes of messages a subscriber may have waiting before it "
+                 "is disconnected (0 for no limit).");
+  app.add_option("--tracking-table-max-keys", config.tracking_table_max_keys,
+                 "Keys remembered for client-side caching before evicting "
+                 "some (0 for no limit).");
+  app.add_option("--timeout", config.timeout,
+                 "Seconds a client may stay idle before it is disconnected "
+                 "(0 for never).");
+  app.add_option("--tcp-keepalive", config.tcp_keepalive,
+                 "Seconds of silence before probing a client's connection "
+                 "(0 to turn keepalive off).");
+  app.add_option("--slowlog-log-slower-than", config.slowlog_log_slower_than,
+                 "Microseconds a command must take to be logged in the slow "
+                 "log (negative to turn it off).");
+  app.add_option("--slowlog-max-len", config.slowlog_max_len,
+                 "Commands the slow log keeps.");
   CLI11_PARSE(app, argc, argv);
+  // Already lowercased by the transform.
+  if (appendfsync == "always") {
+    config.appendfsync = AppendFsync::Always;
+  } else if (appendfsync == "no") {
+    config.appendfsync = AppendFsync::No;
+  } else {
+    config.appendfsync = AppendFsync::EverySec;
+  }
+  if (!replicaof.empty()) {
+    std::istringstream fields(replicaof.front() + " " +
+                              (replicaof.size() > 1 ? replicaof.back() : ""));
+    std::string host{};
+    std::uint32_t port = 0;
+    if (!(fields >> host >> port) || port == 0 ||
+        port > std::numeric_limits<std::uint16_t>::max()) {
+      std::cerr << "--replicaof expects a host and a port" << std::endl;
+      return 1;
+    }
+    config.master_host = std::move(host);
+    config.master_port = static_cast<std::uint16_t>(port);
+  }
+  if (config.cluster_enabled && config.master_host) {
+    std::cerr << "Cluster nodes can't be replicas (yet)" << std::endl;
+    return 1;
+  }
 
   Server server{std::move(config)};
   if (!server.is_ready()) {
@@ -2,12 +2,22 @@
 #include "network.hpp"
 
 // System includes.
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
+#include <cerrno>
 #include <cstddef>
 #include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
 
-std::optional<SocketFd> create_server_socket() {
+std::optional<SocketFd> create_server_socket(const std::uint16_t port) {
   // Create the socket.
   int server_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
@@ -28,16 +38,17 @@ std::optional<SocketFd> create_server_socket() {
   struct sockaddr_in server_addr {};
   server_addr.sin_family = AF_INET;
   server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(6379);
+  server_addr.sin_port = htons(port);
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
   if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) !=
       0) {
-    std::cerr << "Failed to bind to port 6379\n";
+    std::cerr << "Failed to bind to port " << port << "\n";
     return std::nullopt;
   }
 
-  // Listen on that socket.
-  int connection_backlog = 5;
+  // Listen on that socket. The backlog is Redis's default (tcp-backlog), so
+  // that bursts of clients connecting at once don't get dropped.
+  int connection_backlog = 511;
   if (listen(server_fd, connection_backlog) != 0) {
     std::cerr << "listen failed\n";
     return std::nullopt;
@@ -61,8 +72,124 @@ SocketFd await_client_connection(const SocketFd server_fd) {
   return SocketFd(client_fd);
 }
 
-void send_to_client(const SocketFd client_fd, const std::string &message) {
-  send(static_cast<int>(client_fd), message.c_str(), message.size(), 0);
+std::optional<SocketFd> connect_to_server(const std::string &host,
+                                          const std::uint16_t port) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &addresses) != 0) {
+    std::cerr << "Failed to resolve " << host << "\n";
+    return std::nullopt;
+  }
+  std::optional<SocketFd> connected{};
+  for (const auto *address = addresses; address && !connected;
+       address = address->ai_next) {
+    const int fd = socket(address->ai_family,
+                          address->ai_socktype | SOCK_CLOEXEC,
+                          address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      connected = SocketFd(fd);
+    } else {
+      close(fd);
+    }
+  }
+  freeaddrinfo(addresses);
+  return connected;
+}
+
+bool send_to_client(const SocketFd client_fd, std::string_view message) {
+  // A single send may only take part of a big message. MSG_NOSIGNAL turns a
+  // closed connection into an error rather than a SIGPIPE.
+  while (!message.empty()) {
+    const auto sent = send(static_cast<int>(client_fd), message.data(),
+                           message.size(), MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    message.remove_prefix(static_cast<std::size_t>(sent));
+  }
+  return true;
+}
+
+bool poll_for_data(const SocketFd socket_fd,
+                   const std::chrono::milliseconds timeout) {
+  pollfd poll_fd{};
+  poll_fd.fd = static_cast<int>(socket_fd);
+  poll_fd.events = POLLIN;
+  return poll(&poll_fd, 1, static_cast<int>(timeout.count())) > 0;
+}
+
+void set_socket_timeout(const SocketFd socket_fd,
+                        const std::chrono::milliseconds timeout) {
+  const auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  timeval time{};
+  time.tv_sec = seconds.count();
+  time.tv_usec =
+      std::chrono::duration_cast<std::chrono::microseconds>(timeout - seconds)
+          .count();
+  for (const auto option : {SO_RCVTIMEO, SO_SNDTIMEO}) {
+    setsockopt(static_cast<int>(socket_fd), SOL_SOCKET, option, &time,
+               sizeof(time));
+  }
+}
+
+void set_keepalive(const SocketFd socket_fd,
+                   const std::chrono::seconds interval) {
+  // Like Redis: probe every third of the interval after it, and give up after
+  // 3 unanswered probes.
+  const int enable = 1;
+  const int idle = static_cast<int>(interval.count());
+  const int probe_interval = std::max(1, idle / 3);
+  const int num_probes = 3;
+  const int fd = static_cast<int>(socket_fd);
+  if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable)) != 0 ||
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) != 0 ||
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &probe_interval,
+                 sizeof(probe_interval)) != 0 ||
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &num_probes,
+                 sizeof(num_probes)) != 0) {
+    std::cerr << "Failed to turn on TCP keepalive for " << fd << "\n";
+  }
+}
+
+std::string get_peer_address(const SocketFd socket_fd) {
+  sockaddr_in address{};
+  socklen_t address_len = sizeof(address);
+  std::array<char, INET_ADDRSTRLEN> text{};
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (getpeername(static_cast<int>(socket_fd),
+                  reinterpret_cast<sockaddr *>(&address), &address_len) != 0 ||
+      inet_ntop(AF_INET, &address.sin_addr, text.data(), text.size()) ==
+          nullptr) {
+    return "?";
+  }
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+  return text.data();
+}
+
+std::string get_peer_address_and_port(const SocketFd socket_fd) {
+  sockaddr_in address{};
+  socklen_t address_len = sizeof(address);
+  std::array<char, INET_ADDRSTRLEN> text{};
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (getpeername(static_cast<int>(socket_fd),
+                  reinterpret_cast<sockaddr *>(&address), &address_len) != 0 ||
+      inet_ntop(AF_INET, &address.sin_addr, text.data(), text.size()) ==
+          nullptr) {
+    return "?:0";
+  }
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+  return std::string(text.data()) + ":" +
+         std::to_string(ntohs(address.sin_port));
 }
 
 std::optional<std::string>
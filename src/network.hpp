@@ -1,9 +1,12 @@
 #pragma once
 
 // System includes.
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 
 // A strong typedef that can explicitly convert to the underlying type (int).
 class SocketFd {
@@ -15,17 +18,41 @@ private:
   int value;
 };
 
-// Creates a socket, binds it to port 6379, listens on it, and returns its file
+// Creates a socket, binds it to the port, listens on it, and returns its file
 // descriptor.
-std::optional<SocketFd> create_server_socket();
+std::optional<SocketFd> create_server_socket(std::uint16_t port = 6379);
+
+// Connects to the server at the host (a name or an IP address) and port, and
+// returns the socket's file descriptor, or nullopt if it couldn't connect.
+std::optional<SocketFd> connect_to_server(const std::string &host,
+                                          std::uint16_t port);
 
 // Blocks on the given socket fd until it connects to a client, and returns the
 // client's socket file descriptor.
 SocketFd await_client_connection(const SocketFd server_fd);
 
 // Sends the given string message over the socket specified by the client file
-// descriptor.
-void send_to_client(const SocketFd client_fd, const std::string &message);
+// descriptor. Returns false if the connection is gone.
+bool send_to_client(const SocketFd client_fd, std::string_view message);
+
+// Waits up to the timeout for something to read from the socket (data, or the
+// other end hanging up). Returns whether there is.
+bool poll_for_data(const SocketFd socket_fd, std::chrono::milliseconds timeout);
+
+// Makes reads and writes on the socket fail once they block for longer than
+// the timeout.
+void set_socket_timeout(const SocketFd socket_fd,
+                        std::chrono::milliseconds timeout);
+
+// Turns on TCP keepalive for the connection: once it has been silent for the
+// interval, the other end is probed, and the connection fails if it doesn't
+// answer a few probes in a row.
+void set_keepalive(const SocketFd socket_fd, std::chrono::seconds interval);
+
+// The IP address of the other end of the connection, or "?" if unknown.
+std::string get_peer_address(const SocketFd socket_fd);
+// The "ip:port" of the other end of the connection, or "?:0" if unknown.
+std::string get_peer_address_and_port(const SocketFd socket_fd);
 
 // Waits to receive data from the given client and returns it as a string (or
 // nullopt if the client closes the connection).
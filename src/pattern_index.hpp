@@ -0,0 +1,143 @@
+#pragma once
+
+// System includes.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Our library's header includes.
+#include "glob.hpp"
+
+// The pattern subscriptions (PSUBSCRIBE) of a set of subscribers, indexed so
+// that finding the patterns a channel matches doesn't try every pattern.
+// Patterns are kept in a trie by their literal prefix (what comes before the
+// first wildcard), so a channel only visits the nodes along its own prefixes,
+// and only the patterns there are tried. Each pattern is also sorted ahead of
+// time by what is left after its prefix: nothing (only that exact channel),
+// a lone "*" (any channel with the prefix), or a glob to match the rest of
+// the channel against.
+// Not thread-safe.
+template <typename Subscriber> class PatternIndex {
+public:
+  // Returns false if the subscriber already had the pattern.
+  bool add(const std::string &pattern, const Subscriber &subscriber) {
+    const auto [prefix, prefix_size] = glob_literal_prefix(pattern);
+    Node *node = &root_;
+    for (const char character : prefix) {
+      auto &child = node->children[character];
+      if (!child) {
+        child = std::make_unique<Node>();
+      }
+      node = child.get();
+    }
+    auto entry = std::ranges::find(node->entries, pattern, &Entry::pattern);
+    if (entry == node->entries.end()) {
+      const auto rest = std::string_view(pattern).substr(prefix_size);
+      node->entries.push_back(Entry{pattern, prefix_size,
+                                    rest.empty()   ? Kind::Exact
+                                    : rest == "*" ? Kind::AnySuffix
+                                                  : Kind::Glob,
+                                    {}});
+      entry = std::prev(node->entries.end());
+      ++size_;
+    } else if (std::ranges::find(entry->subscribers, subscriber) !=
+               entry->subscribers.end()) {
+      return false;
+    }
+    entry->subscribers.push_back(subscriber);
+    return true;
+  }
+
+  // Returns false if the subscriber didn't have the pattern.
+  bool remove(const std::string &pattern, const Subscriber &subscriber) {
+    const auto prefix = glob_literal_prefix(pattern).first;
+    // The nodes along the prefix, to prune the ones left empty.
+    std::vector<Node *> path{&root_};
+    for (const char character : prefix) {
+      const auto child = path.back()->children.find(character);
+      if (child == path.back()->children.end()) {
+        return false;
+      }
+      path.push_back(child->second.get());
+    }
+    auto &entries = path.back()->entries;
+    const auto entry = std::ranges::find(entries, pattern, &Entry::pattern);
+    if (entry == entries.end()) {
+      return false;
+    }
+    auto &subscribers = entry->subscribers;
+    const auto found = std::ranges::find(subscribers, subscriber);
+    if (found == subscribers.end()) {
+      return false;
+    }
+    // The order of the subscribers doesn't matter.
+    *found = std::move(subscribers.back());
+    subscribers.pop_back();
+    if (subscribers.empty()) {
+      entries.erase(entry);
+      --size_;
+    }
+    for (std::size_t depth = prefix.size(); depth > 0; --depth) {
+      const Node *node = path[depth];
+      if (!node->entries.empty() || !node->children.empty()) {
+        break;
+      }
+      path[depth - 1]->children.erase(prefix[depth - 1]);
+    }
+    return true;
+  }
+
+  // Calls func(pattern, subscribers) for every pattern the channel matches.
+  template <typename Func>
+  void for_each_match(std::string_view channel, Func &&func) const {
+    const Node *node = &root_;
+    for (std::size_t depth = 0;; ++depth) {
+      for (const auto &entry : node->entries) {
+        const bool matches =
+            entry.kind == Kind::AnySuffix ||
+            (entry.kind == Kind::Exact && depth == channel.size()) ||
+            (entry.kind == Kind::Glob &&
+             glob_match(std::string_view(entry.pattern)
+                            .substr(entry.prefix_size),
+                        channel.substr(depth)));
+        if (matches) {
+          func(entry.pattern, entry.subscribers);
+        }
+      }
+      if (depth == channel.size()) {
+        return;
+      }
+      const auto child = node->children.find(channel[depth]);
+      if (child == node->children.end()) {
+        return;
+      }
+      node = child->second.get();
+    }
+  }
+
+  // The number of distinct patterns.
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+private:
+  enum class Kind : std::uint8_t { Exact, AnySuffix, Glob };
+  struct Entry {
+    std::string pattern;
+    // How much of the pattern is the literal prefix.
+    std::size_t prefix_size = 0;
+    Kind kind = Kind::Glob;
+    std::vector<Subscriber> subscribers;
+  };
+  struct Node {
+    std::map<char, std::unique_ptr<Node>> children;
+    std::vector<Entry> entries;
+  };
+
+  Node root_;
+  std::size_t size_ = 0;
+};
@@ -2,12 +2,36 @@
 #include "protocol.hpp"
 
 // System includes.
-#include <cassert>
+#include <cstddef>
 #include <exception>
 #include <iostream>
 #include <ostream>
 #include <variant>
 
+namespace {
+
+// Reads an integer terminated by "\r\n" starting at pos, and moves pos past
+// the terminator. Returns nullopt if the data ends first.
+std::optional<std::size_t> read_terminated_int(std::string_view data,
+                                               std::size_t &pos) {
+  const auto terminator_pos = data.find(TERMINATOR, pos);
+  if (terminator_pos == std::string_view::npos) {
+    return std::nullopt;
+  }
+  std::size_t value = 0;
+  for (auto i = pos; i < terminator_pos; ++i) {
+    if (data[i] < '0' || data[i] > '9') {
+      std::cerr << "Invalid integer in RESP data at offset " << i << std::endl;
+      std::terminate();
+    }
+    value = (value * 10) + static_cast<std::size_t>(data[i] - '0');
+  }
+  pos = terminator_pos + 2;
+  return value;
+}
+
+} // namespace
+
 // TODO this is causing issues in MSAN
 std::ostream &operator<<(std::ostream &outs, const Message &message) {
   outs << "Message (data_type: " << static_cast<int>(message.data_type)
@@ -15,12 +39,15 @@ std::ostream &operator<<(std::ostream &outs, const Message &message) {
   std::visit(MessageDataVisitor{
                  [&outs](const Message::NestedVariantT &message_data) {
                    outs << "vector of size " << message_data.size() << ": [\n";
+                   // Nested arrays (like the entries of XRANGE) are printed
+                   // whole.
                    for (const auto &message : message_data) {
-                     assert(std::holds_alternative<Message::StringVariantT>(
-                                message.data) &&
-                            "Nested Array messages are not allowed");
-                     outs << std::get<Message::StringVariantT>(message.data)
-                          << ",\n";
+                     if (const auto *str = std::get_if<Message::StringVariantT>(
+                             &message.data)) {
+                       outs << *str << ",\n";
+                     } else {
+                       outs << message << ",\n";
+                     }
                    }
                    outs << "\n]";
                  },
@@ -36,4 +63,47 @@ std::ostream &operator<<(std::ostream &outs, const Message &message) {
              message.data);
   outs << ")\n";
   return outs;
-}
\ No newline at end of file
+}
+
+std::optional<Message> parse_command_array(std::string_view data,
+                                           std::size_t &pos) {
+  const auto expect_byte = [&data](std::size_t offset, char expected) {
+    if (data[offset] != expected) {
+      std::cerr << "Expected '" << expected << "' in RESP data at offset "
+                << offset << std::endl;
+      std::terminate();
+    }
+  };
+  // Only move pos once we have the whole command.
+  auto cursor = pos;
+  if (cursor >= data.size()) {
+    return std::nullopt;
+  }
+  expect_byte(cursor, '*');
+  ++cursor;
+  const auto num_elements = read_terminated_int(data, cursor);
+  if (!num_elements) {
+    return std::nullopt;
+  }
+  Message::NestedVariantT elements{};
+  elements.reserve(*num_elements);
+  for (std::size_t i = 0; i < *num_elements; ++i) {
+    if (cursor >= data.size()) {
+      return std::nullopt;
+    }
+    expect_byte(cursor, '$');
+    ++cursor;
+    const auto length = read_terminated_int(data, cursor);
+    if (!length || cursor + *length + 2 > data.size()) {
+      return std::nullopt;
+    }
+    elements.emplace_back(std::string(data.substr(cursor, *length)),
+                          DataType::BulkString);
+    cursor += *length;
+    expect_byte(cursor, '\r');
+    expect_byte(cursor + 1, '\n');
+    cursor += 2;
+  }
+  pos = cursor;
+  return Message{std::move(elements), DataType::Array};
+}
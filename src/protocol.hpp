@@ -2,15 +2,20 @@
 
 // System includes.
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 // This file contains all the types required to work with the Redis
-// serialization protocol specification (RESP). Only RESP 2.0 is supported, 3.0
-// is explicitly not supported.
+// serialization protocol specification (RESP). Requests are always RESP 2.0.
+// Replies can be RESP 3.0 for clients that ask for it with HELLO 3, and are
+// turned into their closest RESP 2.0 equivalent for everyone else.
 
 // This is the terminator for the RESP protocol that separates its parts.
 static constexpr auto TERMINATOR = "\r\n";
@@ -29,20 +34,42 @@ enum class DataType : std::uint8_t {
   // TODO we currently don't handle reading NullBulkString correctly, only
   // writing it out.
   NullBulkString,
+  // The null array: *-1\r\n, or _\r\n in RESP3. Like NullBulkString, it
+  // holds an empty string.
+  NullArray,
   // Comes in this format: *<num_elems>\r\n<elem_1>\r\n....<elem_n>\r\n
   Array,
-  // The rest of these we don't implement for now.
+  // RESP3 only. Each is sent as its RESP2 equivalent to RESP2 clients (in
+  // parentheses). Null: _\r\n ($-1). Boolean, with data "1" or "0": #t\r\n
+  // or #f\r\n (:1 or :0). Double: ,<data>\r\n (a bulk string).
   Null,
   Boolean,
   Double,
+  // Not implemented.
   BigNumber,
   BulkError,
   VerbatimString,
+  // RESP3 only aggregates, whose elements are held like an Array's. A Map's
+  // elements alternate between keys and values. Map: %<num_pairs>, Set:
+  // ~<num_elems>, Push (out-of-band data, like pub/sub messages):
+  // ><num_elems> (all three are sent as arrays to RESP2 clients).
   Map,
   Set,
   Push,
 };
 
+// Whether Messages of the type hold other Messages.
+constexpr bool is_aggregate(DataType data_type) {
+  return data_type == DataType::Array || data_type == DataType::Map ||
+         data_type == DataType::Set || data_type == DataType::Push;
+}
+
+// The RESP versions a client can pick with HELLO.
+enum class Protocol : std::uint8_t {
+  Resp2 = 2,
+  Resp3 = 3,
+};
+
 // TODO consider using wise_enum to make parsing these commands easier.
 // These are the kinds of commands sent from the client that the server is able
 // to parse and respond to.
@@ -54,6 +81,83 @@ enum class CommandVerb : std::uint8_t {
   Get,
   ConfigGet,
   Keys,
+  Save,
+  BgRewriteAof,
+  Info,
+  Type,
+  Select,
+  SwapDb,
+  FlushDb,
+  FlushAll,
+  Del,
+  Unlink,
+  LPush,
+  RPush,
+  LPop,
+  RPop,
+  LLen,
+  LRange,
+  LTrim,
+  HSet,
+  HGet,
+  HMGet,
+  HGetAll,
+  HDel,
+  HIncrBy,
+  HScan,
+  ZAdd,
+  ZIncrBy,
+  ZRange,
+  ZRangeByScore,
+  ZRank,
+  ZRem,
+  ZCard,
+  SAdd,
+  SRem,
+  SIsMember,
+  SMembers,
+  SCard,
+  SInter,
+  SUnion,
+  SDiff,
+  SInterCard,
+  SetBit,
+  GetBit,
+  BitCount,
+  BitPos,
+  BitOp,
+  PfAdd,
+  PfCount,
+  PfMerge,
+  XAdd,
+  XRange,
+  XRevRange,
+  XLen,
+  XTrim,
+  XRead,
+  BLPop,
+  BRPop,
+  ReplConf,
+  PSync,
+  Cluster,
+  Asking,
+  Migrate,
+  Dump,
+  Restore,
+  Subscribe,
+  Unsubscribe,
+  PSubscribe,
+  PUnsubscribe,
+  Publish,
+  PubSub,
+  Hello,
+  Client,
+  Multi,
+  Exec,
+  Discard,
+  Watch,
+  Unwatch,
+  SlowLog,
 };
 
 // A Message sent from the client to the server is parsed into a Command.
@@ -64,6 +168,15 @@ struct Command {
   std::vector<std::string> arguments;
 };
 
+// What a blocking command (BLPOP, BRPOP, or XREAD with BLOCK) waits for when
+// there is nothing to reply with yet.
+struct BlockingSpec {
+  // The keys whose changes may let the command go through.
+  std::vector<std::string> keys;
+  // How long to wait before replying with nil, or forever if unset.
+  std::optional<std::chrono::milliseconds> timeout;
+};
+
 // helper type to create visitors for the Message data variant.
 template <class... Ts> struct MessageDataVisitor : Ts... {
   using Ts::operator()...;
@@ -97,12 +210,13 @@ public:
       : data(std::forward<T>(data_in)), data_type(data_type_in) {
     // TODO this check might make things too slow. Profile this at some point.
     // We check that the data_type and the data variant always match. i.e. if
-    // data_type is Array, then the data is of the nested (vector) variant.
-    // Otherwise, the data is of the non-nested string variant.
-    if (data_type == DataType::Array) {
+    // data_type is an aggregate like Array, then the data is of the nested
+    // (vector) variant. Otherwise, the data is of the non-nested string
+    // variant.
+    if (is_aggregate(data_type)) {
       if constexpr (!std::is_convertible_v<std::decay_t<T>, NestedVariantT>) {
-        assert(false &&
-               "Array messages must be initialized with a vector<Message>");
+        assert(false && "Aggregate messages must be initialized with a "
+                        "vector<Message>");
       }
     } else {
       if constexpr (!std::is_convertible_v<std::decay_t<T>, StringVariantT>) {
@@ -123,3 +237,11 @@ public:
   // For displaying in GTEST.
   friend std::ostream &operator<<(std::ostream &outs, const Message &message);
 };
+
+// Parses one command sent as a RESP Array of BulkStrings (like clients send
+// them, and like the append-only file and the replication stream hold them)
+// starting at pos, and moves pos past it. Returns nullopt (leaving pos alone)
+// if the data ends before the command does. Malformed data is fatal, so this
+// is only for data we trust.
+std::optional<Message> parse_command_array(std::string_view data,
+                                           std::size_t &pos);
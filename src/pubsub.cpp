@@ -0,0 +1,751 @@
+// This source file's own header include.
+#include "pubsub.hpp"
+
+// System includes.
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <span>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+// Our library's header includes.
+#include "glob.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// The most messages written out with one sendmsg() call.
+constexpr std::size_t MAX_IOVECS = 64;
+
+Message bulk(const std::string &data) {
+  return Message{data, DataType::BulkString};
+}
+
+// The replies to (P)SUBSCRIBE and (P)UNSUBSCRIBE: the kind of reply, the
+// channel or pattern (nil if there was none to unsubscribe from) and how
+// many the client is still subscribed to. Like messages, RESP3 clients get
+// them as push data.
+Message subscription_reply(const std::string &kind,
+                           const std::string *channel, std::size_t count) {
+  return Message{
+      Message::NestedVariantT{
+          bulk(kind),
+          channel ? bulk(*channel) : Message{"", DataType::NullBulkString},
+          Message{std::to_string(count), DataType::Integer}},
+      DataType::Push};
+}
+
+SharedMessage serialize(const Message &message, Protocol protocol) {
+  return std::make_shared<const std::string>(
+      message_to_string(message, protocol));
+}
+
+// A message serialized for each protocol the first time a subscriber
+// speaking it needs it.
+class LazyMessage {
+public:
+  explicit LazyMessage(Message message) : message_(std::move(message)) {}
+
+  const SharedMessage &get(Protocol protocol) {
+    auto &serialized = serialized_[protocol == Protocol::Resp3 ? 1 : 0];
+    if (!serialized) {
+      serialized = serialize(message_, protocol);
+    }
+    return serialized;
+  }
+
+private:
+  Message message_;
+  std::array<SharedMessage, 2> serialized_{};
+};
+
+} // namespace
+
+PubSub::PubSub(Resume resume, std::size_t output_buffer_limit,
+               Closed closed)
+    : resume_(std::move(resume)), output_buffer_limit_(output_buffer_limit),
+      closed_(std::move(closed)),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = 0;
+  if (epoll_fd_ < 0 || wake_fd_ < 0 ||
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0) {
+    std::cerr << "Failed to set up sending to subscribers: "
+              << std::system_category().message(errno) << std::endl;
+    std::terminate();
+  }
+  sender_ = std::jthread([this](const std::stop_token &stop) { run(stop); });
+}
+
+PubSub::~PubSub() {
+  sender_.request_stop();
+  wake();
+  sender_.join();
+  for (const auto &[id, subscriber] : subscribers_) {
+    // Attached clients' sockets belong to their tasks.
+    if (!subscriber->attached) {
+      close(static_cast<int>(subscriber->fd));
+    }
+  }
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+void PubSub::subscribe(const SocketFd fd, const ClientState &state,
+                       const Command &command) {
+  std::unique_lock lock(mutex_);
+  if (const auto found = by_client_.find(state.id);
+      state.id != 0 && found != by_client_.end() && found->second->attached) {
+    // Its queue carries on, so what was pushed to it stays in order.
+    auto &subscriber = *found->second;
+    {
+      std::scoped_lock send_lock(subscriber.send_mutex);
+      subscriber.attached = false;
+      subscriber.stays_attached = true;
+      subscriber.state = state;
+      // Has the sender thread write out whatever is queued.
+      subscriber.waiting_to_write = true;
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+      event.data.u64 = subscriber.id;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, static_cast<int>(fd), &event);
+    }
+    handle(subscriber, command);
+    mark_dirty({subscriber.id});
+    return;
+  }
+  const Id id = next_id_++;
+  auto &subscriber =
+      *subscribers_.emplace(id, std::make_unique<Subscriber>(id, fd, state))
+           .first->second;
+  if (state.id != 0) {
+    by_client_[state.id] = &subscriber;
+  }
+  handle(subscriber, command);
+  // Whatever the client sends from now on is read by the sender thread.
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.u64 = id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, static_cast<int>(fd), &event);
+}
+
+std::size_t PubSub::publish(const std::string &channel,
+                            const std::string &message) {
+  std::size_t num_receivers = 0;
+  std::vector<Id> dirty{};
+  {
+    std::shared_lock lock(mutex_);
+    const auto send_to = [&](const std::vector<Subscriber *> &subscribers,
+                             LazyMessage serialized) {
+      for (auto *subscriber : subscribers) {
+        if (enqueue(*subscriber,
+                    serialized.get(subscriber->state.protocol))) {
+          dirty.push_back(subscriber->id);
+        }
+      }
+      num_receivers += subscribers.size();
+    };
+    if (const auto subscribers = channels_.find(channel);
+        subscribers != channels_.end()) {
+      send_to(subscribers->second,
+              LazyMessage(Message{Message::NestedVariantT{bulk("message"),
+                                                           bulk(channel),
+                                                           bulk(message)},
+                                  DataType::Push}));
+    }
+    patterns_.for_each_match(channel, [&](const std::string &pattern,
+                                          const auto &subscribers) {
+      send_to(subscribers,
+              LazyMessage(Message{Message::NestedVariantT{bulk("pmessage"),
+                                                           bulk(pattern),
+                                                           bulk(channel),
+                                                           bulk(message)},
+                                  DataType::Push}));
+    });
+  }
+  mark_dirty(dirty);
+  return num_receivers;
+}
+
+void PubSub::attach(const SocketFd fd, const ClientState &state) {
+  std::unique_lock lock(mutex_);
+  if (by_client_.contains(state.id)) {
+    return;
+  }
+  const Id id = next_id_++;
+  auto &subscriber =
+      *subscribers_.emplace(id, std::make_unique<Subscriber>(id, fd, state))
+           .first->second;
+  subscriber.attached = true;
+  by_client_[state.id] = &subscriber;
+  // Only watched for being writable while something is left to write, and
+  // edge-triggered, so the client hanging up (which its task handles) isn't
+  // reported over and over.
+  epoll_event event{};
+  event.events = EPOLLET;
+  event.data.u64 = id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, static_cast<int>(fd), &event);
+}
+
+void PubSub::detach(const std::uint64_t client_id) {
+  Id id = 0;
+  {
+    std::unique_lock lock(mutex_);
+    const auto found = by_client_.find(client_id);
+    if (found == by_client_.end() || !found->second->attached) {
+      return;
+    }
+    auto &subscriber = *found->second;
+    {
+      // Waits for the sender thread to be done writing to it.
+      std::scoped_lock send_lock(subscriber.send_mutex);
+      subscriber.detached = true;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, static_cast<int>(subscriber.fd),
+                nullptr);
+    }
+    by_client_.erase(found);
+    id = subscriber.id;
+  }
+  // The sender thread frees it.
+  mark_dirty({id});
+}
+
+void PubSub::set_protocol(const std::uint64_t client_id,
+                          const Protocol protocol) {
+  std::unique_lock lock(mutex_);
+  if (const auto found = by_client_.find(client_id);
+      found != by_client_.end() && found->second->attached) {
+    found->second->state.protocol = protocol;
+  }
+}
+
+void PubSub::send(const std::uint64_t client_id, const SocketFd fd,
+                  const std::string_view reply) {
+  // Only its task detaches an attached client, so it outlives this.
+  Subscriber *subscriber = nullptr;
+  {
+    std::shared_lock lock(mutex_);
+    const auto found = by_client_.find(client_id);
+    if (found != by_client_.end() && found->second->attached) {
+      subscriber = found->second;
+    }
+  }
+  if (!subscriber) {
+    send_to_client(fd, reply);
+    return;
+  }
+  {
+    std::scoped_lock send_lock(subscriber->send_mutex);
+    // What was queued was pushed before the reply, so it goes first.
+    std::deque<SharedMessage> queued{};
+    std::size_t sent_of_front = 0;
+    {
+      std::scoped_lock lock(subscriber->queue_mutex);
+      queued.swap(subscriber->queue);
+      sent_of_front = std::exchange(subscriber->sent_of_front, 0);
+      subscriber->queued_bytes = 0;
+    }
+    for (const auto &message : queued) {
+      send_to_client(fd, std::string_view(*message).substr(
+                             std::exchange(sent_of_front, 0)));
+    }
+    send_to_client(fd, reply);
+  }
+  // The sender thread gives up on what is pushed while we hold send_mutex.
+  bool is_empty = true;
+  {
+    std::scoped_lock lock(subscriber->queue_mutex);
+    is_empty = subscriber->queue.empty();
+  }
+  if (!is_empty) {
+    mark_dirty({subscriber->id});
+  }
+}
+
+bool PubSub::push(const std::uint64_t client_id, const Message &message) {
+  std::vector<Id> dirty{};
+  {
+    std::shared_lock lock(mutex_);
+    const auto found = by_client_.find(client_id);
+    if (found == by_client_.end() || found->second->attached) {
+      return false;
+    }
+    auto &subscriber = *found->second;
+    if (enqueue(subscriber, serialize(message, subscriber.state.protocol))) {
+      dirty.push_back(subscriber.id);
+    }
+  }
+  mark_dirty(dirty);
+  return true;
+}
+
+Message PubSub::introspect(const Command &command) const {
+  const auto &args = command.arguments;
+  const auto subcommand = tolower(args.front());
+  std::shared_lock lock(mutex_);
+  if (subcommand == "channels" && args.size() <= 2) {
+    Message::NestedVariantT channels{};
+    for (const auto &[channel, subscribers] : channels_) {
+      if (args.size() == 1 || glob_match(args[1], channel)) {
+        channels.push_back(bulk(channel));
+      }
+    }
+    return Message{std::move(channels), DataType::Array};
+  }
+  if (subcommand == "numsub") {
+    // Each channel followed by its number of subscribers.
+    Message::NestedVariantT counts{};
+    for (const auto &channel : std::span(args).subspan(1)) {
+      const auto subscribers = channels_.find(channel);
+      counts.push_back(bulk(channel));
+      counts.emplace_back(std::to_string(subscribers == channels_.end()
+                                             ? 0
+                                             : subscribers->second.size()),
+                          DataType::Integer);
+    }
+    return Message{std::move(counts), DataType::Array};
+  }
+  if (subcommand == "numpat" && args.size() == 1) {
+    return Message{std::to_string(patterns_.size()), DataType::Integer};
+  }
+  return Message{"ERR unknown subcommand or wrong number of arguments for '" +
+                     args.front() + "'",
+                 DataType::SimpleError};
+}
+
+bool PubSub::push_resp3(const std::uint64_t client_id,
+                        const Message &message) {
+  std::vector<Id> dirty{};
+  {
+    std::shared_lock lock(mutex_);
+    const auto found = by_client_.find(client_id);
+    if (found == by_client_.end() ||
+        found->second->state.protocol != Protocol::Resp3) {
+      return false;
+    }
+    auto &subscriber = *found->second;
+    if (enqueue(subscriber, serialize(message, Protocol::Resp3))) {
+      dirty.push_back(subscriber.id);
+    }
+  }
+  mark_dirty(dirty);
+  return true;
+}
+
+std::size_t PubSub::num_subscribers() const {
+  std::shared_lock lock(mutex_);
+  return static_cast<std::size_t>(
+      std::ranges::count_if(subscribers_, [](const auto &entry) {
+        return !entry.second->attached;
+      }));
+}
+
+bool PubSub::enqueue(Subscriber &subscriber, SharedMessage message) const {
+  std::scoped_lock lock(subscriber.queue_mutex);
+  if (subscriber.overflowed) {
+    return false;
+  }
+  subscriber.queued_bytes += message->size();
+  if (output_buffer_limit_ > 0 &&
+      subscriber.queued_bytes > output_buffer_limit_) {
+    // The sender thread disconnects it.
+    subscriber.overflowed = true;
+    subscriber.queue.clear();
+    return true;
+  }
+  subscriber.queue.push_back(std::move(message));
+  return subscriber.queue.size() == 1;
+}
+
+void PubSub::reply(Subscriber &subscriber, const Message &message) {
+  if (enqueue(subscriber, serialize(message, subscriber.state.protocol))) {
+    mark_dirty({subscriber.id});
+  }
+}
+
+void PubSub::mark_dirty(const std::vector<Id> &ids) {
+  if (ids.empty()) {
+    return;
+  }
+  bool was_empty = false;
+  {
+    std::scoped_lock lock(dirty_mutex_);
+    was_empty = dirty_.empty();
+    dirty_.insert(dirty_.end(), ids.begin(), ids.end());
+  }
+  if (was_empty) {
+    wake();
+  }
+}
+
+void PubSub::handle(Subscriber &subscriber, const Command &command) {
+  const auto count = [&subscriber] {
+    return subscriber.channels.size() + subscriber.patterns.size();
+  };
+  const auto &args = command.arguments;
+  switch (command.verb) {
+  case CommandVerb::Subscribe:
+    for (const auto &channel : args) {
+      if (subscriber.channels.insert(channel).second) {
+        channels_[channel].push_back(&subscriber);
+      }
+      reply(subscriber, subscription_reply("subscribe", &channel, count()));
+    }
+    break;
+  case CommandVerb::PSubscribe:
+    for (const auto &pattern : args) {
+      if (subscriber.patterns.insert(pattern).second) {
+        patterns_.add(pattern, &subscriber);
+      }
+      reply(subscriber, subscription_reply("psubscribe", &pattern, count()));
+    }
+    break;
+  case CommandVerb::Unsubscribe:
+  case CommandVerb::PUnsubscribe: {
+    const bool is_pattern = command.verb == CommandVerb::PUnsubscribe;
+    const auto &subscribed =
+        is_pattern ? subscriber.patterns : subscriber.channels;
+    const auto kind = is_pattern ? "punsubscribe" : "unsubscribe";
+    // Without arguments, from everything (if anything).
+    const auto names = args.empty() ? std::vector<std::string>(
+                                          subscribed.begin(), subscribed.end())
+                                    : args;
+    if (names.empty()) {
+      reply(subscriber, subscription_reply(kind, nullptr, count()));
+    }
+    for (const auto &name : names) {
+      if (is_pattern) {
+        unsubscribe_pattern(subscriber, name);
+      } else {
+        unsubscribe_channel(subscriber, name);
+      }
+      reply(subscriber, subscription_reply(kind, &name, count()));
+    }
+    break;
+  }
+  case CommandVerb::Ping:
+    // RESP3 clients can tell replies and push data apart, so they get the
+    // usual reply.
+    if (subscriber.state.protocol == Protocol::Resp3) {
+      reply(subscriber, args.empty() ? Message{"PONG", DataType::SimpleString}
+                                     : bulk(args.front()));
+    } else {
+      reply(subscriber,
+            Message{Message::NestedVariantT{
+                        bulk("pong"), bulk(args.empty() ? "" : args.front())},
+                    DataType::Array});
+    }
+    break;
+  default:
+    reply(subscriber,
+          Message{"ERR Can't execute '" +
+                      (command.verb == CommandVerb::Unknown
+                           ? std::string("unknown")
+                           : command_to_string(command.verb)) +
+                      "': only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING are "
+                      "allowed in this context",
+                  DataType::SimpleError});
+    break;
+  }
+  subscriber.leaving = count() == 0;
+}
+
+void PubSub::unsubscribe_channel(Subscriber &subscriber,
+                                 const std::string &channel) {
+  if (subscriber.channels.erase(channel) == 0) {
+    return;
+  }
+  const auto entry = channels_.find(channel);
+  auto &subscribers = entry->second;
+  // The order of the subscribers doesn't matter.
+  *std::ranges::find(subscribers, &subscriber) = subscribers.back();
+  subscribers.pop_back();
+  if (subscribers.empty()) {
+    channels_.erase(entry);
+  }
+}
+
+void PubSub::unsubscribe_pattern(Subscriber &subscriber,
+                                 const std::string &pattern) {
+  if (subscriber.patterns.erase(pattern) != 0) {
+    patterns_.remove(pattern, &subscriber);
+  }
+}
+
+void PubSub::run(const std::stop_token &stop) {
+  constexpr int MAX_EVENTS = 64;
+  std::array<epoll_event, MAX_EVENTS> events{};
+  while (!stop.stop_requested()) {
+    const int num_events =
+        epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, -1);
+    std::vector<Id> to_flush{};
+    std::vector<Id> hung_up{};
+    for (int i = 0; i < num_events; ++i) {
+      const auto &event = events[static_cast<std::size_t>(i)];
+      const Id id = event.data.u64;
+      if (id == 0) {
+        std::uint64_t count = 0;
+        [[maybe_unused]] const auto bytes_read =
+            read(wake_fd_, &count, sizeof(count));
+        continue;
+      }
+      auto *subscriber = find(id);
+      if (!subscriber) {
+        continue;
+      }
+      // Attached clients' tasks read their commands.
+      if ((event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) !=
+              0 &&
+          !subscriber->attached && !subscriber->leaving &&
+          !read_commands(*subscriber)) {
+        hung_up.push_back(id);
+        continue;
+      }
+      to_flush.push_back(id);
+    }
+    {
+      std::scoped_lock lock(dirty_mutex_);
+      to_flush.insert(to_flush.end(), dirty_.begin(), dirty_.end());
+      dirty_.clear();
+    }
+    std::ranges::sort(to_flush);
+    const auto [first, last] = std::ranges::unique(to_flush);
+    to_flush.erase(first, last);
+    std::vector<Id> resumed{};
+    std::vector<Id> forgotten{};
+    for (const auto id : to_flush) {
+      auto *subscriber = find(id);
+      if (!subscriber) {
+        continue;
+      }
+      const auto result = flush(*subscriber);
+      if (result == FlushResult::Drop) {
+        hung_up.push_back(id);
+      } else if (result == FlushResult::Resume) {
+        resumed.push_back(id);
+      } else if (result == FlushResult::Forget) {
+        forgotten.push_back(id);
+      }
+    }
+    for (const auto id : forgotten) {
+      forget(id);
+    }
+    for (const auto id : hung_up) {
+      remove(id, false);
+    }
+    for (const auto id : resumed) {
+      remove(id, true);
+    }
+  }
+}
+
+PubSub::Subscriber *PubSub::find(const Id id) const {
+  std::shared_lock lock(mutex_);
+  const auto subscriber = subscribers_.find(id);
+  return subscriber == subscribers_.end() ? nullptr
+                                          : subscriber->second.get();
+}
+
+bool PubSub::read_commands(Subscriber &subscriber) {
+  constexpr std::size_t READ_SIZE = 16UL * 1024;
+  std::array<char, READ_SIZE> buffer{};
+  const auto received = recv(static_cast<int>(subscriber.fd), buffer.data(),
+                             buffer.size(), MSG_DONTWAIT);
+  if (received == 0 ||
+      (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+       errno != EINTR)) {
+    return false;
+  }
+  if (received < 0) {
+    return true;
+  }
+  subscriber.input.append(buffer.data(), static_cast<std::size_t>(received));
+  std::size_t pos = 0;
+  std::unique_lock lock(mutex_);
+  while (!subscriber.leaving) {
+    const auto message = parse_command_array(subscriber.input, pos);
+    if (!message) {
+      break;
+    }
+    handle(subscriber,
+           parse_and_validate_command(*message).value_or(Command{}));
+  }
+  subscriber.input.erase(0, pos);
+  return true;
+}
+
+PubSub::FlushResult PubSub::flush(Subscriber &subscriber) {
+  // An attached client's task writes out its queue itself once it's done
+  // with the socket.
+  std::unique_lock send_lock(subscriber.send_mutex, std::defer_lock);
+  if (subscriber.attached) {
+    if (!send_lock.try_lock()) {
+      return FlushResult::Waiting;
+    }
+  } else {
+    send_lock.lock();
+  }
+  if (subscriber.detached) {
+    return FlushResult::Forget;
+  }
+  const bool attached = subscriber.attached;
+  bool is_empty = false;
+  {
+    std::scoped_lock lock(subscriber.queue_mutex);
+    if (subscriber.overflowed) {
+      std::cerr << "Disconnecting client " << static_cast<int>(subscriber.fd)
+                << " for going over the output buffer limit" << std::endl;
+      if (attached) {
+        // Its task sees it hang up, and detaches and closes it.
+        shutdown(static_cast<int>(subscriber.fd), SHUT_RDWR);
+        return FlushResult::Waiting;
+      }
+      return FlushResult::Drop;
+    }
+    auto &queue = subscriber.queue;
+    while (!queue.empty()) {
+      std::array<iovec, MAX_IOVECS> iovecs{};
+      const auto num_iovecs = std::min(queue.size(), MAX_IOVECS);
+      for (std::size_t i = 0; i < num_iovecs; ++i) {
+        const auto skip = i == 0 ? subscriber.sent_of_front : 0;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        iovecs[i].iov_base = const_cast<char *>(queue[i]->data() + skip);
+        iovecs[i].iov_len = queue[i]->size() - skip;
+      }
+      msghdr header{};
+      header.msg_iov = iovecs.data();
+      header.msg_iovlen = num_iovecs;
+      const auto sent = sendmsg(static_cast<int>(subscriber.fd), &header,
+                                MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) {
+        continue;
+      }
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      if (sent < 0) {
+        // An attached client's task finds out about it on its own.
+        return attached ? FlushResult::Waiting : FlushResult::Drop;
+      }
+      subscriber.queued_bytes -= static_cast<std::size_t>(sent);
+      auto remaining = static_cast<std::size_t>(sent);
+      while (remaining > 0) {
+        const auto left_of_front =
+            queue.front()->size() - subscriber.sent_of_front;
+        if (remaining < left_of_front) {
+          subscriber.sent_of_front += remaining;
+          break;
+        }
+        remaining -= left_of_front;
+        subscriber.sent_of_front = 0;
+        queue.pop_front();
+      }
+    }
+    is_empty = queue.empty();
+  }
+  // Only wait for the socket to be writable while there is something left.
+  if (is_empty == subscriber.waiting_to_write) {
+    subscriber.waiting_to_write = !is_empty;
+    epoll_event event{};
+    event.events = (attached ? static_cast<std::uint32_t>(EPOLLET)
+                             : EPOLLIN | EPOLLRDHUP) |
+                   (is_empty ? 0U : EPOLLOUT);
+    event.data.u64 = subscriber.id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, static_cast<int>(subscriber.fd),
+              &event);
+  }
+  if (is_empty && subscriber.leaving) {
+    return FlushResult::Resume;
+  }
+  return FlushResult::Waiting;
+}
+
+void PubSub::remove(const Id id, const bool resume) {
+  std::unique_ptr<Subscriber> subscriber{};
+  {
+    std::unique_lock lock(mutex_);
+    auto node = subscribers_.extract(id);
+    if (node.empty()) {
+      return;
+    }
+    if (resume) {
+      std::scoped_lock queue_lock(node.mapped()->queue_mutex);
+      if (!node.mapped()->queue.empty()) {
+        subscribers_.insert(std::move(node));
+        mark_dirty({id});
+        return;
+      }
+    }
+    if (resume && node.mapped()->stays_attached) {
+      auto &attached = *node.mapped();
+      {
+        std::scoped_lock send_lock(attached.send_mutex);
+        attached.attached = true;
+        attached.stays_attached = false;
+        attached.leaving = false;
+        attached.waiting_to_write = false;
+        attached.input.clear();
+        epoll_event event{};
+        event.events = EPOLLET;
+        event.data.u64 = id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, static_cast<int>(attached.fd),
+                  &event);
+      }
+      const auto fd = attached.fd;
+      const auto state = attached.state;
+      subscribers_.insert(std::move(node));
+      lock.unlock();
+      resume_(fd, state);
+      return;
+    }
+    subscriber = std::move(node.mapped());
+    // The client may have been attached again since it was detached.
+    if (const auto found = by_client_.find(subscriber->state.id);
+        found != by_client_.end() && found->second == subscriber.get()) {
+      by_client_.erase(found);
+    }
+    for (const auto &channel :
+         std::vector(subscriber->channels.begin(),
+                     subscriber->channels.end())) {
+      unsubscribe_channel(*subscriber, channel);
+    }
+    for (const auto &pattern :
+         std::vector(subscriber->patterns.begin(),
+                     subscriber->patterns.end())) {
+      unsubscribe_pattern(*subscriber, pattern);
+    }
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, static_cast<int>(subscriber->fd),
+            nullptr);
+  if (resume) {
+    resume_(subscriber->fd, subscriber->state);
+  } else {
+    std::cout << "Closing connection with subscriber "
+              << static_cast<int>(subscriber->fd) << std::endl;
+    // Before its descriptor can be reused.
+    if (closed_) {
+      closed_(subscriber->state);
+    }
+    close(static_cast<int>(subscriber->fd));
+  }
+}
+
+void PubSub::forget(const Id id) {
+  std::unique_lock lock(mutex_);
+  subscribers_.erase(id);
+}
+
+void PubSub::wake() const {
+  const std::uint64_t one = 1;
+  [[maybe_unused]] const auto bytes_written =
+      write(wake_fd_, &one, sizeof(one));
+}
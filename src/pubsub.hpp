@@ -0,0 +1,185 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Our library's header includes.
+#include "network.hpp"
+#include "pattern_index.hpp"
+#include "protocol.hpp"
+#include "redis_core.hpp"
+
+// A message serialized once and shared by every subscriber it is sent to.
+using SharedMessage = std::shared_ptr<const std::string>;
+
+// Publish/subscribe. A client that subscribes hands its connection over until
+// it unsubscribes from everything. Like blocked clients, subscribers hold no
+// thread: a single sender thread watches all of their sockets, writes out
+// their queued messages, and serves the commands they send while subscribed
+// ((P)SUBSCRIBE, (P)UNSUBSCRIBE and PING).
+//
+// PUBLISH serializes the message once per channel (and once per matching
+// pattern), and only queues a pointer to it for each subscriber, so it costs
+// no copies or system calls per subscriber. The sender thread writes each
+// subscriber's queue out with one sendmsg() call straight from the shared
+// buffers, and never waits on slow subscribers. A subscriber whose queue grows
+// past the output buffer limit is disconnected, like in Redis.
+//
+// Clients that aren't subscribed may be attached too, so others can push
+// messages to them (e.g. key invalidations) the same way, without waiting on
+// their sockets. Their own tasks keep reading their commands, and send their
+// replies with send(), which writes out what was queued first. The sender
+// thread only writes to them while their tasks aren't.
+class PubSub {
+public:
+  // Called (from the sender thread) with the connection of a client that
+  // unsubscribed from everything, to serve its commands normally again.
+  using Resume = std::function<void(SocketFd, ClientState)>;
+  // Called (from the sender thread) with a client whose connection is
+  // about to be closed while it is subscribed.
+  using Closed = std::function<void(const ClientState &)>;
+
+  // An output_buffer_limit of 0 means no limit.
+  PubSub(Resume resume, std::size_t output_buffer_limit, Closed closed = {});
+  PubSub(const PubSub &other) = delete;
+  PubSub &operator=(const PubSub &other) = delete;
+  PubSub(PubSub &&other) = delete;
+  PubSub &operator=(PubSub &&other) = delete;
+  // Closes the connections of the clients still subscribed.
+  ~PubSub();
+
+  // Takes over the connection of the client, which sent SUBSCRIBE or
+  // PSUBSCRIBE, and queues the replies to it. An attached client stays
+  // attached once it unsubscribes from everything.
+  void subscribe(SocketFd fd, const ClientState &state,
+                 const Command &command);
+  // Lets push() queue messages for the client (by its ClientState::id),
+  // whose task keeps its connection, until detach().
+  void attach(SocketFd fd, const ClientState &state);
+  // Stops pushing to the attached client. Its socket may be closed after.
+  void detach(std::uint64_t client_id);
+  // Updates the protocol of the attached client, which it is pushed to in.
+  void set_protocol(std::uint64_t client_id, Protocol protocol);
+  // Sends the reply to the client, blocking, after whatever was queued for it
+  // if it is attached.
+  void send(std::uint64_t client_id, SocketFd fd, std::string_view reply);
+  // Queues the message for every subscriber of the channel, and of every
+  // pattern it matches. Returns how many got it.
+  std::size_t publish(const std::string &channel, const std::string &message);
+  // Queues the message for the client (by its ClientState::id) if it is
+  // subscribed. Returns whether it was.
+  bool push(std::uint64_t client_id, const Message &message);
+  // Queues the message for the client if it is subscribed or attached, and
+  // speaks RESP3 (so it can tell pushes from replies). Returns whether it
+  // did.
+  bool push_resp3(std::uint64_t client_id, const Message &message);
+  // Replies to PUBSUB CHANNELS, NUMSUB and NUMPAT.
+  [[nodiscard]] Message introspect(const Command &command) const;
+  // The number of subscribed clients (not counting attached ones).
+  [[nodiscard]] std::size_t num_subscribers() const;
+
+private:
+  using Id = std::uint64_t;
+  struct Subscriber {
+    Subscriber(Id id_in, SocketFd fd_in, const ClientState &state_in)
+        : id(id_in), fd(fd_in), state(state_in) {}
+
+    Id id;
+    SocketFd fd;
+    ClientState state;
+    // Guarded by mutex_.
+    std::set<std::string> channels;
+    std::set<std::string> patterns;
+    // Set once it has unsubscribed from everything. It is handed back once
+    // its queue is empty.
+    bool leaving = false;
+    // Set while it is attached rather than subscribed, and its task sends to
+    // it holding send_mutex, which the sender thread only tries to take.
+    // Changed holding both mutex_ and send_mutex.
+    std::atomic<bool> attached = false;
+    // Whether it goes back to being attached when it leaves.
+    bool stays_attached = false;
+    // Set (holding send_mutex) once the attached client is detached, after
+    // which its socket isn't touched, and the sender thread forgets it.
+    bool detached = false;
+    std::mutex send_mutex;
+    // Only used by the sender thread: what the client sent that wasn't a
+    // whole command yet, and whether we wait for its socket to be writable.
+    std::string input;
+    bool waiting_to_write = false;
+    // Guarded by queue_mutex. sent_of_front is how much of the first
+    // message has already been sent.
+    std::mutex queue_mutex;
+    std::deque<SharedMessage> queue;
+    std::size_t sent_of_front = 0;
+    std::size_t queued_bytes = 0;
+    bool overflowed = false;
+  };
+  // What to do with a subscriber after writing out its queue.
+  enum class FlushResult : std::uint8_t { Waiting, Drop, Resume, Forget };
+
+  Resume resume_;
+  std::size_t output_buffer_limit_;
+  Closed closed_;
+
+  // Guards the subscriptions. Publishers share it, so they only contend on
+  // the queues of the subscribers they have in common. Only the sender thread
+  // removes subscribers, so it may use them without holding this.
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<Id, std::unique_ptr<Subscriber>> subscribers_;
+  std::unordered_map<std::string, std::vector<Subscriber *>> channels_;
+  PatternIndex<Subscriber *> patterns_;
+  // The subscribers by the ID of their client.
+  std::unordered_map<std::uint64_t, Subscriber *> by_client_;
+  Id next_id_ = 1;
+
+  // The subscribers whose queues went from empty to not, for the sender
+  // thread to write out.
+  std::mutex dirty_mutex_;
+  std::vector<Id> dirty_;
+
+  int epoll_fd_ = -1;
+  // An eventfd that wakes up the sender thread, registered with ID 0.
+  int wake_fd_ = -1;
+  // Declared last, so it stops before anything it uses is destroyed.
+  std::jthread sender_;
+
+  // Adds the message to the queue. Returns whether the subscriber now needs
+  // writing out (and wasn't already waiting to be).
+  bool enqueue(Subscriber &subscriber, SharedMessage message) const;
+  // Queues the reply for the subscriber and has it written out. Called
+  // holding mutex_.
+  void reply(Subscriber &subscriber, const Message &message);
+  void mark_dirty(const std::vector<Id> &ids);
+  // Applies a command the subscriber sent. Called holding mutex_ exclusively.
+  void handle(Subscriber &subscriber, const Command &command);
+  void unsubscribe_channel(Subscriber &subscriber, const std::string &channel);
+  void unsubscribe_pattern(Subscriber &subscriber, const std::string &pattern);
+
+  // What the sender thread runs.
+  void run(const std::stop_token &stop);
+  Subscriber *find(Id id) const;
+  // Reads and applies what the subscriber sent. Returns false if it hung up.
+  bool read_commands(Subscriber &subscriber);
+  FlushResult flush(Subscriber &subscriber);
+  // Forgets the subscriber, and closes its connection unless it is resumed.
+  // It isn't resumed if something was queued for it since it was flushed, and
+  // goes back to being attached instead if it was before.
+  void remove(Id id, bool resume);
+  // Frees the detached client, whose socket isn't ours.
+  void forget(Id id);
+  void wake() const;
+};
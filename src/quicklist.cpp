@@ -0,0 +1,105 @@
+// This source file's own header include.
+#include "quicklist.hpp"
+
+// System includes.
+#include <utility>
+
+namespace {
+
+// Nodes capped by element count still never grow past this many bytes.
+constexpr std::size_t SIZE_SAFETY_LIMIT = 8UL * 1024;
+// The node size for a fill of -1, doubling with each step down to -5.
+constexpr std::size_t MIN_NODE_BYTES = 4UL * 1024;
+constexpr std::int64_t MIN_FILL = -5;
+
+} // namespace
+
+Quicklist::Quicklist(std::int64_t fill)
+    : fill_(std::max(fill, MIN_FILL)) {}
+
+void Quicklist::push_front(std::string_view element) {
+  if (nodes_.empty() || !fits(nodes_.front(), element.size())) {
+    nodes_.emplace_front();
+  }
+  nodes_.front().push_front(element);
+  ++size_;
+}
+
+void Quicklist::push_back(std::string_view element) {
+  if (nodes_.empty() || !fits(nodes_.back(), element.size())) {
+    nodes_.emplace_back();
+  }
+  nodes_.back().push_back(element);
+  ++size_;
+}
+
+std::optional<std::string> Quicklist::pop_front() {
+  if (nodes_.empty()) {
+    return std::nullopt;
+  }
+  auto element = nodes_.front().pop_front();
+  if (nodes_.front().empty()) {
+    nodes_.pop_front();
+  }
+  --size_;
+  return element;
+}
+
+std::optional<std::string> Quicklist::pop_back() {
+  if (nodes_.empty()) {
+    return std::nullopt;
+  }
+  auto element = nodes_.back().pop_back();
+  if (nodes_.back().empty()) {
+    nodes_.pop_back();
+  }
+  --size_;
+  return element;
+}
+
+void Quicklist::trim(std::size_t first, std::size_t count) {
+  first = std::min(first, size_);
+  count = std::min(count, size_ - first);
+  // Whole nodes outside the range are dropped without touching their
+  // elements, and only the nodes at the edges get cut.
+  for (auto num_to_drop = first; num_to_drop > 0;) {
+    auto &node = nodes_.front();
+    const auto num_in_node = node.size();
+    if (num_in_node <= num_to_drop) {
+      nodes_.pop_front();
+      num_to_drop -= num_in_node;
+    } else {
+      node.erase(0, num_to_drop);
+      num_to_drop = 0;
+    }
+  }
+  for (auto num_to_drop = size_ - first - count; num_to_drop > 0;) {
+    auto &node = nodes_.back();
+    const auto num_in_node = node.size();
+    if (num_in_node <= num_to_drop) {
+      nodes_.pop_back();
+      num_to_drop -= num_in_node;
+    } else {
+      node.erase(num_in_node - num_to_drop, num_to_drop);
+      num_to_drop = 0;
+    }
+  }
+  size_ = count;
+}
+
+void Quicklist::push_back_node(Listpack node) {
+  if (node.empty()) {
+    return;
+  }
+  size_ += node.size();
+  nodes_.push_back(std::move(node));
+}
+
+bool Quicklist::fits(const Listpack &node, std::size_t element_size) const {
+  const auto new_bytes = node.bytes().size() + element_size;
+  if (fill_ >= 0) {
+    return node.size() < static_cast<std::size_t>(fill_) &&
+           new_bytes <= SIZE_SAFETY_LIMIT;
+  }
+  return new_bytes <= MIN_NODE_BYTES << static_cast<std::size_t>(-fill_ - 1);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// System includes.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Our library's header includes.
+#include "listpack.hpp"
+
+// A quicklist is a doubly linked list of listpack nodes, which is how Redis
+// stores lists. Pushing and popping at either end only touches the first or
+// last node, and reading a range walks a few contiguous listpacks instead of
+// chasing a pointer per element. See
+// https://github.com/redis/redis/blob/unstable/src/quicklist.c
+class Quicklist {
+public:
+  // Like Redis's "list-max-listpack-size": a positive fill caps the number of
+  // elements per node, while -1 to -5 cap the node size at 4, 8, 16, 32 or
+  // 64 KiB.
+  static constexpr std::int64_t DEFAULT_FILL = -2;
+
+  explicit Quicklist(std::int64_t fill = DEFAULT_FILL);
+
+  void push_front(std::string_view element);
+  void push_back(std::string_view element);
+  // Remove and return the first or last element, or nullopt if empty.
+  std::optional<std::string> pop_front();
+  std::optional<std::string> pop_back();
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  // Keeps only the count elements starting at index first.
+  void trim(std::size_t first, std::size_t count);
+
+  // Calls func(element) on count elements starting at index first (or as many
+  // as there are). Whole nodes before the range are skipped without walking
+  // their elements.
+  template <typename Func>
+  void for_each(std::size_t first, std::size_t count, Func &&func) const {
+    auto node = nodes_.cbegin();
+    for (; node != nodes_.cend() && first >= node->size(); ++node) {
+      first -= node->size();
+    }
+    for (; node != nodes_.cend() && count > 0; ++node) {
+      const auto num_in_node = std::min(count, node->size() - first);
+      node->for_each(first, num_in_node, func);
+      count -= num_in_node;
+      first = 0;
+    }
+  }
+  template <typename Func> void for_each(Func &&func) const {
+    for_each(0, size_, func);
+  }
+
+  // The nodes themselves, which is how lists are saved in RDB files.
+  [[nodiscard]] const std::list<Listpack> &nodes() const { return nodes_; }
+  // Appends a whole node as is (e.g. when loading), skipping empty ones.
+  void push_back_node(Listpack node);
+
+  bool operator==(const Quicklist &other) const = default;
+
+private:
+  // Whether an element of about the given size still fits into the node.
+  [[nodiscard]] bool fits(const Listpack &node,
+                          std::size_t element_size) const;
+
+  std::int64_t fill_;
+  std::list<Listpack> nodes_;
+  // The total number of elements, so LLEN doesn't have to count them.
+  std::size_t size_ = 0;
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+// System includes.
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A radix tree (compressed trie) mapping byte strings to values, in the
+// spirit of Redis's rax. Each edge is labelled with every byte the keys below
+// it share, so keys with long common prefixes (like the big-endian IDs of
+// stream entries) share most of their path, and a lookup takes one hop per
+// branching point instead of one per byte. Keys are visited in byte order.
+template <typename T> class RadixTree {
+public:
+  // A key and its value. The pointer is only valid until the tree changes.
+  using Entry = std::pair<std::string, const T *>;
+
+  RadixTree() = default;
+  RadixTree(const RadixTree &other)
+      : root_(clone(other.root_)), size_(other.size_) {}
+  RadixTree &operator=(const RadixTree &other) {
+    if (this != &other) {
+      RadixTree copy(other);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+  RadixTree(RadixTree &&other) noexcept
+      : root_(std::exchange(other.root_, Node{})),
+        size_(std::exchange(other.size_, 0)) {}
+  RadixTree &operator=(RadixTree &&other) noexcept {
+    root_ = std::exchange(other.root_, Node{});
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+  ~RadixTree() = default;
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  // Adds the key, or replaces its value. Returns true if it is new.
+  bool insert(std::string_view key, T value) {
+    Node *node = &root_;
+    while (!key.empty()) {
+      const auto child = lower_bound(*node, key.front());
+      if (child == node->children.end() ||
+          (*child)->label.front() != key.front()) {
+        auto leaf = std::make_unique<Node>();
+        leaf->label = key;
+        leaf->value = std::move(value);
+        node->children.insert(child, std::move(leaf));
+        ++size_;
+        return true;
+      }
+      const auto common = common_prefix((*child)->label, key);
+      if (common < (*child)->label.size()) {
+        // Split the edge at the first byte the keys disagree on.
+        auto split = std::make_unique<Node>();
+        split->label = (*child)->label.substr(0, common);
+        (*child)->label.erase(0, common);
+        split->children.push_back(std::move(*child));
+        *child = std::move(split);
+      }
+      node = child->get();
+      key.remove_prefix(common);
+    }
+    const bool added = !node->value.has_value();
+    node->value = std::move(value);
+    size_ += added ? 1 : 0;
+    return added;
+  }
+
+  // Returns false if the key isn't there.
+  bool erase(std::string_view key) {
+    // Each node on the way down, with its parent.
+    std::vector<std::pair<Node *, std::size_t>> path{};
+    Node *node = &root_;
+    while (!key.empty()) {
+      const auto child = lower_bound(*node, key.front());
+      if (child == node->children.end() || !key.starts_with((*child)->label)) {
+        return false;
+      }
+      path.emplace_back(node, child - node->children.begin());
+      key.remove_prefix((*child)->label.size());
+      node = child->get();
+    }
+    if (!node->value) {
+      return false;
+    }
+    node->value.reset();
+    --size_;
+    // Removing the value may leave the node, and then its parent, with
+    // nothing to branch on.
+    for (std::size_t i = path.size(); i > 0 && path.size() - i < 2; --i) {
+      compact(*path[i - 1].first, path[i - 1].second);
+    }
+    return true;
+  }
+
+  [[nodiscard]] const T *find(std::string_view key) const {
+    const Node *node = &root_;
+    while (!key.empty()) {
+      const auto child = lower_bound(*node, key.front());
+      if (child == node->children.end() || !key.starts_with((*child)->label)) {
+        return nullptr;
+      }
+      key.remove_prefix((*child)->label.size());
+      node = child->get();
+    }
+    return node->value ? &*node->value : nullptr;
+  }
+
+  T *find(std::string_view key) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    return const_cast<T *>(std::as_const(*this).find(key));
+  }
+
+  // The entry with the smallest key at least as big as the given one.
+  [[nodiscard]] std::optional<Entry> seek_ge(std::string_view key) const {
+    std::string path{};
+    return seek_ge(root_, path, key);
+  }
+
+  // The entry with the biggest key at most as big as the given one.
+  [[nodiscard]] std::optional<Entry> seek_le(std::string_view key) const {
+    std::string path{};
+    return seek_le(root_, path, key);
+  }
+
+  [[nodiscard]] std::optional<Entry> first() const { return seek_ge(""); }
+
+  [[nodiscard]] std::optional<Entry> last() const {
+    std::string path{};
+    return last_in(root_, path);
+  }
+
+private:
+  struct Node {
+    // The bytes on the edge leading here from the parent.
+    std::string label;
+    std::optional<T> value;
+    // Sorted by the first byte of their labels, which are all different.
+    std::vector<std::unique_ptr<Node>> children;
+  };
+
+  static Node clone(const Node &node) {
+    Node copy{node.label, node.value, {}};
+    copy.children.reserve(node.children.size());
+    for (const auto &child : node.children) {
+      copy.children.push_back(std::make_unique<Node>(clone(*child)));
+    }
+    return copy;
+  }
+
+  static auto lower_bound(const Node &node, char first_byte) {
+    return std::ranges::lower_bound(
+        node.children, static_cast<unsigned char>(first_byte), {},
+        [](const auto &child) {
+          return static_cast<unsigned char>(child->label.front());
+        });
+  }
+
+  static auto lower_bound(Node &node, char first_byte) {
+    return std::ranges::lower_bound(
+        node.children, static_cast<unsigned char>(first_byte), {},
+        [](const auto &child) {
+          return static_cast<unsigned char>(child->label.front());
+        });
+  }
+
+  static std::size_t common_prefix(std::string_view first,
+                                   std::string_view second) {
+    return static_cast<std::size_t>(
+        std::ranges::mismatch(first, second).in1 - first.begin());
+  }
+
+  static bool is_less(char first, char second) {
+    return static_cast<unsigned char>(first) <
+           static_cast<unsigned char>(second);
+  }
+
+  // Removes the child if it holds nothing, or merges it into its only child.
+  static void compact(Node &parent, std::size_t index) {
+    auto &child = parent.children[index];
+    if (child->value) {
+      return;
+    }
+    if (child->children.empty()) {
+      parent.children.erase(parent.children.begin() +
+                            static_cast<std::ptrdiff_t>(index));
+    } else if (child->children.size() == 1) {
+      auto grandchild = std::move(child->children.front());
+      grandchild->label.insert(0, child->label);
+      child = std::move(grandchild);
+    }
+  }
+
+  // The smallest and biggest entries under the node, whose key is path.
+  static std::optional<Entry> first_in(const Node &node, std::string &path) {
+    if (node.value) {
+      return Entry{path, &*node.value};
+    }
+    if (node.children.empty()) {
+      return std::nullopt;
+    }
+    path += node.children.front()->label;
+    return first_in(*node.children.front(), path);
+  }
+
+  static std::optional<Entry> last_in(const Node &node, std::string &path) {
+    if (!node.children.empty()) {
+      path += node.children.back()->label;
+      return last_in(*node.children.back(), path);
+    }
+    if (node.value) {
+      return Entry{path, &*node.value};
+    }
+    return std::nullopt;
+  }
+
+  // Where rest is what is left of the key after path.
+  static std::optional<Entry> seek_ge(const Node &node, std::string &path,
+                                      std::string_view rest) {
+    if (rest.empty()) {
+      return first_in(node, path);
+    }
+    for (auto child = lower_bound(node, rest.front());
+         child != node.children.end(); ++child) {
+      const auto &label = (*child)->label;
+      const auto common = common_prefix(label, rest);
+      const auto path_size = path.size();
+      path += label;
+      std::optional<Entry> found{};
+      if (common == label.size()) {
+        found = seek_ge(**child, path, rest.substr(common));
+      } else if (common == rest.size() ||
+                 is_less(rest[common], label[common])) {
+        // Every key under the child is bigger.
+        found = first_in(**child, path);
+      }
+      if (found) {
+        return found;
+      }
+      path.resize(path_size);
+    }
+    return std::nullopt;
+  }
+
+  static std::optional<Entry> seek_le(const Node &node, std::string &path,
+                                      std::string_view rest) {
+    if (!rest.empty()) {
+      auto child = lower_bound(node, rest.front());
+      if (child != node.children.end() &&
+          (*child)->label.front() == rest.front()) {
+        ++child;
+      }
+      while (child != node.children.begin()) {
+        --child;
+        const auto &label = (*child)->label;
+        const auto common = common_prefix(label, rest);
+        const auto path_size = path.size();
+        path += label;
+        std::optional<Entry> found{};
+        if (common == label.size()) {
+          found = seek_le(**child, path, rest.substr(common));
+        } else if (common < rest.size() &&
+                   is_less(label[common], rest[common])) {
+          // Every key under the child is smaller.
+          found = last_in(**child, path);
+        }
+        if (found) {
+          return found;
+        }
+        path.resize(path_size);
+      }
+    }
+    // The node's own key is a prefix of (or equal to) the one we seek.
+    if (node.value) {
+      return Entry{path, &*node.value};
+    }
+    return std::nullopt;
+  }
+
+  Node root_;
+  std::size_t size_ = 0;
+};
@@ -4,14 +4,23 @@
 // System includes.
 #include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <variant>
 
 // Our library's header includes.
 #include "cache.hpp"
+#include "command_table.hpp"
 #include "config.hpp"
+#include "dump_commands.hpp"
+#include "lazy_free.hpp"
+#include "list_commands.hpp"
 #include "protocol.hpp"
+#include "stream_commands.hpp"
+#include "time.hpp"
 
 namespace {
+constexpr auto DB_INDEX_OUT_OF_RANGE_ERROR = "ERR DB index is out of range";
+
 // NOTE: we return a reference to one of the strings inside the given message
 // arguments. This is fine as long as the caller doesn't hold on to these
 // references longer than they do the Message they passed in as an argument.
@@ -40,112 +49,32 @@ bool is_array(const Message &message) {
   return std::holds_alternative<Message::NestedVariantT>(message.get_data());
 }
 
-Command parse_ping_command(const Message &message) {
-  // PING can be either a simple string on its own or an Array if an argument
-  // is provided.
-  const auto &arg = std::get<Message::NestedVariantT>(message.get_data())[1];
-  assert(arg.get_data_type() != DataType::Array &&
-         "Nested Array messages are not allowed!");
-  return Command{CommandVerb::Ping,
-                 {std::get<Message::StringVariantT>(arg.get_data())}};
-  return Command{CommandVerb::Ping, {}};
-}
-
-Command parse_echo_command(const Message &message) {
-  // ECHO requires exactly one argument and therefore must be an Array
-  // message.
-  const auto &arg = std::get<Message::NestedVariantT>(message.get_data())[1];
-  assert(arg.get_data_type() != DataType::Array &&
-         "Nested Array messages are not allowed!");
-  return Command{CommandVerb::Echo,
-                 {std::get<Message::StringVariantT>(arg.get_data())}};
-}
-Command parse_get_command(const Message &message) {
-  // GET requires exactly one argument and therefore must be an Array message.
-  const auto &arg = std::get<Message::NestedVariantT>(message.get_data())[1];
-  assert(arg.get_data_type() != DataType::Array &&
-         "Nested Array messages are not allowed!");
-  return Command{CommandVerb::Get,
-                 {std::get<Message::StringVariantT>(arg.get_data())}};
-}
-
-Command parse_set_command(const Message &message) {
-  // SET must have at least two arguments (the key and value to set).
-  // The first element is the command, so three elements means we have two
-  // arguments to the command.
-  const auto &messages = std::get<Message::NestedVariantT>(message.get_data());
-  for ([[maybe_unused]] const auto &msg : messages) {
-    assert(msg.get_data_type() != DataType::Array &&
-           "Nested Array messages are not allowed!");
-  }
-  std::vector<std::string> args{};
-  // Copy the messages (skipping the first) as strings and make them the
-  // command arguments.
-  std::transform(messages.cbegin() + 1, messages.cend(),
-                 std::back_inserter(args), [](const auto &msg) {
-                   return std::get<Message::StringVariantT>(msg.get_data());
-                 });
-  return Command{CommandVerb::Set, std::move(args)};
-}
-
-std::optional<Command> parse_config_command_maybe(const Message &message) {
-  // TODO this doesn't handle CONFIG GET with a single arg, it should.
-  // CONFIG GET must provide at least one argument.
-  // The first two elements make up the command, so three elements means we
-  // have one argument to the command.
-  const auto &messages = std::get<Message::NestedVariantT>(message.get_data());
-  for ([[maybe_unused]] const auto &msg : messages) {
-    assert(msg.get_data_type() != DataType::Array &&
-           "Nested Array messages are not allowed!");
-  }
-  if (tolower(std::get<Message::StringVariantT>(messages[1].get_data())) ==
-      "get") {
-    std::vector<std::string> args{};
-    // Copy the messages (skipping the first two) as strings and make them
-    // the command arguments.
-    std::transform(messages.cbegin() + 2, messages.cend(),
-                   std::back_inserter(args), [](const auto &msg) {
-                     return std::get<Message::StringVariantT>(msg.get_data());
-                   });
-    return Command{CommandVerb::ConfigGet, std::move(args)};
-  }
-  return std::nullopt;
-}
-
-Command parse_keys_command([[maybe_unused]] const Message &message) {
-  // TODO actually parse the KEYS arguments (assume "*" for now).
-  return Command{CommandVerb::Keys, {}};
-}
-
 std::optional<Command> parse_array_command(const Message &message) {
-  const auto first_elem = tolower(get_first_elem(message));
-  // Two args in the message means the command has one argument.
-  const bool is_array_and_has_two_elements =
-      is_array(message) &&
-      std::get<Message::NestedVariantT>(message.get_data()).size() == 2;
-  const bool is_array_and_has_at_least_three_elements =
-      is_array(message) &&
-      std::get<Message::NestedVariantT>(message.get_data()).size() >= 3;
-  if (first_elem == "ping" && is_array_and_has_two_elements) {
-    return parse_ping_command(message);
+  const auto &elements = std::get<Message::NestedVariantT>(message.get_data());
+  if (elements.empty()) {
+    return std::nullopt;
   }
-  if (first_elem == "echo" && is_array_and_has_two_elements) {
-    return parse_echo_command(message);
+  const auto *spec = find_command(get_first_elem(message));
+  if (!spec || !spec->accepts(elements.size())) {
+    return std::nullopt;
   }
-  if (first_elem == "get" && is_array_and_has_two_elements) {
-    return parse_get_command(message);
-  }
-  if (first_elem == "set" && is_array_and_has_at_least_three_elements) {
-    return parse_set_command(message);
-  }
-  if (first_elem == "config" && is_array_and_has_at_least_three_elements) {
-    return parse_config_command_maybe(message);
-  }
-  if (first_elem == "keys") {
-    return parse_keys_command(message);
+  // Every element after the name (and subcommand) is an argument.
+  std::size_t num_words = 1;
+  if (!spec->subcommand.empty()) {
+    if (tolower(std::get<Message::StringVariantT>(elements[1].get_data())) !=
+        spec->subcommand) {
+      return std::nullopt;
+    }
+    num_words = 2;
   }
-
-  return std::nullopt;
+  std::vector<std::string> args{};
+  args.reserve(elements.size() - num_words);
+  std::transform(elements.cbegin() + static_cast<std::ptrdiff_t>(num_words),
+                 elements.cend(), std::back_inserter(args),
+                 [](const auto &element) {
+                   return std::get<Message::StringVariantT>(element.get_data());
+                 });
+  return Command{spec->verb, std::move(args)};
 }
 
 } // anonymous namespace
@@ -158,17 +87,59 @@ std::optional<Command> parse_and_validate_command(const Message &message) {
   // Currently we don't handle any commands that are not Array Messages.
   return std::nullopt;
 }
-std::string message_to_string(const Message &message) {
+
+Message command_error(const Message &message) {
+  const auto error = [](std::string text) {
+    return Message{std::move(text), DataType::SimpleError};
+  };
+  if (!is_array(message) ||
+      std::get<Message::NestedVariantT>(message.get_data()).empty()) {
+    return error("ERR unknown command ''");
+  }
+  const auto &elements = std::get<Message::NestedVariantT>(message.get_data());
+  const auto &name = get_first_elem(message);
+  const auto *spec = find_command(name);
+  if (!spec) {
+    return error("ERR unknown command '" + name + "'");
+  }
+  if (!spec->subcommand.empty() && elements.size() > 1) {
+    const auto &subcommand =
+        std::get<Message::StringVariantT>(elements[1].get_data());
+    if (tolower(subcommand) != spec->subcommand) {
+      return error("ERR unknown subcommand '" + subcommand + "'");
+    }
+  }
+  const auto full_name =
+      spec->subcommand.empty()
+          ? std::string(spec->name)
+          : std::string(spec->name) + "|" + std::string(spec->subcommand);
+  return error("ERR wrong number of arguments for '" + full_name +
+               "' command");
+}
+std::string message_to_string(const Message &message,
+                              const Protocol protocol) {
+  const bool resp3 = protocol == Protocol::Resp3;
   std::stringstream sstr{};
   std::visit(
       MessageDataVisitor{
-          [&sstr](const Message::NestedVariantT &message_data) {
-            sstr << "*" << message_data.size() << TERMINATOR;
+          [&sstr, protocol, resp3, data_type = message.get_data_type()](
+              const Message::NestedVariantT &message_data) {
+            auto size = message_data.size();
+            char prefix = '*';
+            if (resp3 && data_type == DataType::Map) {
+              prefix = '%';
+              size /= 2;
+            } else if (resp3 && data_type == DataType::Set) {
+              prefix = '~';
+            } else if (resp3 && data_type == DataType::Push) {
+              prefix = '>';
+            }
+            sstr << prefix << size << TERMINATOR;
             for (const auto &elem : message_data) {
-              sstr << message_to_string(elem);
+              sstr << message_to_string(elem, protocol);
             }
           },
-          [&sstr, data_type = message.get_data_type()](
+          [&sstr, resp3, data_type = message.get_data_type()](
               const Message::StringVariantT &message_data) {
             switch (data_type) {
             case DataType::SimpleString:
@@ -179,15 +150,35 @@ std::string message_to_string(const Message &message) {
                    << TERMINATOR;
               break;
             case DataType::NullBulkString:
-              sstr << "$-1" << TERMINATOR;
+            case DataType::Null:
+              sstr << (resp3 ? "_" : "$-1") << TERMINATOR;
+              break;
+            case DataType::NullArray:
+              sstr << (resp3 ? "_" : "*-1") << TERMINATOR;
               break;
-            case DataType::Unknown:
             case DataType::SimpleError:
+              sstr << "-" << message_data << TERMINATOR;
+              break;
             case DataType::Integer:
-            case DataType::Array:
-            case DataType::Null:
+              sstr << ":" << message_data << TERMINATOR;
+              break;
             case DataType::Boolean:
+              if (resp3) {
+                sstr << "#" << (message_data == "1" ? "t" : "f") << TERMINATOR;
+              } else {
+                sstr << ":" << message_data << TERMINATOR;
+              }
+              break;
             case DataType::Double:
+              if (resp3) {
+                sstr << "," << message_data << TERMINATOR;
+              } else {
+                sstr << "$" << message_data.size() << TERMINATOR
+                     << message_data << TERMINATOR;
+              }
+              break;
+            case DataType::Unknown:
+            case DataType::Array:
             case DataType::BigNumber:
             case DataType::BulkError:
             case DataType::VerbatimString:
@@ -208,110 +199,207 @@ std::string message_to_string(const Message &message) {
 
 Message generate_response_message(const Command &command, const Config &config,
                                   Cache &cache) {
-  if (command.verb == CommandVerb::Ping) {
-    // If PING had an argument, reply with just that argument like ECHO would.
-    if (command.arguments.size() == 1) {
-      const auto data_type = DataType::BulkString;
-      return Message{command.arguments.front(), data_type};
-    }
-    // Otherwise, reply with the simple string "PONG".
-    return Message{"PONG", DataType::SimpleString};
+  if (auto reply = handle_command(command, config, cache)) {
+    return std::move(*reply);
   }
-  if (command.verb == CommandVerb::Echo) {
-    return Message{command.arguments.front(), DataType::BulkString};
+  // Only the server can run the commands without a handler.
+  return Message{"ERR unknown command '" + command_to_string(command.verb) +
+                     "'",
+                 DataType::SimpleError};
+}
+
+std::string command_to_string(CommandVerb command) {
+  const auto *spec = command_spec(command);
+  if (!spec) {
+    std::cerr << "Unknown CommandVerb enum encountered: "
+              << static_cast<int>(command) << std::endl;
+    std::terminate();
   }
-  if (command.verb == CommandVerb::Get) {
-    // TODO we don't currently handle "*" globs or multiple keys.
-    // TODO we assume GET always comes with one and only one argument.
-    const auto &key = command.arguments.front();
-    const auto value = cache.get(key);
-    if (value) {
-      return Message{*value, DataType::BulkString};
-    }
-    return Message{"", DataType::NullBulkString};
+  if (spec->subcommand.empty()) {
+    return std::string(spec->name);
+  }
+  return std::string(spec->name) + " " + std::string(spec->subcommand);
+}
+
+std::optional<Message> handle_command(const Command &command,
+                                      const Config &config, Cache &cache,
+                                      const LazyFree *lazy_free) {
+  const auto *spec = command_spec(command.verb);
+  if (!spec || !spec->handler) {
+    return std::nullopt;
   }
-  if (command.verb == CommandVerb::ConfigGet) {
-    // TODO we don't currently handle "*" globs or multiple keys.
-    const auto &key = command.arguments.front();
-    std::optional<std::string> value{};
-    if (tolower(key) == "dir") {
-      value = config.dir;
-    } else if (tolower(key) == "dbfilename") {
-      value = config.dbfilename;
+  return spec->handler(command, config, cache, lazy_free);
+}
+
+std::optional<Message> handle_database_command(const Command &command,
+                                               std::span<Cache> databases,
+                                               ClientState &client,
+                                               LazyFree *lazy_free) {
+  // Returns the error to reply with if the argument isn't a valid index.
+  const auto parse_db_index =
+      [&databases](const std::string &arg,
+                   std::size_t &index) -> std::optional<Message> {
+    const auto parsed = parse_canonical_int(arg);
+    if (!parsed) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
     }
+    if (*parsed < 0 ||
+        static_cast<std::uint64_t>(*parsed) >= databases.size()) {
+      return Message{DB_INDEX_OUT_OF_RANGE_ERROR, DataType::SimpleError};
+    }
+    index = static_cast<std::size_t>(*parsed);
+    return std::nullopt;
+  };
+  const Message ok{"OK", DataType::SimpleString};
 
-    // Reply with array listing the key and value if found.
-    if (value.has_value()) {
-      return Message(
-          Message::NestedVariantT{Message(key, DataType::BulkString),
-                                  Message(*value, DataType::BulkString)},
-          DataType::Array);
+  if (command.verb == CommandVerb::Select) {
+    std::size_t index = 0;
+    if (auto error = parse_db_index(command.arguments.front(), index)) {
+      return error;
     }
-    // Otherwise, respond with empty array.
-    return Message{Message::NestedVariantT{}, DataType::Array};
+    client.db_index = index;
+    return ok;
   }
-  if (command.verb == CommandVerb::Set) {
-    // Send back OK.
-    return Message{"OK", DataType::SimpleString};
+  if (command.verb == CommandVerb::SwapDb) {
+    std::size_t first = 0;
+    std::size_t second = 0;
+    if (auto error = parse_db_index(command.arguments[0], first)) {
+      return error;
+    }
+    if (auto error = parse_db_index(command.arguments[1], second)) {
+      return error;
+    }
+    // Clients that selected either database see the other one's keys from
+    // now on, like in Redis.
+    databases[first].swap(databases[second]);
+    return ok;
   }
-  if (command.verb == CommandVerb::Keys) {
-    // TODO actually parse the KEYS arguments (assume "*" for now).
-    // Get all the keys from the cache, and make BulkString messages out of each
-    // one.
-    std::vector<std::string> keys = cache.keys();
-    std::vector<Message> key_messages{};
-    key_messages.reserve(keys.size());
-    std::transform(
-        keys.cbegin(), keys.cend(), std::back_inserter(key_messages),
-        [](const auto &key) { return Message{key, DataType::BulkString}; });
-    // Send them back as an array of these BulkString messages.
-    return Message{key_messages, DataType::Array};
+  if (command.verb == CommandVerb::FlushDb ||
+      command.verb == CommandVerb::FlushAll) {
+    bool async = lazy_free && lazy_free->policy().lazy_user_flush;
+    if (!command.arguments.empty()) {
+      const auto mode = tolower(command.arguments.front());
+      if (mode != "async" && mode != "sync") {
+        return Message{"ERR syntax error", DataType::SimpleError};
+      }
+      async = mode == "async";
+    }
+    // Detaching the entries is O(1), so other clients are never blocked on
+    // the freeing. Only this client is, unless it asked for ASYNC.
+    const auto flush = [async, lazy_free](Cache &cache) {
+      auto entries = cache.detach();
+      if (lazy_free) {
+        lazy_free->dispose(std::move(entries), async);
+      }
+    };
+    if (command.verb == CommandVerb::FlushDb) {
+      flush(databases[client.db_index]);
+    } else {
+      std::for_each(databases.begin(), databases.end(), flush);
+    }
+    return ok;
   }
+  return std::nullopt;
+}
+
+bool is_write_command(CommandVerb command) {
+  const auto *spec = command_spec(command);
+  return spec && spec->has(CommandSpec::Write);
+}
 
-  // Print out an error but reply with "OK".
-  std::cerr << "Could not generate a valid response for the given command: "
-            << command_to_string(command.verb) << ", with args (size "
-            << command.arguments.size() << "): ";
-  std::cerr << std::endl;
+Message command_to_message(const Command &command) {
+  Message::NestedVariantT elements{};
+  elements.reserve(command.arguments.size() + 2);
+  // Some commands are made up of more than one word (e.g. "config get").
+  std::istringstream words(command_to_string(command.verb));
+  std::string word{};
+  while (words >> word) {
+    elements.emplace_back(word, DataType::BulkString);
+  }
   for (const auto &arg : command.arguments) {
-    std::cerr << arg << std::endl;
+    elements.emplace_back(arg, DataType::BulkString);
   }
-  return Message{"OK", DataType::SimpleString};
+  return Message{std::move(elements), DataType::Array};
 }
 
-std::string command_to_string(CommandVerb command) {
-  switch (command) {
-  case CommandVerb::Ping:
-    return "ping";
-  case CommandVerb::Echo:
-    return "echo";
-  case CommandVerb::Set:
-    return "set";
-  case CommandVerb::Get:
-    return "get";
-  case CommandVerb::ConfigGet:
-    return "config get";
-  case CommandVerb::Keys:
-    return "keys";
-  case CommandVerb::Unknown:
-  default:
-    std::cerr << "Unknown CommandVerb enum encountered: "
-              << static_cast<int>(command) << std::endl;
-    std::terminate();
+Command make_propagated_command(const Command &command,
+                                const Message &reply) {
+  if (command.verb == CommandVerb::XAdd) {
+    return make_propagated_stream_command(command, reply);
+  }
+  if (command.verb == CommandVerb::BLPop ||
+      command.verb == CommandVerb::BRPop) {
+    return make_propagated_blocking_pop(command, reply);
+  }
+  if (command.verb == CommandVerb::Restore) {
+    return make_propagated_restore(command);
   }
+  Command propagated = command;
+  // SET key value PX <milliseconds> becomes SET key value PXAT <unix time>.
+  if (command.verb == CommandVerb::Set && command.arguments.size() == 4 &&
+      tolower(command.arguments[2]) == "px") {
+    const auto expiry_time = std::chrono::steady_clock::now() +
+                             std::chrono::milliseconds(
+                                 std::stoll(command.arguments[3]));
+    propagated.arguments[2] = "pxat";
+    propagated.arguments[3] = std::to_string(
+        steady_clock_to_unix_timestamp<std::chrono::milliseconds>(
+            expiry_time));
+  }
+  return propagated;
+}
+
+std::optional<BlockingSpec> get_blocking_spec(const Command &command) {
+  if (auto spec = get_blocking_pop_spec(command)) {
+    return spec;
+  }
+  return get_xread_blocking_spec(command);
 }
-void handle_command(const Command &command, Cache &cache) {
-  // The SET command has the side-effect of updating the given key-value pairs
-  // in our cache/db.
-  if (command.verb == CommandVerb::Set) {
-    const auto &key = command.arguments.front();
-    const auto &value = command.arguments[1];
-    std::optional<std::chrono::milliseconds> expiry{};
-    if (command.arguments.size() == 4 && command.arguments[2] == "px") {
-      auto num = std::stoul(command.arguments[3]);
-      expiry = std::chrono::milliseconds(num);
-    }
 
-    cache.set(key, value, expiry);
+Command make_blocked_command(const Command &command, const Cache &cache) {
+  if (command.verb == CommandVerb::XRead) {
+    return resolve_xread_last_ids(command, cache);
   }
-}
\ No newline at end of file
+  return command;
+}
+
+std::vector<std::string> command_keys(const Command &command) {
+  const auto &args = command.arguments;
+  switch (command.verb) {
+  case CommandVerb::SInterCard: {
+    // SINTERCARD numkeys key [key ...] [LIMIT limit]
+    const auto num_keys = parse_canonical_int(args.front());
+    if (!num_keys || *num_keys < 0 ||
+        static_cast<std::size_t>(*num_keys) >= args.size()) {
+      return {};
+    }
+    return {args.begin() + 1, args.begin() + 1 + *num_keys};
+  }
+  case CommandVerb::XRead: {
+    // The first half of what follows STREAMS are keys, the rest are IDs.
+    const auto streams = std::ranges::find_if(
+        args, [](const auto &arg) { return tolower(arg) == "streams"; });
+    if (streams == args.end()) {
+      return {};
+    }
+    const auto num_keys = (args.end() - streams - 1) / 2;
+    return {streams + 1, streams + 1 + num_keys};
+  }
+  default:
+    break;
+  }
+  const auto *spec = command_spec(command.verb);
+  if (!spec || spec->first_key == 0) {
+    return {};
+  }
+  // The positions count the name as 0, and arguments start at 1.
+  const auto num_args = static_cast<int>(args.size());
+  const int last = spec->last_key < 0 ? num_args + 1 + spec->last_key
+                                      : std::min(spec->last_key, num_args);
+  std::vector<std::string> keys{};
+  for (int position = spec->first_key; position <= last;
+       position += spec->key_step) {
+    keys.push_back(args[static_cast<std::size_t>(position - 1)]);
+  }
+  return keys;
+}
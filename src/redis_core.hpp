@@ -2,10 +2,14 @@
 
 // System includes.
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <string>
 #include <utility>
+#include <vector>
 
 // Our library's header includes.
 #include "protocol.hpp"
@@ -14,12 +18,59 @@
 
 struct Config;
 class Cache;
+class LazyFree;
+
+// Error replies shared by the command handlers.
+constexpr auto WRONGTYPE_ERROR =
+    "WRONGTYPE Operation against a key holding the wrong kind of value";
+constexpr auto NOT_AN_INTEGER_ERROR =
+    "ERR value is not an integer or out of range";
+
+// The state of a client connection that carries over from one command to the
+// next.
+struct ClientState {
+  // The database the client has SELECTed.
+  std::size_t db_index = 0;
+  // Set for the connection a replica applies its master's writes through,
+  // the only one allowed to write to a replica.
+  bool is_master = false;
+  // The port a replica told us it listens on (REPLCONF listening-port).
+  std::uint16_t listening_port = 0;
+  // Set by ASKING, which lets only the next command into a slot this cluster
+  // node is importing.
+  bool asking = false;
+  // Unique among the server's connections (0 for internal ones, like the
+  // link to a master).
+  std::uint64_t id = 0;
+  // The protocol replies are sent in, picked with HELLO, and the name set by
+  // HELLO's SETNAME.
+  Protocol protocol = Protocol::Resp2;
+  std::string name{};
+  // The client's "ip:port", for SLOWLOG.
+  std::string address{};
+  // Set by CLIENT TRACKING ON: whether the keys the client reads are
+  // tracked, or it hears about keys with its prefixes instead (BCAST).
+  bool tracking = false;
+  bool tracking_bcast = false;
+  // The commands queued since MULTI, until EXEC or DISCARD, and whether one
+  // of them was rejected (so EXEC discards them all).
+  std::optional<std::vector<Command>> transaction{};
+  bool transaction_failed = false;
+  // Set by WATCH, until EXEC, DISCARD or UNWATCH.
+  bool watching = false;
+};
 
 // Figure out what command is being sent to us in the request from the client.
 // This function also makes sure the Message has the correct form (Array type if
 // needed, and number of arguments).
 std::optional<Command> parse_and_validate_command(const Message &message);
-std::string message_to_string(const Message &message);
+// The error to reply with for a request parse_and_validate_command()
+// rejected, like Redis: the command is unknown, or was sent with the wrong
+// number of arguments.
+Message command_error(const Message &message);
+// Serializes the reply for a client speaking the protocol.
+std::string message_to_string(const Message &message,
+                              Protocol protocol = Protocol::Resp2);
 
 // TODO update this func to accept string literals so we don't have to create
 // temporary strings just to create a Message. Given a string or string_view,
@@ -89,4 +140,44 @@ Message generate_response_message(const Command &command, const Config &config,
 std::string command_to_string(CommandVerb command);
 
 // Handle any state changes we need to do before replying to the client.
-void handle_command(const Command &command, Cache &cache);
\ No newline at end of file
+// Returns the reply when the command comes up with it itself (DEL and the
+// commands on aggregates like lists and hashes), otherwise
+// generate_response_message() does.
+std::optional<Message> handle_command(const Command &command,
+                                      const Config &config, Cache &cache,
+                                      const LazyFree *lazy_free = nullptr);
+
+// Applies the commands that act on whole databases rather than on keys
+// (SELECT, SWAPDB, FLUSHDB and FLUSHALL) and returns the reply, or nullopt for
+// any other command. Databases flushed with ASYNC are handed to lazy_free (if
+// given) to be freed in the background.
+std::optional<Message> handle_database_command(const Command &command,
+                                               std::span<Cache> databases,
+                                               ClientState &client,
+                                               LazyFree *lazy_free = nullptr);
+
+// Whether the command modifies the dataset (and so must be persisted to the
+// append-only file).
+bool is_write_command(CommandVerb command);
+
+// Turns the command back into the RESP Array a client would send for it.
+Message command_to_message(const Command &command);
+
+// Rewrites a write command so that replaying it later (e.g. from the
+// append-only file) has the same effect as it did now, given the reply it got.
+// Relative expiry times become absolute unix timestamps, generated stream
+// entry IDs become explicit, and blocking pops become plain ones.
+Command make_propagated_command(const Command &command, const Message &reply);
+
+// The keys and timeout of a blocking command (BLPOP, BRPOP, or XREAD with
+// BLOCK) that replied with nil, or nullopt for the commands that never block.
+std::optional<BlockingSpec> get_blocking_spec(const Command &command);
+
+// The keys the command acts on, which in cluster mode must all be in one hash
+// slot. Empty for commands that take no keys.
+std::vector<std::string> command_keys(const Command &command);
+
+// Rewrites a blocking command so that retrying it once its keys changed only
+// returns what was added since it blocked (XREAD's "$" IDs become the last
+// IDs now).
+Command make_blocked_command(const Command &command, const Cache &cache);
\ No newline at end of file
@@ -2,19 +2,204 @@
 #include "redis_server.hpp"
 
 // System includes.
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <shared_mutex>
+#include <span>
+#include <spanstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <system_error>
 #include <unistd.h>
+#include <utility>
 
 // Our library's header includes.
+#include "command_table.hpp"
 #include "redis_core.hpp"
 #include "storage.hpp"
+#include "utils.hpp"
 
 namespace {
 
-void handle_client_connection(const SocketFd client_fd, const Config &config,
-                              Cache &cache) {
+// Just waits on the future and swallows exceptions (prints them out to cerr).
+void wait_for_async_task(std::future<void> &fut) {
+  try {
+    fut.get();
+  } catch (const std::exception &future_error) {
+    std::cerr << "Exception from async task: " << future_error.what()
+              << std::endl;
+  }
+}
+
+bool is_async_task_done(std::future<void> &fut) {
+  using namespace std::chrono_literals;
+  if (fut.wait_for(0s) == std::future_status::ready) {
+    wait_for_async_task(fut);
+    return true;
+  }
+
+  return false;
+}
+
+// The Redis version we report (in INFO and HELLO) to clients that check for
+// features.
+constexpr auto REDIS_VERSION = "7.2.0";
+// How often the connection of a replica with no writes to send it checks
+// whether it sent an ACK or hung up.
+constexpr auto REPLICA_POLL_INTERVAL = std::chrono::milliseconds(100);
+// The most of the replication stream sent to a replica in one go.
+constexpr std::size_t REPLICA_MAX_CHUNK = 64UL * 1024;
+// How often idle clients are looked for, which is how late past their
+// timeout they may be disconnected.
+constexpr auto IDLE_TIMER_TICK = std::chrono::milliseconds(100);
+
+// Whether the command may make its key ready for clients blocked on it.
+bool may_serve_blocked_clients(CommandVerb command) {
+  return command == CommandVerb::LPush || command == CommandVerb::RPush ||
+         command == CommandVerb::XAdd;
+}
+
+// Whether the command may run before the dataset is done loading. Commands
+// that don't touch the dataset always can, reads only if we were asked to serve
+// whatever keys are loaded so far.
+bool is_allowed_while_loading(CommandVerb command, const Config &config) {
+  const auto *spec = command_spec(command);
+  if (!spec) {
+    return false;
+  }
+  return spec->has(CommandSpec::Loading) ||
+         (spec->has(CommandSpec::ReadOnly) && config.loading_serve_keys);
+}
+
+// Whether the name may be given to a client (with HELLO or CLIENT SETNAME).
+bool is_valid_client_name(const std::string &name) {
+  return std::ranges::none_of(name, [](char character) {
+    return character < '!' || character > '~';
+  });
+}
+
+Message bulk(const std::string &data) {
+  return Message{data, DataType::BulkString};
+}
+
+} // anonymous namespace
+
+Server::Server(Config config)
+    : socket_fd_(create_server_socket(config.port)),
+      config_(std::move(config)),
+      lazy_free_(LazyFreePolicy{
+          .lazy_user_del = config_.lazyfree_lazy_user_del,
+          .lazy_server_del = config_.lazyfree_lazy_server_del,
+          .lazy_user_flush = config_.lazyfree_lazy_user_flush,
+      }),
+      databases_(config_.databases), command_stats_(num_command_verbs()),
+      slow_log_(config_.slowlog_max_len),
+      replication_id_(generate_random_id()),
+      blocked_timer_([this](const std::stop_token &stop) {
+        run_blocked_timer(stop);
+      }),
+      idle_timers_(IDLE_TIMER_TICK),
+      tracking_(
+          [this](const Invalidation &invalidation) {
+            deliver_invalidation(invalidation);
+          },
+          config_.tracking_table_max_keys),
+      pubsub_(
+          [this](const SocketFd client_fd, const ClientState client) {
+            std::scoped_lock lock(futures_mutex_);
+            futures_.push_back(std::async(std::launch::async,
+                                          &Server::handle_client_connection,
+                                          this, client_fd, client));
+          },
+          config_.client_output_buffer_limit_pubsub,
+          [this](const ClientState &client) { forget_client(client); }),
+      tracking_expirer_([this](const std::stop_token &stop) {
+        tracking_.expire_keys(stop);
+      }) {
+  for (auto &cache : databases_) {
+    cache.set_lazy_free(&lazy_free_);
+  }
+  if (config_.timeout > 0) {
+    idle_timer_ = std::jthread(
+        [this](const std::stop_token &stop) { run_idle_timer(stop); });
+  }
+  if (config_.cluster_enabled) {
+    cluster_ = std::make_unique<ClusterState>(config_.cluster_announce_ip,
+                                              config_.port);
+  }
+  if (config_.master_host) {
+    master_link_ = std::make_unique<MasterLink>(
+        *config_.master_host, config_.master_port, config_.port,
+        [this](std::string_view rdb) { load_from_master(rdb); },
+        [this](const Command &command) { apply_from_master(command); });
+  }
+  loading_.start_time = std::chrono::system_clock::now();
+  if (!config_.async_loading) {
+    if (!load_dataset()) {
+      // Refuse to run without the persistence we were asked for.
+      if (socket_fd_) {
+        close(static_cast<int>(*socket_fd_));
+        socket_fd_.reset();
+      }
+    } else if (master_link_) {
+      master_link_->start();
+    }
+    return;
+  }
+  // Clients connecting before we're done are told to come back later (see
+  // execute_command()), so the loader has the databases to itself apart from
+  // reads.
+  loading_.in_progress = true;
+  loader_ = std::jthread([this] {
+    if (!load_dataset()) {
+      // We're already serving clients, so there is no clean way to back out.
+      std::cerr << "Failed to open the append-only file after loading"
+                << std::endl;
+      std::terminate();
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now() - loading_.start_time);
+    std::cout << "Done loading " << loading_.loaded_keys << " keys in "
+              << elapsed.count() << " ms" << std::endl;
+    loading_.in_progress = false;
+    // Only now can the master's writes go through.
+    if (master_link_) {
+      master_link_->start();
+    }
+  });
+}
+
+bool Server::load_dataset() {
+  load_cache(config_, databases_, &loading_);
+  return !config_.appendonly || open_append_only_file();
+}
+
+bool Server::open_append_only_file() {
+  const auto path = aof_path(config_);
+  const bool existed = std::filesystem::exists(path);
+  aof_ = std::make_unique<AppendOnlyFile>(
+      path, config_.appendfsync, config_.auto_aof_rewrite_percentage,
+      config_.auto_aof_rewrite_min_size);
+  if (!aof_->is_open()) {
+    return false;
+  }
+  // If we just turned on the AOF, the data we loaded from the RDB file is not
+  // in it yet. Write it out now so it isn't lost the next time we start up,
+  // since the AOF then takes precedence over the RDB file.
+  if (!existed) {
+    aof_->start_rewrite(snapshot_databases(databases_));
+    aof_->wait_for_rewrite();
+  }
+  return true;
+}
+
+void Server::handle_client_connection(const SocketFd client_fd,
+                                      ClientState client) {
   // For a client, parse each incoming request, process the request, generate a
   // response to the request, and send the response back to the client. Do this
   // in series, and keep repeating until the client closes the connection.
@@ -24,10 +209,23 @@ void handle_client_connection(const SocketFd client_fd, const Config &config,
     // We only deal with simple request-response model for now.
     // TODO we don't support pipelining. So each client sends one request at a
     // time, which results in one response.
-    const auto request = receive_string_from_client(client_fd);
+    start_idle_timer(client, client_fd);
+    std::optional<std::string> request{};
+    try {
+      request = receive_string_from_client(client_fd);
+    } catch (const std::system_error &error) {
+      // E.g. the client stopped answering keepalive probes.
+      std::cerr << "Failed to read from client " << static_cast<int>(client_fd)
+                << ": " << error.what() << std::endl;
+    }
+    // The client is only idle while we wait for its request, so a slow
+    // command (or reply) doesn't get its socket shut down.
+    stop_idle_timer(client);
     if (!request) {
       std::cout << "Closing connection with " << static_cast<int>(client_fd)
                 << std::endl;
+      forget_client(client);
+      close(static_cast<int>(client_fd));
       break;
     }
     std::cout << "Parsing request from client " << static_cast<int>(client_fd)
@@ -40,52 +238,1199 @@ void handle_client_connection(const SocketFd client_fd, const Config &config,
     const auto command = parse_and_validate_command(request_message);
     Message response_message{};
     if (!command) {
-      // Print out an error but reply with "OK".
-      std::cerr << "Could not parse command from given request: "
-                << message_to_string(request_message) << std::endl;
-      response_message = Message{"OK", DataType::SimpleString};
+      response_message = command_error(request_message);
+      // Like any command rejected in a transaction, it fails the
+      // transaction.
+      if (client.transaction) {
+        client.transaction_failed = true;
+      }
+    } else if (client.transaction && command->verb != CommandVerb::Exec &&
+               command->verb != CommandVerb::Discard) {
+      response_message = queue_command(*command, client);
+    } else if (command_spec(command->verb)->has(CommandSpec::Blocking)) {
+      auto reply = execute_blocking_command(*command, client, client_fd);
+      if (!reply) {
+        // The client is blocked, and this task is done with it.
+        return;
+      }
+      response_message = std::move(*reply);
+    } else if (command->verb == CommandVerb::PSync) {
+      auto reply = serve_replica(*command, client, client_fd);
+      if (!reply) {
+        // The replica has disconnected, and the connection is closed.
+        forget_client(client);
+        return;
+      }
+      response_message = std::move(*reply);
+    } else if (command->verb == CommandVerb::Subscribe ||
+               command->verb == CommandVerb::PSubscribe) {
+      // The client is subscribed, and pubsub_ replies to it (and pushes
+      // invalidation messages to it) from now on.
+      pubsub_.subscribe(client_fd, client, *command);
+      return;
+    } else if (command->verb == CommandVerb::Client) {
+      const auto start = CommandStats::Clock::now();
+      response_message = client_command(*command, client, client_fd);
+      record_command(*command, client, start, response_message);
+    } else if (command->verb == CommandVerb::Exec) {
+      const auto start = CommandStats::Clock::now();
+      response_message = exec(client, client_fd);
+      record_command(*command, client, start, response_message);
     } else {
-      handle_command(*command, cache);
-      response_message = generate_response_message(*command, config, cache);
+      response_message = execute_command(*command, client);
+      serve_blocked_clients(*command, client.db_index);
     }
 
-    const auto response = message_to_string(response_message);
+    const auto response = message_to_string(response_message, client.protocol);
     std::cout << "Sending Response: " << response << std::endl;
-    send_to_client(client_fd, response);
+    send_reply(client_fd, client, response);
   }
 }
 
-// Just waits on the future and swallows exceptions (prints them out to cerr).
-void wait_for_async_task(std::future<void> &fut) {
+Message Server::execute_command(const Command &command, ClientState &client) {
+  if (auto rejected = check_command(command, client)) {
+    command_stats_.record_rejected(command.verb);
+    return std::move(*rejected);
+  }
+  std::uint64_t aof_offset = 0;
+  Message response_message{};
+  {
+    std::shared_lock lock(exec_mutex_);
+    const auto start = CommandStats::Clock::now();
+    response_message = run_command(command, client, aof_offset);
+    record_command(command, client, start, response_message);
+  }
+  // Under "appendfsync always" we must not acknowledge the write until it is
+  // on disk. Waiting outside the locks lets other writers join the same fsync.
+  if (aof_ && aof_offset > 0) {
+    aof_->wait_until_durable(aof_offset);
+  }
+  return response_message;
+}
+
+std::optional<Message> Server::check_command(const Command &command,
+                                             ClientState &client) {
+  // NOTE: nothing may touch aof_ until loading is done, since the loader
+  // thread sets it up.
+  if (loading_.in_progress &&
+      !is_allowed_while_loading(command.verb, config_)) {
+    return Message{"LOADING Redis is loading the dataset in memory",
+                   DataType::SimpleError};
+  }
+  if (cluster_ && command.verb != CommandVerb::Cluster &&
+      command.verb != CommandVerb::Asking) {
+    if (auto redirect =
+            cluster_redirect(command, std::exchange(client.asking, false))) {
+      return std::move(*redirect);
+    }
+    if (command.verb == CommandVerb::Select &&
+        command.arguments.front() != "0") {
+      return Message{"ERR SELECT is not allowed in cluster mode",
+                     DataType::SimpleError};
+    }
+    if (command.verb == CommandVerb::SwapDb) {
+      return Message{"ERR SWAPDB is not allowed in cluster mode",
+                     DataType::SimpleError};
+    }
+  }
+  // Replicas only change along with their master.
+  if (is_write_command(command.verb) && config_.master_host &&
+      !client.is_master) {
+    return Message{"READONLY You can't write against a read only replica.",
+                   DataType::SimpleError};
+  }
+  return std::nullopt;
+}
+
+Message Server::run_command(const Command &command, ClientState &client,
+                            std::uint64_t &aof_offset) {
+  if (command.verb == CommandVerb::Info) {
+    return info(command.arguments);
+  }
+  if (command.verb == CommandVerb::Save) {
+    return save();
+  }
+  if (command.verb == CommandVerb::BgRewriteAof) {
+    return rewrite_append_only_file();
+  }
+  if (command.verb == CommandVerb::ReplConf) {
+    return replconf(command, client);
+  }
+  if (command.verb == CommandVerb::Hello) {
+    return hello(command, client);
+  }
+  if (command.verb == CommandVerb::SlowLog) {
+    return slowlog(command);
+  }
+  // Channels are shared by all databases, and (unlike in Redis) not by the
+  // nodes of a cluster.
+  if (command.verb == CommandVerb::Publish) {
+    return Message{std::to_string(pubsub_.publish(command.arguments[0],
+                                                  command.arguments[1])),
+                   DataType::Integer};
+  }
+  if (command.verb == CommandVerb::PubSub) {
+    return pubsub_.introspect(command);
+  }
+  if (command.verb == CommandVerb::Unsubscribe ||
+      command.verb == CommandVerb::PUnsubscribe) {
+    // Only a subscribed client has anything to unsubscribe from.
+    const bool is_pattern = command.verb == CommandVerb::PUnsubscribe;
+    return Message{
+        Message::NestedVariantT{
+            Message{is_pattern ? "punsubscribe" : "unsubscribe",
+                    DataType::BulkString},
+            command.arguments.empty()
+                ? Message{"", DataType::NullBulkString}
+                : Message{command.arguments.front(), DataType::BulkString},
+            Message{"0", DataType::Integer}},
+        DataType::Push};
+  }
+  if (command.verb == CommandVerb::Cluster ||
+      command.verb == CommandVerb::Asking) {
+    if (!cluster_) {
+      return Message{"ERR This instance has cluster support disabled",
+                     DataType::SimpleError};
+    }
+    if (command.verb == CommandVerb::Asking) {
+      client.asking = true;
+      return Message{"OK", DataType::SimpleString};
+    }
+    // A cluster node only has database 0.
+    return handle_cluster_command(command, *cluster_, databases_.front());
+  }
+  // A client in a transaction only gets here with EXEC and DISCARD (see
+  // queue_command()), and EXEC is handled by the connection.
+  if (command.verb == CommandVerb::Multi) {
+    client.transaction.emplace();
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (command.verb == CommandVerb::Discard) {
+    if (!client.transaction) {
+      return Message{"ERR DISCARD without MULTI", DataType::SimpleError};
+    }
+    client.transaction.reset();
+    client.transaction_failed = false;
+    unwatch(client);
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (command.verb == CommandVerb::Exec) {
+    return Message{"ERR EXEC without MULTI", DataType::SimpleError};
+  }
+  if (command.verb == CommandVerb::Watch) {
+    return watch(command, client);
+  }
+  if (command.verb == CommandVerb::Unwatch) {
+    unwatch(client);
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (!is_write_command(command.verb)) {
+    if (client.tracking && !client.tracking_bcast) {
+      track_keys(command, client);
+    }
+    return apply_command(command, client);
+  }
+  if (command.verb == CommandVerb::Migrate) {
+    return migrate(command, client);
+  }
+  Message response_message{};
+  {
+    std::scoped_lock lock(write_mutex_);
+    response_message = apply_command(command, client);
+    // Commands that failed didn't change anything, and neither did blocking
+    // commands that found nothing.
+    if (response_message.get_data_type() == DataType::SimpleError ||
+        (response_message.get_data_type() == DataType::NullBulkString &&
+         get_blocking_spec(command))) {
+      return response_message;
+    }
+    if (aof_ || backlog_) {
+      aof_offset = persist(client.db_index,
+                           make_propagated_command(command, response_message));
+    }
+  }
+  // Still holding exec_mutex_, so a transaction watching the keys can't run
+  // before it hears about the write.
+  touch_watched_keys(command, client);
+  invalidate_keys(command, client);
+  return response_message;
+}
+
+Message Server::queue_command(const Command &command, ClientState &client) {
+  // Neither of these fails the transaction.
+  if (command.verb == CommandVerb::Multi) {
+    return Message{"ERR MULTI calls can not be nested", DataType::SimpleError};
+  }
+  if (command.verb == CommandVerb::Watch) {
+    return Message{"ERR WATCH inside MULTI is not allowed",
+                   DataType::SimpleError};
+  }
+  // Commands are checked as they are queued, so EXEC only runs transactions
+  // that can run in full.
+  std::optional<Message> rejected{};
+  if (command.verb == CommandVerb::Subscribe ||
+      command.verb == CommandVerb::PSubscribe ||
+      command.verb == CommandVerb::PSync) {
+    // These take over the connection.
+    rejected = Message{"ERR Command not allowed inside a transaction",
+                       DataType::SimpleError};
+  } else {
+    rejected = check_command(command, client);
+  }
+  if (rejected) {
+    command_stats_.record_rejected(command.verb);
+    client.transaction_failed = true;
+    return std::move(*rejected);
+  }
+  client.transaction->push_back(command);
+  return Message{"QUEUED", DataType::SimpleString};
+}
+
+Message Server::exec(ClientState &client, const SocketFd client_fd) {
+  if (!client.transaction) {
+    return Message{"ERR EXEC without MULTI", DataType::SimpleError};
+  }
+  const auto commands = std::move(*client.transaction);
+  client.transaction.reset();
+  if (std::exchange(client.transaction_failed, false)) {
+    unwatch(client);
+    return Message{
+        "EXECABORT Transaction discarded because of previous errors.",
+        DataType::SimpleError};
+  }
+  Message::NestedVariantT replies{};
+  replies.reserve(commands.size());
+  // The database each command ran in, for serving blocked clients.
+  std::vector<std::size_t> db_indices{};
+  db_indices.reserve(commands.size());
+  std::uint64_t aof_offset = 0;
+  {
+    std::unique_lock lock(exec_mutex_);
+    // No write can run until we're done, so none slips in after the check.
+    const bool is_dirty =
+        client.watching && watched_keys_.is_dirty(client.id);
+    unwatch(client);
+    if (is_dirty) {
+      return Message{"", DataType::NullArray};
+    }
+    in_transaction_ = true;
+    for (const auto &command : commands) {
+      db_indices.push_back(client.db_index);
+      std::uint64_t offset = 0;
+      const auto start = CommandStats::Clock::now();
+      replies.push_back(command.verb == CommandVerb::Client
+                            ? client_command(command, client, client_fd)
+                            : run_command(command, client, offset));
+      record_command(command, client, start, replies.back());
+      aof_offset = std::max(aof_offset, offset);
+    }
+    aof_offset = std::max(aof_offset, end_transaction());
+  }
+  // Blocking commands ran like their non-blocking versions, and the clients
+  // blocked on the keys written to are only served once the transaction is
+  // done, like in Redis.
+  for (std::size_t i = 0; i < commands.size(); ++i) {
+    serve_blocked_clients(commands[i], db_indices[i]);
+  }
+  if (aof_ && aof_offset > 0) {
+    aof_->wait_until_durable(aof_offset);
+  }
+  return Message{std::move(replies), DataType::Array};
+}
+
+std::uint64_t Server::end_transaction() {
+  std::scoped_lock lock(write_mutex_);
+  in_transaction_ = false;
+  std::uint64_t aof_offset = 0;
+  // NOTE: aof_ may only be touched if something was written (see
+  // check_command()), since EXEC is allowed while loading.
+  if (const auto db_index =
+          std::exchange(transaction_db_index_, std::nullopt)) {
+    aof_offset = append_write(*db_index, Command{CommandVerb::Exec, {}});
+    if (aof_ && aof_->should_auto_rewrite()) {
+      rewrite_scheduled_ = true;
+    }
+  }
+  if (std::exchange(rewrite_scheduled_, false)) {
+    aof_->start_rewrite(snapshot_databases(databases_));
+  }
+  return aof_offset;
+}
+
+void Server::record_command(const Command &command, const ClientState &client,
+                            const CommandStats::Clock::time_point start,
+                            const Message &reply) {
+  const auto duration = CommandStats::Clock::now() - start;
+  command_stats_.record(command.verb, duration,
+                        reply.get_data_type() == DataType::SimpleError);
+  // Like in Redis, the commands in a transaction are logged rather than EXEC.
+  if (config_.slowlog_log_slower_than >= 0 &&
+      command.verb != CommandVerb::Exec &&
+      duration >= std::chrono::microseconds(config_.slowlog_log_slower_than)) {
+    slow_log_.add(
+        command,
+        std::chrono::duration_cast<std::chrono::microseconds>(duration),
+        client.address, client.name);
+  }
+}
+
+Message Server::slowlog(const Command &command) {
+  const auto &args = command.arguments;
+  const auto subcommand = tolower(args.front());
+  if (subcommand == "get") {
+    std::size_t count = 10;
+    if (args.size() == 2) {
+      const auto parsed = parse_canonical_int(args[1]);
+      if (!parsed || *parsed < -1) {
+        return Message{"ERR count should be greater than or equal to -1",
+                       DataType::SimpleError};
+      }
+      count = *parsed == -1 ? std::numeric_limits<std::size_t>::max()
+                            : static_cast<std::size_t>(*parsed);
+    }
+    const auto integer = [](const auto value) {
+      return Message{std::to_string(value), DataType::Integer};
+    };
+    const auto bulk = [](const std::string &str) {
+      return Message{str, DataType::BulkString};
+    };
+    // Each entry is its ID, unix time in seconds, duration in microseconds,
+    // the command, and the client's address and name.
+    Message::NestedVariantT entries{};
+    for (const auto &entry : slow_log_.get(count)) {
+      Message::NestedVariantT words{};
+      for (const auto &word : entry.words) {
+        words.push_back(bulk(word));
+      }
+      entries.emplace_back(
+          Message::NestedVariantT{
+              integer(entry.id),
+              integer(std::chrono::duration_cast<std::chrono::seconds>(
+                          entry.time.time_since_epoch())
+                          .count()),
+              integer(entry.duration.count()),
+              Message{std::move(words), DataType::Array},
+              bulk(entry.client_address), bulk(entry.client_name)},
+          DataType::Array);
+    }
+    return Message{std::move(entries), DataType::Array};
+  }
+  if (subcommand == "len" && args.size() == 1) {
+    return Message{std::to_string(slow_log_.size()), DataType::Integer};
+  }
+  if (subcommand == "reset" && args.size() == 1) {
+    slow_log_.reset();
+    return Message{"OK", DataType::SimpleString};
+  }
+  return Message{"ERR unknown subcommand or wrong number of arguments for '" +
+                     args.front() + "'",
+                 DataType::SimpleError};
+}
+
+Message Server::watch(const Command &command, ClientState &client) {
+  const auto &cache = databases_[client.db_index];
+  for (const auto &key : command.arguments) {
+    watched_keys_.watch(client.id, client.db_index, key,
+                        cache.read_entry(key, [](const Cache::EntryT *entry) {
+                          return entry ? entry->second : std::nullopt;
+                        }));
+  }
+  client.watching = true;
+  return Message{"OK", DataType::SimpleString};
+}
+
+void Server::unwatch(ClientState &client) {
+  if (std::exchange(client.watching, false)) {
+    watched_keys_.unwatch(client.id);
+  }
+}
+
+void Server::touch_watched_keys(const Command &command,
+                                const ClientState &client) {
+  if (watched_keys_.num_clients() == 0) {
+    return;
+  }
+  if (command.verb == CommandVerb::FlushAll) {
+    watched_keys_.touch_all();
+  } else if (command.verb == CommandVerb::FlushDb) {
+    watched_keys_.touch_db(client.db_index);
+  } else if (command.verb == CommandVerb::SwapDb) {
+    for (const auto &index : command.arguments) {
+      watched_keys_.touch_db(
+          static_cast<std::size_t>(parse_canonical_int(index).value_or(0)));
+    }
+  } else {
+    watched_keys_.touch(client.db_index, command_keys(command));
+  }
+}
+
+void Server::forget_client(const ClientState &client) {
+  stop_tracking(client);
+  if (client.watching) {
+    watched_keys_.unwatch(client.id);
+  }
+}
+
+std::uint64_t Server::persist(const std::size_t db_index,
+                              const Command &command) {
+  if (!in_transaction_) {
+    const auto aof_offset = append_write(db_index, command);
+    if (aof_ && aof_->should_auto_rewrite()) {
+      aof_->start_rewrite(snapshot_databases(databases_));
+    }
+    return aof_offset;
+  }
+  // A rewrite can't start until the transaction is done (see
+  // end_transaction()), or the new file could hold only part of it.
+  if (!transaction_db_index_) {
+    append_write(db_index, Command{CommandVerb::Multi, {}});
+  }
+  transaction_db_index_ = db_index;
+  return append_write(db_index, command);
+}
+
+std::uint64_t Server::append_write(const std::size_t db_index,
+                                   const Command &command) {
+  std::uint64_t aof_offset = 0;
+  if (aof_) {
+    aof_offset = aof_->append(db_index, command);
+  }
+  if (backlog_) {
+    propagate(db_index, command);
+  }
+  return aof_offset;
+}
+
+std::optional<Message> Server::cluster_redirect(const Command &command,
+                                                const bool asking) const {
+  const auto keys = command_keys(command);
+  if (keys.empty()) {
+    return std::nullopt;
+  }
+  const auto slot = key_hash_slot(keys.front());
+  if (std::ranges::any_of(keys, [slot](const auto &key) {
+        return key_hash_slot(key) != slot;
+      })) {
+    return Message{"CROSSSLOT Keys in request don't hash to the same slot",
+                   DataType::SimpleError};
+  }
+  const auto &cache = databases_.front();
+  auto redirect = cluster_->redirect(slot, asking, keys.size(), [&] {
+    return static_cast<std::size_t>(
+        std::ranges::count_if(keys, [&cache](const auto &key) {
+          return cache.type(key).has_value();
+        }));
+  });
+  if (!redirect) {
+    return std::nullopt;
+  }
+  return Message{std::move(*redirect), DataType::SimpleError};
+}
+
+Message Server::migrate(const Command &command, const ClientState &client) {
+  // MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE]
+  // [KEYS key [key ...]]
+  const auto &args = command.arguments;
+  const auto port = parse_canonical_int(args[1]);
+  const auto db = parse_canonical_int(args[3]);
+  const auto timeout = parse_canonical_int(args[4]);
+  if (!port || !db || !timeout || *port <= 0 ||
+      *port > std::numeric_limits<std::uint16_t>::max()) {
+    return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+  }
+  bool copy = false;
+  bool replace = false;
+  std::vector<std::string> keys{};
+  for (std::size_t i = 5; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "copy") {
+      copy = true;
+    } else if (option == "replace") {
+      replace = true;
+    } else if (option == "keys" && args[2].empty()) {
+      keys.assign(args.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+                  args.end());
+      break;
+    } else {
+      return Message{"ERR syntax error", DataType::SimpleError};
+    }
+  }
+  if (keys.empty()) {
+    keys.push_back(args[2]);
+  }
+
+  // Nothing else may change the keys until the other server has them.
+  std::unique_lock lock(write_mutex_);
+  auto &cache = databases_[client.db_index];
+  std::vector<Command> requests{Command{CommandVerb::Select, {args[3]}}};
+  std::vector<std::string> moved{};
+  for (const auto &key : keys) {
+    cache.read_entry(key, [&](const Cache::EntryT *entry) {
+      if (!entry) {
+        return;
+      }
+      // The TTL left, where 0 means the key never expires.
+      std::int64_t ttl = 0;
+      if (entry->second) {
+        ttl = std::max<std::int64_t>(
+            1, std::chrono::duration_cast<std::chrono::milliseconds>(
+                   *entry->second - std::chrono::steady_clock::now())
+                   .count());
+      }
+      // The target may still be importing the slot.
+      if (cluster_) {
+        requests.push_back(Command{CommandVerb::Asking, {}});
+      }
+      requests.push_back(
+          Command{CommandVerb::Restore,
+                  {key, std::to_string(ttl), dump_value(entry->first)}});
+      if (replace) {
+        requests.back().arguments.emplace_back("REPLACE");
+      }
+      moved.push_back(key);
+    });
+  }
+  if (moved.empty()) {
+    return Message{"NOKEY", DataType::SimpleString};
+  }
+
+  const auto target_fd =
+      connect_to_server(args[0], static_cast<std::uint16_t>(*port));
+  if (!target_fd) {
+    return Message{"IOERR error or timeout connecting to the client",
+                   DataType::SimpleError};
+  }
+  // A timeout of 0 means the default, like in Redis.
+  set_socket_timeout(*target_fd, std::chrono::milliseconds(
+                                     *timeout > 0 ? *timeout : 1000));
+  // One command at a time, since servers like us don't take pipelines.
+  std::optional<std::string> error{};
   try {
-    fut.get();
-  } catch (const std::exception &future_error) {
-    std::cerr << "Exception from async task: " << future_error.what()
-              << std::endl;
+    std::string buffer{};
+    for (const auto &request : requests) {
+      if (!send_to_client(*target_fd,
+                          message_to_string(command_to_message(request)))) {
+        error = "IOERR error or timeout writing to target instance";
+        break;
+      }
+      const auto reply = read_node_reply(*target_fd, buffer);
+      if (!reply) {
+        error = "IOERR error or timeout reading to target instance";
+        break;
+      }
+      if (reply->starts_with('-')) {
+        error = "ERR Target instance replied with error: " + reply->substr(1);
+        break;
+      }
+    }
+  } catch (const std::system_error &) {
+    error = "IOERR error or timeout reading to target instance";
+  }
+  close(static_cast<int>(*target_fd));
+  if (error) {
+    return Message{std::move(*error), DataType::SimpleError};
   }
+  if (copy) {
+    return Message{"OK", DataType::SimpleString};
+  }
+  for (const auto &key : moved) {
+    cache.remove(key, lazy_free_.policy().lazy_server_del);
+  }
+  const Command del{CommandVerb::Del, std::move(moved)};
+  const auto aof_offset = persist(client.db_index, del);
+  lock.unlock();
+  touch_watched_keys(del, client);
+  invalidate_keys(del, client);
+  if (aof_) {
+    aof_->wait_until_durable(aof_offset);
+  }
+  return Message{"OK", DataType::SimpleString};
 }
 
-bool is_async_task_done(std::future<void> &fut) {
-  using namespace std::chrono_literals;
-  if (fut.wait_for(0s) == std::future_status::ready) {
-    wait_for_async_task(fut);
-    return true;
+std::optional<Message>
+Server::execute_blocking_command(const Command &command, ClientState &client,
+                                 const SocketFd client_fd) {
+  ++num_blocking_;
+  std::unique_lock lock(blocked_mutex_);
+  auto reply = execute_command(command, client);
+  const auto spec = reply.get_data_type() == DataType::NullBulkString
+                        ? get_blocking_spec(command)
+                        : std::nullopt;
+  if (!spec) {
+    --num_blocking_;
+    return reply;
+  }
+  BlockedClient blocked{client_fd, client,
+                        make_blocked_command(command,
+                                             databases_[client.db_index]),
+                        spec->keys, std::nullopt};
+  if (spec->timeout) {
+    blocked.deadline = std::chrono::steady_clock::now() + *spec->timeout;
   }
+  const auto next_deadline = blocked_.next_deadline();
+  const bool is_earliest =
+      blocked.deadline &&
+      (!next_deadline || *blocked.deadline < *next_deadline);
+  blocked_.block(std::move(blocked));
+  if (is_earliest) {
+    blocked_.wake();
+  }
+  return std::nullopt;
+}
 
-  return false;
+void Server::serve_blocked_clients(const Command &command,
+                                   const std::size_t db_index) {
+  if (num_blocking_ == 0 || !may_serve_blocked_clients(command.verb)) {
+    return;
+  }
+  const auto &key = command.arguments.front();
+  std::vector<std::pair<BlockedClient, Message>> served{};
+  {
+    std::scoped_lock lock(blocked_mutex_);
+    // Once a pop finds nothing, the list is gone and the other pops can only
+    // go through on their other keys, which they would have already.
+    bool is_drained = false;
+    for (const auto id : blocked_.waiting_on(db_index, key)) {
+      const auto &blocked = *blocked_.find(id);
+      const bool is_pop = blocked.command.verb != CommandVerb::XRead;
+      if (is_pop && is_drained) {
+        continue;
+      }
+      ClientState state = blocked.state;
+      auto reply = execute_command(blocked.command, state);
+      if (reply.get_data_type() == DataType::NullBulkString) {
+        is_drained = is_drained || is_pop;
+        continue;
+      }
+      served.emplace_back(*blocked_.unblock(id), std::move(reply));
+    }
+  }
+  // Replying outside the lock, so slow clients don't hold up the others.
+  for (auto &[blocked, reply] : served) {
+    resume_client(std::move(blocked), reply);
+  }
 }
 
-} // anonymous namespace
+void Server::resume_client(BlockedClient client, const Message &reply) {
+  --num_blocking_;
+  send_reply(client.fd, client.state,
+             message_to_string(reply, client.state.protocol));
+  std::scoped_lock lock(futures_mutex_);
+  futures_.push_back(std::async(std::launch::async,
+                                &Server::handle_client_connection, this,
+                                client.fd, client.state));
+}
 
-Server::Server(Config config)
-    : socket_fd_(create_server_socket()),
-      // TODO assume there's only one database we read from the RDB file. We
-      // don't handle multiple databases.
-      cache_(load_cache(config)), config_(std::move(config)) {}
+void Server::run_blocked_timer(const std::stop_token &stop) {
+  while (!stop.stop_requested()) {
+    std::optional<std::chrono::steady_clock::time_point> next_deadline{};
+    {
+      std::scoped_lock lock(blocked_mutex_);
+      next_deadline = blocked_.next_deadline();
+    }
+    const auto hung_up = blocked_.wait(next_deadline);
+    std::vector<BlockedClient> closed{};
+    std::vector<BlockedClient> timed_out{};
+    {
+      std::scoped_lock lock(blocked_mutex_);
+      for (const auto id : hung_up) {
+        if (auto blocked = blocked_.unblock(id)) {
+          closed.push_back(std::move(*blocked));
+        }
+      }
+      for (const auto id :
+           blocked_.timed_out(std::chrono::steady_clock::now())) {
+        timed_out.push_back(*blocked_.unblock(id));
+      }
+    }
+    for (const auto &blocked : closed) {
+      std::cout << "Closing connection with "
+                << static_cast<int>(blocked.fd) << std::endl;
+      // Before its descriptor can be reused.
+      forget_client(blocked.state);
+      close(static_cast<int>(blocked.fd));
+      --num_blocking_;
+    }
+    for (auto &blocked : timed_out) {
+      resume_client(std::move(blocked), Message{"", DataType::NullBulkString});
+    }
+  }
+}
+
+void Server::start_idle_timer(const ClientState &client,
+                              const SocketFd client_fd) {
+  if (config_.timeout == 0) {
+    return;
+  }
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(config_.timeout);
+  std::scoped_lock lock(idle_mutex_);
+  if (idle_timers_.empty()) {
+    idle_timer_started_.notify_one();
+  }
+  idle_timers_.schedule(client.id, deadline);
+  idle_fds_.insert_or_assign(client.id, client_fd);
+}
+
+void Server::stop_idle_timer(const ClientState &client) {
+  if (config_.timeout == 0) {
+    return;
+  }
+  std::scoped_lock lock(idle_mutex_);
+  idle_timers_.cancel(client.id);
+  idle_fds_.erase(client.id);
+}
+
+void Server::run_idle_timer(const std::stop_token &stop) {
+  std::unique_lock lock(idle_mutex_);
+  while (!stop.stop_requested()) {
+    if (idle_timers_.empty()) {
+      idle_timer_started_.wait(lock, stop,
+                               [this] { return !idle_timers_.empty(); });
+      continue;
+    }
+    // Only woken up early to stop.
+    idle_timer_started_.wait_for(lock, stop, IDLE_TIMER_TICK,
+                                 [] { return false; });
+    for (const auto id :
+         idle_timers_.advance(std::chrono::steady_clock::now())) {
+      const auto fd = idle_fds_.extract(id).mapped();
+      std::cout << "Timing out idle client " << static_cast<int>(fd)
+                << std::endl;
+      // Its task closes the socket once it stops the timer, which it can't
+      // do while we hold the lock, so the descriptor isn't reused yet.
+      shutdown(static_cast<int>(fd), SHUT_RDWR);
+    }
+  }
+}
+
+Message Server::replconf(const Command &command, ClientState &client) {
+  // Only the replica's port is of use to us (for INFO), the rest of what
+  // replicas tell us (e.g. "capa psync2") is just acknowledged.
+  if (tolower(command.arguments.front()) == "listening-port") {
+    const auto port = parse_canonical_int(command.arguments[1]);
+    if (!port || *port <= 0 ||
+        *port > std::numeric_limits<std::uint16_t>::max()) {
+      return Message{"ERR value is not an integer or out of range",
+                     DataType::SimpleError};
+    }
+    client.listening_port = static_cast<std::uint16_t>(*port);
+  }
+  return Message{"OK", DataType::SimpleString};
+}
+
+Message Server::hello(const Command &command, ClientState &client) {
+  const auto &args = command.arguments;
+  auto protocol = client.protocol;
+  if (!args.empty()) {
+    const auto version = parse_canonical_int(args.front());
+    if (!version) {
+      return Message{"ERR Protocol version is not an integer or out of range",
+                     DataType::SimpleError};
+    }
+    if (*version != 2 && *version != 3) {
+      return Message{"NOPROTO unsupported protocol version",
+                     DataType::SimpleError};
+    }
+    protocol = static_cast<Protocol>(*version);
+  }
+  std::optional<std::string> name{};
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "auth" && i + 2 < args.size()) {
+      // There are no users or passwords yet, so only the default user (who
+      // needs no password) exists.
+      if (args[i + 1] != "default") {
+        return Message{"WRONGPASS invalid username-password pair or user is "
+                       "disabled.",
+                       DataType::SimpleError};
+      }
+      i += 2;
+    } else if (option == "setname" && i + 1 < args.size()) {
+      name = args[++i];
+      if (!is_valid_client_name(*name)) {
+        return Message{"ERR Client names cannot contain spaces, newlines or "
+                       "special characters.",
+                       DataType::SimpleError};
+      }
+    } else {
+      return Message{"ERR Syntax error in HELLO option '" + args[i] + "'",
+                     DataType::SimpleError};
+    }
+  }
+  // Only switch once the whole command is known to be valid.
+  client.protocol = protocol;
+  if (name) {
+    client.name = std::move(*name);
+  }
+  if (client.tracking) {
+    pubsub_.set_protocol(client.id, protocol);
+  }
+  return Message{
+      Message::NestedVariantT{
+          bulk("server"), bulk("redis"), bulk("version"), bulk(REDIS_VERSION),
+          bulk("proto"),
+          Message{std::to_string(static_cast<int>(protocol)),
+                  DataType::Integer},
+          bulk("id"), Message{std::to_string(client.id), DataType::Integer},
+          bulk("mode"), bulk(cluster_ ? "cluster" : "standalone"),
+          bulk("role"), bulk(config_.master_host ? "replica" : "master"),
+          bulk("modules"),
+          Message{Message::NestedVariantT{}, DataType::Array}},
+      DataType::Map};
+}
+
+void Server::send_reply(const SocketFd client_fd, const ClientState &client,
+                        const std::string &reply) {
+  if (!client.tracking) {
+    send_to_client(client_fd, reply);
+    return;
+  }
+  pubsub_.send(client.id, client_fd, reply);
+}
+
+Message Server::client_command(const Command &command, ClientState &client,
+                               const SocketFd client_fd) {
+  const auto &args = command.arguments;
+  const auto subcommand = tolower(args.front());
+  if (subcommand == "id" && args.size() == 1) {
+    return Message{std::to_string(client.id), DataType::Integer};
+  }
+  if (subcommand == "getname" && args.size() == 1) {
+    return client.name.empty() ? Message{"", DataType::NullBulkString}
+                               : bulk(client.name);
+  }
+  if (subcommand == "setname" && args.size() == 2) {
+    if (!is_valid_client_name(args[1])) {
+      return Message{"ERR Client names cannot contain spaces, newlines or "
+                     "special characters.",
+                     DataType::SimpleError};
+    }
+    client.name = args[1];
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (subcommand != "tracking" || args.size() < 2) {
+    return Message{"ERR unknown subcommand or wrong number of arguments for '" +
+                       args.front() + "'",
+                   DataType::SimpleError};
+  }
+  // CLIENT TRACKING ON|OFF [REDIRECT id] [PREFIX prefix ...] [BCAST] [NOLOOP]
+  const auto state = tolower(args[1]);
+  if (state == "off" && args.size() == 2) {
+    stop_tracking(client);
+    client.tracking = false;
+    client.tracking_bcast = false;
+    return Message{"OK", DataType::SimpleString};
+  }
+  if (state != "on") {
+    return Message{"ERR syntax error", DataType::SimpleError};
+  }
+  TrackingOptions options{};
+  for (std::size_t i = 2; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "redirect" && i + 1 < args.size()) {
+      const auto id = parse_canonical_int(args[++i]);
+      if (!id || *id <= 0) {
+        return Message{"ERR The client ID you want redirect to does not exist",
+                       DataType::SimpleError};
+      }
+      options.redirect = static_cast<std::uint64_t>(*id);
+    } else if (option == "prefix" && i + 1 < args.size()) {
+      options.prefixes.push_back(args[++i]);
+    } else if (option == "bcast") {
+      options.bcast = true;
+    } else if (option == "noloop") {
+      options.noloop = true;
+    } else if (option == "optin" || option == "optout") {
+      return Message{"ERR OPTIN and OPTOUT are not supported",
+                     DataType::SimpleError};
+    } else {
+      return Message{"ERR syntax error", DataType::SimpleError};
+    }
+  }
+  if (!options.prefixes.empty() && !options.bcast) {
+    return Message{"ERR PREFIX option requires BCAST mode to be enabled",
+                   DataType::SimpleError};
+  }
+  if (client.tracking && client.tracking_bcast != options.bcast) {
+    return Message{"ERR You can't switch BCAST mode on/off before disabling "
+                   "tracking for this client, and then re-enabling it with a "
+                   "different mode.",
+                   DataType::SimpleError};
+  }
+  // Attached before tracking starts, so no invalidation is missed.
+  pubsub_.attach(client_fd, client);
+  client.tracking = true;
+  client.tracking_bcast = options.bcast;
+  tracking_.enable(client.id, std::move(options));
+  return Message{"OK", DataType::SimpleString};
+}
+
+void Server::stop_tracking(const ClientState &client) {
+  if (!client.tracking) {
+    return;
+  }
+  tracking_.disable(client.id);
+  pubsub_.detach(client.id);
+}
+
+void Server::track_keys(const Command &command, const ClientState &client) {
+  const auto &cache = databases_[client.db_index];
+  for (const auto &key : command_keys(command)) {
+    tracking_.track(client.id, key,
+                    cache.read_entry(key, [](const Cache::EntryT *entry) {
+                      return entry ? entry->second : std::nullopt;
+                    }));
+  }
+}
+
+void Server::invalidate_keys(const Command &command,
+                             const ClientState &client) {
+  if (tracking_.num_clients() == 0) {
+    return;
+  }
+  if (command.verb == CommandVerb::FlushDb ||
+      command.verb == CommandVerb::FlushAll ||
+      command.verb == CommandVerb::SwapDb) {
+    tracking_.invalidate_all();
+    return;
+  }
+  tracking_.invalidate(command_keys(command), client.id);
+}
+
+void Server::deliver_invalidation(const Invalidation &invalidation) {
+  Message keys{"", DataType::Null};
+  if (invalidation.keys) {
+    Message::NestedVariantT elements{};
+    elements.reserve(invalidation.keys->size());
+    for (const auto &key : *invalidation.keys) {
+      elements.push_back(bulk(key));
+    }
+    keys = Message{std::move(elements), DataType::Array};
+  }
+  if (invalidation.redirect) {
+    // The client it redirects to hears about it like about a message
+    // published to __redis__:invalidate, if it is subscribed.
+    pubsub_.push(*invalidation.redirect,
+                 Message{Message::NestedVariantT{bulk("message"),
+                                                 bulk("__redis__:invalidate"),
+                                                 std::move(keys)},
+                         DataType::Push});
+    return;
+  }
+  // Queued, and written out by pubsub_'s sender thread, so a client that
+  // stops reading never holds up the writer. RESP2 clients can't tell push
+  // data from replies, so they only hear about invalidations through a
+  // redirect.
+  pubsub_.push_resp3(
+      invalidation.client,
+      Message{Message::NestedVariantT{bulk("invalidate"), std::move(keys)},
+              DataType::Push});
+}
+
+std::optional<Message> Server::serve_replica(const Command &command,
+                                             const ClientState &client,
+                                             const SocketFd replica_fd) {
+  if (config_.master_host) {
+    return Message{"ERR replicas can't have replicas of their own",
+                   DataType::SimpleError};
+  }
+  if (loading_.in_progress) {
+    return Message{"LOADING Redis is loading the dataset in memory",
+                   DataType::SimpleError};
+  }
+  // The replica asks for the stream from the byte after the last one it got
+  // (or "? -1" the first time).
+  const auto &requested_id = command.arguments[0];
+  const auto requested_offset = parse_canonical_int(command.arguments[1]);
+  std::string reply{};
+  std::uint64_t offset = 0;
+  std::optional<std::vector<Cache::SnapshotT>> snapshot{};
+  std::uint64_t replica_id = 0;
+  {
+    // Nothing may be written between taking the snapshot and picking the
+    // offset the stream resumes from.
+    std::scoped_lock lock(write_mutex_);
+    {
+      std::scoped_lock repl_lock(repl_mutex_);
+      if (backlog_ && requested_id == replication_id_ && requested_offset &&
+          *requested_offset > 0 &&
+          backlog_->contains(
+              static_cast<std::uint64_t>(*requested_offset - 1))) {
+        offset = static_cast<std::uint64_t>(*requested_offset - 1);
+        reply = "+CONTINUE " + replication_id_ + "\r\n";
+      } else {
+        if (!backlog_) {
+          backlog_ = std::make_unique<ReplicationBacklog>(
+              config_.repl_backlog_size, 0);
+        }
+        offset = backlog_->end_offset();
+        reply = "+FULLRESYNC " + replication_id_ + " " +
+                std::to_string(offset) + "\r\n";
+      }
+      replica_id = next_replica_id_++;
+      replicas_.emplace(replica_id,
+                        ReplicaInfo{get_peer_address(replica_fd),
+                                    client.listening_port, offset,
+                                    std::chrono::steady_clock::now()});
+    }
+    if (reply.starts_with("+FULLRESYNC")) {
+      snapshot = snapshot_databases(databases_);
+      // The replica starts out in database 0, whatever the stream was in.
+      repl_selected_db_.reset();
+    }
+  }
+  std::cout << (snapshot ? "Full" : "Partial") << " resync of replica "
+            << static_cast<int>(replica_fd) << " from offset " << offset
+            << std::endl;
+
+  bool connected = send_to_client(replica_fd, reply);
+  if (connected && snapshot) {
+    // The RDB file is sent like a BulkString, minus the trailing terminator.
+    std::ostringstream rdb{};
+    write_rdb(rdb, *snapshot);
+    snapshot.reset();
+    const auto data = std::move(rdb).str();
+    connected = send_to_client(replica_fd, "$" + std::to_string(data.size()) +
+                                               TERMINATOR) &&
+                send_to_client(replica_fd, data);
+  }
+  // Stream the writes to the replica as they come in, and keep track of how
+  // far it says it got.
+  std::string chunk{};
+  while (connected) {
+    {
+      std::unique_lock lock(repl_mutex_);
+      repl_condition_.wait_for(lock, REPLICA_POLL_INTERVAL, [this, offset] {
+        return backlog_->end_offset() != offset;
+      });
+      if (!backlog_->read(offset, chunk, REPLICA_MAX_CHUNK)) {
+        std::cerr << "Replica " << static_cast<int>(replica_fd)
+                  << " fell behind the replication backlog" << std::endl;
+        break;
+      }
+    }
+    if (!chunk.empty()) {
+      connected = send_to_client(replica_fd, chunk);
+      offset += chunk.size();
+      chunk.clear();
+    }
+    if (!connected ||
+        !poll_for_data(replica_fd, std::chrono::milliseconds(0))) {
+      continue;
+    }
+    std::optional<std::string> request{};
+    try {
+      request = receive_string_from_client(replica_fd);
+    } catch (const std::system_error &error) {
+      std::cerr << "Failed to read from replica: " << error.what()
+                << std::endl;
+    }
+    if (!request) {
+      break;
+    }
+    const auto ack =
+        parse_and_validate_command(message_from_string(*request));
+    if (ack && ack->verb == CommandVerb::ReplConf &&
+        tolower(ack->arguments.front()) == "ack") {
+      if (const auto acked = parse_canonical_int(ack->arguments[1]);
+          acked && *acked >= 0) {
+        std::scoped_lock lock(repl_mutex_);
+        auto &replica = replicas_.at(replica_id);
+        replica.ack_offset = static_cast<std::uint64_t>(*acked);
+        replica.ack_time = std::chrono::steady_clock::now();
+      }
+    }
+  }
+  {
+    std::scoped_lock lock(repl_mutex_);
+    replicas_.erase(replica_id);
+  }
+  std::cout << "Closing connection with replica "
+            << static_cast<int>(replica_fd) << std::endl;
+  close(static_cast<int>(replica_fd));
+  return std::nullopt;
+}
+
+void Server::propagate(const std::size_t db_index, const Command &command) {
+  std::string data{};
+  if (repl_selected_db_ != db_index) {
+    data = message_to_string(command_to_message(
+        Command{CommandVerb::Select, {std::to_string(db_index)}}));
+    repl_selected_db_ = db_index;
+  }
+  data += message_to_string(command_to_message(command));
+  {
+    std::scoped_lock lock(repl_mutex_);
+    backlog_->append(data);
+  }
+  repl_condition_.notify_all();
+}
+
+void Server::load_from_master(std::string_view rdb) {
+  // Clients are told we're loading until the master's dataset is all in.
+  loading_.start_time = std::chrono::system_clock::now();
+  loading_.total_bytes = rdb.size();
+  loading_.loaded_bytes = 0;
+  loading_.loaded_keys = 0;
+  loading_.in_progress = true;
+  {
+    std::scoped_lock lock(write_mutex_);
+    ClientState flusher{};
+    apply_command(Command{CommandVerb::FlushAll, {"ASYNC"}}, flusher);
+    std::ispanstream inputs(std::span<const char>(rdb.data(), rdb.size()));
+    read_rdb_into_databases(inputs, databases_, &loading_);
+    master_client_ = ClientState{.is_master = true};
+    // The append-only file still holds our old dataset.
+    if (aof_) {
+      aof_->wait_for_rewrite();
+      aof_->start_rewrite(snapshot_databases(databases_));
+    }
+  }
+  watched_keys_.touch_all();
+  tracking_.invalidate_all();
+  loading_.in_progress = false;
+}
+
+void Server::apply_from_master(const Command &command) {
+  // The master wraps transactions in MULTI and EXEC, and they are applied
+  // all at once like a client's.
+  if (master_client_.transaction) {
+    // No CLIENT command is ever propagated, so exec() needs no socket.
+    const auto reply = command.verb == CommandVerb::Exec
+                           ? exec(master_client_, SocketFd{-1})
+                           : queue_command(command, master_client_);
+    if (reply.get_data_type() == DataType::SimpleError) {
+      std::cerr << "Failed to apply transaction from master: "
+                << message_to_string(reply) << std::endl;
+    }
+    return;
+  }
+  const auto reply = execute_command(command, master_client_);
+  if (reply.get_data_type() == DataType::SimpleError) {
+    std::cerr << "Failed to apply command from master: "
+              << message_to_string(command_to_message(command)) << ": "
+              << message_to_string(reply) << std::endl;
+  }
+  serve_blocked_clients(command, master_client_.db_index);
+}
+
+Message Server::apply_command(const Command &command, ClientState &client) {
+  if (auto reply =
+          handle_database_command(command, databases_, client, &lazy_free_)) {
+    return std::move(*reply);
+  }
+  auto &cache = databases_[client.db_index];
+  if (auto reply = handle_command(command, config_, cache, &lazy_free_)) {
+    return std::move(*reply);
+  }
+  return generate_response_message(command, config_, cache);
+}
 
 bool Server::is_ready() const { return socket_fd_.has_value(); }
 
 void Server::cleanup_finished_client_tasks() {
+  std::scoped_lock lock(futures_mutex_);
   const auto new_end =
       std::remove_if(futures_.begin(), futures_.end(),
                      [](auto &fut) { return is_async_task_done(fut); });
@@ -120,9 +1465,26 @@ void Server::run() {
       // client connections until some clients finish. Ideally, we should only
       // wait a little bit for the front task and move on to the next ones in
       // the hope of finding a finished one.
-      if (futures_.size() >= ASYNC_MAX_LIMIT) {
-        wait_for_async_task(futures_.front());
-        futures_.pop_front();
+      // Blocked clients don't count, since their tasks are done, so clean up
+      // the finished tasks before picking one to wait for.
+      const auto num_tasks = [this] {
+        std::scoped_lock lock(futures_mutex_);
+        return futures_.size();
+      };
+      if (num_tasks() >= ASYNC_MAX_LIMIT) {
+        cleanup_finished_client_tasks();
+        last_cleanup_time = std::chrono::system_clock::now();
+      }
+      std::optional<std::future<void>> oldest{};
+      {
+        std::scoped_lock lock(futures_mutex_);
+        if (futures_.size() >= ASYNC_MAX_LIMIT) {
+          oldest = std::move(futures_.front());
+          futures_.pop_front();
+        }
+      }
+      if (oldest) {
+        wait_for_async_task(*oldest);
       }
 
       // TODO the problem here is that because the main thread blocks on
@@ -131,17 +1493,24 @@ void Server::run() {
 
       // Create a new connection and spawn off an async task to handle this
       // client.
-      // NOTE: we give the task a reference to the cache since the tasks
-      // don't own the cache; this server process does instead. The server will
-      // be alive as long as any of the tasks.
-      // NOTE: we pass off the cache using std::ref() because otherwise it would
-      // attempt to copy the cache (which is a move-only type due to the mutex).
-      // NOTE: passing the config_ is thread-safe because we never modify it,
-      // just read from it.
+      // NOTE: the tasks only hold a pointer to this server, which owns the
+      // cache and everything else they use. The server will be alive as long
+      // as any of the tasks.
+      // NOTE: reading config_ from the tasks is thread-safe because we never
+      // modify it, just read from it.
       const auto client_fd = await_client_connection(*socket_fd_);
+      if (config_.tcp_keepalive > 0) {
+        set_keepalive(client_fd,
+                      std::chrono::seconds(config_.tcp_keepalive));
+      }
+      std::scoped_lock lock(futures_mutex_);
       futures_.push_back(std::async(std::launch::async,
-                                    handle_client_connection, client_fd,
-                                    std::cref(config_), std::ref(cache_)));
+                                    &Server::handle_client_connection, this,
+                                    client_fd,
+                                    ClientState{
+                                        .id = ++num_connections_,
+                                        .address = get_peer_address_and_port(
+                                            client_fd)}));
     }
   } catch (const std::exception &server_error) {
     std::cerr << "Exception thrown while server was handling new incoming "
@@ -150,12 +1519,273 @@ void Server::run() {
   }
 }
 
+Message Server::save() {
+  // Like Redis, SAVE blocks this client until the snapshot is on disk.
+  if (save_cache(config_, databases_)) {
+    return Message{"OK", DataType::SimpleString};
+  }
+  return Message{"ERR failed to save the RDB file", DataType::SimpleError};
+}
+
+Message Server::rewrite_append_only_file() {
+  if (!aof_) {
+    return Message{"ERR the append-only file is not enabled",
+                   DataType::SimpleError};
+  }
+  // The snapshot must not miss (or double count) any write, see
+  // AppendOnlyFile::start_rewrite().
+  std::scoped_lock lock(write_mutex_);
+  if (in_transaction_ && !aof_->is_rewrite_in_progress()) {
+    rewrite_scheduled_ = true;
+    return Message{"Background append only file rewriting scheduled",
+                   DataType::SimpleString};
+  }
+  if (!aof_->start_rewrite(snapshot_databases(databases_))) {
+    return Message{
+        "ERR Background append only file rewriting already in progress",
+        DataType::SimpleError};
+  }
+  return Message{"Background append only file rewriting started",
+                 DataType::SimpleString};
+}
+
+void Server::info_command_stats(std::ostream &out, const bool commandstats,
+                                const bool latencystats) const {
+  const auto all_counts = command_stats_.merged();
+  // Like Redis, commands are named like "get" and "config|get", and only the
+  // ones that were called are listed.
+  const auto name_of = [](const CommandSpec &spec) {
+    auto name = std::string(spec.name);
+    if (!spec.subcommand.empty()) {
+      name += "|" + std::string(spec.subcommand);
+    }
+    return name;
+  };
+  const auto usec = [](const std::uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e3;
+  };
+  if (commandstats) {
+    out << "# Commandstats\r\n" << std::fixed << std::setprecision(2);
+    for (std::size_t verb = 0; verb < all_counts.size(); ++verb) {
+      const auto &counts = all_counts[verb];
+      const auto *spec = command_spec(static_cast<CommandVerb>(verb));
+      if (!spec || (counts.calls == 0 && counts.rejected == 0)) {
+        continue;
+      }
+      out << "cmdstat_" << name_of(*spec) << ":calls=" << counts.calls
+          << ",usec=" << counts.nanoseconds / 1000 << ",usec_per_call="
+          << (counts.calls == 0
+                  ? 0.0
+                  : usec(counts.nanoseconds) /
+                        static_cast<double>(counts.calls))
+          << ",rejected_calls=" << counts.rejected
+          << ",failed_calls=" << counts.failed << "\r\n";
+    }
+    out << "\r\n";
+  }
+  if (latencystats) {
+    out << "# Latencystats\r\n" << std::fixed << std::setprecision(3);
+    for (std::size_t verb = 0; verb < all_counts.size(); ++verb) {
+      const auto &latencies = all_counts[verb].latencies;
+      const auto *spec = command_spec(static_cast<CommandVerb>(verb));
+      if (!spec || latencies.count() == 0) {
+        continue;
+      }
+      out << "latency_percentiles_usec_" << name_of(*spec)
+          << ":p50=" << usec(latencies.percentile(0.5))
+          << ",p99=" << usec(latencies.percentile(0.99))
+          << ",p99.9=" << usec(latencies.percentile(0.999)) << "\r\n";
+    }
+    out << "\r\n";
+  }
+}
+
+Message Server::info(const std::vector<std::string> &sections) const {
+  const auto wants_section = [&sections](const std::string &name) {
+    if (sections.empty()) {
+      return true;
+    }
+    return std::any_of(sections.cbegin(), sections.cend(),
+                       [&name](const std::string &section) {
+                         const auto lower = tolower(section);
+                         return lower == name || lower == "all" ||
+                                lower == "everything" || lower == "default";
+                       });
+  };
+  // Like in Redis, these are left out by default.
+  const auto wants_extra_section = [&sections](const std::string &name) {
+    return std::any_of(sections.cbegin(), sections.cend(),
+                       [&name](const std::string &section) {
+                         const auto lower = tolower(section);
+                         return lower == name || lower == "all" ||
+                                lower == "everything";
+                       });
+  };
+  const auto seconds_since = [](auto time_point) {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               decltype(time_point)::clock::now() - time_point)
+        .count();
+  };
+
+  // Like Redis, each section is a "# Name" header followed by "field:value"
+  // lines, and sections are separated by an empty line.
+  std::ostringstream out{};
+  if (wants_section("server")) {
+    out << "# Server\r\n"
+        << "redis_version:" << REDIS_VERSION << "\r\n"
+        << "process_id:" << getpid() << "\r\n"
+        << "uptime_in_seconds:" << seconds_since(start_time_) << "\r\n"
+        << "\r\n";
+  }
+  if (wants_section("clients")) {
+    // Without taking blocked_mutex_, which is taken before exec_mutex_ (and
+    // INFO may run in EXEC, holding exec_mutex_).
+    out << "# Clients\r\n"
+        << "blocked_clients:" << blocked_.size() << "\r\n"
+        << "pubsub_clients:" << pubsub_.num_subscribers() << "\r\n"
+        << "tracking_clients:" << tracking_.num_clients() << "\r\n"
+        << "\r\n";
+  }
+  if (wants_section("memory")) {
+    out << "# Memory\r\n"
+        << "lazyfree_pending_objects:" << lazy_free_.pending() << "\r\n"
+        << "lazyfreed_objects:" << lazy_free_.freed() << "\r\n"
+        << "\r\n";
+  }
+  if (wants_section("persistence")) {
+    const bool loading = loading_.in_progress;
+    const std::uint64_t total_bytes = loading_.total_bytes;
+    const std::uint64_t loaded_bytes = loading_.loaded_bytes;
+    out << "# Persistence\r\n"
+        << "loading:" << loading << "\r\n"
+        << "async_loading:" << (loading && config_.async_loading) << "\r\n";
+    if (loading) {
+      const auto elapsed = seconds_since(loading_.start_time);
+      const double fraction =
+          total_bytes == 0 ? 0.0
+                           : static_cast<double>(loaded_bytes) /
+                                 static_cast<double>(total_bytes);
+      // Assume the rest of the file loads as fast as what we've seen so far.
+      const auto eta_seconds =
+          fraction == 0.0 ? 1
+                          : static_cast<std::int64_t>(
+                                static_cast<double>(elapsed) *
+                                (1.0 - fraction) / fraction);
+      out << "loading_start_time:"
+          << std::chrono::duration_cast<std::chrono::seconds>(
+                 loading_.start_time.time_since_epoch())
+                 .count()
+          << "\r\n"
+          << "loading_total_bytes:" << total_bytes << "\r\n"
+          << "loading_loaded_bytes:" << loaded_bytes << "\r\n"
+          << "loading_loaded_perc:" << std::fixed << std::setprecision(2)
+          << fraction * 100 << "\r\n"
+          << "loading_eta_seconds:" << eta_seconds << "\r\n"
+          << "loading_loaded_keys:" << loading_.loaded_keys << "\r\n";
+    }
+    // The loader thread is still setting up the append-only file until it is
+    // done loading.
+    const bool aof_enabled = !loading && aof_;
+    out << "aof_enabled:" << aof_enabled << "\r\n";
+    if (aof_enabled) {
+      out << "aof_rewrite_in_progress:" << aof_->is_rewrite_in_progress()
+          << "\r\n"
+          << "aof_current_size:" << aof_->file_size() << "\r\n";
+    }
+    out << "\r\n";
+  }
+  if (wants_section("stats")) {
+    out << "# Stats\r\n"
+        << "tracking_total_keys:" << tracking_.num_keys() << "\r\n"
+        << "tracking_total_prefixes:" << tracking_.num_prefixes() << "\r\n"
+        << "\r\n";
+  }
+  if (wants_section("replication")) {
+    info_replication(out);
+  }
+  if (wants_section("cluster")) {
+    out << "# Cluster\r\n"
+        << "cluster_enabled:" << (cluster_ ? 1 : 0) << "\r\n"
+        << "\r\n";
+  }
+  if (wants_section("keyspace")) {
+    out << "# Keyspace\r\n";
+    for (std::size_t db_index = 0; db_index < databases_.size(); ++db_index) {
+      const auto num_keys = databases_[db_index].size();
+      if (num_keys > 0) {
+        out << "db" << db_index << ":keys=" << num_keys << "\r\n";
+      }
+    }
+    out << "\r\n";
+  }
+  if (wants_extra_section("commandstats") ||
+      wants_extra_section("latencystats")) {
+    info_command_stats(out, wants_extra_section("commandstats"),
+                       wants_extra_section("latencystats"));
+  }
+  auto reply = out.str();
+  // Drop the separator after the last section.
+  if (reply.ends_with("\r\n\r\n")) {
+    reply.resize(reply.size() - 2);
+  }
+  return Message{std::move(reply), DataType::BulkString};
+}
+
+void Server::info_replication(std::ostream &out) const {
+  out << "# Replication\r\n";
+  if (master_link_) {
+    const auto status = master_link_->status();
+    out << "role:slave\r\n"
+        << "master_host:" << master_link_->host() << "\r\n"
+        << "master_port:" << master_link_->port() << "\r\n"
+        << "master_link_status:" << (status.link_up ? "up" : "down") << "\r\n"
+        << "master_sync_in_progress:" << status.sync_in_progress << "\r\n"
+        << "slave_repl_offset:" << status.offset << "\r\n"
+        << "master_replid:" << status.replication_id << "\r\n"
+        << "\r\n";
+    return;
+  }
+  std::scoped_lock lock(repl_mutex_);
+  out << "role:master\r\n"
+      << "connected_slaves:" << replicas_.size() << "\r\n";
+  const auto now = std::chrono::steady_clock::now();
+  std::size_t index = 0;
+  for (const auto &[id, replica] : replicas_) {
+    out << "slave" << index++ << ":ip=" << replica.address
+        << ",port=" << replica.listening_port
+        << ",state=online,offset=" << replica.ack_offset << ",lag="
+        << std::chrono::duration_cast<std::chrono::seconds>(now -
+                                                            replica.ack_time)
+               .count()
+        << "\r\n";
+  }
+  out << "master_replid:" << replication_id_ << "\r\n"
+      << "master_repl_offset:" << (backlog_ ? backlog_->end_offset() : 0)
+      << "\r\n"
+      << "repl_backlog_active:" << (backlog_ != nullptr) << "\r\n"
+      << "repl_backlog_size:" << config_.repl_backlog_size << "\r\n";
+  if (backlog_) {
+    // Redis counts the first byte of the stream as offset 1.
+    out << "repl_backlog_first_byte_offset:" << backlog_->start_offset() + 1
+        << "\r\n"
+        << "repl_backlog_histlen:" << backlog_->size() << "\r\n";
+  }
+  out << "\r\n";
+}
+
 Server::~Server() {
+  blocked_timer_.request_stop();
+  blocked_.wake();
+
   // If the server is shutting down, wait for all the client connection tasks to
   // finish up. This way, we ensure that the server process is alive as long as
   // all its children tasks.
-  while (futures_.size() > 0) {
+  while (true) {
     cleanup_finished_client_tasks();
+    std::scoped_lock lock(futures_mutex_);
+    if (futures_.empty()) {
+      break;
+    }
   }
 
   if (socket_fd_) {
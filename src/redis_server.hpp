@@ -1,26 +1,292 @@
 #pragma once
 
 // System includes.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 // Our library's header includes.
+#include "aof.hpp"
+#include "blocked_clients.hpp"
 #include "cache.hpp"
+#include "cluster.hpp"
+#include "command_stats.hpp"
 #include "config.hpp"
+#include "lazy_free.hpp"
 #include "network.hpp"
+#include "pubsub.hpp"
+#include "redis_core.hpp"
+#include "replication.hpp"
+#include "replication_backlog.hpp"
+#include "slow_log.hpp"
+#include "storage.hpp"
+#include "timer_wheel.hpp"
+#include "tracking.hpp"
+#include "watched_keys.hpp"
 
 class Server {
 private:
   std::optional<SocketFd> socket_fd_;
   // These futures are handles to the asynchronous tasks, each handling a client
-  // connection.
+  // connection. Guarded by futures_mutex_, since clients that get unblocked
+  // are handed a new task by whichever thread unblocked them.
   std::deque<std::future<void>> futures_;
-
-  Cache cache_;
+  std::mutex futures_mutex_;
 
   Config config_{};
 
+  // Frees deleted values and flushed databases in the background. Declared
+  // before the databases, which hold on to it.
+  LazyFree lazy_free_;
+  // The databases clients can SELECT, indexed by number. There are always
+  // config_.databases of them.
+  std::vector<Cache> databases_;
+
+  // Only set when the append-only file is enabled.
+  std::unique_ptr<AppendOnlyFile> aof_;
+  // Held across applying a write command and appending it to the AOF and the
+  // replication backlog, so they record writes in the same order they were
+  // applied to the databases.
+  std::mutex write_mutex_;
+  // Held shared by each command as it runs, and exclusively by EXEC, so no
+  // other command runs in the middle of a transaction. Taken before
+  // write_mutex_.
+  std::shared_mutex exec_mutex_;
+  // Set while EXEC runs a transaction. Its writes are persisted between a
+  // MULTI (before the first one) and an EXEC, like in Redis, so the
+  // append-only file and replicas replay them all or none. Guarded by
+  // exec_mutex_, and only EXEC (holding it exclusively) sets it.
+  bool in_transaction_ = false;
+  // The database of the transaction's last persisted write, once its MULTI
+  // was persisted. Guarded by exec_mutex_.
+  std::optional<std::size_t> transaction_db_index_;
+  // Whether BGREWRITEAOF ran in the transaction, so the rewrite starts once
+  // it's done. Guarded by exec_mutex_.
+  bool rewrite_scheduled_ = false;
+  // The keys clients WATCH, which writes mark as changed.
+  WatchedKeys watched_keys_;
+  // The calls to each command, for INFO commandstats and latencystats.
+  CommandStats command_stats_;
+  // The commands that ran slower than config_.slowlog_log_slower_than.
+  SlowLog slow_log_;
+
+  // Replication as a master. Replicas hand our ID back to resume from where
+  // they left off.
+  std::string replication_id_;
+  // The tail of the stream of writes sent to replicas, kept from the first
+  // time one connects. Created and appended to holding both write_mutex_ and
+  // repl_mutex_.
+  std::unique_ptr<ReplicationBacklog> backlog_;
+  // The database the last write in the stream ran in, if known. Guarded by
+  // write_mutex_.
+  std::optional<std::size_t> repl_selected_db_;
+  struct ReplicaInfo {
+    std::string address;
+    std::uint16_t listening_port = 0;
+    // How far into the stream the replica last said it got, and when.
+    std::uint64_t ack_offset = 0;
+    std::chrono::steady_clock::time_point ack_time{};
+  };
+  // The connected replicas, by an ID of our own. Guarded by repl_mutex_.
+  std::map<std::uint64_t, ReplicaInfo> replicas_;
+  std::uint64_t next_replica_id_ = 0;
+  mutable std::mutex repl_mutex_;
+  // Notified whenever the backlog grows.
+  std::condition_variable repl_condition_;
+
+  std::chrono::steady_clock::time_point start_time_{
+      std::chrono::steady_clock::now()};
+  // How many clients have connected, which also numbers their IDs. Only the
+  // thread accepting connections touches it.
+  std::uint64_t num_connections_ = 0;
+  LoadingProgress loading_;
+
+  // The clients waiting on BLPOP, BRPOP and XREAD BLOCK, which hold no task
+  // while they wait. Guarded by blocked_mutex_, which is held from trying a
+  // blocking command to blocking the client, and while serving blocked
+  // clients, so a client can't miss a write that would have served it. Taken
+  // before exec_mutex_, so commands (which hold exec_mutex_) must not take it.
+  BlockedClients blocked_;
+  std::mutex blocked_mutex_;
+  // How many clients are blocked or trying a blocking command. Writes only
+  // look for clients to serve when there are any. A client counts itself
+  // before trying, so a write its try misses sees it and serves it.
+  std::atomic<std::size_t> num_blocking_ = 0;
+  // Times out blocked clients and closes the ones that hang up.
+  std::jthread blocked_timer_;
+  // When to time out each client waiting for its next request, when
+  // config_.timeout is set, and its socket. Guarded by idle_mutex_.
+  TimerWheel idle_timers_;
+  std::unordered_map<std::uint64_t, SocketFd> idle_fds_;
+  std::mutex idle_mutex_;
+  // Notified when the first client starts its timeout.
+  std::condition_variable_any idle_timer_started_;
+  // Disconnects the clients that time out (only if config_.timeout is set).
+  std::jthread idle_timer_;
+  // The keys tracking clients may have cached. Declared before pubsub_,
+  // which tells it about subscribers that hang up.
+  TrackingTable tracking_;
+  // The clients in subscribed mode, which hold no task either. Clients that
+  // unsubscribe from everything are handed a new task. Clients with tracking
+  // on are attached to it, which queues their invalidation messages (up to
+  // the pubsub output buffer limit).
+  PubSub pubsub_;
+  // Tells tracking clients about the keys they read expiring.
+  std::jthread tracking_expirer_;
+  // Replication as a replica (only with --replicaof). The link's thread
+  // applies the master's writes through master_client_.
+  ClientState master_client_{.is_master = true};
+  std::unique_ptr<MasterLink> master_link_;
+  // Only set in cluster mode.
+  std::unique_ptr<ClusterState> cluster_;
+  // Loads the dataset when async loading is enabled. Declared last so it is
+  // joined before anything it uses is destroyed.
+  std::jthread loader_;
+
+  void handle_client_connection(SocketFd client_fd, ClientState client);
+  // Applies the command for the client and returns the reply for it,
+  // persisting it to the append-only file first if it is a write.
+  Message execute_command(const Command &command, ClientState &client);
+  // The error to reply with if the command can't run for the client right
+  // now (e.g. while loading, or when another cluster node serves its keys).
+  std::optional<Message> check_command(const Command &command,
+                                       ClientState &client);
+  // Does the work of execute_command() once the command was checked. Called
+  // holding exec_mutex_. Sets aof_offset to the offset in the append-only file
+  // to wait on before acknowledging the command, if it was persisted.
+  Message run_command(const Command &command, ClientState &client,
+                      std::uint64_t &aof_offset);
+  // Queues the command sent by the client in a transaction, and returns the
+  // reply for it.
+  Message queue_command(const Command &command, ClientState &client);
+  // Replies to EXEC: runs the queued commands with no other command in
+  // between, unless one of the keys the client watched has changed.
+  Message exec(ClientState &client, SocketFd client_fd);
+  // Persists the EXEC closing the transaction EXEC ran, if it wrote
+  // anything, and starts the rewrite put off until then (if any). Called
+  // holding exec_mutex_ exclusively. Returns the offset in the append-only
+  // file to wait on, or 0 if nothing was appended.
+  std::uint64_t end_transaction();
+  // Records the call to the command that started running at start and
+  // replied with the reply, and logs it in the slow log if it was slow.
+  void record_command(const Command &command, const ClientState &client,
+                      CommandStats::Clock::time_point start,
+                      const Message &reply);
+  // Replies to SLOWLOG.
+  Message slowlog(const Command &command);
+  // Replies to WATCH.
+  Message watch(const Command &command, ClientState &client);
+  // Forgets the keys the client watched, if any.
+  void unwatch(ClientState &client);
+  // Marks the clients watching the keys the write changed.
+  void touch_watched_keys(const Command &command, const ClientState &client);
+  // Forgets the client that hung up.
+  void forget_client(const ClientState &client);
+  // Like execute_command(), except that if a blocking command has nothing to
+  // reply with yet, it blocks the client and returns nullopt. The client's
+  // socket then belongs to blocked_ until it is served or times out, and
+  // another task takes over the client after that.
+  std::optional<Message> execute_blocking_command(const Command &command,
+                                                  ClientState &client,
+                                                  SocketFd client_fd);
+  // Retries the commands of the clients blocked on the key the command wrote
+  // to in the database (if it may have made it ready), and unblocks the ones
+  // that go through.
+  void serve_blocked_clients(const Command &command, std::size_t db_index);
+  // Sends the reply to the client that is no longer blocked, and hands the
+  // client to a new task.
+  void resume_client(BlockedClient client, const Message &reply);
+  // What the blocked_timer_ thread runs.
+  void run_blocked_timer(const std::stop_token &stop);
+  // Starts the client's timeout over, as it waits for its next request.
+  void start_idle_timer(const ClientState &client, SocketFd client_fd);
+  // Stops timing the client out, e.g. once it's blocked or gone. Its socket
+  // may only be closed after this.
+  void stop_idle_timer(const ClientState &client);
+  // What the idle_timer_ thread runs: shuts down the sockets of the clients
+  // that time out, so their tasks see them hang up and close them.
+  void run_idle_timer(const std::stop_token &stop);
+  // Sends the serialized reply to the client, after the invalidation
+  // messages queued for it if it has tracking on.
+  void send_reply(SocketFd client_fd, const ClientState &client,
+                  const std::string &reply);
+  // Replies to CLIENT. Turning tracking on registers the connection.
+  Message client_command(const Command &command, ClientState &client,
+                         SocketFd client_fd);
+  // Turns tracking off for the client, if it was on.
+  void stop_tracking(const ClientState &client);
+  // Records the keys the command reads for the client, if it tracks them.
+  void track_keys(const Command &command, const ClientState &client);
+  // Tells tracking clients about the keys the write changed.
+  void invalidate_keys(const Command &command, const ClientState &client);
+  // What tracking_ calls to send a client an invalidation message.
+  void deliver_invalidation(const Invalidation &invalidation);
+  // Replies to REPLCONF.
+  static Message replconf(const Command &command, ClientState &client);
+  // Replies to HELLO: switches the client to the protocol it asks for.
+  Message hello(const Command &command, ClientState &client);
+  // Takes over the connection of a replica that sent PSYNC: brings it up to
+  // date (with a full resync if it can't pick up where it left off) and
+  // streams writes to it until it disconnects, then closes the connection.
+  // Returns the error reply instead if we can't serve replicas right now.
+  std::optional<Message> serve_replica(const Command &command,
+                                       const ClientState &client,
+                                       SocketFd replica_fd);
+  // Appends the write, which ran in the database, to the append-only file
+  // and the replication stream (whichever there are), as it is to be
+  // replayed. Called holding write_mutex_. Returns the offset in the
+  // append-only file to wait on before acknowledging the write.
+  std::uint64_t persist(std::size_t db_index, const Command &command);
+  // Appends the command to the append-only file and the replication stream,
+  // as persist() does. Called holding write_mutex_.
+  std::uint64_t append_write(std::size_t db_index, const Command &command);
+  // Appends the write, which ran in the database, to the replication stream.
+  // Called holding write_mutex_.
+  void propagate(std::size_t db_index, const Command &command);
+  // In cluster mode, the error sending the client to the node that serves
+  // the command's keys (or saying it can't be served), if it can't run here.
+  std::optional<Message> cluster_redirect(const Command &command,
+                                          bool asking) const;
+  // Replies to MIGRATE: moves (or copies) keys to another server with
+  // RESTORE, and deletes them here once it has them. Writes wait for the
+  // whole transfer.
+  Message migrate(const Command &command, const ClientState &client);
+  // What master_link_ calls, to replace the dataset with the master's and to
+  // apply its writes.
+  void load_from_master(std::string_view rdb);
+  void apply_from_master(const Command &command);
+  // Applies the command to the databases without persisting it.
+  Message apply_command(const Command &command, ClientState &client);
+  // Loads the databases from disk and opens the append-only file (if enabled).
+  // Returns false if the append-only file could not be opened.
+  bool load_dataset();
+  bool open_append_only_file();
+  // Replies to SAVE.
+  Message save();
+  // Replies to BGREWRITEAOF.
+  Message rewrite_append_only_file();
+  // Replies to INFO with the requested sections (all of them by default,
+  // except commandstats and latencystats).
+  Message info(const std::vector<std::string> &sections) const;
+  // Writes the "# Replication" section of INFO.
+  void info_replication(std::ostream &out) const;
+  // Writes the "# Commandstats" and/or "# Latencystats" sections of INFO.
+  void info_command_stats(std::ostream &out, bool commandstats,
+                          bool latencystats) const;
+
 public:
   explicit Server(Config config);
   Server(const Server &other) = delete;
@@ -0,0 +1,259 @@
+// This source file's own header include.
+#include "replication.hpp"
+
+// System includes.
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+// Our library's header includes.
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+// How long to wait before reconnecting to the master.
+constexpr auto RECONNECT_INTERVAL = 1s;
+// How often to tell the master how far we got, even if it doesn't ask.
+constexpr auto ACK_INTERVAL = 1s;
+// How long a read waits before checking whether it should stop.
+constexpr auto POLL_INTERVAL = 100ms;
+
+// Buffers what the master sends, so it can be taken a line, a number of bytes
+// or a command at a time.
+class StreamReader {
+public:
+  StreamReader(SocketFd fd, std::stop_token stop)
+      : fd_(fd), stop_(std::move(stop)) {}
+
+  // Waits a little for more data. Returns false once the link drops or we're
+  // asked to stop.
+  bool fill() {
+    if (stop_.stop_requested()) {
+      return false;
+    }
+    if (!poll_for_data(fd_, POLL_INTERVAL)) {
+      return !stop_.stop_requested();
+    }
+    // Drop what was already taken before reading more.
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+    constexpr std::size_t READ_SIZE = 64UL * 1024;
+    const auto size = buffer_.size();
+    buffer_.resize(size + READ_SIZE);
+    const auto received =
+        recv(static_cast<int>(fd_), buffer_.data() + size, READ_SIZE, 0);
+    buffer_.resize(size + static_cast<std::size_t>(std::max(received, 0L)));
+    return received > 0;
+  }
+
+  // The next line, without its terminator.
+  std::optional<std::string> read_line() {
+    while (true) {
+      const auto end = buffer_.find(TERMINATOR, pos_);
+      if (end != std::string::npos) {
+        auto line = buffer_.substr(pos_, end - pos_);
+        pos_ = end + 2;
+        return line;
+      }
+      if (!fill()) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  std::optional<std::string> read_bytes(std::size_t count) {
+    while (buffer_.size() - pos_ < count) {
+      if (!fill()) {
+        return std::nullopt;
+      }
+    }
+    auto bytes = buffer_.substr(pos_, count);
+    pos_ += count;
+    return bytes;
+  }
+
+  // The next command, if all of it has arrived, along with its length.
+  std::optional<std::pair<Message, std::size_t>> next_command() {
+    const auto start = pos_;
+    auto message = parse_command_array(buffer_, pos_);
+    if (!message) {
+      return std::nullopt;
+    }
+    return std::pair{std::move(*message), pos_ - start};
+  }
+
+private:
+  SocketFd fd_;
+  std::stop_token stop_;
+  std::string buffer_{};
+  std::size_t pos_ = 0;
+};
+
+std::string serialize(const Command &command) {
+  return message_to_string(command_to_message(command));
+}
+
+} // namespace
+
+MasterLink::MasterLink(std::string host, std::uint16_t port,
+                       std::uint16_t listening_port,
+                       LoadSnapshot load_snapshot, ApplyCommand apply_command)
+    : host_(std::move(host)), port_(port), listening_port_(listening_port),
+      load_snapshot_(std::move(load_snapshot)),
+      apply_command_(std::move(apply_command)) {}
+
+void MasterLink::start() {
+  thread_ = std::jthread([this](const std::stop_token &stop) { run(stop); });
+}
+
+MasterLink::Status MasterLink::status() const {
+  std::scoped_lock lock(mutex_);
+  return status_;
+}
+
+void MasterLink::set_status(const std::function<void(Status &)> &update) {
+  std::scoped_lock lock(mutex_);
+  update(status_);
+}
+
+void MasterLink::run(const std::stop_token &stop) {
+  while (!stop.stop_requested()) {
+    std::cout << "Connecting to master " << host_ << ":" << port_
+              << std::endl;
+    if (const auto master_fd = connect_to_server(host_, port_)) {
+      follow(*master_fd, stop);
+      close(static_cast<int>(*master_fd));
+      set_status([](Status &status) {
+        status.link_up = false;
+        status.sync_in_progress = false;
+      });
+      std::cout << "Lost the link to master " << host_ << ":" << port_
+                << std::endl;
+    }
+    std::unique_lock lock(mutex_);
+    condition_.wait_for(lock, stop, RECONNECT_INTERVAL, [] { return false; });
+  }
+}
+
+void MasterLink::follow(const SocketFd master_fd, const std::stop_token &stop) {
+  StreamReader reader{master_fd, stop};
+  // Sends the command and returns the first line of the reply.
+  const auto request =
+      [&](const Command &command) -> std::optional<std::string> {
+    if (!send_to_client(master_fd, serialize(command))) {
+      return std::nullopt;
+    }
+    return reader.read_line();
+  };
+  const auto is_ok = [](const std::optional<std::string> &reply) {
+    return reply && reply->starts_with('+');
+  };
+  if (!is_ok(request(Command{CommandVerb::Ping, {}})) ||
+      !is_ok(request(Command{
+          CommandVerb::ReplConf,
+          {"listening-port", std::to_string(listening_port_)}})) ||
+      !is_ok(request(Command{CommandVerb::ReplConf, {"capa", "psync2"}}))) {
+    std::cerr << "Handshake with master failed" << std::endl;
+    return;
+  }
+
+  // Ask to resume right after the last byte we got, if we got any.
+  auto [link_up, sync_in_progress, replication_id, offset] = status();
+  const auto reply = request(Command{
+      CommandVerb::PSync,
+      {replication_id, offset < 0 ? "-1" : std::to_string(offset + 1)}});
+  if (!reply) {
+    return;
+  }
+  std::istringstream fields(*reply);
+  std::string resync{};
+  std::string new_replication_id{};
+  std::string new_offset{};
+  fields >> resync >> new_replication_id >> new_offset;
+  if (resync == "+FULLRESYNC") {
+    const auto start_offset = parse_canonical_int(new_offset);
+    if (!start_offset || *start_offset < 0) {
+      std::cerr << "Bad FULLRESYNC from master: " << *reply << std::endl;
+      return;
+    }
+    set_status([](Status &status) { status.sync_in_progress = true; });
+    // The RDB file is sent like a BulkString, minus the trailing terminator.
+    const auto length_line = reader.read_line();
+    const auto length =
+        length_line && length_line->starts_with('$')
+            ? parse_canonical_int(std::string_view(*length_line).substr(1))
+            : std::nullopt;
+    if (!length || *length < 0) {
+      return;
+    }
+    const auto rdb = reader.read_bytes(static_cast<std::size_t>(*length));
+    if (!rdb) {
+      return;
+    }
+    load_snapshot_(*rdb);
+    replication_id = new_replication_id;
+    offset = *start_offset;
+    std::cout << "Synced " << *length << " bytes from master" << std::endl;
+  } else if (resync == "+CONTINUE") {
+    // The master may go by a new ID from now on.
+    if (!new_replication_id.empty()) {
+      replication_id = new_replication_id;
+    }
+    std::cout << "Resuming from master at offset " << offset << std::endl;
+  } else {
+    std::cerr << "Master refused to sync: " << *reply << std::endl;
+    return;
+  }
+  set_status([&replication_id, offset](Status &status) {
+    status = Status{true, false, replication_id, offset};
+  });
+
+  const auto send_ack = [master_fd](std::int64_t acked) {
+    return send_to_client(
+        master_fd,
+        serialize(Command{CommandVerb::ReplConf,
+                          {"ACK", std::to_string(acked)}}));
+  };
+  auto last_ack = std::chrono::steady_clock::now();
+  while (true) {
+    const auto offset_before = offset;
+    while (auto next = reader.next_command()) {
+      const auto &[message, length] = *next;
+      const auto command = parse_and_validate_command(message);
+      if (!command) {
+        std::cerr << "Skipping unknown command from master: "
+                  << message_to_string(message) << std::endl;
+      } else if (command->verb == CommandVerb::ReplConf &&
+                 tolower(command->arguments.front()) == "getack") {
+        // The ACK covers everything before the GETACK itself.
+        if (!send_ack(offset)) {
+          return;
+        }
+      } else {
+        apply_command_(*command);
+      }
+      offset += static_cast<std::int64_t>(length);
+    }
+    if (offset != offset_before) {
+      set_status([offset](Status &status) { status.offset = offset; });
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_ack >= ACK_INTERVAL) {
+      if (!send_ack(offset)) {
+        return;
+      }
+      last_ack = now;
+    }
+    if (!reader.fill()) {
+      return;
+    }
+  }
+}
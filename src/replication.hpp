@@ -0,0 +1,74 @@
+#pragma once
+
+// System includes.
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Our library's header includes.
+#include "network.hpp"
+#include "protocol.hpp"
+
+// A replica's link to its master. It connects, asks for the writes since the
+// offset the replica got to (or for the whole dataset, the first time or if
+// the master no longer has them), and then applies the writes the master
+// streams to it, reconnecting and resuming whenever the link drops. See
+// https://redis.io/docs/latest/operate/oss_and_stack/management/replication/
+class MasterLink {
+public:
+  // Replaces the whole dataset with the RDB file the master sent.
+  using LoadSnapshot = std::function<void(std::string_view rdb)>;
+  // Applies one command from the master's replication stream.
+  using ApplyCommand = std::function<void(const Command &command)>;
+
+  struct Status {
+    bool link_up = false;
+    bool sync_in_progress = false;
+    // The master's replication ID and how far into its stream we are, or
+    // "?" and -1 before the first sync.
+    std::string replication_id = "?";
+    std::int64_t offset = -1;
+  };
+
+  MasterLink(std::string host, std::uint16_t port,
+             std::uint16_t listening_port, LoadSnapshot load_snapshot,
+             ApplyCommand apply_command);
+  MasterLink(const MasterLink &other) = delete;
+  MasterLink &operator=(const MasterLink &other) = delete;
+  MasterLink(MasterLink &&other) = delete;
+  MasterLink &operator=(MasterLink &&other) = delete;
+  ~MasterLink() = default;
+
+  // Starts a thread running the link, which is the only one to call the
+  // handlers.
+  void start();
+
+  [[nodiscard]] Status status() const;
+  [[nodiscard]] const std::string &host() const { return host_; }
+  [[nodiscard]] std::uint16_t port() const { return port_; }
+
+private:
+  std::string host_;
+  std::uint16_t port_;
+  std::uint16_t listening_port_;
+  LoadSnapshot load_snapshot_;
+  ApplyCommand apply_command_;
+
+  // Guards status_, and lets the thread sleep between reconnects until it is
+  // asked to stop.
+  mutable std::mutex mutex_;
+  std::condition_variable_any condition_;
+  Status status_{};
+  // Declared last, so it stops before anything it uses is destroyed.
+  std::jthread thread_;
+
+  void run(const std::stop_token &stop);
+  // Syncs with the master over the connection and then follows its stream
+  // until the link drops or we are asked to stop.
+  void follow(SocketFd master_fd, const std::stop_token &stop);
+  void set_status(const std::function<void(Status &)> &update);
+};
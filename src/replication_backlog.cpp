@@ -0,0 +1,45 @@
+// This source file's own header include.
+#include "replication_backlog.hpp"
+
+// System includes.
+#include <algorithm>
+
+ReplicationBacklog::ReplicationBacklog(std::size_t capacity,
+                                       std::uint64_t offset)
+    : buffer_(capacity, '\0'), end_offset_(offset) {}
+
+void ReplicationBacklog::append(std::string_view data) {
+  end_offset_ += data.size();
+  if (buffer_.empty()) {
+    return;
+  }
+  // Only the last capacity() bytes would survive anyway.
+  if (data.size() > buffer_.size()) {
+    data.remove_prefix(data.size() - buffer_.size());
+  }
+  // Where the data starts in the ring, and how much of it fits before the
+  // ring wraps around.
+  const auto begin = (end_offset_ - data.size()) % buffer_.size();
+  const auto first_part = std::min(data.size(), buffer_.size() - begin);
+  std::copy_n(data.data(), first_part, buffer_.begin() + begin);
+  std::copy_n(data.data() + first_part, data.size() - first_part,
+              buffer_.begin());
+  size_ = std::min(size_ + data.size(), buffer_.size());
+}
+
+bool ReplicationBacklog::read(std::uint64_t offset, std::string &out,
+                              std::size_t max_bytes) const {
+  if (!contains(offset)) {
+    return false;
+  }
+  const auto length = static_cast<std::size_t>(
+      std::min<std::uint64_t>(end_offset_ - offset, max_bytes));
+  if (length == 0) {
+    return true;
+  }
+  const auto begin = offset % buffer_.size();
+  const auto first_part = std::min(length, buffer_.size() - begin);
+  out.append(buffer_, begin, first_part);
+  out.append(buffer_, 0, length - first_part);
+  return true;
+}
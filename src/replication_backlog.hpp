@@ -0,0 +1,48 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+// The tail of a master's replication stream, kept in a fixed-size ring buffer
+// so a replica that disconnects for a little while can pick up where it left
+// off (a partial resync) instead of being sent the whole dataset again. Once
+// the buffer is full, each append overwrites the oldest bytes. Offsets count
+// the bytes of the stream since it started, like Redis's master_repl_offset.
+// See https://redis.io/docs/latest/operate/oss_and_stack/management/replication/
+class ReplicationBacklog {
+public:
+  // Starts empty, as if the stream had already reached the given offset.
+  ReplicationBacklog(std::size_t capacity, std::uint64_t offset);
+
+  void append(std::string_view data);
+
+  // The offset right after the last byte appended.
+  [[nodiscard]] std::uint64_t end_offset() const { return end_offset_; }
+  // The offset of the oldest byte still held.
+  [[nodiscard]] std::uint64_t start_offset() const {
+    return end_offset_ - size_;
+  }
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] std::size_t capacity() const { return buffer_.size(); }
+
+  // Whether a replica that has the stream up to the offset can catch up from
+  // here, i.e. every byte after it is still held.
+  [[nodiscard]] bool contains(std::uint64_t offset) const {
+    return offset >= start_offset() && offset <= end_offset_;
+  }
+
+  // Appends the bytes from the offset on (at most max_bytes of them) to out.
+  // Returns false, leaving out alone, if they are not all held anymore.
+  bool read(std::uint64_t offset, std::string &out,
+            std::size_t max_bytes = std::numeric_limits<std::size_t>::max())
+      const;
+
+private:
+  std::string buffer_;
+  std::uint64_t end_offset_;
+  std::size_t size_ = 0;
+};
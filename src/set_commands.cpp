@@ -0,0 +1,421 @@
+// This source file's own header include.
+#include "set_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+using SetTable = std::unordered_set<std::string>;
+
+constexpr auto NUMKEYS_NOT_POSITIVE_ERROR =
+    "ERR numkeys should be greater than 0";
+constexpr auto TOO_MANY_KEYS_ERROR =
+    "ERR Number of keys can't be greater than number of args";
+constexpr auto NEGATIVE_LIMIT_ERROR = "ERR LIMIT can't be negative";
+constexpr auto SYNTAX_ERROR = "ERR syntax error";
+
+std::size_t set_size(const SetValue &set) {
+  return std::visit([](const auto &members) { return members.size(); }, set);
+}
+
+bool set_contains(const SetValue &set, const std::string &member) {
+  if (const auto *intset = std::get_if<IntSet>(&set)) {
+    const auto value = parse_canonical_int(member);
+    return value && intset->contains(*value);
+  }
+  if (const auto *listpack = std::get_if<Listpack>(&set)) {
+    return listpack->find(member).has_value();
+  }
+  return std::get<SetTable>(set).contains(member);
+}
+
+// Calls func(member) on every member of the set.
+template <typename Func> void set_for_each(const SetValue &set, Func &&func) {
+  std::visit(ValueVisitor{
+                 [&func](const IntSet &intset) {
+                   intset.for_each([&func](std::int64_t value) {
+                     func(std::to_string(value));
+                   });
+                 },
+                 [&func](const Listpack &listpack) {
+                   listpack.for_each([&func](const Listpack::Element &elem) {
+                     func(Listpack::to_string(elem));
+                   });
+                 },
+                 [&func](const SetTable &table) {
+                   for (const auto &member : table) {
+                     func(member);
+                   }
+                 },
+             },
+             set);
+}
+
+void convert_to_table(SetValue &set) {
+  SetTable table{};
+  table.reserve(set_size(set));
+  set_for_each(set, [&table](const std::string &member) {
+    table.insert(member);
+  });
+  set = std::move(table);
+}
+
+// Turns an intset into a listpack if it and the new member fit in one, and
+// into a table otherwise.
+void convert_from_intset(SetValue &set, const std::string &member,
+                         const Config &config) {
+  const auto &intset = std::get<IntSet>(set);
+  bool fits = intset.size() < config.set_max_listpack_entries &&
+              member.size() <= config.set_max_listpack_value;
+  intset.for_each([&](std::int64_t value) {
+    fits = fits &&
+           std::to_string(value).size() <= config.set_max_listpack_value;
+  });
+  if (!fits) {
+    convert_to_table(set);
+    return;
+  }
+  Listpack listpack{};
+  intset.for_each([&listpack](std::int64_t value) {
+    listpack.push_back(value);
+  });
+  set = std::move(listpack);
+}
+
+// Adds the member, converting the set to a roomier encoding first if it
+// would outgrow its current one. Returns true if the member is new.
+bool set_add(SetValue &set, const std::string &member, const Config &config) {
+  if (auto *intset = std::get_if<IntSet>(&set)) {
+    const auto value = parse_canonical_int(member);
+    if (value && intset->size() < config.set_max_intset_entries) {
+      return intset->insert(*value);
+    }
+    if (value && intset->contains(*value)) {
+      return false;
+    }
+    if (value) {
+      convert_to_table(set);
+    } else {
+      convert_from_intset(set, member, config);
+    }
+  }
+  if (auto *listpack = std::get_if<Listpack>(&set)) {
+    if (listpack->find(member)) {
+      return false;
+    }
+    if (member.size() <= config.set_max_listpack_value &&
+        listpack->size() < config.set_max_listpack_entries) {
+      listpack->push_back(member);
+      return true;
+    }
+    convert_to_table(set);
+  }
+  return std::get<SetTable>(set).insert(member).second;
+}
+
+bool set_remove(SetValue &set, const std::string &member) {
+  if (auto *intset = std::get_if<IntSet>(&set)) {
+    const auto value = parse_canonical_int(member);
+    return value && intset->erase(*value);
+  }
+  if (auto *listpack = std::get_if<Listpack>(&set)) {
+    const auto index = listpack->find(member);
+    if (index) {
+      listpack->erase(*index, 1);
+    }
+    return index.has_value();
+  }
+  return std::get<SetTable>(set).erase(member) > 0;
+}
+
+// The members in every one of the sets, stopping after limit of them (if
+// given). All the intsets are intersected first with a sorted merge, then
+// the smallest of what's left is checked against the others.
+std::vector<std::string> intersect(std::vector<const SetValue *> sets,
+                                   std::optional<std::size_t> limit) {
+  std::ranges::sort(sets, {}, [](const SetValue *set) {
+    return set_size(*set);
+  });
+  const IntSet *intsets = nullptr;
+  std::optional<IntSet> merged{};
+  std::vector<const SetValue *> others{};
+  for (const auto *set : sets) {
+    const auto *intset = std::get_if<IntSet>(set);
+    if (intset == nullptr) {
+      others.push_back(set);
+    } else if (intsets == nullptr) {
+      intsets = intset;
+    } else {
+      merged = IntSet::intersect(*intsets, *intset);
+      intsets = &*merged;
+    }
+  }
+
+  std::vector<std::string> members{};
+  const auto add_if_in_all = [&](std::span<const SetValue *const> rest,
+                                 const std::string &member) {
+    if ((!limit || members.size() < *limit) &&
+        std::ranges::all_of(rest, [&member](const SetValue *set) {
+          return set_contains(*set, member);
+        })) {
+      members.push_back(member);
+    }
+  };
+  if (intsets != nullptr) {
+    intsets->for_each([&](std::int64_t value) {
+      add_if_in_all(others, std::to_string(value));
+    });
+  } else {
+    set_for_each(*others.front(), [&](const std::string &member) {
+      add_if_in_all(std::span(others).subspan(1), member);
+    });
+  }
+  return members;
+}
+
+// A reply with the members, which RESP3 clients get as a set.
+Message set_of(const std::vector<std::string> &members) {
+  Message::NestedVariantT elements{};
+  elements.reserve(members.size());
+  for (const auto &member : members) {
+    elements.emplace_back(member, DataType::BulkString);
+  }
+  return Message{std::move(elements), DataType::Set};
+}
+
+// Calls func(set) with the set stored at the key (creating an empty one if
+// the key is missing), removing the key if func leaves the set empty.
+template <typename Func>
+Message update_set(Cache &cache, const std::string &key, Func &&func) {
+  return cache.update(key, [&func](std::optional<Value> &value) {
+    if (!value) {
+      value = SetValue{IntSet{}};
+    }
+    auto *set = std::get_if<SetValue>(&*value);
+    if (set == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    auto reply = func(*set);
+    if (set_size(*set) == 0) {
+      value.reset();
+    }
+    return reply;
+  });
+}
+
+// Calls func(set) with the set stored at the key, or replies with
+// missing_reply if there is none.
+template <typename Func>
+Message read_set(const Cache &cache, const std::string &key,
+                 const Message &missing_reply, Func &&func) {
+  return cache.read(key, [&](const Value *value) {
+    if (value == nullptr) {
+      return missing_reply;
+    }
+    const auto *set = std::get_if<SetValue>(value);
+    if (set == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return func(*set);
+  });
+}
+
+// Calls func(sets) with the sets stored at the keys, where missing keys are
+// nullptr.
+template <typename Func>
+Message read_sets(const Cache &cache, std::span<const std::string> keys,
+                  Func &&func) {
+  return cache.read_many(
+      keys, [&func](const std::vector<const Value *> &values) {
+        std::vector<const SetValue *> sets{};
+        sets.reserve(values.size());
+        for (const auto *value : values) {
+          if (value == nullptr) {
+            sets.push_back(nullptr);
+            continue;
+          }
+          const auto *set = std::get_if<SetValue>(value);
+          if (set == nullptr) {
+            return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+          }
+          sets.push_back(set);
+        }
+        return func(std::move(sets));
+      });
+}
+
+Message add(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  return update_set(cache, args.front(), [&](SetValue &set) {
+    std::size_t num_added = 0;
+    for (auto member = args.cbegin() + 1; member != args.cend(); ++member) {
+      num_added += set_add(set, *member, config) ? 1 : 0;
+    }
+    return Message{std::to_string(num_added), DataType::Integer};
+  });
+}
+
+Message remove_members(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  return update_set(cache, args.front(), [&args](SetValue &set) {
+    std::size_t num_removed = 0;
+    for (auto member = args.cbegin() + 1; member != args.cend(); ++member) {
+      num_removed += set_remove(set, *member) ? 1 : 0;
+    }
+    return Message{std::to_string(num_removed), DataType::Integer};
+  });
+}
+
+Message is_member(const Command &command, const Cache &cache) {
+  return read_set(cache, command.arguments.front(),
+                  Message{"0", DataType::Integer},
+                  [&command](const SetValue &set) {
+                    return Message{
+                        set_contains(set, command.arguments[1]) ? "1" : "0",
+                        DataType::Integer};
+                  });
+}
+
+Message members(const Command &command, const Cache &cache) {
+  return read_set(cache, command.arguments.front(), set_of({}),
+                  [](const SetValue &set) {
+                    std::vector<std::string> members{};
+                    members.reserve(set_size(set));
+                    set_for_each(set, [&members](const std::string &member) {
+                      members.push_back(member);
+                    });
+                    return set_of(members);
+                  });
+}
+
+Message cardinality(const Command &command, const Cache &cache) {
+  return read_set(cache, command.arguments.front(),
+                  Message{"0", DataType::Integer}, [](const SetValue &set) {
+                    return Message{std::to_string(set_size(set)),
+                                   DataType::Integer};
+                  });
+}
+
+Message inter(const Command &command, const Cache &cache) {
+  return read_sets(cache, command.arguments,
+                   [](std::vector<const SetValue *> sets) {
+                     if (std::ranges::find(sets, nullptr) != sets.end()) {
+                       return set_of({});
+                     }
+                     return set_of(intersect(std::move(sets), std::nullopt));
+                   });
+}
+
+// SINTERCARD numkeys key [key ...] [LIMIT limit]
+Message inter_card(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  const auto num_keys = parse_canonical_int(args.front());
+  if (!num_keys) {
+    return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+  }
+  if (*num_keys <= 0) {
+    return Message{NUMKEYS_NOT_POSITIVE_ERROR, DataType::SimpleError};
+  }
+  if (static_cast<std::uint64_t>(*num_keys) > args.size() - 1) {
+    return Message{TOO_MANY_KEYS_ERROR, DataType::SimpleError};
+  }
+  const auto keys_end = static_cast<std::size_t>(*num_keys) + 1;
+  std::optional<std::size_t> limit{};
+  if (keys_end != args.size()) {
+    if (keys_end + 2 != args.size() || tolower(args[keys_end]) != "limit") {
+      return Message{SYNTAX_ERROR, DataType::SimpleError};
+    }
+    const auto parsed = parse_canonical_int(args[keys_end + 1]);
+    if (!parsed) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    if (*parsed < 0) {
+      return Message{NEGATIVE_LIMIT_ERROR, DataType::SimpleError};
+    }
+    // A limit of 0 means no limit.
+    if (*parsed > 0) {
+      limit = static_cast<std::size_t>(*parsed);
+    }
+  }
+  return read_sets(
+      cache, std::span(args).subspan(1, keys_end - 1),
+      [&limit](std::vector<const SetValue *> sets) {
+        if (std::ranges::find(sets, nullptr) != sets.end()) {
+          return Message{"0", DataType::Integer};
+        }
+        return Message{std::to_string(intersect(std::move(sets), limit).size()),
+                       DataType::Integer};
+      });
+}
+
+Message union_or_diff(const Command &command, const Cache &cache) {
+  const bool is_union = command.verb == CommandVerb::SUnion;
+  return read_sets(
+      cache, command.arguments, [is_union](std::vector<const SetValue *> sets) {
+        std::vector<std::string> result{};
+        if (is_union) {
+          SetTable seen{};
+          for (const auto *set : sets) {
+            if (set != nullptr) {
+              set_for_each(*set, [&](const std::string &member) {
+                if (seen.insert(member).second) {
+                  result.push_back(member);
+                }
+              });
+            }
+          }
+        } else if (sets.front() != nullptr) {
+          // The members of the first set that are in none of the others.
+          set_for_each(*sets.front(), [&](const std::string &member) {
+            if (std::none_of(sets.begin() + 1, sets.end(),
+                             [&member](const SetValue *set) {
+                               return set != nullptr &&
+                                      set_contains(*set, member);
+                             })) {
+              result.push_back(member);
+            }
+          });
+        }
+        return set_of(result);
+      });
+}
+
+} // namespace
+
+std::optional<Message> handle_set_command(const Command &command,
+                                          const Config &config, Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::SAdd:
+    return add(command, config, cache);
+  case CommandVerb::SRem:
+    return remove_members(command, cache);
+  case CommandVerb::SIsMember:
+    return is_member(command, cache);
+  case CommandVerb::SMembers:
+    return members(command, cache);
+  case CommandVerb::SCard:
+    return cardinality(command, cache);
+  case CommandVerb::SInter:
+    return inter(command, cache);
+  case CommandVerb::SInterCard:
+    return inter_card(command, cache);
+  case CommandVerb::SUnion:
+  case CommandVerb::SDiff:
+    return union_or_diff(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
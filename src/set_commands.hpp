@@ -0,0 +1,18 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the set commands (SADD, SREM, SISMEMBER, SMEMBERS, SCARD, SINTER,
+// SUNION, SDIFF and SINTERCARD) and returns the reply, or nullopt for any
+// other command. Sets of integers stay intsets until they outgrow
+// config.set_max_intset_entries, and other sets stay listpacks until they
+// outgrow config.set_max_listpack_entries or config.set_max_listpack_value.
+std::optional<Message> handle_set_command(const Command &command,
+                                          const Config &config, Cache &cache);
@@ -0,0 +1,308 @@
+// This source file's own header include.
+#include "skiplist.hpp"
+
+// System includes.
+#include <array>
+#include <new>
+#include <random>
+
+namespace {
+
+// The chance of a node having each next level, like Redis's ZSKIPLIST_P.
+constexpr double LEVEL_PROBABILITY = 0.25;
+
+// Whether the node sorts before (score, member).
+bool sorts_before(const SkipList::Node *node, double score,
+                  std::string_view member) {
+  return node->score() < score ||
+         (node->score() == score && node->member() < member);
+}
+
+} // namespace
+
+SkipList::SkipList() : head_(create_node(MAX_LEVEL, 0, {})) {}
+
+SkipList::SkipList(const SkipList &other) : SkipList() {
+  for (const auto *node = other.first(); node != nullptr; node = node->next()) {
+    insert(node->score(), node->member());
+  }
+}
+
+SkipList &SkipList::operator=(const SkipList &other) {
+  if (this != &other) {
+    SkipList copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+SkipList::SkipList(SkipList &&other) noexcept
+    : head_(std::exchange(other.head_, nullptr)),
+      tail_(std::exchange(other.tail_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      level_(std::exchange(other.level_, 1)) {}
+
+SkipList &SkipList::operator=(SkipList &&other) noexcept {
+  // Whatever we held gets freed along with other.
+  std::swap(head_, other.head_);
+  std::swap(tail_, other.tail_);
+  std::swap(size_, other.size_);
+  std::swap(level_, other.level_);
+  return *this;
+}
+
+SkipList::~SkipList() {
+  if (head_ != nullptr) {
+    clear();
+    destroy_node(head_);
+  }
+}
+
+const SkipList::Node *SkipList::insert(double score, std::string member) {
+  auto *node = create_node(random_level(), score, std::move(member));
+  link(node);
+  ++size_;
+  return node;
+}
+
+bool SkipList::erase(double score, std::string_view member) {
+  std::array<Node *, MAX_LEVEL> update{};
+  find_predecessors(score, member, update.data());
+  auto *node = update[0]->levels()[0].forward;
+  if (node == nullptr || node->score_ != score || node->member_ != member) {
+    return false;
+  }
+  unlink(node, update.data());
+  destroy_node(node);
+  --size_;
+  return true;
+}
+
+const SkipList::Node *SkipList::update_score(double old_score,
+                                             std::string_view member,
+                                             double new_score) {
+  std::array<Node *, MAX_LEVEL> update{};
+  find_predecessors(old_score, member, update.data());
+  auto *node = update[0]->levels()[0].forward;
+  // If the node stays between its neighbours, only the score changes.
+  const auto *next = node->levels()[0].forward;
+  if ((node->backward_ == nullptr || node->backward_->score_ < new_score) &&
+      (next == nullptr || next->score_ > new_score)) {
+    node->score_ = new_score;
+    return node;
+  }
+  // Otherwise move the same node over, so its member string never moves.
+  unlink(node, update.data());
+  node->score_ = new_score;
+  link(node);
+  return node;
+}
+
+std::optional<std::size_t> SkipList::rank(double score,
+                                          std::string_view member) const {
+  const Node *node = head_;
+  std::size_t traversed = 0;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    for (const auto *next = node->levels()[i].forward;
+         next != nullptr &&
+         (next->score_ < score ||
+          (next->score_ == score && next->member_ <= member));
+         next = node->levels()[i].forward) {
+      traversed += node->levels()[i].span;
+      node = next;
+    }
+    if (node != head_ && node->score_ == score && node->member_ == member) {
+      return traversed - 1;
+    }
+  }
+  return std::nullopt;
+}
+
+const SkipList::Node *SkipList::at_rank(std::size_t rank) const {
+  // Spans count ranks starting from 1.
+  const auto target = rank + 1;
+  const Node *node = head_;
+  std::size_t traversed = 0;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    while (node->levels()[i].forward != nullptr &&
+           traversed + node->levels()[i].span <= target) {
+      traversed += node->levels()[i].span;
+      node = node->levels()[i].forward;
+    }
+    if (traversed == target) {
+      return node;
+    }
+  }
+  return nullptr;
+}
+
+const SkipList::Node *
+SkipList::first_in_range(const ScoreRange &range) const {
+  const Node *node = head_;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    while (node->levels()[i].forward != nullptr &&
+           !range.above_min(node->levels()[i].forward->score_)) {
+      node = node->levels()[i].forward;
+    }
+  }
+  node = node->levels()[0].forward;
+  if (node == nullptr || !range.below_max(node->score_)) {
+    return nullptr;
+  }
+  return node;
+}
+
+const SkipList::Node *SkipList::last_in_range(const ScoreRange &range) const {
+  const Node *node = head_;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    while (node->levels()[i].forward != nullptr &&
+           range.below_max(node->levels()[i].forward->score_)) {
+      node = node->levels()[i].forward;
+    }
+  }
+  if (node == head_ || !range.above_min(node->score_)) {
+    return nullptr;
+  }
+  return node;
+}
+
+bool SkipList::operator==(const SkipList &other) const {
+  if (size_ != other.size_) {
+    return false;
+  }
+  for (const auto *node = first(), *other_node = other.first();
+       node != nullptr; node = node->next(), other_node = other_node->next()) {
+    if (node->score_ != other_node->score_ ||
+        node->member_ != other_node->member_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SkipList::Node *SkipList::create_node(std::size_t num_levels, double score,
+                                      std::string member) {
+  static_assert(sizeof(Node) % alignof(Node::Level) == 0);
+  void *memory = ::operator new(sizeof(Node) +
+                                (num_levels * sizeof(Node::Level)));
+  auto *node = new (memory) Node(std::move(member), score, num_levels);
+  for (std::size_t i = 0; i < num_levels; ++i) {
+    new (node->levels() + i) Node::Level{};
+  }
+  return node;
+}
+
+void SkipList::destroy_node(Node *node) {
+  node->~Node();
+  ::operator delete(node);
+}
+
+std::size_t SkipList::random_level() {
+  thread_local std::mt19937 generator{std::random_device{}()};
+  thread_local std::bernoulli_distribution next_level(LEVEL_PROBABILITY);
+  std::size_t level = 1;
+  while (level < MAX_LEVEL && next_level(generator)) {
+    ++level;
+  }
+  return level;
+}
+
+void SkipList::clear() {
+  auto *node = head_->levels()[0].forward;
+  while (node != nullptr) {
+    auto *next = node->levels()[0].forward;
+    destroy_node(node);
+    node = next;
+  }
+  for (std::size_t i = 0; i < MAX_LEVEL; ++i) {
+    head_->levels()[i] = {};
+  }
+  tail_ = nullptr;
+  size_ = 0;
+  level_ = 1;
+}
+
+void SkipList::find_predecessors(double score, std::string_view member,
+                                 Node **update) const {
+  auto *node = head_;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    while (node->levels()[i].forward != nullptr &&
+           sorts_before(node->levels()[i].forward, score, member)) {
+      node = node->levels()[i].forward;
+    }
+    update[i] = node;
+  }
+}
+
+void SkipList::link(Node *node) {
+  std::array<Node *, MAX_LEVEL> update{};
+  // The rank of update[i], so the spans around the new node can be split.
+  std::array<std::size_t, MAX_LEVEL> rank{};
+  auto *current = head_;
+  for (auto level = level_; level > 0; --level) {
+    const auto i = level - 1;
+    rank[i] = level == level_ ? 0 : rank[i + 1];
+    while (current->levels()[i].forward != nullptr &&
+           sorts_before(current->levels()[i].forward, node->score_,
+                        node->member_)) {
+      rank[i] += current->levels()[i].span;
+      current = current->levels()[i].forward;
+    }
+    update[i] = current;
+  }
+  const auto num_levels = node->num_levels_;
+  if (num_levels > level_) {
+    for (auto i = level_; i < num_levels; ++i) {
+      rank[i] = 0;
+      update[i] = head_;
+      update[i]->levels()[i].span = size_;
+    }
+    level_ = num_levels;
+  }
+  for (std::size_t i = 0; i < num_levels; ++i) {
+    auto &before = update[i]->levels()[i];
+    node->levels()[i].forward = before.forward;
+    before.forward = node;
+    node->levels()[i].span = before.span - (rank[0] - rank[i]);
+    before.span = rank[0] - rank[i] + 1;
+  }
+  // Links above the node now skip one more element.
+  for (auto i = num_levels; i < level_; ++i) {
+    ++update[i]->levels()[i].span;
+  }
+  node->backward_ = update[0] == head_ ? nullptr : update[0];
+  if (auto *next = node->levels()[0].forward) {
+    next->backward_ = node;
+  } else {
+    tail_ = node;
+  }
+}
+
+void SkipList::unlink(Node *node, Node *const *update) {
+  for (std::size_t i = 0; i < level_; ++i) {
+    auto &before = update[i]->levels()[i];
+    if (before.forward == node) {
+      before.span += node->levels()[i].span - 1;
+      before.forward = node->levels()[i].forward;
+    } else {
+      --before.span;
+    }
+  }
+  if (auto *next = node->levels()[0].forward) {
+    next->backward_ = node->backward_;
+  } else {
+    tail_ = node->backward_;
+  }
+  while (level_ > 1 && head_->levels()[level_ - 1].forward == nullptr) {
+    --level_;
+  }
+  // The node may get linked in again (see update_score()).
+  for (std::size_t i = 0; i < node->num_levels_; ++i) {
+    node->levels()[i] = {};
+  }
+}
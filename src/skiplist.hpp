@@ -0,0 +1,125 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// A range of scores, with either end optionally excluded (like "(1.5" in
+// ZRANGEBYSCORE).
+struct ScoreRange {
+  double min = 0;
+  double max = 0;
+  bool min_exclusive = false;
+  bool max_exclusive = false;
+
+  [[nodiscard]] bool above_min(double score) const {
+    return min_exclusive ? score > min : score >= min;
+  }
+  [[nodiscard]] bool below_max(double score) const {
+    return max_exclusive ? score < max : score <= max;
+  }
+};
+
+// The ordered half of a big sorted set: members sorted by (score, member),
+// like Redis's zskiplist. Every link also records its span (how many elements
+// it skips), so finding the rank of a member or the member at a rank takes
+// O(log n) like any other lookup. See
+// https://github.com/redis/redis/blob/unstable/src/t_zset.c
+class SkipList {
+public:
+  static constexpr std::size_t MAX_LEVEL = 32;
+
+  class Node {
+  public:
+    [[nodiscard]] const std::string &member() const { return member_; }
+    [[nodiscard]] double score() const { return score_; }
+    [[nodiscard]] const Node *next() const { return levels()[0].forward; }
+    [[nodiscard]] const Node *prev() const { return backward_; }
+
+  private:
+    friend class SkipList;
+    struct Level {
+      Node *forward = nullptr;
+      // The number of elements between this node and forward, counting
+      // forward but not this node.
+      std::size_t span = 0;
+    };
+
+    Node(std::string member, double score, std::size_t num_levels)
+        : member_(std::move(member)), score_(score), num_levels_(num_levels) {}
+
+    // The levels are allocated right after the node, so each node is a single
+    // allocation no matter how tall it is.
+    Level *levels() { return reinterpret_cast<Level *>(this + 1); }
+    [[nodiscard]] const Level *levels() const {
+      return reinterpret_cast<const Level *>(this + 1);
+    }
+
+    std::string member_;
+    double score_;
+    Node *backward_ = nullptr;
+    std::size_t num_levels_;
+  };
+
+  SkipList();
+  // Copies insert every element again, in order.
+  SkipList(const SkipList &other);
+  SkipList &operator=(const SkipList &other);
+  SkipList(SkipList &&other) noexcept;
+  SkipList &operator=(SkipList &&other) noexcept;
+  ~SkipList();
+
+  // Inserts the member, which must not be in the list yet, and returns its
+  // node.
+  const Node *insert(double score, std::string member);
+  // Removes the member with the given score. Returns false if it isn't there.
+  bool erase(double score, std::string_view member);
+  // Moves the member (which must be there with old_score) to new_score, and
+  // returns its node. The node stays where it is if the order doesn't change.
+  const Node *update_score(double old_score, std::string_view member,
+                           double new_score);
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+  [[nodiscard]] const Node *first() const { return head_->levels()[0].forward; }
+  [[nodiscard]] const Node *last() const { return tail_; }
+
+  // The (0-based) rank of the member with the given score, or nullopt if it
+  // isn't there.
+  [[nodiscard]] std::optional<std::size_t> rank(double score,
+                                                std::string_view member) const;
+  // The node at the (0-based) rank, or nullptr if there are not that many.
+  [[nodiscard]] const Node *at_rank(std::size_t rank) const;
+  // The first and last nodes with scores in the range, or nullptr if there
+  // are none.
+  [[nodiscard]] const Node *first_in_range(const ScoreRange &range) const;
+  [[nodiscard]] const Node *last_in_range(const ScoreRange &range) const;
+
+  // Whether both hold the same members with the same scores.
+  bool operator==(const SkipList &other) const;
+
+private:
+  static Node *create_node(std::size_t num_levels, double score,
+                           std::string member);
+  static void destroy_node(Node *node);
+  static std::size_t random_level();
+  void clear();
+  // Finds the rightmost node before (score, member) at every level.
+  void find_predecessors(double score, std::string_view member,
+                         Node **update) const;
+  // Links the node in where its score and member belong.
+  void link(Node *node);
+  // Unlinks the node, given the rightmost node before it at every level.
+  void unlink(Node *node, Node *const *update);
+
+  // Has MAX_LEVEL levels and no element of its own. Heap allocated, so moving
+  // the list leaves every link valid.
+  Node *head_;
+  Node *tail_ = nullptr;
+  std::size_t size_ = 0;
+  // The number of levels in use by the tallest node.
+  std::size_t level_ = 1;
+};
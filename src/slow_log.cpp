@@ -0,0 +1,99 @@
+// This source file's own header include.
+#include "slow_log.hpp"
+
+// System includes.
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
+// Our library's header includes.
+#include "command_table.hpp"
+
+namespace {
+
+// The word, cut down to SlowLog::MAX_ARGUMENT_LENGTH bytes.
+std::string truncate(const std::string_view word) {
+  if (word.size() <= SlowLog::MAX_ARGUMENT_LENGTH) {
+    return std::string(word);
+  }
+  return std::string(word.substr(0, SlowLog::MAX_ARGUMENT_LENGTH)) + "... (" +
+         std::to_string(word.size() - SlowLog::MAX_ARGUMENT_LENGTH) +
+         " more bytes)";
+}
+
+// The words of the command as sent, cut down to SlowLog::MAX_ARGUMENTS.
+std::vector<std::string> truncated_words(const Command &command) {
+  std::vector<std::string_view> names{};
+  if (const auto *spec = command_spec(command.verb)) {
+    names.push_back(spec->name);
+    if (!spec->subcommand.empty()) {
+      names.push_back(spec->subcommand);
+    }
+  }
+  const auto num_words = names.size() + command.arguments.size();
+  // Room for saying how many more there were, if they don't all fit.
+  const auto num_kept = num_words <= SlowLog::MAX_ARGUMENTS
+                            ? num_words
+                            : SlowLog::MAX_ARGUMENTS - 1;
+  std::vector<std::string> words{};
+  words.reserve(std::min(num_words, SlowLog::MAX_ARGUMENTS));
+  for (const auto name : names) {
+    words.emplace_back(name);
+  }
+  for (std::size_t i = 0; words.size() < num_kept; ++i) {
+    words.push_back(truncate(command.arguments[i]));
+  }
+  if (num_kept < num_words) {
+    words.push_back("... (" + std::to_string(num_words - num_kept) +
+                    " more arguments)");
+  }
+  return words;
+}
+
+} // namespace
+
+void SlowLog::add(const Command &command,
+                  const std::chrono::microseconds duration,
+                  const std::string &client_address,
+                  const std::string &client_name) {
+  if (max_len_ == 0) {
+    return;
+  }
+  Entry entry{.time = std::chrono::system_clock::now(),
+              .duration = duration,
+              .words = truncated_words(command),
+              .client_address = client_address,
+              .client_name = client_name};
+  std::scoped_lock lock(mutex_);
+  entry.id = next_id_++;
+  if (entries_.size() < max_len_) {
+    entries_.push_back(std::move(entry));
+    return;
+  }
+  entries_[next_] = std::move(entry);
+  next_ = (next_ + 1) % max_len_;
+}
+
+std::vector<SlowLog::Entry> SlowLog::get(const std::size_t count) const {
+  std::scoped_lock lock(mutex_);
+  std::vector<Entry> entries{};
+  entries.reserve(std::min(count, entries_.size()));
+  // Walk back from the most recent, which is just before next_.
+  for (std::size_t i = 1; i <= entries_.size() && entries.size() < count;
+       ++i) {
+    entries.push_back(
+        entries_[(next_ + entries_.size() - i) % entries_.size()]);
+  }
+  return entries;
+}
+
+std::size_t SlowLog::size() const {
+  std::scoped_lock lock(mutex_);
+  return entries_.size();
+}
+
+void SlowLog::reset() {
+  std::scoped_lock lock(mutex_);
+  entries_.clear();
+  next_ = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// System includes.
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+// The most recent commands that ran slower than a threshold, for SLOWLOG.
+//
+// Kept in a ring buffer of max_len entries, so logging a command past that
+// overwrites the oldest one. Only slow commands are logged (the server
+// decides which), so taking a lock to log one is fine. Long commands are
+// truncated like Redis does, so a command with a big value doesn't keep
+// it alive. Thread-safe.
+class SlowLog {
+public:
+  // Commands are logged with at most MAX_ARGUMENTS words (the last one
+  // saying how many more there were), each at most MAX_ARGUMENT_LENGTH bytes
+  // (followed by how many more bytes there were).
+  static constexpr std::size_t MAX_ARGUMENTS = 32;
+  static constexpr std::size_t MAX_ARGUMENT_LENGTH = 128;
+
+  struct Entry {
+    // Unique, and increasing from 0 (even across reset()).
+    std::uint64_t id = 0;
+    // When the command was logged.
+    std::chrono::system_clock::time_point time{};
+    std::chrono::microseconds duration{};
+    // The command as sent (e.g. "config", "get", "dir"), truncated.
+    std::vector<std::string> words{};
+    // The client's "ip:port" and name.
+    std::string client_address{};
+    std::string client_name{};
+  };
+
+  explicit SlowLog(std::size_t max_len) : max_len_(max_len) {}
+
+  // Logs the command, which took the duration.
+  void add(const Command &command, std::chrono::microseconds duration,
+           const std::string &client_address, const std::string &client_name);
+  // The last count entries logged (all of them if count is larger), the
+  // most recent first.
+  [[nodiscard]] std::vector<Entry> get(std::size_t count) const;
+  [[nodiscard]] std::size_t size() const;
+  // Forgets every entry.
+  void reset();
+
+private:
+  std::size_t max_len_;
+  // Oldest first until full, after which next_ is where the oldest is (and
+  // the next one goes).
+  std::vector<Entry> entries_{};
+  std::size_t next_ = 0;
+  std::uint64_t next_id_ = 0;
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,604 @@
+// This source file's own header include.
+#include "sorted_set_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+constexpr auto NOT_A_FLOAT_ERROR = "ERR value is not a valid float";
+constexpr auto MIN_MAX_NOT_A_FLOAT_ERROR = "ERR min or max is not a float";
+constexpr auto NAN_SCORE_ERROR = "ERR resulting score is not a number (NaN)";
+constexpr auto SYNTAX_ERROR = "ERR syntax error";
+constexpr auto XX_AND_NX_ERROR =
+    "ERR XX and NX options at the same time are not compatible";
+constexpr auto GT_LT_NX_ERROR =
+    "ERR GT, LT, and/or NX options at the same time are not compatible";
+constexpr auto INCR_PAIRS_ERROR =
+    "ERR INCR option supports a single increment-element pair";
+constexpr auto LIMIT_WITHOUT_BY_ERROR =
+    "ERR syntax error, LIMIT is only supported in combination with either "
+    "BYSCORE or BYLEX";
+constexpr auto BYLEX_ERROR = "ERR BYLEX is not supported";
+
+// The members of a small sorted set, in order.
+using Entries = std::vector<std::pair<std::string, double>>;
+
+// Parses a score like Redis does: any float, including "inf", "+inf" and
+// "-inf", but not NaN.
+std::optional<double> parse_score(std::string_view str) {
+  if (str.starts_with('+')) {
+    str.remove_prefix(1);
+    if (str.starts_with('-')) {
+      return std::nullopt;
+    }
+  }
+  double score = 0;
+  const auto [end, error] =
+      std::from_chars(str.data(), str.data() + str.size(), score);
+  if (error != std::errc{} || end != str.data() + str.size() ||
+      std::isnan(score)) {
+    return std::nullopt;
+  }
+  return score;
+}
+
+// The shortest string that parses back into the same score.
+std::string format_score(double score) {
+  if (std::isinf(score)) {
+    return score > 0 ? "inf" : "-inf";
+  }
+  std::array<char, 32> buffer{};
+  const auto [end, error] =
+      std::to_chars(buffer.data(), buffer.data() + buffer.size(), score);
+  return {buffer.data(), end};
+}
+
+// Parses one end of a ZRANGEBYSCORE range, where "(" excludes the score.
+bool parse_bound(std::string_view str, double &score, bool &exclusive) {
+  exclusive = str.starts_with('(');
+  if (exclusive) {
+    str.remove_prefix(1);
+  }
+  const auto parsed = parse_score(str);
+  if (parsed) {
+    score = *parsed;
+  }
+  return parsed.has_value();
+}
+
+double listpack_score(const Listpack::Element &elem) {
+  if (const auto *integer = std::get_if<std::int64_t>(&elem)) {
+    return static_cast<double>(*integer);
+  }
+  return parse_score(std::get<std::string_view>(elem)).value_or(0);
+}
+
+// Small sorted sets are short, so decoding them whole is cheap.
+Entries listpack_entries(const Listpack &listpack) {
+  Entries entries{};
+  entries.reserve(listpack.size() / 2);
+  bool is_member = true;
+  listpack.for_each([&](const Listpack::Element &elem) {
+    if (is_member) {
+      entries.emplace_back(Listpack::to_string(elem), 0);
+    } else {
+      entries.back().second = listpack_score(elem);
+    }
+    is_member = !is_member;
+  });
+  return entries;
+}
+
+std::size_t sorted_set_size(const SortedSetValue &sorted_set) {
+  if (const auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    return listpack->size() / 2;
+  }
+  return std::get<SortedSetTable>(sorted_set).size();
+}
+
+std::optional<double> sorted_set_score(const SortedSetValue &sorted_set,
+                                       const std::string &member) {
+  if (const auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    const auto index = listpack->find(member, 1);
+    if (!index) {
+      return std::nullopt;
+    }
+    double score = 0;
+    listpack->for_each(*index + 1, 1, [&score](const Listpack::Element &elem) {
+      score = listpack_score(elem);
+    });
+    return score;
+  }
+  return std::get<SortedSetTable>(sorted_set).score(member);
+}
+
+void convert_to_table(SortedSetValue &sorted_set) {
+  SortedSetTable table{};
+  for (const auto &[member, score] :
+       listpack_entries(std::get<Listpack>(sorted_set))) {
+    table.insert(member, score);
+  }
+  sorted_set = std::move(table);
+}
+
+// Sets the score of the member, converting the sorted set to a table first if
+// it would outgrow the listpack.
+void sorted_set_set(SortedSetValue &sorted_set, const std::string &member,
+                    double score, const Config &config) {
+  if (auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    const auto index = listpack->find(member, 1);
+    if (index) {
+      listpack->erase(*index, 2);
+    }
+    if (member.size() <= config.zset_max_listpack_value &&
+        sorted_set_size(sorted_set) < config.zset_max_listpack_entries) {
+      // Keep the pairs ordered by (score, member).
+      const auto entries = listpack_entries(*listpack);
+      const auto position = std::ranges::find_if(
+          entries, [&](const std::pair<std::string, double> &entry) {
+            return entry.second > score ||
+                   (entry.second == score && entry.first > member);
+          });
+      const auto pair_index =
+          static_cast<std::size_t>(position - entries.begin());
+      listpack->insert(pair_index * 2, member);
+      listpack->insert((pair_index * 2) + 1, format_score(score));
+      return;
+    }
+    convert_to_table(sorted_set);
+  }
+  std::get<SortedSetTable>(sorted_set).insert(member, score);
+}
+
+bool sorted_set_remove(SortedSetValue &sorted_set, const std::string &member) {
+  if (auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    const auto index = listpack->find(member, 1);
+    if (index) {
+      listpack->erase(*index, 2);
+    }
+    return index.has_value();
+  }
+  return std::get<SortedSetTable>(sorted_set).erase(member);
+}
+
+// The 0-based rank of the member and its score, or nullopt if it isn't
+// there.
+std::optional<std::pair<std::size_t, double>>
+sorted_set_rank(const SortedSetValue &sorted_set, const std::string &member) {
+  if (const auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    const auto entries = listpack_entries(*listpack);
+    for (std::size_t rank = 0; rank < entries.size(); ++rank) {
+      if (entries[rank].first == member) {
+        return std::pair{rank, entries[rank].second};
+      }
+    }
+    return std::nullopt;
+  }
+  const auto &table = std::get<SortedSetTable>(sorted_set);
+  const auto score = table.score(member);
+  if (!score) {
+    return std::nullopt;
+  }
+  return std::pair{*table.ordered().rank(*score, member), *score};
+}
+
+// Collects the members and scores of ZRANGE and ZRANGEBYSCORE replies.
+class RangeReply {
+public:
+  explicit RangeReply(bool with_scores) : with_scores_(with_scores) {}
+
+  void add(const std::string &member, double score) {
+    elements_.emplace_back(member, DataType::BulkString);
+    if (with_scores_) {
+      elements_.emplace_back(format_score(score), DataType::Double);
+    }
+  }
+
+  Message finish() && {
+    return Message{std::move(elements_), DataType::Array};
+  }
+
+private:
+  bool with_scores_;
+  Message::NestedVariantT elements_;
+};
+
+// Adds count members starting at the given rank (counting from the highest
+// score if reverse).
+void add_by_rank(const SortedSetValue &sorted_set, std::size_t first,
+                 std::size_t count, bool reverse, RangeReply &reply) {
+  if (const auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    auto entries = listpack_entries(*listpack);
+    if (reverse) {
+      std::ranges::reverse(entries);
+    }
+    for (std::size_t i = first; i < first + count; ++i) {
+      reply.add(entries[i].first, entries[i].second);
+    }
+    return;
+  }
+  // The spans find the first node in O(log n), then the range is a walk.
+  const auto &ordered = std::get<SortedSetTable>(sorted_set).ordered();
+  const auto *node =
+      ordered.at_rank(reverse ? ordered.size() - 1 - first : first);
+  for (; node != nullptr && count > 0; --count) {
+    reply.add(node->member(), node->score());
+    node = reverse ? node->prev() : node->next();
+  }
+}
+
+// Adds the members with scores in the range (from the highest score if
+// reverse), skipping offset of them and adding at most limit (if given).
+void add_by_score(const SortedSetValue &sorted_set, const ScoreRange &range,
+                  bool reverse, std::size_t offset,
+                  std::optional<std::size_t> limit, RangeReply &reply) {
+  const auto in_range = [&range](double score) {
+    return range.above_min(score) && range.below_max(score);
+  };
+  const auto add = [&](const std::string &member, double score) {
+    if (offset > 0) {
+      --offset;
+    } else if (!limit || *limit > 0) {
+      reply.add(member, score);
+      if (limit) {
+        --*limit;
+      }
+    }
+  };
+  if (const auto *listpack = std::get_if<Listpack>(&sorted_set)) {
+    auto entries = listpack_entries(*listpack);
+    if (reverse) {
+      std::ranges::reverse(entries);
+    }
+    for (const auto &[member, score] : entries) {
+      if (in_range(score)) {
+        add(member, score);
+      }
+    }
+    return;
+  }
+  const auto &ordered = std::get<SortedSetTable>(sorted_set).ordered();
+  for (const auto *node = reverse ? ordered.last_in_range(range)
+                                  : ordered.first_in_range(range);
+       node != nullptr && in_range(node->score()) && (!limit || *limit > 0);
+       node = reverse ? node->prev() : node->next()) {
+    add(node->member(), node->score());
+  }
+}
+
+// Calls func(sorted_set) with the sorted set stored at the key (creating an
+// empty one if the key is missing), removing the key if func leaves the
+// sorted set empty.
+template <typename Func>
+Message update_sorted_set(Cache &cache, const std::string &key, Func &&func) {
+  return cache.update(key, [&func](std::optional<Value> &value) {
+    if (!value) {
+      value = SortedSetValue{Listpack{}};
+    }
+    auto *sorted_set = std::get_if<SortedSetValue>(&*value);
+    if (sorted_set == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    auto reply = func(*sorted_set);
+    if (sorted_set_size(*sorted_set) == 0) {
+      value.reset();
+    }
+    return reply;
+  });
+}
+
+// Calls func(sorted_set) with the sorted set stored at the key, or replies
+// with missing_reply if there is none.
+template <typename Func>
+Message read_sorted_set(const Cache &cache, const std::string &key,
+                        const Message &missing_reply, Func &&func) {
+  return cache.read(key, [&](const Value *value) {
+    if (value == nullptr) {
+      return missing_reply;
+    }
+    const auto *sorted_set = std::get_if<SortedSetValue>(value);
+    if (sorted_set == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return func(*sorted_set);
+  });
+}
+
+struct AddOptions {
+  bool only_new = false;      // NX
+  bool only_existing = false; // XX
+  bool only_greater = false;  // GT
+  bool only_less = false;     // LT
+  bool count_changed = false; // CH
+  bool increment = false;     // INCR
+};
+
+// Applies one score of ZADD or ZINCRBY and returns the member's new score,
+// or nullopt if the options skipped it. Counts what was added and changed.
+std::optional<double> add_one(SortedSetValue &sorted_set,
+                              const std::string &member, double score,
+                              const AddOptions &options, const Config &config,
+                              std::size_t &num_added,
+                              std::size_t &num_changed) {
+  const auto current = sorted_set_score(sorted_set, member);
+  if (!current) {
+    if (options.only_existing) {
+      return std::nullopt;
+    }
+    sorted_set_set(sorted_set, member, score, config);
+    ++num_added;
+    return score;
+  }
+  if (options.only_new) {
+    return std::nullopt;
+  }
+  const auto new_score = options.increment ? *current + score : score;
+  if ((options.only_greater && new_score <= *current) ||
+      (options.only_less && new_score >= *current)) {
+    return std::nullopt;
+  }
+  if (new_score != *current) {
+    sorted_set_set(sorted_set, member, new_score, config);
+    ++num_changed;
+  }
+  return new_score;
+}
+
+// ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+Message add(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  AddOptions options{};
+  std::size_t i = 1;
+  for (; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "nx") {
+      options.only_new = true;
+    } else if (option == "xx") {
+      options.only_existing = true;
+    } else if (option == "gt") {
+      options.only_greater = true;
+    } else if (option == "lt") {
+      options.only_less = true;
+    } else if (option == "ch") {
+      options.count_changed = true;
+    } else if (option == "incr") {
+      options.increment = true;
+    } else {
+      break;
+    }
+  }
+  const auto num_pairs = (args.size() - i) / 2;
+  if (num_pairs == 0 || (args.size() - i) % 2 != 0) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  if (options.only_new && options.only_existing) {
+    return Message{XX_AND_NX_ERROR, DataType::SimpleError};
+  }
+  if ((options.only_greater && options.only_less) ||
+      (options.only_new && (options.only_greater || options.only_less))) {
+    return Message{GT_LT_NX_ERROR, DataType::SimpleError};
+  }
+  if (options.increment && num_pairs > 1) {
+    return Message{INCR_PAIRS_ERROR, DataType::SimpleError};
+  }
+  // Check every score before changing anything.
+  std::vector<double> scores{};
+  scores.reserve(num_pairs);
+  for (auto j = i; j < args.size(); j += 2) {
+    const auto score = parse_score(args[j]);
+    if (!score) {
+      return Message{NOT_A_FLOAT_ERROR, DataType::SimpleError};
+    }
+    scores.push_back(*score);
+  }
+
+  return update_sorted_set(
+      cache, args.front(), [&](SortedSetValue &sorted_set) {
+        std::size_t num_added = 0;
+        std::size_t num_changed = 0;
+        if (options.increment) {
+          if (const auto current = sorted_set_score(sorted_set, args[i + 1]);
+              current && std::isnan(*current + scores.front())) {
+            return Message{NAN_SCORE_ERROR, DataType::SimpleError};
+          }
+          const auto score =
+              add_one(sorted_set, args[i + 1], scores.front(), options, config,
+                      num_added, num_changed);
+          return score ? Message{format_score(*score), DataType::Double}
+                       : Message{"", DataType::NullBulkString};
+        }
+        for (std::size_t pair = 0; pair < num_pairs; ++pair) {
+          add_one(sorted_set, args[i + (pair * 2) + 1], scores[pair], options,
+                  config, num_added, num_changed);
+        }
+        const auto result =
+            options.count_changed ? num_added + num_changed : num_added;
+        return Message{std::to_string(result), DataType::Integer};
+      });
+}
+
+// ZINCRBY key increment member, which is ZADD key INCR increment member.
+Message increment(const Command &command, const Config &config,
+                  Cache &cache) {
+  const auto &args = command.arguments;
+  // Check the increment first, so it can't be taken for an option.
+  if (!parse_score(args[1])) {
+    return Message{NOT_A_FLOAT_ERROR, DataType::SimpleError};
+  }
+  return add(Command{.verb = CommandVerb::ZAdd,
+                     .arguments = {args[0], "incr", args[1], args[2]}},
+             config, cache);
+}
+
+// ZRANGE key start stop [BYSCORE] [REV] [LIMIT offset count] [WITHSCORES]
+// and ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count].
+Message range(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  bool by_score = command.verb == CommandVerb::ZRangeByScore;
+  bool reverse = false;
+  bool with_scores = false;
+  std::optional<std::pair<std::int64_t, std::int64_t>> offset_and_limit{};
+  for (std::size_t i = 3; i < args.size(); ++i) {
+    const auto option = tolower(args[i]);
+    if (option == "byscore" && command.verb == CommandVerb::ZRange) {
+      by_score = true;
+    } else if (option == "bylex" && command.verb == CommandVerb::ZRange) {
+      return Message{BYLEX_ERROR, DataType::SimpleError};
+    } else if (option == "rev" && command.verb == CommandVerb::ZRange) {
+      reverse = true;
+    } else if (option == "withscores") {
+      with_scores = true;
+    } else if (option == "limit" && i + 2 < args.size()) {
+      const auto offset = parse_canonical_int(args[i + 1]);
+      const auto limit = parse_canonical_int(args[i + 2]);
+      if (!offset || !limit) {
+        return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+      }
+      offset_and_limit = {*offset, *limit};
+      i += 2;
+    } else {
+      return Message{SYNTAX_ERROR, DataType::SimpleError};
+    }
+  }
+  if (offset_and_limit && !by_score) {
+    return Message{LIMIT_WITHOUT_BY_ERROR, DataType::SimpleError};
+  }
+  const Message empty{Message::NestedVariantT{}, DataType::Array};
+
+  if (!by_score) {
+    const auto start = parse_canonical_int(args[1]);
+    const auto stop = parse_canonical_int(args[2]);
+    if (!start || !stop) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    return read_sorted_set(
+        cache, args.front(), empty, [&](const SortedSetValue &sorted_set) {
+          const auto size = static_cast<std::int64_t>(
+              sorted_set_size(sorted_set));
+          auto first = *start < 0 ? std::max<std::int64_t>(*start + size, 0)
+                                  : *start;
+          auto last = *stop < 0 ? *stop + size : std::min(*stop, size - 1);
+          RangeReply reply(with_scores);
+          if (first <= last && first < size) {
+            add_by_rank(sorted_set, static_cast<std::size_t>(first),
+                        static_cast<std::size_t>(last - first + 1), reverse,
+                        reply);
+          }
+          return std::move(reply).finish();
+        });
+  }
+
+  // With REV the range is given from max to min.
+  ScoreRange score_range{};
+  const auto &min = reverse ? args[2] : args[1];
+  const auto &max = reverse ? args[1] : args[2];
+  if (!parse_bound(min, score_range.min, score_range.min_exclusive) ||
+      !parse_bound(max, score_range.max, score_range.max_exclusive)) {
+    return Message{MIN_MAX_NOT_A_FLOAT_ERROR, DataType::SimpleError};
+  }
+  const auto [offset, limit] =
+      offset_and_limit.value_or(std::pair<std::int64_t, std::int64_t>{0, -1});
+  // Like in Redis, a negative offset returns nothing and a negative count
+  // returns everything after the offset.
+  if (offset < 0) {
+    return empty;
+  }
+  return read_sorted_set(
+      cache, args.front(), empty, [&](const SortedSetValue &sorted_set) {
+        RangeReply reply(with_scores);
+        add_by_score(sorted_set, score_range, reverse,
+                     static_cast<std::size_t>(offset),
+                     limit < 0 ? std::nullopt
+                               : std::optional<std::size_t>(limit),
+                     reply);
+        return std::move(reply).finish();
+      });
+}
+
+// ZRANK key member [WITHSCORE]
+Message rank(const Command &command, const Cache &cache) {
+  const auto &args = command.arguments;
+  const bool with_score = args.size() == 3;
+  if (with_score && tolower(args[2]) != "withscore") {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  const Message missing{"", DataType::NullBulkString};
+  return read_sorted_set(
+      cache, args.front(), missing, [&](const SortedSetValue &sorted_set) {
+        const auto found = sorted_set_rank(sorted_set, args[1]);
+        if (!found) {
+          return missing;
+        }
+        Message rank_reply{std::to_string(found->first), DataType::Integer};
+        if (!with_score) {
+          return rank_reply;
+        }
+        return Message{
+            Message::NestedVariantT{
+                std::move(rank_reply),
+                Message{format_score(found->second), DataType::Double}},
+            DataType::Array};
+      });
+}
+
+Message remove_members(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  return update_sorted_set(
+      cache, args.front(), [&args](SortedSetValue &sorted_set) {
+        std::size_t num_removed = 0;
+        for (auto member = args.cbegin() + 1; member != args.cend();
+             ++member) {
+          num_removed += sorted_set_remove(sorted_set, *member) ? 1 : 0;
+        }
+        return Message{std::to_string(num_removed), DataType::Integer};
+      });
+}
+
+Message cardinality(const Command &command, const Cache &cache) {
+  return read_sorted_set(cache, command.arguments.front(),
+                         Message{"0", DataType::Integer},
+                         [](const SortedSetValue &sorted_set) {
+                           return Message{
+                               std::to_string(sorted_set_size(sorted_set)),
+                               DataType::Integer};
+                         });
+}
+
+} // namespace
+
+std::optional<Message> handle_sorted_set_command(const Command &command,
+                                                 const Config &config,
+                                                 Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::ZAdd:
+    return add(command, config, cache);
+  case CommandVerb::ZIncrBy:
+    return increment(command, config, cache);
+  case CommandVerb::ZRange:
+  case CommandVerb::ZRangeByScore:
+    return range(command, cache);
+  case CommandVerb::ZRank:
+    return rank(command, cache);
+  case CommandVerb::ZRem:
+    return remove_members(command, cache);
+  case CommandVerb::ZCard:
+    return cardinality(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
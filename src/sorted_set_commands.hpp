@@ -0,0 +1,18 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the sorted set commands (ZADD, ZINCRBY, ZRANGE, ZRANGEBYSCORE,
+// ZRANK, ZREM and ZCARD) and returns the reply, or nullopt for any other
+// command. Sorted sets stay listpacks until they outgrow
+// config.zset_max_listpack_entries or config.zset_max_listpack_value.
+std::optional<Message> handle_sorted_set_command(const Command &command,
+                                                 const Config &config,
+                                                 Cache &cache);
@@ -2,20 +2,136 @@
 #include "storage.hpp"
 
 // System includes.
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstring>
 #include <exception>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <streambuf>
+#include <system_error>
+#include <unordered_set>
+#include <unistd.h>
 
 // Our library's header includes.
+#include "aof.hpp"
 #include "config.hpp"
+#include "crc64.hpp"
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "lzf.hpp"
 #include "time.hpp"
+#include "utils.hpp"
+#include "value.hpp"
+#include "ziplist.hpp"
 
 namespace {
 
+// The RDB version DUMP payloads are tagged with, the same as RDB_WRITE_VERSION.
+constexpr std::uint16_t DUMP_RDB_VERSION = 11;
+
+constexpr std::size_t CHECKSUM_CHUNK_SIZE = 64UL * 1024;
+// How many entries we load into the cache at a time.
+constexpr std::size_t LOADING_BATCH_SIZE = 1024;
+
+// Reads from another stream buffer in large chunks and checksums each chunk
+// once we're done with it, so verifying the RDB checksum costs one pass of
+// the fast CRC64 over memory that is already hot in cache.
+class Crc64InputBuffer : public std::streambuf {
+public:
+  explicit Crc64InputBuffer(std::streambuf *source)
+      : source_(source), buffer_(CHECKSUM_CHUNK_SIZE) {}
+
+  // The CRC64 of every byte consumed from this buffer so far.
+  [[nodiscard]] std::uint64_t checksum() const {
+    return crc64(crc_, std::string_view(eback(), gptr() - eback()));
+  }
+
+  // Moves the source back to the first byte we haven't consumed yet, if it
+  // supports seeking.
+  void give_back_unread() {
+    source_->pubseekoff(-(egptr() - gptr()), std::ios::cur, std::ios::in);
+    setg(eback(), gptr(), gptr());
+  }
+
+protected:
+  int_type underflow() override {
+    // The whole current chunk was consumed, fold it into the running crc.
+    crc_ = crc64(crc_, std::string_view(eback(), egptr() - eback()));
+    const auto num_read = source_->sgetn(
+        buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    if (num_read <= 0) {
+      setg(buffer_.data(), buffer_.data(), buffer_.data());
+      return traits_type::eof();
+    }
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + num_read);
+    return traits_type::to_int_type(buffer_.front());
+  }
+
+private:
+  std::streambuf *source_;
+  std::vector<char> buffer_;
+  std::uint64_t crc_ = 0;
+};
+
+// The writing counterpart of Crc64InputBuffer: buffers the output in chunks
+// and checksums each chunk right before handing it to the destination.
+class Crc64OutputBuffer : public std::streambuf {
+public:
+  explicit Crc64OutputBuffer(std::streambuf *sink)
+      : sink_(sink), buffer_(CHECKSUM_CHUNK_SIZE) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+  }
+  Crc64OutputBuffer(const Crc64OutputBuffer &other) = delete;
+  Crc64OutputBuffer &operator=(const Crc64OutputBuffer &other) = delete;
+  Crc64OutputBuffer(Crc64OutputBuffer &&other) = delete;
+  Crc64OutputBuffer &operator=(Crc64OutputBuffer &&other) = delete;
+  ~Crc64OutputBuffer() override { flush_chunk(); }
+
+  // The CRC64 of every byte written to this buffer so far.
+  [[nodiscard]] std::uint64_t checksum() const {
+    return crc64(crc_, std::string_view(pbase(), pptr() - pbase()));
+  }
+
+protected:
+  int_type overflow(int_type character) override {
+    if (!flush_chunk()) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(character, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(character);
+      pbump(1);
+    }
+    return traits_type::not_eof(character);
+  }
+  int sync() override {
+    return flush_chunk() && sink_->pubsync() == 0 ? 0 : -1;
+  }
+
+private:
+  bool flush_chunk() {
+    const std::string_view chunk(pbase(), pptr() - pbase());
+    crc_ = crc64(crc_, chunk);
+    const auto num_written = sink_->sputn(
+        chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return num_written == static_cast<std::streamsize>(chunk.size());
+  }
+
+  std::streambuf *sink_;
+  std::vector<char> buffer_;
+  std::uint64_t crc_ = 0;
+};
+
 std::optional<std::ifstream> read_file(const std::filesystem::path &filepath) {
   std::ifstream file_contents(filepath, std::ios::binary);
   if (!file_contents) {
@@ -82,6 +198,18 @@ decltype(auto) read_int_n_bytes(std::istream &inputs) {
   return bytes_to_int<num_bytes>(buf);
 }
 
+// The inverse of read_int_n_bytes(): writes the int out in little endian.
+template <std::size_t num_bytes, typename IntType>
+void write_int_n_bytes(std::ostream &outputs, IntType value) {
+  static_assert(sizeof(IntType) == num_bytes);
+  if constexpr (std::endian::native == std::endian::big) {
+    value = std::byteswap(value);
+  }
+  std::array<char, num_bytes> buf{};
+  std::memcpy(buf.data(), &value, num_bytes);
+  outputs.write(buf.data(), num_bytes);
+}
+
 // If the next byte inputs the given opcode, consume it and return true.
 // Otherwise, just return false.
 bool is_opcode_section(const std::byte opcode, std::istream &inputs) {
@@ -159,34 +287,253 @@ Metadata read_rdb_metadata(std::istream &inputs) {
 
   return metadata;
 }
-std::vector<DatabaseSection> read_rdb_database_sections(std::istream &inputs) {
+
+// Reads a length-prefixed blob (like a listpack) into the given compact
+// encoding, bailing if it is malformed.
+template <typename Decoder>
+auto read_encoded_blob(std::istream &inputs, Decoder &&decode,
+                       const char *encoding_name) {
+  auto decoded = decode(parse_length_encoded_string(inputs));
+  if (!decoded) {
+    std::cerr << "Encountered malformed " << encoding_name << std::endl;
+    std::terminate();
+  }
+  return std::move(*decoded);
+}
+
+Listpack read_listpack(std::istream &inputs) {
+  return read_encoded_blob(
+      inputs, [](std::string bytes) { return Listpack::from_bytes(bytes); },
+      "listpack");
+}
+
+Listpack read_ziplist(std::istream &inputs) {
+  return read_encoded_blob(
+      inputs,
+      [](const std::string &bytes) { return ziplist_to_listpack(bytes); },
+      "ziplist");
+}
+
+// Scores in RDB_TYPE_ZSET are strings, with special lengths for the
+// non-finite values.
+double read_string_score(std::istream &inputs) {
+  const auto length = read_int_n_bytes<1>(inputs);
+  switch (length) {
+  case 253:
+    return std::numeric_limits<double>::quiet_NaN();
+  case 254:
+    return std::numeric_limits<double>::infinity();
+  case 255:
+    return -std::numeric_limits<double>::infinity();
+  default:
+    return std::stod(read_string_n_bytes(inputs, length));
+  }
+}
+
+// Scores in RDB_TYPE_ZSET_2 are little endian binary doubles.
+double read_binary_score(std::istream &inputs) {
+  return std::bit_cast<double>(read_int_n_bytes<8>(inputs));
+}
+
+template <typename ScoreReader>
+SortedSetTable read_sorted_set(std::istream &inputs, ScoreReader &&read_score) {
+  SortedSetTable sorted_set{};
+  const auto length = parse_length_encoded_integer(inputs);
+  for (std::uint64_t i = 0; i < length; ++i) {
+    auto member = parse_length_encoded_string(inputs);
+    const auto score = read_score(inputs);
+    sorted_set.insert(member, score);
+  }
+  return sorted_set;
+}
+
+StreamId read_stream_id(std::istream &inputs) {
+  const auto ms = parse_length_encoded_integer(inputs);
+  return StreamId{ms, parse_length_encoded_integer(inputs)};
+}
+
+// Streams are written as their blocks (each keyed by the big endian ID of its
+// first entry) followed by their metadata and consumer groups. We don't
+// support consumer groups, so they are skipped.
+StreamValue read_stream(std::uint8_t value_type, std::istream &inputs) {
+  RadixTree<Listpack> blocks{};
+  const auto num_blocks = parse_length_encoded_integer(inputs);
+  for (std::uint64_t i = 0; i < num_blocks; ++i) {
+    auto key = parse_length_encoded_string(inputs);
+    blocks.insert(key, read_listpack(inputs));
+  }
+  [[maybe_unused]] const auto length = parse_length_encoded_integer(inputs);
+  const auto last_id = read_stream_id(inputs);
+  StreamId max_deleted_id{};
+  std::uint64_t entries_added = 0;
+  if (value_type != RDB_TYPE_STREAM_LISTPACKS) {
+    [[maybe_unused]] const auto first_id = read_stream_id(inputs);
+    max_deleted_id = read_stream_id(inputs);
+    entries_added = parse_length_encoded_integer(inputs);
+  }
+  auto stream = Stream::from_blocks(std::move(blocks), last_id,
+                                    max_deleted_id, entries_added);
+  if (!stream) {
+    std::cerr << "Encountered malformed stream" << std::endl;
+    std::terminate();
+  }
+
+  const auto num_groups = parse_length_encoded_integer(inputs);
+  for (std::uint64_t group = 0; group < num_groups; ++group) {
+    parse_length_encoded_string(inputs);
+    read_stream_id(inputs);
+    if (value_type != RDB_TYPE_STREAM_LISTPACKS) {
+      // The entries read counter.
+      parse_length_encoded_integer(inputs);
+    }
+    // The pending entries: a raw ID, a delivery time and a delivery count.
+    const auto num_pending = parse_length_encoded_integer(inputs);
+    for (std::uint64_t i = 0; i < num_pending; ++i) {
+      read_string_n_bytes(inputs, 16);
+      read_int_n_bytes<8>(inputs);
+      parse_length_encoded_integer(inputs);
+    }
+    const auto num_consumers = parse_length_encoded_integer(inputs);
+    for (std::uint64_t i = 0; i < num_consumers; ++i) {
+      parse_length_encoded_string(inputs);
+      // The seen time, and the active time since RDB_TYPE_STREAM_LISTPACKS_3.
+      read_int_n_bytes<8>(inputs);
+      if (value_type == RDB_TYPE_STREAM_LISTPACKS_3) {
+        read_int_n_bytes<8>(inputs);
+      }
+      const auto num_consumer_pending = parse_length_encoded_integer(inputs);
+      for (std::uint64_t j = 0; j < num_consumer_pending; ++j) {
+        read_string_n_bytes(inputs, 16);
+      }
+    }
+  }
+  return std::move(*stream);
+}
+
+// Reads a value of the given type. Compact encodings are kept as they are
+// (or converted to their modern equivalent), so they stay compact in memory.
+Cache::ValueT read_rdb_value(std::uint8_t value_type, std::istream &inputs) {
+  switch (value_type) {
+  case RDB_TYPE_STRING:
+    return parse_length_encoded_string(inputs);
+  case RDB_TYPE_LIST: {
+    ListValue list{};
+    const auto length = parse_length_encoded_integer(inputs);
+    for (std::uint64_t i = 0; i < length; ++i) {
+      list.push_back(parse_length_encoded_string(inputs));
+    }
+    return list;
+  }
+  case RDB_TYPE_LIST_ZIPLIST: {
+    ListValue list{};
+    list.push_back_node(read_ziplist(inputs));
+    return list;
+  }
+  case RDB_TYPE_LIST_QUICKLIST:
+  case RDB_TYPE_LIST_QUICKLIST_2: {
+    ListValue list{};
+    const auto num_nodes = parse_length_encoded_integer(inputs);
+    for (std::uint64_t i = 0; i < num_nodes; ++i) {
+      auto container = QUICKLIST_NODE_PACKED;
+      if (value_type == RDB_TYPE_LIST_QUICKLIST_2) {
+        container = parse_length_encoded_integer(inputs);
+      }
+      Listpack node{};
+      if (container == QUICKLIST_NODE_PLAIN) {
+        node.push_back(parse_length_encoded_string(inputs));
+      } else if (value_type == RDB_TYPE_LIST_QUICKLIST) {
+        node = read_ziplist(inputs);
+      } else {
+        node = read_listpack(inputs);
+      }
+      list.push_back_node(std::move(node));
+    }
+    return list;
+  }
+  case RDB_TYPE_SET: {
+    std::unordered_set<std::string> set{};
+    const auto length = parse_length_encoded_integer(inputs);
+    set.reserve(length);
+    for (std::uint64_t i = 0; i < length; ++i) {
+      set.insert(parse_length_encoded_string(inputs));
+    }
+    return SetValue{std::move(set)};
+  }
+  case RDB_TYPE_SET_INTSET:
+    return SetValue{read_encoded_blob(
+        inputs, [](std::string bytes) { return IntSet::from_bytes(bytes); },
+        "intset")};
+  case RDB_TYPE_SET_LISTPACK:
+    return SetValue{read_listpack(inputs)};
+  case RDB_TYPE_ZSET:
+    return SortedSetValue{read_sorted_set(inputs, read_string_score)};
+  case RDB_TYPE_ZSET_2:
+    return SortedSetValue{read_sorted_set(inputs, read_binary_score)};
+  case RDB_TYPE_ZSET_ZIPLIST:
+    return SortedSetValue{read_ziplist(inputs)};
+  case RDB_TYPE_ZSET_LISTPACK:
+    return SortedSetValue{read_listpack(inputs)};
+  case RDB_TYPE_HASH: {
+    std::unordered_map<std::string, std::string> hash{};
+    const auto length = parse_length_encoded_integer(inputs);
+    hash.reserve(length);
+    for (std::uint64_t i = 0; i < length; ++i) {
+      auto field = parse_length_encoded_string(inputs);
+      hash.insert_or_assign(std::move(field),
+                            parse_length_encoded_string(inputs));
+    }
+    return HashValue{std::move(hash)};
+  }
+  case RDB_TYPE_HASH_ZIPMAP:
+    return HashValue{read_encoded_blob(
+        inputs,
+        [](const std::string &bytes) { return zipmap_to_listpack(bytes); },
+        "zipmap")};
+  case RDB_TYPE_HASH_ZIPLIST:
+    return HashValue{read_ziplist(inputs)};
+  case RDB_TYPE_HASH_LISTPACK:
+    return HashValue{read_listpack(inputs)};
+  case RDB_TYPE_STREAM_LISTPACKS:
+  case RDB_TYPE_STREAM_LISTPACKS_2:
+  case RDB_TYPE_STREAM_LISTPACKS_3:
+    return read_stream(value_type, inputs);
+  default:
+    // TODO module values.
+    std::cerr << "Got unsupported value type: " << std::to_string(value_type)
+              << std::endl;
+    std::terminate();
+  }
+}
+
+// Hands each key-value pair to the callback as soon as it is read. The
+// returned sections are left empty, they only mark which sections we saw.
+std::vector<DatabaseSection>
+read_rdb_database_sections(std::istream &inputs,
+                           const RdbEntryCallback &on_entry) {
   std::vector<DatabaseSection> db_sections{};
   // Read each database section
   while (is_opcode_section(RDB_DB_SELECTOR, inputs)) {
-    DatabaseSection db_section{};
     // Double check that the db number it's saying we're in inputs the correct
-    // one.
-    const auto db_number = static_cast<std::uint8_t>(inputs.get());
-    if (!inputs.good()) {
-      std::cerr << "Unable to read DB number" << std::endl;
-      std::terminate();
-    }
-    if (db_number != db_sections.size()) {
+    // one. Empty databases are skipped, so the numbers only need to increase.
+    const auto db_number = parse_length_encoded_integer(inputs);
+    if (db_number < db_sections.size()) {
       std::cerr << "Invalid db number encountered: "
                 << std::to_string(db_number) << std::endl;
       std::terminate();
     }
+    db_sections.resize(db_number);
     // Expect the hash table size section and read the sizes.
     if (!is_opcode_section(RDB_RESIZE, inputs)) {
       std::cerr << "Expected RDB_RESIZE opcode" << std::endl;
       std::terminate();
     }
-    const std::uint32_t num_key_value_pairs =
+    const std::uint64_t num_key_value_pairs =
+        parse_length_encoded_integer(inputs);
+    [[maybe_unused]] const std::uint64_t num_expiry_pairs =
         parse_length_encoded_integer(inputs);
-    const std::uint32_t num_expiry_pairs = parse_length_encoded_integer(inputs);
-    std::uint32_t num_expiry_so_far = 0;
+    std::uint64_t num_expiry_so_far = 0;
     // Now read that many key-value pairs.
-    for (std::uint32_t i = 0; i < num_key_value_pairs; ++i) {
+    for (std::uint64_t i = 0; i < num_key_value_pairs; ++i) {
       Cache::ExpiryValueT expiry{std::nullopt};
       // Check for a possible expiry prefix.
       if (is_opcode_section(RDB_EXPIRE_TIME_S, inputs)) {
@@ -202,26 +549,26 @@ std::vector<DatabaseSection> read_rdb_database_sections(std::istream &inputs) {
             read_int_n_bytes<8>(inputs));
         ++num_expiry_so_far;
       }
+      // Skip the eviction hints, since we never evict keys.
+      if (is_opcode_section(RDB_IDLE, inputs)) {
+        parse_length_encoded_integer(inputs);
+      }
+      if (is_opcode_section(RDB_FREQ, inputs)) {
+        read_int_n_bytes<1>(inputs);
+      }
       // Read the value type.
       auto value_type = read_int_n_bytes<1>(inputs);
       // Read the string-encoded key.
       std::string key = parse_length_encoded_string(inputs);
-      // TODO we currently only support the "string encoding" value type.
-      if (value_type == 0) {
-        // Read value encoded as string.
-        std::string value = parse_length_encoded_string(inputs);
-        // Finally, we can populate this key-value pair possibly with an expiry.
-        db_section.data.emplace(key, Cache::EntryT{value, expiry});
-
-      } else {
-        std::cerr << "Got unsupported value type: "
-                  << std::to_string(value_type) << std::endl;
-        std::terminate();
-      }
+      auto value = read_rdb_value(value_type, inputs);
+      // Finally, we can hand over this key-value pair possibly with an
+      // expiry.
+      on_entry(db_number, std::move(key),
+               Cache::EntryT{std::move(value), expiry});
     }
-    // When done reading all the key-value pairs, save this DB section and move
-    // on to the next one.
-    db_sections.push_back(db_section);
+    // When done reading all the key-value pairs, move on to the next DB
+    // section.
+    db_sections.emplace_back();
 
     // Double-check that the promised number of expiry pairs were seen.
     assert(num_expiry_so_far == num_expiry_pairs &&
@@ -229,10 +576,12 @@ std::vector<DatabaseSection> read_rdb_database_sections(std::istream &inputs) {
   }
   return db_sections;
 }
-EndOfFile read_rdb_eof_section(std::istream &inputs) {
+EndOfFile read_rdb_eof_section(std::istream &inputs,
+                                const Crc64InputBuffer &checksummed_inputs) {
   if (is_opcode_section(RDB_EOF, inputs)) {
-    // TODO compute the actual CRC of the entire stream from start to this point
-    // so we can compare it. Read the recorded CRC.
+    // The checksum covers everything up to and including the EOF opcode.
+    const auto computed_crc = checksummed_inputs.checksum();
+    // Read the recorded CRC.
     std::array<std::uint8_t, 8> buf{};
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
     inputs.read(reinterpret_cast<char *>(buf.data()), 8);
@@ -240,12 +589,173 @@ EndOfFile read_rdb_eof_section(std::istream &inputs) {
       std::cerr << "Unable to read CRC 8 bytes" << std::endl;
       std::terminate();
     }
+    const auto recorded_crc =
+        bytes_to_int<8>(std::bit_cast<std::array<std::byte, 8>>(buf));
+    // A zero checksum means the file was written with checksums disabled.
+    if (recorded_crc != 0 && recorded_crc != computed_crc) {
+      std::cerr << "RDB checksum mismatch: recorded " << std::setbase(16)
+                << recorded_crc << " but computed " << computed_crc
+                << std::setbase(10) << std::endl;
+      std::terminate();
+    }
     return EndOfFile{.crc64 = buf};
   }
   std::cerr << "Unable to read End of File section" << std::endl;
   std::terminate();
 }
 
+// Writes the length followed by each element as a string.
+template <typename Container>
+void write_string_collection(std::ostream &outputs,
+                             const Container &container) {
+  write_length_encoded_integer(outputs,
+                               static_cast<std::uint32_t>(container.size()));
+  for (const auto &element : container) {
+    write_length_encoded_string(outputs, element);
+  }
+}
+
+// Values are written in the encoding they have in memory, so the compact ones
+// are a plain copy.
+std::uint8_t rdb_value_type(const Cache::ValueT &value) {
+  return std::visit(
+      ValueVisitor{
+          [](const std::string &) { return RDB_TYPE_STRING; },
+          [](const ListValue &) { return RDB_TYPE_LIST_QUICKLIST_2; },
+          [](const SetValue &set) {
+            return std::visit(
+                ValueVisitor{
+                    [](const IntSet &) { return RDB_TYPE_SET_INTSET; },
+                    [](const Listpack &) { return RDB_TYPE_SET_LISTPACK; },
+                    [](const auto &) { return RDB_TYPE_SET; },
+                },
+                set);
+          },
+          [](const SortedSetValue &sorted_set) {
+            return std::holds_alternative<Listpack>(sorted_set)
+                       ? RDB_TYPE_ZSET_LISTPACK
+                       : RDB_TYPE_ZSET_2;
+          },
+          [](const HashValue &hash) {
+            return std::holds_alternative<Listpack>(hash)
+                       ? RDB_TYPE_HASH_LISTPACK
+                       : RDB_TYPE_HASH;
+          },
+          [](const StreamValue &) { return RDB_TYPE_STREAM_LISTPACKS_3; },
+      },
+      value);
+}
+
+void write_rdb_value(std::ostream &outputs, const Cache::ValueT &value) {
+  const auto write_blob = [&outputs](const auto &encoded) {
+    write_length_encoded_string(outputs, encoded.bytes());
+  };
+  std::visit(
+      ValueVisitor{
+          [&outputs](const std::string &str) {
+            write_length_encoded_string(outputs, str);
+          },
+          [&outputs, &write_blob](const ListValue &list) {
+            write_length_encoded_integer(
+                outputs, static_cast<std::uint32_t>(list.nodes().size()));
+            for (const auto &node : list.nodes()) {
+              write_length_encoded_integer(outputs, QUICKLIST_NODE_PACKED);
+              write_blob(node);
+            }
+          },
+          [&outputs, &write_blob](const SetValue &set) {
+            std::visit(ValueVisitor{
+                           [&write_blob](const IntSet &intset) {
+                             write_blob(intset);
+                           },
+                           [&write_blob](const Listpack &listpack) {
+                             write_blob(listpack);
+                           },
+                           [&outputs](const auto &members) {
+                             write_string_collection(outputs, members);
+                           },
+                       },
+                       set);
+          },
+          [&outputs, &write_blob](const SortedSetValue &sorted_set) {
+            std::visit(
+                ValueVisitor{
+                    [&write_blob](const Listpack &listpack) {
+                      write_blob(listpack);
+                    },
+                    [&outputs](const SortedSetTable &table) {
+                      write_length_encoded_integer(
+                          outputs,
+                          static_cast<std::uint32_t>(table.size()));
+                      for (const auto *node = table.ordered().first();
+                           node != nullptr; node = node->next()) {
+                        write_length_encoded_string(outputs, node->member());
+                        write_int_n_bytes<8>(outputs,
+                                             std::bit_cast<std::uint64_t>(
+                                                 node->score()));
+                      }
+                    },
+                },
+                sorted_set);
+          },
+          [&outputs, &write_blob](const HashValue &hash) {
+            std::visit(ValueVisitor{
+                           [&write_blob](const Listpack &listpack) {
+                             write_blob(listpack);
+                           },
+                           [&outputs](const auto &fields) {
+                             write_length_encoded_integer(
+                                 outputs,
+                                 static_cast<std::uint32_t>(fields.size()));
+                             for (const auto &[field, field_value] : fields) {
+                               write_length_encoded_string(outputs, field);
+                               write_length_encoded_string(outputs,
+                                                           field_value);
+                             }
+                           },
+                       },
+                       hash);
+          },
+          [&outputs, &write_blob](const StreamValue &stream) {
+            const auto write_id = [&outputs](StreamId id) {
+              write_length_encoded_integer(outputs, id.ms);
+              write_length_encoded_integer(outputs, id.seq);
+            };
+            const auto &blocks = stream.blocks();
+            write_length_encoded_integer(outputs, blocks.size());
+            for (auto block = blocks.first(); block;) {
+              write_length_encoded_string(outputs, block->first);
+              write_blob(*block->second);
+              const auto next = StreamId::from_key(block->first).next();
+              block = next ? blocks.seek_ge(next->to_key()) : std::nullopt;
+            }
+            write_length_encoded_integer(outputs, stream.size());
+            write_id(stream.last_id());
+            write_id(stream.first_id());
+            write_id(stream.max_deleted_id());
+            write_length_encoded_integer(outputs, stream.entries_added());
+            // No consumer groups.
+            write_length_encoded_integer(outputs, 0);
+          },
+      },
+      value);
+}
+
+// Flushes the file's contents to disk. Returns false (with errno set) if that
+// failed.
+bool fsync_file(const std::filesystem::path &path) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const bool synced = fsync(fd) == 0;
+  const int saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return synced;
+}
+
 } // namespace
 
 // Parse only the bytes needed to determine the encoding and return the
@@ -287,14 +797,21 @@ StringEncoding parse_string_encoding(std::istream &inputs) {
         least_significant_byte;
     return LengthPrefixedString{length};
   }
-  // Discard the remaining 6 bits. The next 4 bytes represent the length. This
-  // covers lengths from 16384 to (2^32)-1.
+  // The remaining 6 bits say whether the next 4 or 8 bytes represent the
+  // length. Unlike the rest of the file, these are in big endian.
   case 0b10: {
-    const auto length = read_int_n_bytes<4>(inputs);
-    return LengthPrefixedString{length};
+    if (length_byte == std::byte{0x80}) {
+      return LengthPrefixedString{std::byteswap(read_int_n_bytes<4>(inputs))};
+    }
+    if (length_byte == std::byte{0x81}) {
+      return LengthPrefixedString{std::byteswap(read_int_n_bytes<8>(inputs))};
+    }
+    std::cerr << "Encountered unknown length encoding: " << std::setbase(16)
+              << std::to_integer<int>(length_byte) << std::endl;
+    std::terminate();
   }
-  // Special format. We only support "Integers as Strings". Expect 0, 1, or 2
-  // in the remaining 6 bits.
+  // Special format. Expect 0, 1, or 2 in the remaining 6 bits for "Integers as
+  // Strings", or 3 for an LZF compressed string.
   case 0b11: {
     std::byte string_encoding_bits = length_byte & std::byte{0x3F};
     switch (std::to_integer<std::uint8_t>(string_encoding_bits)) {
@@ -307,6 +824,9 @@ StringEncoding parse_string_encoding(std::istream &inputs) {
     // A 32 bit integer follows.
     case 2:
       return IntAsString::FOUR_BYTES;
+    // The compressed and decompressed lengths follow, then the data.
+    case 3:
+      return LzfCompressedString{};
     default:
       std::cerr << "Encountered unsupported string length encoding: "
                 << std::setbase(16)
@@ -323,7 +843,7 @@ StringEncoding parse_string_encoding(std::istream &inputs) {
   }
   return {};
 }
-std::uint32_t parse_length_encoded_integer(std::istream &inputs) {
+std::uint64_t parse_length_encoded_integer(std::istream &inputs) {
   // Parsing a length-encoded integer inputs just like that of a string, except
   // the length of the string ends up being the integer we want, so we can just
   // return that.
@@ -345,16 +865,19 @@ std::string parse_length_encoded_string(std::istream &inputs) {
                           return read_string_n_bytes(inputs, length);
                         },
                         [&inputs](const IntAsString &int_as_string) {
-                          // Read the next N bytes as an integer, and convert to
-                          // a string.
+                          // Read the next N bytes as a signed integer, and
+                          // convert to a string.
                           if (int_as_string == IntAsString::ONE_BYTE) {
-                            return std::to_string(read_int_n_bytes<1>(inputs));
+                            return std::to_string(static_cast<std::int8_t>(
+                                read_int_n_bytes<1>(inputs)));
                           }
                           if (int_as_string == IntAsString::TWO_BYTES) {
-                            return std::to_string(read_int_n_bytes<2>(inputs));
+                            return std::to_string(static_cast<std::int16_t>(
+                                read_int_n_bytes<2>(inputs)));
                           }
                           if (int_as_string == IntAsString::FOUR_BYTES) {
-                            return std::to_string(read_int_n_bytes<4>(inputs));
+                            return std::to_string(static_cast<std::int32_t>(
+                                read_int_n_bytes<4>(inputs)));
                           }
                           std::cerr << "Unknown IntAsString enum: "
                                     << std::to_string(static_cast<std::uint8_t>(
@@ -362,6 +885,23 @@ std::string parse_length_encoded_string(std::istream &inputs) {
                                     << std::endl;
                           std::terminate();
                         },
+                        [&inputs](const LzfCompressedString &) {
+                          const auto compressed_length =
+                              parse_length_encoded_integer(inputs);
+                          const auto length =
+                              parse_length_encoded_integer(inputs);
+                          auto decompressed = lzf_decompress(
+                              read_string_n_bytes(
+                                  inputs, static_cast<std::streamsize>(
+                                              compressed_length)),
+                              length);
+                          if (!decompressed) {
+                            std::cerr << "Unable to decompress LZF string"
+                                      << std::endl;
+                            std::terminate();
+                          }
+                          return std::move(*decompressed);
+                        },
                         [](const auto &) {
                           std::cerr << "Unknown StringEncoding variant"
                                     << std::endl;
@@ -370,40 +910,329 @@ std::string parse_length_encoded_string(std::istream &inputs) {
                     },
                     string_encoding);
 }
-RDB read_rdb(std::istream &inputs) {
+RDB read_rdb(std::istream &raw_inputs, const RdbEntryCallback &on_entry) {
+  // Parse through a buffer that checksums every byte as it is consumed, so we
+  // can verify the file without a second pass over it.
+  Crc64InputBuffer checksummed_inputs(raw_inputs.rdbuf());
+  std::istream inputs(&checksummed_inputs);
   // Read these sections in this particular sequence.
   auto header = read_rdb_header(inputs);
   auto metadata = read_rdb_metadata(inputs);
-  auto db_sections = read_rdb_database_sections(inputs);
-  auto eof_section = read_rdb_eof_section(inputs);
+  auto db_sections = read_rdb_database_sections(inputs, on_entry);
+  auto eof_section = read_rdb_eof_section(inputs, checksummed_inputs);
+  // The RDB file may be followed by other data (like the commands in an
+  // append-only file), so leave the stream right after the end of it.
+  checksummed_inputs.give_back_unread();
   return RDB{.header = header,
              .metadata = metadata,
-             .database_sections = db_sections,
+             .database_sections = std::move(db_sections),
              .eof = eof_section};
 }
 
-Cache load_cache(const Config &config) {
+RDB read_rdb(std::istream &inputs) {
+  std::vector<DatabaseSection> db_sections{};
+  auto rdb = read_rdb(inputs, [&db_sections](std::size_t db_number,
+                                             Cache::KeyT key,
+                                             Cache::EntryT entry) {
+    if (db_sections.size() <= db_number) {
+      db_sections.resize(db_number + 1);
+    }
+    db_sections[db_number].data.emplace(std::move(key), std::move(entry));
+  });
+  // Keep any (empty) sections we saw that had no entries.
+  db_sections.resize(
+      std::max(db_sections.size(), rdb.database_sections.size()));
+  rdb.database_sections = std::move(db_sections);
+  return rdb;
+}
+
+RDB read_rdb_into_databases(std::istream &inputs, std::span<Cache> databases,
+                            LoadingProgress *progress) {
+  // Move the entries into their database in batches as they are parsed, so
+  // that (when loading asynchronously) they can be served before we are done.
+  std::unordered_map<Cache::KeyT, Cache::EntryT> batch{};
+  std::size_t batch_db_number = 0;
+  const auto flush_batch = [&] {
+    const auto batch_size = batch.size();
+    databases[batch_db_number].insert(std::move(batch));
+    batch.clear();
+    if (progress) {
+      progress->loaded_keys += batch_size;
+      // Once the whole file is consumed the stream can't report a position.
+      const auto position = inputs.tellg();
+      progress->loaded_bytes = position < 0
+                                   ? progress->total_bytes.load()
+                                   : static_cast<std::uint64_t>(position);
+    }
+  };
+  auto rdb = read_rdb(inputs, [&](std::size_t db_number, Cache::KeyT key,
+                                  Cache::EntryT entry) {
+    if (db_number >= databases.size()) {
+      std::cerr << "The RDB file has a key in database " << db_number
+                << ", but we only have " << databases.size()
+                << " databases (see --databases)" << std::endl;
+      std::terminate();
+    }
+    if (db_number != batch_db_number) {
+      flush_batch();
+      batch_db_number = db_number;
+    }
+    batch.insert_or_assign(std::move(key), std::move(entry));
+    if (batch.size() >= LOADING_BATCH_SIZE) {
+      flush_batch();
+    }
+  });
+  flush_batch();
+  return rdb;
+}
+
+void load_cache(const Config &config, std::span<Cache> databases,
+                LoadingProgress *progress) {
+  // The append-only file is the more up-to-date of the two, so like Redis we
+  // prefer it over the RDB file when it is enabled.
+  if (config.appendonly &&
+      load_aof(aof_path(config), config, databases, progress)) {
+    return;
+  }
   if (config.dbfilename && config.dir) {
     const auto filepath = std::filesystem::path(*config.dir) /
                           std::filesystem::path(*config.dbfilename);
     std::cout << "Reading RDB from file: " << filepath << std::endl;
     auto file_contents = read_file(filepath);
     if (!file_contents) {
-      return Cache{};
+      return;
+    }
+    if (progress) {
+      progress->total_bytes = std::filesystem::file_size(filepath);
     }
-    auto rdb = read_rdb(*file_contents);
+    const auto rdb =
+        read_rdb_into_databases(*file_contents, databases, progress);
+    // Redis doesn't write any database sections when there are no keys.
     if (rdb.database_sections.size() == 0) {
-      std::cerr
-          << "Expected to find at least one Database section in RDB file: "
-          << filepath << std::endl;
-      std::terminate();
-    } else {
-      if (rdb.database_sections.size() > 1) {
-        std::cout << "Found more than one database sections: "
-                  << rdb.database_sections.size() << std::endl;
+      std::cout << "Found no database sections in RDB file: " << filepath
+                << std::endl;
+    }
+  }
+}
+
+void write_length_encoded_integer(std::ostream &outputs, std::uint64_t length) {
+  // The mirror image of parse_string_encoding(): use the smallest of the four
+  // length encodings that fits.
+  if (length < (1U << 6U)) {
+    outputs.put(static_cast<char>(length));
+  } else if (length < (1U << 14U)) {
+    outputs.put(static_cast<char>((length >> 8U) | 0x40U));
+    outputs.put(static_cast<char>(length & 0xFFU));
+  } else if (length <= UINT32_MAX) {
+    outputs.put(static_cast<char>(0x80));
+    write_int_n_bytes<4>(outputs,
+                         std::byteswap(static_cast<std::uint32_t>(length)));
+  } else {
+    outputs.put(static_cast<char>(0x81));
+    write_int_n_bytes<8>(outputs, std::byteswap(length));
+  }
+}
+
+void write_length_encoded_string(std::ostream &outputs,
+                                 const std::string &str) {
+  // Integers that fit in 32 bits are stored with the compact "Integers as
+  // Strings" encoding, as long as reading them back gives the same string.
+  const auto as_int = parse_canonical_int(str);
+  if (as_int.has_value()) {
+    if (*as_int >= INT8_MIN && *as_int <= INT8_MAX) {
+      outputs.put(static_cast<char>(0xC0));
+      write_int_n_bytes<1>(outputs, static_cast<std::uint8_t>(*as_int));
+      return;
+    }
+    if (*as_int >= INT16_MIN && *as_int <= INT16_MAX) {
+      outputs.put(static_cast<char>(0xC1));
+      write_int_n_bytes<2>(outputs, static_cast<std::uint16_t>(*as_int));
+      return;
+    }
+    if (*as_int >= INT32_MIN && *as_int <= INT32_MAX) {
+      outputs.put(static_cast<char>(0xC2));
+      write_int_n_bytes<4>(outputs, static_cast<std::uint32_t>(*as_int));
+      return;
+    }
+  }
+  write_length_encoded_integer(outputs,
+                               static_cast<std::uint32_t>(str.size()));
+  outputs.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+void write_rdb(std::ostream &outputs, std::span<const Cache> databases) {
+  // Take a copy of the entries first so we only hold each cache lock for the
+  // duration of its copy.
+  write_rdb(outputs, snapshot_databases(databases));
+}
+
+void write_rdb(std::ostream &outputs, const Cache &cache) {
+  write_rdb(outputs, std::span(&cache, 1));
+}
+
+std::vector<Cache::SnapshotT>
+snapshot_databases(std::span<const Cache> databases) {
+  std::vector<Cache::SnapshotT> snapshots{};
+  snapshots.reserve(databases.size());
+  std::transform(databases.begin(), databases.end(),
+                 std::back_inserter(snapshots),
+                 [](const Cache &cache) { return cache.snapshot(); });
+  return snapshots;
+}
+
+void write_rdb(std::ostream &raw_outputs,
+               const std::vector<Cache::SnapshotT> &databases) {
+  // Write through a buffer that checksums every byte on its way out.
+  Crc64OutputBuffer checksummed_outputs(raw_outputs.rdbuf());
+  std::ostream outputs(&checksummed_outputs);
+
+  // Header.
+  outputs << RDB_MAGIC << RDB_WRITE_VERSION;
+
+  // Metadata.
+  const auto write_aux = [&outputs](const std::string &key,
+                                    const std::string &value) {
+    outputs.put(std::to_integer<char>(RDB_AUX));
+    write_length_encoded_string(outputs, key);
+    write_length_encoded_string(outputs, value);
+  };
+  write_aux("redis-ver", "7.2.0");
+  write_aux("redis-bits", std::to_string(sizeof(void *) * 8));
+  write_aux("ctime",
+            std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now()
+                                   .time_since_epoch())
+                               .count()));
+
+  // One database section for each database, skipping the empty ones like
+  // Redis does.
+  for (std::size_t db_number = 0; db_number < databases.size(); ++db_number) {
+    const auto &entries = databases[db_number];
+    if (entries.empty()) {
+      continue;
+    }
+    const auto num_expiry_pairs = static_cast<std::uint32_t>(
+        std::count_if(entries.cbegin(), entries.cend(), [](const auto &entry) {
+          return entry.second.second.has_value();
+        }));
+    outputs.put(std::to_integer<char>(RDB_DB_SELECTOR));
+    write_length_encoded_integer(outputs,
+                                 static_cast<std::uint32_t>(db_number));
+    outputs.put(std::to_integer<char>(RDB_RESIZE));
+    write_length_encoded_integer(outputs,
+                                 static_cast<std::uint32_t>(entries.size()));
+    write_length_encoded_integer(outputs, num_expiry_pairs);
+    for (const auto &[key, entry] : entries) {
+      const auto &[value, expiry] = entry;
+      if (expiry.has_value()) {
+        outputs.put(std::to_integer<char>(RDB_EXPIRE_TIME_MS));
+        const auto unix_time_ms =
+            steady_clock_to_unix_timestamp<std::chrono::milliseconds>(
+                *expiry);
+        write_int_n_bytes<8>(outputs,
+                             static_cast<std::uint64_t>(unix_time_ms));
       }
-      return Cache(rdb.database_sections.front().data);
+      outputs.put(static_cast<char>(rdb_value_type(value)));
+      write_length_encoded_string(outputs, key);
+      write_rdb_value(outputs, value);
     }
   }
-  return Cache{};
-};
\ No newline at end of file
+
+  // End of file section, followed by the checksum of everything before it.
+  outputs.put(std::to_integer<char>(RDB_EOF));
+  write_int_n_bytes<8>(outputs, checksummed_outputs.checksum());
+  outputs.flush();
+}
+
+std::string dump_value(const Cache::ValueT &value) {
+  std::ostringstream outputs{};
+  outputs.put(static_cast<char>(rdb_value_type(value)));
+  write_rdb_value(outputs, value);
+  write_int_n_bytes<2>(outputs, DUMP_RDB_VERSION);
+  auto payload = std::move(outputs).str();
+  std::ostringstream checksum{};
+  write_int_n_bytes<8>(checksum, crc64(0, payload));
+  return payload + checksum.str();
+}
+
+std::optional<Cache::ValueT> restore_value(std::string_view payload) {
+  constexpr std::size_t FOOTER_SIZE = 2 + 8;
+  if (payload.size() <= FOOTER_SIZE) {
+    return std::nullopt;
+  }
+  const auto body = payload.substr(0, payload.size() - 8);
+  std::istringstream footer(std::string(payload.substr(body.size() - 2)));
+  const auto version = read_int_n_bytes<2>(footer);
+  const auto checksum = read_int_n_bytes<8>(footer);
+  if (version > DUMP_RDB_VERSION || checksum != crc64(0, body)) {
+    return std::nullopt;
+  }
+  // Past the checksum, the value is trusted to be well formed (like values
+  // in RDB files are), as long as it is of a type we know.
+  const auto value_type = static_cast<std::uint8_t>(body.front());
+  if (value_type > RDB_TYPE_STREAM_LISTPACKS_3 ||
+      (value_type > RDB_TYPE_ZSET_2 && value_type < RDB_TYPE_HASH_ZIPMAP)) {
+    return std::nullopt;
+  }
+  // The value is between its type byte and the version.
+  std::istringstream inputs(std::string(body.substr(1, body.size() - 3)));
+  auto value = read_rdb_value(value_type, inputs);
+  if (inputs.peek() != std::char_traits<char>::eof()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+bool save_cache(const Config &config, std::span<const Cache> databases) {
+  if (!config.dbfilename || !config.dir) {
+    std::cerr << "Cannot save RDB file without --dir and --dbfilename"
+              << std::endl;
+    return false;
+  }
+  const auto filepath = std::filesystem::path(*config.dir) /
+                        std::filesystem::path(*config.dbfilename);
+  // Write to a temporary file in the same directory and rename it over the
+  // real one once it's on disk, which is atomic on POSIX filesystems.
+  auto temp_filepath = filepath;
+  temp_filepath += ".tmp-" + std::to_string(getpid());
+  const auto abandon = [&temp_filepath](const std::string &reason) {
+    std::cerr << "Failed to save RDB file at " << temp_filepath << ": "
+              << reason << std::endl;
+    std::error_code error{};
+    std::filesystem::remove(temp_filepath, error);
+    return false;
+  };
+  {
+    std::ofstream file(temp_filepath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return abandon("could not open it for writing");
+    }
+    write_rdb(file, databases);
+    file.close();
+    if (!file) {
+      return abandon("could not write it");
+    }
+  }
+  if (!fsync_file(temp_filepath)) {
+    return abandon(std::system_category().message(errno));
+  }
+  std::error_code error{};
+  std::filesystem::rename(temp_filepath, filepath, error);
+  if (error) {
+    return abandon("could not rename it to " + filepath.string() + ": " +
+                   error.message());
+  }
+  fsync_directory(filepath.parent_path().empty() ? "."
+                                                 : filepath.parent_path());
+  std::cout << "Saved RDB to file: " << filepath << std::endl;
+  return true;
+}
+
+void fsync_directory(const std::filesystem::path &dir) {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+  const int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+}
@@ -2,11 +2,20 @@
 
 // System includes.
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <istream>
 #include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
 // Our library's header includes.
@@ -22,7 +31,36 @@ constexpr std::byte RDB_EXPIRE_TIME_S{0xFD};
 constexpr std::byte RDB_EXPIRE_TIME_MS{0xFC};
 constexpr std::byte RDB_RESIZE{0xFB};
 constexpr std::byte RDB_AUX{0xFA}; // Auxiliary fields (AKA metadata fields).
+// Eviction hints (LRU idle time and LFU frequency) that may precede a key.
+constexpr std::byte RDB_IDLE{0xF8};
+constexpr std::byte RDB_FREQ{0xF9};
+// Value types, see https://github.com/redis/redis/blob/unstable/src/rdb.h
+constexpr std::uint8_t RDB_TYPE_STRING = 0;
+constexpr std::uint8_t RDB_TYPE_LIST = 1;
+constexpr std::uint8_t RDB_TYPE_SET = 2;
+constexpr std::uint8_t RDB_TYPE_ZSET = 3;
+constexpr std::uint8_t RDB_TYPE_HASH = 4;
+constexpr std::uint8_t RDB_TYPE_ZSET_2 = 5;
+constexpr std::uint8_t RDB_TYPE_HASH_ZIPMAP = 9;
+constexpr std::uint8_t RDB_TYPE_LIST_ZIPLIST = 10;
+constexpr std::uint8_t RDB_TYPE_SET_INTSET = 11;
+constexpr std::uint8_t RDB_TYPE_ZSET_ZIPLIST = 12;
+constexpr std::uint8_t RDB_TYPE_HASH_ZIPLIST = 13;
+constexpr std::uint8_t RDB_TYPE_LIST_QUICKLIST = 14;
+constexpr std::uint8_t RDB_TYPE_STREAM_LISTPACKS = 15;
+constexpr std::uint8_t RDB_TYPE_HASH_LISTPACK = 16;
+constexpr std::uint8_t RDB_TYPE_ZSET_LISTPACK = 17;
+constexpr std::uint8_t RDB_TYPE_LIST_QUICKLIST_2 = 18;
+constexpr std::uint8_t RDB_TYPE_STREAM_LISTPACKS_2 = 19;
+constexpr std::uint8_t RDB_TYPE_SET_LISTPACK = 20;
+constexpr std::uint8_t RDB_TYPE_STREAM_LISTPACKS_3 = 21;
+// How each node of a RDB_TYPE_LIST_QUICKLIST_2 list is stored: a single
+// element on its own, or a listpack of elements.
+constexpr std::uint64_t QUICKLIST_NODE_PLAIN = 1;
+constexpr std::uint64_t QUICKLIST_NODE_PACKED = 2;
 constexpr auto RDB_MAGIC = "REDIS";
+// The version we write out when saving an RDB file.
+constexpr auto RDB_WRITE_VERSION = "0011";
 // If we detect the RDB file has a version lower than this, we bail.
 constexpr auto MIN_SUPPORTED_RDB_VERSION = 7;
 // The two most-significant bits encode the length.
@@ -46,6 +84,9 @@ struct DatabaseSection {
   std::unordered_map<Cache::KeyT, Cache::EntryT> data;
 };
 struct EndOfFile {
+  // The checksum recorded in the file. It is verified against the CRC64 of all
+  // the preceding bytes while reading, unless it is zero (meaning the writer
+  // had checksums disabled).
   std::array<std::uint8_t, 8> crc64{};
 };
 
@@ -57,23 +98,85 @@ struct RDB {
   EndOfFile eof{};
 };
 
-std::uint32_t parse_length_encoded_integer(std::istream &inputs);
+// Tracks how far along we are in loading the dataset from disk, so it can be
+// reported (e.g. by INFO) while the loading happens in the background.
+struct LoadingProgress {
+  std::atomic<bool> in_progress = false;
+  std::chrono::system_clock::time_point start_time{};
+  std::atomic<std::uint64_t> total_bytes = 0;
+  std::atomic<std::uint64_t> loaded_bytes = 0;
+  std::atomic<std::uint64_t> loaded_keys = 0;
+};
+
+// Called with every key-value pair in the order they are read from an RDB
+// file.
+using RdbEntryCallback = std::function<void(
+    std::size_t db_number, Cache::KeyT key, Cache::EntryT entry)>;
+
+std::uint64_t parse_length_encoded_integer(std::istream &inputs);
 std::string parse_length_encoded_string(std::istream &inputs);
 RDB read_rdb(std::istream &inputs);
-Cache load_cache(const Config &config);
+// Streams the key-value pairs to the callback instead of collecting them, so
+// the database sections in the returned RDB are empty.
+RDB read_rdb(std::istream &inputs, const RdbEntryCallback &on_entry);
+// Reads the RDB file straight into the databases (indexed by database
+// number), moving the entries in batches as they are read and keeping the
+// progress (if given) up to date.
+RDB read_rdb_into_databases(std::istream &inputs, std::span<Cache> databases,
+                            LoadingProgress *progress = nullptr);
+// Populates the (empty) databases from disk: from the append-only file if it
+// is enabled, otherwise from the RDB file (if one is configured). Entries
+// become visible in the databases in batches as they are read, and the
+// progress (if given) is kept up to date along the way.
+void load_cache(const Config &config, std::span<Cache> databases,
+                LoadingProgress *progress = nullptr);
+
+void write_length_encoded_integer(std::ostream &outputs, std::uint64_t length);
+void write_length_encoded_string(std::ostream &outputs,
+                                 const std::string &str);
+// Writes out every unexpired entry in the databases (indexed by database
+// number) as a complete RDB file, including the trailing CRC64 checksum.
+void write_rdb(std::ostream &outputs, std::span<const Cache> databases);
+// Same as above, with the cache as the only database.
+void write_rdb(std::ostream &outputs, const Cache &cache);
+// Same as above, for entries already copied out of the databases.
+void write_rdb(std::ostream &outputs,
+               const std::vector<Cache::SnapshotT> &databases);
+// Takes a snapshot of each database, one after the other.
+std::vector<Cache::SnapshotT>
+snapshot_databases(std::span<const Cache> databases);
+// Writes the databases to the RDB file given in the config. The file is
+// replaced atomically once the new one is on disk, so a crash mid-save never
+// leaves a truncated file behind. Returns false if there is no RDB file
+// configured or the write failed.
+bool save_cache(const Config &config, std::span<const Cache> databases);
+// Makes a rename within the directory durable.
+void fsync_directory(const std::filesystem::path &dir);
+
+// Serializes the value like DUMP does: its RDB type byte and the value as it
+// is stored in an RDB file, then the RDB version (2 bytes) and the CRC64 of
+// everything before it (8 bytes), both little endian.
+std::string dump_value(const Cache::ValueT &value);
+// The value in a DUMP payload, or nullopt if the payload is corrupt or comes
+// from a newer RDB version than we write.
+std::optional<Cache::ValueT> restore_value(std::string_view payload);
 
-// TODO We currently only support two kinds of string encodings:
+// There are three kinds of string encodings:
 // 1. Strings with a length prefix.
 // 2. Special format "Integers as Strings", where you read 1, 2, or 4 bytes as
-// an int, then make it into a string. See
+// a signed int, then make it into a string.
+// 3. LZF compressed strings, where the compressed and decompressed lengths
+// follow, then the compressed data. See
 // https://rdb.fnordig.de/file_format.html#string-encoding for details.
-using LengthPrefixedString = std::uint32_t;
+using LengthPrefixedString = std::uint64_t;
 enum class IntAsString : std::uint8_t {
   ONE_BYTE,
   TWO_BYTES,
   FOUR_BYTES,
 };
-using StringEncoding = std::variant<LengthPrefixedString, IntAsString>;
+struct LzfCompressedString {};
+using StringEncoding =
+    std::variant<LengthPrefixedString, IntAsString, LzfCompressedString>;
 StringEncoding parse_string_encoding(std::istream &inputs);
 
 // helper type to create visitors for the StringEncoding variant.
@@ -0,0 +1,460 @@
+// This source file's own header include.
+#include "stream.hpp"
+
+// System includes.
+#include <algorithm>
+#include <charconv>
+#include <utility>
+#include <variant>
+
+// Our library's header includes.
+#include "utils.hpp"
+
+namespace {
+
+// Elements before the master entry's fields: count, deleted and num-fields.
+constexpr std::size_t MASTER_HEADER_SIZE = 3;
+
+std::optional<std::uint64_t> parse_uint(std::string_view str) {
+  std::uint64_t value = 0;
+  const auto [end, error] =
+      std::from_chars(str.data(), str.data() + str.size(), value);
+  if (str.empty() || error != std::errc{} || end != str.data() + str.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<std::int64_t> to_int(const Listpack::Element &element) {
+  if (const auto *value = std::get_if<std::int64_t>(&element)) {
+    return *value;
+  }
+  return parse_canonical_int(std::get<std::string_view>(element));
+}
+
+// Whether the element is the string, the way it was originally given.
+bool element_equals(const Listpack::Element &element, std::string_view str) {
+  if (const auto *value = std::get_if<std::string_view>(&element)) {
+    return *value == str;
+  }
+  return parse_canonical_int(str) == std::get<std::int64_t>(element);
+}
+
+// The elements of a block, and where each of its entries starts.
+struct DecodedBlock {
+  struct Entry {
+    StreamId id;
+    std::int64_t flags = 0;
+    // The index of the entry's flags element.
+    std::size_t index = 0;
+  };
+
+  std::vector<Listpack::Element> elements;
+  std::size_t num_master_fields = 0;
+  std::int64_t count = 0;
+  std::int64_t deleted = 0;
+  std::vector<Entry> entries;
+
+  // The entry's alternating fields and values.
+  [[nodiscard]] std::vector<std::string> fields(const Entry &entry) const {
+    std::vector<std::string> fields{};
+    if ((entry.flags & Stream::FLAG_SAME_FIELDS) != 0) {
+      fields.reserve(num_master_fields * 2);
+      for (std::size_t i = 0; i < num_master_fields; ++i) {
+        fields.push_back(
+            Listpack::to_string(elements[MASTER_HEADER_SIZE + i]));
+        fields.push_back(Listpack::to_string(elements[entry.index + 3 + i]));
+      }
+      return fields;
+    }
+    const auto num_fields =
+        static_cast<std::size_t>(*to_int(elements[entry.index + 3]));
+    fields.reserve(num_fields * 2);
+    for (std::size_t i = 0; i < num_fields * 2; ++i) {
+      fields.push_back(Listpack::to_string(elements[entry.index + 4 + i]));
+    }
+    return fields;
+  }
+};
+
+// Decodes the block whose first entry has the given ID, or returns nullopt
+// if it is malformed.
+std::optional<DecodedBlock> decode_block(const Listpack &block,
+                                         StreamId block_id) {
+  DecodedBlock decoded{};
+  auto &elements = decoded.elements;
+  elements.reserve(block.size());
+  block.for_each([&elements](const auto &element) {
+    elements.push_back(element);
+  });
+  // Listpacks store anything that looks like an integer as one, so the IDs
+  // and counts are never strings in practice.
+  const auto int_at = [&elements](std::size_t index,
+                                  bool allow_negative = false) {
+    const auto value = index < elements.size() ? to_int(elements[index])
+                                               : std::nullopt;
+    return value && (allow_negative || *value >= 0) ? value : std::nullopt;
+  };
+
+  const auto count = int_at(0);
+  const auto deleted = int_at(1);
+  const auto num_master_fields = int_at(2);
+  if (!count || !deleted || !num_master_fields) {
+    return std::nullopt;
+  }
+  decoded.count = *count;
+  decoded.deleted = *deleted;
+  decoded.num_master_fields = static_cast<std::size_t>(*num_master_fields);
+  decoded.entries.reserve(std::min<std::size_t>(
+      static_cast<std::size_t>(*count + *deleted), elements.size()));
+  // Skip the master entry's terminating 0.
+  std::size_t index = MASTER_HEADER_SIZE + decoded.num_master_fields + 1;
+  if (index > elements.size()) {
+    return std::nullopt;
+  }
+  while (index < elements.size()) {
+    const auto flags = int_at(index);
+    const auto ms_diff = int_at(index + 1, true);
+    const auto seq_diff = int_at(index + 2, true);
+    if (!flags || !ms_diff || !seq_diff) {
+      return std::nullopt;
+    }
+    // The IDs wrap around like the unsigned arithmetic Redis does.
+    const StreamId id{block_id.ms + static_cast<std::uint64_t>(*ms_diff),
+                      block_id.seq + static_cast<std::uint64_t>(*seq_diff)};
+    std::size_t num_elements = 3 + decoded.num_master_fields;
+    if ((*flags & Stream::FLAG_SAME_FIELDS) == 0) {
+      const auto num_fields = int_at(index + 3);
+      if (!num_fields) {
+        return std::nullopt;
+      }
+      num_elements = 4 + 2 * static_cast<std::size_t>(*num_fields);
+    }
+    // Plus the lp-count.
+    if (index + num_elements + 1 > elements.size()) {
+      return std::nullopt;
+    }
+    decoded.entries.push_back({id, *flags, index});
+    index += num_elements + 1;
+  }
+  if (static_cast<std::size_t>(decoded.count + decoded.deleted) !=
+      decoded.entries.size()) {
+    return std::nullopt;
+  }
+  return decoded;
+}
+
+// Blocks in the tree are always well-formed.
+DecodedBlock decode_valid_block(const RadixTree<Listpack>::Entry &block) {
+  return *decode_block(*block.second, StreamId::from_key(block.first));
+}
+
+bool is_deleted(const DecodedBlock::Entry &entry) {
+  return (entry.flags & Stream::FLAG_DELETED) != 0;
+}
+
+} // namespace
+
+std::string StreamId::to_string() const {
+  return std::to_string(ms) + "-" + std::to_string(seq);
+}
+
+std::optional<StreamId> StreamId::parse(std::string_view str,
+                                        std::uint64_t default_seq) {
+  const auto dash = str.find('-');
+  const auto ms = parse_uint(str.substr(0, dash));
+  if (!ms) {
+    return std::nullopt;
+  }
+  if (dash == std::string_view::npos) {
+    return StreamId{*ms, default_seq};
+  }
+  const auto seq = parse_uint(str.substr(dash + 1));
+  if (!seq) {
+    return std::nullopt;
+  }
+  return StreamId{*ms, *seq};
+}
+
+std::string StreamId::to_key() const {
+  std::string key(16, '\0');
+  for (std::size_t i = 0; i < 8; ++i) {
+    key[7 - i] = static_cast<char>((ms >> (8 * i)) & 0xFFU);
+    key[15 - i] = static_cast<char>((seq >> (8 * i)) & 0xFFU);
+  }
+  return key;
+}
+
+StreamId StreamId::from_key(std::string_view key) {
+  StreamId id{};
+  for (std::size_t i = 0; i < 8; ++i) {
+    id.ms = (id.ms << 8U) | static_cast<unsigned char>(key[i]);
+    id.seq = (id.seq << 8U) | static_cast<unsigned char>(key[8 + i]);
+  }
+  return id;
+}
+
+std::optional<StreamId> StreamId::next() const {
+  if (seq < UINT64_MAX) {
+    return StreamId{ms, seq + 1};
+  }
+  if (ms < UINT64_MAX) {
+    return StreamId{ms + 1, 0};
+  }
+  return std::nullopt;
+}
+
+std::optional<StreamId> StreamId::prev() const {
+  if (seq > 0) {
+    return StreamId{ms, seq - 1};
+  }
+  if (ms > 0) {
+    return StreamId{ms - 1, UINT64_MAX};
+  }
+  return std::nullopt;
+}
+
+void Stream::append(StreamId id, std::span<const std::string> fields,
+                    std::size_t max_block_bytes,
+                    std::size_t max_block_entries) {
+  Listpack *block = nullptr;
+  StreamId block_id = id;
+  if (const auto last = blocks_.last()) {
+    std::int64_t num_entries = 0;
+    last->second->for_each(0, 2, [&num_entries](const auto &element) {
+      num_entries += to_int(element).value_or(0);
+    });
+    const bool full =
+        (max_block_bytes > 0 &&
+         last->second->bytes().size() >= max_block_bytes) ||
+        (max_block_entries > 0 &&
+         static_cast<std::size_t>(num_entries) >= max_block_entries);
+    if (!full) {
+      block = blocks_.find(last->first);
+      block_id = StreamId::from_key(last->first);
+    }
+  }
+  if (block == nullptr) {
+    // The first entry's fields become the master entry.
+    Listpack new_block{};
+    new_block.push_back(std::int64_t{0});
+    new_block.push_back(std::int64_t{0});
+    new_block.push_back(static_cast<std::int64_t>(fields.size() / 2));
+    for (std::size_t i = 0; i < fields.size(); i += 2) {
+      new_block.push_back(fields[i]);
+    }
+    new_block.push_back(std::int64_t{0});
+    blocks_.insert(id.to_key(), std::move(new_block));
+    block = blocks_.find(id.to_key());
+  }
+  append_to_block(*block, block_id, id, fields);
+  ++length_;
+  ++entries_added_;
+  last_id_ = id;
+}
+
+void Stream::append_to_block(Listpack &block, StreamId block_id, StreamId id,
+                             std::span<const std::string> fields) {
+  const auto num_fields = fields.size() / 2;
+  std::int64_t count = 0;
+  std::size_t num_master_fields = 0;
+  block.for_each(0, MASTER_HEADER_SIZE,
+                 [&, index = 0](const auto &element) mutable {
+                   if (index == 0) {
+                     count = to_int(element).value_or(0);
+                   } else if (index == 2) {
+                     num_master_fields =
+                         static_cast<std::size_t>(to_int(element).value_or(0));
+                   }
+                   ++index;
+                 });
+  bool same_fields = num_master_fields == num_fields;
+  if (same_fields) {
+    block.for_each(MASTER_HEADER_SIZE, num_master_fields,
+                   [&, index = std::size_t{0}](const auto &element) mutable {
+                     same_fields =
+                         same_fields && element_equals(element,
+                                                       fields[2 * index]);
+                     ++index;
+                   });
+  }
+
+  // The whole entry is appended in one go.
+  std::vector<Listpack::Element> elements{};
+  elements.reserve(fields.size() + 5);
+  elements.emplace_back(same_fields ? FLAG_SAME_FIELDS : FLAG_NONE);
+  elements.emplace_back(static_cast<std::int64_t>(id.ms - block_id.ms));
+  elements.emplace_back(static_cast<std::int64_t>(id.seq - block_id.seq));
+  if (same_fields) {
+    for (std::size_t i = 1; i < fields.size(); i += 2) {
+      elements.emplace_back(std::string_view(fields[i]));
+    }
+  } else {
+    elements.emplace_back(static_cast<std::int64_t>(num_fields));
+    for (const auto &field : fields) {
+      elements.emplace_back(std::string_view(field));
+    }
+  }
+  const auto lp_count = same_fields ? num_fields + 3 : 2 * num_fields + 4;
+  elements.emplace_back(static_cast<std::int64_t>(lp_count));
+  block.push_back(elements);
+  block.replace(0, std::to_string(count + 1));
+}
+
+std::vector<StreamEntry> Stream::range(StreamId first, StreamId last,
+                                       std::size_t count, bool reverse) const {
+  std::vector<StreamEntry> entries{};
+  if (first > last) {
+    return entries;
+  }
+  const auto is_done = [&entries, count] {
+    return count > 0 && entries.size() >= count;
+  };
+  if (!reverse) {
+    // Start from the block that would hold the first ID.
+    auto block = blocks_.seek_le(first.to_key());
+    if (!block) {
+      block = blocks_.seek_ge(first.to_key());
+    }
+    while (block && !is_done() && StreamId::from_key(block->first) <= last) {
+      const auto decoded = decode_valid_block(*block);
+      for (const auto &entry : decoded.entries) {
+        if (entry.id > last || is_done()) {
+          return entries;
+        }
+        if (!is_deleted(entry) && entry.id >= first) {
+          entries.push_back({entry.id, decoded.fields(entry)});
+        }
+      }
+      const auto next = StreamId::from_key(block->first).next();
+      if (!next) {
+        break;
+      }
+      block = blocks_.seek_ge(next->to_key());
+    }
+    return entries;
+  }
+
+  auto block = blocks_.seek_le(last.to_key());
+  while (block && !is_done()) {
+    const auto decoded = decode_valid_block(*block);
+    for (auto entry = decoded.entries.crbegin();
+         entry != decoded.entries.crend(); ++entry) {
+      if (entry->id < first || is_done()) {
+        return entries;
+      }
+      if (!is_deleted(*entry) && entry->id <= last) {
+        entries.push_back({entry->id, decoded.fields(*entry)});
+      }
+    }
+    const auto prev = StreamId::from_key(block->first).prev();
+    if (!prev) {
+      break;
+    }
+    block = blocks_.seek_le(prev->to_key());
+  }
+  return entries;
+}
+
+template <typename Predicate>
+std::size_t Stream::trim(Predicate &&should_remove, bool approximate) {
+  std::size_t removed = 0;
+  while (const auto block = blocks_.first()) {
+    const auto decoded = decode_valid_block(*block);
+    const auto live = static_cast<std::size_t>(decoded.count);
+    const auto newest = std::find_if(decoded.entries.crbegin(),
+                                     decoded.entries.crend(),
+                                     [](const auto &entry) {
+                                       return !is_deleted(entry);
+                                     });
+    // Drop the whole block if its newest entry goes.
+    if (newest == decoded.entries.crend() ||
+        should_remove(newest->id, length_ - live)) {
+      if (newest != decoded.entries.crend()) {
+        max_deleted_id_ = std::max(max_deleted_id_, newest->id);
+      }
+      length_ -= live;
+      removed += live;
+      blocks_.erase(block->first);
+      continue;
+    }
+    if (approximate) {
+      break;
+    }
+    // Otherwise flag its oldest entries as deleted, and stop there.
+    auto *listpack = blocks_.find(block->first);
+    std::int64_t flagged = 0;
+    for (const auto &entry : decoded.entries) {
+      if (is_deleted(entry)) {
+        continue;
+      }
+      if (!should_remove(entry.id, length_ - 1)) {
+        break;
+      }
+      listpack->replace(entry.index,
+                        std::to_string(entry.flags | FLAG_DELETED));
+      max_deleted_id_ = std::max(max_deleted_id_, entry.id);
+      --length_;
+      ++flagged;
+    }
+    if (flagged > 0) {
+      listpack->replace(0, std::to_string(decoded.count - flagged));
+      listpack->replace(1, std::to_string(decoded.deleted + flagged));
+      removed += static_cast<std::size_t>(flagged);
+    }
+    break;
+  }
+  return removed;
+}
+
+std::size_t Stream::trim_to_length(std::size_t max_length, bool approximate) {
+  return trim(
+      [max_length](StreamId /*id*/, std::size_t remaining) {
+        return remaining >= max_length;
+      },
+      approximate);
+}
+
+std::size_t Stream::trim_before(StreamId min_id, bool approximate) {
+  return trim([min_id](StreamId id,
+                       std::size_t /*remaining*/) { return id < min_id; },
+              approximate);
+}
+
+StreamId Stream::first_id() const {
+  const auto entries = range(StreamId{}, StreamId::max(), 1);
+  return entries.empty() ? StreamId{} : entries.front().id;
+}
+
+std::optional<Stream> Stream::from_blocks(RadixTree<Listpack> blocks,
+                                          StreamId last_id,
+                                          StreamId max_deleted_id,
+                                          std::uint64_t entries_added) {
+  Stream stream{};
+  for (auto block = blocks.first(); block;) {
+    if (block->first.size() != 16) {
+      return std::nullopt;
+    }
+    const auto block_id = StreamId::from_key(block->first);
+    const auto decoded = decode_block(*block->second, block_id);
+    if (!decoded) {
+      return std::nullopt;
+    }
+    stream.length_ += static_cast<std::size_t>(decoded->count);
+    const auto next = block_id.next();
+    block = next ? blocks.seek_ge(next->to_key()) : std::nullopt;
+  }
+  stream.blocks_ = std::move(blocks);
+  stream.last_id_ = last_id;
+  stream.max_deleted_id_ = max_deleted_id;
+  stream.entries_added_ = entries_added;
+  return stream;
+}
+
+bool Stream::operator==(const Stream &other) const {
+  return length_ == other.length_ && last_id_ == other.last_id_ &&
+         max_deleted_id_ == other.max_deleted_id_ &&
+         entries_added_ == other.entries_added_ &&
+         range(StreamId{}, StreamId::max()) ==
+             other.range(StreamId{}, StreamId::max());
+}
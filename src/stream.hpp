@@ -0,0 +1,129 @@
+#pragma once
+
+// System includes.
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Our library's header includes.
+#include "listpack.hpp"
+#include "radix_tree.hpp"
+
+// The ID of a stream entry: the unix time in milliseconds it was added at,
+// and a sequence number telling apart the entries added in the same
+// millisecond.
+struct StreamId {
+  std::uint64_t ms = 0;
+  std::uint64_t seq = 0;
+
+  auto operator<=>(const StreamId &other) const = default;
+
+  // Like "1526919030474-0".
+  [[nodiscard]] std::string to_string() const;
+  // Parses "<ms>-<seq>", or just "<ms>" with the given sequence number.
+  static std::optional<StreamId> parse(std::string_view str,
+                                       std::uint64_t default_seq = 0);
+
+  // The 16 bytes of the ID in big endian, so that the byte order of keys is
+  // the order of IDs.
+  [[nodiscard]] std::string to_key() const;
+  static StreamId from_key(std::string_view key);
+
+  // The IDs right after and right before this one, if there are any.
+  [[nodiscard]] std::optional<StreamId> next() const;
+  [[nodiscard]] std::optional<StreamId> prev() const;
+
+  static constexpr StreamId max() { return {UINT64_MAX, UINT64_MAX}; }
+};
+
+struct StreamEntry {
+  StreamId id;
+  // Alternating fields and values.
+  std::vector<std::string> fields;
+
+  bool operator==(const StreamEntry &other) const = default;
+};
+
+// An append-only log of entries, laid out like Redis streams: the entries
+// are packed into listpack blocks of up to a few KiB, and a radix tree maps
+// the ID of the first entry of each block to the block. Appending only ever
+// touches the last block, reading a range walks whole blocks front to back,
+// and every entry costs a few bytes on top of its fields and values instead
+// of a node of its own. Each block is:
+//   <count> <deleted> <num-fields> <field> ... <field> 0
+// (the "master entry", whose fields every entry is compared against) followed
+// by the entries:
+//   <flags> <ms-diff> <seq-diff> <num-fields> <field> <value> ... <lp-count>
+// or, when the fields are the same as the master entry's:
+//   <flags> <ms-diff> <seq-diff> <value> ... <lp-count>
+// where the IDs are relative to the first entry's, and lp-count is the number
+// of elements before it (so the block can be walked back to front). Trimmed
+// entries are only flagged as deleted until their whole block goes. See
+// https://github.com/redis/redis/blob/unstable/src/t_stream.c
+class Stream {
+public:
+  static constexpr std::int64_t FLAG_NONE = 0;
+  static constexpr std::int64_t FLAG_DELETED = 1;
+  static constexpr std::int64_t FLAG_SAME_FIELDS = 2;
+
+  // Appends the entry, whose ID must be bigger than last_id(). A new block
+  // is started once the last one has max_block_entries entries or is over
+  // max_block_bytes bytes (0 means no limit).
+  void append(StreamId id, std::span<const std::string> fields,
+              std::size_t max_block_bytes, std::size_t max_block_entries);
+
+  // The entries with IDs between first and last (inclusive), at most count
+  // of them (0 means all), in reverse order if asked to.
+  [[nodiscard]] std::vector<StreamEntry> range(StreamId first, StreamId last,
+                                               std::size_t count = 0,
+                                               bool reverse = false) const;
+
+  // Removes the oldest entries until at most max_length are left, or until
+  // none are older than min_id. Approximate trimming only removes whole
+  // blocks, which is much cheaper. Returns how many entries were removed.
+  std::size_t trim_to_length(std::size_t max_length, bool approximate);
+  std::size_t trim_before(StreamId min_id, bool approximate);
+
+  [[nodiscard]] std::size_t size() const { return length_; }
+  [[nodiscard]] bool empty() const { return length_ == 0; }
+  [[nodiscard]] StreamId last_id() const { return last_id_; }
+  // The ID of the oldest entry, or 0-0 if there is none.
+  [[nodiscard]] StreamId first_id() const;
+  // The biggest ID trimmed so far.
+  [[nodiscard]] StreamId max_deleted_id() const { return max_deleted_id_; }
+  // How many entries were ever added.
+  [[nodiscard]] std::uint64_t entries_added() const { return entries_added_; }
+
+  // The blocks, keyed by StreamId::to_key() of their first entry.
+  [[nodiscard]] const RadixTree<Listpack> &blocks() const { return blocks_; }
+
+  // Rebuilds a stream from its blocks and metadata (e.g. read from an RDB
+  // file). Returns nullopt if a block is malformed.
+  static std::optional<Stream>
+  from_blocks(RadixTree<Listpack> blocks, StreamId last_id,
+              StreamId max_deleted_id, std::uint64_t entries_added);
+
+  bool operator==(const Stream &other) const;
+
+private:
+  // Appends an entry that is not in the stream yet to the block, whose first
+  // entry has the given ID.
+  static void append_to_block(Listpack &block, StreamId block_id, StreamId id,
+                              std::span<const std::string> fields);
+
+  // Trims the oldest entries for which should_remove(id, remaining) is true,
+  // where remaining is how many entries would be left without this one.
+  template <typename Predicate>
+  std::size_t trim(Predicate &&should_remove, bool approximate);
+
+  RadixTree<Listpack> blocks_;
+  std::size_t length_ = 0;
+  StreamId last_id_;
+  StreamId max_deleted_id_;
+  std::uint64_t entries_added_ = 0;
+};
@@ -0,0 +1,501 @@
+// This source file's own header include.
+#include "stream_commands.hpp"
+
+// System includes.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Our library's header includes.
+#include "cache.hpp"
+#include "config.hpp"
+#include "redis_core.hpp"
+#include "utils.hpp"
+
+namespace {
+
+constexpr auto SYNTAX_ERROR = "ERR syntax error";
+constexpr auto INVALID_ID_ERROR =
+    "ERR Invalid stream ID specified as stream command argument";
+constexpr auto ID_TOO_SMALL_ERROR = "ERR The ID specified in XADD is equal or "
+                                    "smaller than the target stream top item";
+constexpr auto ID_ZERO_ERROR =
+    "ERR The ID specified in XADD must be greater than 0-0";
+constexpr auto IDS_EXHAUSTED_ERROR = "ERR The stream has exhausted the last "
+                                     "possible ID, unable to add more items";
+constexpr auto MAXLEN_ERROR = "ERR The MAXLEN argument must be >= 0.";
+constexpr auto XADD_ARITY_ERROR =
+    "ERR wrong number of arguments for 'xadd' command";
+constexpr auto NEGATIVE_TIMEOUT_ERROR = "ERR timeout is negative";
+constexpr auto XREAD_UNBALANCED_ERROR =
+    "ERR Unbalanced 'xread' list of streams: for each stream key an ID or "
+    "'$' must be specified.";
+
+Message integer_reply(std::uint64_t value) {
+  return Message{std::to_string(value), DataType::Integer};
+}
+
+// Each entry is an array of its ID and an array of its fields and values.
+Message entries_reply(const std::vector<StreamEntry> &entries) {
+  Message::NestedVariantT elements{};
+  elements.reserve(entries.size());
+  for (const auto &entry : entries) {
+    Message::NestedVariantT fields{};
+    fields.reserve(entry.fields.size());
+    for (const auto &field : entry.fields) {
+      fields.emplace_back(field, DataType::BulkString);
+    }
+    Message::NestedVariantT pair{};
+    pair.emplace_back(entry.id.to_string(), DataType::BulkString);
+    pair.emplace_back(std::move(fields), DataType::Array);
+    elements.emplace_back(std::move(pair), DataType::Array);
+  }
+  return Message{std::move(elements), DataType::Array};
+}
+
+// MAXLEN|MINID [=|~] threshold [LIMIT count]
+struct TrimOptions {
+  bool by_min_id = false;
+  bool approximate = false;
+  std::size_t max_length = 0;
+  StreamId min_id;
+};
+
+// Parses the trimming options starting at the index, and moves it past them.
+std::optional<Message> parse_trim_options(const std::vector<std::string> &args,
+                                          std::size_t &index,
+                                          TrimOptions &options) {
+  options.by_min_id = tolower(args[index]) == "minid";
+  ++index;
+  if (index < args.size() && (args[index] == "=" || args[index] == "~")) {
+    options.approximate = args[index] == "~";
+    ++index;
+  }
+  if (index >= args.size()) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  if (options.by_min_id) {
+    const auto min_id = StreamId::parse(args[index]);
+    if (!min_id) {
+      return Message{INVALID_ID_ERROR, DataType::SimpleError};
+    }
+    options.min_id = *min_id;
+  } else {
+    const auto max_length = parse_canonical_int(args[index]);
+    if (!max_length) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    if (*max_length < 0) {
+      return Message{MAXLEN_ERROR, DataType::SimpleError};
+    }
+    options.max_length = static_cast<std::size_t>(*max_length);
+  }
+  ++index;
+  // Approximate trimming always stops at block boundaries here, so the limit
+  // on how much work it may do is accepted but not needed.
+  if (index + 1 < args.size() && tolower(args[index]) == "limit") {
+    if (!parse_canonical_int(args[index + 1])) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    index += 2;
+  }
+  return std::nullopt;
+}
+
+std::size_t apply_trim(Stream &stream, const TrimOptions &options) {
+  return options.by_min_id
+             ? stream.trim_before(options.min_id, options.approximate)
+             : stream.trim_to_length(options.max_length, options.approximate);
+}
+
+// XADD key [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold [LIMIT count]]
+//   <* | id> field value [field value ...]
+struct AddOptions {
+  bool no_mkstream = false;
+  std::optional<TrimOptions> trim;
+  // The index of the ID argument, followed by the fields and values.
+  std::size_t id_index = 1;
+};
+
+std::optional<Message> parse_add_options(const std::vector<std::string> &args,
+                                         AddOptions &options) {
+  std::size_t index = 1;
+  while (index < args.size()) {
+    const auto option = tolower(args[index]);
+    if (option == "nomkstream") {
+      options.no_mkstream = true;
+      ++index;
+    } else if (option == "maxlen" || option == "minid") {
+      options.trim.emplace();
+      if (auto error = parse_trim_options(args, index, *options.trim)) {
+        return error;
+      }
+    } else {
+      break;
+    }
+  }
+  options.id_index = index;
+  const auto num_fields = args.size() - std::min(args.size(), index + 1);
+  if (num_fields == 0 || num_fields % 2 != 0) {
+    return Message{XADD_ARITY_ERROR, DataType::SimpleError};
+  }
+  return std::nullopt;
+}
+
+// Resolves the ID argument of XADD ("*", "<ms>-*" or "<ms>-<seq>") against
+// the last ID of the stream.
+std::optional<Message> resolve_add_id(std::string_view arg, StreamId last_id,
+                                      StreamId &id) {
+  if (arg == "*") {
+    const auto now = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    if (now > last_id.ms) {
+      id = StreamId{now, 0};
+      return std::nullopt;
+    }
+    const auto next = last_id.next();
+    if (!next) {
+      return Message{IDS_EXHAUSTED_ERROR, DataType::SimpleError};
+    }
+    id = *next;
+    return std::nullopt;
+  }
+  if (arg.ends_with("-*")) {
+    const auto ms = StreamId::parse(arg.substr(0, arg.size() - 2));
+    if (!ms || arg.substr(0, arg.size() - 2).contains('-')) {
+      return Message{INVALID_ID_ERROR, DataType::SimpleError};
+    }
+    if (ms->ms < last_id.ms) {
+      return Message{ID_TOO_SMALL_ERROR, DataType::SimpleError};
+    }
+    if (ms->ms > last_id.ms) {
+      id = StreamId{ms->ms, 0};
+      return std::nullopt;
+    }
+    if (last_id.seq == UINT64_MAX) {
+      return Message{ID_TOO_SMALL_ERROR, DataType::SimpleError};
+    }
+    id = StreamId{ms->ms, last_id.seq + 1};
+    return std::nullopt;
+  }
+  const auto parsed = StreamId::parse(arg);
+  if (!parsed) {
+    return Message{INVALID_ID_ERROR, DataType::SimpleError};
+  }
+  if (*parsed == StreamId{}) {
+    return Message{ID_ZERO_ERROR, DataType::SimpleError};
+  }
+  if (*parsed <= last_id) {
+    return Message{ID_TOO_SMALL_ERROR, DataType::SimpleError};
+  }
+  id = *parsed;
+  return std::nullopt;
+}
+
+Message add(const Command &command, const Config &config, Cache &cache) {
+  const auto &args = command.arguments;
+  AddOptions options{};
+  if (auto error = parse_add_options(args, options)) {
+    return std::move(*error);
+  }
+  return cache.update(args.front(), [&](std::optional<Value> &value) {
+    if (value && !std::holds_alternative<StreamValue>(*value)) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    if (!value && options.no_mkstream) {
+      return Message{"", DataType::NullBulkString};
+    }
+    const auto last_id =
+        value ? std::get<StreamValue>(*value).last_id() : StreamId{};
+    StreamId id{};
+    if (auto error = resolve_add_id(args[options.id_index], last_id, id)) {
+      return std::move(*error);
+    }
+    if (!value) {
+      value = StreamValue{};
+    }
+    auto *stream = &std::get<StreamValue>(*value);
+    stream->append(
+        id, std::span(args).subspan(options.id_index + 1),
+        config.stream_node_max_bytes, config.stream_node_max_entries);
+    if (options.trim) {
+      apply_trim(*stream, *options.trim);
+    }
+    return Message{id.to_string(), DataType::BulkString};
+  });
+}
+
+// Parses one end of an XRANGE interval: "-" and "+" for the smallest and
+// biggest IDs, "<ms>" for the first or last ID of that millisecond, and a
+// leading "(" to exclude the ID. Returns nullopt (with no error) if nothing
+// can be in the interval.
+std::optional<Message> parse_range_bound(std::string_view arg, bool is_start,
+                                         std::optional<StreamId> &bound) {
+  if (arg == "-" || arg == "+") {
+    bound = arg == "-" ? StreamId{} : StreamId::max();
+    return std::nullopt;
+  }
+  const bool exclusive = arg.starts_with('(');
+  if (exclusive) {
+    arg.remove_prefix(1);
+  }
+  const auto id = StreamId::parse(arg, is_start ? 0 : UINT64_MAX);
+  if (!id) {
+    return Message{INVALID_ID_ERROR, DataType::SimpleError};
+  }
+  bound = !exclusive ? id : is_start ? id->next() : id->prev();
+  return std::nullopt;
+}
+
+// XRANGE key start end [COUNT count], and XREVRANGE key end start [COUNT
+// count].
+Message range(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  const bool reverse = command.verb == CommandVerb::XRevRange;
+  std::optional<StreamId> first{};
+  std::optional<StreamId> last{};
+  if (auto error = parse_range_bound(args[reverse ? 2 : 1], true, first)) {
+    return std::move(*error);
+  }
+  if (auto error = parse_range_bound(args[reverse ? 1 : 2], false, last)) {
+    return std::move(*error);
+  }
+  std::size_t count = 0;
+  if (args.size() == 5 && tolower(args[3]) == "count") {
+    const auto parsed = parse_canonical_int(args[4]);
+    if (!parsed) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    if (*parsed <= 0) {
+      return entries_reply({});
+    }
+    count = static_cast<std::size_t>(*parsed);
+  } else if (args.size() != 3) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  return cache.read(args.front(), [&](const Value *value) {
+    if (value == nullptr || !first || !last) {
+      return entries_reply({});
+    }
+    const auto *stream = std::get_if<StreamValue>(value);
+    if (stream == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return entries_reply(stream->range(*first, *last, count, reverse));
+  });
+}
+
+// XLEN key
+Message length(const Command &command, Cache &cache) {
+  return cache.read(command.arguments.front(), [](const Value *value) {
+    if (value == nullptr) {
+      return integer_reply(0);
+    }
+    const auto *stream = std::get_if<StreamValue>(value);
+    if (stream == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return integer_reply(stream->size());
+  });
+}
+
+// XTRIM key MAXLEN|MINID [=|~] threshold [LIMIT count]
+Message trim(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  const auto strategy = tolower(args[1]);
+  if (strategy != "maxlen" && strategy != "minid") {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  std::size_t index = 1;
+  TrimOptions options{};
+  if (auto error = parse_trim_options(args, index, options)) {
+    return std::move(*error);
+  }
+  if (index != args.size()) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  return cache.update(args.front(), [&](std::optional<Value> &value) {
+    if (!value) {
+      return integer_reply(0);
+    }
+    auto *stream = std::get_if<StreamValue>(&*value);
+    if (stream == nullptr) {
+      return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+    }
+    return integer_reply(apply_trim(*stream, options));
+  });
+}
+
+// XREAD [COUNT count] [BLOCK milliseconds] STREAMS key [key ...] id [id ...]
+Message read(const Command &command, Cache &cache) {
+  const auto &args = command.arguments;
+  std::size_t count = 0;
+  std::size_t index = 0;
+  for (; index < args.size(); ++index) {
+    const auto option = tolower(args[index]);
+    if (option == "streams") {
+      break;
+    }
+    if ((option != "count" && option != "block") ||
+        index + 1 >= args.size()) {
+      return Message{SYNTAX_ERROR, DataType::SimpleError};
+    }
+    const auto parsed = parse_canonical_int(args[index + 1]);
+    if (!parsed) {
+      return Message{NOT_AN_INTEGER_ERROR, DataType::SimpleError};
+    }
+    // Waiting for entries with BLOCK is up to the server.
+    if (option == "count") {
+      count = static_cast<std::size_t>(std::max<std::int64_t>(*parsed, 0));
+    } else if (*parsed < 0) {
+      return Message{NEGATIVE_TIMEOUT_ERROR, DataType::SimpleError};
+    }
+    ++index;
+  }
+  if (index >= args.size()) {
+    return Message{SYNTAX_ERROR, DataType::SimpleError};
+  }
+  const auto streams = std::span(args).subspan(index + 1);
+  if (streams.empty() || streams.size() % 2 != 0) {
+    return Message{XREAD_UNBALANCED_ERROR, DataType::SimpleError};
+  }
+  const auto keys = streams.first(streams.size() / 2);
+  const auto ids = streams.last(streams.size() / 2);
+  // "$" means only entries added from now on, so it never matches anything
+  // here.
+  std::vector<std::optional<StreamId>> after(ids.size());
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] == "$") {
+      continue;
+    }
+    after[i] = StreamId::parse(ids[i]);
+    if (!after[i]) {
+      return Message{INVALID_ID_ERROR, DataType::SimpleError};
+    }
+  }
+
+  return cache.read_many(keys, [&](const std::vector<const Value *> &values) {
+    Message::NestedVariantT elements{};
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (values[i] == nullptr) {
+        continue;
+      }
+      const auto *stream = std::get_if<StreamValue>(values[i]);
+      if (stream == nullptr) {
+        return Message{WRONGTYPE_ERROR, DataType::SimpleError};
+      }
+      const auto first = after[i] ? after[i]->next() : std::nullopt;
+      if (!first) {
+        continue;
+      }
+      const auto entries = stream->range(*first, StreamId::max(), count);
+      if (entries.empty()) {
+        continue;
+      }
+      Message::NestedVariantT pair{};
+      pair.emplace_back(keys[i], DataType::BulkString);
+      pair.push_back(entries_reply(entries));
+      elements.emplace_back(std::move(pair), DataType::Array);
+    }
+    if (elements.empty()) {
+      return Message{"", DataType::NullBulkString};
+    }
+    return Message{std::move(elements), DataType::Array};
+  });
+}
+
+} // namespace
+
+std::optional<Message> handle_stream_command(const Command &command,
+                                             const Config &config,
+                                             Cache &cache) {
+  switch (command.verb) {
+  case CommandVerb::XAdd:
+    return add(command, config, cache);
+  case CommandVerb::XRange:
+  case CommandVerb::XRevRange:
+    return range(command, cache);
+  case CommandVerb::XLen:
+    return length(command, cache);
+  case CommandVerb::XTrim:
+    return trim(command, cache);
+  case CommandVerb::XRead:
+    return read(command, cache);
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<BlockingSpec> get_xread_blocking_spec(const Command &command) {
+  if (command.verb != CommandVerb::XRead) {
+    return std::nullopt;
+  }
+  const auto &args = command.arguments;
+  std::optional<std::int64_t> block_ms{};
+  std::size_t index = 0;
+  for (; index + 1 < args.size(); index += 2) {
+    const auto option = tolower(args[index]);
+    if (option == "streams") {
+      break;
+    }
+    if (option == "block") {
+      block_ms = parse_canonical_int(args[index + 1]);
+    }
+  }
+  if (!block_ms) {
+    return std::nullopt;
+  }
+  const auto streams = std::span(args).subspan(index + 1);
+  BlockingSpec spec{};
+  spec.keys.assign(streams.begin(), streams.begin() + streams.size() / 2);
+  // Zero means forever.
+  if (*block_ms > 0) {
+    spec.timeout = std::chrono::milliseconds(*block_ms);
+  }
+  return spec;
+}
+
+Command resolve_xread_last_ids(const Command &command, const Cache &cache) {
+  Command resolved = command;
+  auto &args = resolved.arguments;
+  const auto streams_arg =
+      std::ranges::find_if(args, [](const std::string &arg) {
+        return tolower(arg) == "streams";
+      });
+  const auto streams = std::span(streams_arg + 1, args.end());
+  const auto keys = streams.first(streams.size() / 2);
+  auto ids = streams.last(streams.size() / 2);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] != "$") {
+      continue;
+    }
+    ids[i] = cache.read(keys[i], [](const Value *value) {
+      const auto *stream =
+          value == nullptr ? nullptr : std::get_if<StreamValue>(value);
+      return stream == nullptr ? StreamId{}.to_string()
+                               : stream->last_id().to_string();
+    });
+  }
+  return resolved;
+}
+
+Command make_propagated_stream_command(const Command &command,
+                                       const Message &reply) {
+  Command propagated = command;
+  AddOptions options{};
+  if (command.verb == CommandVerb::XAdd &&
+      reply.get_data_type() == DataType::BulkString &&
+      !parse_add_options(command.arguments, options)) {
+    propagated.arguments[options.id_index] =
+        std::get<Message::StringVariantT>(reply.get_data());
+  }
+  return propagated;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// System includes.
+#include <optional>
+
+// Our library's header includes.
+#include "protocol.hpp"
+
+struct Config;
+class Cache;
+
+// Applies the stream commands (XADD, XRANGE, XREVRANGE, XLEN, XTRIM and
+// XREAD) and returns the reply, or nullopt for any other command. New entries
+// go into blocks of up to config.stream_node_max_bytes bytes and
+// config.stream_node_max_entries entries.
+std::optional<Message> handle_stream_command(const Command &command,
+                                             const Config &config,
+                                             Cache &cache);
+
+// The stream keys and timeout of XREAD with BLOCK, or nullopt for any other
+// command. Only meant for commands that got a reply other than an error.
+std::optional<BlockingSpec> get_xread_blocking_spec(const Command &command);
+
+// Replaces the "$" IDs of XREAD with the last IDs of their streams now, so
+// that retrying it later only returns the entries added since.
+Command resolve_xread_last_ids(const Command &command, const Cache &cache);
+
+// Rewrites XADD so that replaying it adds the entry with the ID it was given
+// now (which the reply holds), even if the command asked for a generated one.
+Command make_propagated_stream_command(const Command &command,
+                                       const Message &reply);
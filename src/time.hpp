@@ -11,4 +11,16 @@ unix_timestamp_to_steady_clock(std::size_t num_time_type_increments) {
          (std::chrono::system_clock::time_point(
               TimeType(num_time_type_increments)) -
           std::chrono::system_clock::now());
-}
\ No newline at end of file
+}
+
+// The inverse of the above: converts a steady_clock time point to a unix
+// timestamp counted in TimeType increments.
+template <typename TimeType>
+std::size_t
+steady_clock_to_unix_timestamp(std::chrono::steady_clock::time_point time) {
+  const auto system_time = std::chrono::system_clock::now() +
+                           (time - std::chrono::steady_clock::now());
+  return static_cast<std::size_t>(
+      std::chrono::duration_cast<TimeType>(system_time.time_since_epoch())
+          .count());
+}
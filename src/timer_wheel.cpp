@@ -0,0 +1,106 @@
+// This source file's own header include.
+#include "timer_wheel.hpp"
+
+// System includes.
+#include <algorithm>
+#include <iterator>
+
+TimerWheel::TimerWheel(const Clock::duration tick, const Clock::time_point start)
+    : tick_(tick), start_(start) {}
+
+void TimerWheel::schedule(const Id id, const Clock::time_point deadline) {
+  // The first tick that ends at or after the deadline, and never one that
+  // was already processed.
+  std::uint64_t due = 0;
+  if (const auto elapsed = deadline - start_; elapsed > Clock::duration(0)) {
+    due = static_cast<std::uint64_t>((elapsed + tick_ - Clock::duration(1)) /
+                                     tick_);
+  }
+  const auto [entry, is_new] = timers_.try_emplace(id);
+  auto &timer = entry->second;
+  if (!is_new) {
+    remove(timer);
+  }
+  timer.due = std::max(due, now_ + 1);
+  place(id, timer);
+}
+
+void TimerWheel::cancel(const Id id) {
+  const auto found = timers_.find(id);
+  if (found == timers_.end()) {
+    return;
+  }
+  remove(found->second);
+  timers_.erase(found);
+}
+
+std::vector<TimerWheel::Id> TimerWheel::advance(const Clock::time_point now) {
+  std::vector<Id> fired{};
+  if (now < start_) {
+    return fired;
+  }
+  const auto target = static_cast<std::uint64_t>((now - start_) / tick_);
+  while (now_ < target && !timers_.empty()) {
+    // Nothing happens until the next slot of the first wheel with timers
+    // comes up.
+    std::size_t first = 0;
+    while (sizes_[first] == 0) {
+      ++first;
+    }
+    if (first > 0) {
+      const auto shift = LEVEL_BITS * first;
+      now_ = std::min(target, (((now_ >> shift) + 1) << shift) - 1);
+      if (now_ == target) {
+        break;
+      }
+    }
+    ++now_;
+    // The slots of the coarser wheels that come up now are moved down first,
+    // coarsest first, since their timers may land in the slots below.
+    for (std::size_t level = NUM_LEVELS - 1; level > 0; --level) {
+      const auto shift = LEVEL_BITS * level;
+      if ((now_ & ((1UL << shift) - 1)) != 0) {
+        continue;
+      }
+      Slot moving{};
+      moving.swap(wheels_[level][(now_ >> shift) & (NUM_SLOTS - 1)]);
+      sizes_[level] -= moving.size();
+      for (const auto id : moving) {
+        place(id, timers_.at(id));
+      }
+    }
+    Slot due{};
+    due.swap(wheels_[0][now_ & (NUM_SLOTS - 1)]);
+    sizes_[0] -= due.size();
+    for (const auto id : due) {
+      timers_.erase(id);
+      fired.push_back(id);
+    }
+  }
+  // Nothing is left to fire on the way.
+  now_ = std::max(now_, target);
+  return fired;
+}
+
+void TimerWheel::place(const Id id, Timer &timer) {
+  const auto delta = timer.due - now_;
+  std::size_t level = 0;
+  while (level < NUM_LEVELS - 1 &&
+         delta >= (1UL << (LEVEL_BITS * (level + 1)))) {
+    ++level;
+  }
+  // Timers due past the last wheel wait in its furthest slot.
+  const auto due = std::min<std::uint64_t>(
+      timer.due, now_ + (1UL << (LEVEL_BITS * NUM_LEVELS)) - 1);
+  timer.level = level;
+  timer.slot = (due >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1);
+  auto &slot = wheels_[level][timer.slot];
+  slot.push_back(id);
+  timer.position = std::prev(slot.end());
+  ++sizes_[level];
+}
+
+void TimerWheel::remove(const Timer &timer) {
+  wheels_[timer.level][timer.slot].erase(timer.position);
+  --sizes_[timer.level];
+}
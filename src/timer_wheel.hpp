@@ -0,0 +1,75 @@
+#pragma once
+
+// System includes.
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Deadlines for many timers that are pushed back far more often than they
+// fire, like the idle timeouts of client connections (pushed back on every
+// request). Setting or cancelling a timer is O(1), unlike in a sorted set.
+//
+// Time is cut into ticks. The timers are kept in NUM_LEVELS wheels of
+// NUM_SLOTS slots each: a slot of the first wheel holds the timers due in one
+// tick, a slot of the next one those due in NUM_SLOTS ticks, and so on. As
+// time moves on, the timers in the next slot of a coarser wheel are moved down
+// to the finer wheels (each timer at most NUM_LEVELS - 1 times), and the ones
+// in the current slot of the first wheel fire. Timers fire at the end of the
+// tick they are due in, so up to a tick late. Ones due further off than the
+// wheels span wait in the last slot and are moved again when it comes up.
+// Stretches of time with nothing to fire or move are skipped over, so a wheel
+// left alone for long doesn't go through every tick it missed.
+//
+// Not thread-safe.
+class TimerWheel {
+public:
+  using Id = std::uint64_t;
+  using Clock = std::chrono::steady_clock;
+
+  TimerWheel(Clock::duration tick, Clock::time_point start = Clock::now());
+
+  // Sets the timer with the ID to fire at the deadline (replacing its
+  // previous deadline if it had one).
+  void schedule(Id id, Clock::time_point deadline);
+  // Removes the timer with the ID, if there is one.
+  void cancel(Id id);
+  // Moves time forward to now, and returns the IDs of the timers that fired,
+  // which are removed.
+  std::vector<Id> advance(Clock::time_point now);
+
+  [[nodiscard]] std::size_t size() const { return timers_.size(); }
+  [[nodiscard]] bool empty() const { return timers_.empty(); }
+
+private:
+  static constexpr std::size_t LEVEL_BITS = 6;
+  static constexpr std::size_t NUM_SLOTS = 1UL << LEVEL_BITS;
+  static constexpr std::size_t NUM_LEVELS = 4;
+  using Slot = std::list<Id>;
+
+  struct Timer {
+    // In ticks since start_.
+    std::uint64_t due = 0;
+    std::size_t level = 0;
+    std::size_t slot = 0;
+    Slot::iterator position;
+  };
+
+  Clock::duration tick_;
+  Clock::time_point start_;
+  // The last tick that was processed.
+  std::uint64_t now_ = 0;
+  std::array<std::array<Slot, NUM_SLOTS>, NUM_LEVELS> wheels_{};
+  // The number of timers in each wheel, so advance() can skip over the ticks
+  // in which nothing happens.
+  std::array<std::size_t, NUM_LEVELS> sizes_{};
+  std::unordered_map<Id, Timer> timers_;
+
+  // Puts the timer in the slot for its due tick.
+  void place(Id id, Timer &timer);
+  // Takes the timer out of its slot.
+  void remove(const Timer &timer);
+};
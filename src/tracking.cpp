@@ -0,0 +1,233 @@
+// This source file's own header include.
+#include "tracking.hpp"
+
+// System includes.
+#include <algorithm>
+
+namespace {
+
+// The glob matching every key that starts with the prefix.
+std::string prefix_pattern(const std::string &prefix) {
+  std::string pattern{};
+  for (const char character : prefix) {
+    if (character == '*' || character == '?' || character == '[' ||
+        character == ']' || character == '\\') {
+      pattern.push_back('\\');
+    }
+    pattern.push_back(character);
+  }
+  pattern.push_back('*');
+  return pattern;
+}
+
+} // namespace
+
+TrackingTable::TrackingTable(Deliver deliver, const std::size_t max_keys)
+    : deliver_(std::move(deliver)), max_keys_(max_keys) {}
+
+void TrackingTable::enable(const std::uint64_t client,
+                           TrackingOptions options) {
+  std::scoped_lock lock(mutex_);
+  disable_locked(client);
+  if (options.bcast) {
+    if (options.prefixes.empty()) {
+      options.prefixes.emplace_back();
+    }
+    for (const auto &prefix : options.prefixes) {
+      prefixes_.add(prefix_pattern(prefix), client);
+    }
+  }
+  clients_.emplace(client, std::move(options));
+  num_clients_ = clients_.size();
+}
+
+void TrackingTable::disable(const std::uint64_t client) {
+  std::scoped_lock lock(mutex_);
+  disable_locked(client);
+  num_clients_ = clients_.size();
+}
+
+void TrackingTable::disable_locked(const std::uint64_t client) {
+  const auto found = clients_.find(client);
+  if (found == clients_.end()) {
+    return;
+  }
+  for (const auto &prefix : found->second.prefixes) {
+    prefixes_.remove(prefix_pattern(prefix), client);
+  }
+  clients_.erase(found);
+}
+
+void TrackingTable::track(const std::uint64_t client, const std::string &key,
+                          const std::optional<Clock::time_point> deadline) {
+  Pending pending{};
+  {
+    std::scoped_lock lock(mutex_);
+    const auto options = clients_.find(client);
+    if (options == clients_.end() || options->second.bcast) {
+      return;
+    }
+    const auto [entry, is_new] = keys_.try_emplace(key);
+    auto &clients = entry->second.clients;
+    if (std::ranges::find(clients, client) == clients.end()) {
+      clients.push_back(client);
+    }
+    if (is_new && deadline) {
+      entry->second.deadline = deadline;
+      ++num_deadlines_;
+      add_deadline(*deadline, key);
+    }
+    // Evict whichever keys come first, other than the one just read.
+    while (max_keys_ > 0 && keys_.size() > max_keys_) {
+      auto victim = keys_.begin();
+      if (victim->first == key) {
+        ++victim;
+      }
+      collect(std::string(victim->first), 0, pending, false);
+    }
+  }
+  send(pending);
+}
+
+void TrackingTable::invalidate(const std::vector<std::string> &keys,
+                               const std::uint64_t writer) {
+  Pending pending{};
+  {
+    std::scoped_lock lock(mutex_);
+    for (const auto &key : keys) {
+      collect(key, writer, pending, true);
+    }
+  }
+  send(pending);
+}
+
+void TrackingTable::invalidate_all() {
+  Pending pending{};
+  {
+    std::scoped_lock lock(mutex_);
+    keys_.clear();
+    deadlines_ = {};
+    num_deadlines_ = 0;
+    for (const auto &[client, options] : clients_) {
+      pending.emplace(client, Invalidation{.client = client,
+                                           .redirect = options.redirect,
+                                           .keys = std::nullopt});
+    }
+  }
+  send(pending);
+}
+
+std::size_t TrackingTable::num_keys() const {
+  std::scoped_lock lock(mutex_);
+  return keys_.size();
+}
+
+std::size_t TrackingTable::num_deadlines() const {
+  std::scoped_lock lock(mutex_);
+  return deadlines_.size();
+}
+
+std::size_t TrackingTable::num_prefixes() const {
+  std::scoped_lock lock(mutex_);
+  return prefixes_.size();
+}
+
+void TrackingTable::collect(const std::string &key,
+                            const std::uint64_t writer, Pending &pending,
+                            const bool include_prefixes) {
+  const auto add = [&](const std::uint64_t client, const bool bcast) {
+    const auto options = clients_.find(client);
+    // Clients that switched modes since they read the key hear about it in
+    // the mode they are in now, if at all.
+    if (options == clients_.end() || options->second.bcast != bcast ||
+        (options->second.noloop && client == writer)) {
+      return;
+    }
+    auto &invalidation = pending[client];
+    if (!invalidation.keys) {
+      invalidation = Invalidation{.client = client,
+                                  .redirect = options->second.redirect,
+                                  .keys = std::vector<std::string>{}};
+    }
+    // A client with prefixes that overlap only hears about the key once.
+    if (invalidation.keys->empty() || invalidation.keys->back() != key) {
+      invalidation.keys->push_back(key);
+    }
+  };
+  if (const auto entry = keys_.find(key); entry != keys_.end()) {
+    for (const auto client : entry->second.clients) {
+      add(client, false);
+    }
+    if (entry->second.deadline) {
+      --num_deadlines_;
+    }
+    keys_.erase(entry);
+  }
+  if (include_prefixes) {
+    prefixes_.for_each_match(key,
+                             [&](const std::string &, const auto &clients) {
+                               for (const auto client : clients) {
+                                 add(client, true);
+                               }
+                             });
+  }
+}
+
+void TrackingTable::add_deadline(const Clock::time_point deadline,
+                                 const std::string &key) {
+  if (deadlines_.size() >= 2 * num_deadlines_ + 64) {
+    std::vector<Deadline> live{};
+    live.reserve(num_deadlines_);
+    for (const auto &[tracked, entry] : keys_) {
+      // The key itself is added below.
+      if (entry.deadline && tracked != key) {
+        live.emplace_back(*entry.deadline, tracked);
+      }
+    }
+    deadlines_ = decltype(deadlines_)(std::greater<>{}, std::move(live));
+  }
+  const bool is_earliest =
+      deadlines_.empty() || deadline < deadlines_.top().first;
+  deadlines_.emplace(deadline, key);
+  if (is_earliest) {
+    deadline_added_.notify_one();
+  }
+}
+
+void TrackingTable::send(const Pending &pending) const {
+  for (const auto &[client, invalidation] : pending) {
+    deliver_(invalidation);
+  }
+}
+
+void TrackingTable::expire_keys(const std::stop_token &stop) {
+  std::unique_lock lock(mutex_);
+  while (!stop.stop_requested()) {
+    if (deadlines_.empty()) {
+      deadline_added_.wait(lock, stop, [this] { return !deadlines_.empty(); });
+      continue;
+    }
+    const auto deadline = deadlines_.top().first;
+    if (Clock::now() < deadline) {
+      // Woken up early if an earlier deadline is added.
+      deadline_added_.wait_until(lock, stop, deadline, [this, deadline] {
+        return deadlines_.empty() || deadlines_.top().first < deadline;
+      });
+      continue;
+    }
+    Pending pending{};
+    const auto now = Clock::now();
+    while (!deadlines_.empty() && deadlines_.top().first <= now) {
+      const auto &[due, key] = deadlines_.top();
+      // Skips the deadlines of keys no longer tracked since then.
+      if (const auto entry = keys_.find(key);
+          entry != keys_.end() && entry->second.deadline == due) {
+        collect(key, 0, pending, false);
+      }
+      deadlines_.pop();
+    }
+    lock.unlock();
+    send(pending);
+    lock.lock();
+  }
+}
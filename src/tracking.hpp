@@ -0,0 +1,144 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <stop_token>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Our library's header includes.
+#include "pattern_index.hpp"
+
+// What a client asked for with CLIENT TRACKING ON.
+struct TrackingOptions {
+  // The client to send the invalidation messages to instead, which gets
+  // them on the __redis__:invalidate channel.
+  std::optional<std::uint64_t> redirect{};
+  // Broadcast mode: hear about every key with one of the prefixes (any key
+  // if there are none) that changes, whether it was read or not.
+  bool bcast = false;
+  std::vector<std::string> prefixes{};
+  // Don't hear about the keys the client changes itself.
+  bool noloop = false;
+};
+
+// What to tell a tracking client: that the keys changed, or (if there are
+// none) that every key may have, e.g. after a FLUSHALL.
+struct Invalidation {
+  std::uint64_t client = 0;
+  std::optional<std::uint64_t> redirect{};
+  std::optional<std::vector<std::string>> keys{};
+};
+
+// Server-assisted client-side caching (CLIENT TRACKING): which clients may
+// have cached which keys, so they can be told when the keys change or expire.
+//
+// In the default mode, the table remembers which clients read each key, and
+// forgets the key once they are told it changed (they read it again to keep
+// hearing about it). The table holds at most max_keys keys: past that, keys
+// are evicted and their clients told to drop them, as if they had changed.
+// Since keys only expire when they are next looked at, the table also keeps
+// the deadlines of the keys it tracks, and tells their clients when they
+// pass. Clients in broadcast mode aren't in the table. Their prefixes are in
+// a PatternIndex instead, which each key written to is matched against (they
+// aren't told about keys expiring).
+//
+// Like in Redis, keys are tracked regardless of the database they are in.
+class TrackingTable {
+public:
+  using Clock = std::chrono::steady_clock;
+  // Called with each invalidation to send, without holding any lock.
+  using Deliver = std::function<void(const Invalidation &)>;
+
+  // A max_keys of 0 means no limit.
+  TrackingTable(Deliver deliver, std::size_t max_keys);
+  TrackingTable(const TrackingTable &other) = delete;
+  TrackingTable &operator=(const TrackingTable &other) = delete;
+  TrackingTable(TrackingTable &&other) = delete;
+  TrackingTable &operator=(TrackingTable &&other) = delete;
+  ~TrackingTable() = default;
+
+  // Turns tracking on for the client (replacing its options if it was on).
+  void enable(std::uint64_t client, TrackingOptions options);
+  // Turns tracking off for the client. The keys it read are left in the
+  // table until they change.
+  void disable(std::uint64_t client);
+  // Records that the client (tracking in the default mode) read the key,
+  // which expires at the deadline if it has one. Call it before reading the
+  // key, so a change in between is not missed.
+  void track(std::uint64_t client, const std::string &key,
+             std::optional<Clock::time_point> deadline);
+  // Tells the clients that may have the keys cached that the writer changed
+  // them.
+  void invalidate(const std::vector<std::string> &keys, std::uint64_t writer);
+  // Tells every tracking client that every key may have changed.
+  void invalidate_all();
+  // Tells clients about the keys they read as the keys expire, until
+  // stopped. Run on a thread of its own.
+  void expire_keys(const std::stop_token &stop);
+
+  // The number of clients with tracking on, without taking the lock, so
+  // commands can skip tracking altogether when there are none.
+  [[nodiscard]] std::size_t num_clients() const { return num_clients_; }
+  // The number of keys in the table.
+  [[nodiscard]] std::size_t num_keys() const;
+  // The number of key deadlines kept, including those of keys no longer
+  // tracked, which stays within about twice the number of keys.
+  [[nodiscard]] std::size_t num_deadlines() const;
+  // The number of distinct broadcast mode prefixes.
+  [[nodiscard]] std::size_t num_prefixes() const;
+
+private:
+  // The invalidations to send once the lock is released, by client.
+  using Pending = std::unordered_map<std::uint64_t, Invalidation>;
+  using Deadline = std::pair<Clock::time_point, std::string>;
+
+  Deliver deliver_;
+  std::size_t max_keys_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::uint64_t, TrackingOptions> clients_;
+  std::atomic<std::size_t> num_clients_ = 0;
+  struct TrackedKey {
+    // The clients that read the key.
+    std::vector<std::uint64_t> clients{};
+    // When the key expires, if it does.
+    std::optional<Clock::time_point> deadline{};
+  };
+  // The keys read by clients in the default mode.
+  std::unordered_map<std::string, TrackedKey> keys_;
+  // The broadcast mode clients, by prefix (as a glob).
+  PatternIndex<std::uint64_t> prefixes_;
+  // When the tracked keys expire, earliest first. The deadlines of keys that
+  // changed (or were evicted) since are left in, and skipped unless they
+  // match the key's deadline in keys_. So they don't pile up, the heap is
+  // rebuilt from keys_ once it holds over twice as many deadlines as there
+  // are keys with one.
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>>
+      deadlines_;
+  // The number of keys in keys_ with a deadline.
+  std::size_t num_deadlines_ = 0;
+  std::condition_variable_any deadline_added_;
+
+  // Called holding mutex_.
+  void disable_locked(std::uint64_t client);
+  // Adds the invalidations for the key to send, and forgets who read it.
+  // Broadcast mode clients are only told if include_prefixes is set (when
+  // the key was written to). A writer of 0 is none. Called holding mutex_.
+  void collect(const std::string &key, std::uint64_t writer, Pending &pending,
+               bool include_prefixes);
+  void send(const Pending &pending) const;
+  // Adds the key's deadline, rebuilding the heap first if it has too many
+  // stale ones. Called holding mutex_.
+  void add_deadline(Clock::time_point deadline, const std::string &key);
+};
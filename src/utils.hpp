@@ -3,8 +3,14 @@
 // System includes.
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
 
 template <typename T>
 concept StringLike = requires(T str) {
@@ -21,4 +27,34 @@ template <StringLike StringType> std::string tolower(const StringType &str) {
   std::transform(lower.cbegin(), lower.cend(), lower.begin(),
                  [](auto character) { return std::tolower(character); });
   return lower;
-}
\ No newline at end of file
+}
+
+// Parses the string as a 64-bit integer only if it is the canonical decimal
+// form of one (no leading zeros or "+", no "-0"), so that turning the integer
+// back into a string gives the exact same string. This is what decides whether
+// Redis stores a string as an integer.
+inline std::optional<std::int64_t> parse_canonical_int(std::string_view str) {
+  if (str.empty() || (str.size() > 1 && str.front() == '0') ||
+      str.starts_with("-0")) {
+    return std::nullopt;
+  }
+  std::int64_t value = 0;
+  const auto [end, error] =
+      std::from_chars(str.data(), str.data() + str.size(), value);
+  if (error != std::errc{} || end != str.data() + str.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// A random ID of 40 hex characters, like Redis's replication and node IDs.
+inline std::string generate_random_id() {
+  constexpr std::size_t ID_LENGTH = 40;
+  std::random_device device{};
+  std::uniform_int_distribution<int> digit(0, 15);
+  std::string id(ID_LENGTH, '0');
+  for (auto &character : id) {
+    character = "0123456789abcdef"[digit(device)];
+  }
+  return id;
+}
@@ -0,0 +1,77 @@
+// This source file's own header include.
+#include "value.hpp"
+
+// System includes.
+#include <exception>
+#include <iostream>
+#include <utility>
+
+std::string type_name(ValueType type) {
+  switch (type) {
+  case ValueType::String:
+    return "string";
+  case ValueType::List:
+    return "list";
+  case ValueType::Set:
+    return "set";
+  case ValueType::SortedSet:
+    return "zset";
+  case ValueType::Hash:
+    return "hash";
+  case ValueType::Stream:
+    return "stream";
+  default:
+    std::cerr << "Unknown ValueType enum encountered: "
+              << static_cast<int>(type) << std::endl;
+    std::terminate();
+  }
+}
+
+SortedSetTable::SortedSetTable(const SortedSetTable &other)
+    : ordered_(other.ordered_) {
+  members_.reserve(ordered_.size());
+  for (const auto *node = ordered_.first(); node != nullptr;
+       node = node->next()) {
+    members_.emplace(node->member(), node);
+  }
+}
+
+SortedSetTable &SortedSetTable::operator=(const SortedSetTable &other) {
+  if (this != &other) {
+    SortedSetTable copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+bool SortedSetTable::insert(std::string_view member, double score) {
+  if (const auto it = members_.find(member); it != members_.end()) {
+    const auto old_score = it->second->score();
+    if (old_score != score) {
+      it->second = ordered_.update_score(old_score, member, score);
+    }
+    return false;
+  }
+  const auto *node = ordered_.insert(score, std::string(member));
+  members_.emplace(node->member(), node);
+  return true;
+}
+
+bool SortedSetTable::erase(std::string_view member) {
+  const auto it = members_.find(member);
+  if (it == members_.end()) {
+    return false;
+  }
+  const auto score = it->second->score();
+  // Drop the view before the node that owns the string goes away.
+  members_.erase(it);
+  ordered_.erase(score, member);
+  return true;
+}
+
+std::optional<double> SortedSetTable::score(std::string_view member) const {
+  if (const auto it = members_.find(member); it != members_.end()) {
+    return it->second->score();
+  }
+  return std::nullopt;
+}
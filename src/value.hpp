@@ -0,0 +1,100 @@
+#pragma once
+
+// System includes.
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+
+// Our library's header includes.
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "quicklist.hpp"
+#include "skiplist.hpp"
+#include "stream.hpp"
+
+// The kinds of values a key can hold, as reported by the TYPE command.
+enum class ValueType : std::uint8_t {
+  String,
+  List,
+  Set,
+  SortedSet,
+  Hash,
+  Stream,
+};
+
+// Like Redis, small aggregates are kept in compact encodings (listpacks and
+// intsets) that pack every element into one allocation, and only big ones use
+// node-based containers that are faster to update. See
+// https://redis.io/docs/latest/operate/oss_and_stack/management/optimization/memory-optimization/
+
+// A list is a chain of listpacks, so even long lists stay compact.
+using ListValue = Quicklist;
+
+// Small sets of integers are intsets, other small sets are listpacks.
+using SetValue =
+    std::variant<IntSet, Listpack, std::unordered_set<std::string>>;
+
+// Small sorted sets are listpacks of alternating members and scores, ordered
+// by (score, member). Big ones look up members in a hash table and keep them
+// ordered in a skiplist for range and rank queries. Like in Redis, the table
+// points into the skiplist nodes instead of holding a second copy of every
+// member.
+class SortedSetTable {
+public:
+  SortedSetTable() = default;
+  // Copies rebuild the table so it points into the new nodes.
+  SortedSetTable(const SortedSetTable &other);
+  SortedSetTable &operator=(const SortedSetTable &other);
+  SortedSetTable(SortedSetTable &&other) noexcept = default;
+  SortedSetTable &operator=(SortedSetTable &&other) noexcept = default;
+  ~SortedSetTable() = default;
+
+  // Adds the member, or updates its score. Returns true if it is new.
+  bool insert(std::string_view member, double score);
+  // Returns false if the member isn't there.
+  bool erase(std::string_view member);
+  [[nodiscard]] std::optional<double> score(std::string_view member) const;
+
+  [[nodiscard]] std::size_t size() const { return ordered_.size(); }
+  [[nodiscard]] const SkipList &ordered() const { return ordered_; }
+
+  bool operator==(const SortedSetTable &other) const {
+    return ordered_ == other.ordered_;
+  }
+
+private:
+  SkipList ordered_;
+  // Keyed by views of the member strings owned by the nodes.
+  std::unordered_map<std::string_view, const SkipList::Node *> members_;
+};
+using SortedSetValue = std::variant<Listpack, SortedSetTable>;
+
+// Small hashes are listpacks of alternating fields and values.
+using HashValue =
+    std::variant<Listpack, std::unordered_map<std::string, std::string>>;
+
+// Streams are listpack blocks of entries, indexed by a radix tree.
+using StreamValue = Stream;
+
+// The order of these alternatives matches ValueType.
+using Value = std::variant<std::string, ListValue, SetValue, SortedSetValue,
+                           HashValue, StreamValue>;
+
+// helper type to create visitors for the Value variant (and the variants
+// inside of it).
+template <class... Ts> struct ValueVisitor : Ts... {
+  using Ts::operator()...;
+};
+
+inline ValueType value_type(const Value &value) {
+  return static_cast<ValueType>(value.index());
+}
+
+// The name of the type, as reported by the TYPE command.
+std::string type_name(ValueType type);
@@ -0,0 +1,92 @@
+// This source file's own header include.
+#include "watched_keys.hpp"
+
+// System includes.
+#include <algorithm>
+
+void WatchedKeys::watch(const std::uint64_t client, const std::size_t db_index,
+                        const std::string &key,
+                        const std::optional<Clock::time_point> deadline) {
+  std::scoped_lock lock(mutex_);
+  auto &watchers = keys_[db_index][key];
+  if (std::ranges::find(watchers, client) != watchers.end()) {
+    return;
+  }
+  watchers.push_back(client);
+  auto &watcher = clients_[client];
+  watcher.keys.emplace_back(db_index, key);
+  if (deadline && (!watcher.deadline || *deadline < *watcher.deadline)) {
+    watcher.deadline = deadline;
+  }
+  num_clients_ = clients_.size();
+}
+
+void WatchedKeys::unwatch(const std::uint64_t client) {
+  std::scoped_lock lock(mutex_);
+  const auto found = clients_.find(client);
+  if (found == clients_.end()) {
+    return;
+  }
+  for (const auto &[db_index, key] : found->second.keys) {
+    auto &db_keys = keys_[db_index];
+    const auto entry = db_keys.find(key);
+    std::erase(entry->second, client);
+    if (entry->second.empty()) {
+      db_keys.erase(entry);
+    }
+    if (db_keys.empty()) {
+      keys_.erase(db_index);
+    }
+  }
+  clients_.erase(found);
+  num_clients_ = clients_.size();
+}
+
+void WatchedKeys::touch(const std::size_t db_index,
+                        const std::vector<std::string> &keys) {
+  std::scoped_lock lock(mutex_);
+  const auto db_keys = keys_.find(db_index);
+  if (db_keys == keys_.end()) {
+    return;
+  }
+  for (const auto &key : keys) {
+    const auto entry = db_keys->second.find(key);
+    if (entry == db_keys->second.end()) {
+      continue;
+    }
+    for (const auto client : entry->second) {
+      clients_[client].dirty = true;
+    }
+  }
+}
+
+void WatchedKeys::touch_db(const std::size_t db_index) {
+  std::scoped_lock lock(mutex_);
+  const auto db_keys = keys_.find(db_index);
+  if (db_keys == keys_.end()) {
+    return;
+  }
+  for (const auto &[key, watchers] : db_keys->second) {
+    for (const auto client : watchers) {
+      clients_[client].dirty = true;
+    }
+  }
+}
+
+void WatchedKeys::touch_all() {
+  std::scoped_lock lock(mutex_);
+  for (auto &[client, watcher] : clients_) {
+    watcher.dirty = true;
+  }
+}
+
+bool WatchedKeys::is_dirty(const std::uint64_t client,
+                           const Clock::time_point now) const {
+  std::scoped_lock lock(mutex_);
+  const auto found = clients_.find(client);
+  if (found == clients_.end()) {
+    return false;
+  }
+  return found->second.dirty ||
+         (found->second.deadline && now > *found->second.deadline);
+}
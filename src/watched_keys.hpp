@@ -0,0 +1,65 @@
+#pragma once
+
+// System includes.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The keys clients WATCH, so EXEC can tell whether any of them changed since
+// (in which case the transaction isn't run).
+//
+// Rather than keeping a version of every key, which every write would have to
+// bump, writes look up the keys they changed in here and mark the clients
+// watching them dirty. EXEC then only checks its client's flag. Writes that
+// change every key in a database (FLUSHDB, SWAPDB) mark every client watching
+// a key in it, whether the key existed or not. Keys only expire when they are
+// next looked at, so the table also keeps when each watched key was due to
+// expire, and a client counts as dirty once one of them has.
+class WatchedKeys {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Watches the key in the database for the client. The key expires at the
+  // deadline if it has one.
+  void watch(std::uint64_t client, std::size_t db_index, const std::string &key,
+             std::optional<Clock::time_point> deadline);
+  // Forgets the keys the client watched, and whether they changed.
+  void unwatch(std::uint64_t client);
+  // Marks the clients watching the keys in the database dirty.
+  void touch(std::size_t db_index, const std::vector<std::string> &keys);
+  // Marks the clients watching any key in the database dirty.
+  void touch_db(std::size_t db_index);
+  // Marks every client watching a key dirty.
+  void touch_all();
+  // Whether any of the keys the client watched changed or expired.
+  [[nodiscard]] bool is_dirty(std::uint64_t client,
+                              Clock::time_point now = Clock::now()) const;
+
+  // The number of clients watching keys, without taking the lock, so writes
+  // can skip looking up their keys when there are none.
+  [[nodiscard]] std::size_t num_clients() const { return num_clients_; }
+
+private:
+  struct Watcher {
+    std::vector<std::pair<std::size_t, std::string>> keys{};
+    // When the first of the keys expires, if any of them does.
+    std::optional<Clock::time_point> deadline{};
+    bool dirty = false;
+  };
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::uint64_t, Watcher> clients_;
+  std::atomic<std::size_t> num_clients_ = 0;
+  // The clients watching each key, by database.
+  std::map<std::size_t,
+           std::unordered_map<std::string, std::vector<std::uint64_t>>>
+      keys_;
+};
@@ -0,0 +1,170 @@
+// This source file's own header include.
+#include "ziplist.hpp"
+
+// System includes.
+#include <cstdint>
+#include <string>
+
+namespace {
+
+constexpr unsigned char ZIPLIST_END = 0xFF;
+constexpr std::size_t ZIPLIST_HEADER_SIZE = 10;
+// A previous entry length of this value means the real length follows in the
+// next 4 bytes.
+constexpr unsigned char ZIPLIST_BIG_PREVLEN = 0xFE;
+constexpr unsigned char ZIPLIST_STR_MASK = 0xC0;
+constexpr unsigned char ZIPLIST_STR_06B = 0x00;
+constexpr unsigned char ZIPLIST_STR_14B = 0x40;
+constexpr unsigned char ZIPLIST_STR_32B = 0x80;
+constexpr unsigned char ZIPLIST_INT_16B = 0xC0;
+constexpr unsigned char ZIPLIST_INT_32B = 0xD0;
+constexpr unsigned char ZIPLIST_INT_64B = 0xE0;
+constexpr unsigned char ZIPLIST_INT_24B = 0xF0;
+constexpr unsigned char ZIPLIST_INT_8B = 0xFE;
+// 1111xxxx with xxxx between 0001 and 1101 is an immediate 0 to 12.
+constexpr unsigned char ZIPLIST_INT_IMM_MIN = 0xF1;
+constexpr unsigned char ZIPLIST_INT_IMM_MAX = 0xFD;
+
+constexpr unsigned char ZIPMAP_BIG_LEN = 254;
+constexpr unsigned char ZIPMAP_END = 255;
+
+// Reads through a serialized blob, failing (rather than reading past the end)
+// on truncated input.
+class Reader {
+public:
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  [[nodiscard]] bool ok() const { return ok_; }
+  [[nodiscard]] std::size_t remaining() const {
+    return ok_ ? data_.size() - pos_ : 0;
+  }
+
+  std::optional<unsigned char> peek() {
+    if (remaining() == 0) {
+      ok_ = false;
+      return std::nullopt;
+    }
+    return static_cast<unsigned char>(data_[pos_]);
+  }
+
+  std::string_view bytes(std::size_t num_bytes) {
+    if (remaining() < num_bytes) {
+      ok_ = false;
+      return {};
+    }
+    const auto result = data_.substr(pos_, num_bytes);
+    pos_ += num_bytes;
+    return result;
+  }
+
+  std::uint64_t little_endian(std::size_t num_bytes) {
+    const auto raw = bytes(num_bytes);
+    std::uint64_t value = 0;
+    for (std::size_t i = raw.size(); i > 0; --i) {
+      value = (value << 8U) | static_cast<unsigned char>(raw[i - 1]);
+    }
+    return value;
+  }
+
+  std::uint64_t big_endian(std::size_t num_bytes) {
+    std::uint64_t value = 0;
+    for (const char byte : bytes(num_bytes)) {
+      value = (value << 8U) | static_cast<unsigned char>(byte);
+    }
+    return value;
+  }
+
+private:
+  std::string_view data_;
+  std::size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+} // namespace
+
+std::optional<Listpack> ziplist_to_listpack(std::string_view ziplist) {
+  Reader reader(ziplist);
+  const auto total_bytes = reader.little_endian(4);
+  // We walk the entries front to back, so the tail offset isn't needed.
+  reader.little_endian(4);
+  reader.little_endian(2);
+  if (!reader.ok() || total_bytes != ziplist.size() ||
+      ziplist.size() < ZIPLIST_HEADER_SIZE + 1) {
+    return std::nullopt;
+  }
+
+  Listpack listpack{};
+  while (reader.ok() && reader.peek() != ZIPLIST_END) {
+    if (reader.little_endian(1) == ZIPLIST_BIG_PREVLEN) {
+      reader.little_endian(4);
+    }
+    const auto encoding = reader.peek().value_or(ZIPLIST_END);
+    switch (encoding & ZIPLIST_STR_MASK) {
+    case ZIPLIST_STR_06B:
+      reader.bytes(1);
+      listpack.push_back(reader.bytes(encoding & 0x3FU));
+      continue;
+    case ZIPLIST_STR_14B:
+      listpack.push_back(reader.bytes(reader.big_endian(2) & 0x3FFFU));
+      continue;
+    case ZIPLIST_STR_32B:
+      reader.bytes(1);
+      listpack.push_back(reader.bytes(reader.big_endian(4)));
+      continue;
+    default:
+      break;
+    }
+    reader.bytes(1);
+    std::int64_t value = 0;
+    if (encoding == ZIPLIST_INT_8B) {
+      value = static_cast<std::int8_t>(reader.little_endian(1));
+    } else if (encoding == ZIPLIST_INT_16B) {
+      value = static_cast<std::int16_t>(reader.little_endian(2));
+    } else if (encoding == ZIPLIST_INT_24B) {
+      // Shift the 24 bits to the top so the cast sign extends them.
+      value = static_cast<std::int32_t>(reader.little_endian(3) << 8U) >> 8;
+    } else if (encoding == ZIPLIST_INT_32B) {
+      value = static_cast<std::int32_t>(reader.little_endian(4));
+    } else if (encoding == ZIPLIST_INT_64B) {
+      value = static_cast<std::int64_t>(reader.little_endian(8));
+    } else if (encoding >= ZIPLIST_INT_IMM_MIN &&
+               encoding <= ZIPLIST_INT_IMM_MAX) {
+      value = (encoding & 0x0FU) - 1;
+    } else {
+      return std::nullopt;
+    }
+    listpack.push_back(value);
+  }
+  if (!reader.ok() || reader.remaining() != 1) {
+    return std::nullopt;
+  }
+  return listpack;
+}
+
+std::optional<Listpack> zipmap_to_listpack(std::string_view zipmap) {
+  Reader reader(zipmap);
+  // The number of pairs, which we don't need since the zipmap is terminated.
+  reader.bytes(1);
+  const auto read_length = [&reader]() -> std::uint64_t {
+    const auto length = reader.little_endian(1);
+    if (length == ZIPMAP_BIG_LEN) {
+      return reader.little_endian(4);
+    }
+    return length;
+  };
+
+  Listpack listpack{};
+  while (reader.ok() && reader.peek() != ZIPMAP_END) {
+    listpack.push_back(reader.bytes(read_length()));
+    const auto value_length = read_length();
+    // Values may be followed by some unused bytes, left behind when they were
+    // updated in place.
+    const auto num_free_bytes = reader.little_endian(1);
+    listpack.push_back(reader.bytes(value_length));
+    reader.bytes(num_free_bytes);
+  }
+  if (!reader.ok() || reader.remaining() != 1) {
+    return std::nullopt;
+  }
+  return listpack;
+}
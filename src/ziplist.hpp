@@ -0,0 +1,23 @@
+#pragma once
+
+// System includes.
+#include <optional>
+#include <string_view>
+
+// Our library's header includes.
+#include "listpack.hpp"
+
+// Ziplists (and, before them, zipmaps) are the compact encodings older
+// versions of Redis used where listpacks are used now. They only show up in
+// RDB files written by those versions, so like Redis we convert them to
+// listpacks while loading instead of supporting them everywhere. See
+// https://github.com/redis/redis/blob/7.0/src/ziplist.c and
+// https://github.com/redis/redis/blob/6.2/src/zipmap.c for the formats.
+
+// Returns nullopt if the ziplist is malformed.
+std::optional<Listpack> ziplist_to_listpack(std::string_view ziplist);
+
+// The zipmap's keys and values end up alternating in the listpack, which is
+// how hashes are laid out in listpacks. Returns nullopt if the zipmap is
+// malformed.
+std::optional<Listpack> zipmap_to_listpack(std::string_view zipmap);
@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/aof.hpp"
+#include "../src/cache.hpp"
+#include "../src/redis_core.hpp"
+
+namespace {
+// Gives each test its own empty file in the temp dir.
+class AofTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path = std::filesystem::temp_directory_path() /
+           (std::string("aof_test_") +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+            ".aof");
+    std::filesystem::remove(path);
+  }
+  void TearDown() override { std::filesystem::remove(path); }
+
+  std::filesystem::path path;
+  Config config{};
+};
+
+Command set_command(const std::string &key, const std::string &value) {
+  return Command{CommandVerb::Set, {key, value}};
+}
+} // namespace
+
+TEST_F(AofTest, AppendAndReplay) {
+  for (const auto policy :
+       {AppendFsync::Always, AppendFsync::EverySec, AppendFsync::No}) {
+    std::filesystem::remove(path);
+    {
+      AppendOnlyFile aof(path, policy);
+      ASSERT_TRUE(aof.is_open());
+      aof.append(0, set_command("a", "1"));
+      aof.append(0, set_command("b", "2"));
+      aof.wait_until_durable(aof.append(0, set_command("a", "3")));
+      // Anything still buffered is flushed on destruction.
+    }
+    Cache cache{};
+    ASSERT_TRUE(load_aof(path, config, std::span(&cache, 1)));
+    EXPECT_EQ(cache.get("a"), "3");
+    EXPECT_EQ(cache.get("b"), "2");
+    EXPECT_EQ(cache.keys().size(), 2);
+  }
+}
+
+TEST_F(AofTest, ExpiryIsLoggedAsAbsoluteTime) {
+  const Command set_with_px{CommandVerb::Set, {"k", "v", "PX", "100000"}};
+  const auto propagated = make_propagated_command(
+      set_with_px, Message{"OK", DataType::SimpleString});
+  ASSERT_EQ(propagated.arguments.size(), 4);
+  EXPECT_EQ(propagated.arguments[2], "pxat");
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.wait_until_durable(aof.append(0, propagated));
+    // Already expired by the time it is replayed.
+    aof.wait_until_durable(aof.append(
+        0, Command{CommandVerb::Set, {"gone", "v", "pxat", "1000"}}));
+  }
+  Cache cache{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&cache, 1)));
+  EXPECT_EQ(cache.get("k"), "v");
+  EXPECT_EQ(cache.get("gone"), std::nullopt);
+}
+
+TEST_F(AofTest, GeneratedStreamIdsAreLogged) {
+  Cache cache{};
+  const Command xadd{CommandVerb::XAdd, {"s", "MAXLEN", "5", "*", "f", "v"}};
+  const auto reply = handle_command(xadd, config, cache);
+  ASSERT_TRUE(reply.has_value());
+  const auto propagated = make_propagated_command(xadd, *reply);
+  EXPECT_EQ(propagated.arguments[3],
+            std::get<Message::StringVariantT>(reply->get_data()));
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.wait_until_durable(aof.append(0, propagated));
+  }
+  Cache replayed{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&replayed, 1)));
+  EXPECT_EQ(replayed.read("s", [](const Value *value) { return *value; }),
+            cache.read("s", [](const Value *value) { return *value; }));
+}
+
+TEST_F(AofTest, TruncatedTailIsDropped) {
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.wait_until_durable(aof.append(0, set_command("key", "value")));
+  }
+  const auto complete_size = std::filesystem::file_size(path);
+  {
+    // Simulate a crash in the middle of writing the next command.
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "*3\r\n$3\r\nset\r\n$3\r\nkey\r\n$5\r\nnew";
+  }
+  Cache cache{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&cache, 1)));
+  EXPECT_EQ(cache.get("key"), "value");
+  EXPECT_EQ(std::filesystem::file_size(path), complete_size);
+}
+
+TEST_F(AofTest, UnterminatedTransactionIsDropped) {
+  const Command multi{CommandVerb::Multi, {}};
+  const Command exec{CommandVerb::Exec, {}};
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.append(0, multi);
+    aof.append(0, set_command("a", "1"));
+    aof.append(0, set_command("b", "1"));
+    aof.wait_until_durable(aof.append(0, exec));
+  }
+  {
+    // Simulate a crash in the middle of the next transaction.
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.append(0, multi);
+    aof.wait_until_durable(aof.append(0, set_command("a", "2")));
+  }
+  Cache cache{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&cache, 1)));
+  EXPECT_EQ(cache.get("a"), "1");
+  EXPECT_EQ(cache.get("b"), "1");
+
+  // The MULTI was dropped, so what's appended next isn't part of it.
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.wait_until_durable(aof.append(0, set_command("b", "2")));
+  }
+  Cache replayed{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&replayed, 1)));
+  EXPECT_EQ(replayed.get("a"), "1");
+  EXPECT_EQ(replayed.get("b"), "2");
+}
+
+TEST_F(AofTest, GroupCommitFromManyThreads) {
+  constexpr int NUM_THREADS = 8;
+  constexpr int NUM_COMMANDS_PER_THREAD = 50;
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    std::vector<std::jthread> threads{};
+    for (int thread = 0; thread < NUM_THREADS; ++thread) {
+      threads.emplace_back([&aof, thread] {
+        for (int i = 0; i < NUM_COMMANDS_PER_THREAD; ++i) {
+          aof.wait_until_durable(aof.append(
+              0, set_command(std::to_string(thread) + ":" + std::to_string(i),
+                             "x")));
+        }
+      });
+    }
+  }
+  Cache cache{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&cache, 1)));
+  EXPECT_EQ(cache.keys().size(), NUM_THREADS * NUM_COMMANDS_PER_THREAD);
+}
+
+TEST_F(AofTest, MissingFile) {
+  Cache cache{};
+  EXPECT_FALSE(load_aof(path, config, std::span(&cache, 1)));
+}
+
+TEST_F(AofTest, RewriteCompactsTheFile) {
+  Cache cache{};
+  AppendOnlyFile aof(path, AppendFsync::EverySec);
+  const auto apply = [&](const Command &command) {
+    handle_command(command, config, cache);
+    aof.append(0, command);
+  };
+  // Overwrite the same few keys many times.
+  for (int i = 0; i < 1000; ++i) {
+    apply(set_command("counter:" + std::to_string(i % 3), std::to_string(i)));
+  }
+  aof.flush();
+  const auto size_before = std::filesystem::file_size(path);
+
+  ASSERT_TRUE(aof.start_rewrite({cache.snapshot()}));
+  // Writes that arrive during the rewrite must make it into the new file.
+  apply(set_command("during", "rewrite"));
+  aof.wait_for_rewrite();
+  EXPECT_FALSE(aof.is_rewrite_in_progress());
+  apply(set_command("after", "rewrite"));
+  aof.flush();
+  EXPECT_LT(std::filesystem::file_size(path), size_before / 10);
+
+  Cache replayed{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&replayed, 1)));
+  EXPECT_EQ(replayed.keys().size(), 5);
+  EXPECT_EQ(replayed.get("counter:0"), "999");
+  EXPECT_EQ(replayed.get("counter:1"), "997");
+  EXPECT_EQ(replayed.get("counter:2"), "998");
+  EXPECT_EQ(replayed.get("during"), "rewrite");
+  EXPECT_EQ(replayed.get("after"), "rewrite");
+}
+
+TEST_F(AofTest, RewriteKeepsAggregates) {
+  // Values that no command can write yet (e.g. loaded from an RDB file) have
+  // to survive a rewrite, which stores the snapshot as an RDB preamble.
+  Cache cache{};
+  ListValue list{};
+  list.push_back("a");
+  list.push_back("b");
+  cache.insert({{"list", {list, std::nullopt}}});
+  cache.set("key", "value");
+  AppendOnlyFile aof(path, AppendFsync::Always);
+  ASSERT_TRUE(aof.start_rewrite({cache.snapshot()}));
+  aof.wait_for_rewrite();
+  aof.wait_until_durable(aof.append(0, set_command("after", "rewrite")));
+
+  Cache replayed{};
+  ASSERT_TRUE(load_aof(path, config, std::span(&replayed, 1)));
+  EXPECT_EQ(replayed.keys().size(), 3);
+  EXPECT_EQ(replayed.type("list"), ValueType::List);
+  EXPECT_EQ(replayed.get("key"), "value");
+  EXPECT_EQ(replayed.get("after"), "rewrite");
+}
+
+TEST_F(AofTest, CommandsGoToTheirDatabase) {
+  std::vector<Cache> databases(4);
+  {
+    AppendOnlyFile aof(path, AppendFsync::Always);
+    aof.append(0, set_command("a", "0"));
+    aof.append(2, set_command("a", "2"));
+    aof.append(2, set_command("b", "2"));
+    aof.append(1, Command{CommandVerb::SwapDb, {"1", "2"}});
+    aof.wait_until_durable(aof.append(3, set_command("c", "3")));
+  }
+  // A SELECT was logged whenever the database changed.
+  std::ifstream file(path, std::ios::binary);
+  const std::string contents{std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>()};
+  std::size_t num_selects = 0;
+  for (auto pos = contents.find("select"); pos != std::string::npos;
+       pos = contents.find("select", pos + 1)) {
+    ++num_selects;
+  }
+  EXPECT_EQ(num_selects, 4);
+
+  ASSERT_TRUE(load_aof(path, config, databases));
+  EXPECT_EQ(databases[0].get("a"), "0");
+  EXPECT_EQ(databases[1].get("a"), "2");
+  EXPECT_EQ(databases[1].get("b"), "2");
+  EXPECT_EQ(databases[2].size(), 0);
+  EXPECT_EQ(databases[3].get("c"), "3");
+}
+
+TEST_F(AofTest, AutoRewriteThreshold) {
+  // Rewrite once the file doubles in size, but not before it reaches 1 KiB.
+  AppendOnlyFile aof(path, AppendFsync::Always, 100, 1024);
+  EXPECT_FALSE(aof.should_auto_rewrite());
+  aof.wait_until_durable(aof.append(0, set_command("key", "value")));
+  EXPECT_FALSE(aof.should_auto_rewrite());
+  aof.wait_until_durable(
+      aof.append(0, set_command("key", std::string(2000, 'x'))));
+  EXPECT_TRUE(aof.should_auto_rewrite());
+
+  Cache cache{};
+  cache.set("key", "value");
+  ASSERT_TRUE(aof.start_rewrite({cache.snapshot()}));
+  aof.wait_for_rewrite();
+  // The new, compact file becomes the base size to grow from.
+  EXPECT_FALSE(aof.should_auto_rewrite());
+  EXPECT_EQ(aof.file_size(), std::filesystem::file_size(path));
+}
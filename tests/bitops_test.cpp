@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <random>
+#include <string>
+
+#include "../src/bitops.hpp"
+
+namespace {
+std::string get_random_bytes(const std::size_t length, unsigned seed) {
+  // NOLINTNEXTLINE(cert-msc51-cpp, cert-msc32-c)
+  std::mt19937 generator(seed);
+  std::uniform_int_distribution<> distribution(0, 255);
+  std::string result(length, 0);
+  for (auto &byte : result) {
+    byte = static_cast<char>(distribution(generator));
+  }
+  return result;
+}
+} // namespace
+
+TEST(BitopsTest, Popcount) {
+  EXPECT_EQ(popcount(""), 0);
+  EXPECT_EQ(popcount("\xff\x01"), 9);
+  EXPECT_EQ(popcount(std::string(1000, '\xff')), 8000);
+
+  // Cover every tail length around the 32-byte vector and 512-byte step
+  // sizes, at unaligned offsets.
+  const auto data = get_random_bytes(4096, 7);
+  for (std::size_t offset = 0; offset < 3; ++offset) {
+    for (std::size_t len = 0; len + offset <= 1100; ++len) {
+      const std::string_view view(data.data() + offset, len);
+      std::uint64_t expected = 0;
+      for (const auto byte : view) {
+        expected += static_cast<std::uint64_t>(
+            std::popcount(static_cast<unsigned char>(byte)));
+      }
+      ASSERT_EQ(popcount_portable(view), expected)
+          << "offset " << offset << ", length " << len;
+      ASSERT_EQ(popcount_avx2(view), expected)
+          << "offset " << offset << ", length " << len;
+    }
+  }
+}
+
+TEST(BitopsTest, Bitwise) {
+  const auto first = get_random_bytes(300, 7);
+  const auto second = get_random_bytes(300, 8);
+  for (const auto op : {BitOp::And, BitOp::Or, BitOp::Xor, BitOp::Not}) {
+    for (std::size_t len = 0; len <= first.size(); ++len) {
+      std::string expected = first.substr(0, len);
+      for (std::size_t i = 0; i < len; ++i) {
+        const auto source = static_cast<unsigned char>(second[i]);
+        auto &byte = expected[i];
+        switch (op) {
+        case BitOp::And:
+          byte = static_cast<char>(byte & source);
+          break;
+        case BitOp::Or:
+          byte = static_cast<char>(byte | source);
+          break;
+        case BitOp::Xor:
+          byte = static_cast<char>(byte ^ source);
+          break;
+        case BitOp::Not:
+          byte = static_cast<char>(~source);
+          break;
+        }
+      }
+      const std::string_view source(second.data(), len);
+      auto portable = first.substr(0, len);
+      bitwise_portable(op, portable.data(), source);
+      ASSERT_EQ(portable, expected) << "length " << len;
+      auto avx2 = first.substr(0, len);
+      bitwise_avx2(op, avx2.data(), source);
+      ASSERT_EQ(avx2, expected) << "length " << len;
+    }
+  }
+}
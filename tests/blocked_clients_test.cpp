@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "../src/blocked_clients.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+// A connected pair of sockets: the first stands in for a client connection
+// the server blocks, and closing the second hangs the client up.
+std::pair<int, int> make_socket_pair() {
+  std::array<int, 2> fds{};
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+  return {fds[0], fds[1]};
+}
+
+BlockedClient make_client(int fd, std::vector<std::string> keys,
+                          std::size_t db_index = 0) {
+  return BlockedClient{SocketFd(fd), ClientState{db_index},
+                       Command{CommandVerb::BLPop, {}}, std::move(keys),
+                       std::nullopt};
+}
+} // namespace
+
+TEST(BlockedClientsTest, QueuesAreFirstInFirstOut) {
+  BlockedClients blocked{};
+  std::vector<int> peers{};
+  std::vector<BlockedClients::Id> ids{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    const auto [fd, peer] = make_socket_pair();
+    peers.push_back(peer);
+    // The repeated key only counts once.
+    ids.push_back(blocked.block(make_client(fd, {"a", "b", "a"})));
+  }
+  const auto [fd, peer] = make_socket_pair();
+  peers.push_back(peer);
+  const auto other_db = blocked.block(make_client(fd, {"a"}, 1));
+  EXPECT_EQ(blocked.size(), 4);
+  EXPECT_EQ(blocked.waiting_on(0, "a"), ids);
+  EXPECT_EQ(blocked.waiting_on(0, "b"), ids);
+  EXPECT_EQ(blocked.waiting_on(1, "a"),
+            std::vector<BlockedClients::Id>{other_db});
+  EXPECT_TRUE(blocked.waiting_on(0, "c").empty());
+
+  const auto client = blocked.unblock(ids[1]);
+  ASSERT_TRUE(client.has_value());
+  EXPECT_EQ(client->keys, (std::vector<std::string>{"a", "b"}));
+  EXPECT_FALSE(blocked.unblock(ids[1]).has_value());
+  EXPECT_EQ(blocked.find(ids[1]), nullptr);
+  EXPECT_EQ(blocked.waiting_on(0, "a"),
+            (std::vector<BlockedClients::Id>{ids[0], ids[2]}));
+  close(static_cast<int>(client->fd));
+  for (const auto peer : peers) {
+    close(peer);
+  }
+}
+
+TEST(BlockedClientsTest, DeadlinesAndHangUps) {
+  BlockedClients blocked{};
+  const auto now = BlockedClients::Clock::now();
+  const auto [first_fd, first_peer] = make_socket_pair();
+  auto first = make_client(first_fd, {"a"});
+  first.deadline = now + 20ms;
+  const auto first_id = blocked.block(std::move(first));
+  const auto [second_fd, second_peer] = make_socket_pair();
+  auto second = make_client(second_fd, {"a"});
+  second.deadline = now + 10ms;
+  const auto second_id = blocked.block(std::move(second));
+  const auto [forever_fd, forever_peer] = make_socket_pair();
+  const auto forever_id = blocked.block(make_client(forever_fd, {"a"}));
+
+  EXPECT_EQ(blocked.next_deadline(), now + 10ms);
+  EXPECT_TRUE(blocked.timed_out(now).empty());
+  EXPECT_EQ(blocked.timed_out(now + 1s),
+            (std::vector<BlockedClients::Id>{second_id, first_id}));
+  // Nothing hangs up before the earliest deadline passes.
+  EXPECT_TRUE(blocked.wait(blocked.next_deadline()).empty());
+  EXPECT_GE(BlockedClients::Clock::now(), now + 10ms);
+
+  blocked.wake();
+  EXPECT_TRUE(blocked.wait(std::nullopt).empty());
+
+  // Data from a blocked client waits until it is unblocked.
+  ASSERT_EQ(write(forever_peer, "x", 1), 1);
+  EXPECT_TRUE(blocked.wait(BlockedClients::Clock::now()).empty());
+  close(forever_peer);
+  EXPECT_EQ(blocked.wait(std::nullopt),
+            std::vector<BlockedClients::Id>{forever_id});
+  ASSERT_TRUE(blocked.unblock(forever_id).has_value());
+  close(forever_fd);
+  // The rest are closed along with the blocked clients.
+  close(first_peer);
+  close(second_peer);
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "../src/cache.hpp"
+#include "../src/cluster.hpp"
+#include "../src/protocol.hpp"
+
+namespace {
+
+Message cluster(ClusterState &state, Cache &cache,
+                std::vector<std::string> args) {
+  return handle_cluster_command(Command{CommandVerb::Cluster, std::move(args)},
+                                state, cache);
+}
+
+const Message OK{"OK", DataType::SimpleString};
+
+} // namespace
+
+TEST(ClusterTest, KeyHashSlot) {
+  // The check value of CRC16 XMODEM.
+  EXPECT_EQ(crc16("123456789"), 0x31C3);
+  EXPECT_EQ(crc16(""), 0);
+  EXPECT_EQ(key_hash_slot("foo"), 12182);
+  EXPECT_EQ(key_hash_slot("bar"), 5061);
+  // Only the first non-empty hashtag counts.
+  EXPECT_EQ(key_hash_slot("{foo}.bar"), key_hash_slot("foo"));
+  EXPECT_EQ(key_hash_slot("user:{foo}:name"), key_hash_slot("foo"));
+  EXPECT_EQ(key_hash_slot("{foo}{bar}"), key_hash_slot("foo"));
+  EXPECT_EQ(key_hash_slot("{}foo"), crc16("{}foo") % CLUSTER_SLOTS);
+  EXPECT_EQ(key_hash_slot("foo{"), crc16("foo{") % CLUSTER_SLOTS);
+}
+
+TEST(ClusterTest, Redirect) {
+  ClusterState state("127.0.0.1", 7000);
+  const auto other = state.add_node(ClusterNode{"other", "10.0.0.2", 7001});
+  const auto none_here = [] { return std::size_t{0}; };
+  const auto one_here = [] { return std::size_t{1}; };
+
+  EXPECT_EQ(state.redirect(5, false, 1, none_here),
+            "CLUSTERDOWN Hash slot not served");
+  state.set_owner(5, ClusterState::MYSELF);
+  state.set_owner(6, other);
+  EXPECT_EQ(state.redirect(5, false, 1, none_here), std::nullopt);
+  EXPECT_EQ(state.redirect(6, false, 1, none_here), "MOVED 6 10.0.0.2:7001");
+  // ASKING only lets clients into slots we are importing.
+  EXPECT_EQ(state.redirect(6, true, 1, none_here), "MOVED 6 10.0.0.2:7001");
+
+  // Migrating away: keys still here are served here, the rest are asked for
+  // at the other node.
+  state.set_migrating(5, other);
+  EXPECT_EQ(state.redirect(5, false, 1, one_here), std::nullopt);
+  EXPECT_EQ(state.redirect(5, false, 1, none_here), "ASK 5 10.0.0.2:7001");
+  EXPECT_EQ(state.redirect(5, false, 2, one_here),
+            "TRYAGAIN Multiple keys request during rehashing of slot");
+
+  // Importing: only clients that were sent here with ASK.
+  state.set_importing(6, other);
+  EXPECT_EQ(state.redirect(6, false, 1, none_here), "MOVED 6 10.0.0.2:7001");
+  EXPECT_EQ(state.redirect(6, true, 1, none_here), std::nullopt);
+  EXPECT_EQ(state.redirect(6, true, 2, one_here),
+            "TRYAGAIN Multiple keys request during rehashing of slot");
+
+  state.set_stable(5);
+  EXPECT_EQ(state.redirect(5, false, 1, none_here), std::nullopt);
+}
+
+TEST(ClusterTest, ClusterCommands) {
+  ClusterState state("127.0.0.1", 7000);
+  Cache cache{};
+  cache.set("foo", "1");
+  cache.set("{foo}2", "2");
+  cache.set("bar", "3");
+
+  EXPECT_EQ(cluster(state, cache, {"addslotsrange", "0", "99", "200", "299"}),
+            OK);
+  EXPECT_EQ(cluster(state, cache, {"addslots", "150", "50"}),
+            Message("ERR Slot 50 is already busy", DataType::SimpleError));
+  // Nothing changes when any of the slots is busy.
+  EXPECT_EQ(state.owner(150), std::nullopt);
+  EXPECT_EQ(cluster(state, cache, {"addslots", "16384"}),
+            Message("ERR Invalid or out of range slot",
+                    DataType::SimpleError));
+  EXPECT_EQ(cluster(state, cache, {"delslots", "0"}), OK);
+  const auto ranges = state.slot_ranges();
+  ASSERT_EQ(ranges.size(), 2);
+  EXPECT_EQ(ranges[0].start, 1);
+  EXPECT_EQ(ranges[0].end, 99);
+  EXPECT_EQ(ranges[1].start, 200);
+  EXPECT_EQ(ranges[1].end, 299);
+
+  EXPECT_EQ(cluster(state, cache, {"keyslot", "foo"}),
+            Message("12182", DataType::Integer));
+  EXPECT_EQ(cluster(state, cache, {"countkeysinslot", "12182"}),
+            Message("2", DataType::Integer));
+  EXPECT_EQ(cluster(state, cache, {"getkeysinslot", "5061", "10"}),
+            Message(Message::NestedVariantT{Message("bar",
+                                                    DataType::BulkString)},
+                    DataType::Array));
+
+  // Slots can only be handed to known nodes, and only once their keys are
+  // gone.
+  state.add_node(ClusterNode{"other", "10.0.0.2", 7001});
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5", "node", "unknown"}),
+            Message("ERR I don't know about node unknown",
+                    DataType::SimpleError));
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5", "migrating", "other"}),
+            OK);
+  EXPECT_EQ(state.migrating_to(5), 1);
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5", "node", "other"}), OK);
+  EXPECT_EQ(state.owner(5), 1);
+  EXPECT_EQ(state.migrating_to(5), std::nullopt);
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5061", "importing", "other"}),
+            OK);
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5061", "node", "myself"}),
+            Message("ERR I don't know about node myself",
+                    DataType::SimpleError));
+  EXPECT_EQ(
+      cluster(state, cache, {"setslot", "5061", "node", state.myself().id}),
+      OK);
+  EXPECT_EQ(state.owner(5061), ClusterState::MYSELF);
+  EXPECT_EQ(state.importing_from(5061), std::nullopt);
+  EXPECT_EQ(cluster(state, cache, {"setslot", "5061", "node", "other"}),
+            Message("ERR Can't assign hashslot 5061 to a different node "
+                    "while I still hold keys for this hash slot.",
+                    DataType::SimpleError));
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../src/command_stats.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using Histogram = LatencyHistogram;
+} // namespace
+
+TEST(CommandStatsTest, BucketsAreWithinASixteenthOfTheirValues) {
+  for (std::uint64_t value = 0; value < 16; ++value) {
+    EXPECT_EQ(Histogram::highest_in_bucket(Histogram::bucket_of(value)),
+              value);
+  }
+  for (const std::uint64_t value :
+       {16ULL, 17ULL, 31ULL, 32ULL, 1000ULL, 123456ULL, 987654321ULL}) {
+    const auto highest =
+        Histogram::highest_in_bucket(Histogram::bucket_of(value));
+    EXPECT_GE(highest, value);
+    EXPECT_LE(highest - value, value / Histogram::SUB_BUCKETS);
+  }
+  // Consecutive buckets meet.
+  for (std::size_t bucket = 0; bucket + 1 < Histogram::NUM_BUCKETS; ++bucket) {
+    ASSERT_EQ(Histogram::bucket_of(Histogram::highest_in_bucket(bucket) + 1),
+              bucket + 1);
+  }
+  EXPECT_EQ(Histogram::bucket_of(Histogram::MAX_NANOSECONDS + 1000),
+            Histogram::NUM_BUCKETS - 1);
+}
+
+TEST(CommandStatsTest, Percentiles) {
+  Histogram histogram{};
+  EXPECT_EQ(histogram.percentile(0.5), 0);
+  // 1000 calls of 1us to 1000us.
+  for (std::uint64_t micros = 1; micros <= 1000; ++micros) {
+    histogram.add(Histogram::bucket_of(micros * 1000), 1);
+  }
+  EXPECT_EQ(histogram.count(), 1000);
+  const auto p50 = histogram.percentile(0.5);
+  EXPECT_GE(p50, 500000);
+  EXPECT_LE(p50, 500000 + (500000 / Histogram::SUB_BUCKETS));
+  const auto p999 = histogram.percentile(0.999);
+  EXPECT_GE(p999, 999000);
+  EXPECT_LE(p999, 999000 + (999000 / Histogram::SUB_BUCKETS));
+  EXPECT_EQ(histogram.percentile(1.0),
+            Histogram::highest_in_bucket(Histogram::bucket_of(1000000)));
+}
+
+TEST(CommandStatsTest, MergesTheThreadsCounts) {
+  CommandStats stats(static_cast<std::size_t>(CommandVerb::Get) + 1);
+  constexpr int NUM_THREADS = 8;
+  constexpr int NUM_CALLS = 1000;
+  // Two rounds of threads, where the second reuses the first one's shards.
+  for (int round = 0; round < 2; ++round) {
+    std::vector<std::jthread> threads{};
+    for (int i = 0; i < NUM_THREADS; ++i) {
+      threads.emplace_back([&stats, i] {
+        for (int call = 0; call < NUM_CALLS; ++call) {
+          stats.record(CommandVerb::Get, 2us, i == 0);
+        }
+        stats.record_rejected(CommandVerb::Get);
+        // Out of range, so not counted.
+        stats.record(CommandVerb::Unwatch, 1us, false);
+      });
+    }
+    // Reading while the threads count is safe.
+    const auto counts = stats.merged();
+    EXPECT_LE(
+        counts[static_cast<std::size_t>(CommandVerb::Get)].calls,
+        static_cast<std::uint64_t>((round + 1) * NUM_THREADS * NUM_CALLS));
+  }
+  const auto counts = stats.merged();
+  ASSERT_EQ(counts.size(), static_cast<std::size_t>(CommandVerb::Get) + 1);
+  const auto &get = counts[static_cast<std::size_t>(CommandVerb::Get)];
+  EXPECT_EQ(get.calls, 2 * NUM_THREADS * NUM_CALLS);
+  EXPECT_EQ(get.nanoseconds, 2 * NUM_THREADS * NUM_CALLS * 2000);
+  EXPECT_EQ(get.rejected, 2 * NUM_THREADS);
+  EXPECT_EQ(get.failed, 2 * NUM_CALLS);
+  EXPECT_EQ(get.latencies.count(), get.calls);
+  EXPECT_EQ(get.latencies.percentile(0.5),
+            Histogram::highest_in_bucket(Histogram::bucket_of(2000)));
+  EXPECT_EQ(counts[static_cast<std::size_t>(CommandVerb::Set)].calls, 0);
+}
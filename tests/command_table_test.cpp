@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../src/command_table.hpp"
+#include "../src/redis_core.hpp"
+
+namespace {
+// The words, sent as an array of bulk strings.
+Message request(const std::vector<std::string> &words) {
+  Message::NestedVariantT elements{};
+  for (const auto &word : words) {
+    elements.emplace_back(word, DataType::BulkString);
+  }
+  return Message{std::move(elements), DataType::Array};
+}
+} // namespace
+
+TEST(CommandTableTest, FindsNamesInAnyCase) {
+  for (const auto *name : {"get", "GET", "gEt"}) {
+    const auto *spec = find_command(name);
+    ASSERT_NE(spec, nullptr);
+    EXPECT_EQ(spec->verb, CommandVerb::Get);
+  }
+  EXPECT_EQ(find_command("getx"), nullptr);
+  EXPECT_EQ(find_command("ge"), nullptr);
+  EXPECT_EQ(find_command(""), nullptr);
+  EXPECT_EQ(find_command("config")->verb, CommandVerb::ConfigGet);
+}
+
+TEST(CommandTableTest, EveryVerbHasItsCommand) {
+  EXPECT_EQ(command_spec(CommandVerb::Unknown), nullptr);
+  for (auto verb = static_cast<int>(CommandVerb::Ping);
+       verb <= static_cast<int>(CommandVerb::SlowLog); ++verb) {
+    const auto *spec = command_spec(static_cast<CommandVerb>(verb));
+    ASSERT_NE(spec, nullptr) << verb;
+    EXPECT_EQ(spec->verb, static_cast<CommandVerb>(verb));
+    EXPECT_EQ(find_command(spec->name), spec);
+    // Reads and writes are told apart, and only commands on keys are either.
+    EXPECT_FALSE(spec->has(CommandSpec::Write) &&
+                 spec->has(CommandSpec::ReadOnly))
+        << spec->name;
+    EXPECT_FALSE(spec->has(CommandSpec::Loading) &&
+                 (spec->has(CommandSpec::Write) ||
+                  spec->has(CommandSpec::ReadOnly)))
+        << spec->name;
+  }
+}
+
+TEST(CommandTableTest, Arity) {
+  const auto *get = find_command("get");
+  EXPECT_FALSE(get->accepts(1));
+  EXPECT_TRUE(get->accepts(2));
+  EXPECT_FALSE(get->accepts(3));
+  const auto *lpop = find_command("lpop");
+  EXPECT_FALSE(lpop->accepts(1));
+  EXPECT_TRUE(lpop->accepts(2));
+  EXPECT_TRUE(lpop->accepts(3));
+  EXPECT_FALSE(lpop->accepts(4));
+  EXPECT_TRUE(find_command("del")->accepts(100));
+
+  const auto parse = [](const std::vector<std::string> &words) {
+    return parse_and_validate_command(request(words));
+  };
+  EXPECT_FALSE(parse({"get"}).has_value());
+  EXPECT_FALSE(parse({"GET", "a", "b"}).has_value());
+  EXPECT_FALSE(parse({"nosuchcommand", "a"}).has_value());
+  EXPECT_FALSE(parse({"config", "set", "dir"}).has_value());
+  const auto config = parse({"CONFIG", "GET", "dir"});
+  ASSERT_TRUE(config.has_value());
+  EXPECT_EQ(config->verb, CommandVerb::ConfigGet);
+  EXPECT_EQ(config->arguments, std::vector<std::string>{"dir"});
+}
+
+TEST(CommandTableTest, RejectedCommandErrors) {
+  const auto error = [](const std::vector<std::string> &words) {
+    const auto reply = command_error(request(words));
+    EXPECT_EQ(reply.get_data_type(), DataType::SimpleError);
+    return std::get<Message::StringVariantT>(reply.get_data());
+  };
+  EXPECT_EQ(error({"FOOBAR", "x"}), "ERR unknown command 'FOOBAR'");
+  EXPECT_EQ(error({"GET"}), "ERR wrong number of arguments for 'get' command");
+  EXPECT_EQ(error({"get", "a", "b"}),
+            "ERR wrong number of arguments for 'get' command");
+  EXPECT_EQ(error({"LLEN"}),
+            "ERR wrong number of arguments for 'llen' command");
+  EXPECT_EQ(error({"config"}),
+            "ERR wrong number of arguments for 'config|get' command");
+  EXPECT_EQ(error({"config", "set", "dir"}), "ERR unknown subcommand 'set'");
+  EXPECT_EQ(error({}), "ERR unknown command ''");
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+#include "../src/crc64.hpp"
+
+namespace {
+std::string get_random_bytes(const std::size_t length) {
+  // NOLINTNEXTLINE(cert-msc51-cpp, cert-msc32-c)
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<> distribution(0, 255);
+  std::string result(length, 0);
+  for (auto &byte : result) {
+    byte = static_cast<char>(distribution(generator));
+  }
+  return result;
+}
+} // namespace
+
+TEST(Crc64Test, CheckValue) {
+  // The standard "123456789" check value for CRC-64/Jones (as used by Redis).
+  EXPECT_EQ(crc64(0, "123456789"), 0xe9c6d914c4b8d9ca);
+  EXPECT_EQ(crc64_slicing_by_8(0, "123456789"), 0xe9c6d914c4b8d9ca);
+  EXPECT_EQ(crc64_clmul(0, "123456789"), 0xe9c6d914c4b8d9ca);
+  EXPECT_EQ(crc64(0, ""), 0);
+}
+
+TEST(Crc64Test, ImplementationsAgree) {
+  // Cover every tail length around the 16-byte block and 64-byte lane sizes,
+  // at unaligned offsets, and with a non-zero running crc.
+  const auto data = get_random_bytes(4096);
+  for (std::size_t offset = 0; offset < 3; ++offset) {
+    for (std::size_t len = 0; len + offset <= 600; ++len) {
+      const std::string_view view(data.data() + offset, len);
+      for (const std::uint64_t initial : {0UL, 0x0123456789abcdefUL}) {
+        ASSERT_EQ(crc64_clmul(initial, view),
+                  crc64_slicing_by_8(initial, view))
+            << "offset " << offset << ", length " << len;
+      }
+    }
+  }
+}
+
+TEST(Crc64Test, Incremental) {
+  // Checksumming in pieces gives the same result as checksumming in one go.
+  const auto data = get_random_bytes(100000);
+  const auto expected = crc64(0, data);
+  std::uint64_t crc = 0;
+  for (std::size_t pos = 0; pos < data.size(); pos += 777) {
+    crc = crc64(crc, std::string_view(data).substr(pos, 777));
+  }
+  EXPECT_EQ(crc, expected);
+}
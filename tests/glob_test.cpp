@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "../src/glob.hpp"
+
+TEST(GlobTest, Match) {
+  EXPECT_TRUE(glob_match("*", ""));
+  EXPECT_TRUE(glob_match("*", "anything"));
+  EXPECT_TRUE(glob_match("user:*", "user:42"));
+  EXPECT_FALSE(glob_match("user:*", "users:42"));
+  EXPECT_TRUE(glob_match("h?llo", "hello"));
+  EXPECT_FALSE(glob_match("h?llo", "hllo"));
+  EXPECT_TRUE(glob_match("*a*b*", "xxaxxbxx"));
+  EXPECT_FALSE(glob_match("*a*b*", "xxbxxaxx"));
+  // The star has to backtrack past a partial match of what follows it.
+  EXPECT_TRUE(glob_match("*abc", "ababc"));
+  EXPECT_TRUE(glob_match("**", "x"));
+  EXPECT_FALSE(glob_match("", "x"));
+}
+
+TEST(GlobTest, ClassesAndEscapes) {
+  EXPECT_TRUE(glob_match("h[ae]llo", "hallo"));
+  EXPECT_FALSE(glob_match("h[ae]llo", "hillo"));
+  EXPECT_TRUE(glob_match("h[^e]llo", "hallo"));
+  EXPECT_FALSE(glob_match("h[^e]llo", "hello"));
+  EXPECT_TRUE(glob_match("[a-c]x", "bx"));
+  EXPECT_TRUE(glob_match("[c-a]x", "bx"));
+  EXPECT_FALSE(glob_match("[a-c]x", "dx"));
+  EXPECT_TRUE(glob_match("[\\]]", "]"));
+  EXPECT_TRUE(glob_match("a\\*", "a*"));
+  EXPECT_FALSE(glob_match("a\\*", "ab"));
+  EXPECT_TRUE(glob_match("a\\?b", "a?b"));
+  // An unterminated class runs to the end of the pattern.
+  EXPECT_TRUE(glob_match("[ab", "b"));
+}
+
+TEST(GlobTest, LiteralPrefix) {
+  using Prefix = std::pair<std::string, std::size_t>;
+  EXPECT_EQ(glob_literal_prefix("news.*"), Prefix("news.", 5));
+  EXPECT_EQ(glob_literal_prefix("news"), Prefix("news", 4));
+  EXPECT_EQ(glob_literal_prefix("*"), Prefix("", 0));
+  EXPECT_EQ(glob_literal_prefix("a?c"), Prefix("a", 1));
+  EXPECT_EQ(glob_literal_prefix("ab[cd]"), Prefix("ab", 2));
+  // Escaped characters are literal, but take up two characters.
+  EXPECT_EQ(glob_literal_prefix("a\\*b*"), Prefix("a*b", 4));
+}
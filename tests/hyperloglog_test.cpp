@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+#include "../src/hyperloglog.hpp"
+
+namespace {
+constexpr std::size_t SPARSE_MAX_BYTES = 3000;
+
+std::string add_elements(std::size_t first, std::size_t last,
+                         std::size_t sparse_max_bytes) {
+  auto hll = hll_create();
+  for (auto i = first; i < last; ++i) {
+    hll_add(hll, "element:" + std::to_string(i), sparse_max_bytes);
+  }
+  return hll;
+}
+
+HllRegisters registers_of(std::string_view hll) {
+  HllRegisters registers{};
+  hll_merge_portable(registers, hll);
+  return registers;
+}
+} // namespace
+
+TEST(HyperLogLogTest, Empty) {
+  auto hll = hll_create();
+  EXPECT_TRUE(is_hll(hll));
+  EXPECT_TRUE(hll_is_sparse(hll));
+  EXPECT_EQ(hll_cached_count(hll), 0);
+  EXPECT_EQ(hll_count(hll), 0);
+  EXPECT_EQ(hll_estimate(HllRegisters{}), 0);
+}
+
+TEST(HyperLogLogTest, AddAndCount) {
+  auto hll = hll_create();
+  EXPECT_TRUE(hll_add(hll, "a", SPARSE_MAX_BYTES));
+  EXPECT_FALSE(hll_add(hll, "a", SPARSE_MAX_BYTES));
+  EXPECT_FALSE(hll_cached_count(hll).has_value());
+  EXPECT_EQ(hll_count(hll), 1);
+  EXPECT_EQ(hll_cached_count(hll), 1);
+
+  for (const std::size_t num_elements : {10UL, 1000UL, 100000UL}) {
+    auto counted = add_elements(0, num_elements, SPARSE_MAX_BYTES);
+    ASSERT_TRUE(is_hll(counted));
+    const auto estimate = static_cast<double>(hll_count(counted));
+    // Well within a few standard errors (0.81%).
+    EXPECT_NEAR(estimate, static_cast<double>(num_elements),
+                static_cast<double>(num_elements) * 0.03)
+        << num_elements << " elements";
+  }
+}
+
+TEST(HyperLogLogTest, SparseTurnsDense) {
+  // The encodings hold the same registers, so they give the same estimate.
+  auto sparse = add_elements(0, 200, SPARSE_MAX_BYTES);
+  auto dense = add_elements(0, 200, 0);
+  EXPECT_TRUE(hll_is_sparse(sparse));
+  EXPECT_FALSE(hll_is_sparse(dense));
+  EXPECT_TRUE(is_hll(dense));
+  EXPECT_EQ(registers_of(sparse), registers_of(dense));
+  EXPECT_EQ(hll_count(sparse), hll_count(dense));
+
+  auto grown = add_elements(0, 5000, SPARSE_MAX_BYTES);
+  EXPECT_FALSE(hll_is_sparse(grown));
+  EXPECT_EQ(registers_of(grown), registers_of(add_elements(0, 5000, 0)));
+}
+
+TEST(HyperLogLogTest, Merge) {
+  const auto first = add_elements(0, 3000, 0);
+  const auto second = add_elements(2000, 6000, 0);
+  const auto sparse = add_elements(5000, 5100, SPARSE_MAX_BYTES);
+  HllRegisters portable{};
+  HllRegisters avx2{};
+  for (const auto &hll : {first, second, sparse}) {
+    hll_merge_portable(portable, hll);
+    hll_merge_avx2(avx2, hll);
+  }
+  EXPECT_EQ(portable, avx2);
+  EXPECT_EQ(portable, registers_of(add_elements(0, 6000, 0)));
+  EXPECT_NEAR(static_cast<double>(hll_estimate(portable)), 6000, 6000 * 0.03);
+}
+
+TEST(HyperLogLogTest, FromRegisters) {
+  // NOLINTNEXTLINE(cert-msc51-cpp, cert-msc32-c)
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<> distribution(0, 51);
+  HllRegisters registers{};
+  for (auto &value : registers) {
+    value = static_cast<std::uint8_t>(distribution(generator));
+  }
+  const auto dense = hll_from_registers(registers, SPARSE_MAX_BYTES);
+  EXPECT_TRUE(is_hll(dense));
+  EXPECT_FALSE(hll_is_sparse(dense));
+  EXPECT_EQ(registers_of(dense), registers);
+  HllRegisters avx2{};
+  hll_merge_avx2(avx2, dense);
+  EXPECT_EQ(avx2, registers);
+
+  HllRegisters few{};
+  few[0] = 3;
+  few[1] = 3;
+  few[HLL_REGISTERS - 1] = 32;
+  const auto sparse = hll_from_registers(few, SPARSE_MAX_BYTES);
+  EXPECT_TRUE(is_hll(sparse));
+  EXPECT_TRUE(hll_is_sparse(sparse));
+  EXPECT_EQ(registers_of(sparse), few);
+}
+
+TEST(HyperLogLogTest, Invalid) {
+  auto hll = hll_create();
+  EXPECT_FALSE(is_hll(""));
+  EXPECT_FALSE(is_hll("HYLL"));
+  EXPECT_FALSE(is_hll(hll.substr(0, hll.size() - 1)));
+  // Covers one register too many.
+  EXPECT_FALSE(is_hll(hll + '\0'));
+  auto wrong_encoding = hll;
+  wrong_encoding[4] = 2;
+  EXPECT_FALSE(is_hll(wrong_encoding));
+  auto dense = add_elements(0, 10, 0);
+  EXPECT_FALSE(is_hll(dense + 'x'));
+}
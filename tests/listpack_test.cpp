@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../src/intset.hpp"
+#include "../src/listpack.hpp"
+#include "../src/lzf.hpp"
+#include "../src/ziplist.hpp"
+
+namespace {
+std::vector<std::string> listpack_elements(const Listpack &listpack) {
+  std::vector<std::string> result{};
+  listpack.for_each([&result](const Listpack::Element &element) {
+    result.push_back(Listpack::to_string(element));
+  });
+  return result;
+}
+} // namespace
+
+TEST(ListpackTest, PushBackAndIterate) {
+  Listpack listpack{};
+  EXPECT_TRUE(listpack.empty());
+
+  // Strings of every length encoding, and integers of every width (including
+  // strings that are really integers).
+  const std::vector<std::string> elements = {
+      "",
+      "hello",
+      std::string(100, 'x'),
+      std::string(5000, 'y'),
+      "0",
+      "127",
+      "-1",
+      "4095",
+      "-4096",
+      "32767",
+      "8388607",
+      "-2147483648",
+      std::to_string(std::numeric_limits<std::int64_t>::max()),
+      std::to_string(std::numeric_limits<std::int64_t>::min()),
+      // Not canonical integers, so these stay strings.
+      "007",
+      "-0",
+      "1.5",
+  };
+  for (const auto &element : elements) {
+    listpack.push_back(element);
+  }
+  EXPECT_EQ(listpack.size(), elements.size());
+  EXPECT_EQ(listpack_elements(listpack), elements);
+
+  // Integers are stored as integers.
+  std::size_t num_ints = 0;
+  listpack.for_each([&num_ints](const Listpack::Element &element) {
+    num_ints += std::holds_alternative<std::int64_t>(element) ? 1 : 0;
+  });
+  EXPECT_EQ(num_ints, 10);
+
+  // The serialized form can be wrapped again as is.
+  const auto copy = Listpack::from_bytes(listpack.bytes());
+  ASSERT_TRUE(copy.has_value());
+  EXPECT_EQ(*copy, listpack);
+}
+
+TEST(ListpackTest, FromBytesRejectsMalformed) {
+  Listpack listpack{};
+  listpack.push_back("hello");
+  listpack.push_back(std::int64_t{1000});
+  const auto &bytes = listpack.bytes();
+
+  // Truncated.
+  EXPECT_FALSE(Listpack::from_bytes(bytes.substr(0, bytes.size() - 1)));
+  // Wrong total length in the header.
+  auto bad_total = bytes;
+  bad_total[0] = static_cast<char>(bad_total[0] + 1);
+  EXPECT_FALSE(Listpack::from_bytes(bad_total));
+  // A string entry claiming to be longer than the listpack.
+  auto bad_entry = bytes;
+  bad_entry[6] = static_cast<char>(0x80 | 0x3F);
+  EXPECT_FALSE(Listpack::from_bytes(bad_entry));
+  // Wrong element count.
+  auto bad_count = bytes;
+  bad_count[4] = 3;
+  EXPECT_FALSE(Listpack::from_bytes(bad_count));
+}
+
+TEST(ListpackTest, PushFrontPopAndErase) {
+  Listpack listpack{};
+  for (const auto *element : {"c", "1000", "b", "-7", "a"}) {
+    listpack.push_front(element);
+  }
+  EXPECT_EQ(listpack_elements(listpack),
+            (std::vector<std::string>{"a", "-7", "b", "1000", "c"}));
+  // Popping walks back from the end using the backlens, including over the
+  // long entry.
+  listpack.push_back(std::string(200, 'z'));
+  EXPECT_EQ(listpack.pop_back(), std::string(200, 'z'));
+  EXPECT_EQ(listpack.pop_back(), "c");
+  EXPECT_EQ(listpack.pop_front(), "a");
+  EXPECT_EQ(listpack.size(), 3);
+
+  listpack.erase(1, 1);
+  EXPECT_EQ(listpack_elements(listpack),
+            (std::vector<std::string>{"-7", "1000"}));
+  // Erasing past the end stops at the last element.
+  listpack.erase(1, 10);
+  EXPECT_EQ(listpack_elements(listpack), (std::vector<std::string>{"-7"}));
+
+  std::vector<std::string> ranged{};
+  listpack.push_back("x");
+  listpack.push_back("y");
+  listpack.for_each(1, 5, [&ranged](const Listpack::Element &element) {
+    ranged.push_back(Listpack::to_string(element));
+  });
+  EXPECT_EQ(ranged, (std::vector<std::string>{"x", "y"}));
+  // The result is still a valid listpack.
+  EXPECT_TRUE(Listpack::from_bytes(listpack.bytes()));
+}
+
+TEST(ListpackTest, FindAndReplace) {
+  // Alternating fields and values, like a small hash.
+  Listpack listpack{};
+  for (const auto *element : {"name", "ada", "age", "36", "36", "name"}) {
+    listpack.push_back(element);
+  }
+  EXPECT_EQ(listpack.find("name"), 0);
+  EXPECT_EQ(listpack.find("ada"), 1);
+  EXPECT_EQ(listpack.find("36"), 3);
+  EXPECT_FALSE(listpack.find("036"));
+  EXPECT_FALSE(listpack.find("missing"));
+  // Skipping the values only finds fields.
+  EXPECT_EQ(listpack.find("36", 1), 4);
+  EXPECT_FALSE(listpack.find("ada", 1));
+
+  listpack.replace(1, std::string(100, 'x'));
+  listpack.replace(3, "37");
+  EXPECT_EQ(listpack_elements(listpack),
+            (std::vector<std::string>{"name", std::string(100, 'x'), "age",
+                                      "37", "36", "name"}));
+  EXPECT_TRUE(Listpack::from_bytes(listpack.bytes()));
+}
+
+TEST(IntSetTest, FromBytes) {
+  // Three 16-bit integers: -5, 1, 300.
+  const std::string bytes("\x02\x00\x00\x00"
+                          "\x03\x00\x00\x00"
+                          "\xFB\xFF"
+                          "\x01\x00"
+                          "\x2C\x01",
+                          14);
+  const auto intset = IntSet::from_bytes(bytes);
+  ASSERT_TRUE(intset.has_value());
+  EXPECT_EQ(intset->size(), 3);
+  EXPECT_EQ(intset->at(0), -5);
+  EXPECT_EQ(intset->at(1), 1);
+  EXPECT_EQ(intset->at(2), 300);
+  EXPECT_TRUE(intset->contains(-5));
+  EXPECT_TRUE(intset->contains(300));
+  EXPECT_FALSE(intset->contains(2));
+  EXPECT_EQ(intset->bytes(), bytes);
+
+  // Out of order contents.
+  auto unsorted = bytes;
+  std::swap(unsorted[8], unsorted[12]);
+  std::swap(unsorted[9], unsorted[13]);
+  EXPECT_FALSE(IntSet::from_bytes(unsorted));
+  // Unsupported width.
+  auto bad_width = bytes;
+  bad_width[0] = 3;
+  EXPECT_FALSE(IntSet::from_bytes(bad_width));
+  // Truncated.
+  EXPECT_FALSE(IntSet::from_bytes(bytes.substr(0, 13)));
+}
+
+TEST(IntSetTest, InsertAndErase) {
+  IntSet intset{};
+  EXPECT_TRUE(intset.insert(5));
+  EXPECT_TRUE(intset.insert(-3));
+  EXPECT_FALSE(intset.insert(5));
+  EXPECT_EQ(intset.bytes().size(), 8 + (2 * 2));
+  // Widens the encoding for integers that don't fit 16 bits.
+  EXPECT_TRUE(intset.insert(100'000));
+  EXPECT_TRUE(intset.insert(std::numeric_limits<std::int64_t>::min()));
+  EXPECT_EQ(intset.bytes().size(), 8 + (4 * 8));
+  EXPECT_EQ(intset.at(0), std::numeric_limits<std::int64_t>::min());
+  EXPECT_EQ(intset.at(3), 100'000);
+  EXPECT_TRUE(intset.erase(-3));
+  EXPECT_FALSE(intset.erase(-3));
+  EXPECT_EQ(intset.size(), 3);
+  EXPECT_EQ(intset.at(1), 5);
+  EXPECT_TRUE(IntSet::from_bytes(intset.bytes()));
+}
+
+TEST(IntSetTest, Intersect) {
+  const auto to_vector = [](const IntSet &intset) {
+    std::vector<std::int64_t> values{};
+    intset.for_each([&values](std::int64_t value) { values.push_back(value); });
+    return values;
+  };
+  // Every width, long enough for whole blocks and a leftover tail.
+  for (const std::int64_t scale : {1, 1'000, 1'000'000'000}) {
+    IntSet multiples_of_two{};
+    IntSet multiples_of_three{};
+    std::vector<std::int64_t> expected{};
+    for (std::int64_t i = -30; i < 30; ++i) {
+      multiples_of_two.insert(i * 2 * scale);
+      multiples_of_three.insert(i * 3 * scale);
+      if (i % 3 == 0) {
+        expected.push_back(i * 2 * scale);
+      }
+    }
+    const auto result = IntSet::intersect(multiples_of_two,
+                                          multiples_of_three);
+    EXPECT_EQ(to_vector(result), expected);
+    EXPECT_EQ(to_vector(IntSet::intersect(multiples_of_three,
+                                          multiples_of_two)),
+              expected);
+    EXPECT_TRUE(IntSet::from_bytes(result.bytes()));
+  }
+
+  // Mixed encodings.
+  IntSet narrow{};
+  IntSet wide{};
+  for (std::int64_t i = 0; i < 20; ++i) {
+    narrow.insert(i);
+    wide.insert(i * 5);
+  }
+  wide.insert(std::numeric_limits<std::int64_t>::max());
+  EXPECT_EQ(to_vector(IntSet::intersect(narrow, wide)),
+            (std::vector<std::int64_t>{0, 5, 10, 15}));
+  EXPECT_TRUE(IntSet::intersect(narrow, IntSet{}).empty());
+}
+
+TEST(ZiplistTest, ConvertToListpack) {
+  // A ziplist with the string "abc", the immediate integer 3 and the 8-bit
+  // integer -1.
+  const std::string ziplist("\x15\x00\x00\x00"
+                            "\x11\x00\x00\x00"
+                            "\x03\x00"
+                            "\x00\x03"
+                            "abc"
+                            "\x05\xF4"
+                            "\x02\xFE\xFF"
+                            "\xFF",
+                            21);
+  const auto listpack = ziplist_to_listpack(ziplist);
+  ASSERT_TRUE(listpack.has_value());
+  EXPECT_EQ(listpack_elements(*listpack),
+            (std::vector<std::string>{"abc", "3", "-1"}));
+
+  EXPECT_FALSE(ziplist_to_listpack(ziplist.substr(0, 20)));
+}
+
+TEST(ZiplistTest, ConvertZipmapToListpack) {
+  // A zipmap with the pairs (a, xy) and (bc, z), where the first value has one
+  // unused byte after it.
+  const std::string zipmap("\x02"
+                           "\x01"
+                           "a"
+                           "\x02\x01"
+                           "xy?"
+                           "\x02"
+                           "bc"
+                           "\x01\x00"
+                           "z"
+                           "\xFF",
+                           15);
+  const auto listpack = zipmap_to_listpack(zipmap);
+  ASSERT_TRUE(listpack.has_value());
+  EXPECT_EQ(listpack_elements(*listpack),
+            (std::vector<std::string>{"a", "xy", "bc", "z"}));
+}
+
+TEST(LzfTest, Decompress) {
+  // A literal run of "abc", then a back reference copying 6 bytes from 3 bytes
+  // back (which overlaps the bytes it is producing).
+  const std::string compressed("\x02"
+                               "abc"
+                               "\x80\x02",
+                               6);
+  EXPECT_EQ(lzf_decompress(compressed, 9), "abcabcabc");
+  // The decompressed length has to match exactly.
+  EXPECT_FALSE(lzf_decompress(compressed, 8));
+  EXPECT_FALSE(lzf_decompress(compressed, 10));
+  // A back reference pointing before the start.
+  EXPECT_FALSE(lzf_decompress(std::string("\x00"
+                                          "a"
+                                          "\x20\x05",
+                                          4),
+                              4));
+}
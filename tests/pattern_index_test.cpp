@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/glob.hpp"
+#include "../src/pattern_index.hpp"
+
+namespace {
+using Matches = std::vector<std::pair<std::string, std::vector<int>>>;
+
+Matches matches(const PatternIndex<int> &index, const std::string &channel) {
+  Matches found{};
+  index.for_each_match(channel, [&found](const std::string &pattern,
+                                         const std::vector<int> &subscribers) {
+    found.emplace_back(pattern, subscribers);
+  });
+  std::ranges::sort(found);
+  return found;
+}
+} // namespace
+
+TEST(PatternIndexTest, Match) {
+  PatternIndex<int> index{};
+  EXPECT_TRUE(index.add("news.*", 1));
+  EXPECT_TRUE(index.add("news.*", 2));
+  EXPECT_FALSE(index.add("news.*", 1));
+  EXPECT_TRUE(index.add("news.sport", 3));
+  EXPECT_TRUE(index.add("n?ws.[st]*", 4));
+  EXPECT_TRUE(index.add("*", 5));
+  EXPECT_EQ(index.size(), 4);
+
+  EXPECT_EQ(matches(index, "news.sport"),
+            (Matches{{"*", {5}},
+                     {"n?ws.[st]*", {4}},
+                     {"news.*", {1, 2}},
+                     {"news.sport", {3}}}));
+  EXPECT_EQ(matches(index, "news.art"),
+            (Matches{{"*", {5}}, {"news.*", {1, 2}}}));
+  // The exact pattern only matches the whole channel.
+  EXPECT_EQ(matches(index, "news.sports"),
+            (Matches{{"*", {5}}, {"n?ws.[st]*", {4}}, {"news.*", {1, 2}}}));
+  EXPECT_EQ(matches(index, "new"), (Matches{{"*", {5}}}));
+}
+
+TEST(PatternIndexTest, Remove) {
+  PatternIndex<int> index{};
+  index.add("a.b.*", 1);
+  index.add("a.b.*", 2);
+  index.add("a.*", 1);
+  EXPECT_FALSE(index.remove("a.b.*", 3));
+  EXPECT_FALSE(index.remove("a.c.*", 1));
+  EXPECT_TRUE(index.remove("a.b.*", 1));
+  EXPECT_EQ(matches(index, "a.b.c"),
+            (Matches{{"a.*", {1}}, {"a.b.*", {2}}}));
+  EXPECT_TRUE(index.remove("a.b.*", 2));
+  EXPECT_EQ(index.size(), 1);
+  EXPECT_EQ(matches(index, "a.b.c"), (Matches{{"a.*", {1}}}));
+  EXPECT_TRUE(index.remove("a.*", 1));
+  EXPECT_EQ(index.size(), 0);
+  EXPECT_TRUE(matches(index, "a.b.c").empty());
+}
+
+TEST(PatternIndexTest, AgreesWithGlobMatch) {
+  const std::vector<std::string> patterns{
+      "*",     "a*",   "a*b",     "a?",      "ab*",   "[ab]*", "ab\\*",
+      "a\\?b", "*b",   "a[^b]*",  "abc",     "a",     "",      "?",
+      "b*a",   "ab?c", "a[a-c]c", "\\[ab\\]*"};
+  const std::vector<std::string> channels{
+      "", "a", "b", "ab", "abc", "ab*", "a?b", "acc", "ba", "[ab]x", "abbc"};
+  PatternIndex<int> index{};
+  for (const auto &pattern : patterns) {
+    index.add(pattern, 0);
+  }
+  for (const auto &channel : channels) {
+    std::vector<std::string> expected{};
+    for (const auto &pattern : patterns) {
+      if (glob_match(pattern, channel)) {
+        expected.push_back(pattern);
+      }
+    }
+    std::vector<std::string> found{};
+    for (const auto &[pattern, subscribers] : matches(index, channel)) {
+      found.push_back(pattern);
+    }
+    std::ranges::sort(expected);
+    EXPECT_EQ(found, expected) << "channel: " << channel;
+  }
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#include "../src/pubsub.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+// A connected pair of sockets: the first stands in for the connection of the
+// client that subscribes, and the second for the client's end of it.
+std::pair<int, int> make_socket_pair() {
+  std::array<int, 2> fds{};
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()), 0);
+  return {fds[0], fds[1]};
+}
+
+// Reads from the socket until the expected number of bytes arrived (or it
+// took too long).
+std::string read_exactly(int fd, std::size_t size) {
+  std::string data{};
+  std::array<char, 4096> buffer{};
+  const auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (data.size() < size && std::chrono::steady_clock::now() < deadline) {
+    const auto received = recv(fd, buffer.data(),
+                               std::min(buffer.size(), size - data.size()),
+                               MSG_DONTWAIT);
+    if (received > 0) {
+      data.append(buffer.data(), static_cast<std::size_t>(received));
+    } else {
+      std::this_thread::sleep_for(1ms);
+    }
+  }
+  return data;
+}
+
+std::string message(const std::string &channel, const std::string &data) {
+  return message_to_string(Message{
+      Message::NestedVariantT{Message{"message", DataType::BulkString},
+                              Message{channel, DataType::BulkString},
+                              Message{data, DataType::BulkString}},
+      DataType::Array});
+}
+} // namespace
+
+TEST(PubSubTest, SubscribeAndPublish) {
+  PubSub pubsub([](SocketFd, ClientState) {}, 0);
+  const auto [fd, peer] = make_socket_pair();
+  pubsub.subscribe(SocketFd(fd), ClientState{},
+                   Command{CommandVerb::Subscribe, {"a", "b"}});
+  const std::string subscribed = "*3\r\n$9\r\nsubscribe\r\n$1\r\na\r\n:1\r\n"
+                                 "*3\r\n$9\r\nsubscribe\r\n$1\r\nb\r\n:2\r\n";
+  EXPECT_EQ(read_exactly(peer, subscribed.size()), subscribed);
+  EXPECT_EQ(pubsub.num_subscribers(), 1);
+
+  EXPECT_EQ(pubsub.publish("a", "hi"), 1);
+  EXPECT_EQ(pubsub.publish("c", "nobody"), 0);
+  EXPECT_EQ(pubsub.publish("b", "there"), 1);
+  const auto expected = message("a", "hi") + message("b", "there");
+  EXPECT_EQ(read_exactly(peer, expected.size()), expected);
+
+  const auto numsub = pubsub.introspect(
+      Command{CommandVerb::PubSub, {"NUMSUB", "a", "c"}});
+  EXPECT_EQ(message_to_string(numsub),
+            "*4\r\n$1\r\na\r\n:1\r\n$1\r\nc\r\n:0\r\n");
+  close(peer);
+}
+
+TEST(PubSubTest, PatternsAndUnsubscribing) {
+  std::atomic<int> resumed = -1;
+  PubSub pubsub(
+      [&resumed](SocketFd fd, ClientState state) {
+        EXPECT_EQ(state.db_index, 3);
+        resumed = static_cast<int>(fd);
+      },
+      0);
+  const auto [fd, peer] = make_socket_pair();
+  pubsub.subscribe(SocketFd(fd), ClientState{3},
+                   Command{CommandVerb::PSubscribe, {"news.*"}});
+  const std::string subscribed =
+      "*3\r\n$10\r\npsubscribe\r\n$6\r\nnews.*\r\n:1\r\n";
+  EXPECT_EQ(read_exactly(peer, subscribed.size()), subscribed);
+
+  EXPECT_EQ(pubsub.publish("news.art", "x"), 1);
+  const std::string pmessage = "*4\r\n$8\r\npmessage\r\n$6\r\nnews.*\r\n"
+                               "$8\r\nnews.art\r\n$1\r\nx\r\n";
+  EXPECT_EQ(read_exactly(peer, pmessage.size()), pmessage);
+
+  // The client unsubscribes from everything, and is handed back.
+  const auto punsubscribe = message_to_string(command_to_message(
+      Command{CommandVerb::PUnsubscribe, {}}));
+  ASSERT_EQ(send(peer, punsubscribe.data(), punsubscribe.size(), 0),
+            static_cast<ssize_t>(punsubscribe.size()));
+  const std::string unsubscribed =
+      "*3\r\n$12\r\npunsubscribe\r\n$6\r\nnews.*\r\n:0\r\n";
+  EXPECT_EQ(read_exactly(peer, unsubscribed.size()), unsubscribed);
+  const auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (resumed != fd && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(resumed, fd);
+  EXPECT_EQ(pubsub.num_subscribers(), 0);
+  EXPECT_EQ(pubsub.publish("news.art", "x"), 0);
+  close(fd);
+  close(peer);
+}
+
+TEST(PubSubTest, SlowSubscriberIsDisconnected) {
+  PubSub pubsub([](SocketFd, ClientState) {}, 64UL * 1024);
+  const auto [fd, peer] = make_socket_pair();
+  pubsub.subscribe(SocketFd(fd), ClientState{},
+                   Command{CommandVerb::Subscribe, {"a"}});
+  // The peer never reads, so the messages pile up past the limit.
+  const std::string data(1024, 'x');
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (pubsub.num_subscribers() > 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    pubsub.publish("a", data);
+  }
+  EXPECT_EQ(pubsub.num_subscribers(), 0);
+  close(peer);
+}
+
+TEST(PubSubTest, Resp3SubscribersGetPushData) {
+  PubSub pubsub([](SocketFd, ClientState) {}, 0);
+  const auto [fd, peer] = make_socket_pair();
+  pubsub.subscribe(SocketFd(fd), ClientState{.protocol = Protocol::Resp3},
+                   Command{CommandVerb::Subscribe, {"a"}});
+  const std::string subscribed = ">3\r\n$9\r\nsubscribe\r\n$1\r\na\r\n:1\r\n";
+  EXPECT_EQ(read_exactly(peer, subscribed.size()), subscribed);
+  EXPECT_EQ(pubsub.publish("a", "hi"), 1);
+  const std::string pushed = ">3\r\n$7\r\nmessage\r\n$1\r\na\r\n$2\r\nhi\r\n";
+  EXPECT_EQ(read_exactly(peer, pushed.size()), pushed);
+  close(peer);
+}
+
+TEST(PubSubTest, AttachedClientsGetPushesWithoutBlockingPushers) {
+  PubSub pubsub([](SocketFd, ClientState) {}, 64UL * 1024);
+  const auto [fd, peer] = make_socket_pair();
+  const ClientState state{.id = 7, .protocol = Protocol::Resp3};
+  pubsub.attach(SocketFd(fd), state);
+  EXPECT_EQ(pubsub.num_subscribers(), 0);
+  const Message invalidate{
+      Message::NestedVariantT{Message{"invalidate", DataType::BulkString},
+                              Message{"", DataType::Null}},
+      DataType::Push};
+  const auto pushed = message_to_string(invalidate, Protocol::Resp3);
+  // Only subscribed clients get what push() sends.
+  EXPECT_FALSE(pubsub.push(7, invalidate));
+  EXPECT_TRUE(pubsub.push_resp3(7, invalidate));
+  EXPECT_EQ(read_exactly(peer, pushed.size()), pushed);
+
+  // Replies go out after what was pushed before them.
+  EXPECT_TRUE(pubsub.push_resp3(7, invalidate));
+  pubsub.send(7, SocketFd(fd), "+OK\r\n");
+  EXPECT_EQ(read_exactly(peer, pushed.size() + 5), pushed + "+OK\r\n");
+
+  // Pushing to a client that stopped reading never waits on it. Once its
+  // pushes pile up past the limit, its socket is shut down.
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  std::array<char, 1> byte{};
+  while (recv(fd, byte.data(), byte.size(), MSG_DONTWAIT) != 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    pubsub.push_resp3(7, invalidate);
+  }
+  EXPECT_LT(std::chrono::steady_clock::now(), deadline);
+
+  pubsub.detach(7);
+  EXPECT_FALSE(pubsub.push_resp3(7, invalidate));
+  close(fd);
+  close(peer);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../src/quicklist.hpp"
+
+namespace {
+std::vector<std::string> quicklist_elements(const Quicklist &list,
+                                            std::size_t first = 0,
+                                            std::size_t count = SIZE_MAX) {
+  std::vector<std::string> result{};
+  list.for_each(first, count, [&result](const Listpack::Element &element) {
+    result.push_back(Listpack::to_string(element));
+  });
+  return result;
+}
+} // namespace
+
+TEST(QuicklistTest, PushAndPopAtBothEnds) {
+  // Three elements per node.
+  Quicklist list(3);
+  EXPECT_FALSE(list.pop_front());
+  EXPECT_FALSE(list.pop_back());
+  for (int i = 0; i < 5; ++i) {
+    list.push_back(std::to_string(i));
+    list.push_front(std::to_string(-i - 1));
+  }
+  EXPECT_EQ(list.size(), 10);
+  EXPECT_EQ(list.nodes().size(), 4);
+  EXPECT_EQ(quicklist_elements(list),
+            (std::vector<std::string>{"-5", "-4", "-3", "-2", "-1", "0", "1",
+                                      "2", "3", "4"}));
+  EXPECT_EQ(quicklist_elements(list, 4, 3),
+            (std::vector<std::string>{"-1", "0", "1"}));
+  EXPECT_TRUE(quicklist_elements(list, 10, 3).empty());
+
+  EXPECT_EQ(list.pop_front(), "-5");
+  EXPECT_EQ(list.pop_back(), "4");
+  EXPECT_EQ(list.pop_back(), "3");
+  EXPECT_EQ(list.size(), 7);
+  // Emptied nodes are dropped.
+  EXPECT_EQ(list.nodes().size(), 3);
+  while (list.pop_front()) {
+  }
+  EXPECT_TRUE(list.empty());
+  EXPECT_TRUE(list.nodes().empty());
+}
+
+TEST(QuicklistTest, Trim) {
+  Quicklist list(4);
+  for (int i = 0; i < 20; ++i) {
+    list.push_back(std::to_string(i));
+  }
+  // Drops whole nodes on both sides and cuts the ones at the edges.
+  list.trim(5, 9);
+  EXPECT_EQ(list.size(), 9);
+  EXPECT_EQ(list.nodes().size(), 3);
+  EXPECT_EQ(quicklist_elements(list),
+            (std::vector<std::string>{"5", "6", "7", "8", "9", "10", "11",
+                                      "12", "13"}));
+  list.trim(0, 100);
+  EXPECT_EQ(list.size(), 9);
+  list.trim(9, 1);
+  EXPECT_TRUE(list.empty());
+}
+
+TEST(QuicklistTest, NodeSizeLimits) {
+  const std::string element(100, 'x');
+  for (const std::int64_t fill : {-1, -2, -5}) {
+    Quicklist list(fill);
+    for (int i = 0; i < 2000; ++i) {
+      list.push_back(element);
+    }
+    const auto max_bytes = 4096UL << static_cast<std::size_t>(-fill - 1);
+    for (const auto &node : list.nodes()) {
+      EXPECT_LE(node.bytes().size(), max_bytes);
+      // Nodes are filled up before starting new ones.
+      if (&node != &list.nodes().back()) {
+        EXPECT_GT(node.bytes().size() + 2 * element.size(), max_bytes);
+      }
+    }
+  }
+  // Elements bigger than a node get a node of their own.
+  Quicklist list(-1);
+  list.push_back("small");
+  list.push_back(std::string(10000, 'y'));
+  list.push_back("small");
+  EXPECT_EQ(list.nodes().size(), 3);
+}
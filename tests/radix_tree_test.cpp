@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/radix_tree.hpp"
+
+namespace {
+std::vector<std::pair<std::string, int>>
+radix_tree_entries(const RadixTree<int> &tree) {
+  std::vector<std::pair<std::string, int>> result{};
+  for (auto entry = tree.first(); entry;) {
+    result.emplace_back(entry->first, *entry->second);
+    entry = tree.seek_ge(entry->first + '\0');
+  }
+  return result;
+}
+} // namespace
+
+TEST(RadixTreeTest, InsertFindAndErase) {
+  RadixTree<int> tree{};
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.first(), std::nullopt);
+  EXPECT_EQ(tree.last(), std::nullopt);
+
+  EXPECT_TRUE(tree.insert("romane", 1));
+  EXPECT_TRUE(tree.insert("romanus", 2));
+  EXPECT_TRUE(tree.insert("romulus", 3));
+  EXPECT_TRUE(tree.insert("rom", 4));
+  EXPECT_TRUE(tree.insert("", 5));
+  EXPECT_FALSE(tree.insert("romane", 6));
+  EXPECT_EQ(tree.size(), 5);
+
+  EXPECT_EQ(*tree.find("romane"), 6);
+  EXPECT_EQ(*tree.find("rom"), 4);
+  EXPECT_EQ(*tree.find(""), 5);
+  EXPECT_EQ(tree.find("roman"), nullptr);
+  EXPECT_EQ(tree.find("romanes"), nullptr);
+  EXPECT_EQ(tree.find("x"), nullptr);
+  *tree.find("rom") = 7;
+
+  EXPECT_EQ(radix_tree_entries(tree),
+            (std::vector<std::pair<std::string, int>>{{"", 5},
+                                                      {"rom", 7},
+                                                      {"romane", 6},
+                                                      {"romanus", 2},
+                                                      {"romulus", 3}}));
+
+  EXPECT_FALSE(tree.erase("roman"));
+  EXPECT_TRUE(tree.erase("romane"));
+  EXPECT_TRUE(tree.erase("rom"));
+  EXPECT_FALSE(tree.erase("rom"));
+  EXPECT_EQ(tree.size(), 3);
+  EXPECT_EQ(*tree.find("romanus"), 2);
+  EXPECT_EQ(tree.find("romane"), nullptr);
+
+  const auto copy = tree;
+  EXPECT_TRUE(tree.erase("romanus"));
+  EXPECT_TRUE(tree.erase("romulus"));
+  EXPECT_TRUE(tree.erase(""));
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.first(), std::nullopt);
+  EXPECT_EQ(radix_tree_entries(copy),
+            (std::vector<std::pair<std::string, int>>{
+                {"", 5}, {"romanus", 2}, {"romulus", 3}}));
+}
+
+TEST(RadixTreeTest, SeekMatchesSortedMap) {
+  // Binary keys with long shared prefixes, like big-endian stream IDs.
+  std::mt19937 generator(39);
+  std::uniform_int_distribution<int> byte(0, 3);
+  const auto random_key = [&] {
+    std::string key(1 + static_cast<std::size_t>(byte(generator)), '\0');
+    std::ranges::generate(key, [&] {
+      return static_cast<char>(byte(generator) * 0x50);
+    });
+    return key;
+  };
+
+  RadixTree<int> tree{};
+  std::map<std::string, int> expected{};
+  for (int i = 0; i < 2000; ++i) {
+    const auto key = random_key();
+    if (byte(generator) == 0) {
+      EXPECT_EQ(tree.erase(key), expected.erase(key) == 1);
+    } else {
+      EXPECT_EQ(tree.insert(key, i), !expected.contains(key));
+      expected[key] = i;
+    }
+    ASSERT_EQ(tree.size(), expected.size());
+
+    const auto target = random_key();
+    const auto ge = expected.lower_bound(target);
+    const auto found_ge = tree.seek_ge(target);
+    ASSERT_EQ(found_ge.has_value(), ge != expected.end());
+    if (found_ge) {
+      EXPECT_EQ(found_ge->first, ge->first);
+      EXPECT_EQ(*found_ge->second, ge->second);
+    }
+    const auto le = expected.upper_bound(target);
+    const auto found_le = tree.seek_le(target);
+    ASSERT_EQ(found_le.has_value(), le != expected.begin());
+    if (found_le) {
+      EXPECT_EQ(found_le->first, std::prev(le)->first);
+      EXPECT_EQ(*found_le->second, std::prev(le)->second);
+    }
+  }
+  EXPECT_EQ(radix_tree_entries(tree),
+            (std::vector<std::pair<std::string, int>>(expected.begin(),
+                                                      expected.end())));
+  if (!expected.empty()) {
+    EXPECT_EQ(tree.last()->first, expected.rbegin()->first);
+  }
+}
@@ -1,7 +1,62 @@
 #include <gtest/gtest.h>
 
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/cache.hpp"
+#include "../src/config.hpp"
+#include "../src/hyperloglog.hpp"
+#include "../src/lazy_free.hpp"
 #include "../src/redis_core.hpp"
 
+namespace {
+// Parses the words the way a client would send them.
+Command make_command(std::initializer_list<std::string> words) {
+  Message::NestedVariantT elements{};
+  for (const auto &word : words) {
+    elements.emplace_back(word, DataType::BulkString);
+  }
+  const auto command =
+      parse_and_validate_command(Message{elements, DataType::Array});
+  EXPECT_TRUE(command.has_value());
+  return command.value_or(Command{});
+}
+
+Message integer(int value) {
+  return Message(std::to_string(value), DataType::Integer);
+}
+
+// An array (or another aggregate) of bulk strings.
+Message array(std::initializer_list<std::string> elements,
+              DataType data_type = DataType::Array) {
+  Message::NestedVariantT messages{};
+  for (const auto &element : elements) {
+    messages.emplace_back(element, DataType::BulkString);
+  }
+  return Message(messages, data_type);
+}
+
+// An array of members, each followed by its score.
+Message with_scores(std::initializer_list<std::string> elements) {
+  Message::NestedVariantT messages{};
+  for (const auto &element : elements) {
+    messages.emplace_back(element, messages.size() % 2 == 0
+                                       ? DataType::BulkString
+                                       : DataType::Double);
+  }
+  return Message(messages, DataType::Array);
+}
+
+const Message OK{"OK", DataType::SimpleString};
+const Message NIL{"", DataType::NullBulkString};
+} // namespace
+
 TEST(MessageTest, MessageToString) {
   EXPECT_EQ(message_to_string(Message("PING", DataType::SimpleString)),
             "+PING\r\n");
@@ -19,6 +74,37 @@ TEST(MessageTest, MessageToString) {
             "*2\r\n$5\r\nhello\r\n+goodbye\r\n");
   EXPECT_EQ(message_to_string(Message("", DataType::NullBulkString)),
             "$-1\r\n");
+  EXPECT_EQ(message_to_string(Message("ERR oops", DataType::SimpleError)),
+            "-ERR oops\r\n");
+  EXPECT_EQ(message_to_string(Message("42", DataType::Integer)), ":42\r\n");
+}
+
+TEST(MessageTest, Resp3ToString) {
+  // Each RESP3 type, and what RESP2 clients get instead.
+  const auto both = [](const Message &message) {
+    return std::pair{message_to_string(message, Protocol::Resp3),
+                     message_to_string(message, Protocol::Resp2)};
+  };
+  using Both = std::pair<std::string, std::string>;
+  EXPECT_EQ(both(array({"a", "1"}, DataType::Map)),
+            Both("%1\r\n$1\r\na\r\n$1\r\n1\r\n",
+                 "*2\r\n$1\r\na\r\n$1\r\n1\r\n"));
+  EXPECT_EQ(both(array({"a"}, DataType::Set)),
+            Both("~1\r\n$1\r\na\r\n", "*1\r\n$1\r\na\r\n"));
+  EXPECT_EQ(both(array({"a"}, DataType::Push)),
+            Both(">1\r\n$1\r\na\r\n", "*1\r\n$1\r\na\r\n"));
+  EXPECT_EQ(both(Message("1.5", DataType::Double)),
+            Both(",1.5\r\n", "$3\r\n1.5\r\n"));
+  EXPECT_EQ(both(Message("1", DataType::Boolean)), Both("#t\r\n", ":1\r\n"));
+  EXPECT_EQ(both(Message("0", DataType::Boolean)), Both("#f\r\n", ":0\r\n"));
+  EXPECT_EQ(both(NIL), Both("_\r\n", "$-1\r\n"));
+  EXPECT_EQ(both(Message("", DataType::Null)), Both("_\r\n", "$-1\r\n"));
+  EXPECT_EQ(both(Message("", DataType::NullArray)), Both("_\r\n", "*-1\r\n"));
+  // Elements are serialized for the same protocol.
+  EXPECT_EQ(message_to_string(
+                Message(Message::NestedVariantT{NIL}, DataType::Array),
+                Protocol::Resp3),
+            "*1\r\n_\r\n");
 }
 
 TEST(MessageTest, MessageFromString) {
@@ -51,4 +137,711 @@ TEST(MessageTest, RoundTrip) {
   EXPECT_EQ(msg2, message_from_string(message_to_string(msg2)));
   EXPECT_EQ(msg3, message_from_string(message_to_string(msg3)));
   EXPECT_EQ(empty, message_from_string(message_to_string(empty)));
-}
\ No newline at end of file
+}
+
+TEST(MessageTest, ParseCommandArray) {
+  const auto set = make_command({"set", "key", "value"});
+  const auto psync = make_command({"psync", "?", "-1"});
+  const auto stream = message_to_string(command_to_message(set)) +
+                      message_to_string(command_to_message(psync));
+  std::size_t pos = 0;
+  EXPECT_EQ(parse_command_array(stream, pos), command_to_message(set));
+  const auto second = pos;
+  EXPECT_EQ(parse_command_array(stream, pos), command_to_message(psync));
+  EXPECT_EQ(pos, stream.size());
+  EXPECT_FALSE(parse_command_array(stream, pos).has_value());
+
+  // Until all of a command has arrived, pos stays put.
+  for (auto end = second; end < stream.size(); ++end) {
+    pos = second;
+    EXPECT_FALSE(
+        parse_command_array(std::string_view(stream).substr(0, end), pos)
+            .has_value());
+    EXPECT_EQ(pos, second);
+  }
+  EXPECT_FALSE(parse_and_validate_command(
+                   command_to_message(Command{CommandVerb::PSync, {"?"}}))
+                   .has_value());
+}
+
+TEST(CommandTest, CommandsTheServerRunsAreRejectedHere) {
+  Cache cache{};
+  const auto reply =
+      generate_response_message(make_command({"info"}), Config{}, cache);
+  EXPECT_EQ(reply, Message("ERR unknown command 'info'", DataType::SimpleError));
+}
+
+TEST(CommandTest, DatabaseCommands) {
+  std::vector<Cache> databases(4);
+  ClientState client{};
+  databases[0].set("zero", "0");
+  databases[1].set("one", "1");
+
+  // Key commands are left alone.
+  EXPECT_FALSE(handle_database_command(make_command({"get", "zero"}),
+                                       databases, client));
+
+  EXPECT_EQ(handle_database_command(make_command({"SELECT", "1"}), databases,
+                                    client),
+            OK);
+  EXPECT_EQ(client.db_index, 1);
+  const auto select_error = [&](const std::string &index) {
+    const auto reply = handle_database_command(
+        make_command({"select", index}), databases, client);
+    return reply && reply->get_data_type() == DataType::SimpleError;
+  };
+  EXPECT_TRUE(select_error("4"));
+  EXPECT_TRUE(select_error("-1"));
+  EXPECT_TRUE(select_error("one"));
+  EXPECT_EQ(client.db_index, 1);
+
+  // The selected database now holds what used to be in database 0.
+  EXPECT_EQ(handle_database_command(make_command({"swapdb", "0", "1"}),
+                                    databases, client),
+            OK);
+  EXPECT_EQ(databases[client.db_index].get("zero"), "0");
+  EXPECT_EQ(databases[0].get("one"), "1");
+
+  EXPECT_EQ(handle_database_command(make_command({"flushdb"}), databases,
+                                    client),
+            OK);
+  EXPECT_EQ(databases[1].size(), 0);
+  EXPECT_EQ(databases[0].size(), 1);
+
+  LazyFree lazy_free{};
+  databases[3].set("three", "3");
+  EXPECT_EQ(handle_database_command(make_command({"flushall", "ASYNC"}),
+                                    databases, client, &lazy_free),
+            OK);
+  lazy_free.wait_until_idle();
+  for (const auto &cache : databases) {
+    EXPECT_EQ(cache.size(), 0);
+  }
+  const auto bad_flush = handle_database_command(
+      make_command({"flushall", "later"}), databases, client);
+  ASSERT_TRUE(bad_flush.has_value());
+  EXPECT_EQ(bad_flush->get_data_type(), DataType::SimpleError);
+}
+
+TEST(CommandTest, DelAndUnlink) {
+  LazyFree lazy_free{};
+  Cache cache{};
+  cache.set_lazy_free(&lazy_free);
+  std::unordered_map<std::string, std::string> fields{};
+  for (std::size_t i = 0; i <= LazyFree::LAZYFREE_THRESHOLD; ++i) {
+    fields.emplace("field" + std::to_string(i), "value");
+  }
+  cache.insert({{"big", {HashValue{std::move(fields)}, std::nullopt}}});
+  cache.set("small", "1");
+  cache.set("other", "2");
+
+  const auto removed = [&cache](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), Config{}, cache);
+  };
+  // Missing keys aren't counted.
+  EXPECT_EQ(removed({"unlink", "big", "small", "missing"}),
+            Message("2", DataType::Integer));
+  EXPECT_EQ(removed({"del", "other", "other"}),
+            Message("1", DataType::Integer));
+  EXPECT_EQ(cache.size(), 0);
+
+  // Only the big hash was worth freeing in the background.
+  lazy_free.wait_until_idle();
+  EXPECT_EQ(lazy_free.pending(), 0);
+  EXPECT_EQ(lazy_free.freed(), 1);
+}
+
+TEST(CommandTest, ListCommands) {
+  Cache cache{};
+  const auto run = [&cache](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), Config{}, cache);
+  };
+
+  EXPECT_EQ(run({"rpush", "list", "c", "d", "e"}), integer(3));
+  EXPECT_EQ(run({"lpush", "list", "b", "a"}), integer(5));
+  EXPECT_EQ(run({"llen", "list"}), integer(5));
+  EXPECT_EQ(run({"lrange", "list", "0", "-1"}),
+            array({"a", "b", "c", "d", "e"}));
+  EXPECT_EQ(run({"lrange", "list", "-2", "100"}), array({"d", "e"}));
+  EXPECT_EQ(run({"lrange", "list", "3", "1"}), array({}));
+
+  EXPECT_EQ(run({"lpop", "list"}), Message("a", DataType::BulkString));
+  EXPECT_EQ(run({"rpop", "list", "2"}), array({"e", "d"}));
+  EXPECT_EQ(run({"ltrim", "list", "1", "-1"}), OK);
+  EXPECT_EQ(run({"lrange", "list", "0", "-1"}), array({"c"}));
+  // Popping the last element removes the key.
+  EXPECT_EQ(run({"rpop", "list", "5"}), array({"c"}));
+  EXPECT_FALSE(cache.type("list").has_value());
+  EXPECT_EQ(run({"lpop", "list"}), NIL);
+  // With a count, a missing list is a nil array.
+  EXPECT_EQ(run({"lpop", "list", "2"}), Message("", DataType::NullArray));
+  EXPECT_EQ(run({"rpop", "list", "1"}), Message("", DataType::NullArray));
+  EXPECT_EQ(run({"llen", "list"}), integer(0));
+
+  cache.set("string", "value");
+  for (const auto &command :
+       {run({"lpush", "string", "a"}), run({"llen", "string"}),
+        run({"lrange", "string", "0", "1"}), run({"ltrim", "list", "x", "1"}),
+        run({"lpop", "list", "-1"})}) {
+    ASSERT_TRUE(command.has_value());
+    EXPECT_EQ(command->get_data_type(), DataType::SimpleError);
+  }
+  EXPECT_EQ(cache.get("string"), "value");
+}
+
+TEST(CommandTest, HashCommands) {
+  Config config{};
+  config.hash_max_listpack_entries = 4;
+  config.hash_max_listpack_value = 16;
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  const auto is_listpack = [&cache](const std::string &key) {
+    return cache.read(key, [](const Value *value) {
+      return std::holds_alternative<Listpack>(std::get<HashValue>(*value));
+    });
+  };
+
+  EXPECT_EQ(run({"hset", "user", "name", "ada", "age", "36"}), integer(2));
+  EXPECT_EQ(run({"hset", "user", "name", "grace"}), integer(0));
+  EXPECT_EQ(run({"hset", "user", "name", "ada", "age"}),
+            Message("ERR wrong number of arguments for 'hset' command",
+                    DataType::SimpleError));
+  EXPECT_EQ(run({"hget", "user", "name"}),
+            Message("grace", DataType::BulkString));
+  EXPECT_EQ(run({"hget", "user", "missing"}), NIL);
+  EXPECT_EQ(run({"hincrby", "user", "age", "-6"}), integer(30));
+  EXPECT_EQ(run({"hincrby", "user", "visits", "1"}), integer(1));
+  EXPECT_EQ(run({"hgetall", "user"}),
+            array({"name", "grace", "age", "30", "visits", "1"},
+                  DataType::Map));
+  Message::NestedVariantT values{Message("grace", DataType::BulkString), NIL};
+  EXPECT_EQ(run({"hmget", "user", "name", "missing"}),
+            Message(values, DataType::Array));
+  EXPECT_TRUE(is_listpack("user"));
+  EXPECT_EQ(run({"hscan", "user", "0", "match", "*a*", "novalues"}),
+            Message(Message::NestedVariantT{Message("0", DataType::BulkString),
+                                            array({"name", "age"})},
+                    DataType::Array));
+
+  // Long values and too many fields both turn it into a table.
+  EXPECT_EQ(run({"hset", "user", "bio", std::string(17, 'x')}), integer(1));
+  EXPECT_FALSE(is_listpack("user"));
+  EXPECT_EQ(run({"hset", "other", "a", "1", "b", "2", "c", "3", "d", "4"}),
+            integer(4));
+  EXPECT_TRUE(is_listpack("other"));
+  EXPECT_EQ(run({"hset", "other", "e", "5"}), integer(1));
+  EXPECT_FALSE(is_listpack("other"));
+  EXPECT_EQ(run({"hget", "other", "c"}), Message("3", DataType::BulkString));
+
+  // Scanning a table a bucket at a time still visits every field once.
+  std::set<std::string> fields{};
+  std::string cursor = "0";
+  do {
+    const auto reply = run({"hscan", "other", cursor, "count", "1"});
+    ASSERT_TRUE(reply.has_value());
+    const auto &parts = std::get<Message::NestedVariantT>(reply->get_data());
+    cursor = std::get<Message::StringVariantT>(parts[0].get_data());
+    const auto &elements =
+        std::get<Message::NestedVariantT>(parts[1].get_data());
+    for (std::size_t i = 0; i < elements.size(); i += 2) {
+      const auto &field =
+          std::get<Message::StringVariantT>(elements[i].get_data());
+      EXPECT_TRUE(fields.insert(field).second);
+    }
+  } while (cursor != "0");
+  EXPECT_EQ(fields, (std::set<std::string>{"a", "b", "c", "d", "e"}));
+
+  EXPECT_EQ(run({"hdel", "other", "a", "b", "missing"}), integer(2));
+  EXPECT_EQ(run({"hdel", "other", "c", "d", "e"}), integer(3));
+  EXPECT_FALSE(cache.type("other").has_value());
+
+  EXPECT_EQ(run({"hincrby", "user", "name", "1"})->get_data_type(),
+            DataType::SimpleError);
+  EXPECT_EQ(run({"hincrby", "user", "age", "9223372036854775807"})
+                ->get_data_type(),
+            DataType::SimpleError);
+  cache.set("string", "value");
+  EXPECT_EQ(run({"hget", "string", "a"})->get_data_type(),
+            DataType::SimpleError);
+}
+
+TEST(CommandTest, SortedSetCommands) {
+  // Once with small sorted sets kept as listpacks, and once as skiplists.
+  for (const std::size_t max_entries : {128, 0}) {
+    Config config{};
+    config.zset_max_listpack_entries = max_entries;
+    Cache cache{};
+    const auto run = [&](std::initializer_list<std::string> words) {
+      return handle_command(make_command(words), config, cache);
+    };
+
+    EXPECT_EQ(run({"zadd", "board", "10", "ada", "20", "bob", "15", "cy"}),
+              integer(3));
+    EXPECT_EQ(run({"zadd", "board", "ch", "12", "ada", "15", "cy", "5", "dee"}),
+              integer(2));
+    EXPECT_EQ(run({"zcard", "board"}), integer(4));
+    EXPECT_EQ(run({"zincrby", "board", "2.5", "dee"}),
+              Message("7.5", DataType::Double));
+    EXPECT_EQ(run({"zrange", "board", "0", "-1"}),
+              array({"dee", "ada", "cy", "bob"}));
+    EXPECT_EQ(run({"zrange", "board", "0", "1", "rev", "withscores"}),
+              with_scores({"bob", "20", "cy", "15"}));
+    EXPECT_EQ(run({"zrangebyscore", "board", "(7.5", "+inf", "withscores",
+                   "limit", "1", "5"}),
+              with_scores({"cy", "15", "bob", "20"}));
+    EXPECT_EQ(run({"zrange", "board", "15", "-inf", "byscore", "rev"}),
+              array({"cy", "ada", "dee"}));
+    EXPECT_EQ(run({"zrank", "board", "cy"}), integer(2));
+    EXPECT_EQ(run({"zrank", "board", "ada", "withscore"}),
+              Message(Message::NestedVariantT{
+                          integer(1), Message("12", DataType::Double)},
+                      DataType::Array));
+    EXPECT_EQ(run({"zrank", "board", "missing"}), NIL);
+
+    // NX only adds, XX only updates, GT only raises scores.
+    EXPECT_EQ(run({"zadd", "board", "nx", "1", "ada", "1", "eve"}), integer(1));
+    EXPECT_EQ(run({"zadd", "board", "xx", "ch", "3", "eve", "3", "fay"}),
+              integer(1));
+    EXPECT_EQ(run({"zadd", "board", "gt", "incr", "-1", "bob"}), NIL);
+    EXPECT_EQ(run({"zrange", "board", "0", "1", "withscores"}),
+              with_scores({"eve", "3", "dee", "7.5"}));
+
+    EXPECT_EQ(run({"zrem", "board", "eve", "missing", "dee"}), integer(2));
+    EXPECT_EQ(run({"zrange", "board", "0", "-1"}), array({"ada", "cy", "bob"}));
+    EXPECT_EQ(run({"zrem", "board", "ada", "cy", "bob"}), integer(3));
+    EXPECT_FALSE(cache.type("board").has_value());
+
+    for (const auto &reply :
+         {run({"zadd", "board", "x", "ada"}), run({"zadd", "board", "nx", "1"}),
+          run({"zadd", "board", "nx", "xx", "1", "a"}),
+          run({"zincrby", "board", "nan", "a"}),
+          run({"zrangebyscore", "board", "a", "1"}),
+          run({"zrange", "board", "0", "1", "limit", "0", "1"})}) {
+      ASSERT_TRUE(reply.has_value());
+      EXPECT_EQ(reply->get_data_type(), DataType::SimpleError);
+    }
+  }
+}
+
+TEST(CommandTest, SortedSetEncoding) {
+  Config config{};
+  config.zset_max_listpack_entries = 3;
+  config.zset_max_listpack_value = 8;
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  const auto is_listpack = [&cache](const std::string &key) {
+    return cache.read(key, [](const Value *value) {
+      return std::holds_alternative<Listpack>(
+          std::get<SortedSetValue>(*value));
+    });
+  };
+
+  EXPECT_EQ(run({"zadd", "small", "3", "c", "1", "a", "2", "b"}), integer(3));
+  EXPECT_TRUE(is_listpack("small"));
+  EXPECT_EQ(run({"zadd", "small", "4", "d"}), integer(1));
+  EXPECT_FALSE(is_listpack("small"));
+  EXPECT_EQ(run({"zadd", "long", "1", std::string(9, 'x')}), integer(1));
+  EXPECT_FALSE(is_listpack("long"));
+  EXPECT_EQ(run({"zrange", "small", "0", "-1"}), array({"a", "b", "c", "d"}));
+  EXPECT_EQ(run({"zrank", "small", "d"}), integer(3));
+}
+
+TEST(CommandTest, SetCommands) {
+  Config config{};
+  config.set_max_intset_entries = 4;
+  config.set_max_listpack_entries = 4;
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  // The members of an array reply, in sorted order.
+  const auto sorted = [](const std::optional<Message> &reply) {
+    std::set<std::string> members{};
+    for (const auto &element :
+         std::get<Message::NestedVariantT>(reply->get_data())) {
+      members.insert(std::get<Message::StringVariantT>(element.get_data()));
+    }
+    return members;
+  };
+  const auto encoding = [&cache](const std::string &key) {
+    return cache.read(key, [](const Value *value) {
+      return std::get<SetValue>(*value).index();
+    });
+  };
+
+  EXPECT_EQ(run({"sadd", "ints", "3", "1", "2", "3"}), integer(3));
+  EXPECT_EQ(encoding("ints"), 0);
+  EXPECT_EQ(run({"sadd", "mixed", "1", "b", "3"}), integer(3));
+  EXPECT_EQ(encoding("mixed"), 1);
+  EXPECT_EQ(run({"sadd", "many", "1", "2", "3", "4", "5"}), integer(5));
+  EXPECT_EQ(encoding("many"), 2);
+  // Adding a string to an intset keeps the integers.
+  EXPECT_EQ(run({"sadd", "ints", "x"}), integer(1));
+  EXPECT_EQ(encoding("ints"), 1);
+  EXPECT_EQ(sorted(run({"smembers", "ints"})),
+            (std::set<std::string>{"1", "2", "3", "x"}));
+
+  EXPECT_EQ(run({"scard", "many"}), integer(5));
+  EXPECT_EQ(run({"sismember", "many", "4"}), integer(1));
+  EXPECT_EQ(run({"sismember", "many", "6"}), integer(0));
+  EXPECT_EQ(run({"sismember", "missing", "6"}), integer(0));
+
+  EXPECT_EQ(sorted(run({"sinter", "many", "ints", "mixed"})),
+            (std::set<std::string>{"1", "3"}));
+  EXPECT_EQ(sorted(run({"sinter", "many", "missing"})),
+            std::set<std::string>{});
+  EXPECT_EQ(sorted(run({"sunion", "ints", "mixed", "missing"})),
+            (std::set<std::string>{"1", "2", "3", "b", "x"}));
+  EXPECT_EQ(sorted(run({"sdiff", "many", "ints", "missing"})),
+            (std::set<std::string>{"4", "5"}));
+  EXPECT_EQ(run({"sintercard", "2", "many", "ints"}), integer(3));
+  EXPECT_EQ(run({"sintercard", "2", "many", "ints", "limit", "2"}),
+            integer(2));
+
+  // Intersections of intsets only.
+  EXPECT_EQ(run({"sadd", "odd", "-1", "1", "3"}), integer(3));
+  EXPECT_EQ(run({"sadd", "wide", "3", "100000", "1"}), integer(3));
+  EXPECT_EQ(sorted(run({"sinter", "odd", "wide"})),
+            (std::set<std::string>{"1", "3"}));
+  EXPECT_EQ(run({"sintercard", "3", "odd", "wide", "many"}), integer(2));
+
+  EXPECT_EQ(run({"srem", "odd", "1", "missing", "-1"}), integer(2));
+  EXPECT_EQ(run({"srem", "odd", "3"}), integer(1));
+  EXPECT_FALSE(cache.type("odd").has_value());
+
+  cache.set("string", "value");
+  for (const auto &reply :
+       {run({"sadd", "string", "a"}), run({"sinter", "many", "string"}),
+        run({"sintercard", "0", "many"}), run({"sintercard", "3", "many"}),
+        run({"sintercard", "1", "many", "limit", "-1"})}) {
+    ASSERT_TRUE(reply.has_value());
+    EXPECT_EQ(reply->get_data_type(), DataType::SimpleError);
+  }
+}
+
+TEST(CommandTest, BitmapCommands) {
+  Config config{};
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  const auto stored = [&cache](const std::string &key) {
+    return cache.read(key, [](const Value *value) {
+      return value ? std::optional(std::get<std::string>(*value))
+                   : std::nullopt;
+    });
+  };
+
+  // Bit 0 is the most significant bit of the first byte.
+  EXPECT_EQ(run({"setbit", "bits", "1", "1"}), integer(0));
+  EXPECT_EQ(run({"setbit", "bits", "7", "1"}), integer(0));
+  EXPECT_EQ(run({"setbit", "bits", "20", "1"}), integer(0));
+  EXPECT_EQ(run({"setbit", "bits", "20", "1"}), integer(1));
+  EXPECT_EQ(stored("bits"), std::string("A\0\x08", 3));
+  EXPECT_EQ(run({"getbit", "bits", "1"}), integer(1));
+  EXPECT_EQ(run({"getbit", "bits", "2"}), integer(0));
+  EXPECT_EQ(run({"getbit", "bits", "1000"}), integer(0));
+  EXPECT_EQ(run({"getbit", "missing", "0"}), integer(0));
+
+  EXPECT_EQ(run({"bitcount", "bits"}), integer(3));
+  EXPECT_EQ(run({"bitcount", "bits", "0", "0"}), integer(2));
+  EXPECT_EQ(run({"bitcount", "bits", "1", "-1"}), integer(1));
+  EXPECT_EQ(run({"bitcount", "bits", "5", "1"}), integer(0));
+  EXPECT_EQ(run({"bitcount", "bits", "2", "7", "bit"}), integer(1));
+  EXPECT_EQ(run({"bitcount", "bits", "-5", "-1", "BIT"}), integer(1));
+  EXPECT_EQ(run({"bitcount", "missing"}), integer(0));
+
+  EXPECT_EQ(run({"bitpos", "bits", "1"}), integer(1));
+  EXPECT_EQ(run({"bitpos", "bits", "0"}), integer(0));
+  EXPECT_EQ(run({"bitpos", "bits", "1", "1"}), integer(20));
+  EXPECT_EQ(run({"bitpos", "bits", "1", "2", "7", "bit"}), integer(7));
+  EXPECT_EQ(run({"bitpos", "missing", "1"}), integer(-1));
+  EXPECT_EQ(run({"bitpos", "missing", "0"}), integer(0));
+  // Without an end, a string of ones counts as padded with clear bits.
+  cache.set("ones", "\xff");
+  EXPECT_EQ(run({"bitpos", "ones", "0"}), integer(8));
+  EXPECT_EQ(run({"bitpos", "ones", "0", "0", "0"}), integer(-1));
+
+  // Long enough to go through the word and vector paths.
+  EXPECT_EQ(run({"setbit", "big", "100000", "1"}), integer(0));
+  EXPECT_EQ(run({"setbit", "big", "99999", "1"}), integer(0));
+  EXPECT_EQ(run({"bitcount", "big"}), integer(2));
+  EXPECT_EQ(run({"bitcount", "big", "0", "12499"}), integer(1));
+  EXPECT_EQ(run({"bitpos", "big", "1"}), integer(99999));
+  EXPECT_EQ(run({"bitpos", "big", "1", "12500"}), integer(100000));
+
+  cache.set("a", "\xff\x0f");
+  cache.set("b", "\x0f");
+  EXPECT_EQ(run({"bitop", "and", "dest", "a", "b"}), integer(2));
+  EXPECT_EQ(stored("dest"), std::string("\x0f\0", 2));
+  EXPECT_EQ(run({"bitop", "or", "dest", "a", "b", "missing"}), integer(2));
+  EXPECT_EQ(stored("dest"), "\xff\x0f");
+  EXPECT_EQ(run({"bitop", "XOR", "dest", "a", "b"}), integer(2));
+  EXPECT_EQ(stored("dest"), "\xf0\x0f");
+  EXPECT_EQ(run({"bitop", "not", "dest", "b"}), integer(1));
+  EXPECT_EQ(stored("dest"), "\xf0");
+  EXPECT_EQ(run({"bitop", "and", "dest", "missing"}), integer(0));
+  EXPECT_FALSE(stored("dest").has_value());
+
+  run({"sadd", "set", "a"});
+  for (const auto &reply :
+       {run({"setbit", "bits", "-1", "1"}), run({"setbit", "bits", "0", "2"}),
+        run({"getbit", "bits", "x"}), run({"bitcount", "bits", "0"}),
+        run({"bitcount", "bits", "0", "1", "nibble"}),
+        run({"bitpos", "bits", "2"}), run({"bitop", "not", "dest", "a", "b"}),
+        run({"bitop", "nand", "dest", "a"}), run({"setbit", "set", "0", "1"}),
+        run({"bitop", "and", "dest", "a", "set"})}) {
+    ASSERT_TRUE(reply.has_value());
+    EXPECT_EQ(reply->get_data_type(), DataType::SimpleError);
+  }
+  // A BITOP that fails with WRONGTYPE leaves its destination alone.
+  cache.set("dest", "kept");
+  const auto wrong_type = run({"bitop", "or", "dest", "a", "set"});
+  ASSERT_TRUE(wrong_type.has_value());
+  EXPECT_EQ(wrong_type->get_data_type(), DataType::SimpleError);
+  EXPECT_EQ(stored("dest"), "kept");
+}
+
+TEST(CommandTest, HyperLogLogCommands) {
+  Config config{};
+  config.hll_sparse_max_bytes = 60;
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  const auto is_sparse = [&cache](const std::string &key) {
+    return cache.read(key, [](const Value *value) {
+      return hll_is_sparse(std::get<std::string>(*value));
+    });
+  };
+
+  EXPECT_EQ(run({"pfadd", "empty"}), integer(1));
+  EXPECT_EQ(run({"pfadd", "empty"}), integer(0));
+  EXPECT_EQ(run({"pfcount", "empty"}), integer(0));
+  EXPECT_EQ(run({"pfadd", "hll", "a", "b", "c"}), integer(1));
+  EXPECT_EQ(run({"pfadd", "hll", "a", "b"}), integer(0));
+  EXPECT_EQ(run({"pfcount", "hll"}), integer(3));
+  // The second time it is cached.
+  EXPECT_EQ(run({"pfcount", "hll"}), integer(3));
+  EXPECT_EQ(run({"pfcount", "missing"}), integer(0));
+  EXPECT_TRUE(is_sparse("hll"));
+
+  EXPECT_EQ(run({"pfadd", "other", "c", "d", "e", "f", "g", "h", "i", "j",
+                 "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v",
+                 "w", "x", "y", "z"}),
+            integer(1));
+  EXPECT_FALSE(is_sparse("other"));
+  // Two of the letters land in the same register, so it is one short.
+  EXPECT_EQ(run({"pfcount", "other"}), integer(23));
+  EXPECT_EQ(run({"pfcount", "hll", "other", "missing"}), integer(25));
+
+  EXPECT_EQ(run({"pfmerge", "merged", "hll", "other", "missing"}),
+            (Message{"OK", DataType::SimpleString}));
+  EXPECT_EQ(run({"pfcount", "merged"}), integer(25));
+  // The destination's own registers are merged in.
+  EXPECT_EQ(run({"pfadd", "dest", "zz"}), integer(1));
+  EXPECT_EQ(run({"pfmerge", "dest", "hll"}),
+            (Message{"OK", DataType::SimpleString}));
+  EXPECT_EQ(run({"pfcount", "dest"}), integer(4));
+  EXPECT_EQ(run({"pfmerge", "new"}), (Message{"OK", DataType::SimpleString}));
+  EXPECT_EQ(run({"pfcount", "new"}), integer(0));
+
+  cache.set("string", "not a hyperloglog");
+  run({"sadd", "set", "a"});
+  for (const auto &reply :
+       {run({"pfadd", "string", "a"}), run({"pfcount", "string"}),
+        run({"pfcount", "hll", "set"}), run({"pfmerge", "dest", "string"}),
+        run({"pfadd", "set", "a"})}) {
+    ASSERT_TRUE(reply.has_value());
+    EXPECT_EQ(reply->get_data_type(), DataType::SimpleError);
+  }
+  // A failed merge leaves the destination alone.
+  EXPECT_EQ(run({"pfcount", "dest"}), integer(4));
+}
+
+TEST(CommandTest, StreamCommands) {
+  Config config{};
+  config.stream_node_max_entries = 2;
+  Cache cache{};
+  const auto run = [&](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), config, cache);
+  };
+  const auto bulk = [](const std::string &str) {
+    return Message{str, DataType::BulkString};
+  };
+  // An array of entries, each an ID and its fields and values.
+  const auto entries =
+      [](std::initializer_list<
+          std::pair<std::string, std::initializer_list<std::string>>>
+             list) {
+        Message::NestedVariantT messages{};
+        for (const auto &[id, fields] : list) {
+          messages.emplace_back(
+              Message::NestedVariantT{Message{id, DataType::BulkString},
+                                      array(fields)},
+              DataType::Array);
+        }
+        return Message(messages, DataType::Array);
+      };
+  const auto is_error = [](const std::optional<Message> &reply) {
+    return reply.has_value() && reply->get_data_type() == DataType::SimpleError;
+  };
+
+  EXPECT_EQ(run({"xadd", "s", "1-1", "temp", "20"}), bulk("1-1"));
+  EXPECT_EQ(run({"xadd", "s", "1-*", "temp", "21"}), bulk("1-2"));
+  EXPECT_EQ(run({"xadd", "s", "2-*", "temp", "22", "unit", "c"}), bulk("2-0"));
+  EXPECT_EQ(run({"xadd", "s", "3", "temp", "23"}), bulk("3-0"));
+  EXPECT_EQ(run({"xlen", "s"}), integer(4));
+  EXPECT_EQ(run({"xlen", "missing"}), integer(0));
+  EXPECT_EQ(run({"xadd", "fresh", "0-*", "a", "b"}), bulk("0-1"));
+  EXPECT_EQ(run({"xadd", "missing", "NOMKSTREAM", "*", "a", "b"}), NIL);
+  EXPECT_EQ(run({"xlen", "missing"}), integer(0));
+
+  EXPECT_EQ(run({"xadd", "s", "3-0", "a", "b"}),
+            (Message{"ERR The ID specified in XADD is equal or smaller than "
+                     "the target stream top item",
+                     DataType::SimpleError}));
+  EXPECT_EQ(run({"xadd", "other", "0-0", "a", "b"}),
+            (Message{"ERR The ID specified in XADD must be greater than 0-0",
+                     DataType::SimpleError}));
+  EXPECT_EQ(run({"xlen", "other"}), integer(0));
+  EXPECT_TRUE(is_error(run({"xadd", "s", "1-x", "a", "b"})));
+  EXPECT_TRUE(is_error(run({"xadd", "s", "*", "a", "b", "c"})));
+
+  EXPECT_EQ(run({"xrange", "s", "-", "+"}),
+            entries({{"1-1", {"temp", "20"}},
+                     {"1-2", {"temp", "21"}},
+                     {"2-0", {"temp", "22", "unit", "c"}},
+                     {"3-0", {"temp", "23"}}}));
+  EXPECT_EQ(run({"xrange", "s", "1", "1"}),
+            entries({{"1-1", {"temp", "20"}}, {"1-2", {"temp", "21"}}}));
+  EXPECT_EQ(run({"xrange", "s", "(1-1", "+", "COUNT", "2"}),
+            entries({{"1-2", {"temp", "21"}},
+                     {"2-0", {"temp", "22", "unit", "c"}}}));
+  EXPECT_EQ(run({"xrevrange", "s", "+", "-", "COUNT", "1"}),
+            entries({{"3-0", {"temp", "23"}}}));
+  EXPECT_EQ(run({"xrevrange", "s", "(3-0", "1-2"}),
+            entries({{"2-0", {"temp", "22", "unit", "c"}},
+                     {"1-2", {"temp", "21"}}}));
+  EXPECT_EQ(run({"xrange", "missing", "-", "+"}), entries({}));
+  EXPECT_TRUE(is_error(run({"xrange", "s", "x", "+"})));
+
+  EXPECT_EQ(run({"xread", "STREAMS", "s", "fresh", "2-0", "0"}),
+            (Message{Message::NestedVariantT{
+                         Message{Message::NestedVariantT{
+                                     bulk("s"),
+                                     entries({{"3-0", {"temp", "23"}}})},
+                                 DataType::Array},
+                         Message{Message::NestedVariantT{
+                                     bulk("fresh"),
+                                     entries({{"0-1", {"a", "b"}}})},
+                                 DataType::Array}},
+                     DataType::Array}));
+  EXPECT_EQ(run({"xread", "COUNT", "1", "STREAMS", "s", "0"}),
+            (Message{Message::NestedVariantT{Message{
+                         Message::NestedVariantT{
+                             bulk("s"), entries({{"1-1", {"temp", "20"}}})},
+                         DataType::Array}},
+                     DataType::Array}));
+  EXPECT_EQ(run({"xread", "STREAMS", "s", "missing", "$", "0"}), NIL);
+  EXPECT_TRUE(is_error(run({"xread", "STREAMS", "s", "fresh", "0"})));
+
+  EXPECT_EQ(run({"xtrim", "s", "MAXLEN", "3"}), integer(1));
+  EXPECT_EQ(run({"xrange", "s", "-", "1-2"}),
+            entries({{"1-2", {"temp", "21"}}}));
+  // Approximate trimming only drops whole blocks (of two entries here).
+  EXPECT_EQ(run({"xtrim", "s", "MAXLEN", "~", "1"}), integer(1));
+  EXPECT_EQ(run({"xtrim", "s", "MINID", "3"}), integer(1));
+  EXPECT_EQ(run({"xrange", "s", "-", "+"}), entries({{"3-0", {"temp", "23"}}}));
+  EXPECT_EQ(run({"xadd", "s", "MAXLEN", "2", "*", "a", "b"}).has_value(),
+            true);
+  EXPECT_EQ(run({"xadd", "s", "MAXLEN", "=", "2", "*", "a", "b"}).has_value(),
+            true);
+  EXPECT_EQ(run({"xlen", "s"}), integer(2));
+  EXPECT_TRUE(is_error(run({"xtrim", "s", "MAXLEN", "-1"})));
+  EXPECT_TRUE(is_error(run({"xtrim", "s", "SIZE", "1"})));
+
+  cache.set("string", "value");
+  EXPECT_TRUE(is_error(run({"xadd", "string", "*", "a", "b"})));
+  EXPECT_TRUE(is_error(run({"xlen", "string"})));
+  EXPECT_TRUE(is_error(run({"xread", "STREAMS", "string", "0"})));
+}
+
+TEST(CommandTest, BlockingCommands) {
+  Cache cache{};
+  const auto run = [&cache](std::initializer_list<std::string> words) {
+    return handle_command(make_command(words), Config{}, cache);
+  };
+  const auto is_error = [](const std::optional<Message> &reply) {
+    return reply.has_value() && reply->get_data_type() == DataType::SimpleError;
+  };
+
+  // Blocking is up to the server, so these reply with nil right away.
+  EXPECT_EQ(run({"blpop", "a", "b", "0"}), NIL);
+  EXPECT_EQ(run({"rpush", "b", "x", "y"}), integer(2));
+  EXPECT_EQ(run({"blpop", "a", "b", "0"}), array({"b", "x"}));
+  EXPECT_EQ(run({"brpop", "a", "b", "0.5"}), array({"b", "y"}));
+  EXPECT_FALSE(cache.type("b").has_value());
+  EXPECT_TRUE(is_error(run({"blpop", "a", "x"})));
+  EXPECT_TRUE(is_error(run({"blpop", "a", "-1"})));
+  cache.set("string", "value");
+  EXPECT_TRUE(is_error(run({"blpop", "string", "a", "0"})));
+
+  const auto spec = get_blocking_spec(make_command({"brpop", "a", "b", "1.5"}));
+  ASSERT_TRUE(spec.has_value());
+  EXPECT_EQ(spec->keys, (std::vector<std::string>{"a", "b"}));
+  EXPECT_EQ(spec->timeout, std::chrono::milliseconds(1500));
+  EXPECT_FALSE(get_blocking_spec(make_command({"blpop", "a", "0"}))
+                   ->timeout.has_value());
+  EXPECT_FALSE(get_blocking_spec(make_command({"lpop", "a"})).has_value());
+
+  // Blocking pops are propagated as the pop that went through.
+  const auto propagated = make_propagated_command(
+      make_command({"blpop", "a", "b", "0"}), array({"b", "x"}));
+  EXPECT_EQ(propagated.verb, CommandVerb::LPop);
+  EXPECT_EQ(propagated.arguments, (std::vector<std::string>{"b"}));
+
+  EXPECT_EQ(run({"xadd", "s", "5-1", "a", "b"}),
+            (Message{"5-1", DataType::BulkString}));
+  const auto xread =
+      make_command({"xread", "BLOCK", "100", "STREAMS", "s", "t", "$", "$"});
+  EXPECT_EQ(handle_command(xread, Config{}, cache), NIL);
+  const auto xread_spec = get_blocking_spec(xread);
+  ASSERT_TRUE(xread_spec.has_value());
+  EXPECT_EQ(xread_spec->keys, (std::vector<std::string>{"s", "t"}));
+  EXPECT_EQ(xread_spec->timeout, std::chrono::milliseconds(100));
+  // Retrying it later must only see entries added since it blocked.
+  EXPECT_EQ(make_blocked_command(xread, cache).arguments,
+            (std::vector<std::string>{"BLOCK", "100", "STREAMS", "s", "t",
+                                      "5-1", "0-0"}));
+  EXPECT_FALSE(get_blocking_spec(make_command({"xread", "STREAMS", "s", "0"}))
+                   .has_value());
+  EXPECT_TRUE(is_error(run({"xread", "BLOCK", "-1", "STREAMS", "s", "0"})));
+}
+
+TEST(CommandTest, CommandKeys) {
+  using Keys = std::vector<std::string>;
+  EXPECT_EQ(command_keys(make_command({"get", "a"})), Keys{"a"});
+  EXPECT_EQ(command_keys(make_command({"set", "a", "b"})), Keys{"a"});
+  EXPECT_EQ(command_keys(make_command({"del", "a", "b"})), (Keys{"a", "b"}));
+  EXPECT_EQ(command_keys(make_command({"bitop", "and", "d", "a", "b"})),
+            (Keys{"d", "a", "b"}));
+  EXPECT_EQ(command_keys(make_command({"sintercard", "2", "a", "b", "limit",
+                                       "1"})),
+            (Keys{"a", "b"}));
+  EXPECT_EQ(command_keys(make_command({"blpop", "a", "b", "0"})),
+            (Keys{"a", "b"}));
+  EXPECT_EQ(command_keys(make_command({"xread", "count", "1", "streams", "a",
+                                       "b", "0", "0"})),
+            (Keys{"a", "b"}));
+  EXPECT_EQ(command_keys(Command{CommandVerb::Ping, {}}), Keys{});
+  EXPECT_EQ(command_keys(Command{CommandVerb::FlushAll, {}}), Keys{});
+  EXPECT_EQ(command_keys(make_command({"migrate", "h", "1", "a", "0", "0"})),
+            Keys{});
+  EXPECT_EQ(command_keys(make_command({"publish", "channel", "hi"})), Keys{});
+  EXPECT_EQ(command_keys(make_command({"ping"})), Keys{});
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "../src/replication_backlog.hpp"
+
+TEST(ReplicationBacklogTest, WrapsAround) {
+  ReplicationBacklog backlog(8, 100);
+  EXPECT_EQ(backlog.end_offset(), 100);
+  EXPECT_TRUE(backlog.contains(100));
+  EXPECT_FALSE(backlog.contains(99));
+  std::string out{};
+  EXPECT_TRUE(backlog.read(100, out));
+  EXPECT_EQ(out, "");
+
+  backlog.append("abcde");
+  EXPECT_TRUE(backlog.read(101, out));
+  EXPECT_EQ(out, "bcde");
+  // The oldest bytes get overwritten once the ring is full.
+  backlog.append("fghij");
+  EXPECT_EQ(backlog.end_offset(), 110);
+  EXPECT_EQ(backlog.start_offset(), 102);
+  EXPECT_EQ(backlog.size(), 8);
+  out.clear();
+  EXPECT_FALSE(backlog.read(101, out));
+  EXPECT_EQ(out, "");
+  EXPECT_TRUE(backlog.read(102, out));
+  EXPECT_EQ(out, "cdefghij");
+  out.clear();
+  EXPECT_TRUE(backlog.read(104, out, 3));
+  EXPECT_EQ(out, "efg");
+
+  // Appending more than fits keeps only the end of it.
+  backlog.append("0123456789xy");
+  EXPECT_EQ(backlog.end_offset(), 122);
+  out.clear();
+  EXPECT_TRUE(backlog.read(backlog.start_offset(), out));
+  EXPECT_EQ(out, "456789xy");
+}
+
+TEST(ReplicationBacklogTest, MatchesTheWholeStream) {
+  std::mt19937 rng(42);
+  ReplicationBacklog backlog(100, 0);
+  std::string stream{};
+  for (int i = 0; i < 1000; ++i) {
+    const std::string data(rng() % 30, static_cast<char>('a' + (i % 26)));
+    backlog.append(data);
+    stream += data;
+    ASSERT_EQ(backlog.end_offset(), stream.size());
+    const auto from = backlog.start_offset() + (rng() % (backlog.size() + 1));
+    std::string out{};
+    ASSERT_TRUE(backlog.read(from, out));
+    ASSERT_EQ(out, stream.substr(from));
+  }
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/skiplist.hpp"
+
+namespace {
+std::vector<std::pair<double, std::string>> skiplist_elements(
+    const SkipList &list) {
+  std::vector<std::pair<double, std::string>> result{};
+  for (const auto *node = list.first(); node != nullptr; node = node->next()) {
+    result.emplace_back(node->score(), node->member());
+  }
+  return result;
+}
+} // namespace
+
+TEST(SkipListTest, InsertEraseAndOrder) {
+  SkipList list{};
+  EXPECT_EQ(list.first(), nullptr);
+  EXPECT_EQ(list.last(), nullptr);
+  list.insert(2, "b");
+  list.insert(1, "z");
+  list.insert(2, "a");
+  list.insert(-1, "c");
+  // Ties on score are ordered by member.
+  EXPECT_EQ(skiplist_elements(list),
+            (std::vector<std::pair<double, std::string>>{
+                {-1, "c"}, {1, "z"}, {2, "a"}, {2, "b"}}));
+  EXPECT_EQ(list.last()->member(), "b");
+  EXPECT_EQ(list.last()->prev()->member(), "a");
+  EXPECT_EQ(list.first()->prev(), nullptr);
+
+  EXPECT_FALSE(list.erase(1, "a"));
+  EXPECT_TRUE(list.erase(2, "b"));
+  EXPECT_EQ(list.size(), 3);
+  EXPECT_EQ(list.last()->member(), "a");
+
+  // Moving the member keeps its node, so pointers to it stay valid.
+  const auto *node = list.first();
+  EXPECT_EQ(list.update_score(-1, "c", 5), node);
+  EXPECT_EQ(list.last(), node);
+  EXPECT_EQ(list.update_score(5, "c", 4), node);
+  EXPECT_EQ(skiplist_elements(list),
+            (std::vector<std::pair<double, std::string>>{
+                {1, "z"}, {2, "a"}, {4, "c"}}));
+
+  const auto copy = list;
+  EXPECT_EQ(copy, list);
+  list.erase(1, "z");
+  EXPECT_NE(copy, list);
+}
+
+TEST(SkipListTest, RanksAndRanges) {
+  // Insert in a random order, so the levels and spans get exercised.
+  std::vector<int> scores(1000);
+  std::iota(scores.begin(), scores.end(), 0);
+  std::shuffle(scores.begin(), scores.end(), std::mt19937{42});
+  SkipList list{};
+  for (const auto score : scores) {
+    list.insert(score, "m" + std::to_string(score));
+  }
+  for (std::size_t rank = 0; rank < 1000; rank += 37) {
+    const auto score = static_cast<double>(rank);
+    EXPECT_EQ(list.rank(score, "m" + std::to_string(rank)), rank);
+    ASSERT_NE(list.at_rank(rank), nullptr);
+    EXPECT_EQ(list.at_rank(rank)->score(), score);
+  }
+  EXPECT_FALSE(list.rank(5, "m6").has_value());
+  EXPECT_EQ(list.at_rank(1000), nullptr);
+
+  // Erasing and moving members keeps the spans right.
+  for (int score = 0; score < 1000; score += 2) {
+    list.erase(score, "m" + std::to_string(score));
+  }
+  list.update_score(999, "m999", -1);
+  EXPECT_EQ(list.size(), 500);
+  EXPECT_EQ(list.rank(-1, "m999"), 0);
+  EXPECT_EQ(list.rank(1, "m1"), 1);
+  EXPECT_EQ(list.rank(997, "m997"), 499);
+  EXPECT_EQ(list.at_rank(250)->member(), "m499");
+
+  EXPECT_EQ(list.first_in_range({.min = 10, .max = 20})->score(), 11);
+  EXPECT_EQ(list.last_in_range({.min = 10, .max = 20})->score(), 19);
+  EXPECT_EQ(list.first_in_range({.min = 11,
+                                 .max = 20,
+                                 .min_exclusive = true})
+                ->score(),
+            13);
+  EXPECT_EQ(list.first_in_range({.min = 11.5, .max = 12}), nullptr);
+  EXPECT_EQ(list.last_in_range(
+                {.min = 990,
+                 .max = std::numeric_limits<double>::infinity()})
+                ->score(),
+            997);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/slow_log.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using Words = std::vector<std::string>;
+
+Command get(const std::string &key) {
+  return Command{.verb = CommandVerb::Get, .arguments = {key}};
+}
+
+} // namespace
+
+TEST(SlowLogTest, KeepsTheMostRecentEntries) {
+  SlowLog log(3);
+  for (int i = 0; i < 5; ++i) {
+    log.add(get("key" + std::to_string(i)), std::chrono::microseconds(i),
+            "127.0.0.1:5000", "worker");
+  }
+  EXPECT_EQ(log.size(), 3);
+  const auto entries = log.get(10);
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].id, 4);
+  EXPECT_EQ(entries[0].words, (Words{"get", "key4"}));
+  EXPECT_EQ(entries[0].duration, 4us);
+  EXPECT_EQ(entries[0].client_address, "127.0.0.1:5000");
+  EXPECT_EQ(entries[0].client_name, "worker");
+  EXPECT_EQ(entries[1].id, 3);
+  EXPECT_EQ(entries[2].id, 2);
+  ASSERT_EQ(log.get(1).size(), 1);
+  EXPECT_EQ(log.get(1).front().id, 4);
+
+  // IDs carry on after a reset.
+  log.reset();
+  EXPECT_EQ(log.size(), 0);
+  log.add(get("key"), 1us, "", "");
+  EXPECT_EQ(log.get(10).front().id, 5);
+
+  SlowLog disabled(0);
+  disabled.add(get("key"), 1us, "", "");
+  EXPECT_EQ(disabled.size(), 0);
+}
+
+TEST(SlowLogTest, TruncatesLongCommands) {
+  SlowLog log(1);
+  Command command{.verb = CommandVerb::ConfigGet,
+                  .arguments = {std::string(200, 'x')}};
+  log.add(command, 1us, "", "");
+  EXPECT_EQ(log.get(1).front().words,
+            (Words{"config", "get",
+                   std::string(128, 'x') + "... (72 more bytes)"}));
+
+  command = Command{.verb = CommandVerb::RPush, .arguments = {"list"}};
+  for (int i = 0; i < 40; ++i) {
+    command.arguments.push_back(std::to_string(i));
+  }
+  log.add(command, 1us, "", "");
+  const auto words = log.get(1).front().words;
+  ASSERT_EQ(words.size(), SlowLog::MAX_ARGUMENTS);
+  EXPECT_EQ(words[0], "rpush");
+  EXPECT_EQ(words[1], "list");
+  EXPECT_EQ(words[30], "28");
+  // 42 words, of which 31 are kept.
+  EXPECT_EQ(words.back(), "... (11 more arguments)");
+}
@@ -1,10 +1,15 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <filesystem>
+#include <iterator>
 #include <random>
+#include <span>
 #include <sstream>
 #include <string>
 
+#include "../src/cache.hpp"
+#include "../src/config.hpp"
 #include "../src/storage.hpp"
 
 namespace {
@@ -86,22 +91,20 @@ TEST(StorageTest, ParseLengthEncodedString) {
   EXPECT_EQ(actual_output, expected_output);
 
   // Test case: length encoding bits are 10 and length is 16384.
-  // The first byte "\x80" has length encoding bits 10 (the rest of the byte is
-  // discarded). The next four bytes come in little-endian and make up the
-  // length 16384 (which is the same as the swapped bytes: 0x00004000).
+  // The first byte "\x80" means a 32-bit length follows. The next four bytes
+  // come in big-endian and make up the length 16384 (0x00004000).
   expected_output = get_random_string_n_bytes(16384);
-  input = std::istringstream{"\x80" + std::string("\x00", 1) + "\x40" +
-                             std::string(2, '\x00') + expected_output};
+  input = std::istringstream{"\x80" + std::string(2, '\x00') + "\x40" +
+                             std::string("\x00", 1) + expected_output};
   actual_output = parse_length_encoded_string(input);
   EXPECT_EQ(actual_output.size(), expected_output.size());
   EXPECT_EQ(actual_output, expected_output);
 
   // Test case: length encoding bits are 10 and length is 17000.
-  // The first byte "\x80" has length encoding bits 10 (the rest of the byte is
-  // discarded). The next four bytes come in little-endian and make up the
-  // length 17000 (which is the same as the swapped bytes: 0x00004268).
+  // The first byte "\x80" means a 32-bit length follows. The next four bytes
+  // come in big-endian and make up the length 17000 (0x00004268).
   expected_output = get_random_string_n_bytes(17000);
-  input = std::istringstream{"\x80\x68\x42" + std::string(2, '\x00') +
+  input = std::istringstream{std::string("\x80\x00\x00\x42\x68", 5) +
                              expected_output};
   actual_output = parse_length_encoded_string(input);
   EXPECT_EQ(actual_output.size(), expected_output.size());
@@ -124,8 +127,8 @@ TEST(StorageTest, ParseLengthEncodedString) {
   EXPECT_EQ(actual_output, expected_output);
 
   // Test case: length encoding bits are 11 and the string an 8-bit integer with
-  // value 255.
-  expected_output = "255";
+  // value -1 (the integers are signed).
+  expected_output = "-1";
   input = std::istringstream{"\xC0\xFF"};
   actual_output = parse_length_encoded_string(input);
   EXPECT_EQ(actual_output.size(), expected_output.size());
@@ -140,8 +143,8 @@ TEST(StorageTest, ParseLengthEncodedString) {
   EXPECT_EQ(actual_output, expected_output);
 
   // Test case: length encoding bits are 11 and the string a 16-bit integer with
-  // value (2^16)-1 (65535).
-  expected_output = "65535";
+  // value -1.
+  expected_output = "-1";
   input = std::istringstream{"\xC1\xFF\xFF"};
   actual_output = parse_length_encoded_string(input);
   EXPECT_EQ(actual_output.size(), expected_output.size());
@@ -157,8 +160,8 @@ TEST(StorageTest, ParseLengthEncodedString) {
   EXPECT_EQ(actual_output, expected_output);
 
   // Test case: length encoding bits are 11 and the string a 32-bit integer with
-  // value (2^32)-1.
-  expected_output = std::to_string((static_cast<std::uint64_t>(1) << 32U) - 1);
+  // value -1.
+  expected_output = "-1";
   input = std::istringstream{"\xC2\xFF\xFF\xFF\xFF"};
   actual_output = parse_length_encoded_string(input);
   EXPECT_EQ(actual_output.size(), expected_output.size());
@@ -209,8 +212,203 @@ TEST(StorageTest, ReadRDB) {
   ASSERT_EQ(rdb.database_sections.size(), 1);
   ASSERT_EQ(rdb.database_sections.front().data.size(), 1);
   ASSERT_TRUE(rdb.database_sections.front().data.contains("mykey"));
-  ASSERT_EQ(rdb.database_sections.front().data.at("mykey").first, "myval");
+  ASSERT_EQ(
+      std::get<std::string>(rdb.database_sections.front().data.at("mykey").first),
+      "myval");
   EXPECT_EQ(rdb.eof.crc64,
             (std::array<std::uint8_t, 8>{0xcc, 0xf7, 0x77, 0x2d, 0x5f, 0x89,
                                          0x2d, 0x7c}));
-}
\ No newline at end of file
+}
+
+TEST(StorageTest, ReadRDBChecksumMismatch) {
+  // The same file as in ReadRDB, but with the value "myval" changed to "myvaX"
+  // so the recorded checksum no longer matches.
+  std::vector<std::uint8_t> rdb_bytes = {
+      0x52, 0x45, 0x44, 0x49, 0x53, 0x30, 0x30, 0x30, 0x39, 0xfa, 0x09,
+      0x72, 0x65, 0x64, 0x69, 0x73, 0x2d, 0x76, 0x65, 0x72, 0x05, 0x35,
+      0x2e, 0x30, 0x2e, 0x37, 0xfa, 0x0a, 0x72, 0x65, 0x64, 0x69, 0x73,
+      0x2d, 0x62, 0x69, 0x74, 0x73, 0xc0, 0x40, 0xfa, 0x05, 0x63, 0x74,
+      0x69, 0x6d, 0x65, 0xc2, 0x75, 0xd3, 0x92, 0x66, 0xfa, 0x08, 0x75,
+      0x73, 0x65, 0x64, 0x2d, 0x6d, 0x65, 0x6d, 0xc2, 0xf8, 0x26, 0x0c,
+      0x00, 0xfa, 0x0c, 0x61, 0x6f, 0x66, 0x2d, 0x70, 0x72, 0x65, 0x61,
+      0x6d, 0x62, 0x6c, 0x65, 0xc0, 0x00, 0xfe, 0x00, 0xfb, 0x01, 0x00,
+      0x00, 0x05, 0x6d, 0x79, 0x6b, 0x65, 0x79, 0x05, 0x6d, 0x79, 0x76,
+      0x61, 0x58, 0xff, 0xcc, 0xf7, 0x77, 0x2d, 0x5f, 0x89, 0x2d, 0x7c,
+  };
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const std::string rdb_string(reinterpret_cast<const char *>(rdb_bytes.data()),
+                               rdb_bytes.size());
+  std::istringstream input_stream{rdb_string};
+  ASSERT_DEATH({ read_rdb(input_stream); }, "RDB checksum mismatch");
+}
+
+TEST(StorageTest, WriteAndReadRDB) {
+  Cache cache{};
+  cache.set("mykey", "myval");
+  cache.set("number", "12345");
+  cache.set("negative", "-7");
+  cache.set("big", get_random_string_n_bytes(20000));
+  cache.set("expires", "soon", std::chrono::hours(1));
+
+  std::stringstream stream{};
+  write_rdb(stream, cache);
+  // Reading verifies the checksum we wrote at the end.
+  const auto rdb = read_rdb(stream);
+  EXPECT_EQ(rdb.header.version, 11);
+  ASSERT_EQ(rdb.database_sections.size(), 1);
+  const auto &data = rdb.database_sections.front().data;
+  ASSERT_EQ(data.size(), 5);
+  for (const auto &key : cache.keys()) {
+    ASSERT_TRUE(data.contains(key));
+    EXPECT_EQ(std::get<std::string>(data.at(key).first), cache.get(key));
+  }
+  EXPECT_FALSE(data.at("mykey").second.has_value());
+  ASSERT_TRUE(data.at("expires").second.has_value());
+  EXPECT_GT(*data.at("expires").second, std::chrono::steady_clock::now());
+}
+
+TEST(StorageTest, WriteAndReadRDBAggregates) {
+  // Each aggregate type in each of its encodings comes back in the same
+  // encoding.
+  ListValue list{};
+  for (int i = 0; i < 1000; ++i) {
+    list.push_back("element" + std::to_string(i));
+  }
+  ASSERT_GT(list.nodes().size(), 1);
+  const auto intset = IntSet::from_bytes(std::string(
+      "\x02\x00\x00\x00\x02\x00\x00\x00\x01\x00\x02\x00", 12));
+  ASSERT_TRUE(intset.has_value());
+  Listpack small{};
+  small.push_back("a");
+  small.push_back("1.5");
+  small.push_back("b");
+  small.push_back("2");
+  SortedSetTable table{};
+  table.insert("x", 1.25);
+  table.insert("y", -3.0);
+  // IDs past 32 bits need the 8 byte length encoding, and trimming leaves a
+  // deleted entry behind in the first block.
+  Stream stream_value{};
+  for (std::uint64_t i = 0; i < 5; ++i) {
+    stream_value.append({(std::uint64_t{1} << 40U) + i, i},
+                        std::vector<std::string>{"f", std::to_string(i)}, 0,
+                        2);
+  }
+  stream_value.trim_to_length(2, false);
+
+  const std::vector<std::pair<Cache::KeyT, Cache::EntryT>> entries = {
+      {"list", {list, std::nullopt}},
+      {"intset", {SetValue{*intset}, std::nullopt}},
+      {"set_listpack", {SetValue{small}, std::nullopt}},
+      {"set", {SetValue{std::unordered_set<std::string>{"p", "q"}},
+               std::nullopt}},
+      {"zset_listpack", {SortedSetValue{small}, std::nullopt}},
+      {"zset", {SortedSetValue{table}, std::nullopt}},
+      {"hash_listpack", {HashValue{small}, std::nullopt}},
+      {"hash",
+       {HashValue{std::unordered_map<std::string, std::string>{{"f", "v"}}},
+        std::nullopt}},
+      {"stream", {StreamValue{stream_value}, std::nullopt}},
+  };
+  std::stringstream stream{};
+  write_rdb(stream, std::vector<Cache::SnapshotT>{entries});
+  const auto rdb = read_rdb(stream);
+  ASSERT_EQ(rdb.database_sections.size(), 1);
+  const auto &data = rdb.database_sections.front().data;
+  ASSERT_EQ(data.size(), entries.size());
+  for (const auto &[key, entry] : entries) {
+    ASSERT_TRUE(data.contains(key));
+    EXPECT_EQ(data.at(key).first, entry.first) << key;
+  }
+}
+
+TEST(StorageTest, DumpAndRestoreValue) {
+  Listpack small{};
+  small.push_back("f");
+  small.push_back("v");
+  for (const auto &value :
+       {Cache::ValueT{std::string("hello")}, Cache::ValueT{HashValue{small}},
+        Cache::ValueT{SetValue{std::unordered_set<std::string>{"p", "q"}}}}) {
+    const auto payload = dump_value(value);
+    const auto restored = restore_value(payload);
+    ASSERT_TRUE(restored.has_value());
+    EXPECT_EQ(*restored, value);
+  }
+  // The type byte, the value, the version and the checksum.
+  const auto payload = dump_value(std::string("v"));
+  ASSERT_EQ(payload.size(), 1 + 2 + 2 + 8);
+  EXPECT_EQ(payload.substr(0, 5), std::string("\x00\x01v\x0b\x00", 5));
+
+  // Any corruption is caught by the checksum.
+  auto corrupted = payload;
+  corrupted[2] = 'w';
+  EXPECT_FALSE(restore_value(corrupted).has_value());
+  EXPECT_FALSE(restore_value(payload.substr(0, 9)).has_value());
+  EXPECT_FALSE(restore_value("").has_value());
+}
+
+TEST(StorageTest, WriteAndReadRDBDatabases) {
+  std::vector<Cache> databases(16);
+  databases[0].set("zero", "0");
+  databases[3].set("three", "3");
+  databases[15].set("fifteen", "15", std::chrono::hours(1));
+
+  std::stringstream stream{};
+  write_rdb(stream, databases);
+  // Each key goes back into the database it came from.
+  std::vector<Cache> loaded(16);
+  const auto rdb = read_rdb_into_databases(stream, loaded);
+  ASSERT_EQ(rdb.database_sections.size(), 16);
+  for (std::size_t i = 0; i < databases.size(); ++i) {
+    EXPECT_EQ(loaded[i].keys(), databases[i].keys()) << i;
+  }
+  EXPECT_EQ(loaded[15].get("fifteen"), "15");
+
+  // Loading into fewer databases than the file uses is fatal.
+  stream.clear();
+  stream.seekg(0);
+  std::vector<Cache> too_few(4);
+  ASSERT_DEATH({ read_rdb_into_databases(stream, too_few); },
+               "only have 4 databases");
+}
+
+TEST(StorageTest, LoadCacheReportsProgress) {
+  Cache written{};
+  constexpr std::size_t NUM_KEYS = 5000;
+  for (std::size_t i = 0; i < NUM_KEYS; ++i) {
+    written.set("key" + std::to_string(i), get_random_string_n_bytes(100));
+  }
+  const auto dir = std::filesystem::temp_directory_path();
+  const Config config{.dir = dir.string(),
+                      .dbfilename = "storage_test_progress.rdb"};
+  ASSERT_TRUE(save_cache(config, std::span(&written, 1)));
+
+  // The entries are streamed into the cache in batches, and the progress ends
+  // up covering the whole file.
+  Cache loaded{};
+  LoadingProgress progress{};
+  load_cache(config, std::span(&loaded, 1), &progress);
+  const auto file_size = std::filesystem::file_size(dir / *config.dbfilename);
+  EXPECT_EQ(progress.total_bytes, file_size);
+  EXPECT_EQ(progress.loaded_bytes, file_size);
+  EXPECT_EQ(progress.loaded_keys, NUM_KEYS);
+  EXPECT_EQ(loaded.size(), NUM_KEYS);
+  EXPECT_EQ(loaded.get("key42"), written.get("key42"));
+  std::filesystem::remove(dir / *config.dbfilename);
+}
+
+TEST(StorageTest, FailedSaveLeavesNoTempFile) {
+  const auto dir =
+      std::filesystem::temp_directory_path() / "storage_test_failed_save";
+  std::filesystem::remove_all(dir);
+  // The RDB file can't be replaced by the new one if it's a directory.
+  std::filesystem::create_directories(dir / "dump.rdb" / "in_the_way");
+  const Config config{.dir = dir.string(), .dbfilename = "dump.rdb"};
+  Cache cache{};
+  cache.set("key", "value");
+  EXPECT_FALSE(save_cache(config, std::span(&cache, 1)));
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir),
+                          std::filesystem::directory_iterator()),
+            1);
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../src/stream.hpp"
+
+namespace {
+std::vector<std::string> ids(const std::vector<StreamEntry> &entries) {
+  std::vector<std::string> result{};
+  for (const auto &entry : entries) {
+    result.push_back(entry.id.to_string());
+  }
+  return result;
+}
+
+// Appends entries 1-0 to count-0, in blocks of up to 3 entries.
+Stream make_stream(std::uint64_t count) {
+  Stream stream{};
+  for (std::uint64_t i = 1; i <= count; ++i) {
+    // Every other entry has the same fields as the first one of its block.
+    const std::vector<std::string> fields =
+        i % 2 == 0 ? std::vector<std::string>{"n", std::to_string(i)}
+                   : std::vector<std::string>{"n", std::to_string(i), "odd",
+                                              "yes"};
+    stream.append({i, 0}, fields, 0, 3);
+  }
+  return stream;
+}
+} // namespace
+
+TEST(StreamTest, StreamIds) {
+  EXPECT_EQ(StreamId::parse("1526919030474-55"),
+            (StreamId{1526919030474, 55}));
+  EXPECT_EQ(StreamId::parse("5"), (StreamId{5, 0}));
+  EXPECT_EQ(StreamId::parse("5", UINT64_MAX), (StreamId{5, UINT64_MAX}));
+  EXPECT_EQ(StreamId::parse("-1"), std::nullopt);
+  EXPECT_EQ(StreamId::parse("1-"), std::nullopt);
+  EXPECT_EQ(StreamId::parse("1-2-3"), std::nullopt);
+  EXPECT_EQ(StreamId::parse("abc"), std::nullopt);
+  EXPECT_EQ(StreamId::parse("18446744073709551616"), std::nullopt);
+
+  const StreamId id{0x0102030405060708, 9};
+  EXPECT_EQ(StreamId::from_key(id.to_key()), id);
+  // Keys sort like IDs.
+  EXPECT_LT((StreamId{1, 300}).to_key(), (StreamId{2, 0}).to_key());
+  EXPECT_LT((StreamId{1, 255}).to_key(), (StreamId{1, 256}).to_key());
+
+  EXPECT_EQ((StreamId{1, UINT64_MAX}).next(), (StreamId{2, 0}));
+  EXPECT_EQ(StreamId::max().next(), std::nullopt);
+  EXPECT_EQ((StreamId{2, 0}).prev(), (StreamId{1, UINT64_MAX}));
+  EXPECT_EQ(StreamId{}.prev(), std::nullopt);
+  EXPECT_EQ((StreamId{7, 3}).to_string(), "7-3");
+}
+
+TEST(StreamTest, AppendAndRange) {
+  auto stream = make_stream(10);
+  EXPECT_EQ(stream.size(), 10);
+  EXPECT_EQ(stream.blocks().size(), 4);
+  EXPECT_EQ(stream.first_id(), (StreamId{1, 0}));
+  EXPECT_EQ(stream.last_id(), (StreamId{10, 0}));
+  EXPECT_EQ(stream.entries_added(), 10);
+
+  const auto all = stream.range({}, StreamId::max());
+  ASSERT_EQ(all.size(), 10);
+  EXPECT_EQ(all[0].fields,
+            (std::vector<std::string>{"n", "1", "odd", "yes"}));
+  EXPECT_EQ(all[1].fields, (std::vector<std::string>{"n", "2"}));
+  EXPECT_EQ(all[4].fields,
+            (std::vector<std::string>{"n", "5", "odd", "yes"}));
+
+  EXPECT_EQ(ids(stream.range({3, 0}, {6, 0})),
+            (std::vector<std::string>{"3-0", "4-0", "5-0", "6-0"}));
+  EXPECT_EQ(ids(stream.range({2, 1}, {9, 0}, 3)),
+            (std::vector<std::string>{"3-0", "4-0", "5-0"}));
+  EXPECT_EQ(ids(stream.range({3, 0}, {7, 5}, 3, true)),
+            (std::vector<std::string>{"7-0", "6-0", "5-0"}));
+  EXPECT_EQ(ids(stream.range({9, 0}, StreamId::max(), 0, true)),
+            (std::vector<std::string>{"10-0", "9-0"}));
+  EXPECT_TRUE(stream.range({11, 0}, StreamId::max()).empty());
+  EXPECT_TRUE(stream.range({5, 0}, {4, 0}).empty());
+
+  // Blocks also close once they reach the byte limit, here after the third
+  // entry.
+  Stream small_blocks{};
+  const std::vector<std::string> fields{"field", std::string(100, 'x')};
+  for (std::uint64_t i = 1; i <= 10; ++i) {
+    small_blocks.append({1, i}, fields, 256, 0);
+  }
+  EXPECT_EQ(small_blocks.blocks().size(), 4);
+  EXPECT_EQ(small_blocks.range({}, StreamId::max()).size(), 10);
+}
+
+TEST(StreamTest, Trim) {
+  auto stream = make_stream(10);
+  // Approximate trimming only drops whole blocks.
+  EXPECT_EQ(stream.trim_to_length(6, true), 3);
+  EXPECT_EQ(stream.size(), 7);
+  EXPECT_EQ(stream.first_id(), (StreamId{4, 0}));
+  // Exact trimming flags the rest as deleted.
+  EXPECT_EQ(stream.trim_to_length(6, false), 1);
+  EXPECT_EQ(stream.size(), 6);
+  EXPECT_EQ(stream.blocks().size(), 3);
+  EXPECT_EQ(stream.first_id(), (StreamId{5, 0}));
+  EXPECT_EQ(stream.max_deleted_id(), (StreamId{4, 0}));
+  EXPECT_EQ(ids(stream.range({}, {6, 0}, 0, true)),
+            (std::vector<std::string>{"6-0", "5-0"}));
+
+  EXPECT_EQ(stream.trim_before({8, 0}, false), 3);
+  EXPECT_EQ(ids(stream.range({}, StreamId::max())),
+            (std::vector<std::string>{"8-0", "9-0", "10-0"}));
+  EXPECT_EQ(stream.trim_before({8, 0}, false), 0);
+  EXPECT_EQ(stream.trim_to_length(0, false), 3);
+  EXPECT_TRUE(stream.empty());
+  EXPECT_TRUE(stream.blocks().empty());
+  EXPECT_EQ(stream.first_id(), StreamId{});
+  // The last ID stays, so new entries still have to come after it.
+  EXPECT_EQ(stream.last_id(), (StreamId{10, 0}));
+  EXPECT_EQ(stream.max_deleted_id(), (StreamId{10, 0}));
+}
+
+TEST(StreamTest, FromBlocksAndEquality) {
+  auto stream = make_stream(7);
+  stream.trim_to_length(5, false);
+  const auto rebuilt =
+      Stream::from_blocks(stream.blocks(), stream.last_id(),
+                          stream.max_deleted_id(), stream.entries_added());
+  ASSERT_TRUE(rebuilt.has_value());
+  EXPECT_EQ(rebuilt->size(), 5);
+  EXPECT_EQ(*rebuilt, stream);
+
+  auto copy = stream;
+  EXPECT_EQ(copy, stream);
+  copy.append({8, 0}, std::vector<std::string>{"n", "8"}, 0, 3);
+  EXPECT_NE(copy, stream);
+
+  RadixTree<Listpack> malformed{};
+  Listpack block{};
+  block.push_back("not a count");
+  malformed.insert(StreamId{1, 0}.to_key(), block);
+  EXPECT_EQ(Stream::from_blocks(malformed, {1, 0}, {}, 1), std::nullopt);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "../src/timer_wheel.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+using Ids = std::vector<TimerWheel::Id>;
+} // namespace
+
+TEST(TimerWheelTest, FiresAtTheEndOfTheTick) {
+  const auto start = TimerWheel::Clock::now();
+  TimerWheel wheel(10ms, start);
+  wheel.schedule(1, start + 25ms);
+  wheel.schedule(2, start + 30ms);
+  wheel.schedule(3, start + 31ms);
+  EXPECT_EQ(wheel.size(), 3);
+  EXPECT_TRUE(wheel.advance(start + 29ms).empty());
+  EXPECT_EQ(wheel.advance(start + 30ms), (Ids{1, 2}));
+  EXPECT_TRUE(wheel.advance(start + 39ms).empty());
+  EXPECT_EQ(wheel.advance(start + 40ms), (Ids{3}));
+  EXPECT_TRUE(wheel.empty());
+
+  // Deadlines that already passed fire on the next tick.
+  wheel.schedule(4, start);
+  EXPECT_EQ(wheel.advance(start + 50ms), (Ids{4}));
+}
+
+TEST(TimerWheelTest, ReschedulesAndCancels) {
+  const auto start = TimerWheel::Clock::now();
+  TimerWheel wheel(1ms, start);
+  wheel.schedule(1, start + 10ms);
+  wheel.schedule(2, start + 10ms);
+  wheel.schedule(1, start + 5s);
+  wheel.cancel(2);
+  wheel.cancel(3);
+  EXPECT_TRUE(wheel.advance(start + 4s).empty());
+  EXPECT_EQ(wheel.size(), 1);
+  EXPECT_EQ(wheel.advance(start + 5s), (Ids{1}));
+}
+
+TEST(TimerWheelTest, MatchesSortedDeadlines) {
+  // Deadlines from one tick to past the span of the wheels (2^24 ticks),
+  // checked against the same timers kept in order.
+  const auto start = TimerWheel::Clock::now();
+  constexpr auto TICK = 1ms;
+  TimerWheel wheel(TICK, start);
+  std::map<TimerWheel::Id, std::uint64_t> expected{};
+  std::mt19937_64 random(42);
+  std::uniform_int_distribution<int> magnitude(0, 26);
+  const auto random_ticks = [&] {
+    return 1 + (random() % (1ULL << static_cast<unsigned>(magnitude(random))));
+  };
+
+  std::uint64_t now = 0;
+  for (int step = 0; step < 2000; ++step) {
+    for (int i = 0; i < 10; ++i) {
+      const TimerWheel::Id id = random() % 500;
+      const auto due = now + random_ticks();
+      wheel.schedule(id, start + (due * TICK));
+      expected[id] = due;
+    }
+    if (step % 7 == 0) {
+      const TimerWheel::Id id = random() % 500;
+      wheel.cancel(id);
+      expected.erase(id);
+    }
+    now += random_ticks() / 4;
+    const auto fired = wheel.advance(start + (now * TICK));
+    Ids expected_fired{};
+    for (auto entry = expected.begin(); entry != expected.end();) {
+      if (entry->second <= now) {
+        expected_fired.push_back(entry->first);
+        entry = expected.erase(entry);
+      } else {
+        ++entry;
+      }
+    }
+    ASSERT_EQ(std::multiset<TimerWheel::Id>(fired.begin(), fired.end()),
+              std::multiset<TimerWheel::Id>(expected_fired.begin(),
+                                            expected_fired.end()))
+        << "at tick " << now;
+    ASSERT_EQ(wheel.size(), expected.size());
+  }
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/tracking.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+// Collects what the table delivers, from whichever thread.
+class Delivered {
+public:
+  TrackingTable::Deliver deliver() {
+    return [this](const Invalidation &invalidation) {
+      std::scoped_lock lock(mutex_);
+      invalidations_.push_back(invalidation);
+    };
+  }
+
+  // The keys each invalidation for the client carried, in order (with an
+  // empty list for "every key").
+  std::vector<std::vector<std::string>> keys_for(std::uint64_t client) {
+    std::scoped_lock lock(mutex_);
+    std::vector<std::vector<std::string>> keys{};
+    for (const auto &invalidation : invalidations_) {
+      if (invalidation.client == client) {
+        keys.push_back(invalidation.keys.value_or(std::vector<std::string>{}));
+      }
+    }
+    return keys;
+  }
+
+  std::size_t size() {
+    std::scoped_lock lock(mutex_);
+    return invalidations_.size();
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<Invalidation> invalidations_;
+};
+
+using Keys = std::vector<std::vector<std::string>>;
+} // namespace
+
+TEST(TrackingTest, InvalidatesKeysReadOnce) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 0);
+  table.enable(1, TrackingOptions{});
+  table.enable(2, TrackingOptions{});
+  table.track(1, "a", std::nullopt);
+  table.track(1, "b", std::nullopt);
+  table.track(2, "a", std::nullopt);
+  EXPECT_EQ(table.num_keys(), 2);
+
+  table.invalidate({"a", "c"}, 3);
+  EXPECT_EQ(delivered.keys_for(1), (Keys{{"a"}}));
+  EXPECT_EQ(delivered.keys_for(2), (Keys{{"a"}}));
+  EXPECT_EQ(table.num_keys(), 1);
+  // They have to read it again to hear about it again.
+  table.invalidate({"a"}, 3);
+  EXPECT_EQ(delivered.size(), 2);
+
+  // Clients that turned tracking off aren't told.
+  table.disable(1);
+  table.invalidate({"b"}, 3);
+  EXPECT_EQ(delivered.size(), 2);
+  EXPECT_EQ(table.num_keys(), 0);
+}
+
+TEST(TrackingTest, NoLoopSkipsOwnWrites) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 0);
+  table.enable(1, TrackingOptions{.noloop = true});
+  table.enable(2, TrackingOptions{.redirect = 5});
+  table.track(1, "a", std::nullopt);
+  table.track(2, "a", std::nullopt);
+  table.invalidate({"a"}, 1);
+  EXPECT_TRUE(delivered.keys_for(1).empty());
+  EXPECT_EQ(delivered.keys_for(2), (Keys{{"a"}}));
+}
+
+TEST(TrackingTest, BroadcastMatchesPrefixes) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 0);
+  table.enable(1, TrackingOptions{.bcast = true, .prefixes = {"user:", "*"}});
+  table.enable(2, TrackingOptions{.bcast = true});
+  EXPECT_EQ(table.num_prefixes(), 3);
+  // Broadcast clients don't fill the table.
+  table.track(1, "user:1", std::nullopt);
+  EXPECT_EQ(table.num_keys(), 0);
+
+  table.invalidate({"user:1", "*x", "order:1"}, 3);
+  EXPECT_EQ(delivered.keys_for(1), (Keys{{"user:1", "*x"}}));
+  EXPECT_EQ(delivered.keys_for(2), (Keys{{"user:1", "*x", "order:1"}}));
+  // Unlike in the default mode, they keep hearing about the keys.
+  table.invalidate({"user:1"}, 3);
+  EXPECT_EQ(delivered.keys_for(1).size(), 2);
+
+  table.disable(1);
+  EXPECT_EQ(table.num_prefixes(), 1);
+}
+
+TEST(TrackingTest, InvalidateAllTellsEveryClient) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 0);
+  table.enable(1, TrackingOptions{});
+  table.enable(2, TrackingOptions{.bcast = true});
+  table.track(1, "a", std::nullopt);
+  table.invalidate_all();
+  EXPECT_EQ(delivered.keys_for(1), (Keys{{}}));
+  EXPECT_EQ(delivered.keys_for(2), (Keys{{}}));
+  EXPECT_EQ(table.num_keys(), 0);
+}
+
+TEST(TrackingTest, EvictsPastMaxKeys) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 2);
+  table.enable(1, TrackingOptions{});
+  table.track(1, "a", std::nullopt);
+  table.track(1, "b", std::nullopt);
+  EXPECT_EQ(delivered.size(), 0);
+  table.track(1, "c", std::nullopt);
+  EXPECT_EQ(table.num_keys(), 2);
+  // The client is told to drop whichever key was evicted, never the one it
+  // just read.
+  const auto evicted = delivered.keys_for(1);
+  ASSERT_EQ(evicted.size(), 1);
+  ASSERT_EQ(evicted.front().size(), 1);
+  EXPECT_NE(evicted.front().front(), "c");
+  table.invalidate({"c"}, 0);
+  EXPECT_EQ(delivered.size(), 2);
+}
+
+TEST(TrackingTest, InvalidatesKeysAsTheyExpire) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 0);
+  std::jthread expirer(
+      [&table](const std::stop_token &stop) { table.expire_keys(stop); });
+  table.enable(1, TrackingOptions{});
+  const auto now = TrackingTable::Clock::now();
+  table.track(1, "later", now + 1h);
+  table.track(1, "soon", now + 50ms);
+  table.track(1, "forever", std::nullopt);
+  const auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (delivered.size() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(delivered.keys_for(1), (Keys{{"soon"}}));
+  EXPECT_EQ(table.num_keys(), 2);
+}
+
+TEST(TrackingTest, StaleDeadlinesDontPileUp) {
+  Delivered delivered{};
+  TrackingTable table(delivered.deliver(), 10);
+  table.enable(1, TrackingOptions{});
+  const auto later = TrackingTable::Clock::now() + 1h;
+  // A hot key with a long TTL, read again after every write.
+  for (int i = 0; i < 10000; ++i) {
+    table.track(1, "hot", later);
+    table.invalidate({"hot"}, 0);
+  }
+  for (int i = 0; i < 100; ++i) {
+    table.track(1, "key" + std::to_string(i), later);
+  }
+  EXPECT_EQ(table.num_keys(), 10);
+  EXPECT_LE(table.num_deadlines(), (2 * 10) + 64);
+}
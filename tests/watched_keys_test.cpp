@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "../src/watched_keys.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+} // namespace
+
+TEST(WatchedKeysTest, WritesMarkTheirWatchers) {
+  WatchedKeys watched{};
+  watched.watch(1, 0, "a", std::nullopt);
+  watched.watch(1, 0, "b", std::nullopt);
+  watched.watch(2, 0, "b", std::nullopt);
+  watched.watch(3, 1, "a", std::nullopt);
+  EXPECT_EQ(watched.num_clients(), 3);
+
+  watched.touch(0, {"a", "c"});
+  EXPECT_TRUE(watched.is_dirty(1));
+  EXPECT_FALSE(watched.is_dirty(2));
+  // The same key in another database is another key.
+  EXPECT_FALSE(watched.is_dirty(3));
+
+  // Watching again starts over.
+  watched.unwatch(1);
+  EXPECT_FALSE(watched.is_dirty(1));
+  watched.watch(1, 0, "a", std::nullopt);
+  EXPECT_FALSE(watched.is_dirty(1));
+
+  watched.unwatch(2);
+  watched.touch(0, {"b"});
+  EXPECT_FALSE(watched.is_dirty(2));
+  EXPECT_FALSE(watched.is_dirty(1));
+  EXPECT_EQ(watched.num_clients(), 2);
+}
+
+TEST(WatchedKeysTest, FlushesMarkEveryWatcher) {
+  WatchedKeys watched{};
+  watched.watch(1, 0, "a", std::nullopt);
+  watched.watch(2, 1, "a", std::nullopt);
+  watched.touch_db(1);
+  EXPECT_FALSE(watched.is_dirty(1));
+  EXPECT_TRUE(watched.is_dirty(2));
+  watched.touch_all();
+  EXPECT_TRUE(watched.is_dirty(1));
+}
+
+TEST(WatchedKeysTest, ExpiredKeysCountAsChanged) {
+  WatchedKeys watched{};
+  const auto now = WatchedKeys::Clock::now();
+  watched.watch(1, 0, "later", now + 1h);
+  watched.watch(1, 0, "soon", now + 1s);
+  EXPECT_FALSE(watched.is_dirty(1, now));
+  EXPECT_TRUE(watched.is_dirty(1, now + 2s));
+}